@@ -0,0 +1,309 @@
+#include <benchmark/benchmark.h>
+#include "data/tensor.hpp"
+#include "../source/layer/details/convolution.hpp"
+#include "../source/layer/details/maxpooling.hpp"
+#include "../source/layer/details/adaptive_avgpooling.hpp"
+#include "../source/layer/details/linear.hpp"
+#include "../source/layer/details/expression.hpp"
+#include "../source/layer/details/cat.hpp"
+#include "../source/layer/details/upsample.hpp"
+#include "../source/layer/details/yolo_detect.hpp"
+#include "../source/layer/details/batchnorm2d.hpp"
+#include "../source/layer/details/relu.hpp"
+#include "../source/layer/details/sigmoid.hpp"
+#include "../source/layer/details/silu.hpp"
+#include "../source/layer/details/hardswish.hpp"
+#include "../source/layer/details/hardsigmoid.hpp"
+#include "../source/layer/details/softmax.hpp"
+
+using namespace kuiper_infer;
+
+/**
+ * 按照操作数的形状创建批次中的随机张量，四维形状是[batch,channels,rows,cols]，二维形状是[batch,features]
+ * @param shape 操作数的形状
+ * @return 批次中的每个张量
+ */
+static std::vector<std::shared_ptr<Tensor<float>>> MakeTensors(const std::vector<int32_t> &shape) {
+  CHECK(shape.size() >= 2 && shape.size() <= 4);
+  uint32_t channels = 1;
+  uint32_t rows = shape.at(1);
+  uint32_t cols = 1;
+  if (shape.size() == 4) {
+    channels = shape.at(1);
+    rows = shape.at(2);
+    cols = shape.at(3);
+  } else if (shape.size() == 3) {
+    cols = shape.at(2);
+  }
+
+  // 和计算图规划的中间张量一样，整个批次放在一块连续内存中
+  std::vector<std::shared_ptr<Tensor<float>>> tensors = Tensor<float>::CreateBatch(shape.at(0), channels, rows, cols);
+  for (const auto &tensor : tensors) {
+    tensor->Rand();
+  }
+  return tensors;
+}
+
+/**
+ * 用随机输入反复执行一个Layer，并根据Layer估计的计算量和访存量给出GFLOP/s和GB/s
+ * @param state benchmark的状态
+ * @param layer 需要测试的Layer
+ * @param input_shapes 每个输入操作数的形状，第一维是批次
+ */
+static void RunLayer(benchmark::State &state, Layer &layer, const std::vector<std::vector<int32_t>> &input_shapes) {
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (const auto &input_shape : input_shapes) {
+    const auto &tensors = MakeTensors(input_shape);
+    inputs.insert(inputs.end(), tensors.begin(), tensors.end());
+  }
+
+  std::vector<int32_t> output_shape;
+  CHECK(layer.InferOutputShape(input_shapes, output_shape)) << "Can not infer the output shape of " << layer.layer_name();
+  // 输出张量预先分配好，计时中不包含输出的分配
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = MakeTensors(output_shape);
+
+  for (auto _ : state) {
+    const InferStatus status = layer.Forward(inputs, outputs);
+    CHECK(status == InferStatus::kInferSuccess) << layer.layer_name() << " layer forward failed";
+    benchmark::DoNotOptimize(outputs.front()->data().memptr());
+    benchmark::ClobberMemory();
+  }
+
+  uint64_t element_size = 0;
+  for (const auto &input : inputs) {
+    element_size += input->size();
+  }
+  for (const auto &output : outputs) {
+    element_size += output->size();
+  }
+  const double flops = double(layer.Flops(input_shapes, output_shape));
+  const double bytes = double(element_size * sizeof(float) + layer.ParamBytes());
+  state.counters["GFLOP/s"] = benchmark::Counter(flops * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["GB/s"] = benchmark::Counter(bytes * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+/// 参数依次是batch, in_channels, out_channels, size, kernel, stride, groups
+static void BM_Convolution(benchmark::State &state) {
+  const uint32_t batch = state.range(0);
+  const uint32_t in_channels = state.range(1);
+  const uint32_t out_channels = state.range(2);
+  const uint32_t size = state.range(3);
+  const uint32_t kernel = state.range(4);
+  const uint32_t stride = state.range(5);
+  const uint32_t groups = state.range(6);
+  const uint32_t padding = (kernel - 1) / 2;
+
+  ConvolutionLayer conv_layer(out_channels, in_channels, kernel, kernel, padding, padding, stride, stride, groups);
+  std::vector<float> weights(out_channels * (in_channels / groups) * kernel * kernel);
+  for (uint32_t i = 0; i < weights.size(); ++i) {
+    weights.at(i) = float(i % 17) / 17.f - 0.5f;
+  }
+  conv_layer.set_weights(weights);
+  conv_layer.set_bias(std::vector<float>(out_channels, 0.1f));
+  RunLayer(state, conv_layer, {{int32_t(batch), int32_t(in_channels), int32_t(size), int32_t(size)}});
+}
+
+/// 参数依次是batch, channels, size, kernel, stride
+static void BM_MaxPooling(benchmark::State &state) {
+  const uint32_t kernel = state.range(3);
+  const uint32_t stride = state.range(4);
+  MaxPoolingLayer max_layer(kernel / 2, kernel / 2, kernel, kernel, stride, stride);
+  RunLayer(state, max_layer, {{int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                               int32_t(state.range(2))}});
+}
+
+/// 参数依次是batch, channels, size, output_size
+static void BM_AdaptiveAvgPooling(benchmark::State &state) {
+  AdaptiveAveragePoolingLayer avg_layer(state.range(3), state.range(3));
+  RunLayer(state, avg_layer, {{int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                               int32_t(state.range(2))}});
+}
+
+/// 参数依次是batch, in_features, out_features
+static void BM_Linear(benchmark::State &state) {
+  const int32_t in_features = state.range(1);
+  const int32_t out_features = state.range(2);
+  LinearLayer linear_layer(in_features, out_features, true);
+  linear_layer.set_weights(std::vector<float>(in_features * out_features, 0.01f));
+  linear_layer.set_bias(std::vector<float>(out_features, 0.1f));
+  RunLayer(state, linear_layer, {{int32_t(state.range(0)), in_features}});
+}
+
+/// 参数依次是batch, channels, size；第一组是残差连接的相加，第二组是SE模块中按通道广播的相乘
+static void BM_ExpressionAdd(benchmark::State &state) {
+  ExpressionLayer expression_layer("add(@0,@1)");
+  const std::vector<int32_t> shape = {int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                                      int32_t(state.range(2))};
+  RunLayer(state, expression_layer, {shape, shape});
+}
+
+static void BM_ExpressionMulBroadcast(benchmark::State &state) {
+  ExpressionLayer expression_layer("mul(@0,@1)");
+  const int32_t batch = state.range(0);
+  const int32_t channels = state.range(1);
+  RunLayer(state, expression_layer, {{batch, channels, int32_t(state.range(2)), int32_t(state.range(2))},
+                                     {batch, channels, 1, 1}});
+}
+
+/// 参数依次是batch, channels, size，两个相同形状的输入在通道维度拼接
+static void BM_Cat(benchmark::State &state) {
+  CatLayer cat_layer(1);
+  const std::vector<int32_t> shape = {int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                                      int32_t(state.range(2))};
+  RunLayer(state, cat_layer, {shape, shape});
+}
+
+/// 参数依次是batch, channels, size，放大两倍
+static void BM_Upsample(benchmark::State &state) {
+  UpSampleLayer upsample_layer(2.f, 2.f);
+  RunLayer(state, upsample_layer, {{int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                                    int32_t(state.range(2))}});
+}
+
+/// 参数依次是batch, input_size，三个检测头的输入是yolov5n在该分辨率下的特征图
+static void BM_YoloDetect(benchmark::State &state) {
+  const int32_t batch = state.range(0);
+  const int32_t input_size = state.range(1);
+  const int32_t stages = 3;
+  const int32_t num_classes = 80;
+  const std::vector<float> strides = {8.f, 16.f, 32.f};
+  const std::vector<int32_t> in_channels = {64, 128, 256};
+  const uint32_t out_channels = stages * (num_classes + 5);
+
+  std::vector<std::shared_ptr<ConvolutionLayer>> conv_layers;
+  std::vector<arma::fmat> grids;
+  std::vector<arma::fmat> anchor_grids;
+  std::vector<std::vector<int32_t>> input_shapes;
+  for (int32_t s = 0; s < stages; ++s) {
+    const int32_t size = input_size / int32_t(strides.at(s));
+    std::shared_ptr<ConvolutionLayer> conv_layer =
+        std::make_shared<ConvolutionLayer>(out_channels, in_channels.at(s), 1, 1, 0, 0, 1, 1, 1);
+    conv_layer->set_weights(std::vector<float>(out_channels * in_channels.at(s), 0.01f));
+    conv_layer->set_bias(std::vector<float>(out_channels, 0.1f));
+    conv_layers.push_back(conv_layer);
+
+    arma::fmat grid(stages * size * size, 2);
+    grid.fill(-0.5f);
+    grids.push_back(grid);
+    arma::fmat anchor_grid(stages * size * size, 2);
+    anchor_grid.fill(strides.at(s) * 2.f);
+    anchor_grids.push_back(anchor_grid);
+    input_shapes.push_back({batch, in_channels.at(s), size, size});
+  }
+  YoloDetectLayer yolo_layer(stages, num_classes, strides, anchor_grids, grids, conv_layers);
+  RunLayer(state, yolo_layer, input_shapes);
+}
+
+/// 参数依次是batch, channels, size
+static void BM_BatchNorm2d(benchmark::State &state) {
+  const uint32_t channels = state.range(1);
+  BatchNorm2dLayer batch_layer(channels, 1e-5f, std::vector<float>(channels, 1.f), std::vector<float>(channels, 0.f));
+  batch_layer.set_weights(std::vector<float>(channels, 0.1f));
+  batch_layer.set_bias(std::vector<float>(channels, 1.f));
+  RunLayer(state, batch_layer, {{int32_t(state.range(0)), int32_t(channels), int32_t(state.range(2)),
+                                 int32_t(state.range(2))}});
+}
+
+/// 激活函数的参数依次是batch, channels, size
+template<typename ActivationLayer>
+static void BM_Activation(benchmark::State &state) {
+  ActivationLayer activation_layer;
+  RunLayer(state, activation_layer, {{int32_t(state.range(0)), int32_t(state.range(1)), int32_t(state.range(2)),
+                                      int32_t(state.range(2))}});
+}
+
+/// resnet18的3x3卷积、下采样卷积和第一层7x7卷积，mobilenet的逐点卷积和逐通道卷积，yolov5n中的3x3和1x1卷积
+BENCHMARK(BM_Convolution)
+    ->ArgNames({"batch", "in", "out", "size", "kernel", "stride", "groups"})
+    ->Args({1, 3, 64, 224, 7, 2, 1})
+    ->Args({1, 64, 64, 56, 3, 1, 1})
+    ->Args({1, 64, 128, 56, 3, 2, 1})
+    ->Args({1, 128, 128, 28, 3, 1, 1})
+    ->Args({1, 256, 256, 14, 3, 1, 1})
+    ->Args({1, 512, 512, 7, 3, 1, 1})
+    ->Args({8, 64, 64, 56, 3, 1, 1})
+    ->Args({1, 32, 32, 112, 3, 1, 32})
+    ->Args({1, 144, 144, 56, 3, 2, 144})
+    ->Args({1, 32, 16, 112, 1, 1, 1})
+    ->Args({1, 96, 24, 56, 1, 1, 1})
+    ->Args({1, 576, 96, 14, 1, 1, 1})
+    ->Args({1, 3, 16, 320, 6, 2, 1})
+    ->Args({1, 32, 32, 80, 3, 1, 1})
+    ->Args({1, 64, 32, 40, 1, 1, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_MaxPooling)
+    ->ArgNames({"batch", "channels", "size", "kernel", "stride"})
+    ->Args({1, 64, 112, 3, 2})
+    ->Args({8, 64, 112, 3, 2})
+    ->Args({1, 128, 20, 5, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_AdaptiveAvgPooling)
+    ->ArgNames({"batch", "channels", "size", "output"})
+    ->Args({1, 512, 7, 1})
+    ->Args({8, 512, 7, 1})
+    ->Args({1, 576, 14, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Linear)
+    ->ArgNames({"batch", "in", "out"})
+    ->Args({1, 512, 1000})
+    ->Args({8, 512, 1000})
+    ->Args({1, 1024, 1000})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_ExpressionAdd)
+    ->ArgNames({"batch", "channels", "size"})
+    ->Args({1, 64, 56})
+    ->Args({8, 64, 56})
+    ->Args({1, 256, 14})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_ExpressionMulBroadcast)
+    ->ArgNames({"batch", "channels", "size"})
+    ->Args({1, 96, 28})
+    ->Args({1, 576, 7})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Cat)
+    ->ArgNames({"batch", "channels", "size"})
+    ->Args({1, 64, 40})
+    ->Args({1, 128, 20})
+    ->Args({4, 64, 40})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_Upsample)
+    ->ArgNames({"batch", "channels", "size"})
+    ->Args({1, 128, 20})
+    ->Args({1, 64, 40})
+    ->Args({4, 64, 40})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_YoloDetect)
+    ->ArgNames({"batch", "input"})
+    ->Args({1, 320})
+    ->Args({4, 320})
+    ->Args({1, 640})
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_BatchNorm2d)
+    ->ArgNames({"batch", "channels", "size"})
+    ->Args({1, 64, 56})
+    ->Args({8, 64, 56})
+    ->Unit(benchmark::kMicrosecond);
+
+#define KUIPER_BENCHMARK_ACTIVATION(ActivationLayer)         \
+  BENCHMARK_TEMPLATE(BM_Activation, ActivationLayer)         \
+      ->ArgNames({"batch", "channels", "size"})              \
+      ->Args({1, 64, 112})                                   \
+      ->Args({8, 64, 56})                                    \
+      ->Args({1, 256, 14})                                   \
+      ->Unit(benchmark::kMicrosecond)
+
+KUIPER_BENCHMARK_ACTIVATION(ReluLayer);
+KUIPER_BENCHMARK_ACTIVATION(SigmoidLayer);
+KUIPER_BENCHMARK_ACTIVATION(SiLULayer);
+KUIPER_BENCHMARK_ACTIVATION(HardSwishLayer);
+KUIPER_BENCHMARK_ACTIVATION(HardSigmoid);
+KUIPER_BENCHMARK_ACTIVATION(SoftmaxLayer);
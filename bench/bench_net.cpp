@@ -3,6 +3,7 @@
 //
 #include <benchmark/benchmark.h>
 #include "runtime/runtime_ir.hpp"
+#include "runtime/inference_server.hpp"
 const int kIterationNum = 5;
 
 static void BM_Resnet18(benchmark::State &state) {
@@ -84,7 +85,31 @@ static void BM_Yolov5nano(benchmark::State &state) {
   }
 }
 
+static void BM_Resnet18_Server(benchmark::State &state) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch8.pnnx.param",
+                                                                       "tmp/resnet/resnet18_batch8.pnnx.bin");
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+  // 单个样本的请求在2ms内合并成最多8个一组的批次
+  InferenceServer server(graph, 8, 2000);
+
+  const uint32_t request_num = 8;
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(1.);
+  for (auto _ : state) {
+    std::vector<std::future<std::shared_ptr<Tensor<float>>>> futures;
+    for (int i = 0; i < request_num; ++i) {
+      futures.push_back(server.Submit(input));
+    }
+    for (auto &future : futures) {
+      future.wait();
+    }
+  }
+  state.counters["batches"] = server.batch_num();
+}
+
 BENCHMARK(BM_Resnet18)->Iterations(kIterationNum);
+BENCHMARK(BM_Resnet18_Server)->Iterations(kIterationNum);
 BENCHMARK(BM_Resnet18_Batch16)->Iterations(kIterationNum);
 BENCHMARK(BM_MobilenetV3)->Iterations(kIterationNum);
 BENCHMARK(BM_Yolov5nano)->Iterations(kIterationNum);
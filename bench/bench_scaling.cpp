@@ -0,0 +1,129 @@
+#include <benchmark/benchmark.h>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include "runtime/runtime_ir.hpp"
+#include "runtime/thread_pool.hpp"
+
+/// 批次大小的扫描范围，模型按照其中最大的批次Build一次，之后用较小的批次直接推理
+const std::vector<int64_t> kScalingBatchSizes = {1, 2, 4, 8, 16};
+const int kScalingIterationNum = 20;
+
+/**
+ * 加载并缓存模型，同一个模型在不同参数的测试之间只Build一次
+ * @param param_path 模型的结构文件
+ * @param bin_path 模型的权重文件
+ * @return Build之后的计算图
+ */
+static kuiper_infer::RuntimeGraph &LoadGraph(const std::string &param_path, const std::string &bin_path) {
+  using namespace kuiper_infer;
+  static std::map<std::string, std::unique_ptr<RuntimeGraph>> graphs;
+  std::unique_ptr<RuntimeGraph> &graph = graphs[param_path];
+  if (graph == nullptr) {
+    graph = std::make_unique<RuntimeGraph>(param_path, bin_path);
+    graph->set_max_batch_size(kScalingBatchSizes.back());
+    graph->Build("pnnx_input_0", "pnnx_output_0");
+  }
+  return *graph;
+}
+
+/**
+ * 返回排好序的延迟中给定百分位的值
+ * @param latencies 从小到大排列的延迟
+ * @param percentile 百分位，范围是[0, 100]
+ * @return 对应的延迟
+ */
+static double Percentile(const std::vector<double> &latencies, double percentile) {
+  CHECK(!latencies.empty());
+  const size_t index = std::min(latencies.size() - 1, size_t(percentile / 100. * double(latencies.size())));
+  return latencies.at(index);
+}
+
+/**
+ * 在给定的批次和线程数量下测试模型的延迟和吞吐，state.range(0)是批次，state.range(1)是线程数量
+ * 计数器中p50/p95/p99的单位是毫秒，efficiency是相对同一批次单线程吞吐的加速比除以线程数量
+ * 使用--benchmark_format=json或者csv输出机器可读的结果，建议同时设置OPENBLAS_NUM_THREADS=1避免和线程池争抢核心
+ */
+static void BM_Scaling(benchmark::State &state, const std::string &param_path, const std::string &bin_path,
+                       uint32_t channels, uint32_t rows, uint32_t cols) {
+  using namespace kuiper_infer;
+  const uint32_t batch_size = state.range(0);
+  const uint32_t thread_num = state.range(1);
+  RuntimeGraph &graph = LoadGraph(param_path, bin_path);
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(channels, rows, cols);
+    input->Fill(1.);
+    inputs.push_back(input);
+  }
+
+  ThreadPool &thread_pool = ThreadPool::GetInstance();
+  const uint32_t origin_thread_num = thread_pool.thread_num();
+  thread_pool.set_thread_num(thread_num);
+  // 预热一次，切换执行计划和首次分配内存不计入延迟
+  graph.Forward(inputs, false);
+
+  std::vector<double> latencies;
+  for (auto _ : state) {
+    const auto &start = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+    const double latency =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+    state.SetIterationTime(latency);
+    latencies.push_back(latency);
+  }
+  thread_pool.set_thread_num(origin_thread_num);
+
+  std::sort(latencies.begin(), latencies.end());
+  double total_latency = 0.;
+  for (const double latency : latencies) {
+    total_latency += latency;
+  }
+  const double images_per_second = double(batch_size) * double(latencies.size()) / total_latency;
+
+  // 同一个模型和批次下单线程的吞吐，线程数量从1开始扫描，后续的测试据此计算扩展效率
+  static std::map<std::tuple<std::string, uint32_t>, double> single_thread_throughputs;
+  const auto &key = std::make_tuple(param_path, batch_size);
+  if (thread_num == 1) {
+    single_thread_throughputs[key] = images_per_second;
+  }
+  const auto &single_thread = single_thread_throughputs.find(key);
+  if (single_thread != single_thread_throughputs.end()) {
+    state.counters["efficiency"] = images_per_second / (single_thread->second * thread_num);
+  }
+  state.counters["p50_ms"] = Percentile(latencies, 50.) * 1e3;
+  state.counters["p95_ms"] = Percentile(latencies, 95.) * 1e3;
+  state.counters["p99_ms"] = Percentile(latencies, 99.) * 1e3;
+  state.counters["images/s"] = images_per_second;
+}
+
+/**
+ * 生成批次和线程数量的组合，线程数量按2的幂增长到硬件的并发数量
+ * @param benchmark 需要设置参数的测试
+ */
+static void ScalingArguments(benchmark::internal::Benchmark *benchmark) {
+  const uint32_t max_thread_num = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int64_t> thread_nums;
+  for (uint32_t thread_num = 1; thread_num < max_thread_num; thread_num *= 2) {
+    thread_nums.push_back(thread_num);
+  }
+  thread_nums.push_back(max_thread_num);
+
+  benchmark->ArgNames({"batch", "threads"});
+  for (const int64_t batch_size : kScalingBatchSizes) {
+    for (const int64_t thread_num : thread_nums) {
+      benchmark->Args({batch_size, thread_num});
+    }
+  }
+  benchmark->Iterations(kScalingIterationNum)->UseManualTime()->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_CAPTURE(BM_Scaling, resnet18, std::string("tmp/resnet/resnet18_batch8.pnnx.param"),
+                  std::string("tmp/resnet/resnet18_batch8.pnnx.bin"), 3, 224, 224)->Apply(ScalingArguments);
+BENCHMARK_CAPTURE(BM_Scaling, mobilenet_v3, std::string("tmp/mobilenet/mobile_batch8.pnnx.param"),
+                  std::string("tmp/mobilenet/mobile_batch8.bin"), 3, 224, 224)->Apply(ScalingArguments);
+BENCHMARK_CAPTURE(BM_Scaling, yolov5n, std::string("tmp/yolo/yolov5n_small.pnnx.param"),
+                  std::string("tmp/yolo/yolov5n_small.pnnx.bin"), 3, 320, 320)->Apply(ScalingArguments);
@@ -3,12 +3,16 @@
 //
 
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 #include <opencv2/opencv.hpp>
 #include <glog/logging.h>
 
 #include "data/tensor.hpp"
+#include "data/image.hpp"
 #include "image_util.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "runtime/video_pipeline.hpp"
 #include "tick.hpp"
 
 void SingleImageYoloInferNano(const std::string &image_path,
@@ -24,6 +28,17 @@ void SingleImageYoloInferNano(const std::string &image_path,
   const int32_t input_w = 640;
 
   RuntimeGraph graph(param_path, weight_path);
+  // 检测头直接输出置信度过滤和非极大值抑制之后的检测框
+  DetectionPostProcess post_process;
+  post_process.enabled = true;
+  post_process.conf_thresh = conf_thresh;
+  post_process.iou_thresh = iou_thresh;
+  graph.set_detection_post_process(post_process);
+  // 有可用的显卡时卷积等节点和图片预处理都在设备上执行
+  const bool use_cuda = DeviceAvailable(DeviceType::kDeviceCUDA);
+  if (use_cuda) {
+    graph.set_device(DeviceType::kDeviceCUDA);
+  }
 
   graph.Build("pnnx_input_0", "pnnx_output_0");
 
@@ -32,34 +47,24 @@ void SingleImageYoloInferNano(const std::string &image_path,
   const int32_t origin_input_h = image.size().height;
   const int32_t origin_input_w = image.size().width;
 
-  int stride = 32;
-  cv::Mat out_image;
-  Letterbox(image, out_image, {input_h, input_w}, stride, {114, 114, 114}, true);
-
-  cv::Mat rgb_image;
-  cv::cvtColor(out_image, rgb_image, cv::COLOR_BGR2RGB);
-
-  cv::Mat normalize_image;
-  rgb_image.convertTo(normalize_image, CV_32FC3, 1. / 255.);
-
-  std::vector<cv::Mat> split_images;
-  cv::split(normalize_image, split_images);
-  assert(split_images.size() == input_c);
+  // letterbox、BGR转RGB、归一化和按通道重排在一次遍历中完成，直接写入输入张量，在设备上时写入设备内存
+  ImageView image_view;
+  image_view.data = image.data;
+  image_view.height = origin_input_h;
+  image_view.width = origin_input_w;
+  image_view.channels = image.channels();
+  image_view.step = image.step;
+  ImagePreprocessParam preprocess_param;
+  preprocess_param.target_height = input_h;
+  preprocess_param.target_width = input_w;
 
   std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(input_c, input_h, input_w);
-  input->Fill(0.f);
-  std::vector<std::shared_ptr<Tensor<float>>> inputs;
-
-  int index = 0;
-  int offset = 0;
-  for (const auto &split_image : split_images) {
-    assert(split_image.total() == input_w * input_h);
-    const cv::Mat &split_image_t = split_image.t();
-    memcpy(input->at(index).memptr(), split_image_t.data, sizeof(float) * split_image.total());
-    index += 1;
-    offset += split_image.total();
+  if (use_cuda) {
+    PreprocessImagesCuda({image_view}, preprocess_param, {input});
+  } else {
+    PreprocessImage(image_view, preprocess_param, input->data().memptr());
   }
-
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
   inputs.push_back(input);
 
   TICK(FORWARD)
@@ -75,51 +80,29 @@ void SingleImageYoloInferNano(const std::string &image_path,
   const uint32_t batch = shapes.at(0);
   assert(batch == 1);
   const uint32_t elements = shapes.at(1);
-  const uint32_t num_info = shapes.at(2);
+  assert(shapes.at(2) == 6);
   std::vector<Detection> detections;
 
-  std::vector<cv::Rect> boxes;
-  std::vector<float> confs;
-  std::vector<int> class_ids;
-
+  // 每行是x1、y1、x2、y2、得分和类别，检测框按照得分从高到低排列，类别为-1的行之后没有检测框
   const uint32_t b = 0;
   for (uint32_t i = 0; i < elements; ++i) {
-    float cls_conf = output->at(b, i, 4);
-    if (cls_conf >= conf_thresh) {
-      int center_x = (int) (output->at(b, i, 0));
-      int center_y = (int) (output->at(b, i, 1));
-      int width = (int) (output->at(b, i, 2));
-      int height = (int) (output->at(b, i, 3));
-      int left = center_x - width / 2;
-      int top = center_y - height / 2;
-
-      int best_class_id = -1;
-      float best_conf = -1.f;
-      for (uint32_t j = 5; j < num_info; ++j) {
-        if (output->at(b, i, j) > best_conf) {
-          best_conf = output->at(b, i, j);
-          best_class_id = int(j - 5);
-        }
-      }
-
-      boxes.emplace_back(left, top, width, height);
-      confs.emplace_back(best_conf * cls_conf);
-      class_ids.emplace_back(best_class_id);
+    const int class_id = int(output->at(b, i, 5));
+    if (class_id < 0) {
+      break;
     }
-  }
-
-  std::vector<int> indices;
-  cv::dnn::NMSBoxes(boxes, confs, conf_thresh, iou_thresh, indices);
+    const int left = int(output->at(b, i, 0));
+    const int top = int(output->at(b, i, 1));
+    const int right = int(output->at(b, i, 2));
+    const int bottom = int(output->at(b, i, 3));
 
-  for (int idx : indices) {
     Detection det;
-    det.box = cv::Rect(boxes[idx]);
+    det.box = cv::Rect(left, top, right - left, bottom - top);
     ScaleCoords(cv::Size{input_w, input_h},
                 det.box,
                 cv::Size{origin_input_w, origin_input_h});
 
-    det.conf = confs[idx];
-    det.class_id = class_ids[idx];
+    det.conf = output->at(b, i, 4);
+    det.class_id = class_id;
     detections.emplace_back(det);
   }
 
@@ -134,10 +117,79 @@ void SingleImageYoloInferNano(const std::string &image_path,
   cv::imwrite("output.jpg", image);
 }
 
-int main() {
-  const std::string &image_path = "imgs/25.jpg";
+void VideoYoloInfer(const std::string &video_path,
+                    const std::string &param_path,
+                    const std::string &weight_path,
+                    const float conf_thresh = 0.25f,
+                    const float iou_thresh = 0.25f) {
+  using namespace kuiper_infer;
+  // 视频文件路径是一个数字时打开对应编号的摄像头
+  cv::VideoCapture capture;
+  const bool is_camera = !video_path.empty() && std::all_of(video_path.begin(), video_path.end(), ::isdigit);
+  if (is_camera) {
+    capture.open(std::stoi(video_path));
+  } else {
+    capture.open(video_path);
+  }
+  if (!capture.isOpened()) {
+    LOG(ERROR) << "Can not open the video: " << video_path;
+    return;
+  }
+
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>(param_path, weight_path);
+  DetectionPostProcess post_process;
+  post_process.enabled = true;
+  post_process.conf_thresh = conf_thresh;
+  post_process.iou_thresh = iou_thresh;
+  graph->set_detection_post_process(post_process);
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  cv::VideoWriter writer;
+  VideoSource source = [&capture](VideoFrame &frame) {
+    std::shared_ptr<cv::Mat> image = std::make_shared<cv::Mat>();
+    if (!capture.read(*image) || image->empty()) {
+      return false;
+    }
+    frame.image.data = image->data;
+    frame.image.height = image->rows;
+    frame.image.width = image->cols;
+    frame.image.channels = image->channels();
+    frame.image.step = image->step;
+    frame.holder = image;
+    return true;
+  };
+  VideoSink sink = [&writer](VideoResult &result) {
+    cv::Mat &image = *std::static_pointer_cast<cv::Mat>(result.frame.holder);
+    for (const auto &detection : result.detections) {
+      const cv::Rect box(cv::Point(int(detection.x1), int(detection.y1)),
+                         cv::Point(int(detection.x2), int(detection.y2)));
+      cv::rectangle(image, box, cv::Scalar(255, 255, 255), 2);
+      cv::putText(image, std::to_string(detection.class_id), box.tl(), cv::FONT_HERSHEY_COMPLEX, 1,
+                  cv::Scalar(255, 255, 0), 2);
+    }
+    if (!writer.isOpened()) {
+      writer.open("output.avi", cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 25, image.size());
+    }
+    writer.write(image);
+  };
+
+  // 摄像头的帧来不及处理时直接丢弃，视频文件的每一帧都需要检测
+  VideoPipelineOptions options;
+  options.drop_frames = is_camera;
+  VideoPipeline pipeline(graph, source, sink, options);
+  pipeline.Wait();
+  LOG(INFO) << "Video pipeline statistics:\n" << pipeline.stats().ToString();
+}
+
+int main(int argc, char *argv[]) {
   const std::string &param_path = "tmp/yolo/demo/yolov5s.pnnx.param";
   const std::string &weight_path = "tmp/yolo/demo/yolov5s.pnnx.bin";
+  // 给出视频文件或者摄像头编号时检测视频流，否则检测一张图片
+  if (argc > 1) {
+    VideoYoloInfer(argv[1], param_path, weight_path);
+    return 0;
+  }
+  const std::string &image_path = "imgs/25.jpg";
   SingleImageYoloInferNano(image_path, param_path, weight_path);
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_DEVICE_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_DEVICE_HPP_
+#include <cstddef>
+#include <memory>
+
+namespace kuiper_infer {
+/// 张量数据所在以及计算节点执行的设备
+enum class DeviceType {
+  kDeviceCPU = 0,
+  kDeviceCUDA = 1,
+};
+
+/**
+ * 返回设备是否可以使用，CUDA需要编译时开启USE_CUDA并且运行时有可用的显卡
+ * @param device 设备
+ * @return 是否可以使用
+ */
+bool DeviceAvailable(DeviceType device);
+
+/**
+ * 等待设备上已经提交的计算全部完成，CPU上直接返回
+ * @param device 设备
+ */
+void SynchronizeDevice(DeviceType device);
+
+/**
+ * 在当前线程的流上把主机内存复制到设备内存，主机内存是页锁定内存时不等待复制完成
+ * @param host 主机内存的起始地址
+ * @param device 设备内存的起始地址
+ * @param size float元素数量
+ */
+void CopyHostToDevice(const float *host, float *device, size_t size);
+
+/**
+ * 在当前线程的流上按照字节把主机内存复制到设备内存，用于上传图片等不是float的数据
+ * @param host 主机内存的起始地址
+ * @param device 设备内存的起始地址
+ * @param bytes 字节数
+ */
+void CopyBytesHostToDevice(const void *host, void *device, size_t bytes);
+
+/**
+ * 在当前线程的流上把设备内存复制到主机内存，主机内存是页锁定内存时不等待复制完成，读取之前需要等待流完成
+ * @param device 设备内存的起始地址
+ * @param host 主机内存的起始地址
+ * @param size float元素数量
+ */
+void CopyDeviceToHost(const float *device, float *host, size_t size);
+
+/// CUDA设备上的一个执行流，同一个流上的内核和复制按照提交顺序执行，不同的流之间可以重叠
+/// 每个执行上下文使用自己的流，一个上下文复制输入的同时另一个上下文的内核可以继续计算
+class DeviceStream {
+ public:
+  /**
+   * 创建一个不和默认流同步的执行流，需要编译时开启USE_CUDA
+   */
+  DeviceStream();
+
+  ~DeviceStream();
+
+  DeviceStream(const DeviceStream &) = delete;
+
+  DeviceStream &operator=(const DeviceStream &) = delete;
+
+  /**
+   * 等待流上已经提交的内核和复制全部完成
+   */
+  void Synchronize() const;
+
+  /**
+   * 返回流的句柄，即cudaStream_t
+   * @return 流的句柄
+   */
+  void *handle() const;
+
+  /**
+   * 返回当前线程提交内核和复制使用的流，在Scope的作用域内返回指定的流，否则为空，表示默认流
+   * @return 流的句柄
+   */
+  static void *Current();
+
+  /**
+   * 在当前线程上等待当前使用的流完成，没有指定流时等待整个设备
+   */
+  static void SynchronizeCurrent();
+
+  /// 在作用域内指定当前线程使用的流，析构时恢复之前的流
+  class Scope {
+   public:
+    /**
+     * 指定当前线程使用的流
+     * @param stream 执行流，为空时不做任何处理
+     */
+    explicit Scope(const DeviceStream *stream);
+
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    bool bound_ = false; /// 是否修改了当前线程的流
+    void *prev_stream_ = nullptr; /// 之前指定的流
+  };
+
+ private:
+  void *stream_ = nullptr; /// 流的句柄
+};
+
+/// CUDA设备上的一块内存，析构时释放，不能复制
+/// 也可以是另一块设备内存中的一段，此时持有原来的内存并且不能扩大
+class DeviceBuffer {
+ public:
+  DeviceBuffer() = default;
+
+  ~DeviceBuffer();
+
+  DeviceBuffer(const DeviceBuffer &) = delete;
+
+  DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+  /**
+   * 返回另一块设备内存中的一段，内存规划时多个张量按照偏移量共享同一块设备内存
+   * @param base 原来的设备内存
+   * @param offset 这一段的起点，单位是float元素
+   * @param size 这一段的float元素数量，不能越过原来内存的末尾
+   * @return 指向这一段的设备内存
+   */
+  static std::shared_ptr<DeviceBuffer> View(const std::shared_ptr<DeviceBuffer> &base, size_t offset, size_t size);
+
+  /**
+   * 保证内存至少能容纳size个float元素，不够时重新分配，原有的数据不保留
+   * @param size float元素数量
+   */
+  void Reserve(size_t size);
+
+  /**
+   * 在当前线程的流上将主机内存中的数据复制到设备内存的开头，内存不够时先重新分配
+   * 主机内存是页锁定内存时复制异步进行，流完成之前不能改写主机内存，普通内存的复制返回时已经读取完成
+   * @param host 主机内存的起始地址
+   * @param size float元素数量
+   */
+  void CopyFromHost(const float *host, size_t size);
+
+  /**
+   * 在当前线程的流上将设备内存开头的数据复制到主机内存，等待复制完成后返回
+   * @param host 主机内存的起始地址
+   * @param size float元素数量，不能超过设备内存的大小
+   */
+  void CopyToHost(float *host, size_t size) const;
+
+  /**
+   * 在当前线程的流上将设备内存开头的数据复制到页锁定的主机内存，不等待复制完成
+   * @param host 页锁定主机内存的起始地址
+   * @param size float元素数量，不能超过设备内存的大小
+   */
+  void CopyToHostAsync(float *host, size_t size) const;
+
+  /**
+   * 返回设备内存的起始地址
+   * @return 起始地址，没有分配时为空
+   */
+  float *data() const;
+
+  /**
+   * 返回设备内存能容纳的float元素数量
+   * @return 元素数量
+   */
+  size_t size() const;
+
+ private:
+  float *data_ = nullptr; /// 设备内存的起始地址
+  size_t size_ = 0; /// 设备内存能容纳的float元素数量
+  std::shared_ptr<DeviceBuffer> base_; /// 这一段所在的原来的设备内存，自己分配时为空
+};
+
+/// 主机上的页锁定内存，设备可以直接通过DMA读写，用于计算图输入和输出的异步复制，不能复制
+class PinnedBuffer {
+ public:
+  PinnedBuffer() = default;
+
+  ~PinnedBuffer();
+
+  PinnedBuffer(const PinnedBuffer &) = delete;
+
+  PinnedBuffer &operator=(const PinnedBuffer &) = delete;
+
+  /**
+   * 保证内存至少能容纳size个float元素，不够时重新分配，原有的数据不保留
+   * @param size float元素数量
+   */
+  void Reserve(size_t size);
+
+  /**
+   * 返回页锁定内存的起始地址
+   * @return 起始地址，没有分配时为空
+   */
+  float *data() const;
+
+  /**
+   * 返回页锁定内存能容纳的float元素数量
+   * @return 元素数量
+   */
+  size_t size() const;
+
+ private:
+  float *data_ = nullptr; /// 页锁定内存的起始地址
+  size_t size_ = 0; /// 页锁定内存能容纳的float元素数量
+};
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_DEVICE_HPP_
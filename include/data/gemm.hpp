@@ -0,0 +1,168 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_GEMM_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_GEMM_HPP_
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "layer/abstract/activation.hpp"
+#include "runtime/cpu_feature.hpp"
+
+namespace kuiper_infer {
+/// 矩阵乘法的实现，编译时由GEMM_BACKEND选择链接的BLAS，内置实现总是可用
+enum class GemmBackend {
+  kBlas = 0, /// 链接的通用BLAS，无法控制线程数
+  kOpenBLAS = 1,
+  kMKL = 2,
+  kBLIS = 3,
+  kBuiltin = 4, /// 内置的分块实现，不依赖BLAS，在调用线程中计算
+};
+
+/// 矩阵乘法的尾部计算，结果在写回c时加上偏置和残差并计算激活函数，c = act(c + row_bias + col_bias + residual)
+struct GemmEpilogue {
+  const float *row_bias = nullptr; /// 每一行的偏置，为空时不加
+  const float *col_bias = nullptr; /// 每一列的偏置，为空时不加
+  const float *residual = nullptr; /// 和c形状相同的残差矩阵，按列优先排列，为空时不加
+  uint32_t ldr = 0; /// 残差矩阵相邻两列之间的距离
+  ActivationType activation = ActivationType::kActivationNone;
+};
+
+/// 按照内置实现的面板格式打包的矩阵，权重只需要打包一次，之后的每次计算直接读取
+struct GemmPackedMatrix {
+  bool left = true; /// 作为左矩阵a按行面板打包，否则作为右矩阵b按列面板打包
+  uint32_t rows = 0; /// op之后的行数
+  uint32_t cols = 0; /// op之后的列数
+  uint32_t panel = 0; /// 面板的宽度，只计算一部分行或者列时起点需要是它的倍数
+  CpuIsa isa = CpuIsa::kScalar; /// 打包时使用的内核级别，面板宽度随级别变化，计算时使用同一个级别
+  std::vector<float> data; /// 按公共维度分块，每块中依次存放所有的面板
+  std::shared_ptr<const float> shared_data; /// 多个计算图和进程共享的只读内存中同样的数据，存在时代替data
+  size_t shared_size = 0; /// shared_data中float元素的数量
+
+  bool empty() const;
+
+  /**
+   * 返回打包数据的起始地址，数据可能保存在data中或者共享的只读内存中
+   * @return 打包数据的起始地址
+   */
+  const float *packed_data() const;
+
+  /**
+   * 返回打包数据的float元素数量
+   * @return 元素数量
+   */
+  size_t packed_size() const;
+};
+
+/**
+ * 计算c = act(alpha * op(a) * op(b) + beta * c + bias)，所有矩阵按列优先排列，矩阵可以是外部内存或者更大的矩阵中的一块
+ * @param transpose_a 是否转置a
+ * @param transpose_b 是否转置b
+ * @param m op(a)和c的行数
+ * @param n op(b)和c的列数
+ * @param k op(a)的列数和op(b)的行数
+ * @param alpha 乘积的系数
+ * @param a 矩阵a的起始地址
+ * @param lda 矩阵a相邻两列之间的距离
+ * @param b 矩阵b的起始地址
+ * @param ldb 矩阵b相邻两列之间的距离
+ * @param beta c原有值的系数，为0时不读取c原有的值
+ * @param c 矩阵c的起始地址
+ * @param ldc 矩阵c相邻两列之间的距离
+ * @param epilogue 写回c时的偏置和激活函数
+ */
+void Gemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, float alpha, const float *a,
+          uint32_t lda, const float *b, uint32_t ldb, float beta, float *c, uint32_t ldc,
+          const GemmEpilogue &epilogue = GemmEpilogue());
+
+/**
+ * 将左矩阵op(a)打包为内置实现使用的格式
+ * @param transpose 是否转置a
+ * @param m op(a)的行数
+ * @param k op(a)的列数
+ * @param a 矩阵a的起始地址
+ * @param lda 矩阵a相邻两列之间的距离
+ * @return 打包之后的矩阵
+ */
+GemmPackedMatrix GemmPackA(bool transpose, uint32_t m, uint32_t k, const float *a, uint32_t lda);
+
+/**
+ * 将右矩阵op(b)打包为内置实现使用的格式
+ * @param transpose 是否转置b
+ * @param k op(b)的行数
+ * @param n op(b)的列数
+ * @param b 矩阵b的起始地址
+ * @param ldb 矩阵b相邻两列之间的距离
+ * @return 打包之后的矩阵
+ */
+GemmPackedMatrix GemmPackB(bool transpose, uint32_t k, uint32_t n, const float *b, uint32_t ldb);
+
+/**
+ * 用打包的左矩阵中从row_begin开始的m行计算c = act(a * op(b) + bias)，总是使用内置实现
+ * @param a 打包的左矩阵
+ * @param row_begin 起始行，需要是面板宽度的倍数
+ * @param m 计算的行数
+ * @param transpose_b 是否转置b
+ * @param n op(b)和c的列数
+ * @param b 矩阵b的起始地址
+ * @param ldb 矩阵b相邻两列之间的距离
+ * @param c 矩阵c的起始地址，对应a的第row_begin行
+ * @param ldc 矩阵c相邻两列之间的距离
+ * @param epilogue 写回c时的偏置和激活函数，行偏置同样从第row_begin行开始
+ */
+void GemmPackedA(const GemmPackedMatrix &a, uint32_t row_begin, uint32_t m, bool transpose_b, uint32_t n,
+                 const float *b, uint32_t ldb, float *c, uint32_t ldc, const GemmEpilogue &epilogue = GemmEpilogue());
+
+/**
+ * 用打包的右矩阵中从col_begin开始的n列计算c = act(op(a) * b + bias)，总是使用内置实现
+ * @param transpose_a 是否转置a
+ * @param m op(a)和c的行数
+ * @param a 矩阵a的起始地址
+ * @param lda 矩阵a相邻两列之间的距离
+ * @param b 打包的右矩阵
+ * @param col_begin 起始列，需要是面板宽度的倍数
+ * @param n 计算的列数
+ * @param c 矩阵c的起始地址，对应b的第col_begin列
+ * @param ldc 矩阵c相邻两列之间的距离
+ * @param epilogue 写回c时的偏置和激活函数，列偏置同样从第col_begin列开始
+ */
+void GemmPackedB(bool transpose_a, uint32_t m, const float *a, uint32_t lda, const GemmPackedMatrix &b,
+                 uint32_t col_begin, uint32_t n, float *c, uint32_t ldc, const GemmEpilogue &epilogue = GemmEpilogue());
+
+/**
+ * 返回编译时选择的BLAS
+ * @return 编译时选择的实现，没有链接BLAS时为kBuiltin
+ */
+GemmBackend CompiledGemmBackend();
+
+/**
+ * 切换之后的矩阵乘法使用的实现，只能在编译时选择的BLAS和内置实现之间切换
+ * @param backend 使用的实现
+ * @return 是否切换成功
+ */
+bool SetGemmBackend(GemmBackend backend);
+
+/**
+ * 返回当前矩阵乘法使用的实现
+ * @return 当前的实现
+ */
+GemmBackend CurrentGemmBackend();
+
+/**
+ * 返回实现的名称
+ * @param backend 矩阵乘法的实现
+ * @return 实现的名称
+ */
+const char *GemmBackendName(GemmBackend backend);
+
+/**
+ * 设置BLAS内部使用的线程数，Layer已经在线程池中切分矩阵乘法，默认让BLAS只使用1个线程，避免两边的线程互相争抢
+ * @param thread_num BLAS使用的线程数，至少为1
+ * @return 编译时选择的BLAS是否支持设置线程数
+ */
+bool SetGemmThreadNum(uint32_t thread_num);
+
+/**
+ * 返回BLAS内部使用的线程数
+ * @return BLAS使用的线程数，内置实现为1，无法控制线程数的通用BLAS为0
+ */
+uint32_t GemmThreadNum();
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_GEMM_HPP_
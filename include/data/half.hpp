@@ -0,0 +1,66 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_HALF_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_HALF_HPP_
+#include <cstdint>
+
+namespace kuiper_infer {
+/**
+ * 将一个IEEE半精度数转换为float
+ * @param value 半精度数的编码
+ * @return 转换之后的float
+ */
+float HalfToFloat(uint16_t value);
+
+/**
+ * 将一个float舍入到最近的IEEE半精度数，超出范围时为无穷大
+ * @param value 原始的float
+ * @return 半精度数的编码
+ */
+uint16_t FloatToHalf(float value);
+
+/**
+ * 将一个bfloat16转换为float，bfloat16就是float的高16位
+ * @param value bfloat16的编码
+ * @return 转换之后的float
+ */
+float BFloat16ToFloat(uint16_t value);
+
+/**
+ * 将一个float舍入到最近的bfloat16
+ * @param value 原始的float
+ * @return bfloat16的编码
+ */
+uint16_t FloatToBFloat16(float value);
+
+/**
+ * 批量将半精度数转换为float，支持F16C时使用向量指令
+ * @param input 半精度数的编码
+ * @param size 元素数量
+ * @param output 转换之后的float
+ */
+void HalfToFloat(const uint16_t *input, uint32_t size, float *output);
+
+/**
+ * 批量将float舍入到半精度数
+ * @param input 原始的float
+ * @param size 元素数量
+ * @param output 半精度数的编码
+ */
+void FloatToHalf(const float *input, uint32_t size, uint16_t *output);
+
+/**
+ * 批量将bfloat16转换为float
+ * @param input bfloat16的编码
+ * @param size 元素数量
+ * @param output 转换之后的float
+ */
+void BFloat16ToFloat(const uint16_t *input, uint32_t size, float *output);
+
+/**
+ * 批量将float舍入到bfloat16，支持AVX512-BF16时使用向量指令
+ * @param input 原始的float
+ * @param size 元素数量
+ * @param output bfloat16的编码
+ */
+void FloatToBFloat16(const float *input, uint32_t size, uint16_t *output);
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_HALF_HPP_
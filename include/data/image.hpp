@@ -0,0 +1,73 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_IMAGE_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_IMAGE_HPP_
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+/// 按行存放、通道交错的8位图片，例如OpenCV读取的BGR图片，预处理时直接读取不复制
+struct ImageView {
+  const uint8_t *data = nullptr; /// 第一行的起始地址
+  uint32_t height = 0; /// 图片的高度
+  uint32_t width = 0; /// 图片的宽度
+  uint32_t channels = 3; /// 每个像素的通道数量，至少为3，只使用前三个通道
+  size_t step = 0; /// 相邻两行之间的字节数，为0时按照width * channels紧密排列
+};
+
+/// 图片预处理的参数，每个输出通道计算output = pixel * scale + shift
+struct ImagePreprocessParam {
+  uint32_t target_height = 640; /// 输出的高度
+  uint32_t target_width = 640; /// 输出的宽度
+  bool letterbox = true; /// 保持宽高比缩放后居中并在四周填充，为false时直接拉伸到输出大小
+  bool scale_up = true; /// letterbox时是否允许放大图片
+  uint8_t pad_value = 114; /// 填充区域的像素值
+  bool swap_rb = true; /// 是否交换第一个和第三个通道，例如BGR转为RGB
+  float scale[3] = {1.f / 255.f, 1.f / 255.f, 1.f / 255.f}; /// 每个输出通道的缩放
+  float shift[3] = {0.f, 0.f, 0.f}; /// 每个输出通道缩放之后的偏移，按照均值和标准差归一化时为-mean / std
+};
+
+/// 预处理时图片的缩放比例和填充大小，用于把输出上的坐标映射回原图
+struct LetterboxInfo {
+  float scale_x = 1.f; /// 缩放后的宽度和原图宽度的比例
+  float scale_y = 1.f; /// 缩放后的高度和原图高度的比例
+  uint32_t pad_left = 0; /// 左侧填充的列数
+  uint32_t pad_top = 0; /// 上方填充的行数
+};
+
+/**
+ * 对一张图片做letterbox缩放、通道交换、归一化，并按照通道分开写入输出，整个过程只读取一次原图
+ * 输出和Tensor<float>(3, target_height, target_width)的内存布局相同，可以直接写入计算图绑定的输入内存
+ * 缩放使用双线性插值，像素中心对齐，和OpenCV的INTER_LINEAR一致
+ * @param image 输入图片
+ * @param param 预处理参数
+ * @param output 输出的起始地址，至少能容纳3 * target_height * target_width个元素
+ * @return 缩放比例和填充大小
+ */
+LetterboxInfo PreprocessImage(const ImageView &image, const ImagePreprocessParam &param, float *output);
+
+/**
+ * 在当前线程池中并行预处理一批图片，每张图片的输出依次紧密排列，可以作为一个批次的输入
+ * @param images 输入图片，大小可以各不相同
+ * @param param 预处理参数
+ * @param output 输出的起始地址，至少能容纳images.size() * 3 * target_height * target_width个元素
+ * @return 每张图片的缩放比例和填充大小
+ */
+std::vector<LetterboxInfo> PreprocessImages(const std::vector<ImageView> &images, const ImagePreprocessParam &param,
+                                            float *output);
+
+/**
+ * 在CUDA设备上预处理一批图片，结果和PreprocessImages相同，直接写入每个输出张量在设备上的内存
+ * 原图按照8位像素上传，CPU不再逐像素计算，输出张量标记为在设备上，作为计算图的输入时不会再复制
+ * 内核在当前线程的流上执行，返回前等待完成，之后可以改写原图，其他流上的节点也可以读取输出
+ * @param images 输入图片，位于页锁定内存中时上传更快
+ * @param param 预处理参数
+ * @param outputs 每张图片的输出张量，形状是(3, target_height, target_width)
+ * @return 每张图片的缩放比例和填充大小
+ */
+std::vector<LetterboxInfo> PreprocessImagesCuda(const std::vector<ImageView> &images,
+                                                const ImagePreprocessParam &param,
+                                                const std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_IMAGE_HPP_
@@ -4,27 +4,70 @@
 
 #ifndef KUIPER_COURSE_INCLUDE_DATA_LOAD_DATA_HPP_
 #define KUIPER_COURSE_INCLUDE_DATA_LOAD_DATA_HPP_
-#include <armadillo>
+#include "data/tensor_allocator.hpp"
+#include <memory>
 #include <string>
+#include "data/tensor.hpp"
 namespace kuiper_infer {
 
 class CSVDataLoader {
  public:
   /**
    * 从csv文件中初始化张量
+   * 文件映射到内存后按行并行解析，遇到空行结束，缺少的元素填充0，无法解析的元素被跳过
    * @param file_path csv文件的路径
    * @param split_char 分隔符号
    * @return 根据csv文件得到的张量
    */
   static arma::fmat LoadData(const std::string &file_path, char split_char = ',');
- private:
+
+  /**
+   * 从csv文件中初始化一个单通道的张量，解析规则和LoadData相同，数据直接写入张量不再复制
+   * @param file_path csv文件的路径
+   * @param split_char 分隔符号
+   * @return 形状为(1, 行数, 列数)的张量
+   */
+  static std::shared_ptr<Tensor<float>> LoadTensor(const std::string &file_path, char split_char = ',');
+};
+
+/// 二进制张量文件的读写，不需要解析文本，用于测试数据和标定数据
+/// npy文件和numpy兼容，只支持小端的float32；raw文件没有文件头，按照张量在内存中的布局保存
+class BinaryDataLoader {
+ public:
+  /**
+   * 读取numpy保存的npy文件，1维的(K)对应张量(1, 1, K)，2维的(H, W)对应(1, H, W)，3维的(C, H, W)对应(C, H, W)，
+   * 更高维时最前面的维度必须是1
+   * @param file_path npy文件的路径
+   * @return 读取得到的张量
+   */
+  static std::shared_ptr<Tensor<float>> LoadNpy(const std::string &file_path);
+
+  /**
+   * 将张量按照实际的形状保存为npy文件，numpy.load可以直接读取
+   * @param file_path npy文件的路径
+   * @param tensor 保存的张量
+   * @return 是否保存成功
+   */
+  static bool SaveNpy(const std::string &file_path, const Tensor<float> &tensor);
+
+  /**
+   * 读取SaveRaw保存的文件，文件内容直接读入张量的内存
+   * @param file_path 文件的路径
+   * @param channels 张量的通道数
+   * @param rows 张量的行数
+   * @param cols 张量的列数
+   * @return 读取得到的张量
+   */
+  static std::shared_ptr<Tensor<float>> LoadRaw(const std::string &file_path, uint32_t channels, uint32_t rows,
+                                                uint32_t cols);
+
   /**
-   * 得到csv文件的尺寸大小
-   * @param file csv文件的路径
-   * @param split_char 分割符号
-   * @return 根据csv文件的尺寸大小
+   * 将张量的内存原样写入文件，每个通道按列存储，读取时需要给出相同的形状
+   * @param file_path 文件的路径
+   * @param tensor 保存的张量
+   * @return 是否保存成功
    */
-  static std::pair<size_t, size_t> GetMatrixSize(std::ifstream &file, char split_char);
+  static bool SaveRaw(const std::string &file_path, const Tensor<float> &tensor);
 };
 }
 
@@ -0,0 +1,77 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_MEMORY_TRACKER_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_MEMORY_TRACKER_HPP_
+#include <atomic>
+#include <cstddef>
+
+namespace kuiper_infer {
+/// 全局的内存统计，记录张量和执行计划自己持有的内存，建立在外部内存上的张量不计入
+class MemoryTracker {
+ public:
+  /**
+   * 返回全局的内存统计
+   * @return 全局的内存统计
+   */
+  static MemoryTracker &GetInstance();
+
+  /**
+   * 记录一次内存分配，并更新峰值
+   * @param bytes 分配的字节数
+   */
+  void Allocate(size_t bytes);
+
+  /**
+   * 记录一次内存释放
+   * @param bytes 释放的字节数
+   */
+  void Release(size_t bytes);
+
+  /**
+   * 返回当前持有的字节数
+   * @return 当前的字节数
+   */
+  size_t current_bytes() const;
+
+  /**
+   * 返回从创建或者上次ResetPeak以来的峰值字节数
+   * @return 峰值字节数
+   */
+  size_t peak_bytes() const;
+
+  /**
+   * 将峰值重置为当前持有的字节数，用于统计某一段时间内的峰值
+   */
+  void ResetPeak();
+
+ private:
+  std::atomic<size_t> current_bytes_{0};
+  std::atomic<size_t> peak_bytes_{0};
+};
+
+/// 一块被统计的内存的大小，拷贝时按照拷贝出的新内存计入统计，析构时从统计中释放
+class TrackedAllocation {
+ public:
+  TrackedAllocation() = default;
+
+  TrackedAllocation(const TrackedAllocation &allocation);
+
+  TrackedAllocation &operator=(const TrackedAllocation &allocation);
+
+  ~TrackedAllocation();
+
+  /**
+   * 持有的内存大小发生变化时更新统计
+   * @param bytes 新的字节数
+   */
+  void Reset(size_t bytes);
+
+  /**
+   * 返回持有的字节数
+   * @return 持有的字节数
+   */
+  size_t bytes() const;
+
+ private:
+  size_t bytes_ = 0;
+};
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_MEMORY_TRACKER_HPP_
@@ -0,0 +1,115 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_QUANTIZE_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_QUANTIZE_HPP_
+#include <vector>
+#include <cstdint>
+#include "data/tensor_allocator.hpp"
+
+namespace kuiper_infer {
+/// 按行对称量化的INT8矩阵，每一行是一个输出通道的权重，量化值的范围是[-127,127]
+struct QuantizedMatrix {
+  uint32_t rows = 0; /// 矩阵的行数
+  uint32_t cols = 0; /// 矩阵的列数
+  uint32_t stride = 0; /// 每一行占用的元素数量，补0到向量宽度的整数倍
+  std::vector<int8_t> data; /// 按行优先排列的量化值
+  std::vector<float> scales; /// 每一行的量化系数，原始值约等于量化值乘以系数
+  std::vector<int32_t> row_sums; /// 每一行量化值的和，输入按无符号数计算点积时用来扣除偏移量
+
+  /**
+   * 返回矩阵是否为空
+   * @return 是否为空
+   */
+  bool empty() const;
+};
+
+/// 分组只量化权重的矩阵，输入和输出保持float，计算时在寄存器中反量化
+/// 按照行分成面板保存，面板中同一列的panel_rows个量化值连续排列，最后一个面板补0
+/// 每个面板沿列方向每group_size列分成一组，组内每一行有自己的系数，对称量化没有零点
+/// 8位时每个量化值占一个字节，范围是[-127,127]；4位时范围是[-7,7]，加8之后保存为无符号的半字节，
+/// 面板中一列的第r个量化值位于第r % (panel_rows / 2)个字节，r小于panel_rows / 2时在低4位，否则在高4位
+struct GroupQuantizedMatrix {
+  uint32_t bits = 0; /// 量化的位数，8或者4
+  uint32_t rows = 0; /// 矩阵的行数
+  uint32_t cols = 0; /// 矩阵的列数
+  uint32_t panel_rows = 0; /// 每个面板包含的行数
+  uint32_t group_size = 0; /// 每组包含的列数
+  std::vector<uint8_t> data; /// 依次排列的面板
+  std::vector<float> scales; /// 每个面板中第g组第r行的系数位于g * panel_rows + r，面板之间依次排列
+
+  /**
+   * 返回矩阵是否为空
+   * @return 是否为空
+   */
+  bool empty() const;
+
+  /**
+   * 返回每个面板中组的数量
+   * @return 组的数量
+   */
+  uint32_t group_num() const;
+
+  /**
+   * 返回一个面板中量化值占用的字节数
+   * @return 字节数
+   */
+  size_t panel_bytes() const;
+
+  /**
+   * 返回量化值和系数占用的字节数
+   * @return 字节数
+   */
+  size_t bytes() const;
+};
+
+/**
+ * 返回最大绝对值为abs_max的数据对称量化到[-127,127]时使用的系数
+ * @param abs_max 数据的最大绝对值
+ * @return 量化系数，abs_max为0时返回1
+ */
+float QuantizeScale(float abs_max);
+
+/**
+ * 逐行量化一个矩阵，每一行使用自己的系数
+ * @param matrix 需要量化的矩阵
+ * @return 量化之后的矩阵
+ */
+QuantizedMatrix QuantizeRows(const arma::fmat &matrix);
+
+/**
+ * 按组只量化矩阵，每组每一行使用自己的最大绝对值计算系数
+ * @param matrix 需要量化的矩阵
+ * @param bits 量化的位数，8或者4
+ * @param group_size 每组包含的列数
+ * @param panel_rows 每个面板包含的行数，必须是偶数
+ * @return 量化之后的矩阵
+ */
+GroupQuantizedMatrix QuantizeGroups(const arma::fmat &matrix, uint32_t bits, uint32_t group_size,
+                                    uint32_t panel_rows);
+
+/**
+ * 将分组量化的矩阵反量化为float矩阵
+ * @param matrix 分组量化的矩阵
+ * @return 反量化之后的矩阵
+ */
+arma::fmat DequantizeGroups(const GroupQuantizedMatrix &matrix);
+
+/**
+ * 使用给定的系数将数据量化到[-127,127]，越出范围的值被截断
+ * @param input 原始数据
+ * @param size 数据的元素数量
+ * @param scale 量化系数
+ * @param output 量化值
+ */
+void QuantizeSymmetric(const float *input, uint32_t size, float scale, int8_t *output);
+
+/**
+ * 计算量化矩阵中[row_begin, row_end)行与一个量化向量的点积，使用int32累加
+ * @param matrix 量化矩阵
+ * @param vector 量化向量，长度至少为matrix.stride，超过matrix.cols的部分必须为0
+ * @param row_begin 起始行
+ * @param row_end 结束行
+ * @param output 每一行的点积，第一个元素对应row_begin
+ */
+void Int8MatrixVector(const QuantizedMatrix &matrix, const int8_t *vector, uint32_t row_begin, uint32_t row_end,
+                      int32_t *output);
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_QUANTIZE_HPP_
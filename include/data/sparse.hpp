@@ -0,0 +1,81 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_SPARSE_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_SPARSE_HPP_
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "data/gemm.hpp"
+
+namespace kuiper_infer {
+/// 按列压缩的稀疏矩阵(CSC)，作为矩阵乘法的右矩阵，每一列对应一个输出通道或者输出特征
+/// 第j列的非零元素是values[col_offsets[j], col_offsets[j + 1])，所在的行由row_indices给出并按照升序排列
+/// 剪枝之后的权重按输出通道压缩，等价于按行压缩(CSR)的权重矩阵
+struct SparseMatrix {
+  uint32_t rows = 0; /// 矩阵的行数，即公共维度的长度
+  uint32_t cols = 0; /// 矩阵的列数
+  std::vector<uint32_t> col_offsets; /// 每一列第一个非零元素的位置，共cols + 1个
+  std::vector<uint32_t> row_indices; /// 每个非零元素所在的行
+  std::vector<float> values; /// 每个非零元素的值
+
+  /**
+   * 返回矩阵是否为空，全为0的矩阵压缩之后不为空
+   * @return 是否为空
+   */
+  bool empty() const;
+
+  /**
+   * 返回压缩之后占用的字节数
+   * @return 字节数
+   */
+  size_t bytes() const;
+};
+
+/**
+ * 设置权重转换为稀疏矩阵的阈值，之后创建的卷积层和全连接层在0的比例不低于阈值时使用稀疏计算
+ * @param threshold 0的比例，大于1时不使用稀疏计算
+ */
+void SetSparseThreshold(float threshold);
+
+/**
+ * 返回权重转换为稀疏矩阵的阈值，默认为0.7，低于它时稀疏计算跳过的乘法不足以抵消间接访问的开销
+ * @return 0的比例
+ */
+float SparseThreshold();
+
+/**
+ * 返回一段数据中0的比例
+ * @param data 数据的起始地址
+ * @param size 元素数量
+ * @return 0的比例，size为0时返回0
+ */
+float ZeroRatio(const float *data, size_t size);
+
+/**
+ * 按列压缩一个矩阵，第r行第c列的元素位于matrix[r * row_stride + c * col_stride]
+ * 通过两个步长可以直接压缩转置的矩阵，不需要先复制一份
+ * @param matrix 矩阵的起始地址
+ * @param rows 矩阵的行数
+ * @param cols 矩阵的列数
+ * @param row_stride 相邻两行之间的距离
+ * @param col_stride 相邻两列之间的距离
+ * @return 压缩之后的矩阵
+ */
+SparseMatrix SparsifyColumns(const float *matrix, uint32_t rows, uint32_t cols, uint32_t row_stride,
+                             uint32_t col_stride);
+
+/**
+ * 计算c = act(a * b[:, col_begin:col_begin + n] + bias)，a是稠密矩阵，b是稀疏矩阵，在调用线程中计算
+ * b的每个非零元素对a的一列做一次向量乘加，跳过所有为0的乘法
+ * @param m a和c的行数
+ * @param a 矩阵a的起始地址，按列优先排列，列数等于b的行数
+ * @param lda 矩阵a相邻两列之间的距离
+ * @param b 稀疏矩阵
+ * @param col_begin 从b的哪一列开始计算
+ * @param n 计算的列数
+ * @param c 矩阵c的起始地址，原有的值被覆盖
+ * @param ldc 矩阵c相邻两列之间的距离
+ * @param epilogue 写回c时的偏置和激活函数，列偏置对应c的列而不是b的列
+ */
+void SparseGemm(uint32_t m, const float *a, uint32_t lda, const SparseMatrix &b, uint32_t col_begin, uint32_t n,
+                float *c, uint32_t ldc, const GemmEpilogue &epilogue = GemmEpilogue());
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_SPARSE_HPP_
@@ -6,7 +6,10 @@
 #define KUIPER_COURSE_DATA_BLOB_HPP_
 #include <memory>
 #include <vector>
-#include "armadillo"
+#include <glog/logging.h>
+#include "data/tensor_allocator.hpp"
+#include "data/memory_tracker.hpp"
+#include "data/device.hpp"
 
 namespace kuiper_infer {
 template<typename T>
@@ -32,6 +35,15 @@ class Tensor<float> {
    */
   explicit Tensor(uint32_t channels, uint32_t rows, uint32_t cols);
 
+  /**
+   * 在外部内存上创建张量，张量不拥有也不释放这块内存
+   * @param raw_ptr 外部内存的起始地址，至少能容纳channels * rows * cols个元素
+   * @param channels 张量的通道数
+   * @param rows 张量的行数
+   * @param cols 张量的列数
+   */
+  explicit Tensor(float *raw_ptr, uint32_t channels, uint32_t rows, uint32_t cols);
+
   Tensor(const Tensor &tensor);
 
   Tensor<float> &operator=(const Tensor &tensor);
@@ -161,6 +173,13 @@ class Tensor<float> {
    */
   void Fill(const std::vector<float> &values);
 
+  /**
+   * 使用一段连续内存中按行优先排列的数据初始化张量，不需要先复制到数组中
+   * @param values 用来初始化张量的数据
+   * @param size 数据的元素数量，需要和张量的大小相同
+   */
+  void Fill(const float *values, uint32_t size);
+
   /**
    * 以常量1初始化张量
    */
@@ -189,7 +208,100 @@ class Tensor<float> {
   void ReRawView(const std::vector<uint32_t> &shapes);
 
   /**
-   * 张量相加
+   * 按照存储顺序改变形状，和ReRawshape的结果相同，但是返回的张量和tensor共享内存，不复制数据
+   * @param tensor 原始张量
+   * @param shapes 张量的实际尺寸大小
+   * @return 共享内存的新张量
+   */
+  static std::shared_ptr<Tensor<float>> Reshape(const std::shared_ptr<Tensor<float>> &tensor,
+                                                const std::vector<uint32_t> &shapes);
+
+  /**
+   * pytorch兼容的改变形状，和ReRawView的结果相同
+   * 行优先的元素顺序和存储顺序一致时返回和tensor共享内存的张量，否则返回重新排列之后的新张量
+   * @param tensor 原始张量
+   * @param shapes 张量的实际尺寸大小
+   * @return 改变形状之后的张量
+   */
+  static std::shared_ptr<Tensor<float>> View(const std::shared_ptr<Tensor<float>> &tensor,
+                                             const std::vector<uint32_t> &shapes);
+
+  /**
+   * 返回张量中连续的若干个通道，结果和tensor共享内存
+   * @param tensor 原始张量
+   * @param channel_begin 第一个通道
+   * @param channels 通道的数量
+   * @return 共享内存的通道切片
+   */
+  static std::shared_ptr<Tensor<float>> Slice(const std::shared_ptr<Tensor<float>> &tensor, uint32_t channel_begin,
+                                              uint32_t channels);
+
+  /**
+   * 创建一个批次的张量，所有样本按照NCHW的顺序放在同一块连续内存中，每个样本的张量是这块内存上的视图
+   * @param batch_size 批次的大小
+   * @param channels 每个样本的通道数
+   * @param rows 每个样本的行数
+   * @param cols 每个样本的列数
+   * @return 每个样本的张量
+   */
+  static std::vector<std::shared_ptr<Tensor<float>>> CreateBatch(uint32_t batch_size, uint32_t channels,
+                                                                 uint32_t rows, uint32_t cols);
+
+  /**
+   * 返回一个批次的张量是否形状相同并且依次紧密排列在同一块内存中，这时整个批次可以作为一个NCHW张量计算
+   * @param tensors 每个样本的张量
+   * @return 第一个样本的起始地址，不连续时为空指针
+   */
+  static float *ContiguousBatch(const std::vector<std::shared_ptr<Tensor<float>>> &tensors);
+
+  /**
+   * 返回行列为rows和cols的张量按照pytorch的方式改变为shapes时是否可以共享内存
+   * 每个通道只有一行或者一列时行优先的顺序就是存储顺序，每个通道的形状不变时也不需要重新排列
+   * @param rows 原始张量的行数
+   * @param cols 原始张量的列数
+   * @param shapes 张量的实际尺寸大小
+   * @return 是否可以共享内存
+   */
+  static bool ViewSharesMemory(uint32_t rows, uint32_t cols, const std::vector<uint32_t> &shapes);
+
+  /**
+   * 返回张量是否建立在另一个张量的内存上
+   * @return 是否共享另一个张量的内存
+   */
+  bool is_view() const;
+
+  /**
+   * 返回张量最新的数据所在的设备，其他设备上的数据只有同步之后才有效
+   * @return 最新数据所在的设备
+   */
+  DeviceType device() const;
+
+  /**
+   * 设置张量最新的数据所在的设备，在设备上写入张量之后调用，不复制数据
+   * @param device 最新数据所在的设备
+   */
+  void set_device(DeviceType device);
+
+  /**
+   * 将最新的数据复制到给定的设备上，之后两个设备上的数据一致，device()不变
+   * @param device 需要读取数据的设备
+   */
+  void SyncTo(DeviceType device);
+
+  /**
+   * 返回张量在CUDA设备上的数据，第一次调用时分配设备内存，内存的排列和主机上的存储顺序相同
+   * @return 设备内存的起始地址
+   */
+  float *cuda_data();
+
+  /**
+   * 指定张量在CUDA设备上使用的内存，用于让设备上的张量共享内存规划分配的设备内存块
+   * @param cuda_buffer 设备内存，至少能容纳张量全部的元素
+   */
+  void set_cuda_buffer(std::shared_ptr<DeviceBuffer> cuda_buffer);
+
+  /**
+   * 张量相加，其中一个张量每个通道只有一个值时在通道内广播
    * @param tensor1 输入张量1
    * @param tensor2 输入张量2
    * @return 张量相加的结果
@@ -198,7 +310,17 @@ class Tensor<float> {
                                                    const std::shared_ptr<Tensor<float>> &tensor2);
 
   /**
-   * 张量相乘
+   * 张量相加并写入已有的输出张量，输出张量可以是输入张量之一，此时原地累加
+   * @param tensor1 输入张量1
+   * @param tensor2 输入张量2
+   * @param output_tensor 输出张量，形状和广播之后的结果相同
+   */
+  static void ElementAdd(const std::shared_ptr<Tensor<float>> &tensor1,
+                         const std::shared_ptr<Tensor<float>> &tensor2,
+                         const std::shared_ptr<Tensor<float>> &output_tensor);
+
+  /**
+   * 张量相乘，其中一个张量每个通道只有一个值时在通道内广播
    * @param tensor1 输入张量1
    * @param tensor2 输入张量2
    * @return 张量相乘的结果
@@ -206,16 +328,34 @@ class Tensor<float> {
   static std::shared_ptr<Tensor<float>> ElementMultiply(const std::shared_ptr<Tensor<float>> &tensor1,
                                                         const std::shared_ptr<Tensor<float>> &tensor2);
 
+  /**
+   * 张量相乘并写入已有的输出张量，输出张量可以是输入张量之一，此时原地相乘
+   * @param tensor1 输入张量1
+   * @param tensor2 输入张量2
+   * @param output_tensor 输出张量，形状和广播之后的结果相同
+   */
+  static void ElementMultiply(const std::shared_ptr<Tensor<float>> &tensor1,
+                              const std::shared_ptr<Tensor<float>> &tensor2,
+                              const std::shared_ptr<Tensor<float>> &output_tensor);
+
   /**
    * 展开张量
    */
   void Flatten();
 
   /**
-   * 对张量中的元素进行过滤
+   * 对张量中的元素进行过滤，过滤函数的类型是模板参数，lambda可以被内联
    * @param filter 过滤函数
    */
-  void Transform(const std::function<float(float)> &filter);
+  template<typename Function>
+  void Transform(Function filter) {
+    CHECK(!this->data_.empty());
+    float *data_ptr = this->data_.memptr();
+    const uint32_t size = this->data_.n_elem;
+    for (uint32_t i = 0; i < size; ++i) {
+      data_ptr[i] = filter(data_ptr[i]);
+    }
+  }
 
   /**
    * 返回一个深拷贝后的张量
@@ -227,8 +367,30 @@ class Tensor<float> {
 
  private:
   void ReView(const std::vector<uint32_t> &shapes);
+
+  /**
+   * 张量数据重新分配之后更新内存统计，建立在外部内存上的张量不计入
+   */
+  void TrackMemory();
+
+  /**
+   * 在tensor的内存上创建形状为shapes的张量
+   * @param tensor 原始张量
+   * @param offset 新张量在原始张量中的起点
+   * @param shapes 新张量的通道数、行数和列数
+   * @param raw_shapes 新张量的实际尺寸大小
+   * @return 共享内存的新张量
+   */
+  static std::shared_ptr<Tensor<float>> Alias(const std::shared_ptr<Tensor<float>> &tensor, uint32_t offset,
+                                              const std::vector<uint32_t> &shapes,
+                                              const std::vector<uint32_t> &raw_shapes);
+
   std::vector<uint32_t> raw_shapes_; // 张量数据的实际尺寸大小
   arma::fcube data_; // 张量数据
+  TrackedAllocation allocation_; // 张量自己持有的内存
+  std::shared_ptr<Tensor<float>> base_; // 共享内存时持有内存所属的张量，保证内存在视图析构之前有效
+  DeviceType device_ = DeviceType::kDeviceCPU; // 最新的数据所在的设备
+  std::shared_ptr<DeviceBuffer> cuda_buffer_; // CUDA设备上的数据，第一次使用时分配
 };
 
 }
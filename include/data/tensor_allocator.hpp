@@ -0,0 +1,135 @@
+#ifndef KUIPER_INFER_INCLUDE_DATA_TENSOR_ALLOCATOR_HPP_
+#define KUIPER_INFER_INCLUDE_DATA_TENSOR_ALLOCATOR_HPP_
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Armadillo的include guard，分配函数必须在第一次包含Armadillo之前指定，否则分配和释放会使用不同的函数
+#ifdef ARMA_INCLUDES
+#error "armadillo must be included through data/tensor_allocator.hpp"
+#endif
+
+/**
+ * Armadillo申请堆内存时调用的函数，转发给当前的张量分配器，返回的地址按照64字节对齐
+ * @param bytes 字节数
+ * @return 内存的起始地址，分配失败时为空
+ */
+void *kuiper_infer_arma_allocate(size_t bytes);
+
+/**
+ * Armadillo释放堆内存时调用的函数，交还给分配这块内存的张量分配器
+ * @param ptr 内存的起始地址
+ */
+void kuiper_infer_arma_release(void *ptr);
+
+#define ARMA_ALIEN_MEM_ALLOC_FUNCTION kuiper_infer_arma_allocate
+#define ARMA_ALIEN_MEM_FREE_FUNCTION kuiper_infer_arma_release
+#include <armadillo>
+
+namespace kuiper_infer {
+/// 张量内存的分配器，张量和Layer中临时矩阵的堆内存都通过当前的分配器申请和释放
+/// 实现需要是线程安全的，返回的地址至少按照64字节对齐，AVX-512的对齐读写不会越过缓存行
+class TensorAllocator {
+ public:
+  virtual ~TensorAllocator() = default;
+
+  /**
+   * 申请一块内存
+   * @param bytes 字节数
+   * @return 按照64字节对齐的起始地址，分配失败时为空
+   */
+  virtual void *Allocate(size_t bytes) = 0;
+
+  /**
+   * 释放一块由Allocate申请的内存
+   * @param ptr 内存的起始地址
+   * @param bytes 申请时的字节数
+   */
+  virtual void Release(void *ptr, size_t bytes) = 0;
+
+  /**
+   * 设置之后申请内存使用的分配器，通常在创建第一个张量之前设置
+   * 之前的分配器一直保留到进程退出，它分配的内存释放时仍然交还给它
+   * @param allocator 分配器，为空时恢复默认的分配器
+   */
+  static void SetCurrent(std::shared_ptr<TensorAllocator> allocator);
+
+  /**
+   * 返回当前使用的分配器
+   * @return 当前的分配器
+   */
+  static TensorAllocator &Current();
+
+  /**
+   * 返回默认的分配器，是一个使用默认参数的PoolTensorAllocator
+   * @return 默认的分配器
+   */
+  static TensorAllocator &Default();
+};
+
+/// 按照大小分级缓存释放的内存，Layer反复创建和销毁同样大小的临时张量时直接复用
+/// 较大的内存使用匿名映射并且按照大页对齐，通过透明大页减少大特征图和权重的TLB缺失
+class PoolTensorAllocator : public TensorAllocator {
+ public:
+  /**
+   * @param max_cached_bytes 最多缓存的空闲内存字节数，超过时直接释放
+   * @param huge_page_threshold 不小于这个字节数的内存使用匿名映射并建议内核使用透明大页，0表示不使用
+   * @param use_hugetlb 是否先尝试MAP_HUGETLB从预留的大页中分配，失败时退回透明大页
+   */
+  explicit PoolTensorAllocator(size_t max_cached_bytes = size_t(256) << 20, size_t huge_page_threshold = kHugePageSize,
+                               bool use_hugetlb = false);
+
+  ~PoolTensorAllocator() override;
+
+  PoolTensorAllocator(const PoolTensorAllocator &) = delete;
+
+  PoolTensorAllocator &operator=(const PoolTensorAllocator &) = delete;
+
+  void *Allocate(size_t bytes) override;
+
+  void Release(void *ptr, size_t bytes) override;
+
+  /**
+   * 释放所有缓存的空闲内存
+   */
+  void Trim();
+
+  /**
+   * 返回缓存的空闲内存字节数
+   * @return 空闲内存的字节数
+   */
+  size_t cached_bytes() const;
+
+  /**
+   * 返回复用缓存内存的分配次数
+   * @return 复用的次数
+   */
+  size_t reused_count() const;
+
+  static constexpr size_t kAlignment = 64; /// 返回地址的对齐字节数
+  static constexpr size_t kHugePageSize = size_t(2) << 20; /// x86_64上大页的字节数
+
+ private:
+  /**
+   * 将申请的字节数向上取整到所在的级别，每个2的幂次之间分为4级，浪费不超过25%，使用大页的内存按照大页取整
+   * @param bytes 申请的字节数
+   * @return 级别的字节数
+   */
+  size_t RoundSize(size_t bytes) const;
+
+  void *AllocateBlock(size_t size) const;
+
+  void ReleaseBlock(void *ptr, size_t size) const;
+
+  size_t max_cached_bytes_ = 0; /// 最多缓存的空闲内存字节数
+  size_t huge_page_threshold_ = 0; /// 使用匿名映射的最小字节数，0表示不使用
+  bool use_hugetlb_ = false; /// 是否先尝试从预留的大页中分配
+  mutable std::mutex mutex_; /// 保护空闲链表
+  std::unordered_map<size_t, std::vector<void *>> free_blocks_; /// 每个级别的空闲内存
+  size_t cached_bytes_ = 0; /// 缓存的空闲内存字节数
+  size_t reused_count_ = 0; /// 复用缓存内存的分配次数
+};
+}
+#endif //KUIPER_INFER_INCLUDE_DATA_TENSOR_ALLOCATOR_HPP_
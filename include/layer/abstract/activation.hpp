@@ -0,0 +1,70 @@
+#ifndef KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_ACTIVATION_HPP_
+#define KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_ACTIVATION_HPP_
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "status_code.hpp"
+
+namespace kuiper_infer {
+// 只声明张量，矩阵乘法的尾部计算激活函数时不需要包含armadillo
+template<typename T>
+class Tensor;
+
+struct RuntimeOperator;
+
+/// 可以作为卷积和全连接层尾部直接计算的激活函数
+enum class ActivationType {
+  kActivationNone = 0,
+  kActivationRelu = 1,
+  kActivationSigmoid = 2,
+  kActivationSiLU = 3,
+  kActivationHardSwish = 4,
+  kActivationHardSigmoid = 5,
+};
+
+/**
+ * 根据计算节点的类型返回对应的激活函数
+ * @param op_type 计算节点的类型，例如nn.ReLU
+ * @return 对应的激活函数，不是激活函数时返回kActivationNone
+ */
+ActivationType ActivationTypeFromOpType(const std::string &op_type);
+
+/**
+ * 读取计算图合并进计算节点的激活函数参数，卷积、全连接等Layer的GetInstance共用
+ * @param op 计算节点
+ * @param name 参数的名称，例如activation
+ * @param activation_type 读取到的激活函数，参数不存在时为kActivationNone
+ * @return 参数不存在或者读取成功时返回true，参数不是字符串或者不是支持的激活函数时返回false
+ */
+bool ParseFusedActivation(const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+                          ActivationType &activation_type);
+
+/**
+ * 对一段连续的数据原地计算激活函数
+ * @param activation 激活函数的类型
+ * @param data 数据的起始地址
+ * @param size 数据的元素数量
+ */
+void ApplyActivation(ActivationType activation, float *data, uint32_t size);
+
+/**
+ * 对一个batch的输入计算激活函数并写入输出，所有样本的元素按照连续的块切分到线程池中并行计算
+ * @param activation 激活函数的类型
+ * @param inputs 输入张量
+ * @param outputs 输出张量，已经分配好并且和对应的输入形状相同，可以是输入张量本身
+ */
+void ApplyActivation(ActivationType activation, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                     const std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+/**
+ * 在CUDA设备上对一个batch的输入计算激活函数，激活Layer的ForwardCuda共用
+ * @param activation 激活函数的类型
+ * @param inputs 输入张量，数据已经同步到设备上
+ * @param outputs 输出张量，为空时新建，可以是输入张量本身
+ * @return 执行的状态，没有开启USE_CUDA时不支持
+ */
+InferStatus ForwardActivationCuda(ActivationType activation, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                  std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+}
+#endif //KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_ACTIVATION_HPP_
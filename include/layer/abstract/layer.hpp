@@ -11,10 +11,21 @@
 #include <glog/logging.h>
 
 #include "status_code.hpp"
+#include "validation.hpp"
 #include "data/tensor.hpp"
 #include "runtime/runtime_op.hpp"
+#include "runtime/numa.hpp"
+#include "runtime/tuning_cache.hpp"
+#include "runtime/shared_params.hpp"
 
 namespace kuiper_infer {
+/// 检测头的后处理参数，开启后检测Layer直接输出经过置信度过滤和非极大值抑制的检测框
+struct DetectionPostProcess {
+  bool enabled = false; /// 是否在检测Layer中做后处理
+  float conf_thresh = 0.25f; /// 目标置信度和类别置信度的乘积不小于该值的框才会保留
+  float iou_thresh = 0.45f; /// 和得分更高的框交并比超过该值的框被抑制，不区分类别
+  uint32_t max_detections = 300; /// 每张图片最多输出的检测框数量
+};
 
 class Layer {
  public:
@@ -65,14 +76,199 @@ class Layer {
    */
   virtual void set_bias(const std::vector<float> &bias);
 
+  /**
+   * 从一块连续的内存设置Layer的权重，加载模型时直接从权重文件中读取，不需要先复制到数组中
+   * 默认复制到数组之后调用数组版本
+   * @param weights 权重
+   * @param size 权重的元素数量
+   */
+  virtual void set_weights(const float *weights, uint32_t size);
+
+  /**
+   * 从一块连续的内存设置Layer的偏移量，默认复制到数组之后调用数组版本
+   * @param bias 偏移量
+   * @param size 偏移量的元素数量
+   */
+  virtual void set_bias(const float *bias, uint32_t size);
+
   /**
    * 返回层的名称
    * @return 层的名称
    */
   virtual const std::string &layer_name() const { return this->layer_name_; }
 
+  /**
+   * 返回Layer在给定的输入形状下计算时需要的临时内存，计算图在Build的时候统一分配
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   * @return 需要的float元素数量
+   */
+  virtual size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const;
+
+  /**
+   * 根据输入操作数的形状推导输出操作数的形状，计算图在输入形状变化时用它重新规划中间张量
+   * 默认输出和第一个输入的形状相同，改变形状的Layer需要重写
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   * @param output_shape 推导得到的输出操作数形状
+   * @return 是否支持该输入形状
+   */
+  virtual bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                std::vector<int32_t> &output_shape) const;
+
+  /**
+   * 估计给定形状下一次Forward的浮点运算次数，性能分析时用来计算达到的GFLOP/s
+   * 默认每个输出元素一次运算，计算量和输出元素数量不成正比的Layer需要重写
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   * @param output_shape 输出操作数的形状
+   * @return 浮点运算次数
+   */
+  virtual uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                         const std::vector<int32_t> &output_shape) const;
+
+  /**
+   * 返回Layer在给定的输入形状下是否直接让输出张量共享输入张量的内存，例如只改变形状的Layer
+   * 计算图不再为这样的输出分配内存，并将输入张量的生命周期延长到输出张量的所有读取者执行完成
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   * @return 输出是否共享输入的内存
+   */
+  virtual bool ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const;
+
+  /**
+   * 返回Layer是否可以在输入张量的内存上直接写入输出，例如逐元素计算的激活函数
+   * 计算图只在输入张量没有其他读取者并且形状和输出相同时原地执行
+   * @return 是否支持原地计算
+   */
+  virtual bool SupportInPlace() const;
+
+  /**
+   * 返回Layer中权重和偏移量的字节数，性能分析时计入每次Forward读取的内存
+   * @return 权重和偏移量的字节数
+   */
+  virtual size_t ParamBytes() const;
+
+  /**
+   * 按照策略设置Layer中权重以及打包、量化后的权重所在的NUMA节点，默认没有权重
+   * @param policy 权重的分布方式
+   * @param node kBind时权重所在的NUMA节点
+   */
+  virtual void PlaceParams(NumaMemoryPolicy policy, uint32_t node);
+
+  /**
+   * 把Layer计算时读取的权重以及打包后的权重按照固定的顺序交给共享器，映射参数文件时替换为文件中的数据
+   * 默认没有权重
+   * @param shared_params 参数的共享器
+   */
+  virtual void ShareParams(SharedParams &shared_params);
+
+  /**
+   * 保持映射的参数文件有效，计算图在Layer的权重改为引用文件中的数据之后调用
+   * 权重矩阵本身不持有映射，Layer比计算图存在得更久时由Layer保持映射
+   * @param shared_params 映射参数文件的共享器
+   */
+  void set_shared_params(std::shared_ptr<const SharedParams> shared_params);
+
+  /**
+   * 将Layer的权重转换为INT8并在之后的Forward中使用INT8计算，输入按照标定得到的最大绝对值量化
+   * 默认不支持量化，Layer保持浮点计算
+   * @param input_abs_max 标定时输入的最大绝对值，不大于0时每次Forward按照实际的输入动态计算
+   * @return 是否转换成功
+   */
+  virtual bool QuantizeInt8(float input_abs_max);
+
+  /**
+   * 将Layer的权重按组只量化为8位或者4位，输入和输出保持float，计算时反量化，减少Forward读取的权重字节数
+   * 默认不支持，Layer保持原来的权重
+   * @param bits 量化的位数，8或者4
+   * @param group_size 每组包含的输入特征数量
+   * @return 是否量化成功
+   */
+  virtual bool QuantizeWeights(uint32_t bits, uint32_t group_size);
+
+  /**
+   * 在给定的输入形状和当前线程池的线程数量下选择最快的计算算法，之后这个形状的Forward和临时内存规划都使用它
+   * 先在缓存中查找调优结果，找不到时逐个测量可用的算法并将结果记录到缓存中，默认只有一种算法不需要调优
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   * @param cache 调优结果的缓存
+   * @return 是否选择了算法
+   */
+  virtual bool Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache);
+
+  /**
+   * 规划内存时为给定的输入形状提前准备Forward需要的只读数据，推理时直接读取不需要加锁生成
+   * 多个执行上下文可能同时规划，实现需要自己保证线程安全，默认没有需要准备的数据
+   * @param input_shapes 每个输入操作数的形状，第一维是batch
+   */
+  virtual void PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes);
+
+  /**
+   * 设置检测Layer的后处理，开启后输出形状变为[batch, max_detections, 6]，每行是x1、y1、x2、y2、得分和类别
+   * 检测框按照得分从高到低排列，不足max_detections时剩余的行得分为0、类别为-1，默认不是检测Layer
+   * @param post_process 后处理参数
+   * @return 是否支持后处理
+   */
+  virtual bool SetDetectionPostProcess(const DetectionPostProcess &post_process);
+
+  /**
+   * 返回Layer是否可以在给定的设备上执行，计算图只把节点放置到Layer支持的设备上，默认只支持CPU
+   * @param device 设备
+   * @return 是否支持
+   */
+  virtual bool SupportDevice(DeviceType device) const;
+
+  /**
+   * Layer在CUDA设备上的执行函数，输入张量的数据已经同步到设备上，结果写入输出张量的设备内存
+   * 输出张量为空时新建，执行完成后输出张量最新的数据在设备上，默认不支持
+   * @param inputs 层的输入
+   * @param outputs 层的输出
+   * @return 执行的状态
+   */
+  virtual InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                  std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+  /**
+   * 设置Layer计算时可以使用的临时内存，内存由计算图持有，Layer执行期间独占使用
+   * @param workspace 临时内存的起始地址，按照64字节对齐
+   * @param workspace_size 临时内存的float元素数量
+   */
+  void set_workspace(float *workspace, size_t workspace_size);
+
+  /// 在当前线程中临时指定所有Layer计算时使用的临时内存，析构时恢复之前的设置
+  /// 多个执行上下文并发执行同一个Layer时，每个上下文在调用Forward前指定自己的临时内存，优先于set_workspace
+  class WorkspaceScope {
+   public:
+    WorkspaceScope(float *workspace, size_t workspace_size);
+
+    ~WorkspaceScope();
+
+    WorkspaceScope(const WorkspaceScope &) = delete;
+
+    WorkspaceScope &operator=(const WorkspaceScope &) = delete;
+
+   private:
+    bool prev_bound_ = false; /// 之前是否已经指定了临时内存
+    float *prev_workspace_ = nullptr; /// 之前指定的临时内存
+    size_t prev_workspace_size_ = 0; /// 之前指定的临时内存的float元素数量
+  };
+
  protected:
+  /**
+   * 返回至少能容纳size个元素的临时内存，计算图分配的临时内存不够的时候使用buffer中新分配的内存
+   * @param size 需要的float元素数量
+   * @param buffer 临时内存不够时使用的内存
+   * @return 临时内存的起始地址
+   */
+  float *AcquireWorkspace(size_t size, std::vector<float> &buffer) const;
+
+  /**
+   * 返回形状中所有维度的乘积
+   * @param shape 操作数的形状
+   * @return 元素数量
+   */
+  static uint64_t ShapeSize(const std::vector<int32_t> &shape);
+
   std::string layer_name_; /// Layer的名称
+  float *workspace_ = nullptr; /// 通过set_workspace设置的临时内存
+  size_t workspace_size_ = 0; /// 临时内存的float元素数量
+  std::shared_ptr<const SharedParams> shared_params_; /// 权重引用的参数文件映射
 };
 
 }
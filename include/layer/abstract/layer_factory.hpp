@@ -22,6 +22,15 @@ class LayerRegisterer {
 
   static std::shared_ptr<Layer> CreateLayer(const std::shared_ptr<RuntimeOperator> &op);
 
+  /**
+   * 创建计算节点对应的Layer，失败时返回错误码而不是直接退出，可以在多个线程中同时调用
+   * @param op 计算图中的计算节点
+   * @param layer 创建成功的Layer
+   * @return 参数和权重的解析状态
+   */
+  static ParseParameterAttrStatus CreateLayer(const std::shared_ptr<RuntimeOperator> &op,
+                                              std::shared_ptr<Layer> &layer);
+
   static CreateRegistry &Registry();
 };
 
@@ -0,0 +1,111 @@
+#ifndef KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_LAZY_LAYER_HPP_
+#define KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_LAZY_LAYER_HPP_
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "layer.hpp"
+
+namespace kuiper_infer {
+/// 延迟创建的Layer，计算节点第一次执行时才解析参数并加载权重
+/// 规划内存时不需要权重的查询直接返回保守的结果：没有临时内存、不共享输入内存、不原地计算、没有权重
+/// 其他调用先创建实际的Layer再转发给它，创建之后计算图按照实际的Layer重新规划内存
+/// 映射到内存的权重在加载前提示内核预读，加载后提示内核回收对应的文件页，常驻内存只包含执行过的节点的权重
+class LazyLayer : public Layer {
+ public:
+  /**
+   * @param op 计算节点，Layer只保存弱引用，计算节点由计算图持有
+   * @param pending_num 计算图中还没有创建的延迟Layer数量，创建之后减一
+   */
+  LazyLayer(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<std::atomic<uint32_t>> pending_num);
+
+  InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  const std::vector<std::shared_ptr<Tensor<float>>> &weights() const override;
+
+  const std::vector<std::shared_ptr<Tensor<float>>> &bias() const override;
+
+  void set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) override;
+
+  void set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bias) override;
+
+  void set_weights(const std::vector<float> &weights) override;
+
+  void set_bias(const std::vector<float> &bias) override;
+
+  void set_weights(const float *weights, uint32_t size) override;
+
+  void set_bias(const float *bias, uint32_t size) override;
+
+  size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  bool ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
+  bool SupportInPlace() const override;
+
+  size_t ParamBytes() const override;
+
+  /**
+   * 创建之前只记录权重的分布方式，创建时按照它放置权重
+   */
+  void PlaceParams(NumaMemoryPolicy policy, uint32_t node) override;
+
+  void ShareParams(SharedParams &shared_params) override;
+
+  bool QuantizeInt8(float input_abs_max) override;
+
+  /**
+   * 创建之前只记录量化的设置并返回true，创建时在放置权重之前量化，量化失败时保持原来的权重
+   */
+  bool QuantizeWeights(uint32_t bits, uint32_t group_size) override;
+
+  bool Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) override;
+
+  /**
+   * 创建之前不做准备，Forward时由实际的Layer自己生成，创建之后计算图重新规划时再准备
+   */
+  void PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes) override;
+
+  bool SetDetectionPostProcess(const DetectionPostProcess &post_process) override;
+
+  bool SupportDevice(DeviceType device) const override;
+
+  /**
+   * 返回实际的Layer是否已经创建
+   * @return 是否已经创建
+   */
+  bool materialized() const;
+
+  /**
+   * 返回实际的Layer，还没有创建时先创建，多个线程同时调用时只创建一次
+   * @return 实际的Layer
+   */
+  Layer &layer() const;
+
+ private:
+  /**
+   * 解析计算节点的参数和权重创建实际的Layer，创建失败时直接退出
+   */
+  void Materialize() const;
+
+  std::weak_ptr<RuntimeOperator> op_; /// 对应的计算节点
+  std::shared_ptr<std::atomic<uint32_t>> pending_num_; /// 计算图中还没有创建的延迟Layer数量
+  mutable std::once_flag create_flag_; /// 保证实际的Layer只创建一次
+  mutable std::shared_ptr<Layer> layer_; /// 实际的Layer
+  mutable std::atomic<bool> materialized_{false}; /// 实际的Layer是否已经创建
+  NumaMemoryPolicy weight_policy_ = NumaMemoryPolicy::kDefault; /// 创建之前记录的权重分布方式
+  uint32_t weight_node_ = 0; /// kBind时权重所在的NUMA节点
+  uint32_t quantize_bits_ = 0; /// 创建之前记录的权重量化位数，为0时不量化
+  uint32_t quantize_group_size_ = 0; /// 创建之前记录的量化分组大小
+};
+}
+#endif //KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_LAZY_LAYER_HPP_
@@ -5,6 +5,7 @@
 #ifndef KUIPER_COURSE_SOURCE_LAYER_PARAM_LAYER_HPP_
 #define KUIPER_COURSE_SOURCE_LAYER_PARAM_LAYER_HPP_
 #include"layer.hpp"
+#include "activation.hpp"
 
 namespace kuiper_infer {
 class ParamLayer : public Layer {
@@ -19,13 +20,42 @@ class ParamLayer : public Layer {
 
   void set_bias(const std::vector<float> &bias) override;
 
+  /**
+   * 按顺序把权重填充到每个权重张量中，数组版本同样调用这个函数，子类只需要重写这个版本
+   */
+  void set_weights(const float *weights, uint32_t size) override;
+
+  /**
+   * 按顺序把偏移量填充到每个偏移量张量中，数组版本同样调用这个函数，子类只需要重写这个版本
+   */
+  void set_bias(const float *bias, uint32_t size) override;
+
   void set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) override;
 
   void set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bias) override;
 
+  size_t ParamBytes() const override;
+
+  void PlaceParams(NumaMemoryPolicy policy, uint32_t node) override;
+
+  void ShareParams(SharedParams &shared_params) override;
+
+  /**
+   * 设置在偏移量之后直接计算的激活函数，由计算图将后继的激活节点合并进来
+   * @param activation 激活函数的类型
+   */
+  void set_activation(ActivationType activation);
+
+  /**
+   * 返回在偏移量之后直接计算的激活函数
+   * @return 激活函数的类型
+   */
+  ActivationType activation() const;
+
  protected:
   std::vector<std::shared_ptr<Tensor<float>>> weights_;
   std::vector<std::shared_ptr<Tensor<float>>> bias_;
+  ActivationType activation_ = ActivationType::kActivationNone; /// 合并进来的激活函数
 };
 
 }
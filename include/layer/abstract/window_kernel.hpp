@@ -0,0 +1,57 @@
+#ifndef KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_WINDOW_KERNEL_HPP_
+#define KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_WINDOW_KERNEL_HPP_
+#include <cstdint>
+
+namespace kuiper_infer {
+/// 一个通道池化时的窗口参数，池化内核之间共用
+struct PoolingWindow {
+  uint32_t pooling_h = 0; /// 窗口的高度
+  uint32_t pooling_w = 0; /// 窗口的宽度
+  uint32_t stride_h = 1; /// 行方向的步长
+  uint32_t stride_w = 1; /// 列方向的步长
+  uint32_t padding_h = 0; /// 行方向的填充
+  uint32_t padding_w = 0; /// 列方向的填充
+  uint32_t input_w = 0; /// 输入的列数
+  uint32_t output_h = 0; /// 输出的行数
+  uint32_t output_w = 0; /// 输出的列数
+};
+
+/**
+ * 返回窗口参数在模板实例中的值，模板参数不为0时是编译期常量，内层循环的次数固定之后可以完全展开
+ * @tparam kFixed 实例化时固定的值，为0时使用运行时的值
+ * @param value 运行时的值
+ * @return 实际使用的值
+ */
+template<uint32_t kFixed>
+inline uint32_t FixedOr(uint32_t value) {
+  return kFixed != 0 ? kFixed : value;
+}
+
+/**
+ * 按照窗口大小和步长选择卷积和池化内核的模板实例，常见的组合使用参数固定的实例，其他组合使用通用实例
+ * 每个Layer在创建时选择一次，推理时直接调用选中的函数
+ * @tparam Kernel 内核模板，参数依次是窗口的高度、宽度和两个方向的步长，Kernel<0, 0, 0, 0>是通用实例，
+ * 静态成员函数Run是内核的入口，Function是它的函数指针类型
+ * @param kernel_h 窗口的高度
+ * @param kernel_w 窗口的宽度
+ * @param stride_h 高度方向的步长
+ * @param stride_w 宽度方向的步长
+ * @return 选中的实例
+ */
+template<template<uint32_t, uint32_t, uint32_t, uint32_t> class Kernel>
+typename Kernel<0, 0, 0, 0>::Function SelectWindowKernel(uint32_t kernel_h, uint32_t kernel_w, uint32_t stride_h,
+                                                         uint32_t stride_w) {
+#define KUIPER_WINDOW_KERNEL(KH, KW, SH, SW)                                          \
+  if (kernel_h == (KH) && kernel_w == (KW) && stride_h == (SH) && stride_w == (SW)) { \
+    return &Kernel<KH, KW, SH, SW>::Run;                                              \
+  }
+  KUIPER_WINDOW_KERNEL(1, 1, 1, 1)
+  KUIPER_WINDOW_KERNEL(2, 2, 2, 2)
+  KUIPER_WINDOW_KERNEL(3, 3, 1, 1)
+  KUIPER_WINDOW_KERNEL(3, 3, 2, 2)
+  KUIPER_WINDOW_KERNEL(5, 5, 1, 1)
+#undef KUIPER_WINDOW_KERNEL
+  return &Kernel<0, 0, 0, 0>::Run;
+}
+}
+#endif //KUIPER_INFER_INCLUDE_LAYER_ABSTRACT_WINDOW_KERNEL_HPP_
@@ -0,0 +1,80 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_CPU_FEATURE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_CPU_FEATURE_HPP_
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace kuiper_infer {
+/// 内核编译时针对的指令集级别，同一个程序中可以包含多个级别的内核，运行时选择一个
+enum class CpuIsa {
+  kScalar = 0, /// 没有额外的指令集，使用标量实现
+  kSSE42 = 1, /// SSE4.2和POPCNT
+  kAVX2 = 2, /// AVX2、FMA和F16C
+  kAVX512 = 3, /// AVX-512 F/BW/DQ/VL
+  kNEON = 4, /// ARMv8的NEON
+};
+
+/**
+ * 通过cpuid检测当前处理器支持的最高级别
+ * @return 处理器和操作系统都支持的最高级别
+ */
+CpuIsa DetectCpuIsa();
+
+/**
+ * 某个级别的内核是否被编译进了程序
+ * @param isa 指令集级别
+ * @return 是否已经编译
+ */
+bool CpuIsaCompiled(CpuIsa isa);
+
+/**
+ * 当前处理器是否可以运行某个级别的内核
+ * @param isa 指令集级别
+ * @return 是否支持
+ */
+bool CpuIsaSupported(CpuIsa isa);
+
+/**
+ * 强制使用某个级别的内核，用于测试和性能对比，之后打包的矩阵使用这个级别的格式
+ * @param isa 指令集级别
+ * @return 级别没有编译或者处理器不支持时返回false
+ */
+bool SetCpuIsa(CpuIsa isa);
+
+/**
+ * 返回当前使用的内核级别，第一次调用时选择已经编译并且处理器支持的最高级别，
+ * 环境变量KUIPER_CPU_ISA可以指定为scalar、sse4.2、avx2、avx512或者neon
+ * @return 当前的级别
+ */
+CpuIsa CurrentCpuIsa();
+
+/**
+ * 返回指令集级别的名称
+ * @param isa 指令集级别
+ * @return 级别的名称，和环境变量KUIPER_CPU_ISA使用的名称相同
+ */
+const char *CpuIsaName(CpuIsa isa);
+
+/**
+ * 根据名称解析指令集级别
+ * @param name 级别的名称
+ * @param isa 解析得到的级别
+ * @return 名称是否有效
+ */
+bool ParseCpuIsa(const std::string &name, CpuIsa &isa);
+
+/**
+ * 返回处理器的型号，读取/proc/cpuinfo，用于区分不同机器上的调优结果
+ * @return 处理器的型号，无法获取时为unknown
+ */
+std::string CpuModelName();
+
+/**
+ * 返回第一个CPU的某一级数据缓存的大小，读取/sys/devices/system/cpu/cpu0/cache
+ * 二级缓存通常每个核心独占，三级缓存通常由一组核心共享
+ * @param level 缓存的级别，1到3
+ * @return 缓存的字节数，无法获取时为0
+ */
+size_t CpuCacheBytes(uint32_t level);
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_CPU_FEATURE_HPP_
@@ -0,0 +1,74 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_HARDWARE_COUNTER_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_HARDWARE_COUNTER_HPP_
+#include <vector>
+#include <cstdint>
+
+namespace kuiper_infer {
+/// 一次读取得到的硬件计数器的值，不支持的计数器保持为0
+struct HardwareCounterValues {
+  uint64_t cycles = 0; /// CPU周期数
+  uint64_t instructions = 0; /// 退役的指令数
+  uint64_t llc_misses = 0; /// 最后一级缓存的缺失次数
+  uint64_t vector_instructions = 0; /// 退役的向量浮点指令数
+
+  /**
+   * 返回两次读取之间的差值
+   * @param start 较早的一次读取
+   * @return 差值
+   */
+  HardwareCounterValues operator-(const HardwareCounterValues &start) const;
+};
+
+/// 基于Linux perf_event的硬件计数器，只统计打开计数器的线程，所以每个线程使用自己的实例
+/// 没有权限或者不是Linux时不可用，此时Read直接返回false
+class HardwareCounters {
+ public:
+  /**
+   * 返回当前线程的硬件计数器，第一次调用时打开计数器
+   * @return 当前线程的硬件计数器
+   */
+  static HardwareCounters &ThreadLocal();
+
+  /**
+   * 设置向量浮点指令使用的原始事件编码，需要在任何线程打开计数器之前设置
+   * 默认在Intel处理器上使用FP_ARITH_INST_RETIRED中所有打包的单双精度指令，其他处理器上为0，表示不统计
+   * @param config perf_event的原始事件编码，为0时不统计
+   */
+  static void set_vector_event(uint64_t config);
+
+  ~HardwareCounters();
+
+  HardwareCounters(const HardwareCounters &) = delete;
+
+  HardwareCounters &operator=(const HardwareCounters &) = delete;
+
+  /**
+   * 返回当前线程是否成功打开了计数器
+   * @return 是否可用
+   */
+  bool available() const;
+
+  /**
+   * 读取计数器当前的值
+   * @param values 读取到的值
+   * @return 是否读取成功
+   */
+  bool Read(HardwareCounterValues &values) const;
+
+ private:
+  HardwareCounters();
+
+  /// 计数器在组中的顺序对应的事件
+  enum class CounterEvent {
+    kCycles = 0,
+    kInstructions = 1,
+    kLLCMisses = 2,
+    kVectorInstructions = 3,
+  };
+
+  int group_fd_ = -1; /// 计数器组的组长，也就是周期计数器
+  std::vector<int> fds_; /// 成功打开的计数器
+  std::vector<CounterEvent> events_; /// 每个打开的计数器对应的事件
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_HARDWARE_COUNTER_HPP_
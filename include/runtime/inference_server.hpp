@@ -0,0 +1,180 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_INFERENCE_SERVER_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_INFERENCE_SERVER_HPP_
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "data/tensor.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/lock_free_queue.hpp"
+
+namespace kuiper_infer {
+/// 推理请求完成时的回调，参数是该请求的输出张量，在推理线程中调用
+using InferenceCallback = std::function<void(const std::shared_ptr<Tensor<float>> &)>;
+
+/// 异步推理服务，将单个样本的推理请求合并成批次执行
+/// 请求先放入无锁队列，推理线程从第一个请求入队开始最多等待给定的时间，批次满了或者超时后执行一次批量的Forward
+/// 服务运行期间可以在后台构建新版本的计算图并原子地替换，替换过程中请求不会中断
+class InferenceServer {
+ public:
+  /**
+   * 创建推理服务并启动推理线程
+   * @param graph 已经Build完成的计算图，服务运行期间不能重新Build
+   * @param max_batch_size 每个批次最多合并的请求数量，不能超过计算图推理时的最大批次
+   * @param max_latency_us 批次中第一个请求最多等待的时间，单位为微秒，为0时不等待后续请求
+   * @param worker_num 推理线程的数量，每个推理线程使用自己的执行上下文，计算图设置了副本时等于副本的数量，忽略这个参数
+   * @param queue_capacity 请求队列的容量，队列满时提交请求的线程会等待
+   * @param metrics 记录请求数量、批次数量、队列深度和请求延迟的指标集合，为空时使用计算图的指标集合
+   */
+  InferenceServer(std::shared_ptr<RuntimeGraph> graph, uint32_t max_batch_size, uint32_t max_latency_us,
+                  uint32_t worker_num = 1, uint32_t queue_capacity = 1024,
+                  std::shared_ptr<RuntimeMetrics> metrics = nullptr);
+
+  ~InferenceServer();
+
+  InferenceServer(const InferenceServer &) = delete;
+
+  InferenceServer &operator=(const InferenceServer &) = delete;
+
+  /**
+   * 提交一个推理请求
+   * @param input 单个样本的输入张量，和同一批次中其他请求的形状相同时才会合并
+   * @return 请求的输出张量，推理完成后可以获取，服务已经停止时为空
+   */
+  std::future<std::shared_ptr<Tensor<float>>> Submit(const std::shared_ptr<Tensor<float>> &input);
+
+  /**
+   * 提交一个推理请求，推理完成后在推理线程中调用回调
+   * 服务已经停止时拒绝请求，在当前线程中以空的输出调用回调
+   * @param input 单个样本的输入张量
+   * @param callback 推理完成时的回调
+   * @return 请求是否被接受
+   */
+  bool Submit(const std::shared_ptr<Tensor<float>> &input, InferenceCallback callback);
+
+  /**
+   * 在后台线程上Build新的计算图，为每个推理线程创建执行上下文并用一个满批次预热，完成后原子地替换服务使用的计算图
+   * 已经开始的批次继续使用旧的计算图，最后一个使用旧计算图的批次完成时由持有它的线程释放旧的计算图和执行上下文
+   * 后台Build和推理线程共享CPU，可以给新计算图设置一个较小的线程池来限制对在线请求的影响
+   * 多次替换在同一个后台线程上按照调用的顺序依次执行，服务已经停止时不替换
+   * @param graph 还没有Build的新计算图
+   * @param input_name 计算图的输入节点
+   * @param output_name 计算图的输出节点
+   * @param warmup_input 预热使用的单个样本输入，为空时不预热，第一个批次会包含规划内存的时间
+   * @return 是否替换成功，新计算图的最大批次小于服务的最大批次，或者设置的副本数量和推理线程的数量不同时不替换
+   */
+  std::future<bool> SwapGraph(std::shared_ptr<RuntimeGraph> graph, const std::string &input_name,
+                              const std::string &output_name,
+                              const std::shared_ptr<Tensor<float>> &warmup_input = nullptr);
+
+  /**
+   * 返回当前服务使用的计算图
+   * @return 计算图
+   */
+  std::shared_ptr<RuntimeGraph> graph() const;
+
+  /**
+   * 返回当前计算图的版本，创建服务时为0，每次替换成功之后加1
+   * @return 计算图的版本
+   */
+  uint64_t graph_version() const;
+
+  /**
+   * 处理完已经提交的请求之后停止推理线程，停止之后不能再提交请求
+   */
+  void Stop();
+
+  /**
+   * 返回已经完成的请求数量
+   * @return 完成的请求数量
+   */
+  uint64_t request_num() const;
+
+  /**
+   * 返回已经执行的批次数量
+   * @return 执行的批次数量
+   */
+  uint64_t batch_num() const;
+
+ private:
+  /// 队列中的推理请求
+  struct InferenceRequest {
+    std::shared_ptr<Tensor<float>> input; /// 输入张量
+    InferenceCallback callback; /// 推理完成时的回调
+    std::chrono::steady_clock::time_point submit_time; /// 请求提交的时间
+  };
+
+  /// 一个版本的计算图，推理线程在每个批次开始时取得当前版本，批次结束之后释放
+  struct GraphVersion {
+    std::shared_ptr<RuntimeGraph> graph; /// 执行推理的计算图
+    std::vector<std::shared_ptr<ExecutionContext>> contexts; /// 每个推理线程的执行上下文，设置了副本时是各个副本
+    uint64_t version = 0; /// 计算图的版本
+  };
+
+  /**
+   * 为计算图的每个推理线程创建执行上下文
+   * @param graph 已经Build完成的计算图
+   * @param version 计算图的版本
+   * @return 新的版本
+   */
+  std::shared_ptr<GraphVersion> CreateVersion(std::shared_ptr<RuntimeGraph> graph, uint64_t version) const;
+
+  /**
+   * 返回当前的版本
+   * @return 当前的版本
+   */
+  std::shared_ptr<GraphVersion> CurrentVersion() const;
+
+  /**
+   * 推理线程的主循环
+   * @param worker_index 推理线程的编号
+   */
+  void WorkerLoop(uint32_t worker_index);
+
+  /**
+   * 后台替换线程的主循环，依次执行提交的替换，停止之后执行完剩余的替换再退出
+   */
+  void SwapLoop();
+
+  /**
+   * 从队列中取出一个请求，队列为空时等待到给定的时间
+   * @param request 取出的请求
+   * @param deadline 最多等待到的时间
+   * @return 是否取到了请求
+   */
+  bool PopRequest(InferenceRequest &request, std::chrono::steady_clock::time_point deadline);
+
+  std::shared_ptr<GraphVersion> version_; /// 当前的计算图版本，通过原子操作读取和替换
+  uint32_t max_batch_size_ = 1; /// 每个批次最多合并的请求数量
+  uint32_t worker_num_ = 1; /// 推理线程的数量
+  std::chrono::microseconds max_latency_; /// 批次中第一个请求最多等待的时间
+  LockFreeQueue<InferenceRequest> requests_; /// 等待推理的请求
+  std::vector<std::thread> workers_; /// 推理线程
+  std::mutex swap_mutex_; /// 保护等待执行的替换和替换线程的状态
+  std::condition_variable swap_cond_;
+  std::deque<std::function<void()>> swap_tasks_; /// 等待后台线程执行的替换
+  std::thread swap_thread_; /// 后台Build和替换计算图的线程，第一次替换时启动
+  bool swap_stop_ = false; /// 是否已经停止接受新的替换
+  std::atomic<uint32_t> pending_num_{0}; /// 已经登记但还没有被取走的请求数量，登记早于放入队列
+  std::atomic<uint32_t> sleeping_num_{0}; /// 正在等待新请求的推理线程数量
+  std::atomic<uint64_t> request_num_{0}; /// 已经完成的请求数量
+  std::atomic<uint64_t> batch_num_{0}; /// 已经执行的批次数量
+  std::shared_ptr<RuntimeMetrics> metrics_; /// 记录服务指标的指标集合，为空时不记录
+  MetricCounter *request_counter_ = nullptr; /// 完成的请求数量
+  MetricCounter *batch_counter_ = nullptr; /// 执行的批次数量
+  MetricGauge *queue_depth_ = nullptr; /// 队列中等待的请求数量
+  LatencyHistogram *queue_latency_ = nullptr; /// 请求从提交到所在批次开始推理的时间
+  LatencyHistogram *request_latency_ = nullptr; /// 请求从提交到回调开始的时间
+  std::atomic<bool> stop_{false}; /// 推理线程是否需要退出
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_INFERENCE_SERVER_HPP_
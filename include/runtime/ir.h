@@ -17,6 +17,7 @@
 
 #include <initializer_list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -145,7 +146,7 @@ class Attribute
 {
 public:
     Attribute()
-        : type(0)
+        : type(0), mapped_size(0)
     {
     }
 
@@ -155,11 +156,19 @@ public:
 
     Attribute(const std::initializer_list<int>& shape, const std::vector<float>& t);
 
-    // 0=null 1=f32 2=f64 3=f16 4=i32 5=i64 6=i16 7=i8 8=u8 9=bool
+    // 0=null 1=f32 2=f64 3=f16 4=i32 5=i64 6=i16 7=i8 8=u8 9=bool 10=cp64 11=cp128 12=cp32 13=bf16
     int type;
     std::vector<int> shape;
 
     std::vector<char> data;
+
+    // stored weights inside the memory mapped bin file, used instead of data to avoid copying
+    std::shared_ptr<const char> mapped_data;
+    size_t mapped_size;
+
+    // the weights from either data or the mapped bin file
+    const char* data_ptr() const;
+    size_t data_size() const;
 };
 
 bool operator==(const Attribute& lhs, const Attribute& rhs);
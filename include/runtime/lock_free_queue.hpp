@@ -0,0 +1,236 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_LOCK_FREE_QUEUE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_LOCK_FREE_QUEUE_HPP_
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+/// 有界的多生产者多消费者无锁队列，每个位置带有序号，生产者和消费者通过比较序号和位置判断该位置是否可用
+template<typename T>
+class LockFreeQueue {
+ public:
+  /**
+   * 创建队列
+   * @param capacity 队列的容量，会向上取整为2的幂
+   */
+  explicit LockFreeQueue(uint32_t capacity) {
+    CHECK(capacity > 0) << "The capacity of queue must be greater than zero";
+    size_t cell_num = 1;
+    while (cell_num < capacity) {
+      cell_num <<= 1;
+    }
+    mask_ = cell_num - 1;
+    cells_ = std::make_unique<Cell[]>(cell_num);
+    for (size_t i = 0; i < cell_num; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  LockFreeQueue(const LockFreeQueue &) = delete;
+
+  LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+  /**
+   * 将元素放入队列尾部
+   * @param value 放入的元素，放入成功时被移走
+   * @return 队列已满时返回false
+   */
+  bool Push(T &value) {
+    Cell *cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * 从队列头部取出元素
+   * @param value 取出的元素
+   * @return 队列为空时返回false
+   */
+  bool Pop(T &value) {
+    Cell *cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data);
+    // 取走之后释放元素持有的资源，不等到这个位置被再次写入
+    cell->data = T();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * 返回队列的容量
+   * @return 队列的容量
+   */
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence{0}; /// 等于位置时可以写入，等于位置加1时可以读取
+    T data;
+  };
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  alignas(64) std::atomic<size_t> enqueue_pos_{0}; /// 下一个写入的位置
+  alignas(64) std::atomic<size_t> dequeue_pos_{0}; /// 下一个读取的位置
+};
+
+/// 有界的单生产者单消费者无锁队列，只能有一个线程写入和一个线程读取
+/// 写入和读取的位置各自只被一个线程修改，不需要比较交换，用于流水线中相邻阶段之间传递数据
+template<typename T>
+class SpscQueue {
+ public:
+  /**
+   * 创建队列
+   * @param capacity 队列的容量，会向上取整为2的幂
+   */
+  explicit SpscQueue(uint32_t capacity) {
+    CHECK(capacity > 0) << "The capacity of queue must be greater than zero";
+    size_t cell_num = 1;
+    while (cell_num < capacity) {
+      cell_num <<= 1;
+    }
+    mask_ = cell_num - 1;
+    cells_ = std::make_unique<T[]>(cell_num);
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  /**
+   * 将元素放入队列尾部，只能在生产者线程中调用
+   * @param value 放入的元素，放入成功时被移走
+   * @return 队列已满时返回false
+   */
+  bool Push(T &value) {
+    const size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    if (pos - dequeue_pos_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    cells_[pos & mask_] = std::move(value);
+    enqueue_pos_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * 从队列头部取出元素，只能在消费者线程中调用
+   * @param value 取出的元素
+   * @return 队列为空时返回false
+   */
+  bool Pop(T &value) {
+    const size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    if (pos == enqueue_pos_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(cells_[pos & mask_]);
+    cells_[pos & mask_] = T();
+    dequeue_pos_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * 返回队列是否为空，在其他线程中调用时只是一个瞬间的近似值
+   * @return 是否为空
+   */
+  bool empty() const {
+    return dequeue_pos_.load(std::memory_order_acquire) == enqueue_pos_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * 返回队列的容量
+   * @return 队列的容量
+   */
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+ private:
+  std::unique_ptr<T[]> cells_;
+  size_t mask_ = 0;
+  alignas(64) std::atomic<size_t> enqueue_pos_{0}; /// 下一个写入的位置，只由生产者修改
+  alignas(64) std::atomic<size_t> dequeue_pos_{0}; /// 下一个读取的位置，只由消费者修改
+};
+
+/// 无锁队列的消费者线程在队列为空时的等待和唤醒，流水线的每个阶段使用一个
+/// 生产者只在消费者正在等待时才加锁唤醒，消费者每次最多睡眠kWaitTimeout后重新检查，错过唤醒时最多延迟这么久
+class QueueWaiter {
+ public:
+  /// 消费者等待时最长的睡眠时间
+  static constexpr std::chrono::microseconds kWaitTimeout{500};
+
+  /**
+   * 等待条件满足或者到达截止时间
+   * @param ready 等待的条件
+   * @param deadline 截止时间
+   * @return 条件是否满足，到达截止时间时返回false
+   */
+  template<typename Predicate>
+  bool Wait(Predicate ready,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+    while (!ready()) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        return false;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleeping_ = true;
+      cond_.wait_until(lock, now + std::min<std::chrono::steady_clock::duration>(deadline - now, kWaitTimeout),
+                       ready);
+      sleeping_ = false;
+    }
+    return true;
+  }
+
+  /// 唤醒正在等待的消费者线程
+  void Notify() {
+    if (sleeping_) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+      }
+      cond_.notify_one();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::atomic<bool> sleeping_{false}; /// 消费者线程是否正在等待
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_LOCK_FREE_QUEUE_HPP_
@@ -0,0 +1,100 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_NUMA_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_NUMA_HPP_
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace kuiper_infer {
+/// 内存在NUMA节点之间的分布方式
+enum class NumaMemoryPolicy {
+  kDefault = 0, /// 由操作系统决定，通常是第一次访问的线程所在的节点
+  kBind = 1, /// 放在指定的节点上
+  kInterleave = 2, /// 按页交错分布到所有节点上，所有节点的线程访问时带宽均衡
+};
+
+/**
+ * 返回系统中NUMA节点的数量，读取/sys/devices/system/node，不是NUMA系统时为1
+ * @return NUMA节点的数量
+ */
+uint32_t NumaNodeNum();
+
+/**
+ * 返回一个NUMA节点上的CPU编号
+ * @param node NUMA节点的编号
+ * @return 节点上的CPU编号，不是NUMA系统时返回所有的CPU
+ */
+std::vector<uint32_t> NumaNodeCpus(uint32_t node);
+
+/**
+ * 返回当前线程正在运行的CPU所在的NUMA节点
+ * @return NUMA节点的编号，无法获取时返回0
+ */
+uint32_t CurrentNumaNode();
+
+/**
+ * 返回当前线程绑定的NUMA节点，线程池根据它选择提交任务的队列
+ * @return NUMA节点的编号，没有绑定时返回-1
+ */
+int32_t PreferredNumaNode();
+
+/**
+ * 返回当前线程可以运行的CPU
+ * @return CPU编号，无法获取时为空
+ */
+std::vector<uint32_t> ThreadCpus();
+
+/**
+ * 把一组CPU按照编号顺序平均切分成连续的若干组，编号相邻的CPU通常共享缓存
+ * @param group_num 切分的组数，不能超过CPU的数量
+ * @param cpus 切分的CPU，为空时使用当前线程可以运行的全部CPU
+ * @return 每组的CPU编号
+ */
+std::vector<std::vector<uint32_t>> SplitCpus(uint32_t group_num, const std::vector<uint32_t> &cpus = {});
+
+/**
+ * 设置当前线程可以运行的CPU
+ * @param cpus CPU编号
+ * @return 是否设置成功
+ */
+bool BindThreadToCpus(const std::vector<uint32_t> &cpus);
+
+/**
+ * 将当前线程绑定到一个NUMA节点的所有CPU上
+ * @param node NUMA节点的编号
+ * @return 是否绑定成功
+ */
+bool BindThreadToNumaNode(uint32_t node);
+
+/**
+ * 按照策略设置一段内存所在的NUMA节点，已经分配了物理页的内存会被迁移，内存按页对齐处理
+ * 只有一个NUMA节点时不做任何处理
+ * @param data 内存的起始地址
+ * @param bytes 内存的字节数
+ * @param policy 内存的分布方式
+ * @param node kBind时内存所在的NUMA节点
+ * @return 是否设置成功
+ */
+bool PlaceMemory(const void *data, size_t bytes, NumaMemoryPolicy policy, uint32_t node = 0);
+
+/// 在作用域内将当前线程绑定到一个NUMA节点，析构时恢复之前的CPU亲和性和绑定的节点
+class NumaNodeScope {
+ public:
+  /**
+   * 绑定当前线程
+   * @param node NUMA节点的编号，小于0时不做任何处理
+   */
+  explicit NumaNodeScope(int32_t node);
+
+  ~NumaNodeScope();
+
+  NumaNodeScope(const NumaNodeScope &) = delete;
+
+  NumaNodeScope &operator=(const NumaNodeScope &) = delete;
+
+ private:
+  bool bound_ = false; /// 是否修改了当前线程的绑定
+  int32_t previous_node_ = -1; /// 之前绑定的NUMA节点
+  std::vector<uint32_t> previous_cpus_; /// 之前可以运行的CPU
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_NUMA_HPP_
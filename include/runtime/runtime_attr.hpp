@@ -5,31 +5,86 @@
 #ifndef KUIPER_INFER_INCLUDE_PARSER_RUNTIME_ATTR_HPP_
 #define KUIPER_INFER_INCLUDE_PARSER_RUNTIME_ATTR_HPP_
 #include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 #include <glog/logging.h>
 #include "status_code.hpp"
 #include "runtime_datatype.hpp"
+#include "data/half.hpp"
 
 namespace kuiper_infer {
 
 /// 计算图节点的属性信息
 struct RuntimeAttribute {
   std::vector<char> weight_data; /// 节点中的权重参数
+  std::shared_ptr<const char> mapped_data; /// 映射到内存的模型文件中的权重参数，存在时代替weight_data，不需要复制
+  size_t mapped_size = 0; /// 映射的权重参数的字节数
   std::vector<int> shape;  /// 节点中的形状信息
   RuntimeDataType type = RuntimeDataType::kTypeUnknown; /// 节点中的数据类型
 
+  /**
+   * 返回权重参数的起始地址，权重可能保存在weight_data中或者映射的模型文件中
+   * @return 权重参数的起始地址
+   */
+  const char *weight_ptr() const {
+    return mapped_data ? mapped_data.get() : weight_data.data();
+  }
+
+  /**
+   * 返回权重参数的字节数
+   * @return 权重参数的字节数
+   */
+  size_t weight_bytes() const {
+    return mapped_data ? mapped_size : weight_data.size();
+  }
+
+  /**
+   * 返回权重参数的元素数量，按照保存的类型计算
+   * @return 元素数量
+   */
+  size_t element_num() const {
+    const bool half = type == RuntimeDataType::kTypeFloat16 || type == RuntimeDataType::kTypeBFloat16;
+    return weight_bytes() / (half ? sizeof(uint16_t) : sizeof(float));
+  }
+
   /**
    * 从节点中加载权重参数
    * @tparam T 权重类型
    * @return 权重参数数组
    */
   template<class T> //
-  std::vector<T> get();
+  std::vector<T> get() const;
+
+  /**
+   * 按照T读取权重参数，保存的类型就是T并且地址按照T对齐时直接返回权重所在的内存，不复制
+   * 映射的权重在文件中没有对齐，或者需要从半精度展开为float时，转换到buffer中再返回
+   * @tparam T 权重类型
+   * @param buffer 需要转换时使用的内存
+   * @return 权重参数的起始地址，元素数量由element_num返回，在属性和buffer都有效时可用
+   */
+  template<class T>
+  const T *view(std::vector<T> &buffer) const;
 };
 
 template<class T>
-std::vector<T> RuntimeAttribute::get() {
+const T *RuntimeAttribute::view(std::vector<T> &buffer) const {
+  const bool same_type = (type == RuntimeDataType::kTypeFloat32 && std::is_same<T, float>::value) ||
+      ((type == RuntimeDataType::kTypeFloat16 || type == RuntimeDataType::kTypeBFloat16)
+          && std::is_same<T, uint16_t>::value);
+  if (same_type && reinterpret_cast<uintptr_t>(weight_ptr()) % alignof(T) == 0) {
+    CHECK_EQ(weight_bytes() % sizeof(T), 0);
+    return reinterpret_cast<const T *>(weight_ptr());
+  }
+  buffer = get<T>();
+  return buffer.data();
+}
+
+template<class T>
+std::vector<T> RuntimeAttribute::get() const {
   /// 检查节点属性中的权重类型
-  CHECK(!weight_data.empty());
+  CHECK(weight_bytes() != 0);
   CHECK(type != RuntimeDataType::kTypeUnknown);
   std::vector<T> weights;
   switch (type) {
@@ -37,10 +92,28 @@ std::vector<T> RuntimeAttribute::get() {
       const bool is_float = std::is_same<T, float>::value;
       CHECK_EQ(is_float, true);
       const uint32_t float_size = sizeof(float);
-      CHECK_EQ(weight_data.size() % float_size, 0);
-      for (uint32_t i = 0; i < weight_data.size() / float_size; ++i) {
-        float weight = *((float *) weight_data.data() + i);
-        weights.push_back(weight);
+      CHECK_EQ(weight_bytes() % float_size, 0);
+      // 映射的权重不一定按照float对齐，整块复制而不是逐个读取
+      weights.resize(weight_bytes() / float_size);
+      memcpy(weights.data(), weight_ptr(), weight_bytes());
+      break;
+    }
+    case RuntimeDataType::kTypeFloat16:
+    case RuntimeDataType::kTypeBFloat16: { /// 加载的数据类型是半精度
+      // 按照float加载时展开为float，按照uint16_t加载时返回原始的编码，由Layer保持压缩的权重
+      const bool is_float = std::is_same<T, float>::value;
+      const bool is_raw = std::is_same<T, uint16_t>::value;
+      CHECK_EQ(is_float || is_raw, true);
+      CHECK_EQ(weight_bytes() % sizeof(uint16_t), 0);
+      std::vector<uint16_t> raw_weights(weight_bytes() / sizeof(uint16_t));
+      memcpy(raw_weights.data(), weight_ptr(), weight_bytes());
+      weights.resize(raw_weights.size());
+      if (is_raw) {
+        memcpy(weights.data(), raw_weights.data(), weight_bytes());
+      } else if (type == RuntimeDataType::kTypeFloat16) {
+        HalfToFloat(raw_weights.data(), raw_weights.size(), reinterpret_cast<float *>(weights.data()));
+      } else {
+        BFloat16ToFloat(raw_weights.data(), raw_weights.size(), reinterpret_cast<float *>(weights.data()));
       }
       break;
     }
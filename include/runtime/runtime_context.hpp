@@ -0,0 +1,177 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CONTEXT_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CONTEXT_HPP_
+#include <vector>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "data/tensor.hpp"
+#include "runtime/runtime_memory.hpp"
+#include "runtime/runtime_profiler.hpp"
+#include "runtime/runtime_dump.hpp"
+#include "runtime/thread_pool.hpp"
+
+namespace kuiper_infer {
+/// 一种输入形状下的执行计划，输入形状变化时执行上下文在多个计划之间切换
+struct RuntimeGraphPlan {
+  std::vector<int32_t> input_shape; /// 计划对应的输入操作数形状，第一维是batch
+  std::vector<std::vector<int32_t>> output_shapes; /// 执行序列中每个节点输出操作数的形状
+  RuntimeMemoryPlanner memory_planner; /// 该输入形状下中间张量和临时内存的规划
+  int32_t numa_node = -1; /// 规划的内存已经放置到的NUMA节点，-1表示没有放置
+  uint32_t thread_num = 0; /// 规划时线程池的线程数量，部分Layer按照线程数量划分临时内存
+  uint32_t lazy_layer_num = 0; /// 规划时还没有创建的延迟Layer数量，和计算图中的数量不同时需要重新规划
+  uint32_t micro_batch_size = 0; /// 每个微批次的样本数量，为0时整个批次一起执行
+  std::vector<uint32_t> segment_bounds; /// 微批次执行时各段在执行序列中的边界，第s段是[bounds[s], bounds[s + 1])
+};
+
+/// 计算图的执行上下文，持有推理过程中的中间张量、Layer的临时内存和节点的调度状态
+/// 同一个计算图的多个上下文共享Layer和权重，不同线程各自使用一个上下文就可以同时调用Forward
+/// 同一个上下文同一时刻只能用于一次推理
+/// 计算图在CUDA设备上执行时每个上下文有自己的流，一个上下文复制输入的同时其他上下文的内核可以继续计算
+class ExecutionContext {
+ public:
+  /**
+   * 设置上下文中最多缓存的执行计划数量，输入形状变化时最近使用的计划保留在缓存中
+   * @param plan_cache_size 缓存的执行计划数量，至少为1
+   */
+  void set_plan_cache_size(uint32_t plan_cache_size);
+
+  /**
+   * 返回上下文中最多缓存的执行计划数量
+   * @return 缓存的执行计划数量
+   */
+  uint32_t plan_cache_size() const;
+
+  /**
+   * 返回上下文中当前缓存的执行计划数量
+   * @return 缓存中的执行计划数量
+   */
+  uint32_t cached_plan_num() const;
+
+  /**
+   * 返回当前执行计划中间张量的内存规划结果
+   * @return 内存规划
+   */
+  const RuntimeMemoryPlanner &memory_planner() const;
+
+  /**
+   * 设置上下文使用的性能分析器，设置之后每次推理都会记录各个节点的执行情况
+   * @param profiler 性能分析器，为空时不记录
+   */
+  void set_profiler(std::shared_ptr<RuntimeProfiler> profiler);
+
+  /**
+   * 返回上下文使用的性能分析器
+   * @return 性能分析器，没有设置时为空
+   */
+  const std::shared_ptr<RuntimeProfiler> &profiler() const;
+
+  /**
+   * 设置上下文使用的中间输出dumper，设置之后每次推理都把选中节点的输出交给它写入文件
+   * @param activation_dumper 中间输出dumper，为空时不保存
+   */
+  void set_activation_dumper(std::shared_ptr<ActivationDumper> activation_dumper);
+
+  /**
+   * 返回上下文使用的中间输出dumper
+   * @return 中间输出dumper，没有设置时为空
+   */
+  const std::shared_ptr<ActivationDumper> &activation_dumper() const;
+
+  /**
+   * 将上下文绑定到一个NUMA节点，之后的推理在调用线程绑定到这个节点的CPU上执行，
+   * 提交的并行任务优先由这个节点上的工作线程执行，执行计划中的中间张量和临时内存也迁移到这个节点
+   * 工作线程需要先通过ThreadPool::set_numa_binding绑定到各个节点
+   * @param numa_node NUMA节点的编号，-1表示不绑定
+   */
+  void set_numa_node(int32_t numa_node);
+
+  /**
+   * 返回上下文绑定的NUMA节点
+   * @return NUMA节点的编号，没有绑定时为-1
+   */
+  int32_t numa_node() const;
+
+  /**
+   * 设置上下文推理时使用的线程池，所有Layer的并行计算都提交到这个线程池，优先于计算图设置的线程池
+   * 多个上下文可以共享同一个线程池
+   * @param thread_pool 线程池，为空时使用计算图的线程池
+   */
+  void set_thread_pool(std::shared_ptr<ThreadPool> thread_pool);
+
+  /**
+   * 返回上下文推理时使用的线程池
+   * @return 线程池，没有设置时为空
+   */
+  const std::shared_ptr<ThreadPool> &thread_pool() const;
+
+  /**
+   * 绑定调用者持有的输入张量，之后不传入输入的Forward直接读取这些张量，不做复制
+   * 调用者可以在两次推理之间原地改写张量的内容，张量在解除绑定之前必须保持有效
+   * @param inputs 输入张量，数量就是每次推理的批次大小
+   */
+  void BindInputs(const std::vector<std::shared_ptr<Tensor<float>>> &inputs);
+
+  /**
+   * 将调用者的一块连续内存按照批次划分为输入张量并绑定
+   * @param data 内存的起始地址，至少能容纳形状中全部的元素
+   * @param shapes 输入的形状，第一维是batch，支持2、3、4维
+   */
+  void BindInputs(float *data, const std::vector<int32_t> &shapes);
+
+  /**
+   * 绑定调用者持有的输出张量，之后使用该上下文的Forward把计算图的输出直接写入这些张量并返回它们
+   * 张量的形状必须和计算图的输出相同，数量不能少于推理的批次大小
+   * @param outputs 输出张量
+   */
+  void BindOutputs(const std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+  /**
+   * 将调用者的一块连续内存按照批次划分为输出张量并绑定
+   * @param data 内存的起始地址，至少能容纳形状中全部的元素
+   * @param shapes 输出的形状，第一维是batch，支持2、3、4维
+   */
+  void BindOutputs(float *data, const std::vector<int32_t> &shapes);
+
+  /**
+   * 解除输入和输出张量的绑定，之后的Forward重新返回上下文内存中的输出张量
+   */
+  void ClearBindings();
+
+  /**
+   * 返回绑定的输入张量
+   * @return 输入张量，没有绑定时为空
+   */
+  const std::vector<std::shared_ptr<Tensor<float>>> &bound_inputs() const;
+
+  /**
+   * 返回绑定的输出张量
+   * @return 输出张量，没有绑定时为空
+   */
+  const std::vector<std::shared_ptr<Tensor<float>>> &bound_outputs() const;
+
+ private:
+  friend class RuntimeGraph;
+
+  uint64_t build_id_ = 0; /// 执行计划所属的计算图构建编号，计算图重新Build之后原有的计划失效
+  std::list<RuntimeGraphPlan> plans_; /// 最近使用的执行计划，第一个是当前使用的计划
+  uint32_t plan_cache_size_ = 4; /// 最多缓存的执行计划数量
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> output_datas_; /// 本次推理中每个节点的输出张量
+  std::vector<double> run_durations_; /// 本次推理中每个节点的执行时间
+  std::vector<bool> active_ops_; /// 本次推理需要执行的节点，为空时执行全部节点
+  std::vector<float> input_abs_max_; /// 标定时每个节点输入的最大绝对值，为空时不统计
+  std::vector<std::atomic<uint32_t>> in_degrees_; /// 并行执行时每个节点尚未完成的前驱节点数量
+  std::atomic<uint32_t> remain_ops_{0}; /// 并行执行时尚未完成的节点数量
+  std::shared_ptr<RuntimeProfiler> profiler_; /// 记录节点执行情况的性能分析器
+  std::shared_ptr<ActivationDumper> activation_dumper_; /// 保存节点输出的dumper
+  int32_t numa_node_ = -1; /// 绑定的NUMA节点，-1表示不绑定
+  std::shared_ptr<ThreadPool> thread_pool_; /// 推理时使用的线程池，为空时使用计算图的线程池
+  std::vector<std::shared_ptr<Tensor<float>>> bound_inputs_; /// 调用者绑定的输入张量
+  std::vector<std::shared_ptr<Tensor<float>>> bound_outputs_; /// 调用者绑定的输出张量，计算图的输出直接写入其中
+  std::unique_ptr<DeviceStream> device_stream_; /// 设备上的节点和复制使用的流，第一次在设备上推理时创建
+  PinnedBuffer pinned_inputs_; /// 计算图输入复制到设备之前暂存的页锁定内存
+  PinnedBuffer pinned_outputs_; /// 计算图输出从设备复制回来时暂存的页锁定内存
+  bool outputs_pinned_ = false; /// 本次推理的输出是否正在异步复制到页锁定内存中
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_CONTEXT_HPP_
@@ -14,5 +14,7 @@ enum class RuntimeDataType {
   kTypeInt16 = 6,
   kTypeInt8 = 7,
   kTypeUInt8 = 8,
+  kTypeBFloat16 = 13,
+  kTypeInt4 = 14, /// 只在运行时按组量化的权重中使用，模型文件中没有这个类型
 };
 #endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_DATATYPE_HPP_
@@ -0,0 +1,127 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_DUMP_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_DUMP_HPP_
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include "data/tensor.hpp"
+
+namespace kuiper_infer {
+/// 一个计算节点的输出和参考输出之间的误差统计
+struct ActivationDiff {
+  std::string name; /// 计算节点的名称
+  uint32_t records = 0; /// 参与比较的推理次数
+  uint64_t elements = 0; /// 参与比较的元素数量
+  bool shape_matched = true; /// 两次运行的输出形状和推理次数是否一致，不一致时只比较形状相同的部分
+  double max_abs_error = 0.; /// 最大绝对误差
+  double mean_abs_error = 0.; /// 平均绝对误差
+  double rmse = 0.; /// 均方根误差
+  double max_rel_error = 0.; /// 最大相对误差，参考值的绝对值小于1e-6时按照1e-6计算
+  double cosine_similarity = 1.; /// 两次输出展平之后的余弦相似度
+};
+
+/// 推理时把选中的计算节点的输出写入文件，用于和参考运行逐层比较精度
+/// 节点的输出先复制到内存中，再由后台线程写入目录下以节点名称命名的.kdump文件，推理线程不等待磁盘
+/// 同一个节点每次推理的输出依次追加在文件中，多个上下文和线程可以同时使用同一个dumper
+class ActivationDumper {
+ public:
+  /**
+   * 创建dumper并启动后台写入线程，目录中已有的同名文件会被覆盖
+   * @param directory 保存文件的目录，需要已经存在
+   * @param operator_names 需要保存输出的节点名称，为空时保存所有节点
+   * @param max_pending_bytes 尚未写入磁盘的数据上限，超过时推理线程等待后台线程写入
+   */
+  explicit ActivationDumper(std::string directory, const std::vector<std::string> &operator_names = {},
+                            size_t max_pending_bytes = size_t(256) << 20);
+
+  ~ActivationDumper();
+
+  ActivationDumper(const ActivationDumper &) = delete;
+
+  ActivationDumper &operator=(const ActivationDumper &) = delete;
+
+  /**
+   * 返回是否需要保存一个节点的输出
+   * @param name 节点的名称
+   * @return 是否需要保存
+   */
+  bool Selected(const std::string &name) const;
+
+  /**
+   * 复制一个节点本次推理的输出并交给后台线程写入，输出在CPU上的数据必须是最新的
+   * @param name 节点的名称
+   * @param outputs 每个批次的输出张量
+   */
+  void Dump(const std::string &name, const std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+  /**
+   * 等待已经提交的输出全部写入磁盘
+   * @return 写入过程中是否没有发生错误
+   */
+  bool Flush();
+
+  /**
+   * 返回保存文件的目录
+   * @return 目录
+   */
+  const std::string &directory() const;
+
+  /**
+   * 返回目录中保存一个节点输出的文件路径，节点名称中的特殊字符替换为下划线
+   * @param directory 目录
+   * @param name 节点的名称
+   * @return 文件路径
+   */
+  static std::string DumpPath(const std::string &directory, const std::string &name);
+
+  /**
+   * 逐个节点比较两个目录中保存的输出，只比较两个目录中都存在的节点，结果按照节点第一次保存的顺序排列
+   * @param reference_directory 参考运行保存的目录
+   * @param directory 需要检查的运行保存的目录
+   * @return 每个节点的误差统计
+   */
+  static std::vector<ActivationDiff> Compare(const std::string &reference_directory, const std::string &directory);
+
+  /**
+   * 将误差统计整理为表格
+   * @param diffs 每个节点的误差统计
+   * @return 表格文本
+   */
+  static std::string CompareReport(const std::vector<ActivationDiff> &diffs);
+
+ private:
+  /// 等待写入的一次输出
+  struct DumpRecord {
+    std::string name; /// 节点的名称
+    uint32_t sequence = 0; /// 节点第一次提交的顺序
+    std::vector<uint32_t> shapes; /// 每个张量的通道数、行数和列数
+    std::vector<float> data; /// 所有张量依次排列的数据
+  };
+
+  void WriteLoop();
+
+  std::string directory_; /// 保存文件的目录
+  std::set<std::string> operator_names_; /// 需要保存输出的节点名称，为空时保存所有节点
+  size_t max_pending_bytes_ = 0; /// 尚未写入磁盘的数据上限
+
+  std::mutex mutex_;
+  std::condition_variable queue_cond_; /// 有新的记录或者需要停止时通知后台线程
+  std::condition_variable done_cond_; /// 有记录写入完成时通知等待的推理线程
+  std::deque<DumpRecord> queue_; /// 等待写入的记录
+  size_t pending_bytes_ = 0; /// 已经提交尚未写入完成的字节数
+  uint32_t next_sequence_ = 0; /// 下一个新节点的保存顺序
+  std::map<std::string, uint32_t> sequences_; /// 每个节点第一次提交的顺序
+  bool stop_ = false; /// 是否停止后台线程
+  bool failed_ = false; /// 写入是否发生过错误
+  std::map<std::string, FILE *> files_; /// 每个节点打开的文件，只在后台线程中访问
+  std::thread writer_; /// 后台写入线程
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_DUMP_HPP_
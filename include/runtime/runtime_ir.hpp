@@ -1,33 +1,44 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_IR_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_IR_HPP_
 #include <vector>
 #include <string>
 #include <glog/logging.h>
 #include <memory>
 #include <map>
 #include <queue>
+#include <atomic>
 
 #include "ir.h"
 #include "layer/abstract/layer.hpp"
 #include "runtime/runtime_operand.hpp"
+#include "runtime/runtime_memory.hpp"
+#include "runtime/runtime_context.hpp"
+#include "runtime/runtime_metrics.hpp"
+#include "runtime/runtime_pass.hpp"
 #include "runtime_op.hpp"
 
 namespace kuiper_infer {
 class RuntimeGraphShape {
  public:
   /**
-   * 如果图是第一次运行，则根据节点输入operand的形状准备好后续Layer计算中所需要的Tensor
-   * 如果图是第二次以上运行，则检查输入operand的形状和operand中张量的形状是否匹配
-   * @param operators 计算图中的计算节点
-   */
-  static void InitOperatorInputTensor(const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
-
-  /**
-   * 如果图是第一次运行，则根据节点输出operand的形状准备好后续Layer计算中所需要的Tensor
-   * 如果图是第二次以上运行，则检查输出operand的形状和operand中张量的形状是否匹配
+   * 如果图是第一次运行，则根据pnnx节点创建计算节点的输出operand，operand中只记录形状，张量由执行上下文创建
+   * 如果图是第二次以上运行，则检查输出operand的形状和pnnx节点中的形状是否匹配
    * @param pnnx_operators pnnx图节点
    * @param operators KuiperInfer计算图中的计算节点
    */
   static void InitOperatorOutputTensor(const std::vector<pnnx::Operator *> &pnnx_operators,
                                        const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+
+  /**
+   * 将所有操作数的批次维度设置为最大的批次大小，推理时可以输入不超过该大小的任意批次
+   * 需要在创建输出operand之前调用
+   * @param pnnx_operands pnnx图中的操作数，从编译缓存加载时为空
+   * @param operators KuiperInfer计算图中的计算节点
+   * @param max_batch_size 最大的批次大小
+   */
+  static void InitOperatorBatchSize(const std::vector<pnnx::Operand *> &pnnx_operands,
+                                    const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                    uint32_t max_batch_size);
 };
 
 /// 计算图结构，由多个计算节点和节点之间的数据流图组成
@@ -47,6 +58,13 @@ class RuntimeGraph {
    */
   void Build(const std::string &input_name, const std::string &output_name);
 
+  /**
+   * 构建有多个输出的计算图，执行序列只包含这些输出节点的祖先节点
+   * @param input_name 计算图输入节点的名称
+   * @param output_names 计算图输出节点的名称，第一个是Forward默认返回的输出
+   */
+  void Build(const std::string &input_name, const std::vector<std::string> &output_names);
+
   /**
    * 设置权重文件
    * @param bin_path 权重文件路径
@@ -72,21 +90,471 @@ class RuntimeGraph {
   const std::string &bin_path() const;
 
   /**
-   * 计算图的执行,根据广度优先搜索的顺序执行
-   * @param inputs 计算图的输入张量
+   * 计算图的执行,按照Build阶段得到的拓扑序列执行，使用计算图自带的执行上下文，不能在多个线程中同时调用
+   * @param inputs 计算图的输入张量，数量就是本次推理的批次大小，不能超过Build时确定的批次大小
    * @param debug 是否调试，如果调试则输出一些中间信息
    * @return 计算图的输出张量
    */
   std::vector<std::shared_ptr<Tensor<float>>> Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                                                       bool debug = false);
 
+  /**
+   * 使用给定的执行上下文执行计算图，中间张量和调度状态都保存在上下文中
+   * 多个线程使用各自的上下文可以同时调用，执行期间不能重新Build计算图
+   * @param context 执行上下文，计算图重新Build之后上下文中的执行计划会重新创建
+   * @param inputs 计算图的输入张量，数量就是本次推理的批次大小，不能超过Build时确定的批次大小
+   * @param debug 是否调试，如果调试则输出一些中间信息
+   * @return 计算图的输出张量，保存在上下文的内存中，下一次使用该上下文推理时会被覆盖，绑定了输出张量时就是绑定的张量
+   */
+  std::vector<std::shared_ptr<Tensor<float>>> Forward(const std::shared_ptr<ExecutionContext> &context,
+                                                      const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                                      bool debug = false) const;
+
+  /**
+   * 使用执行上下文中绑定的输入张量执行计算图，上下文绑定了输出张量时计算图的输出直接写入其中
+   * @param context 执行上下文，需要先通过BindInputs绑定输入
+   * @param debug 是否调试，如果调试则输出一些中间信息
+   * @return 计算图的输出张量，绑定了输出张量时就是绑定的张量
+   */
+  std::vector<std::shared_ptr<Tensor<float>>> Forward(const std::shared_ptr<ExecutionContext> &context,
+                                                      bool debug = false) const;
+
+  /**
+   * 计算指定的若干个输出，只执行这些输出节点的祖先节点，其他分支上的节点不执行，使用计算图自带的执行上下文
+   * @param inputs 计算图的输入张量，数量就是本次推理的批次大小，不能超过Build时确定的批次大小
+   * @param output_names 本次需要的输出节点名称，必须是Build时给出的输出节点
+   * @return 按照output_names的顺序排列的各个输出张量
+   */
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> ForwardOutputs(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs, const std::vector<std::string> &output_names);
+
+  /**
+   * 使用给定的执行上下文计算指定的若干个输出，只执行这些输出节点的祖先节点
+   * @param context 执行上下文
+   * @param inputs 计算图的输入张量，数量就是本次推理的批次大小，不能超过Build时确定的批次大小
+   * @param output_names 本次需要的输出节点名称，必须是Build时给出的输出节点
+   * @return 按照output_names的顺序排列的各个输出张量，保存在上下文的内存中，下一次使用该上下文推理时会被覆盖
+   */
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> ForwardOutputs(
+      const std::shared_ptr<ExecutionContext> &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+      const std::vector<std::string> &output_names) const;
+
+  /**
+   * 返回Build时给出的输出节点名称
+   * @return 输出节点名称，第一个是Forward默认返回的输出
+   */
+  const std::vector<std::string> &output_names() const;
+
+  /**
+   * 创建一个新的执行上下文，并为Build时的输入形状预先规划中间张量
+   * @return 执行上下文
+   */
+  std::shared_ptr<ExecutionContext> CreateContext() const;
+
+  /**
+   * 预热执行上下文，每个输入形状用全0的满批次输入执行一次，之后同样形状的第一次推理和稳定状态一样快
+   * 预热时规划中间张量和临时内存，Layer创建延迟分配的张量，线程池和矩阵乘法的线程开始运行，内存的缺页也在这时发生
+   * @param context 执行上下文，为空时使用计算图自带的上下文
+   * @param input_shapes 需要预热的输入形状，第一维是batch，为空时预热上下文中已经规划的全部形状
+   * @param lock_memory 是否在预热之后用mlockall锁定进程当前的全部内存，包括权重、中间张量和临时内存
+   * @return 预热的输入形状数量
+   */
+  uint32_t Warmup(const std::shared_ptr<ExecutionContext> &context = nullptr,
+                  const std::vector<std::vector<int32_t>> &input_shapes = {}, bool lock_memory = false) const;
+
+  /**
+   * 把执行序列切分成若干个连续的阶段，用于流水线并行执行
+   * 每个节点的开销按照Build时输入形状下的浮点运算次数估计，每个阶段分到的开销和它的线程数量成正比
+   * 延迟加载权重时估计开销会创建全部的Layer
+   * @param stage_threads 每个阶段的线程数量，数量就是阶段数量，不能超过执行序列中的节点数量
+   * @return 阶段数量加1个边界，第s个阶段执行执行序列中[bounds[s], bounds[s + 1])的节点
+   */
+  std::vector<uint32_t> PartitionStages(const std::vector<uint32_t> &stage_threads) const;
+
+  /**
+   * 使用标定样本做训练后量化，统计每个节点输入的最大绝对值，支持INT8的Layer之后按照INT8计算
+   * 需要在Build之后调用，重新Build会重新创建Layer，需要再次量化
+   * @param samples 标定样本，每一项是一次Forward的输入
+   * @return 转换为INT8的Layer数量
+   */
+  uint32_t QuantizeInt8(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &samples);
+
+  /**
+   * 设置Build时按组只量化权重的节点，输入和输出保持float，适合批次较小、读取权重的带宽是瓶颈的全连接层
+   * 单独设置的节点优先于所有节点的设置，不支持量化的Layer保持原来的权重，修改之后需要重新Build
+   * @param op_name 计算节点的名称，为空时设置所有节点
+   * @param bits 量化的位数，8或者4，为0时不量化
+   * @param group_size 每组包含的输入特征数量
+   */
+  void set_weight_quantization(const std::string &op_name, uint32_t bits, uint32_t group_size = 64);
+
+  /**
+   * 设置是否在相互独立的分支之间并行执行计算节点，修改之后需要重新Build
+   * @param parallel_execute 是否并行执行
+   */
+  void set_parallel_execute(bool parallel_execute);
+
+  /**
+   * 返回是否在相互独立的分支之间并行执行计算节点
+   * @return 是否并行执行
+   */
+  bool parallel_execute() const;
+
+  /**
+   * 设置顺序执行时的微批次，执行序列按照缓存大小切分成若干段连续的节点，每一段依次对每个微批次执行完所有节点
+   * 大批次推理时一个节点的输出在下一个节点读取之前仍然留在二级或者三级缓存中，代价是同一段内的中间张量不再复用内存
+   * 并行执行或者有节点在设备上执行时不切分，修改之后需要重新Build
+   * @param micro_batch_size 每个微批次的样本数量，为0时不切分
+   * @param cache_bytes 一个微批次在一段内所有中间张量的字节数上限，为0时按照处理器的缓存大小和线程数量估计
+   */
+  void set_micro_batch(uint32_t micro_batch_size, size_t cache_bytes = 0);
+
+  /**
+   * 返回微批次的样本数量
+   * @return 样本数量，不切分时为0
+   */
+  uint32_t micro_batch_size() const;
+
+  /**
+   * 设置编译缓存文件，Build时如果缓存文件存在则直接从中加载合并优化后的计算图，不再解析pnnx模型
+   * 缓存文件不存在或者无法读取时从pnnx模型构建计算图并写入缓存
+   * 模型文件的大小、修改时间或者内容，以及最大批次、图优化过程和权重量化的设置和生成缓存时不同时重新构建并覆盖缓存
+   * @param cache_path 编译缓存文件路径，为空时不使用缓存
+   */
+  void set_cache_path(const std::string &cache_path);
+
+  /**
+   * 返回编译缓存文件
+   * @return 编译缓存文件路径
+   */
+  const std::string &cache_path() const;
+
+  /**
+   * 将Build得到的合并优化后的计算图保存为编译缓存文件，需要在Build之后并且没有释放权重属性时调用
+   * @param cache_path 编译缓存文件路径
+   * @return 是否保存成功
+   */
+  bool SaveCache(const std::string &cache_path) const;
+
+  /**
+   * 按照Build得到的执行序列和内存规划生成模型专用的C++代码，需要在Build之后并且没有释放权重属性时调用
+   * 生成的类在构造时从内嵌的权重直接创建各个具体的Layer，推理时按照执行序列依次调用具体Layer的Forward，
+   * 不经过注册表查找和虚函数分派，每个节点的输入输出张量在构造时按照规划的偏移量建立在一块预先分配的内存上，
+   * 只改变形状的节点在构造时执行一次，推理时不再执行，生成的代码只支持CPU，输入形状和批次固定为Build时的形状
+   * @param header_path 生成的头文件路径
+   * @param source_path 生成的源文件路径，和KuiperInfer的库一起编译，include和source目录需要在头文件搜索路径中
+   * @param class_name 生成的模型类名称，Forward计算Build时给出的第一个输出
+   * @return 是否生成成功，节点中有无法还原的参数时失败
+   */
+  bool GenerateSource(const std::string &header_path, const std::string &source_path,
+                      const std::string &class_name) const;
+
+  /**
+   * 设置共享参数文件，Build时Layer打包之后的权重替换为文件中的数据，同一台机器上的多个计算图和进程共享一份物理内存
+   * 文件不存在或者和当前的模型不一致时由Build重新生成，文件放在/dev/shm下时就是POSIX共享内存
+   * @param shared_params_path 共享参数文件路径，为空时每个计算图持有自己的权重
+   */
+  void set_shared_params_path(const std::string &shared_params_path);
+
+  /**
+   * 返回共享参数文件
+   * @return 共享参数文件路径
+   */
+  const std::string &shared_params_path() const;
+
+  /**
+   * 返回最近一次Build映射的共享参数
+   * @return 共享参数，没有设置共享参数文件时为空
+   */
+  const std::shared_ptr<SharedParams> &shared_params() const;
+
+  /**
+   * 设置是否在Build时为每个计算节点调优计算算法，每个节点按照Build时的输入形状和计算图线程池的线程数量测量各个算法
+   * 调优结果在之后的推理和内存规划中使用，其他输入形状和线程数量仍然使用默认的选择
+   * @param auto_tune 是否调优
+   */
+  void set_auto_tune(bool auto_tune);
+
+  /**
+   * 返回是否在Build时调优计算算法
+   * @return 是否调优
+   */
+  bool auto_tune() const;
+
+  /**
+   * 设置调优缓存文件，缓存按照处理器型号区分，Build时已经调优过的节点直接使用缓存中的结果，新的结果写回缓存文件
+   * @param tuning_cache_path 调优缓存文件路径，为空时每次Build都重新调优
+   */
+  void set_tuning_cache_path(const std::string &tuning_cache_path);
+
+  /**
+   * 返回调优缓存文件
+   * @return 调优缓存文件路径
+   */
+  const std::string &tuning_cache_path() const;
+
+  /**
+   * 设置检测头的后处理，开启后检测Layer直接输出按照得分排序并经过非极大值抑制的检测框，修改之后需要重新Build
+   * @param post_process 后处理参数
+   */
+  void set_detection_post_process(const DetectionPostProcess &post_process);
+
+  /**
+   * 返回检测头的后处理参数
+   * @return 后处理参数
+   */
+  const DetectionPostProcess &detection_post_process() const;
+
+  /**
+   * 设置计算节点优先放置的设备，Layer支持该设备的节点在设备上执行，其他节点仍然在CPU上执行
+   * 相邻节点的设备不同时张量在两个设备之间复制，设备不可用时全部在CPU上执行，修改之后需要重新Build
+   * @param device 优先放置的设备
+   */
+  void set_device(DeviceType device);
+
+  /**
+   * 返回计算节点优先放置的设备
+   * @return 优先放置的设备
+   */
+  DeviceType device() const;
+
+  /**
+   * 返回Build时执行的图优化过程，可以在Build之前增加或者删除优化过程
+   * @return 图优化过程的管理器
+   */
+  GraphPassManager &pass_manager();
+
+  /**
+   * 设置推理时允许的最大批次大小，Forward可以输入不超过该大小的任意批次，中间张量按照最大批次预先分配
+   * 修改之后需要重新Build，并且会重新加载模型文件
+   * @param max_batch_size 最大的批次大小，为0时使用模型导出时的批次大小
+   */
+  void set_max_batch_size(uint32_t max_batch_size);
+
+  /**
+   * 返回推理时允许的最大批次大小
+   * @return 最大的批次大小，为0时使用模型导出时的批次大小
+   */
+  uint32_t max_batch_size() const;
+
+  /**
+   * 返回Build之后每次推理最多可以输入的张量数量，设置了最大批次大小时就是该值，否则是模型导出时的批次大小
+   * @return 推理时的最大批次
+   */
+  uint32_t batch_size() const;
+
+  /**
+   * 设置是否在Build完成后释放pnnx图和计算节点中的权重属性，Layer创建后只有Layer自己的权重参与计算
+   * 释放之后再次Build需要重新加载模型文件
+   * @param compact 是否释放构建计算图时使用的数据
+   */
+  void set_compact(bool compact);
+
+  /**
+   * 返回是否在Build完成后释放构建计算图时使用的数据
+   * @return 是否释放
+   */
+  bool compact() const;
+
+  /**
+   * 返回最近一次Build之后释放的权重字节数，没有开启compact时为0
+   * @return 释放的字节数
+   */
+  size_t reclaimed_bytes() const;
+
+  /**
+   * 设置是否延迟加载权重，开启后带有权重的节点在第一次执行时才创建Layer，之后的Build生效
+   * 启动时间和常驻内存只和实际执行的节点有关，执行之后按照创建的Layer重新规划中间张量和临时内存
+   * 自动调优、共享参数文件和检测后处理需要在Build时访问所有Layer，开启它们时Layer仍然在Build时创建
+   * @param lazy_weights 是否延迟加载权重
+   */
+  void set_lazy_weights(bool lazy_weights);
+
+  /**
+   * 返回是否延迟加载权重
+   * @return 是否延迟加载
+   */
+  bool lazy_weights() const;
+
+  /**
+   * 返回还没有创建的延迟Layer数量，没有开启延迟加载时为0
+   * @return Layer数量
+   */
+  uint32_t lazy_layer_num() const;
+
+  /**
+   * 设置执行上下文最多缓存的执行计划数量，输入形状变化时重新推导形状并规划内存，最近使用的计划保留在缓存中
+   * 对计算图自带的上下文和之后创建的上下文生效
+   * @param plan_cache_size 缓存的执行计划数量，至少为1
+   */
+  void set_plan_cache_size(uint32_t plan_cache_size);
+
+  /**
+   * 返回最多缓存的执行计划数量
+   * @return 缓存的执行计划数量
+   */
+  uint32_t plan_cache_size() const;
+
+  /**
+   * 限制计算图推理时使用的线程数量和CPU，计算图创建自己的线程池，所有Layer的并行计算都只使用这个线程池
+   * 没有设置线程池的执行上下文都使用它，多个模型部署在同一台机器上时互相不占用对方的CPU
+   * @param thread_num 参与计算的线程数量，包括调用Forward的线程，为0时使用全局的线程池
+   * @param cpus 推理时可以运行的CPU编号，为空时不限制
+   */
+  void set_thread_budget(uint32_t thread_num, const std::vector<uint32_t> &cpus = {});
+
+  /**
+   * 返回计算图自己的线程池
+   * @return 线程池，使用全局的线程池时为空
+   */
+  const std::shared_ptr<ThreadPool> &thread_pool() const;
+
+  /**
+   * 设置数据并行的副本数量，每个副本是一个执行上下文，共享计算图中不变的Layer和权重
+   * 每个副本有自己的线程池并绑定到互不相交的一组CPU上，批次为1的高并发推理时通常比一次推理用满所有CPU的吞吐更高
+   * 推理服务按照副本的数量创建推理线程，所有副本从同一个请求队列中取请求
+   * @param replica_num 副本的数量，为0时不使用副本
+   * @param cpus 所有副本可以运行的CPU，按照编号顺序平均分给每个副本，为空时使用当前线程可以运行的全部CPU
+   */
+  void set_replicas(uint32_t replica_num, const std::vector<uint32_t> &cpus = {});
+
+  /**
+   * 返回数据并行的副本数量
+   * @return 副本数量，没有设置副本时为0
+   */
+  uint32_t replica_num() const;
+
+  /**
+   * 为每个副本创建执行上下文，上下文的线程池绑定到副本的CPU上，并按照该线程池为Build时的输入形状预先规划中间张量
+   * 每次调用都创建新的上下文和线程池
+   * @return 每个副本的执行上下文
+   */
+  std::vector<std::shared_ptr<ExecutionContext>> CreateReplicas() const;
+
+  /**
+   * 设置Layer权重在NUMA节点之间的分布方式，Build之后生效，已经Build的计算图立即迁移权重
+   * 多个节点的线程共同推理时使用kInterleave平衡各节点的内存带宽，只在一个节点上推理时使用kBind
+   * @param policy 权重的分布方式，kDefault时保持第一次写入权重的线程所在的节点
+   * @param node kBind时权重所在的NUMA节点
+   */
+  void set_weight_placement(NumaMemoryPolicy policy, uint32_t node = 0);
+
+  /**
+   * 返回Layer权重在NUMA节点之间的分布方式
+   * @return 权重的分布方式
+   */
+  NumaMemoryPolicy weight_policy() const;
+
+  /**
+   * 返回计算图自带的执行上下文中当前缓存的执行计划数量
+   * @return 缓存中的执行计划数量
+   */
+  uint32_t cached_plan_num() const;
+
+  /**
+   * 返回计算图自带的执行上下文中当前的内存规划结果
+   * @return 内存规划
+   */
+  const RuntimeMemoryPlanner &memory_planner() const;
+
+  /**
+   * 统计一个执行上下文当前执行计划下每个节点的中间张量、权重和临时内存，以及全局的当前和峰值内存
+   * @param context 执行上下文，为空时使用计算图自带的执行上下文
+   * @return 内存占用
+   */
+  RuntimeMemoryReport MemoryReport(const std::shared_ptr<ExecutionContext> &context = nullptr) const;
+
+  /**
+   * 设置计算图自带执行上下文的性能分析器，重新Build之后仍然有效，其他执行上下文通过自己的set_profiler设置
+   * @param profiler 性能分析器，为空时不记录
+   */
+  void set_profiler(std::shared_ptr<RuntimeProfiler> profiler);
+
+  /**
+   * 返回计算图自带执行上下文的性能分析器
+   * @return 性能分析器，没有设置时为空
+   */
+  const std::shared_ptr<RuntimeProfiler> &profiler() const;
+
+  /**
+   * 设置记录推理指标的指标集合，所有执行上下文的推理都记录到这里，重新Build之后仍然有效
+   * 计算图创建时带有一个自己的指标集合，多个计算图和推理服务可以共享同一个，按照graph标签区分
+   * 不能和推理同时调用
+   * @param metrics 指标集合，为空时不记录
+   * @param graph_label 指标中graph标签的值，为空时使用结构文件的路径
+   */
+  void set_metrics(std::shared_ptr<RuntimeMetrics> metrics, const std::string &graph_label = "");
+
+  /**
+   * 返回记录推理指标的指标集合
+   * @return 指标集合，不记录时为空
+   */
+  const std::shared_ptr<RuntimeMetrics> &metrics() const;
+
+  /**
+   * 设置计算图自带执行上下文的中间输出dumper，重新Build之后仍然有效，其他执行上下文通过自己的set_activation_dumper设置
+   * @param activation_dumper 中间输出dumper，为空时不保存
+   */
+  void set_activation_dumper(std::shared_ptr<ActivationDumper> activation_dumper);
+
+  /**
+   * 返回计算图自带执行上下文的中间输出dumper
+   * @return 中间输出dumper，没有设置时为空
+   */
+  const std::shared_ptr<ActivationDumper> &activation_dumper() const;
+
+  /**
+   * 返回计算图中的计算节点，Build之后不包含被图优化合并掉的节点
+   * @return 计算节点
+   */
+  const std::vector<std::shared_ptr<RuntimeOperator>> &operators() const;
+
  private:
+  /// 推理时直接更新的指标，设置指标集合或者Build之后从指标集合中取得
+  struct GraphMetrics {
+    MetricCounter *forward_num = nullptr; /// Forward的调用次数
+    MetricCounter *sample_num = nullptr; /// 所有Forward的样本数量之和
+    LatencyHistogram *forward_latency = nullptr; /// 每次Forward的耗时
+    MetricGauge *weight_bytes = nullptr; /// 已经创建的Layer中权重的字节数
+    MetricGauge *activation_bytes = nullptr; /// 最近创建的执行计划中中间张量的字节数
+    MetricGauge *workspace_bytes = nullptr; /// 最近创建的执行计划中临时内存的字节数
+    std::vector<LatencyHistogram *> operator_latencies; /// 执行序列中每个节点所属类型的耗时，没有Layer的节点为空
+  };
+
+  /**
+   * 在指标集合中取得计算图使用的指标，设置指标集合和Build完成之后调用
+   */
+  void BindMetrics();
+
+  /**
+   * 记录一次Forward的批次大小和耗时，以及本次执行的每个节点的耗时
+   * 微批次执行时一个节点分多次执行，上下文中累计的耗时每次Forward只记录一次
+   * @param context 执行完成的上下文
+   * @param batch_size 批次大小
+   * @param start 开始的时间
+   */
+  void RecordForward(const ExecutionContext &context, uint32_t batch_size,
+                     std::chrono::steady_clock::time_point start) const;
+
   /**
    * 计算图的初始化
    * @return 是否初始化成功
    */
   bool Init();
 
+  /**
+   * 从编译缓存文件中初始化计算图，权重属性直接引用映射到内存的缓存文件
+   * @param cache_path 编译缓存文件路径
+   * @return 是否初始化成功
+   */
+  bool InitFromCache(const std::string &cache_path);
+
+  /**
+   * 返回决定缓存中计算图结构的Build设置：最大批次、图优化过程和权重量化，设置不同时不加载缓存
+   * @return 设置的文本描述
+   */
+  std::string CacheBuildConfig() const;
+
   /**
    * 初始化kuiper infer计算图节点中的输入操作数
    * @param inputs pnnx中的输入操作数
@@ -120,38 +588,160 @@ class RuntimeGraph {
                               const std::shared_ptr<RuntimeOperator> &runtime_operator);
 
   /**
-   * 初始化kuiper infer计算图中的输入操作数
-   * @param src 上一个节点的输出操作数
-   * @param dest 下一个节点的输入操作数
+   * 在线程池中并行创建计算节点对应的Layer，创建失败时按照节点顺序报告第一个失败的节点
+   * 延迟加载权重时带有权重的节点只创建LazyLayer，第一次执行时再解析参数和权重
+   * @param operators 需要创建Layer的计算节点
+   */
+  void CreateLayers(const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+
+  /**
+   * 释放pnnx图以及计算节点中已经被Layer加载的权重属性
+   * @return 释放的字节数
+   */
+  size_t ReleaseBuildData();
+
+  /**
+   * 按照Build时的输入形状为所有Layer调优计算算法，需要在创建执行上下文之前调用，临时内存按照调优结果规划
+   */
+  void TuneLayers();
+
+  /**
+   * 按照设置对Layer的权重按组量化，需要在调优和规划内存之前调用
+   */
+  void QuantizeLayerWeights();
+
+  /**
+   * 把所有Layer的权重替换为共享参数文件中的数据，需要在Layer打包权重之后调用
+   */
+  void ShareParams();
+
+  /**
+   * 按照设置的分布方式放置所有Layer的权重
+   */
+  void PlaceWeights() const;
+
+  /**
+   * 按照优先放置的设备和Layer支持的设备放置执行序列中的节点，并记录每个节点的输出需要复制到哪些设备上
+   */
+  void PlaceOperators();
+
+  /**
+   * 返回执行上下文推理时使用的线程池
+   * @param context 执行上下文
+   * @return 线程池，使用全局的线程池时为空
+   */
+  ThreadPool *ContextThreadPool(const ExecutionContext &context) const;
+
+  /**
+   * 以输入节点为起点对输出节点的祖先节点进行拓扑排序，得到固定的执行序列，其他分支上的节点不进入执行序列
+   * @param input_op 计算图的输入节点
+   * @param output_ops 计算图的输出节点，按照顺序放在执行序列的最后
+   * @return 拓扑排序后的计算节点序列
+   */
+  static std::vector<std::shared_ptr<RuntimeOperator>> TopoSortOperators(const std::shared_ptr<RuntimeOperator> &input_op,
+                                                                         const std::vector<std::shared_ptr<RuntimeOperator>> &output_ops);
+
+  /**
+   * 根据节点的输出节点名称建立节点之间的连接关系
+   * @param operators 计算图中的计算节点
+   */
+  static void InitOperatorEdges(const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+
+  /**
+   * 根据输入操作数的形状依次推导执行序列中每个节点的输出形状，不修改计算节点
+   * @param input_shape 输入操作数的形状，第一维是batch
+   * @return 执行序列中每个节点输出操作数的形状
    */
-  static void SetOpInputData(const std::vector<std::shared_ptr<Tensor<float>>> &src,
-                             const std::vector<std::shared_ptr<Tensor<float>>> &dest);
+  std::vector<std::vector<int32_t>> InferOperatorShapes(const std::vector<int32_t> &input_shape) const;
 
   /**
-   * 根据计算图中的计算节点来返回Layer
-   * @param op 计算图中的计算节点
-   * @return 创建成功的Layer
+   * 为给定的输入形状规划中间张量和临时内存，并放在上下文执行计划缓存的最前面
+   * @param context 执行上下文
+   * @param input_shape 输入操作数的形状，第一维是batch
    */
-  static std::shared_ptr<Layer> CreateLayer(const std::shared_ptr<RuntimeOperator> &op);
+  void CreatePlan(ExecutionContext &context, const std::vector<int32_t> &input_shape) const;
 
   /**
-   * 检查当前节点是否就绪
-   * @param op 待检查的节点
-   * @return 是否就绪
+   * 将上下文切换到给定输入形状的执行计划，缓存中没有时推导形状并重新规划
+   * @param context 执行上下文
+   * @param input_shape 输入操作数的形状，第一维是batch
    */
-  static bool CheckOperatorReady(const std::shared_ptr<RuntimeOperator> &op);
+  void SwitchPlan(ExecutionContext &context, const std::vector<int32_t> &input_shape) const;
 
   /**
-   * 探查下一层的计算节点
-   * @param current_op 当前计算节点
-   * @param operator_queue 计算节点的计算序列
-   * @param layer_output_data 当前节点的输出，赋予到下一层计算节点的输入张量中
+   * 执行单个计算节点，节点的输出保存在上下文中供后继节点读取
+   * @param op_index 当前节点在执行序列中的位置
+   * @param context 执行上下文
+   * @param inputs 计算图的输入张量
+   * @param batch_begin 本次计算的第一个样本
+   * @param batch_end 本次计算的最后一个样本之后的位置，微批次执行时只计算[batch_begin, batch_end)的样本
+   * @return 节点的执行时间，单位为秒
    */
-  static void ProbeNextLayer(const std::shared_ptr<RuntimeOperator> &current_op,
-                             std::deque<std::shared_ptr<RuntimeOperator>> &operator_queue,
-                             const std::vector<std::shared_ptr<Tensor<float>>> &layer_output_data);
+  double ExecuteOperator(uint32_t op_index, ExecutionContext &context,
+                         const std::vector<std::shared_ptr<Tensor<float>>> &inputs, uint32_t batch_begin,
+                         uint32_t batch_end) const;
+
+  /**
+   * 检查输入并切换执行上下文的执行计划，准备一次推理需要的中间张量
+   * @param context 执行上下文
+   * @param inputs 计算图的输入张量
+   * @param output_ids 本次需要的输出在Build时输出节点中的位置，只执行它们的祖先节点，默认只计算第一个输出
+   */
+  void PrepareForward(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                      const std::vector<uint32_t> &output_ids = {0}) const;
+
+  /**
+   * 按照顺序或者在相互独立的分支之间并行执行整个执行序列
+   * @param context 执行上下文，需要先通过PrepareForward准备
+   * @param inputs 计算图的输入张量
+   */
+  void ExecuteOperators(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const;
+
+  /**
+   * 在当前线程中依次执行执行序列中[begin, end)的节点，之前的节点必须已经在同一个上下文中执行完成
+   * @param context 执行上下文，需要先通过PrepareForward准备
+   * @param inputs 计算图的输入张量
+   * @param begin 第一个执行的节点在执行序列中的位置
+   * @param end 最后一个执行的节点之后的位置
+   */
+  void ExecuteRange(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                    uint32_t begin, uint32_t end) const;
+
+  /**
+   * 所有节点执行完成之后等待设备并写回绑定的输出张量
+   * @param context 执行上下文
+   * @param inputs 计算图的输入张量
+   * @return 计算图的输出张量
+   */
+  std::vector<std::shared_ptr<Tensor<float>>> FinishForward(ExecutionContext &context,
+                                                            const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const;
+
+  /**
+   * 在线程池中执行计算节点，节点执行完成后将所有依赖已经满足的后继节点提交为新的任务
+   * @param op_index 当前节点在执行序列中的位置
+   * @param context 执行上下文，保存每个节点尚未完成的前驱节点数量和尚未完成的节点数量
+   * @param inputs 计算图的输入张量
+   */
+  void ExecuteParallel(uint32_t op_index, ExecutionContext &context,
+                       const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const;
+
+  /**
+   * 将主机上的计算图输入经过上下文的页锁定内存，在上下文的流上异步复制到设备
+   * @param context 执行上下文
+   * @param inputs 计算图的输入张量
+   */
+  void StageInputs(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const;
+
+  /**
+   * 在上下文的流上将设备上的计算图输出异步复制到上下文的页锁定内存，推理结束时再写回输出张量
+   * @param context 执行上下文
+   * @param outputs 计算图的输出张量
+   */
+  void StageOutputs(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &outputs) const;
 
  private:
+  friend class RuntimePipeline;
+
   enum class GraphState {
     NeedInit = -2,
     NeedBuild = -1,
@@ -159,13 +749,58 @@ class RuntimeGraph {
   };
   GraphState graph_state_ = GraphState::NeedInit;
   std::string input_name_; /// 计算图输入节点的名称
-  std::string output_name_; /// 计算图输出节点的名称
+  std::vector<std::string> output_names_; /// 计算图输出节点的名称
   std::string param_path_; /// 计算图的结构文件
   std::string bin_path_; /// 计算图的权重文件
   std::map<std::string, std::shared_ptr<RuntimeOperator>> input_operators_maps_; /// 保存输入节点
   std::map<std::string, std::shared_ptr<RuntimeOperator>> output_operators_maps_; /// 保存输出节点
   std::vector<std::shared_ptr<RuntimeOperator>> operators_; /// 计算图的计算节点
+  std::vector<std::shared_ptr<RuntimeOperator>> topo_operators_; /// 拓扑排序后的执行序列，在Build阶段确定
+  std::vector<std::vector<uint32_t>> topo_successors_; /// 执行序列中每个节点的后继节点位置
+  std::vector<uint32_t> topo_in_degrees_; /// 执行序列中每个节点的前驱节点数量
+  std::vector<std::vector<uint32_t>> topo_input_indexes_; /// 执行序列中每个节点各个输入操作数的来源节点位置
+  uint32_t topo_output_index_ = 0; /// 计算图第一个输出的来源节点在执行序列中的位置
+  std::vector<uint32_t> topo_output_indexes_; /// 计算图各个输出的来源节点在执行序列中的位置
+  std::vector<std::vector<bool>> topo_output_ancestors_; /// 执行序列中的节点是否是各个输出节点的祖先节点
+  std::vector<std::vector<DeviceType>> topo_sync_devices_; /// 执行序列中每个节点的输出执行完成后需要复制到的设备
+  uint32_t device_op_num_ = 0; /// 放置在CPU以外设备上的节点数量
+  bool stage_outputs_ = false; /// 计算图的输出在设备上写入并且只被输出节点读取，经过页锁定内存复制回主机
+  uint64_t build_id_ = 0; /// 计算图的构建编号，每次Build都不同
+  bool parallel_execute_ = false; /// 是否在相互独立的分支之间并行执行
+  uint32_t micro_batch_size_ = 0; /// 顺序执行时每个微批次的样本数量，为0时不切分
+  size_t micro_batch_cache_bytes_ = 0; /// 一个微批次在一段内中间张量的字节数上限，为0时自动估计
+  uint32_t max_batch_size_ = 0; /// 推理时允许的最大批次大小，为0时使用模型导出时的批次大小
+  bool compact_ = false; /// 是否在Build完成后释放构建计算图时使用的数据
+  bool build_data_released_ = false; /// 构建计算图时使用的数据是否已经释放
+  bool lazy_weights_ = false; /// 是否在节点第一次执行时才创建带有权重的Layer
+  std::shared_ptr<std::atomic<uint32_t>> lazy_layer_num_; /// 还没有创建的延迟Layer数量，没有延迟Layer时为空
+  std::string cache_path_; /// 编译缓存文件
+  bool auto_tune_ = false; /// 是否在Build时调优计算算法
+  /// 每个节点权重量化的位数和分组大小，空名称对应所有节点
+  std::map<std::string, std::pair<uint32_t, uint32_t>> weight_quantization_;
+  std::string tuning_cache_path_; /// 调优缓存文件
+  std::string shared_params_path_; /// 共享参数文件
+  std::shared_ptr<SharedParams> shared_params_; /// 映射的共享参数，Layer的权重引用其中的数据
+  GraphPassManager pass_manager_ = GraphPassManager::Default(); /// Build时执行的图优化过程
+  DetectionPostProcess detection_post_process_; /// 检测头的后处理参数
+  DeviceType device_ = DeviceType::kDeviceCPU; /// 计算节点优先放置的设备
+  size_t reclaimed_bytes_ = 0; /// 最近一次Build之后释放的权重字节数
+  std::shared_ptr<RuntimeOperator> input_operator_; /// 计算图的输入节点
+  std::shared_ptr<RuntimeOperator> output_operator_; /// 计算图的第一个输出节点
+  std::shared_ptr<ExecutionContext> default_context_; /// 计算图自带的执行上下文
+  uint32_t plan_cache_size_ = 4; /// 执行上下文最多缓存的执行计划数量
+  std::shared_ptr<ThreadPool> thread_pool_; /// 计算图自己的线程池，为空时使用全局的线程池
+  uint32_t replica_num_ = 0; /// 数据并行的副本数量
+  std::vector<uint32_t> replica_cpus_; /// 所有副本可以运行的CPU
+  NumaMemoryPolicy weight_policy_ = NumaMemoryPolicy::kDefault; /// Layer权重在NUMA节点之间的分布方式
+  uint32_t weight_node_ = 0; /// kBind时权重所在的NUMA节点
+  std::shared_ptr<RuntimeProfiler> profiler_; /// 计算图自带执行上下文的性能分析器
+  std::shared_ptr<ActivationDumper> activation_dumper_; /// 计算图自带执行上下文的中间输出dumper
+  std::shared_ptr<RuntimeMetrics> metrics_ = std::make_shared<RuntimeMetrics>(); /// 记录推理指标的指标集合
+  std::string metrics_label_; /// 指标中graph标签的值，为空时使用结构文件的路径
+  GraphMetrics graph_metrics_; /// 从指标集合中取得的指标
   std::unique_ptr<pnnx::Graph> graph_; /// pnnx的graph
 };
 
-}
\ No newline at end of file
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_IR_HPP_
@@ -0,0 +1,155 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "runtime_op.hpp"
+#include "data/memory_tracker.hpp"
+#include "runtime/numa.hpp"
+
+namespace kuiper_infer {
+/// Layer分配到的临时内存
+struct RuntimeWorkspace {
+  float *workspace = nullptr; /// 临时内存的起始地址，按照64字节对齐
+  size_t workspace_size = 0; /// 临时内存的float元素数量
+};
+
+/// 一个计算节点占用的内存
+struct OperatorMemory {
+  std::string name; /// 计算节点的名称
+  std::string type; /// 计算节点的类型
+  size_t activation_bytes = 0; /// 输出张量按照最大批次规划的字节数
+  size_t weight_bytes = 0; /// Layer中权重和偏移量的字节数
+  size_t scratch_bytes = 0; /// 分配给Layer的临时内存字节数
+};
+
+/// 计算图在一个执行上下文中的内存占用，用于估计每个模型实例需要的内存
+struct RuntimeMemoryReport {
+  std::vector<OperatorMemory> operators; /// 执行序列中每个有Layer的节点的内存占用
+  size_t activation_bytes = 0; /// 规划后中间张量实际占用的字节数，生命周期不重叠的节点共享内存
+  size_t weight_bytes = 0; /// 所有Layer权重的字节数
+  size_t scratch_bytes = 0; /// 执行上下文中临时内存的字节数
+  size_t current_bytes = 0; /// 全局内存统计中当前持有的字节数
+  size_t peak_bytes = 0; /// 全局内存统计中的峰值字节数
+
+  /**
+   * 将内存占用格式化为表格，最后一行是汇总
+   * @return 表格文本
+   */
+  std::string ToString() const;
+};
+
+/// 计算图中间张量的静态内存规划，生命周期不重叠的输出张量复用同一块内存
+class RuntimeMemoryPlanner {
+ public:
+  /**
+   * 根据计算节点的执行顺序分析每个节点输出张量的生命周期，并将其分配到可复用的内存块中
+   * 规划结果保存在规划器中，不修改计算节点，没有Layer的输入输出节点不分配内存
+   * 输出共享输入内存的节点也不分配内存，它的输入张量一直保留到它的读取者全部执行完成
+   * 支持原地计算的节点在输入张量只被自己读取并且形状相同时，输出直接使用输入张量所在的内存
+   * @param topo_operators 按照执行顺序排列的计算节点
+   * @param output_shapes 每个节点输出操作数的形状，第一维是batch
+   * @param dependency_aware 节点是否可能乱序并行执行，此时只有读取者全部是当前节点祖先的内存块才能被复用
+   * @param op_segments 顺序执行时每个节点所在的分段，同一分段的节点按照微批次交替执行，
+   * 读取者和写入者在同一分段时内存块不复用，为空时每个节点单独作为一个分段
+   */
+  void Plan(const std::vector<std::shared_ptr<RuntimeOperator>> &topo_operators,
+            const std::vector<std::vector<int32_t>> &output_shapes, bool dependency_aware = false,
+            const std::vector<uint32_t> &op_segments = {});
+  /**
+   * 为每个节点的Layer分配计算时需要的临时内存，顺序执行时所有节点共享同一块内存，并行执行时每个节点使用不同的区域
+   * @param topo_operators 按照执行顺序排列的计算节点
+   * @param input_shapes 每个节点全部输入操作数的形状
+   * @param dependency_aware 节点是否可能乱序并行执行
+   */
+  void PlanWorkspace(const std::vector<std::shared_ptr<RuntimeOperator>> &topo_operators,
+                     const std::vector<std::vector<std::vector<int32_t>>> &input_shapes,
+                     bool dependency_aware = false);
+  /**
+   * 返回执行序列中一个节点的输出张量，张量建立在内存块上
+   * 除了直接写入拼接输出的节点，同一个节点的各个batch张量在内存块中依次紧密排列，可以作为一个连续的批次计算
+   * @param op_index 节点在执行序列中的位置
+   * @return 节点的输出张量，没有分配内存的节点为空，输出共享输入内存的节点中每个张量都是空指针
+   */
+  const std::vector<std::shared_ptr<Tensor<float>>> &tensors(uint32_t op_index) const;
+  /**
+   * 返回执行序列中一个节点的Layer可以使用的临时内存
+   * @param op_index 节点在执行序列中的位置
+   * @return 临时内存
+   */
+  const RuntimeWorkspace &workspace(uint32_t op_index) const;
+  /**
+   * 返回所有Layer临时内存的字节数
+   * @return 临时内存的字节数
+   */
+  size_t workspace_bytes() const;
+
+  /**
+   * 返回规划后所有内存块的字节数
+   * @return 规划后的字节数
+   */
+  size_t planned_bytes() const;
+
+  /**
+   * 返回每个输出张量单独分配内存时所需的字节数
+   * @return 不做规划时的字节数
+   */
+  size_t naive_bytes() const;
+
+  /**
+   * 返回内存块的数量
+   * @return 内存块的数量
+   */
+  uint32_t slot_count() const;
+
+  /**
+   * 返回一个内存块的float元素数量
+   * @param slot_index 内存块的编号
+   * @return 元素数量
+   */
+  size_t slot_size(uint32_t slot_index) const;
+
+  /**
+   * 返回执行序列中一个节点的输出张量所在的内存块和每个batch张量在内存块中的偏移量，生成代码时按照同样的规划排列内存
+   * @param op_index 节点在执行序列中的位置
+   * @param offsets 每个batch张量在内存块中的float偏移量
+   * @return 内存块的编号，没有分配内存的节点为-1
+   */
+  int32_t TensorOffsets(uint32_t op_index, std::vector<size_t> &offsets) const;
+
+  /**
+   * 按照策略设置所有内存块和临时内存所在的NUMA节点，已经写入的内存会被迁移
+   * @param policy 内存的分布方式
+   * @param node kBind时内存所在的NUMA节点
+   * @return 是否全部设置成功
+   */
+  bool PlaceMemory(NumaMemoryPolicy policy, uint32_t node) const;
+
+  /**
+   * 按照同样的规划在CUDA设备上分配内存块，每个输出张量在设备上使用对应内存块中相同偏移量的一段，
+   * 设备上的中间张量因此和主机上一样按照生命周期复用内存，已经分配过时直接返回
+   */
+  void PlaceDeviceMemory();
+
+  /**
+   * 返回CUDA设备上内存块的字节数
+   * @return 设备内存的字节数，没有分配时为0
+   */
+  size_t device_bytes() const;
+
+ private:
+  size_t naive_bytes_ = 0; /// 不做规划时所需的字节数
+  std::vector<std::vector<float>> slots_; /// 可复用的内存块
+  std::vector<float> workspace_; /// 所有Layer共用的临时内存，多分配一些用于对齐
+  size_t workspace_size_ = 0; /// 对齐之后实际可用的临时内存元素数量
+  TrackedAllocation slot_allocation_; /// 内存块在全局内存统计中的记录
+  TrackedAllocation workspace_allocation_; /// 临时内存在全局内存统计中的记录
+
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> tensors_; /// 每个节点规划后的输出张量
+  std::vector<int32_t> tensor_slots_; /// 每个节点输出张量所在的内存块，-1表示没有分配
+  std::vector<std::shared_ptr<DeviceBuffer>> device_slots_; /// 和内存块一一对应的设备内存
+  std::vector<RuntimeWorkspace> workspaces_; /// 每个节点分配到的临时内存
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_MEMORY_HPP_
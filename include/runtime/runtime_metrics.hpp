@@ -0,0 +1,216 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace kuiper_infer {
+/// 指标的标签，按照标签名排序，导出时依次输出
+using MetricLabels = std::map<std::string, std::string>;
+
+/// 每个指标的分片数量，线程按照第一次更新指标的顺序分配到分片上，同一分片上的线程才会竞争同一个缓存行
+constexpr uint32_t kMetricShardNum = 16;
+
+/**
+ * 返回当前线程使用的分片编号
+ * @return 分片编号，在[0, kMetricShardNum)之间
+ */
+uint32_t MetricShardIndex();
+
+/// 单调递增的计数器，每个线程只更新自己的分片，读取时把所有分片加起来
+class MetricCounter {
+ public:
+  /**
+   * 增加计数
+   * @param value 增加的数量
+   */
+  void Add(uint64_t value = 1);
+
+  /**
+   * 返回所有分片的计数之和
+   * @return 计数
+   */
+  uint64_t value() const;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Shard, kMetricShardNum> shards_;
+};
+
+/// 可以增减的瞬时值，例如队列深度和内存占用，更新频率低于计数器，不分片
+class MetricGauge {
+ public:
+  /**
+   * 设置当前值
+   * @param value 当前值
+   */
+  void Set(int64_t value);
+
+  /**
+   * 在当前值上增加，减少时传入负数
+   * @param value 增加的数量
+   */
+  void Add(int64_t value);
+
+  /**
+   * 返回当前值
+   * @return 当前值
+   */
+  int64_t value() const;
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+/// 延迟直方图某一时刻的快照，所有分片已经合并
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts; /// 每个桶中的记录数量
+  uint64_t count = 0; /// 记录的总数
+  uint64_t sum_ns = 0; /// 所有记录的延迟之和，单位为纳秒
+  uint64_t max_ns = 0; /// 最大的延迟
+
+  /**
+   * 返回给定分位数所在桶的上界，相对误差不超过桶的宽度
+   * @param quantile 分位数，在[0, 1]之间
+   * @return 延迟，单位为纳秒，没有记录时为0
+   */
+  uint64_t ValueAtQuantile(double quantile) const;
+
+  /**
+   * 返回延迟的平均值
+   * @return 平均延迟，单位为纳秒
+   */
+  double mean_ns() const;
+};
+
+/// HDR风格的延迟直方图，按纳秒记录，每个2的幂次区间均分为32个桶，任意延迟的相对误差在3%左右
+/// 延迟小于64纳秒时每个桶只有一个值，超过2^36纳秒(约68秒)的延迟计入最后一个桶
+/// 每个分片在第一次被使用时才分配，只被少数线程更新的直方图不会占用全部分片的内存
+class LatencyHistogram {
+ public:
+  static constexpr uint32_t kSubBucketBits = 5; /// 每个2的幂次区间内的桶数量是2^kSubBucketBits
+  static constexpr uint32_t kMaxValueBits = 36; /// 可以区分的最大延迟是2^kMaxValueBits纳秒
+  static constexpr uint32_t kBucketNum = (kMaxValueBits - kSubBucketBits + 1) << kSubBucketBits; /// 桶的总数
+
+  LatencyHistogram() = default;
+
+  ~LatencyHistogram();
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  /**
+   * 记录一次延迟
+   * @param nanoseconds 延迟，单位为纳秒
+   */
+  void Record(uint64_t nanoseconds);
+
+  /**
+   * 合并所有分片，得到当前的快照，可以和Record同时调用，快照中各个桶之间可能相差正在进行的几次记录
+   * @return 直方图的快照
+   */
+  HistogramSnapshot Snapshot() const;
+
+  /**
+   * 返回延迟所在的桶
+   * @param nanoseconds 延迟，单位为纳秒
+   * @return 桶的编号
+   */
+  static uint32_t BucketIndex(uint64_t nanoseconds);
+
+  /**
+   * 返回桶中最大的延迟
+   * @param bucket_index 桶的编号
+   * @return 延迟，单位为纳秒
+   */
+  static uint64_t BucketUpperBound(uint32_t bucket_index);
+
+ private:
+  struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, kBucketNum> counts{};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+  };
+  std::array<std::atomic<Shard *>, kMetricShardNum> shards_{}; /// 每个分片在第一次记录时分配
+};
+
+/// 推理的指标集合，记录计算图和推理服务的请求数量、延迟分布、队列深度和内存占用
+/// 更新指标不加锁，每个线程更新自己的分片，ExportPrometheus在读取时合并，适合在生产环境中一直开启
+/// 计算图、推理服务等组件可以共享同一个指标集合，指标按照名称和标签区分
+class RuntimeMetrics {
+ public:
+  /**
+   * 返回一个计数器，不存在时创建，同一名称的指标类型和说明必须相同
+   * 返回的引用在指标集合析构之前一直有效，组件在初始化时取得之后直接更新
+   * @param name 指标的名称
+   * @param help 指标的说明
+   * @param labels 指标的标签
+   * @return 计数器
+   */
+  MetricCounter &Counter(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+
+  /**
+   * 返回一个瞬时值，不存在时创建
+   * @param name 指标的名称
+   * @param help 指标的说明
+   * @param labels 指标的标签
+   * @return 瞬时值
+   */
+  MetricGauge &Gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+
+  /**
+   * 返回一个延迟直方图，不存在时创建
+   * @param name 指标的名称，导出时以秒为单位
+   * @param help 指标的说明
+   * @param labels 指标的标签
+   * @return 延迟直方图
+   */
+  LatencyHistogram &Histogram(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+
+  /**
+   * 按照Prometheus的文本格式导出所有指标，供HTTP服务的/metrics接口直接返回
+   * 直方图导出为累计的桶，边界是1微秒到68秒之间每个2的幂次区间的四等分点，可以用histogram_quantile计算尾延迟
+   * 同时导出全局内存统计中当前和峰值的字节数
+   * @return 指标文本
+   */
+  std::string ExportPrometheus() const;
+
+ private:
+  /// 指标的类型
+  enum class MetricType {
+    kCounter = 0,
+    kGauge = 1,
+    kHistogram = 2,
+  };
+
+  /// 同一名称的所有指标
+  struct MetricFamily {
+    MetricType type = MetricType::kCounter;
+    std::string help;
+    std::map<MetricLabels, std::unique_ptr<MetricCounter>> counters;
+    std::map<MetricLabels, std::unique_ptr<MetricGauge>> gauges;
+    std::map<MetricLabels, std::unique_ptr<LatencyHistogram>> histograms;
+  };
+
+  /**
+   * 返回指定名称的指标族，不存在时创建，调用者需要持有锁
+   * @param name 指标的名称
+   * @param help 指标的说明
+   * @param type 指标的类型
+   * @return 指标族
+   */
+  MetricFamily &Family(const std::string &name, const std::string &help, MetricType type);
+
+  mutable std::mutex mutex_; /// 保护指标的创建和导出时的遍历，更新指标不需要加锁
+  std::map<std::string, MetricFamily> families_; /// 按照名称排列的指标族
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_METRICS_HPP_
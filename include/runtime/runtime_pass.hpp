@@ -0,0 +1,162 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PASS_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PASS_HPP_
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "runtime/runtime_op.hpp"
+
+namespace kuiper_infer {
+/// 优化过程可以使用的计算图信息
+struct GraphPassContext {
+  std::string input_name; /// 计算图输入节点的名称
+  std::vector<std::string> output_names; /// 计算图输出节点的名称
+
+  /**
+   * 判断节点是否是计算图的输出节点
+   * @param name 节点的名称
+   * @return 是输出节点时返回true
+   */
+  bool IsOutput(const std::string &name) const;
+};
+
+/// 计算图上的一个优化过程，在Init之后、创建Layer之前修改计算节点以及节点之间的连接
+class GraphPass {
+ public:
+  explicit GraphPass(std::string name);
+
+  virtual ~GraphPass() = default;
+
+  /**
+   * 返回优化过程的名称
+   * @return 优化过程的名称
+   */
+  const std::string &name() const;
+
+  /**
+   * 执行优化，删除的节点从operators中移除，剩余节点的输入输出关系保持一致
+   * @param operators 计算图中的计算节点，按照pnnx模型中的顺序排列
+   * @param context 计算图的信息
+   * @return 修改、合并或者删除的节点数量
+   */
+  virtual uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                       const GraphPassContext &context) = 0;
+
+ private:
+  std::string name_; /// 优化过程的名称
+};
+
+/// 删除不能到达计算图输出节点的节点，包括其他输出的分支和没有使用的常量
+class DeadNodeEliminationPass : public GraphPass {
+ public:
+  DeadNodeEliminationPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 删除推理时什么都不做的节点，例如Identity、Dropout、输入输出形状相同的展平和view，
+/// 以及后面紧跟view的展平和view，后继节点改为直接读取它们的输入
+class IdentityEliminationPass : public GraphPass {
+ public:
+  IdentityEliminationPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 输入全部来自常量的节点在构建时计算一次，结果作为新的常量节点，不再被使用的常量节点随之删除
+class ConstantFoldingPass : public GraphPass {
+ public:
+  ConstantFoldingPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 将卷积之后唯一的BatchNorm节点合并到卷积的权重和偏移量中
+class ConvBatchNormFusionPass : public GraphPass {
+ public:
+  ConvBatchNormFusionPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 将卷积和全连接层之后唯一的激活节点合并为它们的尾部计算
+class ActivationFusionPass : public GraphPass {
+ public:
+  ActivationFusionPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 将输出为1x1的自适应平均池化和之后的展平合并到全连接层中，分类网络的头部只做一次矩阵乘法
+class GlobalPoolingFusionPass : public GraphPass {
+ public:
+  GlobalPoolingFusionPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 将Squeeze-and-Excitation模块的节点链合并为一个节点，在激活函数合并之后执行
+/// 输出为1x1的自适应平均池化、两个1x1卷积及其激活函数、以及池化的输入和卷积结果的逐元素乘法
+/// 合并为一个kuiper.SqueezeExcitation节点，中间的小张量不再单独分配，乘法不再经过通道广播
+class SqueezeExcitationFusionPass : public GraphPass {
+ public:
+  SqueezeExcitationFusionPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 将残差连接的加法合并到产生其中一个加数的卷积中，在激活函数合并之后执行
+/// 卷积在写回输出时加上另一个加数，加法之后唯一的激活函数也一起合并，省去加法节点和一次完整读写特征图的过程
+class ResidualAddFusionPass : public GraphPass {
+ public:
+  ResidualAddFusionPass();
+
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) override;
+};
+
+/// 按照顺序执行一组优化过程
+class GraphPassManager {
+ public:
+  /**
+   * 创建默认的优化过程：先删除无用节点、恒等节点并折叠常量，再合并算子
+   * @return 包含默认优化过程的管理器
+   */
+  static GraphPassManager Default();
+
+  /**
+   * 在最后添加一个优化过程
+   * @param pass 优化过程
+   */
+  void AddPass(std::shared_ptr<GraphPass> pass);
+
+  /**
+   * 删除指定名称的优化过程
+   * @param name 优化过程的名称
+   * @return 是否找到并删除
+   */
+  bool RemovePass(const std::string &name);
+
+  /**
+   * 删除所有的优化过程
+   */
+  void Clear();
+
+  /**
+   * 返回所有的优化过程
+   * @return 按照执行顺序排列的优化过程
+   */
+  const std::vector<std::shared_ptr<GraphPass>> &passes() const;
+
+  /**
+   * 依次执行所有的优化过程
+   * @param operators 计算图中的计算节点
+   * @param context 计算图的信息
+   * @return 所有优化过程修改的节点数量之和
+   */
+  uint32_t Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators, const GraphPassContext &context) const;
+
+ private:
+  std::vector<std::shared_ptr<GraphPass>> passes_; /// 按照执行顺序排列的优化过程
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PASS_HPP_
@@ -0,0 +1,134 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PIPELINE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PIPELINE_HPP_
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "data/tensor.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/thread_pool.hpp"
+#include "runtime/lock_free_queue.hpp"
+
+namespace kuiper_infer {
+/// 流水线推理请求完成时的回调，参数是该请求的输出张量，在最后一个阶段的线程中调用
+using PipelineCallback = std::function<void(const std::vector<std::shared_ptr<Tensor<float>>> &)>;
+
+/// 流水线并行推理，计算图的执行序列切分成若干个连续的阶段，每个阶段有自己的线程和绑定到一组CPU的线程池
+/// 相邻阶段之间通过有界的单生产者单消费者队列传递请求，连续的请求同时在不同的阶段中计算
+/// 每个在途的请求使用自己的执行上下文，中间张量保存在上下文中随请求传递到下一个阶段，不需要复制
+/// 单个Layer的并行计算无法用满所有CPU时可以提高吞吐，单个请求的延迟不会降低
+class RuntimePipeline {
+ public:
+  /**
+   * 创建流水线并启动每个阶段的线程
+   * @param graph 已经Build完成的计算图，不能在设备上执行，流水线运行期间不能重新Build
+   * @param core_groups 每个阶段可以运行的CPU，数量就是阶段数量，每组的CPU数量就是该阶段的线程数量
+   * @param queue_capacity 相邻阶段之间队列的容量，下一个阶段来不及处理时上一个阶段等待
+   */
+  RuntimePipeline(std::shared_ptr<RuntimeGraph> graph, const std::vector<std::vector<uint32_t>> &core_groups,
+                  uint32_t queue_capacity = 2);
+
+  ~RuntimePipeline();
+
+  RuntimePipeline(const RuntimePipeline &) = delete;
+
+  RuntimePipeline &operator=(const RuntimePipeline &) = delete;
+
+  /**
+   * 把一组CPU按照编号顺序平均切分成连续的若干组，同一组的CPU通常共享缓存
+   * @param stage_num 切分的组数
+   * @param cpus 切分的CPU，为空时使用当前线程可以运行的全部CPU
+   * @return 每组的CPU编号
+   */
+  static std::vector<std::vector<uint32_t>> SplitCores(uint32_t stage_num, const std::vector<uint32_t> &cpus = {});
+
+  /**
+   * 提交一个推理请求，可以在多个线程中同时调用
+   * @param inputs 一次推理的输入张量，推理完成之前必须保持有效
+   * @return 请求的输出张量，推理完成后可以获取，流水线已经停止时立即得到空的输出
+   */
+  std::future<std::vector<std::shared_ptr<Tensor<float>>>> Submit(
+      const std::vector<std::shared_ptr<Tensor<float>>> &inputs);
+
+  /**
+   * 提交一个推理请求，推理完成后在最后一个阶段的线程中调用回调
+   * 和Stop同时调用时请求要么被处理，要么被拒绝，不会丢失
+   * @param inputs 一次推理的输入张量，推理完成之前必须保持有效
+   * @param callback 推理完成时的回调，不能长时间阻塞，否则所有阶段都会等待；请求被拒绝时在当前线程中以空的输出调用
+   * @return 是否提交成功，流水线已经停止时返回false
+   */
+  bool Submit(const std::vector<std::shared_ptr<Tensor<float>>> &inputs, PipelineCallback callback);
+
+  /**
+   * 处理完已经提交的请求之后停止所有阶段的线程，停止之后提交的请求被拒绝
+   */
+  void Stop();
+
+  /**
+   * 返回阶段的数量
+   * @return 阶段数量
+   */
+  uint32_t stage_num() const;
+
+  /**
+   * 返回每个阶段在执行序列中的范围
+   * @return 阶段数量加1个边界，第s个阶段执行[bounds[s], bounds[s + 1])的节点
+   */
+  const std::vector<uint32_t> &stage_bounds() const;
+
+  /**
+   * 返回已经完成的请求数量
+   * @return 完成的请求数量
+   */
+  uint64_t request_num() const;
+
+ private:
+  /// 流水线中的推理请求，携带自己的执行上下文在阶段之间传递
+  struct PipelineRequest {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs; /// 输入张量
+    PipelineCallback callback; /// 推理完成时的回调
+    std::shared_ptr<ExecutionContext> context; /// 第一个阶段分配的执行上下文，保存中间张量
+    std::chrono::steady_clock::time_point start; /// 第一个阶段开始执行的时间，最后一个阶段记录指标时使用
+  };
+
+  /// 流水线的一个阶段
+  struct Stage {
+    uint32_t begin = 0; /// 第一个节点在执行序列中的位置
+    uint32_t end = 0; /// 最后一个节点之后的位置
+    std::unique_ptr<ThreadPool> thread_pool; /// 阶段内Layer并行计算使用的线程池，阶段线程自己也参与计算
+    std::unique_ptr<SpscQueue<std::unique_ptr<PipelineRequest>>> requests; /// 上一个阶段交给这个阶段的请求，第一个阶段没有
+    QueueWaiter waiter; /// 阶段线程等待请求或者空闲的执行上下文
+    std::thread thread; /// 阶段线程
+  };
+
+  /**
+   * 阶段线程的主循环
+   * @param stage_index 阶段的编号
+   */
+  void StageLoop(uint32_t stage_index);
+
+  /**
+   * 把请求交给下一个阶段，队列满时等待
+   * @param stage_index 下一个阶段的编号
+   * @param request 交出的请求，为空时通知下一个阶段退出
+   */
+  void PushRequest(uint32_t stage_index, std::unique_ptr<PipelineRequest> request);
+
+  std::shared_ptr<RuntimeGraph> graph_; /// 执行推理的计算图
+  std::vector<uint32_t> bounds_; /// 每个阶段在执行序列中的边界
+  std::vector<std::unique_ptr<Stage>> stages_; /// 流水线的各个阶段
+  ThreadPool *plan_pool_ = nullptr; /// 线程最多的阶段的线程池，执行计划按照它规划，所有阶段的临时内存都足够
+  LockFreeQueue<std::unique_ptr<PipelineRequest>> submitted_; /// 提交但还没有进入第一个阶段的请求
+  SpscQueue<std::shared_ptr<ExecutionContext>> free_contexts_; /// 空闲的执行上下文，最后一个阶段归还，第一个阶段取出
+  std::atomic<uint32_t> pending_num_{0}; /// 登记提交但还没有被第一个阶段取走的请求数量，在放入队列之前增加
+  std::atomic<uint64_t> request_num_{0}; /// 已经完成的请求数量
+  std::atomic<bool> stop_{false}; /// 第一个阶段处理完剩余的请求之后是否退出
+  std::mutex stop_mutex_; /// 保证只停止一次
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PIPELINE_HPP_
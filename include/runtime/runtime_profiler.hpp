@@ -0,0 +1,110 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PROFILER_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PROFILER_HPP_
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include "runtime/hardware_counter.hpp"
+
+namespace kuiper_infer {
+/// 计算节点一次执行的性能记录
+struct OperatorProfile {
+  std::string name; /// 计算节点的名称
+  std::string type; /// 计算节点的类型
+  uint32_t thread_index = 0; /// 执行节点的线程，按照线程第一次出现的顺序编号
+  double start_us = 0.; /// 开始时间，相对于性能分析器创建的时刻，单位为微秒
+  double end_us = 0.; /// 结束时间，单位为微秒
+  std::vector<std::vector<int32_t>> input_shapes; /// 每个输入操作数的形状，第一维是本次推理的批次
+  std::vector<int32_t> output_shape; /// 输出操作数的形状
+  uint64_t flops = 0; /// 估计的浮点运算次数
+  uint64_t bytes = 0; /// 估计读写的内存字节数，包括输入输出张量以及权重
+  size_t activation_bytes = 0; /// 本次推理中输出张量的字节数
+  size_t weight_bytes = 0; /// Layer中权重的字节数
+  size_t scratch_bytes = 0; /// 分配给Layer的临时内存字节数
+  size_t current_bytes = 0; /// 节点执行完成时全局内存统计中持有的字节数
+  bool has_hardware_counters = false; /// 是否记录了硬件计数器
+  HardwareCounterValues hardware_counters; /// 节点执行期间硬件计数器的增量
+
+  /**
+   * 返回节点的执行时间
+   * @return 执行时间，单位为微秒
+   */
+  double duration_us() const;
+
+  /**
+   * 返回节点达到的计算速度
+   * @return 每秒的十亿次浮点运算数
+   */
+  double gflops() const;
+};
+
+/// 计算节点的性能分析器，记录每个节点实例的执行时间，可以导出为chrome://tracing或者Perfetto能打开的json
+/// 并行执行时多个线程同时记录，所有接口都是线程安全的
+class RuntimeProfiler {
+ public:
+  RuntimeProfiler();
+
+  /**
+   * 返回从性能分析器创建到现在经过的时间
+   * @return 经过的时间，单位为微秒
+   */
+  double Now() const;
+
+  /**
+   * 设置是否在每个节点执行时读取硬件计数器，当前线程无法打开计数器时保持关闭
+   * @param hardware_counters 是否读取硬件计数器
+   * @return 设置之后是否读取硬件计数器
+   */
+  bool set_hardware_counters(bool hardware_counters);
+
+  /**
+   * 返回是否在每个节点执行时读取硬件计数器
+   * @return 是否读取硬件计数器
+   */
+  bool hardware_counters() const;
+
+  /**
+   * 记录一个节点的执行情况，线程编号由当前线程决定
+   * @param profile 节点的性能记录
+   */
+  void Record(OperatorProfile profile);
+
+  /**
+   * 清空所有的性能记录
+   */
+  void Clear();
+
+  /**
+   * 返回所有的性能记录，按照记录的先后顺序排列
+   * @return 性能记录
+   */
+  std::vector<OperatorProfile> records() const;
+
+  /**
+   * 将性能记录导出为Chrome trace格式的json文件
+   * @param path 文件路径
+   * @return 是否导出成功
+   */
+  bool ExportChromeTrace(const std::string &path) const;
+
+  /**
+   * 按照节点名称汇总性能记录，返回总耗时最多的节点组成的表格
+   * 表格中的FLOP/Byte是计算强度，计算强度低并且GFLOP/s也低的节点一般受限于内存带宽
+   * @param top_n 表格中节点的数量，为0时包含全部节点
+   * @return 表格文本
+   */
+  std::string TopOperators(uint32_t top_n = 10) const;
+
+ private:
+  std::chrono::steady_clock::time_point start_time_; /// 性能分析器创建的时刻
+  std::atomic<bool> hardware_counters_{false}; /// 是否读取硬件计数器
+  mutable std::mutex mutex_;
+  std::vector<OperatorProfile> records_; /// 性能记录
+  std::map<std::thread::id, uint32_t> thread_indexes_; /// 线程和线程编号的对应关系
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_RUNTIME_PROFILER_HPP_
@@ -0,0 +1,123 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_SHARED_PARAMS_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_SHARED_PARAMS_HPP_
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "data/tensor.hpp"
+#include "data/gemm.hpp"
+
+namespace kuiper_infer {
+/// Layer的只读参数在多个计算图和进程之间共享
+/// 参数文件保存所有Layer打包之后的权重，每个进程只读映射同一个文件，操作系统的页缓存中只有一份物理内存
+/// 文件放在/dev/shm下时就是POSIX共享内存，不经过磁盘
+/// Layer通过Share逐个交出参数：记录时保存参数的位置，映射之后把内容相同的参数替换为文件中的数据
+class SharedParams : public std::enable_shared_from_this<SharedParams> {
+ public:
+  /**
+   * 创建记录参数的共享器，记录完成之后通过Save写入参数文件
+   */
+  SharedParams() = default;
+
+  ~SharedParams();
+
+  SharedParams(const SharedParams &) = delete;
+
+  SharedParams &operator=(const SharedParams &) = delete;
+
+  /**
+   * 映射一个参数文件，之后的Share把内容相同的参数替换为文件中的数据
+   * @param path 参数文件路径
+   * @return 映射文件的共享器，文件不存在或者格式不对时为空
+   */
+  static std::shared_ptr<SharedParams> Open(const std::string &path);
+
+  /**
+   * 将记录的参数写入参数文件，先写入临时文件再重命名，同时启动的其他进程不会读到写了一半的文件
+   * @param path 参数文件路径
+   * @return 是否保存成功
+   */
+  bool Save(const std::string &path) const;
+
+  /**
+   * 设置之后交出的参数所属的计算节点，参数在文件中按照节点名称和节点内的顺序区分
+   * @param operator_name 计算节点的名称
+   */
+  void BeginOperator(const std::string &operator_name);
+
+  /**
+   * 交出一个张量参数，映射文件时替换为建立在文件数据上的张量，替换后的张量存在期间共享器保持映射
+   * @param tensor 张量参数
+   */
+  void Share(std::shared_ptr<Tensor<float>> &tensor);
+
+  /**
+   * 交出一个矩阵参数，映射文件时矩阵改为使用文件中的数据，矩阵不持有映射，由所属的Layer保持映射
+   * @param matrix 矩阵参数
+   */
+  void Share(arma::fmat &matrix);
+
+  /**
+   * 交出一个打包的矩阵参数，映射文件时释放自己的数据并引用文件中的数据，引用期间共享器保持映射
+   * @param matrix 打包的矩阵参数
+   */
+  void Share(GemmPackedMatrix &matrix);
+
+  /**
+   * 返回是否映射了参数文件
+   * @return 是否映射
+   */
+  bool mapped() const;
+
+  /**
+   * 返回替换为文件数据的参数数量
+   * @return 参数数量
+   */
+  uint32_t shared_num() const;
+
+  /**
+   * 返回替换为文件数据的参数字节数，这些内存不再由进程自己持有
+   * @return 字节数
+   */
+  size_t shared_bytes() const;
+
+  /**
+   * 返回文件中没有或者内容不同而保留自己数据的参数数量，不为0时文件和当前的模型不一致
+   * @return 参数数量
+   */
+  uint32_t missed_num() const;
+
+ private:
+  /// 参数在文件中的位置
+  struct Entry {
+    uint64_t offset = 0; /// 数据相对文件开头的偏移量，按照64字节对齐
+    uint64_t size = 0; /// float元素数量
+  };
+
+  /**
+   * 记录时保存参数的位置，映射时返回文件中内容相同的数据
+   * @param data 参数的起始地址
+   * @param size float元素数量
+   * @return 文件中的数据，记录时或者没有找到时为空
+   */
+  float *Attach(const float *data, size_t size);
+
+  /**
+   * 统计一个替换为文件数据的参数
+   * @param size float元素数量
+   */
+  void Count(size_t size);
+
+  std::string operator_name_; /// 当前交出参数的计算节点
+  uint32_t operator_index_ = 0; /// 当前节点中下一个参数的顺序
+  std::vector<std::pair<std::string, std::pair<const float *, size_t>>> records_; /// 记录的参数名称、地址和元素数量
+  std::unordered_map<std::string, Entry> entries_; /// 文件中每个参数的位置
+  char *mapped_data_ = nullptr; /// 映射的文件内容
+  size_t mapped_size_ = 0; /// 映射的字节数
+  uint32_t shared_num_ = 0; /// 替换为文件数据的参数数量
+  size_t shared_bytes_ = 0; /// 替换为文件数据的字节数
+  uint32_t missed_num_ = 0; /// 保留自己数据的参数数量
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_SHARED_PARAMS_HPP_
@@ -16,6 +16,7 @@
 #define PNNX_STOREZIP_H
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -33,11 +34,17 @@ class StoreZipReader
 
   int read_file(const std::string& name, char* data);
 
+  // read-only view of a stored file inside the memory mapped archive
+  // the view keeps the mapping alive after close(), null if the archive is not mapped
+  std::shared_ptr<const char> get_file_view(const std::string& name);
+
   int close();
 
  private:
   FILE* fp;
 
+  std::shared_ptr<const char> mapping;
+
   struct StoreZipMeta
   {
     size_t offset;
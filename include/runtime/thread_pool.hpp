@@ -0,0 +1,169 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_THREAD_POOL_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_THREAD_POOL_HPP_
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace kuiper_infer {
+/// 工作窃取线程池，所有Layer和计算图的并行执行都提交到当前线程使用的线程池，默认是全局共享的线程池
+/// 多个模型部署在同一台机器上时，每个计算图或者执行上下文可以使用自己的线程池，限制线程数量和可以运行的CPU
+class ThreadPool {
+ public:
+  /**
+   * 创建线程池
+   * @param thread_num 参与计算的线程数量，包括调用ParallelFor的线程，所以只会额外创建thread_num - 1个工作线程
+   * @param cpus 工作线程可以运行的CPU编号，为空时不限制
+   */
+  explicit ThreadPool(uint32_t thread_num, const std::vector<uint32_t> &cpus = {});
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * 返回全局的线程池，默认线程数量为硬件的并发数量
+   * @return 全局的线程池
+   */
+  static ThreadPool &GetInstance();
+
+  /**
+   * 返回当前线程使用的线程池，工作线程返回所属的线程池，在Scope的作用域内返回指定的线程池，否则返回全局的线程池
+   * Layer通过它提交并行任务，所以计算图和执行上下文设置的线程池对所有Layer生效
+   * @return 当前线程使用的线程池
+   */
+  static ThreadPool &Current();
+
+  /**
+   * 重新设置参与计算的线程数量，不能在有任务执行的时候调用
+   * @param thread_num 参与计算的线程数量
+   */
+  void set_thread_num(uint32_t thread_num);
+
+  /**
+   * 返回参与计算的线程数量
+   * @return 参与计算的线程数量
+   */
+  uint32_t thread_num() const;
+
+  /**
+   * 设置是否将工作线程按编号连续地平均分配并绑定到各个NUMA节点，会重新创建工作线程，不能在有任务执行的时候调用
+   * 绑定之后空闲的线程优先窃取同一个节点上的任务，绑定了节点的外部线程只把任务提交到这个节点的队列
+   * @param numa_binding 是否绑定
+   */
+  void set_numa_binding(bool numa_binding);
+
+  /**
+   * 返回工作线程是否绑定到了NUMA节点
+   * @return 是否绑定
+   */
+  bool numa_binding() const;
+
+  /**
+   * 设置工作线程可以运行的CPU，会重新创建工作线程，不能在有任务执行的时候调用
+   * 同时绑定了NUMA节点时，工作线程只在所属节点上的这些CPU中运行
+   * @param cpus CPU编号，为空时不限制
+   */
+  void set_cpu_affinity(const std::vector<uint32_t> &cpus);
+
+  /**
+   * 返回工作线程可以运行的CPU
+   * @return CPU编号，为空时不限制
+   */
+  const std::vector<uint32_t> &cpu_affinity() const;
+
+  /**
+   * 提交一个任务，工作线程提交的任务放在自己的队列中，其他线程提交的任务轮流放入各个队列
+   * @param task 需要执行的任务
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * 在当前线程中执行一个还没有开始的任务，等待任务完成的线程通过它帮助执行任务而不是阻塞
+   * @return 是否执行了任务
+   */
+  bool RunPendingTask();
+
+  /**
+   * 将[begin, end)区间切分成不超过线程数量的连续块并行执行，当前线程也参与计算并等待所有块完成
+   * 在任务中嵌套调用时不会创建新的线程。Layer在样本内部（例如通道之间）切分区间，batch较小时单个样本也能用满所有的线程
+   * @param begin 区间的起点
+   * @param end 区间的终点
+   * @param function 对区间中每个位置执行的函数
+   */
+  void ParallelFor(uint32_t begin, uint32_t end, const std::function<void(uint32_t)> &function);
+
+  /// 在当前线程中临时指定使用的线程池，析构时恢复之前的设置
+  /// 线程池限制了CPU时当前线程在作用域内也只在这些CPU上运行，因为它同样参与ParallelFor的计算
+  class Scope {
+   public:
+    /**
+     * 指定当前线程使用的线程池
+     * @param thread_pool 线程池，为空时不做任何处理
+     */
+    explicit Scope(ThreadPool *thread_pool);
+
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    bool bound_ = false; /// 是否修改了当前线程的线程池
+    ThreadPool *prev_pool_ = nullptr; /// 之前指定的线程池
+    std::vector<uint32_t> prev_cpus_; /// 之前可以运行的CPU，没有修改时为空
+  };
+
+ private:
+  /**
+   * 启动工作线程
+   */
+  void Start();
+
+  /**
+   * 停止并回收所有的工作线程
+   */
+  void Stop();
+
+  /**
+   * 工作线程的主循环
+   * @param worker_index 工作线程的编号
+   */
+  void WorkerLoop(uint32_t worker_index);
+
+  /**
+   * 优先从自己的队列尾部取任务，否则从其他队列头部窃取任务
+   * @param queue_index 优先访问的队列
+   * @param task 取到的任务
+   * @return 是否取到了任务
+   */
+  bool PopTask(uint32_t queue_index, std::function<void()> &task);
+
+  /// 每个工作线程的任务队列
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  uint32_t thread_num_ = 1; /// 参与计算的线程数量
+  bool numa_binding_ = false; /// 工作线程是否绑定到NUMA节点
+  std::vector<uint32_t> cpus_; /// 工作线程可以运行的CPU，为空时不限制
+  std::vector<std::unique_ptr<WorkerQueue>> queues_; /// 任务队列，数量和工作线程相同
+  std::vector<std::vector<uint32_t>> steal_orders_; /// 每个队列为空时依次窃取的其他队列，同一个节点的队列在前
+  std::vector<std::vector<uint32_t>> node_queues_; /// 绑定NUMA节点时每个节点上的队列
+  std::vector<std::thread> workers_; /// 工作线程
+  std::atomic<uint32_t> pending_num_{0}; /// 已经提交但还没有被取走的任务数量
+  std::atomic<uint32_t> next_queue_{0}; /// 外部线程提交任务时轮流选择的队列
+  std::atomic<bool> stop_{false}; /// 工作线程是否需要退出
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_THREAD_POOL_HPP_
@@ -0,0 +1,67 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_TUNING_CACHE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_TUNING_CACHE_HPP_
+#include <map>
+#include <string>
+#include <cstdint>
+
+namespace kuiper_infer {
+/// Layer调优结果的缓存，键描述了Layer的参数、输入形状和线程数量，值是选出的算法
+/// 缓存文件记录了处理器的型号，在其他型号的处理器上加载时丢弃原有的结果重新调优
+class TuningCache {
+ public:
+  TuningCache();
+
+  /**
+   * 从文件中加载调优结果，替换缓存中原有的结果
+   * @param path 缓存文件路径
+   * @return 文件存在、格式正确并且处理器型号相同时返回true
+   */
+  bool Load(const std::string &path);
+
+  /**
+   * 将调优结果保存到文件
+   * @param path 缓存文件路径
+   * @return 是否保存成功
+   */
+  bool Save(const std::string &path) const;
+
+  /**
+   * 查找一个调优结果
+   * @param key 调优的键
+   * @param value 找到的值
+   * @return 是否找到
+   */
+  bool Find(const std::string &key, int32_t &value) const;
+
+  /**
+   * 记录一个调优结果
+   * @param key 调优的键，不能包含空白字符
+   * @param value 选出的值
+   */
+  void Insert(const std::string &key, int32_t value);
+
+  /**
+   * 返回缓存中调优结果的数量
+   * @return 调优结果的数量
+   */
+  uint32_t size() const;
+
+  /**
+   * 返回加载或者保存之后是否记录了新的结果
+   * @return 是否需要重新保存
+   */
+  bool modified() const;
+
+  /**
+   * 返回缓存对应的处理器型号
+   * @return 处理器型号
+   */
+  const std::string &cpu_model() const;
+
+ private:
+  std::string cpu_model_; /// 当前处理器的型号
+  std::map<std::string, int32_t> entries_; /// 调优的键和选出的值
+  mutable bool modified_ = false; /// 加载或者保存之后是否记录了新的结果
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_TUNING_CACHE_HPP_
@@ -0,0 +1,209 @@
+#ifndef KUIPER_INFER_INCLUDE_RUNTIME_VIDEO_PIPELINE_HPP_
+#define KUIPER_INFER_INCLUDE_RUNTIME_VIDEO_PIPELINE_HPP_
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "data/tensor.hpp"
+#include "data/image.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "runtime/lock_free_queue.hpp"
+
+namespace kuiper_infer {
+/// 视频流中的一帧
+struct VideoFrame {
+  uint64_t index = 0; /// 帧的序号，由流水线按照读取的顺序编号
+  ImageView image; /// 帧的像素，处理完成之前必须保持有效
+  std::shared_ptr<void> holder; /// 持有像素所在的内存，例如解码得到的cv::Mat，帧处理完成后释放
+};
+
+/// 原图坐标上的一个检测框
+struct VideoDetection {
+  float x1 = 0.f; /// 左上角的横坐标
+  float y1 = 0.f; /// 左上角的纵坐标
+  float x2 = 0.f; /// 右下角的横坐标
+  float y2 = 0.f; /// 右下角的纵坐标
+  float score = 0.f; /// 得分
+  int32_t class_id = -1; /// 类别
+};
+
+/// 一帧的检测结果，交给sink之后流水线会复用这块内存
+struct VideoResult {
+  VideoFrame frame; /// 检测的帧
+  std::vector<VideoDetection> detections; /// 按照得分从高到低排列的检测框
+  double latency_ms = 0.; /// 从读取这一帧到交给sink经过的时间，单位为毫秒
+};
+
+/// 读取下一帧，返回false时视频流结束，在读取线程中调用
+using VideoSource = std::function<bool(VideoFrame &)>;
+/// 处理一帧的检测结果，例如绘制或者编码输出，在sink线程中调用
+using VideoSink = std::function<void(VideoResult &)>;
+
+/// 视频流水线的参数
+struct VideoPipelineOptions {
+  ImagePreprocessParam preprocess; /// 预处理参数，输出大小和计算图的输入相同
+  uint32_t batch_size = 1; /// 推理时最多合并的帧数量，不能超过计算图的最大批次
+  uint32_t max_batch_wait_us = 0; /// 批次中第一帧最多等待后续帧的时间，单位为微秒，为0时不等待
+  uint32_t queue_capacity = 4; /// 相邻阶段之间队列的容量，下游来不及处理时上游等待
+  bool drop_frames = false; /// 流水线满时是否丢弃新读取的帧，摄像头等实时视频流开启后延迟不会累积
+};
+
+/// 视频流水线的统计信息
+struct VideoPipelineStats {
+  uint64_t frame_num = 0; /// 已经交给sink的帧数量
+  uint64_t dropped_num = 0; /// 流水线满时丢弃的帧数量
+  uint64_t batch_num = 0; /// 执行的推理批次数量
+  double frames_per_second = 0.; /// 从读取第一帧到最近一帧完成的平均帧率
+  double source_ms = 0.; /// 每帧在读取阶段的平均耗时，单位为毫秒
+  double preprocess_ms = 0.; /// 每帧在预处理阶段的平均耗时
+  double infer_ms = 0.; /// 每帧所在批次的平均推理耗时
+  double postprocess_ms = 0.; /// 每帧在后处理阶段的平均耗时
+  double sink_ms = 0.; /// 每帧在sink中的平均耗时
+  double latency_ms = 0.; /// 每帧从读取到交给sink的平均延迟，包括在队列中等待的时间
+
+  /**
+   * 输出为可读的字符串
+   * @return 统计信息
+   */
+  std::string ToString() const;
+};
+
+/// 视频分析流水线，读取、预处理、批量推理、检测后处理和sink各自在一个线程中运行
+/// 相邻阶段之间通过有界的单生产者单消费者队列传递帧，下游来不及处理时上游等待，反压最终传到读取阶段
+/// 推理阶段使用计算图的线程池，其他阶段和推理同时进行，连续的帧在不同的阶段中重叠执行
+/// 计算图需要开启检测头的后处理，输出每行是x1、y1、x2、y2、得分和类别
+class VideoPipeline {
+ public:
+  /**
+   * 创建流水线并启动所有阶段的线程
+   * @param graph 已经Build完成的计算图，流水线运行期间不能重新Build
+   * @param source 读取下一帧的函数
+   * @param sink 处理检测结果的函数
+   * @param options 流水线的参数
+   */
+  VideoPipeline(std::shared_ptr<RuntimeGraph> graph, VideoSource source, VideoSink sink,
+                const VideoPipelineOptions &options = VideoPipelineOptions());
+
+  ~VideoPipeline();
+
+  VideoPipeline(const VideoPipeline &) = delete;
+
+  VideoPipeline &operator=(const VideoPipeline &) = delete;
+
+  /**
+   * 等待视频流结束并且所有读取的帧都交给sink之后返回
+   */
+  void Wait();
+
+  /**
+   * 停止读取新的帧，已经读取的帧处理完成之后返回
+   */
+  void Stop();
+
+  /**
+   * 返回当前的统计信息，可以在运行期间调用
+   * @return 统计信息
+   */
+  VideoPipelineStats stats() const;
+
+ private:
+  /// 在流水线中流动的一帧，预先分配并循环使用，输入张量不需要每帧重新申请
+  struct VideoTask {
+    VideoResult result; /// 帧和检测结果
+    LetterboxInfo letterbox; /// 预处理时的缩放比例和填充大小
+    std::shared_ptr<Tensor<float>> input; /// 预处理的输出，也是计算图的输入
+    std::shared_ptr<Tensor<float>> output; /// 计算图输出的复制，下一个批次推理时不会被覆盖
+    std::chrono::steady_clock::time_point read_time; /// 开始读取这一帧的时间
+  };
+
+  /// 流水线的一个阶段，从自己的队列中取出帧
+  struct Stage {
+    std::unique_ptr<SpscQueue<VideoTask *>> tasks; /// 上一个阶段交给这个阶段的帧，读取阶段使用空闲的帧
+    QueueWaiter waiter; /// 阶段线程等待上一个阶段交来的帧
+    std::atomic<uint64_t> busy_ns{0}; /// 阶段处理所有帧的总耗时，单位为纳秒
+    std::thread thread; /// 阶段线程
+  };
+
+  /// 流水线各个阶段的编号
+  enum StageIndex {
+    kStageSource = 0,
+    kStagePreprocess = 1,
+    kStageInfer = 2,
+    kStagePostprocess = 3,
+    kStageSink = 4,
+    kStageNum = 5,
+  };
+
+  /**
+   * 读取阶段的主循环，从空闲的帧中取出一个，读取之后交给预处理阶段
+   */
+  void SourceLoop();
+
+  /**
+   * 预处理阶段的主循环
+   */
+  void PreprocessLoop();
+
+  /**
+   * 推理阶段的主循环，把连续的若干帧合并成一个批次
+   */
+  void InferLoop();
+
+  /**
+   * 检测后处理阶段的主循环，把检测框映射回原图的坐标
+   */
+  void PostprocessLoop();
+
+  /**
+   * sink阶段的主循环，处理完成后归还帧
+   */
+  void SinkLoop();
+
+  /**
+   * 等待阶段的队列中有帧并取出，超时之后重新检查，避免错过唤醒
+   * @param stage_index 阶段的编号
+   * @param deadline 最多等待到的时间
+   * @param task 取出的帧，为空时表示视频流结束
+   * @return 超时之前是否取到
+   */
+  bool PopTask(uint32_t stage_index, std::chrono::steady_clock::time_point deadline, VideoTask *&task);
+
+  /**
+   * 把帧交给下一个阶段，队列满时等待
+   * @param stage_index 下一个阶段的编号
+   * @param task 交出的帧，为空时通知下一个阶段退出
+   */
+  void PushTask(uint32_t stage_index, VideoTask *task);
+
+  /**
+   * 一个阶段的处理完成，记录耗时
+   * @param stage_index 阶段的编号
+   * @param start 开始处理的时间
+   * @param frame_num 这次处理的帧数量，批量推理时批次中每一帧都经历了整个批次的耗时
+   */
+  void RecordStage(uint32_t stage_index, std::chrono::steady_clock::time_point start, uint32_t frame_num = 1);
+
+  std::shared_ptr<RuntimeGraph> graph_; /// 执行推理的计算图
+  std::shared_ptr<ExecutionContext> context_; /// 推理阶段使用的执行上下文
+  VideoSource source_; /// 读取帧的函数
+  VideoSink sink_; /// 处理检测结果的函数
+  VideoPipelineOptions options_; /// 流水线的参数
+  std::vector<std::unique_ptr<VideoTask>> task_pool_; /// 所有预先分配的帧
+  std::vector<std::unique_ptr<Stage>> stages_; /// 流水线的各个阶段
+  std::atomic<bool> stop_{false}; /// 读取阶段是否停止读取新的帧
+  std::mutex wait_mutex_; /// 保证只等待线程结束一次
+  std::atomic<uint64_t> frame_num_{0}; /// 已经交给sink的帧数量
+  std::atomic<uint64_t> dropped_num_{0}; /// 丢弃的帧数量
+  std::atomic<uint64_t> batch_num_{0}; /// 执行的推理批次数量
+  std::atomic<uint64_t> latency_ns_{0}; /// 所有帧从读取到交给sink的总延迟
+  std::atomic<int64_t> first_read_ns_{-1}; /// 读取第一帧的时间，相对于start_time_
+  std::atomic<int64_t> last_done_ns_{0}; /// 最近一帧交给sink的时间，相对于start_time_
+  std::chrono::steady_clock::time_point start_time_; /// 流水线创建的时间
+};
+}
+#endif //KUIPER_INFER_INCLUDE_RUNTIME_VIDEO_PIPELINE_HPP_
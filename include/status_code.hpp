@@ -31,6 +31,7 @@ enum class InferStatus {
   kInferFailedOutputSizeError = 7,
   kInferFailedOperationUnknown = 8,
   kInferFailedYoloStageNumberError = 9,
+  kInferFailedDeviceNotSupported = 10,
 
   kInferSuccess = 0,
 };
@@ -53,6 +54,9 @@ enum class ParseParameterAttrStatus {
   kParameterMissingGroups = 13,
   kParameterMissingScale = 14,
   kParameterMissingResizeMode = 15,
+  kParameterMissingActivation = 16,
+  kParameterMissingGlobalPooling = 17,
+  kParameterMissingResidual = 18,
 
   kAttrMissingBias = 21,
   kAttrMissingWeight = 22,
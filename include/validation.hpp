@@ -0,0 +1,39 @@
+#ifndef KUIPER_INFER_INCLUDE_VALIDATION_HPP_
+#define KUIPER_INFER_INCLUDE_VALIDATION_HPP_
+#include <glog/logging.h>
+
+// 合法性检查的级别，由CMake的KUIPER_VALIDATION选项设置
+// Full：每次Forward都检查输入输出的形状；Build：形状只在Build和重新规划时检查，Forward不再检查；Off：都不检查
+#define KUIPER_VALIDATION_OFF 0
+#define KUIPER_VALIDATION_BUILD 1
+#define KUIPER_VALIDATION_FULL 2
+
+#ifndef KUIPER_VALIDATION_LEVEL
+#define KUIPER_VALIDATION_LEVEL KUIPER_VALIDATION_FULL
+#endif
+
+// 关闭的检查仍然参与编译，条件中的变量不会产生未使用的警告，但是不会执行
+#define KUIPER_DISABLED_CHECK(condition) while (false) CHECK(condition)
+
+/// Build和重新规划执行计划时的检查，执行计划确定之后形状不再变化
+#if KUIPER_VALIDATION_LEVEL >= KUIPER_VALIDATION_BUILD
+#define KUIPER_BUILD_CHECK(condition) CHECK(condition)
+#else
+#define KUIPER_BUILD_CHECK(condition) KUIPER_DISABLED_CHECK(condition)
+#endif
+
+/// 每次Forward时对输入输出形状的检查，Build时已经检查过的图中是多余的
+#if KUIPER_VALIDATION_LEVEL >= KUIPER_VALIDATION_FULL
+#define KUIPER_FORWARD_CHECK(condition) CHECK(condition)
+#else
+#define KUIPER_FORWARD_CHECK(condition) KUIPER_DISABLED_CHECK(condition)
+#endif
+
+/// 逐元素访问等内层循环中的检查，只在调试版本中执行
+#if KUIPER_VALIDATION_LEVEL >= KUIPER_VALIDATION_FULL && !defined(NDEBUG)
+#define KUIPER_DEBUG_CHECK(condition) CHECK(condition)
+#else
+#define KUIPER_DEBUG_CHECK(condition) KUIPER_DISABLED_CHECK(condition)
+#endif
+
+#endif //KUIPER_INFER_INCLUDE_VALIDATION_HPP_
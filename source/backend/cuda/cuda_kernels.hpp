@@ -0,0 +1,99 @@
+#ifndef KUIPER_INFER_SOURCE_BACKEND_CUDA_CUDA_KERNELS_HPP_
+#define KUIPER_INFER_SOURCE_BACKEND_CUDA_CUDA_KERNELS_HPP_
+#include <cstdint>
+#include "data/device.hpp"
+#include "layer/abstract/activation.hpp"
+
+// CUDA设备上的计算内核，只在开启USE_CUDA时编译，所有指针都是设备内存
+// 张量在设备上的排列和主机相同：通道依次排列，每个通道按列存储，(row, col)位于col * rows + row
+namespace kuiper_infer {
+namespace cuda {
+/// 设备上逐元素的二元运算
+enum class BinaryOperation {
+  kAdd = 0,
+  kMultiply = 1,
+};
+
+/**
+ * 展开卷积的输入，结果是行优先的(channels * kernel_h * kernel_w) x (output_h * output_w)矩阵
+ * 第ic * kernel_h * kernel_w + kx * kernel_h + ky行对应卷积核的一个位置，和打包后的卷积核顺序相同
+ * 第ox * output_h + oy列对应一个输出位置，和输出通道的存储顺序相同，越过边界的位置填充0
+ */
+void Im2Col(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t kernel_h,
+            uint32_t kernel_w, uint32_t stride_h, uint32_t stride_w, uint32_t padding_h, uint32_t padding_w,
+            uint32_t output_h, uint32_t output_w, float *col);
+
+/**
+ * 行优先的矩阵乘法c = a * b，a是m x k，b是k x n，c是m x n
+ */
+void Gemm(uint32_t m, uint32_t n, uint32_t k, const float *a, const float *b, float *c);
+
+/**
+ * 对channels个连续的通道原地加上每个通道的偏移量和残差并计算激活函数
+ * @param bias 每个通道的偏移量，为空时不加
+ * @param residual 和data形状相同的残差，为空时不加
+ */
+void BiasActivation(ActivationType activation, const float *bias, uint32_t channels, uint32_t plane_size,
+                    float *data, const float *residual = nullptr);
+
+/**
+ * 对size个元素计算激活函数，output可以等于input
+ */
+void Activation(ActivationType activation, const float *input, uint32_t size, float *output);
+
+/**
+ * 最大池化，越过边界的位置不参与计算
+ */
+void MaxPooling(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t pooling_h,
+                uint32_t pooling_w, uint32_t stride_h, uint32_t stride_w, uint32_t padding_h, uint32_t padding_w,
+                uint32_t output_h, uint32_t output_w, float *output);
+
+/**
+ * 没有填充的平均池化，窗口完全位于输入之内
+ */
+void AveragePooling(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t pooling_h,
+                    uint32_t pooling_w, uint32_t stride_h, uint32_t stride_w, uint32_t output_h, uint32_t output_w,
+                    float *output);
+
+/**
+ * 逐元素的二元运算，广播的输入每个通道只有一个值
+ * @param lhs_broadcast lhs是否在通道内广播
+ * @param rhs_broadcast rhs是否在通道内广播
+ */
+void ElementBinary(BinaryOperation operation, const float *lhs, bool lhs_broadcast, const float *rhs,
+                   bool rhs_broadcast, uint32_t channels, uint32_t plane_size, float *output);
+
+/**
+ * 设备内存之间的复制
+ */
+void Copy(const float *input, uint32_t size, float *output);
+
+/// 设备上预处理一张图片的参数，缩放后的大小和填充位置在主机上按照CPU预处理的规则计算
+struct ImagePreprocessArgs {
+  uint32_t height = 0; /// 原图的高度
+  uint32_t width = 0; /// 原图的宽度
+  uint32_t channels = 3; /// 原图每个像素的通道数量，只使用前三个通道
+  uint32_t step = 0; /// 原图相邻两行之间的字节数
+  uint32_t resized_h = 0; /// 缩放后的高度
+  uint32_t resized_w = 0; /// 缩放后的宽度
+  uint32_t pad_top = 0; /// 上方填充的行数
+  uint32_t pad_left = 0; /// 左侧填充的列数
+  uint32_t target_h = 0; /// 输出的高度
+  uint32_t target_w = 0; /// 输出的宽度
+  bool swap_rb = true; /// 是否交换第一个和第三个通道
+  float pad_value = 114.f; /// 填充区域的像素值
+  float scale[3] = {1.f, 1.f, 1.f}; /// 每个输出通道的缩放
+  float shift[3] = {0.f, 0.f, 0.f}; /// 每个输出通道缩放之后的偏移
+};
+
+/**
+ * 对一张按行存放、通道交错的8位图片做letterbox缩放、通道交换和归一化，和CPU上的PreprocessImage结果相同
+ * 缩放使用像素中心对齐的双线性插值，输出和Tensor(3, target_h, target_w)的布局相同
+ * @param image 设备上原图第一行的起始地址
+ * @param args 预处理参数
+ * @param output 设备上输出的起始地址
+ */
+void PreprocessImage(const uint8_t *image, const ImagePreprocessArgs &args, float *output);
+}
+}
+#endif //KUIPER_INFER_SOURCE_BACKEND_CUDA_CUDA_KERNELS_HPP_
@@ -0,0 +1,68 @@
+#include <cuda_runtime.h>
+#include "../../cuda_kernels.hpp"
+
+constexpr unsigned int kActivationThreads = 256;
+
+// 和CPU上标量的计算顺序相同
+__device__ inline float activate(kuiper_infer::ActivationType activation, float x) {
+  switch (activation) {
+    case kuiper_infer::ActivationType::kActivationRelu:
+      return x > 0.f ? x : 0.f;
+    case kuiper_infer::ActivationType::kActivationSigmoid:
+      return 1.f / (1.f + expf(-x));
+    case kuiper_infer::ActivationType::kActivationSiLU:
+      return x / (1.f + expf(-x));
+    case kuiper_infer::ActivationType::kActivationHardSwish:
+      return x <= -3.f ? 0.f : (x >= 3.f ? x : x * (x + 3) / 6);
+    case kuiper_infer::ActivationType::kActivationHardSigmoid:
+      return x <= -3.f ? 0.f : (x >= 3.f ? 1.f : x / 6.f + 0.5f);
+    default:
+      return x;
+  }
+}
+
+__global__ void activation_kernel(kuiper_infer::ActivationType activation, const float *input, unsigned int size,
+                                  float *output) {
+  const unsigned int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index < size) {
+    output[index] = activate(activation, input[index]);
+  }
+}
+
+__global__ void bias_activation_kernel(kuiper_infer::ActivationType activation, const float *bias,
+                                       const float *residual, unsigned int plane_size, unsigned int size,
+                                       float *data) {
+  const unsigned int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index < size) {
+    float value = bias != nullptr ? data[index] + bias[index / plane_size] : data[index];
+    if (residual != nullptr) {
+      value += residual[index];
+    }
+    data[index] = activate(activation, value);
+  }
+}
+
+namespace kuiper_infer {
+namespace cuda {
+void BiasActivation(ActivationType activation, const float *bias, uint32_t channels, uint32_t plane_size,
+                    float *data, const float *residual) {
+  const uint32_t size = channels * plane_size;
+  if (size == 0 || (bias == nullptr && residual == nullptr && activation == ActivationType::kActivationNone)) {
+    return;
+  }
+  const uint32_t grid = (size + kActivationThreads - 1) / kActivationThreads;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  bias_activation_kernel<<<grid, kActivationThreads, 0, stream>>>(activation, bias, residual, plane_size, size,
+                                                                  data);
+}
+
+void Activation(ActivationType activation, const float *input, uint32_t size, float *output) {
+  if (size == 0) {
+    return;
+  }
+  const uint32_t grid = (size + kActivationThreads - 1) / kActivationThreads;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  activation_kernel<<<grid, kActivationThreads, 0, stream>>>(activation, input, size, output);
+}
+}
+}
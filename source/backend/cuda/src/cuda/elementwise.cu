@@ -0,0 +1,40 @@
+#include <cuda_runtime.h>
+#include "../../cuda_kernels.hpp"
+
+constexpr unsigned int kElementThreads = 256;
+
+__global__ void element_binary_kernel(kuiper_infer::cuda::BinaryOperation operation, const float *lhs,
+                                      bool lhs_broadcast, const float *rhs, bool rhs_broadcast,
+                                      unsigned int plane_size, unsigned int size, float *output) {
+  const unsigned int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index >= size) {
+    return;
+  }
+  const float x = lhs[lhs_broadcast ? index / plane_size : index];
+  const float y = rhs[rhs_broadcast ? index / plane_size : index];
+  output[index] = operation == kuiper_infer::cuda::BinaryOperation::kAdd ? x + y : x * y;
+}
+
+namespace kuiper_infer {
+namespace cuda {
+void ElementBinary(BinaryOperation operation, const float *lhs, bool lhs_broadcast, const float *rhs,
+                   bool rhs_broadcast, uint32_t channels, uint32_t plane_size, float *output) {
+  const uint32_t size = channels * plane_size;
+  if (size == 0) {
+    return;
+  }
+  const uint32_t grid = (size + kElementThreads - 1) / kElementThreads;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  element_binary_kernel<<<grid, kElementThreads, 0, stream>>>(
+      operation, lhs, lhs_broadcast, rhs, rhs_broadcast, plane_size, size, output);
+}
+
+void Copy(const float *input, uint32_t size, float *output) {
+  if (size == 0 || input == output) {
+    return;
+  }
+  cudaMemcpyAsync(output, input, size * sizeof(float), cudaMemcpyDeviceToDevice,
+                  static_cast<cudaStream_t>(DeviceStream::Current()));
+}
+}
+}
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fstream>
+#include "../../cuda_kernels.hpp"
 
 #define SMEM_LDA (128)
 #define SMEM_LDB (128)
@@ -76,28 +77,20 @@ void sgemm_128x128x8(int m, int n, int k, const float *a, const float *b, float
     }
 }
 
+// 每个线程块计算c中BLOCK x BLOCK的子矩阵，越过边界的元素按0读入，任意形状都可以使用
 template <int BLOCK>
-__global__ void sgemm(int m, int n, int k, float *a, float *b, float *c) {
-  // blockIdx control subpanel matrix
-
+__global__ void sgemm(int m, int n, int k, const float *a, const float *b, float *c) {
   const int tx = threadIdx.x;
   const int ty = threadIdx.y;
-  const int bx = blockIdx.x;
-  const int by = blockIdx.y;
-
-  //printf("tx = %d, ty = %d, bx = %d, by = %d, BLOCK = %d, k = %d, by * BLOCK * k = %d\n", tx, ty, bx, by, BLOCK, k, by * BLOCK * k);
-  float *begin_a = a + by * blockDim.y * k;
-  float *begin_b = b + bx * blockDim.x;
-  float *end_a = begin_a + k;
+  const int row = blockIdx.y * BLOCK + ty;
+  const int col = blockIdx.x * BLOCK + tx;
 
+  __shared__ float ashare[BLOCK][BLOCK];
+  __shared__ float bshare[BLOCK][BLOCK];
   float sum = 0.f;
-  for (float *a_ptr = begin_a, *b_ptr = begin_b; a_ptr < end_a;
-       a_ptr += BLOCK, b_ptr += BLOCK * n) {
-    __shared__ float ashare[BLOCK][BLOCK];
-    __shared__ float bshare[BLOCK][BLOCK];
-
-    ashare[ty][tx] = a_ptr[ty * k + tx];
-    bshare[ty][tx] = b_ptr[ty * n + tx];
+  for (int k0 = 0; k0 < k; k0 += BLOCK) {
+    ashare[ty][tx] = (row < m && k0 + tx < k) ? a[row * k + k0 + tx] : 0.f;
+    bshare[ty][tx] = (k0 + ty < k && col < n) ? b[(k0 + ty) * n + col] : 0.f;
     __syncthreads();
 
 #pragma unroll
@@ -107,7 +100,9 @@ __global__ void sgemm(int m, int n, int k, float *a, float *b, float *c) {
     __syncthreads();
   }
 
-  c[(BLOCK * by + ty) * n + BLOCK * bx + tx] = sum;
+  if (row < m && col < n) {
+    c[row * n + col] = sum;
+  }
 }
 
 template <int BLOCK>
@@ -125,42 +120,29 @@ __global__ void sgemm_naive(int m, int n, int k, float *a, float *b, float *c) {
 
 
 void launch_sgemm(int m, int n, int k, float *a, float *b, float *c){
-
-    if (m >= 32 && n >= 32 && k >=8){
+    // 内核提交到当前线程指定的流上，没有指定时使用默认流
+    const cudaStream_t stream = static_cast<cudaStream_t>(kuiper_infer::DeviceStream::Current());
+    // 128x128x8的内核没有边界检查，只用于对齐的形状，线程块的x方向对应c的列
+    if (m % 128 == 0 && n % 128 == 0 && k % 8 == 0){
         constexpr int block = 128;
-        dim3 grid((m + block -1) / block, (n + block -1) / block);
-        sgemm_128x128x8<<<grid, 256>>>(m, n, k, a, b, c);
-    }
-    else if (m >= 32 && n >= 32 && k >= 1){
-        constexpr int BLOCK = 32;
-        dim3 block(BLOCK, BLOCK);
-        dim3 grid((m + BLOCK -1) / BLOCK, (n + BLOCK -1) / BLOCK);
-        sgemm<BLOCK><<<grid, block>>>(m, n, k, a, b, c);
+        dim3 grid(n / block, m / block);
+        sgemm_128x128x8<<<grid, 256, 0, stream>>>(m, n, k, a, b, c);
     }
     else {
         constexpr int BLOCK = 16;
         dim3 block(BLOCK, BLOCK);
-        dim3 grid((m + BLOCK -1) / BLOCK, (n + BLOCK -1) / BLOCK);
-        sgemm_naive<BLOCK><<<grid, block>>>(m, n, k, a, b, c);
+        dim3 grid((n + BLOCK -1) / BLOCK, (m + BLOCK -1) / BLOCK);
+        sgemm<BLOCK><<<grid, block, 0, stream>>>(m, n, k, a, b, c);
     }
 }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+namespace kuiper_infer {
+namespace cuda {
+void Gemm(uint32_t m, uint32_t n, uint32_t k, const float *a, const float *b, float *c) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  launch_sgemm(int(m), int(n), int(k), const_cast<float *>(a), const_cast<float *>(b), c);
+}
+}
+}
@@ -3,6 +3,7 @@
 #include <cuda_runtime.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "../../cuda_kernels.hpp"
 
 #define THREADS_PER_BLOCK (512)
 
@@ -142,9 +143,52 @@ void launch_kernel2col(
 
 }
 
+// 带填充和非正方形卷积核的展开，每个线程写入展开矩阵的一个元素，相邻线程写入同一行中相邻的输出位置
+__global__ void im2col_padded(
+    const float *in,
+    int input_h,
+    int input_w,
+    int kernel_h,
+    int kernel_w,
+    int stride_h,
+    int stride_w,
+    int padding_h,
+    int padding_w,
+    int output_h,
+    int output_w,
+    int total,
+    float *col){
+
+    const int index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= total){
+        return;
+    }
+    const int plane = output_h * output_w;
+    const int p = index % plane;
+    const int r = index / plane;
+    const int ky = r % kernel_h;
+    const int kx = (r / kernel_h) % kernel_w;
+    const int ic = r / (kernel_h * kernel_w);
+    const int iy = (p % output_h) * stride_h - padding_h + ky;
+    const int ix = (p / output_h) * stride_w - padding_w + kx;
+    col[index] = (iy >= 0 && iy < input_h && ix >= 0 && ix < input_w) ?
+                 in[(ic * input_w + ix) * input_h + iy] : 0.f;
+}
 
-
-
-
-
-
+namespace kuiper_infer {
+namespace cuda {
+void Im2Col(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t kernel_h,
+            uint32_t kernel_w, uint32_t stride_h, uint32_t stride_w, uint32_t padding_h, uint32_t padding_w,
+            uint32_t output_h, uint32_t output_w, float *col) {
+  const int total = int(channels * kernel_h * kernel_w * output_h * output_w);
+  if (total == 0) {
+    return;
+  }
+  const int grid = (total + THREADS_PER_BLOCK - 1) / THREADS_PER_BLOCK;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  im2col_padded<<<grid, THREADS_PER_BLOCK, 0, stream>>>(input, int(input_h), int(input_w), int(kernel_h), int(kernel_w),
+                                                        int(stride_h), int(stride_w), int(padding_h), int(padding_w),
+                                                        int(output_h), int(output_w), total, col);
+}
+}
+}
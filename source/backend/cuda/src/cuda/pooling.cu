@@ -0,0 +1,84 @@
+#include <cuda_runtime.h>
+#include <cfloat>
+#include "../../cuda_kernels.hpp"
+
+constexpr unsigned int kPoolingThreads = 256;
+
+// 每个线程计算一个输出元素，相邻线程对应同一列中相邻的输出行
+__global__ void max_pooling_kernel(const float *input, int input_h, int input_w, int pooling_h, int pooling_w,
+                                   int stride_h, int stride_w, int padding_h, int padding_w, int output_h,
+                                   int output_w, int total, float *output) {
+  const int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index >= total) {
+    return;
+  }
+  const int plane = output_h * output_w;
+  const int c = index / plane;
+  const int oy = index % plane % output_h;
+  const int ox = index % plane / output_h;
+  const int y_begin = max(oy * stride_h - padding_h, 0);
+  const int y_end = min(oy * stride_h - padding_h + pooling_h, input_h);
+  const int x_begin = max(ox * stride_w - padding_w, 0);
+  const int x_end = min(ox * stride_w - padding_w + pooling_w, input_w);
+  const float *input_channel = input + c * input_h * input_w;
+  float value = -FLT_MAX;
+  for (int x = x_begin; x < x_end; ++x) {
+    for (int y = y_begin; y < y_end; ++y) {
+      value = fmaxf(value, input_channel[x * input_h + y]);
+    }
+  }
+  output[index] = value;
+}
+
+__global__ void average_pooling_kernel(const float *input, int input_h, int input_w, int pooling_h, int pooling_w,
+                                       int stride_h, int stride_w, int output_h, int output_w, int total,
+                                       float *output) {
+  const int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index >= total) {
+    return;
+  }
+  const int plane = output_h * output_w;
+  const int c = index / plane;
+  const int oy = index % plane % output_h;
+  const int ox = index % plane / output_h;
+  const float *window = input + c * input_h * input_w + ox * stride_w * input_h + oy * stride_h;
+  float sum = 0.f;
+  for (int x = 0; x < pooling_w; ++x) {
+    for (int y = 0; y < pooling_h; ++y) {
+      sum += window[x * input_h + y];
+    }
+  }
+  output[index] = sum / float(pooling_h * pooling_w);
+}
+
+namespace kuiper_infer {
+namespace cuda {
+void MaxPooling(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t pooling_h,
+                uint32_t pooling_w, uint32_t stride_h, uint32_t stride_w, uint32_t padding_h, uint32_t padding_w,
+                uint32_t output_h, uint32_t output_w, float *output) {
+  const int total = int(channels * output_h * output_w);
+  if (total == 0) {
+    return;
+  }
+  const int grid = (total + kPoolingThreads - 1) / kPoolingThreads;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  max_pooling_kernel<<<grid, kPoolingThreads, 0, stream>>>(
+      input, int(input_h), int(input_w), int(pooling_h), int(pooling_w), int(stride_h), int(stride_w),
+      int(padding_h), int(padding_w), int(output_h), int(output_w), total, output);
+}
+
+void AveragePooling(const float *input, uint32_t channels, uint32_t input_h, uint32_t input_w, uint32_t pooling_h,
+                    uint32_t pooling_w, uint32_t stride_h, uint32_t stride_w, uint32_t output_h, uint32_t output_w,
+                    float *output) {
+  const int total = int(channels * output_h * output_w);
+  if (total == 0) {
+    return;
+  }
+  const int grid = (total + kPoolingThreads - 1) / kPoolingThreads;
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  average_pooling_kernel<<<grid, kPoolingThreads, 0, stream>>>(
+      input, int(input_h), int(input_w), int(pooling_h), int(pooling_w), int(stride_h), int(stride_w),
+      int(output_h), int(output_w), total, output);
+}
+}
+}
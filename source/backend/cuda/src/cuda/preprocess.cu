@@ -1,5 +1,6 @@
 #include <cuda_runtime.h>
 #include <stdio.h>
+#include "../../cuda_kernels.hpp"
 
 constexpr unsigned int kThreadsPerBlock = 256;
 constexpr float kDefaultFillValue = 114.f/255.f;
@@ -189,19 +190,77 @@ void launchResizeKernel(
 
 }
 
+/**
+ * 像素中心对齐的插值位置，和CPU预处理的插值表相同，越过最后一个像素时两侧都取最后一个像素
+ * @param dst_index 缩放后的位置
+ * @param scale 原图大小和缩放后大小的比例
+ * @param src_size 原图的大小
+ * @param index0 左侧或者上方的像素
+ * @param index1 右侧或者下方的像素
+ * @return 右侧或者下方像素的权重
+ */
+__device__ inline float resize_position(int dst_index, float scale, int src_size, int &index0, int &index1) {
+  const float position = fmaxf((float(dst_index) + 0.5f) * scale - 0.5f, 0.f);
+  index0 = int(position);
+  index1 = index0 + 1;
+  float weight = position - float(index0);
+  if (index0 >= src_size - 1) {
+    index0 = src_size - 1;
+    index1 = index0;
+    weight = 0.f;
+  }
+  return weight;
+}
 
+// 每个线程计算一个输出位置的三个通道，相邻线程对应同一列中相邻的输出行，写入输出时可以合并访问
+__global__ void preprocess_image_kernel(const uint8_t *image, kuiper_infer::cuda::ImagePreprocessArgs args,
+                                        float *output) {
+  const int index = blockIdx.x * blockDim.x + threadIdx.x;
+  const int plane = int(args.target_h * args.target_w);
+  if (index >= plane) {
+    return;
+  }
+  const int y = index % int(args.target_h) - int(args.pad_top);
+  const int x = index / int(args.target_h) - int(args.pad_left);
+  if (y < 0 || y >= int(args.resized_h) || x < 0 || x >= int(args.resized_w)) {
+    for (int c = 0; c < 3; ++c) {
+      output[c * plane + index] = args.pad_value * args.scale[c] + args.shift[c];
+    }
+    return;
+  }
+
+  int y0 = 0;
+  int y1 = 0;
+  int x0 = 0;
+  int x1 = 0;
+  const float weight_y = resize_position(y, float(args.height) / float(args.resized_h), int(args.height), y0, y1);
+  const float weight_x = resize_position(x, float(args.width) / float(args.resized_w), int(args.width), x0, x1);
+  const uint8_t *row0 = image + size_t(y0) * args.step;
+  const uint8_t *row1 = image + size_t(y1) * args.step;
+  const int offset0 = x0 * int(args.channels);
+  const int offset1 = x1 * int(args.channels);
+  // 先水平插值再垂直插值，垂直插值和归一化合并为一次乘加，计算顺序和CPU相同
+  for (int c = 0; c < 3; ++c) {
+    const int src_channel = args.swap_rb ? 2 - c : c;
+    const float top0 = float(row0[offset0 + src_channel]);
+    const float top = top0 + (float(row0[offset1 + src_channel]) - top0) * weight_x;
+    const float bottom0 = float(row1[offset0 + src_channel]);
+    const float bottom = bottom0 + (float(row1[offset1 + src_channel]) - bottom0) * weight_x;
+    output[c * plane + index] =
+        top * ((1.f - weight_y) * args.scale[c]) + bottom * (weight_y * args.scale[c]) + args.shift[c];
+  }
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+namespace kuiper_infer {
+namespace cuda {
+void PreprocessImage(const uint8_t *image, const ImagePreprocessArgs &args, float *output) {
+  const int plane = int(args.target_h * args.target_w);
+  if (plane == 0) {
+    return;
+  }
+  const int grid = (plane + int(kThreadsPerBlock) - 1) / int(kThreadsPerBlock);
+  const cudaStream_t stream = static_cast<cudaStream_t>(DeviceStream::Current());
+  preprocess_image_kernel<<<grid, kThreadsPerBlock, 0, stream>>>(image, args, output);
+}
+}
+}
@@ -0,0 +1,232 @@
+#include "data/device.hpp"
+#include <glog/logging.h>
+#ifdef USE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+namespace kuiper_infer {
+#ifdef USE_CUDA
+#define KUIPER_CUDA_CHECK(call)                                                                 \
+  do {                                                                                          \
+    const cudaError_t error = (call);                                                           \
+    CHECK(error == cudaSuccess) << "CUDA error " << int(error) << ": " << cudaGetErrorString(error); \
+  } while (0)
+#endif
+
+// 当前线程在DeviceStream::Scope中指定的流
+static thread_local void *scoped_stream = nullptr;
+
+bool DeviceAvailable(DeviceType device) {
+  if (device == DeviceType::kDeviceCPU) {
+    return true;
+  }
+#ifdef USE_CUDA
+  static const bool cuda_available = []() {
+    int device_count = 0;
+    return cudaGetDeviceCount(&device_count) == cudaSuccess && device_count > 0;
+  }();
+  return cuda_available;
+#else
+  return false;
+#endif
+}
+
+void SynchronizeDevice(DeviceType device) {
+  if (device == DeviceType::kDeviceCPU) {
+    return;
+  }
+#ifdef USE_CUDA
+  KUIPER_CUDA_CHECK(cudaDeviceSynchronize());
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+void CopyHostToDevice(const float *host, float *device, size_t size) {
+  if (size == 0) {
+    return;
+  }
+#ifdef USE_CUDA
+  KUIPER_CUDA_CHECK(cudaMemcpyAsync(device, host, size * sizeof(float), cudaMemcpyHostToDevice,
+                                    static_cast<cudaStream_t>(scoped_stream)));
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+void CopyBytesHostToDevice(const void *host, void *device, size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+#ifdef USE_CUDA
+  KUIPER_CUDA_CHECK(cudaMemcpyAsync(device, host, bytes, cudaMemcpyHostToDevice,
+                                    static_cast<cudaStream_t>(scoped_stream)));
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+void CopyDeviceToHost(const float *device, float *host, size_t size) {
+  if (size == 0) {
+    return;
+  }
+#ifdef USE_CUDA
+  KUIPER_CUDA_CHECK(cudaMemcpyAsync(host, device, size * sizeof(float), cudaMemcpyDeviceToHost,
+                                    static_cast<cudaStream_t>(scoped_stream)));
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+DeviceStream::DeviceStream() {
+#ifdef USE_CUDA
+  cudaStream_t stream = nullptr;
+  KUIPER_CUDA_CHECK(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+  stream_ = stream;
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+DeviceStream::~DeviceStream() {
+#ifdef USE_CUDA
+  if (stream_ != nullptr) {
+    cudaStreamDestroy(static_cast<cudaStream_t>(stream_));
+  }
+#endif
+}
+
+void DeviceStream::Synchronize() const {
+#ifdef USE_CUDA
+  KUIPER_CUDA_CHECK(cudaStreamSynchronize(static_cast<cudaStream_t>(stream_)));
+#endif
+}
+
+void *DeviceStream::handle() const {
+  return stream_;
+}
+
+void *DeviceStream::Current() {
+  return scoped_stream;
+}
+
+void DeviceStream::SynchronizeCurrent() {
+#ifdef USE_CUDA
+  if (scoped_stream != nullptr) {
+    KUIPER_CUDA_CHECK(cudaStreamSynchronize(static_cast<cudaStream_t>(scoped_stream)));
+  } else {
+    KUIPER_CUDA_CHECK(cudaDeviceSynchronize());
+  }
+#endif
+}
+
+DeviceStream::Scope::Scope(const DeviceStream *stream) {
+  if (stream == nullptr) {
+    return;
+  }
+  bound_ = true;
+  prev_stream_ = scoped_stream;
+  scoped_stream = stream->handle();
+}
+
+DeviceStream::Scope::~Scope() {
+  if (bound_) {
+    scoped_stream = prev_stream_;
+  }
+}
+
+std::shared_ptr<DeviceBuffer> DeviceBuffer::View(const std::shared_ptr<DeviceBuffer> &base, size_t offset,
+                                                 size_t size) {
+  CHECK(base != nullptr);
+  CHECK(offset + size <= base->size_) << "The view of device buffer exceeds the end of the buffer";
+  std::shared_ptr<DeviceBuffer> view = std::make_shared<DeviceBuffer>();
+  view->data_ = base->data_ + offset;
+  view->size_ = size;
+  view->base_ = base->base_ != nullptr ? base->base_ : base;
+  return view;
+}
+
+DeviceBuffer::~DeviceBuffer() {
+#ifdef USE_CUDA
+  // 进程退出时CUDA上下文可能已经销毁，释放失败不再报错
+  if (data_ != nullptr && base_ == nullptr) {
+    cudaFree(data_);
+  }
+#endif
+}
+
+void DeviceBuffer::Reserve(size_t size) {
+  if (size <= size_) {
+    return;
+  }
+  CHECK(base_ == nullptr) << "The view of device buffer can not grow";
+#ifdef USE_CUDA
+  if (data_ != nullptr) {
+    KUIPER_CUDA_CHECK(cudaFree(data_));
+    data_ = nullptr;
+    size_ = 0;
+  }
+  KUIPER_CUDA_CHECK(cudaMalloc(reinterpret_cast<void **>(&data_), size * sizeof(float)));
+  size_ = size;
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+void DeviceBuffer::CopyFromHost(const float *host, size_t size) {
+  CHECK(host != nullptr || size == 0);
+  this->Reserve(size);
+  CopyHostToDevice(host, data_, size);
+}
+
+void DeviceBuffer::CopyToHost(float *host, size_t size) const {
+  this->CopyToHostAsync(host, size);
+  DeviceStream::SynchronizeCurrent();
+}
+
+void DeviceBuffer::CopyToHostAsync(float *host, size_t size) const {
+  CHECK(size <= size_) << "The copy size " << size << " exceeds the device buffer size " << size_;
+  CopyDeviceToHost(data_, host, size);
+}
+
+float *DeviceBuffer::data() const {
+  return data_;
+}
+
+size_t DeviceBuffer::size() const {
+  return size_;
+}
+
+PinnedBuffer::~PinnedBuffer() {
+#ifdef USE_CUDA
+  if (data_ != nullptr) {
+    cudaFreeHost(data_);
+  }
+#endif
+}
+
+void PinnedBuffer::Reserve(size_t size) {
+  if (size <= size_) {
+    return;
+  }
+#ifdef USE_CUDA
+  if (data_ != nullptr) {
+    KUIPER_CUDA_CHECK(cudaFreeHost(data_));
+    data_ = nullptr;
+    size_ = 0;
+  }
+  KUIPER_CUDA_CHECK(cudaHostAlloc(reinterpret_cast<void **>(&data_), size * sizeof(float), cudaHostAllocDefault));
+  size_ = size;
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+#endif
+}
+
+float *PinnedBuffer::data() const {
+  return data_;
+}
+
+size_t PinnedBuffer::size() const {
+  return size_;
+}
+}
@@ -0,0 +1,231 @@
+#include "data/gemm.hpp"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <glog/logging.h>
+#include "../kernels/cpu_kernels.hpp"
+
+// 不包含armadillo，armadillo按照自己的方式声明BLAS的函数，和这里的声明会冲突
+#if !defined(KUIPER_GEMM_BACKEND_BUILTIN)
+extern "C" {
+void sgemm_(const char *transa, const char *transb, const int *m, const int *n, const int *k, const float *alpha,
+            const float *a, const int *lda, const float *b, const int *ldb, const float *beta, float *c,
+            const int *ldc);
+#if defined(KUIPER_GEMM_BACKEND_OPENBLAS)
+void openblas_set_num_threads(int num_threads);
+int openblas_get_num_threads();
+#elif defined(KUIPER_GEMM_BACKEND_MKL)
+void MKL_Set_Num_Threads(int num_threads);
+int MKL_Get_Max_Threads();
+#elif defined(KUIPER_GEMM_BACKEND_BLIS)
+void bli_thread_set_num_threads(int64_t num_threads);
+int64_t bli_thread_get_num_threads();
+#endif
+}
+#endif
+
+namespace kuiper_infer {
+bool GemmPackedMatrix::empty() const {
+  return packed_size() == 0;
+}
+
+const float *GemmPackedMatrix::packed_data() const {
+  return shared_data ? shared_data.get() : data.data();
+}
+
+size_t GemmPackedMatrix::packed_size() const {
+  return shared_data ? shared_size : data.size();
+}
+
+static uint32_t PaddedSize(uint32_t size, uint32_t panel) {
+  return (size + panel - 1) / panel * panel;
+}
+
+static GemmKernelOperand MatrixOperand(bool transpose, const float *data, uint32_t ld) {
+  GemmKernelOperand operand;
+  operand.data = data;
+  operand.ld = ld;
+  operand.transpose = transpose;
+  return operand;
+}
+
+static GemmKernelOperand PackedOperand(const GemmPackedMatrix &packed, uint32_t offset) {
+  GemmKernelOperand operand;
+  operand.packed = packed.packed_data();
+  operand.packed_size = PaddedSize(packed.left ? packed.rows : packed.cols, packed.panel);
+  operand.offset = offset;
+  return operand;
+}
+
+/**
+ * 内置的分块矩阵乘法，打包用的内存每个线程一份，已经打包的操作数直接读取
+ */
+static void BuiltinGemm(const CpuKernels &kernels, const GemmKernelOperand &a, const GemmKernelOperand &b,
+                        uint32_t m, uint32_t n, uint32_t k, float alpha, float beta, float *c, uint32_t ldc,
+                        const GemmEpilogue &epilogue) {
+  thread_local std::vector<float> workspace;
+  const size_t workspace_size = kernels.gemm_workspace_size(m, n, k);
+  if (workspace.size() < workspace_size) {
+    workspace.resize(workspace_size);
+  }
+  kernels.gemm(a, b, m, n, k, alpha, beta, c, ldc, epilogue, workspace.data());
+}
+
+static GemmPackedMatrix PackMatrix(bool left, bool transpose, uint32_t rows, uint32_t cols, const float *matrix,
+                                   uint32_t ld) {
+  const CpuKernels &kernels = CurrentCpuKernels();
+  GemmPackedMatrix packed;
+  packed.left = left;
+  packed.rows = rows;
+  packed.cols = cols;
+  packed.panel = left ? kernels.gemm_panel_rows() : kernels.gemm_panel_cols();
+  packed.isa = kernels.isa;
+  const uint32_t size = left ? rows : cols;
+  const uint32_t depth = left ? cols : rows;
+  packed.data.resize(size_t(PaddedSize(size, packed.panel)) * depth);
+  kernels.gemm_pack(left, transpose, size, depth, matrix, ld, packed.data.data());
+  return packed;
+}
+
+GemmPackedMatrix GemmPackA(bool transpose, uint32_t m, uint32_t k, const float *a, uint32_t lda) {
+  CHECK(m > 0 && k > 0 && a != nullptr) << "The matrix to pack is empty";
+  return PackMatrix(true, transpose, m, k, a, lda);
+}
+
+GemmPackedMatrix GemmPackB(bool transpose, uint32_t k, uint32_t n, const float *b, uint32_t ldb) {
+  CHECK(k > 0 && n > 0 && b != nullptr) << "The matrix to pack is empty";
+  return PackMatrix(false, transpose, k, n, b, ldb);
+}
+
+void GemmPackedA(const GemmPackedMatrix &a, uint32_t row_begin, uint32_t m, bool transpose_b, uint32_t n,
+                 const float *b, uint32_t ldb, float *c, uint32_t ldc, const GemmEpilogue &epilogue) {
+  CHECK(a.left && !a.empty()) << "The left matrix is not packed";
+  CHECK(row_begin % a.panel == 0 && row_begin + m <= a.rows);
+  if (m == 0 || n == 0) {
+    return;
+  }
+  CHECK(b != nullptr && c != nullptr && ldc >= m);
+  // 面板的格式由打包时的级别决定，按照同一个级别计算
+  BuiltinGemm(CpuKernelsOf(a.isa), PackedOperand(a, row_begin), MatrixOperand(transpose_b, b, ldb), m, n, a.cols,
+              1.f, 0.f, c, ldc, epilogue);
+}
+
+void GemmPackedB(bool transpose_a, uint32_t m, const float *a, uint32_t lda, const GemmPackedMatrix &b,
+                 uint32_t col_begin, uint32_t n, float *c, uint32_t ldc, const GemmEpilogue &epilogue) {
+  CHECK(!b.left && !b.empty()) << "The right matrix is not packed";
+  CHECK(col_begin % b.panel == 0 && col_begin + n <= b.cols);
+  if (m == 0 || n == 0) {
+    return;
+  }
+  CHECK(a != nullptr && c != nullptr && ldc >= m);
+  BuiltinGemm(CpuKernelsOf(b.isa), MatrixOperand(transpose_a, a, lda), PackedOperand(b, col_begin), m, n, b.rows,
+              1.f, 0.f, c, ldc, epilogue);
+}
+
+GemmBackend CompiledGemmBackend() {
+#if defined(KUIPER_GEMM_BACKEND_BUILTIN)
+  return GemmBackend::kBuiltin;
+#elif defined(KUIPER_GEMM_BACKEND_OPENBLAS)
+  return GemmBackend::kOpenBLAS;
+#elif defined(KUIPER_GEMM_BACKEND_MKL)
+  return GemmBackend::kMKL;
+#elif defined(KUIPER_GEMM_BACKEND_BLIS)
+  return GemmBackend::kBLIS;
+#else
+  return GemmBackend::kBlas;
+#endif
+}
+
+static std::atomic<GemmBackend> current_backend(CompiledGemmBackend());
+static std::atomic<bool> gemm_thread_num_set(false);
+
+bool SetGemmBackend(GemmBackend backend) {
+  if (backend != GemmBackend::kBuiltin && backend != CompiledGemmBackend()) {
+    LOG(ERROR) << "The gemm backend " << GemmBackendName(backend) << " is not compiled, the compiled backend is "
+               << GemmBackendName(CompiledGemmBackend());
+    return false;
+  }
+  current_backend = backend;
+  return true;
+}
+
+GemmBackend CurrentGemmBackend() {
+  return current_backend;
+}
+
+const char *GemmBackendName(GemmBackend backend) {
+  switch (backend) {
+    case GemmBackend::kBlas: return "BLAS";
+    case GemmBackend::kOpenBLAS: return "OpenBLAS";
+    case GemmBackend::kMKL: return "MKL";
+    case GemmBackend::kBLIS: return "BLIS";
+    case GemmBackend::kBuiltin: return "Builtin";
+  }
+  return "Unknown";
+}
+
+bool SetGemmThreadNum(uint32_t thread_num) {
+  CHECK(thread_num >= 1) << "The gemm thread number must be at least 1";
+  gemm_thread_num_set = true;
+#if defined(KUIPER_GEMM_BACKEND_OPENBLAS)
+  openblas_set_num_threads(int(thread_num));
+  return true;
+#elif defined(KUIPER_GEMM_BACKEND_MKL)
+  MKL_Set_Num_Threads(int(thread_num));
+  return true;
+#elif defined(KUIPER_GEMM_BACKEND_BLIS)
+  bli_thread_set_num_threads(int64_t(thread_num));
+  return true;
+#elif defined(KUIPER_GEMM_BACKEND_BUILTIN)
+  return thread_num == 1;
+#else
+  LOG(WARNING) << "The generic blas can not set the thread number, set it by the environment variable instead";
+  return false;
+#endif
+}
+
+uint32_t GemmThreadNum() {
+#if defined(KUIPER_GEMM_BACKEND_OPENBLAS)
+  return uint32_t(openblas_get_num_threads());
+#elif defined(KUIPER_GEMM_BACKEND_MKL)
+  return uint32_t(MKL_Get_Max_Threads());
+#elif defined(KUIPER_GEMM_BACKEND_BLIS)
+  return uint32_t(bli_thread_get_num_threads());
+#elif defined(KUIPER_GEMM_BACKEND_BUILTIN)
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void Gemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, float alpha, const float *a,
+          uint32_t lda, const float *b, uint32_t ldb, float beta, float *c, uint32_t ldc,
+          const GemmEpilogue &epilogue) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  CHECK(c != nullptr && ldc >= m);
+  CHECK(k == 0 || (a != nullptr && b != nullptr));
+  if (current_backend == GemmBackend::kBuiltin) {
+    BuiltinGemm(CurrentCpuKernels(), MatrixOperand(transpose_a, a, lda), MatrixOperand(transpose_b, b, ldb), m, n, k,
+                alpha, beta, c, ldc, epilogue);
+    return;
+  }
+#if !defined(KUIPER_GEMM_BACKEND_BUILTIN)
+  // BLAS默认的线程数和线程池叠加会超出核数，没有显式设置时只使用1个线程
+  static std::once_flag default_thread_flag;
+  std::call_once(default_thread_flag, []() {
+    if (!gemm_thread_num_set && CompiledGemmBackend() != GemmBackend::kBlas) {
+      SetGemmThreadNum(1);
+    }
+  });
+  const char trans_a = transpose_a ? 'T' : 'N';
+  const char trans_b = transpose_b ? 'T' : 'N';
+  const int m_ = int(m), n_ = int(n), k_ = int(k);
+  const int lda_ = int(std::max(1u, lda)), ldb_ = int(std::max(1u, ldb)), ldc_ = int(ldc);
+  sgemm_(&trans_a, &trans_b, &m_, &n_, &k_, &alpha, a, &lda_, b, &ldb_, &beta, c, &ldc_);
+  CurrentCpuKernels().gemm_epilogue(epilogue, m, n, c, ldc);
+#endif
+}
+}
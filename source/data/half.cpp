@@ -0,0 +1,81 @@
+#include "data/half.hpp"
+#include <cmath>
+#include <cstring>
+#include "../kernels/cpu_kernels.hpp"
+
+namespace kuiper_infer {
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1fu;
+  const uint32_t mantissa = value & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent == 0) {
+    // 非规格化数的值是mantissa * 2^-24
+    const float subnormal = float(mantissa) * 5.9604644775390625e-8f;
+    memcpy(&bits, &subnormal, sizeof(bits));
+    bits |= sign;
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = uint16_t((bits >> 16) & 0x8000u);
+  uint32_t abs_bits = bits & 0x7fffffffu;
+  if (abs_bits >= 0x7f800000u) {
+    return sign | 0x7c00u | (abs_bits > 0x7f800000u ? 0x200u : 0u);
+  }
+  // 大于等于65520时舍入之后超过半精度的最大值65504
+  if (abs_bits >= 0x477ff000u) {
+    return sign | 0x7c00u;
+  }
+  // 小于2^-14时结果是非规格化数，以2^-24为单位舍入
+  if (abs_bits < 0x38800000u) {
+    return sign | uint16_t(std::nearbyint(std::abs(value) * 16777216.f));
+  }
+  // 指数减去两种格式偏置的差112，低13位按照最近偶数舍入
+  abs_bits += 0xc8000fffu + ((abs_bits >> 13) & 1u);
+  return sign | uint16_t(abs_bits >> 13);
+}
+
+float BFloat16ToFloat(uint16_t value) {
+  const uint32_t bits = uint32_t(value) << 16;
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint16_t FloatToBFloat16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffffu) > 0x7f800000u) {
+    return uint16_t((bits >> 16) | 0x40u);
+  }
+  bits += 0x7fffu + ((bits >> 16) & 1u);
+  return uint16_t(bits >> 16);
+}
+
+void HalfToFloat(const uint16_t *input, uint32_t size, float *output) {
+  CurrentCpuKernels().half_to_float(input, size, output);
+}
+
+void FloatToHalf(const float *input, uint32_t size, uint16_t *output) {
+  CurrentCpuKernels().float_to_half(input, size, output);
+}
+
+void BFloat16ToFloat(const uint16_t *input, uint32_t size, float *output) {
+  CurrentCpuKernels().bfloat16_to_float(input, size, output);
+}
+
+void FloatToBFloat16(const float *input, uint32_t size, uint16_t *output) {
+  CurrentCpuKernels().float_to_bfloat16(input, size, output);
+}
+}
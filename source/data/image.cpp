@@ -0,0 +1,268 @@
+#include "data/image.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <glog/logging.h>
+#include "runtime/thread_pool.hpp"
+#include "../kernels/cpu_kernels.hpp"
+#ifdef USE_CUDA
+#include "../backend/cuda/cuda_kernels.hpp"
+#endif
+
+namespace kuiper_infer {
+/// 每个任务处理的输出行数，一个任务的中间结果留在缓存中，再按列写入输出
+static constexpr uint32_t kImageBandRows = 16;
+
+/// 一个方向上的双线性插值表
+struct ResizeTable {
+  std::vector<uint32_t> offsets0; /// 左侧或者上方像素的偏移量
+  std::vector<uint32_t> offsets1; /// 右侧或者下方像素的偏移量
+  std::vector<float> weights; /// 右侧或者下方像素的权重
+};
+
+/// 一张图片预处理时的几何关系
+struct ImageLayout {
+  LetterboxInfo info;
+  uint32_t resized_width = 0; /// 缩放后的宽度
+  uint32_t resized_height = 0; /// 缩放后的高度
+  size_t step = 0; /// 原图相邻两行之间的字节数
+  ResizeTable x_table; /// 水平方向的插值表，偏移量以字节为单位
+  ResizeTable y_table; /// 垂直方向的插值表，偏移量以行为单位
+};
+
+/**
+ * 生成像素中心对齐的插值表，dst_index对应原图中(dst_index + 0.5) * src_size / dst_size - 0.5的位置
+ * @param src_size 原图的大小
+ * @param dst_size 缩放后的大小
+ * @param stride 相邻两个位置的偏移量之差
+ * @param table 插值表
+ */
+static void MakeResizeTable(uint32_t src_size, uint32_t dst_size, uint32_t stride, ResizeTable &table) {
+  table.offsets0.resize(dst_size);
+  table.offsets1.resize(dst_size);
+  table.weights.resize(dst_size);
+  const float scale = float(src_size) / float(dst_size);
+  for (uint32_t i = 0; i < dst_size; ++i) {
+    const float position = std::max((float(i) + 0.5f) * scale - 0.5f, 0.f);
+    uint32_t index0 = uint32_t(position);
+    uint32_t index1 = index0 + 1;
+    float weight = position - float(index0);
+    if (index0 >= src_size - 1) {
+      index0 = src_size - 1;
+      index1 = index0;
+      weight = 0.f;
+    }
+    table.offsets0.at(i) = index0 * stride;
+    table.offsets1.at(i) = index1 * stride;
+    table.weights.at(i) = weight;
+  }
+}
+
+static ImageLayout MakeImageLayout(const ImageView &image, const ImagePreprocessParam &param) {
+  CHECK(image.data != nullptr && image.height > 0 && image.width > 0) << "The image to preprocess is empty";
+  CHECK(image.channels >= 3) << "The image to preprocess must have at least three channels";
+  ImageLayout layout;
+  layout.step = image.step != 0 ? image.step : size_t(image.width) * image.channels;
+  CHECK(layout.step >= size_t(image.width) * image.channels) << "The row step of image is too small";
+
+  if (param.letterbox) {
+    float ratio = std::min(float(param.target_height) / float(image.height),
+                           float(param.target_width) / float(image.width));
+    if (!param.scale_up) {
+      ratio = std::min(ratio, 1.f);
+    }
+    layout.resized_width = std::max(1u, std::min(param.target_width, uint32_t(std::round(image.width * ratio))));
+    layout.resized_height = std::max(1u, std::min(param.target_height, uint32_t(std::round(image.height * ratio))));
+    // 和yolov5的letterbox一致，两侧填充的数量不相等时多出的一列或者一行在右侧和下方
+    layout.info.pad_left = uint32_t(std::round(float(param.target_width - layout.resized_width) / 2.f - 0.1f));
+    layout.info.pad_top = uint32_t(std::round(float(param.target_height - layout.resized_height) / 2.f - 0.1f));
+  } else {
+    layout.resized_width = param.target_width;
+    layout.resized_height = param.target_height;
+  }
+  layout.info.scale_x = float(layout.resized_width) / float(image.width);
+  layout.info.scale_y = float(layout.resized_height) / float(image.height);
+  MakeResizeTable(image.width, layout.resized_width, image.channels, layout.x_table);
+  MakeResizeTable(image.height, layout.resized_height, 1, layout.y_table);
+  return layout;
+}
+
+/**
+ * 预处理一张图片中的一段输出行，先按行计算到band中，再按列写入输出
+ * @param image 输入图片
+ * @param layout 图片的几何关系
+ * @param param 预处理参数
+ * @param row_begin 第一行输出
+ * @param row_end 最后一行输出的下一行
+ * @param output 这张图片输出的起始地址
+ */
+static void PreprocessBand(const ImageView &image, const ImageLayout &layout, const ImagePreprocessParam &param,
+                           uint32_t row_begin, uint32_t row_end, float *output) {
+  const CpuKernels &kernels = CurrentCpuKernels();
+  const uint32_t target_height = param.target_height;
+  const uint32_t target_width = param.target_width;
+  const uint32_t resized_width = layout.resized_width;
+  const uint32_t pad_left = layout.info.pad_left;
+  const uint32_t pad_top = layout.info.pad_top;
+  const uint32_t band_rows = row_end - row_begin;
+  const uint32_t row_size = image.width * image.channels;
+
+  // band中每个通道按行存放band_rows行，水平插值后的原图行缓存最近使用的两行
+  std::vector<float> band(3 * band_rows * target_width);
+  std::vector<float> resized_rows(2 * 3 * resized_width);
+  int64_t cached_rows[2] = {-1, -1};
+  uint32_t next_slot = 0;
+  auto resized_row = [&](uint32_t src_row) {
+    for (uint32_t slot = 0; slot < 2; ++slot) {
+      if (cached_rows[slot] == src_row) {
+        return resized_rows.data() + slot * 3 * resized_width;
+      }
+    }
+    const uint32_t slot = next_slot;
+    next_slot = 1 - next_slot;
+    cached_rows[slot] = src_row;
+    float *resized = resized_rows.data() + slot * 3 * resized_width;
+    const uint8_t *row = image.data + src_row * layout.step;
+    for (uint32_t c = 0; c < 3; ++c) {
+      const uint32_t src_channel = param.swap_rb ? 2 - c : c;
+      kernels.image_resize_row(row + src_channel, row_size - src_channel, layout.x_table.offsets0.data(),
+                               layout.x_table.offsets1.data(), layout.x_table.weights.data(), resized_width,
+                               resized + c * resized_width);
+    }
+    return resized;
+  };
+
+  for (uint32_t r = 0; r < band_rows; ++r) {
+    const uint32_t y = row_begin + r;
+    const bool padded_row = y < pad_top || y >= pad_top + layout.resized_height;
+    for (uint32_t c = 0; c < 3; ++c) {
+      float *band_row = band.data() + (c * band_rows + r) * target_width;
+      const float pad = float(param.pad_value) * param.scale[c] + param.shift[c];
+      if (padded_row) {
+        std::fill(band_row, band_row + target_width, pad);
+      } else {
+        std::fill(band_row, band_row + pad_left, pad);
+        std::fill(band_row + pad_left + resized_width, band_row + target_width, pad);
+      }
+    }
+    if (padded_row) {
+      continue;
+    }
+    // 垂直插值和归一化合并为一次乘加: (row0 * (1 - w) + row1 * w) * scale + shift
+    const uint32_t resized_y = y - pad_top;
+    const float weight = layout.y_table.weights.at(resized_y);
+    const float *row0 = resized_row(layout.y_table.offsets0.at(resized_y));
+    const float *row1 = resized_row(layout.y_table.offsets1.at(resized_y));
+    for (uint32_t c = 0; c < 3; ++c) {
+      float *band_row = band.data() + (c * band_rows + r) * target_width;
+      kernels.linear_combine(row0 + c * resized_width, (1.f - weight) * param.scale[c], row1 + c * resized_width,
+                             weight * param.scale[c], param.shift[c], resized_width, band_row + pad_left);
+    }
+  }
+
+  // 张量的每个通道按列存放，band中同一列的band_rows个值在输出中连续
+  const size_t plane_size = size_t(target_height) * target_width;
+  for (uint32_t c = 0; c < 3; ++c) {
+    const float *band_plane = band.data() + c * band_rows * target_width;
+    float *plane = output + c * plane_size;
+    for (uint32_t x = 0; x < target_width; ++x) {
+      float *column = plane + size_t(x) * target_height + row_begin;
+      for (uint32_t r = 0; r < band_rows; ++r) {
+        column[r] = band_plane[r * target_width + x];
+      }
+    }
+  }
+}
+
+LetterboxInfo PreprocessImage(const ImageView &image, const ImagePreprocessParam &param, float *output) {
+  const std::vector<LetterboxInfo> &infos = PreprocessImages({image}, param, output);
+  return infos.front();
+}
+
+std::vector<LetterboxInfo> PreprocessImages(const std::vector<ImageView> &images, const ImagePreprocessParam &param,
+                                            float *output) {
+  CHECK(output != nullptr) << "The output of image preprocess is empty";
+  CHECK(param.target_height > 0 && param.target_width > 0) << "The target size of image preprocess is empty";
+  std::vector<ImageLayout> layouts;
+  std::vector<LetterboxInfo> infos;
+  for (const ImageView &image : images) {
+    layouts.push_back(MakeImageLayout(image, param));
+    infos.push_back(layouts.back().info);
+  }
+
+  // 每个任务是一张图片中连续的一段输出行
+  const uint32_t band_num = (param.target_height + kImageBandRows - 1) / kImageBandRows;
+  const size_t image_size = size_t(3) * param.target_height * param.target_width;
+  ThreadPool::Current().ParallelFor(0, uint32_t(images.size()) * band_num, [&](uint32_t task) {
+    const uint32_t index = task / band_num;
+    const uint32_t row_begin = task % band_num * kImageBandRows;
+    const uint32_t row_end = std::min(row_begin + kImageBandRows, param.target_height);
+    PreprocessBand(images.at(index), layouts.at(index), param, row_begin, row_end, output + index * image_size);
+  });
+  return infos;
+}
+
+std::vector<LetterboxInfo> PreprocessImagesCuda(const std::vector<ImageView> &images,
+                                                const ImagePreprocessParam &param,
+                                                const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  CHECK(images.size() == outputs.size()) << "The number of images and output tensors is different";
+  CHECK(param.target_height > 0 && param.target_width > 0) << "The target size of image preprocess is empty";
+#ifdef USE_CUDA
+  std::vector<ImageLayout> layouts;
+  std::vector<LetterboxInfo> infos;
+  std::vector<size_t> image_offsets;
+  size_t total_bytes = 0;
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    const ImageView &image = images.at(i);
+    const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    CHECK(output != nullptr && output->channels() == 3 && output->rows() == param.target_height
+              && output->cols() == param.target_width) << "The shape of output tensor is different from the target";
+    layouts.push_back(MakeImageLayout(image, param));
+    infos.push_back(layouts.back().info);
+    image_offsets.push_back(total_bytes);
+    // 最后一行只上传有效的像素，不读取原图末尾之外的内存
+    total_bytes += (image.height - 1) * layouts.back().step + size_t(image.width) * image.channels;
+  }
+
+  // 原图暂存在每个线程自己的设备内存中，不同的流各用一块内存
+  thread_local std::map<void *, DeviceBuffer> image_buffers;
+  DeviceBuffer &image_buffer = image_buffers[DeviceStream::Current()];
+  image_buffer.Reserve((total_bytes + sizeof(float) - 1) / sizeof(float));
+  uint8_t *device_images = reinterpret_cast<uint8_t *>(image_buffer.data());
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    const size_t image_bytes = (i + 1 < images.size() ? image_offsets.at(i + 1) : total_bytes) - image_offsets.at(i);
+    CopyBytesHostToDevice(images.at(i).data, device_images + image_offsets.at(i), image_bytes);
+  }
+
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    const ImageView &image = images.at(i);
+    const ImageLayout &layout = layouts.at(i);
+    cuda::ImagePreprocessArgs args;
+    args.height = image.height;
+    args.width = image.width;
+    args.channels = image.channels;
+    args.step = uint32_t(layout.step);
+    args.resized_h = layout.resized_height;
+    args.resized_w = layout.resized_width;
+    args.pad_top = layout.info.pad_top;
+    args.pad_left = layout.info.pad_left;
+    args.target_h = param.target_height;
+    args.target_w = param.target_width;
+    args.swap_rb = param.swap_rb;
+    args.pad_value = float(param.pad_value);
+    for (uint32_t c = 0; c < 3; ++c) {
+      args.scale[c] = param.scale[c];
+      args.shift[c] = param.shift[c];
+    }
+    const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    cuda::PreprocessImage(device_images + image_offsets.at(i), args, output->cuda_data());
+    output->set_device(DeviceType::kDeviceCUDA);
+  }
+  DeviceStream::SynchronizeCurrent();
+  return infos;
+#else
+  LOG(FATAL) << "The library is built without the cuda backend";
+  return {};
+#endif
+}
+}
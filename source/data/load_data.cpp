@@ -3,91 +3,298 @@
 //
 #include "data/load_data.hpp"
 #include <string>
-#include <fstream>
-#include <armadillo>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
 #include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <glog/logging.h>
+#include "runtime/thread_pool.hpp"
 
 namespace kuiper_infer {
+// 并行解析csv时每个任务处理的行数
+static constexpr size_t kCSVRowBlock = 256;
 
-arma::fmat CSVDataLoader::LoadData(const std::string &file_path, const char split_char) {
-  CHECK(!file_path.empty()) << "File path is empty!";
-  std::ifstream in(file_path);
-  CHECK(in.is_open() && in.good()) << "File open failed! " << file_path;
+/// 只读映射到内存中的整个文件，析构时解除映射
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &file_path) {
+    const int fd = open(file_path.c_str(), O_RDONLY);
+    CHECK(fd >= 0) << "File open failed! " << file_path;
+    struct stat st{};
+    CHECK(fstat(fd, &st) == 0) << "File open failed! " << file_path;
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      CHECK(addr != MAP_FAILED) << "File map failed! " << file_path;
+      data_ = static_cast<const char *>(addr);
+    }
+    close(fd);
+  }
 
-  arma::fmat data;
-  std::string line_str;
-  std::stringstream line_stream;
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  MappedFile(const MappedFile &) = delete;
+
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
 
-  const auto &[rows, cols] = CSVDataLoader::GetMatrixSize(in, split_char);
-  data.zeros(rows, cols);
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
 
-  size_t row = 0;
-  while (in.good()) {
-    std::getline(in, line_str);
-    if (line_str.empty()) {
+/**
+ * 解析csv文件，allocate根据行数和列数返回一块填充了0、按列存储的内存，解析结果直接写入其中
+ */
+template<typename Allocate>
+static void ParseCSV(const std::string &file_path, char split_char, Allocate allocate) {
+  CHECK(!file_path.empty()) << "File path is empty!";
+  const MappedFile file(file_path);
+
+  // 先找出每一行的范围，遇到空行结束
+  std::vector<std::pair<const char *, const char *>> lines;
+  const char *p = file.data();
+  const char *end = file.data() + file.size();
+  while (p < end) {
+    const char *line_end = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+    if (line_end == p) {
       break;
     }
+    lines.emplace_back(p, line_end);
+    p = line_end + 1;
+  }
 
-    std::string token;
-    line_stream.clear();
-    line_stream.str(line_str);
+  // 列数是所有行中分隔符数量的最大值加1
+  const size_t rows = lines.size();
+  const size_t block_num = (rows + kCSVRowBlock - 1) / kCSVRowBlock;
+  std::vector<size_t> block_cols(block_num, 0);
+  ThreadPool::Current().ParallelFor(0, uint32_t(block_num), [&](uint32_t block) {
+    size_t max_cols = 0;
+    for (size_t row = block * kCSVRowBlock; row < std::min(rows, (block + 1) * kCSVRowBlock); ++row) {
+      const auto &[line_begin, line_end] = lines.at(row);
+      const size_t line_cols = std::count(line_begin, line_end, split_char) + 1;
+      max_cols = std::max(max_cols, line_cols);
+    }
+    block_cols.at(block) = max_cols;
+  });
+  size_t cols = 0;
+  for (const size_t block_col : block_cols) {
+    cols = std::max(cols, block_col);
+  }
 
-    size_t col = 0;
-    while (line_stream.good()) {
-      std::getline(line_stream, token, split_char);
-      try {
-        data.at(row, col) = std::stof(token);
-      }
-      catch (std::exception &e) {
-        LOG(ERROR) << "Parse CSV File meet error: " << e.what();
-        continue;
+  float *data = allocate(rows, cols);
+  ThreadPool::Current().ParallelFor(0, uint32_t(block_num), [&](uint32_t block) {
+    for (size_t row = block * kCSVRowBlock; row < std::min(rows, (block + 1) * kCSVRowBlock); ++row) {
+      const char *token = lines.at(row).first;
+      const char *line_end = lines.at(row).second;
+      size_t col = 0;
+      while (token <= line_end) {
+        const char *token_end = std::find(token, line_end, split_char);
+        const char *number = token;
+        while (number < token_end && (*number == ' ' || *number == '\t' || *number == '+')) {
+          number += 1;
+        }
+        float value = 0.f;
+        const auto result = std::from_chars(number, token_end, value);
+        if (result.ec != std::errc() || number == token_end) {
+          LOG(ERROR) << "Parse CSV File meet error: " << std::string(token, token_end);
+        } else {
+          CHECK(col < cols) << "There are excessive elements on the column";
+          data[col * rows + row] = value;
+          col += 1;
+        }
+        token = token_end + 1;
       }
-      col += 1;
-      CHECK(col <= cols) << "There are excessive elements on the column";
     }
+  });
+}
 
-    row += 1;
-    CHECK(row <= rows) << "There are excessive elements on the row";
-  }
+arma::fmat CSVDataLoader::LoadData(const std::string &file_path, const char split_char) {
+  arma::fmat data;
+  ParseCSV(file_path, split_char, [&](size_t rows, size_t cols) {
+    data.zeros(rows, cols);
+    return data.memptr();
+  });
   return data;
 }
 
+std::shared_ptr<Tensor<float>> CSVDataLoader::LoadTensor(const std::string &file_path, char split_char) {
+  std::shared_ptr<Tensor<float>> tensor;
+  ParseCSV(file_path, split_char, [&](size_t rows, size_t cols) {
+    tensor = std::make_shared<Tensor<float>>(1, rows, cols);
+    tensor->Fill(0.f);
+    return tensor->data().memptr();
+  });
+  return tensor;
+}
 
-std::pair<size_t, size_t> CSVDataLoader::GetMatrixSize(std::ifstream &file, char split_char) {
-  bool load_ok = file.good();
-  file.clear();
-  size_t fn_rows = 0;
-  size_t fn_cols = 0;
-  const std::ifstream::pos_type start_pos = file.tellg();
+std::shared_ptr<Tensor<float>> BinaryDataLoader::LoadNpy(const std::string &file_path) {
+  CHECK(!file_path.empty()) << "File path is empty!";
+  const MappedFile file(file_path);
+  const char *data = file.data();
+  CHECK(file.size() >= 10 && memcmp(data, "\x93NUMPY", 6) == 0) << "Not a npy file: " << file_path;
 
-  std::string token;
-  std::string line_str;
-  std::stringstream line_stream;
+  // 1.0版本的文件头长度是2字节，2.0和3.0版本是4字节
+  const uint8_t major_version = data[6];
+  size_t header_len = 0;
+  size_t header_begin = 0;
+  if (major_version == 1) {
+    header_len = uint8_t(data[8]) | (size_t(uint8_t(data[9])) << 8);
+    header_begin = 10;
+  } else {
+    CHECK(file.size() >= 12) << "Not a npy file: " << file_path;
+    for (int i = 3; i >= 0; --i) {
+      header_len = (header_len << 8) | uint8_t(data[8 + i]);
+    }
+    header_begin = 12;
+  }
+  CHECK(header_begin + header_len <= file.size()) << "The npy header is broken: " << file_path;
+  const std::string header(data + header_begin, header_len);
+
+  const size_t descr_pos = header.find("'descr'");
+  CHECK(descr_pos != std::string::npos) << "The npy header is broken: " << file_path;
+  const size_t descr_begin = header.find('\'', header.find(':', descr_pos)) + 1;
+  const std::string descr = header.substr(descr_begin, header.find('\'', descr_begin) - descr_begin);
+  CHECK(descr == "<f4") << "Only little endian float32 npy file is supported, but got " << descr;
+
+  const size_t fortran_pos = header.find("'fortran_order'");
+  CHECK(fortran_pos != std::string::npos) << "The npy header is broken: " << file_path;
+  const bool fortran_order = header.compare(header.find(':', fortran_pos) + 1, 5, " True") == 0;
 
-  while (file.good() && load_ok) {
-    std::getline(file, line_str);
-    if (line_str.empty()) {
+  const size_t shape_pos = header.find("'shape'");
+  CHECK(shape_pos != std::string::npos) << "The npy header is broken: " << file_path;
+  const size_t shape_begin = header.find('(', shape_pos) + 1;
+  const size_t shape_end = header.find(')', shape_begin);
+  std::vector<uint32_t> shapes;
+  const char *p = header.data() + shape_begin;
+  const char *shape_last = header.data() + shape_end;
+  while (p < shape_last) {
+    while (p < shape_last && (*p == ' ' || *p == ',')) {
+      p += 1;
+    }
+    if (p == shape_last) {
       break;
     }
+    uint32_t dim = 0;
+    p = std::from_chars(p, shape_last, dim).ptr;
+    shapes.push_back(dim);
+  }
+  while (shapes.size() > 3) {
+    CHECK(shapes.front() == 1) << "Only the leading dims of a npy file with more than 3 dims can be 1";
+    shapes.erase(shapes.begin());
+  }
+  while (shapes.size() < 3) {
+    shapes.insert(shapes.begin(), 1);
+  }
+  const uint32_t channels = shapes.at(0);
+  const uint32_t rows = shapes.at(1);
+  const uint32_t cols = shapes.at(2);
+  CHECK(!fortran_order || channels == 1) << "Only npy files with at most 2 dims can be in fortran order";
+
+  const size_t size = size_t(channels) * rows * cols;
+  const size_t data_begin = header_begin + header_len;
+  CHECK(data_begin + size * sizeof(float) <= file.size()) << "The npy file is truncated: " << file_path;
 
-    line_stream.clear();
-    line_stream.str(line_str);
-    size_t line_cols = 0;
+  std::shared_ptr<Tensor<float>> tensor = std::make_shared<Tensor<float>>(channels, rows, cols);
+  if (size == 0) {
+    return tensor;
+  }
+  if (fortran_order || rows == 1 || cols == 1) {
+    // 数据的排列和张量的内存相同
+    memcpy(tensor->data().memptr(), data + data_begin, size * sizeof(float));
+  } else {
+    // npy按照行优先排列，文件头保证数据起始于4字节对齐的位置
+    tensor->Fill(reinterpret_cast<const float *>(data + data_begin), size);
+  }
+  return tensor;
+}
 
-    std::string row_token;
-    while (line_stream.good()) {
-      std::getline(line_stream, row_token, split_char);
-      ++line_cols;
+bool BinaryDataLoader::SaveNpy(const std::string &file_path, const Tensor<float> &tensor) {
+  std::string shape_str = "(";
+  const std::vector<uint32_t> &raw_shapes = tensor.raw_shapes();
+  for (size_t i = 0; i < raw_shapes.size(); ++i) {
+    shape_str += std::to_string(raw_shapes.at(i));
+    if (i + 1 < raw_shapes.size() || raw_shapes.size() == 1) {
+      shape_str += ",";
     }
-    if (line_cols > fn_cols) {
-      fn_cols = line_cols;
+    if (i + 1 < raw_shapes.size()) {
+      shape_str += " ";
     }
+  }
+  shape_str += ")";
 
-    ++fn_rows;
+  // 文件头用空格补齐，使数据起始于64字节对齐的位置
+  std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': " + shape_str + ", }";
+  const size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header.push_back('\n');
+
+  FILE *fp = fopen(file_path.c_str(), "wb");
+  if (fp == nullptr) {
+    LOG(ERROR) << "File open failed! " << file_path;
+    return false;
+  }
+  const char magic[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+  const uint8_t header_len[2] = {uint8_t(header.size() & 0xff), uint8_t(header.size() >> 8)};
+  bool success = fwrite(magic, 1, 8, fp) == 8 && fwrite(header_len, 1, 2, fp) == 2 &&
+      fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+  // 每个通道转置之后就是行优先的排列
+  for (uint32_t c = 0; c < tensor.channels() && success; ++c) {
+    const arma::fmat channel_t = tensor.at(c).t();
+    success = fwrite(channel_t.memptr(), sizeof(float), channel_t.n_elem, fp) == channel_t.n_elem;
+  }
+  if (fclose(fp) != 0 || !success) {
+    LOG(ERROR) << "File write failed! " << file_path;
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<Tensor<float>> BinaryDataLoader::LoadRaw(const std::string &file_path, uint32_t channels,
+                                                         uint32_t rows, uint32_t cols) {
+  CHECK(!file_path.empty()) << "File path is empty!";
+  FILE *fp = fopen(file_path.c_str(), "rb");
+  CHECK(fp != nullptr) << "File open failed! " << file_path;
+  std::shared_ptr<Tensor<float>> tensor = std::make_shared<Tensor<float>>(channels, rows, cols);
+  const size_t size = tensor->size();
+  const size_t read_size = fread(tensor->data().memptr(), sizeof(float), size, fp);
+  fclose(fp);
+  CHECK(read_size == size) << "The raw file is smaller than the tensor: " << file_path;
+  return tensor;
+}
+
+bool BinaryDataLoader::SaveRaw(const std::string &file_path, const Tensor<float> &tensor) {
+  FILE *fp = fopen(file_path.c_str(), "wb");
+  if (fp == nullptr) {
+    LOG(ERROR) << "File open failed! " << file_path;
+    return false;
+  }
+  const size_t size = tensor.size();
+  const bool success = fwrite(tensor.data().memptr(), sizeof(float), size, fp) == size;
+  if (fclose(fp) != 0 || !success) {
+    LOG(ERROR) << "File write failed! " << file_path;
+    return false;
   }
-  file.clear();
-  file.seekg(start_pos);
-  return {fn_rows, fn_cols};
+  return true;
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "data/memory_tracker.hpp"
+
+namespace kuiper_infer {
+
+MemoryTracker &MemoryTracker::GetInstance() {
+  static MemoryTracker memory_tracker;
+  return memory_tracker;
+}
+
+void MemoryTracker::Allocate(size_t bytes) {
+  const size_t current_bytes = current_bytes_.fetch_add(bytes) + bytes;
+  size_t peak_bytes = peak_bytes_.load();
+  while (current_bytes > peak_bytes && !peak_bytes_.compare_exchange_weak(peak_bytes, current_bytes)) {
+  }
+}
+
+void MemoryTracker::Release(size_t bytes) {
+  current_bytes_.fetch_sub(bytes);
+}
+
+size_t MemoryTracker::current_bytes() const {
+  return current_bytes_.load();
+}
+
+size_t MemoryTracker::peak_bytes() const {
+  return peak_bytes_.load();
+}
+
+void MemoryTracker::ResetPeak() {
+  peak_bytes_.store(current_bytes_.load());
+}
+
+TrackedAllocation::TrackedAllocation(const TrackedAllocation &allocation) {
+  Reset(allocation.bytes_);
+}
+
+TrackedAllocation &TrackedAllocation::operator=(const TrackedAllocation &allocation) {
+  if (this != &allocation) {
+    Reset(allocation.bytes_);
+  }
+  return *this;
+}
+
+TrackedAllocation::~TrackedAllocation() {
+  Reset(0);
+}
+
+void TrackedAllocation::Reset(size_t bytes) {
+  if (bytes == bytes_) {
+    return;
+  }
+  MemoryTracker &memory_tracker = MemoryTracker::GetInstance();
+  if (bytes > bytes_) {
+    memory_tracker.Allocate(bytes - bytes_);
+  } else {
+    memory_tracker.Release(bytes_ - bytes);
+  }
+  bytes_ = bytes;
+}
+
+size_t TrackedAllocation::bytes() const {
+  return bytes_;
+}
+}
@@ -0,0 +1,152 @@
+#include "data/quantize.hpp"
+#include <cmath>
+#include <algorithm>
+#include <glog/logging.h>
+#include "../kernels/cpu_kernels.hpp"
+
+namespace kuiper_infer {
+/// 量化矩阵每一行补齐到的元素数量，对应一次处理的最大向量宽度
+constexpr uint32_t kQuantizeRowAlign = 64;
+
+bool QuantizedMatrix::empty() const {
+  return data.empty();
+}
+
+float QuantizeScale(float abs_max) {
+  return abs_max > 0.f ? abs_max / 127.f : 1.f;
+}
+
+QuantizedMatrix QuantizeRows(const arma::fmat &matrix) {
+  CHECK(!matrix.empty()) << "The matrix to quantize is empty";
+  QuantizedMatrix quantized;
+  quantized.rows = matrix.n_rows;
+  quantized.cols = matrix.n_cols;
+  quantized.stride = (quantized.cols + kQuantizeRowAlign - 1) / kQuantizeRowAlign * kQuantizeRowAlign;
+  quantized.data.assign(size_t(quantized.rows) * quantized.stride, 0);
+  quantized.scales.resize(quantized.rows);
+  quantized.row_sums.resize(quantized.rows);
+
+  std::vector<float> row(quantized.cols);
+  for (uint32_t r = 0; r < quantized.rows; ++r) {
+    float abs_max = 0.f;
+    for (uint32_t c = 0; c < quantized.cols; ++c) {
+      row.at(c) = matrix.at(r, c);
+      abs_max = std::max(abs_max, std::abs(row.at(c)));
+    }
+    const float scale = QuantizeScale(abs_max);
+    int8_t *row_ptr = quantized.data.data() + size_t(r) * quantized.stride;
+    QuantizeSymmetric(row.data(), quantized.cols, scale, row_ptr);
+    int32_t row_sum = 0;
+    for (uint32_t c = 0; c < quantized.cols; ++c) {
+      row_sum += row_ptr[c];
+    }
+    quantized.scales.at(r) = scale;
+    quantized.row_sums.at(r) = row_sum;
+  }
+  return quantized;
+}
+
+bool GroupQuantizedMatrix::empty() const {
+  return data.empty();
+}
+
+uint32_t GroupQuantizedMatrix::group_num() const {
+  return group_size == 0 ? 0 : (cols + group_size - 1) / group_size;
+}
+
+size_t GroupQuantizedMatrix::panel_bytes() const {
+  return size_t(cols) * panel_rows * bits / 8;
+}
+
+size_t GroupQuantizedMatrix::bytes() const {
+  return data.size() + scales.size() * sizeof(float);
+}
+
+GroupQuantizedMatrix QuantizeGroups(const arma::fmat &matrix, uint32_t bits, uint32_t group_size,
+                                    uint32_t panel_rows) {
+  CHECK(!matrix.empty()) << "The matrix to quantize is empty";
+  CHECK(bits == 8 || bits == 4) << "Unsupported quantization bits: " << bits;
+  CHECK(group_size > 0) << "The quantization group size must be greater than zero";
+  CHECK(panel_rows > 0 && panel_rows % 2 == 0) << "The panel rows must be a positive even number";
+  GroupQuantizedMatrix quantized;
+  quantized.bits = bits;
+  quantized.rows = matrix.n_rows;
+  quantized.cols = matrix.n_cols;
+  quantized.panel_rows = panel_rows;
+  quantized.group_size = group_size;
+  const uint32_t panel_num = (quantized.rows + panel_rows - 1) / panel_rows;
+  const uint32_t group_num = quantized.group_num();
+  const size_t panel_bytes = quantized.panel_bytes();
+  // 补出来的行量化值为0，4位时对应的半字节是8
+  quantized.data.assign(panel_bytes * panel_num, bits == 8 ? 0 : 0x88);
+  quantized.scales.assign(size_t(panel_num) * group_num * panel_rows, 0.f);
+
+  const float max_level = bits == 8 ? 127.f : 7.f;
+  const uint32_t half_rows = panel_rows / 2;
+  for (uint32_t r = 0; r < quantized.rows; ++r) {
+    const uint32_t panel_row = r % panel_rows;
+    uint8_t *panel_ptr = quantized.data.data() + panel_bytes * (r / panel_rows);
+    float *scale_ptr = quantized.scales.data() + size_t(r / panel_rows) * group_num * panel_rows;
+    for (uint32_t g = 0; g < group_num; ++g) {
+      const uint32_t col_begin = g * group_size;
+      const uint32_t col_end = std::min(col_begin + group_size, quantized.cols);
+      float abs_max = 0.f;
+      for (uint32_t c = col_begin; c < col_end; ++c) {
+        abs_max = std::max(abs_max, std::abs(matrix.at(r, c)));
+      }
+      const float scale = abs_max > 0.f ? abs_max / max_level : 1.f;
+      scale_ptr[size_t(g) * panel_rows + panel_row] = scale;
+      for (uint32_t c = col_begin; c < col_end; ++c) {
+        const float value = std::min(max_level, std::max(-max_level, std::nearbyint(matrix.at(r, c) / scale)));
+        if (bits == 8) {
+          panel_ptr[size_t(c) * panel_rows + panel_row] = uint8_t(int8_t(value));
+        } else {
+          uint8_t &byte = panel_ptr[size_t(c) * half_rows + panel_row % half_rows];
+          const uint32_t shift = panel_row < half_rows ? 0 : 4;
+          byte = uint8_t((byte & ~(0xFu << shift)) | (uint32_t(int32_t(value) + 8) << shift));
+        }
+      }
+    }
+  }
+  return quantized;
+}
+
+arma::fmat DequantizeGroups(const GroupQuantizedMatrix &matrix) {
+  arma::fmat dequantized(matrix.rows, matrix.cols);
+  const uint32_t group_num = matrix.group_num();
+  const size_t panel_bytes = matrix.panel_bytes();
+  const uint32_t half_rows = matrix.panel_rows / 2;
+  for (uint32_t r = 0; r < matrix.rows; ++r) {
+    const uint32_t panel_row = r % matrix.panel_rows;
+    const uint8_t *panel_ptr = matrix.data.data() + panel_bytes * (r / matrix.panel_rows);
+    const float *scale_ptr = matrix.scales.data() + size_t(r / matrix.panel_rows) * group_num * matrix.panel_rows;
+    for (uint32_t c = 0; c < matrix.cols; ++c) {
+      int32_t value = 0;
+      if (matrix.bits == 8) {
+        value = int8_t(panel_ptr[size_t(c) * matrix.panel_rows + panel_row]);
+      } else {
+        const uint8_t byte = panel_ptr[size_t(c) * half_rows + panel_row % half_rows];
+        value = int32_t((panel_row < half_rows ? byte : byte >> 4) & 0xF) - 8;
+      }
+      dequantized.at(r, c) = float(value) * scale_ptr[size_t(c / matrix.group_size) * matrix.panel_rows + panel_row];
+    }
+  }
+  return dequantized;
+}
+
+void QuantizeSymmetric(const float *input, uint32_t size, float scale, int8_t *output) {
+  CHECK(scale > 0.f) << "The quantization scale must be greater than zero";
+  const float inv_scale = 1.f / scale;
+  for (uint32_t i = 0; i < size; ++i) {
+    const float value = std::nearbyint(input[i] * inv_scale);
+    output[i] = int8_t(std::min(127.f, std::max(-127.f, value)));
+  }
+}
+
+void Int8MatrixVector(const QuantizedMatrix &matrix, const int8_t *vector, uint32_t row_begin, uint32_t row_end,
+                      int32_t *output) {
+  CHECK(row_begin <= row_end && row_end <= matrix.rows);
+  CurrentCpuKernels().int8_dot_rows(matrix.data.data() + size_t(row_begin) * matrix.stride, matrix.stride,
+                                    row_end - row_begin, vector, matrix.row_sums.data() + row_begin, output);
+}
+}
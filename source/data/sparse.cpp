@@ -0,0 +1,77 @@
+#include "data/sparse.hpp"
+#include <atomic>
+#include <glog/logging.h>
+#include "../kernels/cpu_kernels.hpp"
+
+namespace kuiper_infer {
+static std::atomic<float> sparse_threshold(0.7f);
+
+bool SparseMatrix::empty() const {
+  return col_offsets.empty();
+}
+
+size_t SparseMatrix::bytes() const {
+  return col_offsets.size() * sizeof(uint32_t) + row_indices.size() * sizeof(uint32_t)
+      + values.size() * sizeof(float);
+}
+
+void SetSparseThreshold(float threshold) {
+  CHECK(threshold >= 0.f) << "The sparse threshold can not be negative: " << threshold;
+  sparse_threshold.store(threshold);
+}
+
+float SparseThreshold() {
+  return sparse_threshold.load();
+}
+
+float ZeroRatio(const float *data, size_t size) {
+  if (size == 0) {
+    return 0.f;
+  }
+  CHECK(data != nullptr);
+  size_t zero_num = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == 0.f) {
+      zero_num += 1;
+    }
+  }
+  return float(zero_num) / float(size);
+}
+
+SparseMatrix SparsifyColumns(const float *matrix, uint32_t rows, uint32_t cols, uint32_t row_stride,
+                             uint32_t col_stride) {
+  CHECK(matrix != nullptr && rows > 0 && cols > 0) << "The matrix to sparsify is empty";
+  SparseMatrix sparse;
+  sparse.rows = rows;
+  sparse.cols = cols;
+  sparse.col_offsets.reserve(cols + 1);
+  sparse.col_offsets.push_back(0);
+  for (uint32_t c = 0; c < cols; ++c) {
+    const float *col_ptr = matrix + size_t(c) * col_stride;
+    for (uint32_t r = 0; r < rows; ++r) {
+      const float value = col_ptr[size_t(r) * row_stride];
+      if (value != 0.f) {
+        sparse.row_indices.push_back(r);
+        sparse.values.push_back(value);
+      }
+    }
+    sparse.col_offsets.push_back(sparse.values.size());
+  }
+  sparse.row_indices.shrink_to_fit();
+  sparse.values.shrink_to_fit();
+  return sparse;
+}
+
+void SparseGemm(uint32_t m, const float *a, uint32_t lda, const SparseMatrix &b, uint32_t col_begin, uint32_t n,
+                float *c, uint32_t ldc, const GemmEpilogue &epilogue) {
+  CHECK(!b.empty()) << "The sparse matrix is empty";
+  CHECK(col_begin + n <= b.cols) << "The columns " << col_begin << " + " << n << " exceed the sparse matrix "
+                                 << b.cols;
+  CHECK(ldc >= m && (m == 0 || a != nullptr) && c != nullptr);
+  if (m == 0 || n == 0) {
+    return;
+  }
+  CurrentCpuKernels().sparse_gemm(a, lda, m, b.col_offsets.data() + col_begin, b.row_indices.data(),
+                                  b.values.data(), n, c, ldc, epilogue);
+}
+}
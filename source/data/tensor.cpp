@@ -6,11 +6,28 @@
 #include <glog/logging.h>
 
 #include <memory>
+#include "validation.hpp"
+#include "../kernels/cpu_kernels.hpp"
 
 namespace kuiper_infer {
 
 Tensor<float>::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
   data_ = arma::fcube(rows, cols, channels);
+  this->TrackMemory();
+  if (channels == 1 && rows == 1) {
+    this->raw_shapes_ = std::vector < uint32_t > {cols};
+  } else if (channels == 1) {
+    this->raw_shapes_ = std::vector < uint32_t > {rows, cols};
+  } else {
+    this->raw_shapes_ = std::vector < uint32_t > {channels, rows, cols};
+  }
+}
+
+Tensor<float>::Tensor(float *raw_ptr, uint32_t channels, uint32_t rows, uint32_t cols)
+    : data_(raw_ptr, rows, cols, channels, false, true) {
+  // 外部内存只能在构造时绑定，赋值一个建立在外部内存上的cube会拷贝出新的内存
+  CHECK(raw_ptr != nullptr);
+  this->TrackMemory();
   if (channels == 1 && rows == 1) {
     this->raw_shapes_ = std::vector < uint32_t > {cols};
   } else if (channels == 1) {
@@ -23,33 +40,43 @@ Tensor<float>::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
 Tensor<float>::Tensor(const Tensor &tensor) {
   this->data_ = tensor.data_;
   this->raw_shapes_ = tensor.raw_shapes_;
+  this->TrackMemory();
+  // 拷贝只保存在主机上，最新的数据在设备上时从设备复制
+  if (tensor.device_ != DeviceType::kDeviceCPU) {
+    tensor.cuda_buffer_->CopyToHost(this->data_.memptr(), this->data_.n_elem);
+  }
 }
 
 Tensor<float> &Tensor<float>::operator=(const Tensor &tensor) {
   if (this != &tensor) {
     this->data_ = tensor.data_;
     this->raw_shapes_ = tensor.raw_shapes_;
+    this->TrackMemory();
+    if (tensor.device_ != DeviceType::kDeviceCPU) {
+      tensor.cuda_buffer_->CopyToHost(this->data_.memptr(), this->data_.n_elem);
+    }
+    this->device_ = DeviceType::kDeviceCPU;
   }
   return *this;
 }
 
 uint32_t Tensor<float>::rows() const {
-  CHECK(!this->data_.empty());
+  KUIPER_DEBUG_CHECK(!this->data_.empty());
   return this->data_.n_rows;
 }
 
 uint32_t Tensor<float>::cols() const {
-  CHECK(!this->data_.empty());
+  KUIPER_DEBUG_CHECK(!this->data_.empty());
   return this->data_.n_cols;
 }
 
 uint32_t Tensor<float>::channels() const {
-  CHECK(!this->data_.empty());
+  KUIPER_DEBUG_CHECK(!this->data_.empty());
   return this->data_.n_slices;
 }
 
 uint32_t Tensor<float>::size() const {
-  CHECK(!this->data_.empty());
+  KUIPER_DEBUG_CHECK(!this->data_.empty());
   return this->data_.size();
 }
 
@@ -65,12 +92,12 @@ bool Tensor<float>::empty() const {
 }
 
 float Tensor<float>::index(uint32_t offset) const {
-  CHECK(offset < this->data_.size()) << "Tensor capacity is not enough!";
+  KUIPER_DEBUG_CHECK(offset < this->data_.size()) << "Tensor capacity is not enough!";
   return this->data_.at(offset);
 }
 
 float &Tensor<float>::index(uint32_t offset) {
-  CHECK(offset < this->data_.size()) << "Tensor capacity is not enough!";
+  KUIPER_DEBUG_CHECK(offset < this->data_.size()) << "Tensor capacity is not enough!";
   return this->data_.at(offset);
 }
 
@@ -88,26 +115,26 @@ const arma::fcube &Tensor<float>::data() const {
 }
 
 arma::fmat &Tensor<float>::at(uint32_t channel) {
-  CHECK_LT(channel, this->channels());
+  KUIPER_DEBUG_CHECK(channel < this->channels());
   return this->data_.slice(channel);
 }
 
 const arma::fmat &Tensor<float>::at(uint32_t channel) const {
-  CHECK_LT(channel, this->channels());
+  KUIPER_DEBUG_CHECK(channel < this->channels());
   return this->data_.slice(channel);
 }
 
 float Tensor<float>::at(uint32_t channel, uint32_t row, uint32_t col) const {
-  CHECK_LT(row, this->rows());
-  CHECK_LT(col, this->cols());
-  CHECK_LT(channel, this->channels());
+  KUIPER_DEBUG_CHECK(row < this->rows());
+  KUIPER_DEBUG_CHECK(col < this->cols());
+  KUIPER_DEBUG_CHECK(channel < this->channels());
   return this->data_.at(row, col, channel);
 }
 
 float &Tensor<float>::at(uint32_t channel, uint32_t row, uint32_t col) {
-  CHECK_LT(row, this->rows());
-  CHECK_LT(col, this->cols());
-  CHECK_LT(channel, this->channels());
+  KUIPER_DEBUG_CHECK(row < this->rows());
+  KUIPER_DEBUG_CHECK(col < this->cols());
+  KUIPER_DEBUG_CHECK(channel < this->channels());
   return this->data_.at(row, col, channel);
 }
 
@@ -141,6 +168,7 @@ void Tensor<float>::Padding(const std::vector<uint32_t> &pads, float padding_val
   }
   CHECK(!padded_cube.empty());
   this->data_ = padded_cube;
+  this->TrackMemory();
 }
 
 void Tensor<float>::Fill(float value) {
@@ -149,9 +177,14 @@ void Tensor<float>::Fill(float value) {
 }
 
 void Tensor<float>::Fill(const std::vector<float> &values) {
+  Fill(values.data(), values.size());
+}
+
+void Tensor<float>::Fill(const float *values, uint32_t size) {
   CHECK(!this->data_.empty());
+  CHECK(values != nullptr);
   const uint32_t total_elems = this->data_.size();
-  CHECK_EQ(values.size(), total_elems);
+  CHECK_EQ(size, total_elems);
 
   const uint32_t rows = this->rows();
   const uint32_t cols = this->cols();
@@ -160,7 +193,7 @@ void Tensor<float>::Fill(const std::vector<float> &values) {
 
   for (uint32_t i = 0; i < channels; ++i) {
     auto &channel_data = this->data_.slice(i);
-    const arma::fmat &channel_data_t = arma::fmat(values.data() + i * planes, this->cols(), this->rows());
+    const arma::fmat &channel_data_t = arma::fmat(values + i * planes, this->cols(), this->rows());
     channel_data = channel_data_t.t();
   }
 }
@@ -194,6 +227,7 @@ void Tensor<float>::Flatten() {
   }
   CHECK_EQ(index, size);
   this->data_ = linear_cube;
+  this->TrackMemory();
   this->raw_shapes_ = std::vector < uint32_t > {size};
 }
 
@@ -212,64 +246,79 @@ void Tensor<float>::Ones() {
   this->data_.fill(1.);
 }
 
+/**
+ * 返回两个张量逐元素计算的结果形状，形状相同或者其中一个每个通道只有一个值时可以计算
+ * @param tensor1 输入张量1
+ * @param tensor2 输入张量2
+ * @return 结果张量的形状
+ */
+static std::vector<uint32_t> BroadcastShapes(const std::shared_ptr<Tensor<float>> &tensor1,
+                                             const std::shared_ptr<Tensor<float>> &tensor2) {
+  CHECK(tensor1 != nullptr && tensor2 != nullptr);
+  CHECK(!tensor1->empty() && !tensor2->empty());
+  if (tensor1->shapes() == tensor2->shapes()) {
+    return tensor1->shapes();
+  }
+  CHECK(tensor1->channels() == tensor2->channels()) << "Tensors shape are not adapting";
+  if (tensor2->rows() == 1 && tensor2->cols() == 1) {
+    return tensor1->shapes();
+  }
+  CHECK(tensor1->rows() == 1 && tensor1->cols() == 1) << "Tensors shape are not adapting";
+  return tensor2->shapes();
+}
+
+/**
+ * 逐元素计算两个张量，每个通道只有一个值的张量按照步长为0读取，不展开成完整的张量
+ * 输出张量可以和任意一个输入张量是同一个张量
+ * @param tensor1 输入张量1
+ * @param tensor2 输入张量2
+ * @param output_tensor 输出张量
+ * @param operation 逐元素计算的运算
+ */
+static void ElementBroadcast(const std::shared_ptr<Tensor<float>> &tensor1,
+                             const std::shared_ptr<Tensor<float>> &tensor2,
+                             const std::shared_ptr<Tensor<float>> &output_tensor, ElementOperation operation) {
+  const std::vector<uint32_t> &shapes = BroadcastShapes(tensor1, tensor2);
+  CHECK(output_tensor != nullptr && output_tensor->shapes() == shapes)
+          << "The output tensor shape is not adapting";
+  const uint32_t plane_size = output_tensor->rows() * output_tensor->cols();
+  const bool broadcast1 = tensor1->rows() * tensor1->cols() == 1;
+  const bool broadcast2 = tensor2->rows() * tensor2->cols() == 1;
+  const CpuKernels &kernels = CurrentCpuKernels();
+  for (uint32_t c = 0; c < output_tensor->channels(); ++c) {
+    kernels.element_binary(operation, tensor1->at(c).memptr(), broadcast1, tensor2->at(c).memptr(), broadcast2,
+                           plane_size, output_tensor->at(c).memptr());
+  }
+}
+
 std::shared_ptr<Tensor<float>> Tensor<float>::ElementAdd(const std::shared_ptr<Tensor<float>> &tensor1,
                                                          const std::shared_ptr<Tensor<float>> &tensor2) {
-  CHECK(!tensor1->empty() && !tensor2->empty());
-  CHECK(tensor1->shapes() == tensor2->shapes()) << "Tensors shape are not adapting";
-  std::shared_ptr<Tensor<float>>
-      output_tensor = std::make_shared < Tensor < float >> (tensor1->channels(), tensor1->rows(), tensor1->cols());
-  output_tensor->data_ = tensor1->data_ + tensor2->data_;
+  const std::vector<uint32_t> &shapes = BroadcastShapes(tensor1, tensor2);
+  std::shared_ptr<Tensor<float>> output_tensor = std::make_shared<Tensor<float>>(shapes.at(0), shapes.at(1),
+                                                                                 shapes.at(2));
+  ElementAdd(tensor1, tensor2, output_tensor);
   return output_tensor;
 }
 
+void Tensor<float>::ElementAdd(const std::shared_ptr<Tensor<float>> &tensor1,
+                               const std::shared_ptr<Tensor<float>> &tensor2,
+                               const std::shared_ptr<Tensor<float>> &output_tensor) {
+  ElementBroadcast(tensor1, tensor2, output_tensor, ElementOperation::kAdd);
+}
+
 std::shared_ptr<Tensor<float>> Tensor<float>::ElementMultiply(const std::shared_ptr<Tensor<float>> &tensor1,
                                                               const std::shared_ptr<Tensor<float>> &tensor2) {
-  CHECK(!tensor1->empty() && !tensor2->empty());
-  if (tensor1->shapes() == tensor2->shapes()) {
-    std::shared_ptr<Tensor<float>> output_tensor =
-        std::make_shared < Tensor < float >> (tensor1->channels(), tensor1->rows(), tensor1->cols());
-    output_tensor->data_ = tensor1->data_ % tensor2->data_;
-    return output_tensor;
-  } else {
-    CHECK(tensor1->channels() == tensor2->channels()) << "Tensors shape are not adapting";
-    uint32_t channels = tensor1->channels();
-    std::shared_ptr<Tensor<float>> tensor1_;
-    std::shared_ptr<Tensor<float>> tensor2_;
-
-    if (tensor2->rows() == 1 && tensor2->cols() == 1) {
-      tensor1_ = tensor1;
-      tensor2_ = tensor2;
-    } else if (tensor1->rows() == 1 && tensor1->cols() == 1) {
-      tensor1_ = tensor2;
-      tensor2_ = tensor1;
-    } else {
-      LOG(FATAL) << "Tensors shape are not adapting";
-    }
-
-    std::vector<float> channel_values;
-    for (uint32_t c = 0; c < channels; ++c) {
-      float value = tensor2_->index(c);
-      channel_values.push_back(value);
-    }
-    const std::shared_ptr<Tensor<float>> input_tensor2_ = tensor2_->Clone();
-    input_tensor2_->data_.reshape(tensor1_->rows(), tensor1_->cols(), channels);
-    for (uint32_t c = 0; c < channels; ++c) {
-      input_tensor2_->data_.slice(c).fill(channel_values.at(c));
-    }
-    std::shared_ptr<Tensor<float>> output_tensor =
-        std::make_shared < Tensor
-            < float >> (input_tensor2_->rows(), input_tensor2_->cols(), input_tensor2_->channels());
-    output_tensor->data_ = tensor1_->data_ % input_tensor2_->data_;
-    return output_tensor;
-  }
+  const std::vector<uint32_t> &shapes = BroadcastShapes(tensor1, tensor2);
+  std::shared_ptr<Tensor<float>> output_tensor = std::make_shared<Tensor<float>>(shapes.at(0), shapes.at(1),
+                                                                                 shapes.at(2));
+  ElementMultiply(tensor1, tensor2, output_tensor);
+  return output_tensor;
 }
 
-void Tensor<float>::Transform(const std::function<float(float)> &filter) {
-  CHECK(!this->data_.empty());
-  uint32_t channels = this->channels();
-  for (uint32_t c = 0; c < channels; ++c) {
-    this->data_.slice(c).transform(filter);
-  }
+void Tensor<float>::ElementMultiply(const std::shared_ptr<Tensor<float>> &tensor1,
+                                    const std::shared_ptr<Tensor<float>> &tensor2,
+                                    const std::shared_ptr<Tensor<float>> &output_tensor) {
+  ElementBroadcast(tensor1, tensor2, output_tensor, ElementOperation::kMultiply);
 }
 
 void Tensor<float>::ReRawshape(const std::vector<uint32_t> &shapes) {
@@ -298,6 +347,57 @@ const std::vector<uint32_t> &Tensor<float>::raw_shapes() const {
   return this->raw_shapes_;
 }
 
+/**
+ * 将实际尺寸大小转换为张量的通道数、行数和列数，一维时是一列，二维时是一个通道
+ * @param shapes 张量的实际尺寸大小
+ * @return 张量的通道数、行数和列数
+ */
+static std::vector<uint32_t> CubeShapes(const std::vector<uint32_t> &shapes) {
+  CHECK(!shapes.empty() && shapes.size() <= 3);
+  if (shapes.size() == 3) {
+    return {shapes.at(0), shapes.at(1), shapes.at(2)};
+  } else if (shapes.size() == 2) {
+    return {1, shapes.at(0), shapes.at(1)};
+  } else {
+    return {1, shapes.at(0), 1};
+  }
+}
+
+/**
+ * 按照行优先的元素顺序将source中的数据复制到target中，两者的元素数量相同
+ * @param source 原始数据
+ * @param target 重新排列之后的数据
+ */
+static void ViewCopy(const arma::fcube &source, arma::fcube &target) {
+  CHECK(source.n_elem == target.n_elem);
+  const uint32_t source_rows = source.n_rows;
+  const uint32_t source_cols = source.n_cols;
+  const uint32_t target_rows = target.n_rows;
+  const uint32_t target_cols = target.n_cols;
+  // 目标位置的坐标随着行优先的顺序递增，不需要对每个元素做除法和取余
+  uint32_t channel = 0;
+  uint32_t row = 0;
+  uint32_t col = 0;
+  float *target_channel = target.slice_memptr(0);
+  for (uint32_t c = 0; c < source.n_slices; ++c) {
+    const float *source_channel = source.slice_memptr(c);
+    for (uint32_t r = 0; r < source_rows; ++r) {
+      for (uint32_t c_ = 0; c_ < source_cols; ++c_) {
+        target_channel[col * target_rows + row] = source_channel[c_ * source_rows + r];
+        if (++col == target_cols) {
+          col = 0;
+          if (++row == target_rows) {
+            row = 0;
+            if (++channel < target.n_slices) {
+              target_channel = target.slice_memptr(channel);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 void Tensor<float>::ReRawView(const std::vector<uint32_t> &shapes) {
   CHECK(!shapes.empty());
   const uint32_t origin_size = this->size();
@@ -307,18 +407,15 @@ void Tensor<float>::ReRawView(const std::vector<uint32_t> &shapes) {
   }
   CHECK(shapes.size() <= 3);
   CHECK(current_size == origin_size);
-  std::vector<uint32_t> target_shapes; // channel row col
-  if (shapes.size() == 3) {
-    target_shapes = {shapes.at(0), shapes.at(1), shapes.at(2)};
-    this->raw_shapes_ = {shapes.at(0), shapes.at(1), shapes.at(2)};
-  } else if (shapes.size() == 2) {
-    target_shapes = {1, shapes.at(0), shapes.at(1)};
-    this->raw_shapes_ = {shapes.at(0), shapes.at(1)};
+  const std::vector<uint32_t> &target_shapes = CubeShapes(shapes); // channel row col
+  if (ViewSharesMemory(this->data_.n_rows, this->data_.n_cols, shapes) && this->data_.mem_state == 0) {
+    // 存储顺序和行优先的顺序一致，只需要改变形状
+    this->data_.reshape(target_shapes.at(1), target_shapes.at(2), target_shapes.at(0));
+    this->TrackMemory();
   } else {
-    target_shapes = {1, shapes.at(0), 1};
-    this->raw_shapes_ = {shapes.at(0)};
+    this->ReView(target_shapes);
   }
-  this->ReView(target_shapes);
+  this->raw_shapes_ = shapes;
 }
 
 void Tensor<float>::ReView(const std::vector<uint32_t> &shapes) {
@@ -326,20 +423,156 @@ void Tensor<float>::ReView(const std::vector<uint32_t> &shapes) {
   const uint32_t target_rows = shapes.at(1);
   const uint32_t target_cols = shapes.at(2);
   arma::fcube new_data(target_rows, target_cols, target_channels);
+  ViewCopy(this->data_, new_data);
+  this->data_ = new_data;
+  this->TrackMemory();
+}
 
-  const uint32_t plane_size = target_rows * target_cols;
-  for (uint32_t c = 0; c < this->data_.n_slices; ++c) {
-    for (uint32_t r = 0; r < this->data_.n_rows; ++r) {
-      for (uint32_t c_ = 0; c_ < this->data_.n_cols; ++c_) {
-        const uint32_t pos_index = c * data_.n_rows * data_.n_cols + r * data_.n_cols + c_;
-        const uint32_t ch = pos_index / plane_size;          // 249 / 60 => 4
-        const uint32_t row = (pos_index - ch * plane_size) / target_cols;   // 255 -
-        const uint32_t col = (pos_index - ch * plane_size - row * target_cols);
-        new_data.at(row, col, ch) = this->data_.at(r, c_, c);
-      }
+std::shared_ptr<Tensor<float>> Tensor<float>::Alias(const std::shared_ptr<Tensor<float>> &tensor, uint32_t offset,
+                                                    const std::vector<uint32_t> &shapes,
+                                                    const std::vector<uint32_t> &raw_shapes) {
+  CHECK(tensor != nullptr && !tensor->empty());
+  CHECK(offset + shapes.at(0) * shapes.at(1) * shapes.at(2) <= tensor->size());
+  std::shared_ptr<Tensor<float>> view = std::make_shared<Tensor<float>>(tensor->data_.memptr() + offset, shapes.at(0),
+                                                                        shapes.at(1), shapes.at(2));
+  view->raw_shapes_ = raw_shapes;
+  view->base_ = tensor->base_ != nullptr ? tensor->base_ : tensor;
+  return view;
+}
+
+std::shared_ptr<Tensor<float>> Tensor<float>::Reshape(const std::shared_ptr<Tensor<float>> &tensor,
+                                                      const std::vector<uint32_t> &shapes) {
+  CHECK(tensor != nullptr && !tensor->empty());
+  uint32_t current_size = 1;
+  for (uint32_t s : shapes) {
+    current_size *= s;
+  }
+  CHECK(current_size == tensor->size());
+  return Alias(tensor, 0, CubeShapes(shapes), shapes);
+}
+
+std::shared_ptr<Tensor<float>> Tensor<float>::View(const std::shared_ptr<Tensor<float>> &tensor,
+                                                   const std::vector<uint32_t> &shapes) {
+  CHECK(tensor != nullptr && !tensor->empty());
+  uint32_t current_size = 1;
+  for (uint32_t s : shapes) {
+    current_size *= s;
+  }
+  CHECK(current_size == tensor->size());
+  const std::vector<uint32_t> &target_shapes = CubeShapes(shapes);
+  if (ViewSharesMemory(tensor->rows(), tensor->cols(), shapes)) {
+    return Alias(tensor, 0, target_shapes, shapes);
+  }
+  std::shared_ptr<Tensor<float>> output =
+      std::make_shared<Tensor<float>>(target_shapes.at(0), target_shapes.at(1), target_shapes.at(2));
+  ViewCopy(tensor->data_, output->data_);
+  output->raw_shapes_ = shapes;
+  return output;
+}
+
+std::shared_ptr<Tensor<float>> Tensor<float>::Slice(const std::shared_ptr<Tensor<float>> &tensor,
+                                                    uint32_t channel_begin, uint32_t channels) {
+  CHECK(tensor != nullptr && !tensor->empty());
+  CHECK(channels > 0 && channel_begin + channels <= tensor->channels())
+          << "The channel slice is out of range: " << channel_begin << " + " << channels << " > "
+          << tensor->channels();
+  const uint32_t rows = tensor->rows();
+  const uint32_t cols = tensor->cols();
+  std::vector<uint32_t> raw_shapes;
+  if (channels == 1 && rows == 1) {
+    raw_shapes = {cols};
+  } else if (channels == 1) {
+    raw_shapes = {rows, cols};
+  } else {
+    raw_shapes = {channels, rows, cols};
+  }
+  return Alias(tensor, channel_begin * rows * cols, {channels, rows, cols}, raw_shapes);
+}
+
+std::vector<std::shared_ptr<Tensor<float>>> Tensor<float>::CreateBatch(uint32_t batch_size, uint32_t channels,
+                                                                       uint32_t rows, uint32_t cols) {
+  CHECK(batch_size > 0 && channels > 0) << "The batch size and channels must be greater than zero";
+  const std::shared_ptr<Tensor<float>> batch = std::make_shared<Tensor<float>>(batch_size * channels, rows, cols);
+  std::vector<std::shared_ptr<Tensor<float>>> tensors(batch_size);
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    tensors.at(i) = Slice(batch, i * channels, channels);
+  }
+  return tensors;
+}
+
+float *Tensor<float>::ContiguousBatch(const std::vector<std::shared_ptr<Tensor<float>>> &tensors) {
+  if (tensors.empty() || tensors.front() == nullptr || tensors.front()->empty()) {
+    return nullptr;
+  }
+  const std::shared_ptr<Tensor<float>> &first = tensors.front();
+  float *batch_ptr = first->data_.memptr();
+  for (uint32_t i = 1; i < tensors.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &tensor = tensors.at(i);
+    if (tensor == nullptr || tensor->empty() || tensor->raw_shapes_ != first->raw_shapes_
+        || tensor->data_.n_rows != first->data_.n_rows || tensor->data_.n_cols != first->data_.n_cols
+        || tensor->data_.n_slices != first->data_.n_slices
+        || tensor->data_.memptr() != batch_ptr + size_t(i) * first->data_.n_elem) {
+      return nullptr;
     }
   }
-  this->data_ = new_data;
+  return batch_ptr;
+}
+
+bool Tensor<float>::ViewSharesMemory(uint32_t rows, uint32_t cols, const std::vector<uint32_t> &shapes) {
+  const std::vector<uint32_t> &target_shapes = CubeShapes(shapes);
+  const uint32_t target_rows = target_shapes.at(1);
+  const uint32_t target_cols = target_shapes.at(2);
+  if (rows == target_rows && cols == target_cols) {
+    return true;
+  }
+  return (rows == 1 || cols == 1) && (target_rows == 1 || target_cols == 1);
+}
+
+bool Tensor<float>::is_view() const {
+  return this->base_ != nullptr;
+}
+
+DeviceType Tensor<float>::device() const {
+  return this->device_;
+}
+
+void Tensor<float>::set_device(DeviceType device) {
+  this->device_ = device;
+}
+
+void Tensor<float>::SyncTo(DeviceType device) {
+  if (device == this->device_) {
+    return;
+  }
+  CHECK(!this->data_.empty());
+  if (device == DeviceType::kDeviceCUDA) {
+    this->cuda_data();
+    this->cuda_buffer_->CopyFromHost(this->data_.memptr(), this->data_.n_elem);
+  } else {
+    CHECK(this->cuda_buffer_ != nullptr) << "The tensor has no data on the cuda device";
+    this->cuda_buffer_->CopyToHost(this->data_.memptr(), this->data_.n_elem);
+  }
+}
+
+float *Tensor<float>::cuda_data() {
+  CHECK(!this->data_.empty());
+  if (this->cuda_buffer_ == nullptr) {
+    this->cuda_buffer_ = std::make_shared<DeviceBuffer>();
+  }
+  // 填充之后元素数量会变化，设备内存不够时重新分配
+  this->cuda_buffer_->Reserve(this->data_.n_elem);
+  return this->cuda_buffer_->data();
+}
+
+void Tensor<float>::set_cuda_buffer(std::shared_ptr<DeviceBuffer> cuda_buffer) {
+  CHECK(cuda_buffer != nullptr && cuda_buffer->size() >= this->data_.n_elem)
+          << "The device buffer can not hold the tensor";
+  this->cuda_buffer_ = std::move(cuda_buffer);
+}
+
+void Tensor<float>::TrackMemory() {
+  // mem_state为0时内存由张量自己分配，否则是外部内存
+  this->allocation_.Reset(this->data_.mem_state == 0 ? this->data_.n_elem * sizeof(float) : 0);
 }
 
 const float *Tensor<float>::RawPtr() const {
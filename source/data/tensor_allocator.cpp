@@ -0,0 +1,197 @@
+#include "data/tensor_allocator.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace kuiper_infer {
+/// 每块内存前面的头部，记录分配这块内存的分配器和申请的字节数，占用一个缓存行以保持对齐
+struct alignas(PoolTensorAllocator::kAlignment) TensorBlockHeader {
+  TensorAllocator *allocator = nullptr;
+  size_t bytes = 0;
+};
+
+static_assert(sizeof(TensorBlockHeader) == PoolTensorAllocator::kAlignment, "The block header must be one cache line");
+
+/// 设置过的全部分配器，进程退出时全局的矩阵仍然可能释放内存，所以不析构
+static std::vector<std::shared_ptr<TensorAllocator>> &InstalledAllocators() {
+  static auto *allocators = new std::vector<std::shared_ptr<TensorAllocator>>();
+  return *allocators;
+}
+
+static std::mutex installed_mutex;
+static std::atomic<TensorAllocator *> current_allocator{nullptr};
+
+void TensorAllocator::SetCurrent(std::shared_ptr<TensorAllocator> allocator) {
+  std::lock_guard<std::mutex> lock(installed_mutex);
+  if (allocator == nullptr) {
+    current_allocator.store(nullptr);
+    return;
+  }
+  current_allocator.store(allocator.get());
+  InstalledAllocators().push_back(std::move(allocator));
+}
+
+TensorAllocator &TensorAllocator::Current() {
+  TensorAllocator *allocator = current_allocator.load(std::memory_order_acquire);
+  return allocator != nullptr ? *allocator : Default();
+}
+
+TensorAllocator &TensorAllocator::Default() {
+  // 和InstalledAllocators相同，默认的分配器也不析构
+  static auto *allocator = new PoolTensorAllocator();
+  return *allocator;
+}
+
+PoolTensorAllocator::PoolTensorAllocator(size_t max_cached_bytes, size_t huge_page_threshold, bool use_hugetlb)
+    : max_cached_bytes_(max_cached_bytes), huge_page_threshold_(huge_page_threshold), use_hugetlb_(use_hugetlb) {
+}
+
+PoolTensorAllocator::~PoolTensorAllocator() {
+  this->Trim();
+}
+
+size_t PoolTensorAllocator::RoundSize(size_t bytes) const {
+  if (huge_page_threshold_ != 0 && bytes >= huge_page_threshold_) {
+    return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  }
+  if (bytes <= 256) {
+    return 256;
+  }
+  // 最高位以下的两位决定级别，step是最高位的四分之一
+  size_t high_bit = 1;
+  while ((high_bit << 1) <= bytes - 1) {
+    high_bit <<= 1;
+  }
+  const size_t step = high_bit / 4;
+  return (bytes + step - 1) / step * step;
+}
+
+void *PoolTensorAllocator::AllocateBlock(size_t size) const {
+#if defined(__linux__)
+  if (huge_page_threshold_ != 0 && size >= huge_page_threshold_) {
+#if defined(MAP_HUGETLB)
+    if (use_hugetlb_) {
+      void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        return ptr;
+      }
+    }
+#endif
+    // 多映射一个大页，裁掉首尾之后起点按照大页对齐，透明大页才能覆盖整块内存
+    const size_t mapped_size = size + kHugePageSize;
+    void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      return nullptr;
+    }
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(mapped);
+    const uintptr_t aligned = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    if (aligned > begin) {
+      munmap(mapped, aligned - begin);
+    }
+    const size_t tail = begin + mapped_size - (aligned + size);
+    if (tail > 0) {
+      munmap(reinterpret_cast<void *>(aligned + size), tail);
+    }
+    void *ptr = reinterpret_cast<void *>(aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    return ptr;
+  }
+#endif
+  return std::aligned_alloc(kAlignment, size);
+}
+
+void PoolTensorAllocator::ReleaseBlock(void *ptr, size_t size) const {
+#if defined(__linux__)
+  if (huge_page_threshold_ != 0 && size >= huge_page_threshold_) {
+    munmap(ptr, size);
+    return;
+  }
+#endif
+  std::free(ptr);
+}
+
+void *PoolTensorAllocator::Allocate(size_t bytes) {
+  const size_t size = RoundSize(bytes);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = free_blocks_.find(size);
+    if (iter != free_blocks_.end() && !iter->second.empty()) {
+      void *ptr = iter->second.back();
+      iter->second.pop_back();
+      cached_bytes_ -= size;
+      reused_count_ += 1;
+      return ptr;
+    }
+  }
+  return AllocateBlock(size);
+}
+
+void PoolTensorAllocator::Release(void *ptr, size_t bytes) {
+  if (ptr == nullptr) {
+    return;
+  }
+  const size_t size = RoundSize(bytes);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cached_bytes_ + size <= max_cached_bytes_) {
+      free_blocks_[size].push_back(ptr);
+      cached_bytes_ += size;
+      return;
+    }
+  }
+  ReleaseBlock(ptr, size);
+}
+
+void PoolTensorAllocator::Trim() {
+  std::unordered_map<size_t, std::vector<void *>> free_blocks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_blocks.swap(free_blocks_);
+    cached_bytes_ = 0;
+  }
+  for (const auto &[size, blocks] : free_blocks) {
+    for (void *ptr : blocks) {
+      ReleaseBlock(ptr, size);
+    }
+  }
+}
+
+size_t PoolTensorAllocator::cached_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cached_bytes_;
+}
+
+size_t PoolTensorAllocator::reused_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reused_count_;
+}
+}
+
+void *kuiper_infer_arma_allocate(size_t bytes) {
+  using namespace kuiper_infer;
+  TensorAllocator &allocator = TensorAllocator::Current();
+  const size_t total_bytes = bytes + sizeof(TensorBlockHeader);
+  void *block = allocator.Allocate(total_bytes);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  TensorBlockHeader *header = new(block) TensorBlockHeader();
+  header->allocator = &allocator;
+  header->bytes = total_bytes;
+  return header + 1;
+}
+
+void kuiper_infer_arma_release(void *ptr) {
+  using namespace kuiper_infer;
+  if (ptr == nullptr) {
+    return;
+  }
+  TensorBlockHeader *header = static_cast<TensorBlockHeader *>(ptr) - 1;
+  header->allocator->Release(header, header->bytes);
+}
@@ -0,0 +1,391 @@
+#include "cpu_kernels.hpp"
+#include <math.h>
+#include <float.h>
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+#if defined(__AVX512F__)
+/// AVX-512一次处理16个float
+struct ActivationVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type Set(float value) { return _mm512_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm512_add_ps(x, y); }
+  static Type Sub(Type x, Type y) { return _mm512_sub_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm512_mul_ps(x, y); }
+  static Type Div(Type x, Type y) { return _mm512_div_ps(x, y); }
+  static Type Max(Type x, Type y) { return _mm512_max_ps(x, y); }
+  static Type Min(Type x, Type y) { return _mm512_min_ps(x, y); }
+  static Type Floor(Type x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+  static Type Pow2(Type n) {
+    const __m512i exponent = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(exponent, 23));
+  }
+  static Type SelectLessEqual(Type x, Type bound, Type if_true, Type otherwise) {
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, bound, _CMP_LE_OQ), otherwise, if_true);
+  }
+};
+#elif defined(__AVX2__)
+/// AVX2一次处理8个float
+struct ActivationVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type Set(float value) { return _mm256_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm256_add_ps(x, y); }
+  static Type Sub(Type x, Type y) { return _mm256_sub_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm256_mul_ps(x, y); }
+  static Type Div(Type x, Type y) { return _mm256_div_ps(x, y); }
+  static Type Max(Type x, Type y) { return _mm256_max_ps(x, y); }
+  static Type Min(Type x, Type y) { return _mm256_min_ps(x, y); }
+  static Type Floor(Type x) { return _mm256_floor_ps(x); }
+  static Type Pow2(Type n) {
+    const __m256i exponent = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+  }
+  static Type SelectLessEqual(Type x, Type bound, Type if_true, Type otherwise) {
+    return _mm256_blendv_ps(otherwise, if_true, _mm256_cmp_ps(x, bound, _CMP_LE_OQ));
+  }
+};
+#elif defined(__SSE4_2__)
+/// SSE一次处理4个float
+struct ActivationVector {
+  using Type = __m128;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return _mm_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm_storeu_ps(ptr, x); }
+  static Type Set(float value) { return _mm_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm_add_ps(x, y); }
+  static Type Sub(Type x, Type y) { return _mm_sub_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm_mul_ps(x, y); }
+  static Type Div(Type x, Type y) { return _mm_div_ps(x, y); }
+  static Type Max(Type x, Type y) { return _mm_max_ps(x, y); }
+  static Type Min(Type x, Type y) { return _mm_min_ps(x, y); }
+  static Type Floor(Type x) { return _mm_floor_ps(x); }
+  static Type Pow2(Type n) {
+    const __m128i exponent = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(exponent, 23));
+  }
+  static Type SelectLessEqual(Type x, Type bound, Type if_true, Type otherwise) {
+    return _mm_blendv_ps(otherwise, if_true, _mm_cmple_ps(x, bound));
+  }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// NEON一次处理4个float
+struct ActivationVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type Set(float value) { return vdupq_n_f32(value); }
+  static Type Add(Type x, Type y) { return vaddq_f32(x, y); }
+  static Type Sub(Type x, Type y) { return vsubq_f32(x, y); }
+  static Type Mul(Type x, Type y) { return vmulq_f32(x, y); }
+  static Type Div(Type x, Type y) { return vdivq_f32(x, y); }
+  static Type Max(Type x, Type y) { return vmaxq_f32(x, y); }
+  static Type Min(Type x, Type y) { return vminq_f32(x, y); }
+  static Type Floor(Type x) { return vrndmq_f32(x); }
+  static Type Pow2(Type n) {
+    const int32x4_t exponent = vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127));
+    return vreinterpretq_f32_s32(vshlq_n_s32(exponent, 23));
+  }
+  static Type SelectLessEqual(Type x, Type bound, Type if_true, Type otherwise) {
+    return vbslq_f32(vcleq_f32(x, bound), if_true, otherwise);
+  }
+};
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define KUIPER_ACTIVATION_SIMD
+#endif
+
+#ifdef KUIPER_ACTIVATION_SIMD
+using Vector = ActivationVector;
+
+/**
+ * 向量化的exp，先把x分解为n * ln2 + r，其中|r| <= ln2 / 2，再用5阶多项式计算exp(r)并乘以2^n
+ * 多项式的系数来自Cephes，在[-87.3, 88]上的相对误差不超过2e-7，超出这个范围的输入会被截断
+ * @param x 输入
+ * @return exp(x)
+ */
+static inline Vector::Type FastExp(Vector::Type x) {
+  x = Vector::Min(Vector::Max(x, Vector::Set(-87.3f)), Vector::Set(88.f));
+  const Vector::Type n = Vector::Floor(Vector::Add(Vector::Mul(x, Vector::Set(1.44269504088896341f)),
+                                                   Vector::Set(0.5f)));
+  // ln2拆成两部分，减少r的舍入误差
+  x = Vector::Sub(x, Vector::Mul(n, Vector::Set(0.693359375f)));
+  x = Vector::Sub(x, Vector::Mul(n, Vector::Set(-2.12194440e-4f)));
+
+  Vector::Type y = Vector::Set(1.9875691500e-4f);
+  y = Vector::Add(Vector::Mul(y, x), Vector::Set(1.3981999507e-3f));
+  y = Vector::Add(Vector::Mul(y, x), Vector::Set(8.3334519073e-3f));
+  y = Vector::Add(Vector::Mul(y, x), Vector::Set(4.1665795894e-2f));
+  y = Vector::Add(Vector::Mul(y, x), Vector::Set(1.6666665459e-1f));
+  y = Vector::Add(Vector::Mul(y, x), Vector::Set(5.0000001201e-1f));
+  y = Vector::Add(Vector::Mul(y, Vector::Mul(x, x)), Vector::Add(x, Vector::Set(1.f)));
+  return Vector::Mul(y, Vector::Pow2(n));
+}
+
+/**
+ * 用向量指令计算激活函数，剩下不足一个向量的元素由调用者处理
+ * @param activation 激活函数的类型
+ * @param data 数据的起始地址
+ * @param size 数据的元素数量
+ * @return 已经处理的元素数量
+ */
+static uint32_t ApplyActivationVector(ActivationType activation, float *data, uint32_t size) {
+  const uint32_t vector_size = size / Vector::kWidth * Vector::kWidth;
+  const Vector::Type zero = Vector::Set(0.f);
+  const Vector::Type one = Vector::Set(1.f);
+  const Vector::Type three = Vector::Set(3.f);
+  const Vector::Type minus_three = Vector::Set(-3.f);
+  const Vector::Type six = Vector::Set(6.f);
+  const Vector::Type half = Vector::Set(0.5f);
+  switch (activation) {
+    case ActivationType::kActivationNone: {
+      return size;
+    }
+    case ActivationType::kActivationRelu: {
+      for (uint32_t i = 0; i < vector_size; i += Vector::kWidth) {
+        Vector::Store(data + i, Vector::Max(Vector::Load(data + i), zero));
+      }
+      break;
+    }
+    case ActivationType::kActivationSigmoid: {
+      for (uint32_t i = 0; i < vector_size; i += Vector::kWidth) {
+        const Vector::Type x = Vector::Load(data + i);
+        Vector::Store(data + i, Vector::Div(one, Vector::Add(one, FastExp(Vector::Sub(zero, x)))));
+      }
+      break;
+    }
+    case ActivationType::kActivationSiLU: {
+      for (uint32_t i = 0; i < vector_size; i += Vector::kWidth) {
+        const Vector::Type x = Vector::Load(data + i);
+        Vector::Store(data + i, Vector::Div(x, Vector::Add(one, FastExp(Vector::Sub(zero, x)))));
+      }
+      break;
+    }
+    case ActivationType::kActivationHardSwish: {
+      // 中间段和标量的计算顺序相同，两端用比较结果选择，保证和标量的结果一致
+      for (uint32_t i = 0; i < vector_size; i += Vector::kWidth) {
+        const Vector::Type x = Vector::Load(data + i);
+        Vector::Type y = Vector::Div(Vector::Mul(x, Vector::Add(x, three)), six);
+        y = Vector::SelectLessEqual(three, x, x, y);
+        y = Vector::SelectLessEqual(x, minus_three, zero, y);
+        Vector::Store(data + i, y);
+      }
+      break;
+    }
+    case ActivationType::kActivationHardSigmoid: {
+      for (uint32_t i = 0; i < vector_size; i += Vector::kWidth) {
+        const Vector::Type x = Vector::Load(data + i);
+        Vector::Type y = Vector::Add(Vector::Div(x, six), half);
+        y = Vector::SelectLessEqual(three, x, one, y);
+        y = Vector::SelectLessEqual(x, minus_three, zero, y);
+        Vector::Store(data + i, y);
+      }
+      break;
+    }
+  }
+  return vector_size;
+}
+#endif
+
+void ApplyActivationKernel(ActivationType activation, float *data, uint32_t size) {
+  uint32_t begin = 0;
+#ifdef KUIPER_ACTIVATION_SIMD
+  begin = ApplyActivationVector(activation, data, size);
+#endif
+  // 不支持向量指令的平台和剩下不足一个向量的元素，在循环外选择激活函数，使每个循环都足够简单
+  switch (activation) {
+    case ActivationType::kActivationNone: {
+      break;
+    }
+    case ActivationType::kActivationRelu: {
+      for (uint32_t i = begin; i < size; ++i) {
+        data[i] = data[i] > 0.f ? data[i] : 0.f;
+      }
+      break;
+    }
+    case ActivationType::kActivationSigmoid: {
+      for (uint32_t i = begin; i < size; ++i) {
+        data[i] = 1.f / (1.f + ::expf(-data[i]));
+      }
+      break;
+    }
+    case ActivationType::kActivationSiLU: {
+      for (uint32_t i = begin; i < size; ++i) {
+        data[i] = data[i] / (1.f + ::expf(-data[i]));
+      }
+      break;
+    }
+    case ActivationType::kActivationHardSwish: {
+      for (uint32_t i = begin; i < size; ++i) {
+        const float val = data[i];
+        data[i] = val <= -3.f ? 0.f : (val >= 3.f ? val : val * (val + 3) / 6);
+      }
+      break;
+    }
+    case ActivationType::kActivationHardSigmoid: {
+      for (uint32_t i = begin; i < size; ++i) {
+        const float val = data[i];
+        data[i] = val <= -3.f ? 0.f : (val >= 3.f ? 1.f : val / 6.f + 0.5f);
+      }
+      break;
+    }
+  }
+}
+
+/// softmax每次合并的行数，一组数据只更新一次运行中的最大值，重新缩放指数和的exp分摊到整组
+static constexpr uint32_t kSoftmaxBlock = 4;
+
+/**
+ * 在线更新一个标量的最大值和指数和，最大值变大时把之前的指数和缩放到新的最大值
+ * @param x 新的输入
+ * @param max 运行中的最大值
+ * @param sum 运行中的指数和
+ */
+static inline void SoftmaxUpdate(float x, float &max, float &sum) {
+  if (x > max) {
+    sum = sum * ::expf(max - x) + 1.f;
+    max = x;
+  } else {
+    sum += ::expf(x - max);
+  }
+}
+
+/**
+ * 对一段连续的数据计算softmax，读取一遍得到最大值和指数和，再读取一遍写入输出
+ * @param input 输入的起始地址
+ * @param length 元素数量
+ * @param output 输出的起始地址
+ */
+static void SoftmaxContiguous(const float *input, uint32_t length, float *output) {
+  float max = -FLT_MAX;
+  float sum = 0.f;
+  uint32_t i = 0;
+#ifdef KUIPER_ACTIVATION_SIMD
+  const uint32_t block_size = Vector::kWidth * kSoftmaxBlock;
+  if (length >= block_size) {
+    // 每个位置各自维护最大值和指数和，最后按照全局最大值合并
+    Vector::Type vector_max = Vector::Set(-FLT_MAX);
+    Vector::Type vector_sum = Vector::Set(0.f);
+    for (; i + block_size <= length; i += block_size) {
+      Vector::Type x[kSoftmaxBlock];
+      Vector::Type block_max = vector_max;
+      for (uint32_t b = 0; b < kSoftmaxBlock; ++b) {
+        x[b] = Vector::Load(input + i + b * Vector::kWidth);
+        block_max = Vector::Max(block_max, x[b]);
+      }
+      vector_sum = Vector::Mul(vector_sum, FastExp(Vector::Sub(vector_max, block_max)));
+      for (uint32_t b = 0; b < kSoftmaxBlock; ++b) {
+        vector_sum = Vector::Add(vector_sum, FastExp(Vector::Sub(x[b], block_max)));
+      }
+      vector_max = block_max;
+    }
+    float maxs[Vector::kWidth];
+    float sums[Vector::kWidth];
+    Vector::Store(maxs, vector_max);
+    Vector::Store(sums, vector_sum);
+    for (uint32_t k = 0; k < Vector::kWidth; ++k) {
+      max = maxs[k] > max ? maxs[k] : max;
+    }
+    for (uint32_t k = 0; k < Vector::kWidth; ++k) {
+      sum += sums[k] * ::expf(maxs[k] - max);
+    }
+  }
+#endif
+  for (; i < length; ++i) {
+    SoftmaxUpdate(input[i], max, sum);
+  }
+
+  const float scale = 1.f / sum;
+  uint32_t k = 0;
+#ifdef KUIPER_ACTIVATION_SIMD
+  const Vector::Type vector_max = Vector::Set(max);
+  const Vector::Type vector_scale = Vector::Set(scale);
+  for (; k + Vector::kWidth <= length; k += Vector::kWidth) {
+    Vector::Store(output + k, Vector::Mul(FastExp(Vector::Sub(Vector::Load(input + k), vector_max)), vector_scale));
+  }
+#endif
+  for (; k < length; ++k) {
+    output[k] = ::expf(input[k] - max) * scale;
+  }
+}
+
+/**
+ * 对相邻的多列分别计算softmax，同一行相邻列的数据连续，一个向量同时计算kWidth列
+ * @param input 第一列第一个元素的地址
+ * @param length 每列的元素数量
+ * @param stride 同一列相邻元素之间的距离
+ * @param inner 列的数量
+ * @param output 输出中第一列第一个元素的地址
+ */
+static void SoftmaxColumns(const float *input, uint32_t length, uint32_t stride, uint32_t inner, float *output) {
+  uint32_t j = 0;
+#ifdef KUIPER_ACTIVATION_SIMD
+  for (; j + Vector::kWidth <= inner; j += Vector::kWidth) {
+    Vector::Type max = Vector::Set(-FLT_MAX);
+    Vector::Type sum = Vector::Set(0.f);
+    uint32_t l = 0;
+    for (; l + kSoftmaxBlock <= length; l += kSoftmaxBlock) {
+      Vector::Type x[kSoftmaxBlock];
+      Vector::Type block_max = max;
+      for (uint32_t b = 0; b < kSoftmaxBlock; ++b) {
+        x[b] = Vector::Load(input + size_t(l + b) * stride + j);
+        block_max = Vector::Max(block_max, x[b]);
+      }
+      sum = Vector::Mul(sum, FastExp(Vector::Sub(max, block_max)));
+      for (uint32_t b = 0; b < kSoftmaxBlock; ++b) {
+        sum = Vector::Add(sum, FastExp(Vector::Sub(x[b], block_max)));
+      }
+      max = block_max;
+    }
+    for (; l < length; ++l) {
+      const Vector::Type x = Vector::Load(input + size_t(l) * stride + j);
+      const Vector::Type new_max = Vector::Max(max, x);
+      sum = Vector::Add(Vector::Mul(sum, FastExp(Vector::Sub(max, new_max))), FastExp(Vector::Sub(x, new_max)));
+      max = new_max;
+    }
+
+    const Vector::Type scale = Vector::Div(Vector::Set(1.f), sum);
+    for (l = 0; l < length; ++l) {
+      const size_t offset = size_t(l) * stride + j;
+      Vector::Store(output + offset, Vector::Mul(FastExp(Vector::Sub(Vector::Load(input + offset), max)), scale));
+    }
+  }
+#endif
+  for (; j < inner; ++j) {
+    float max = -FLT_MAX;
+    float sum = 0.f;
+    for (uint32_t l = 0; l < length; ++l) {
+      SoftmaxUpdate(input[size_t(l) * stride + j], max, sum);
+    }
+    const float scale = 1.f / sum;
+    for (uint32_t l = 0; l < length; ++l) {
+      const size_t offset = size_t(l) * stride + j;
+      output[offset] = ::expf(input[offset] - max) * scale;
+    }
+  }
+}
+
+void SoftmaxKernel(const float *input, uint32_t length, uint32_t stride, uint32_t inner, float *output) {
+  if (length == 0 || inner == 0) {
+    return;
+  }
+  if (inner == 1 && stride == 1) {
+    SoftmaxContiguous(input, length, output);
+  } else {
+    SoftmaxColumns(input, length, stride, inner, output);
+  }
+}
+}
+}
@@ -0,0 +1,42 @@
+#include "cpu_kernels.hpp"
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+// 级别由这个文件编译时的指令集决定，基础级别使用编译器默认的指令集，可能是-march打开的任何一级
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && defined(__AVX512VL__)
+constexpr CpuIsa kCompiledIsa = CpuIsa::kAVX512;
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+constexpr CpuIsa kCompiledIsa = CpuIsa::kAVX2;
+#elif defined(__SSE4_2__) && defined(__POPCNT__)
+constexpr CpuIsa kCompiledIsa = CpuIsa::kSSE42;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+constexpr CpuIsa kCompiledIsa = CpuIsa::kNEON;
+#else
+constexpr CpuIsa kCompiledIsa = CpuIsa::kScalar;
+#endif
+
+extern const CpuKernels kCpuKernels = {
+    kCompiledIsa,
+    GemmPanelRows,
+    GemmPanelCols,
+    GemmWorkspaceSize,
+    GemmKernel,
+    GemmPackKernel,
+    GemmEpilogueKernel,
+    ApplyActivationKernel,
+    ElementBinaryKernel,
+    ScaleShiftKernel,
+    Int8DotRowsKernel,
+    HalfToFloatKernel,
+    FloatToHalfKernel,
+    BFloat16ToFloatKernel,
+    FloatToBFloat16Kernel,
+    HalfPanelKernel,
+    QuantPanelKernel,
+    ImageResizeRowKernel,
+    LinearCombineKernel,
+    SoftmaxKernel,
+    SparseGemmKernel,
+};
+}
+}
@@ -0,0 +1,170 @@
+#ifndef KUIPER_INFER_SOURCE_KERNELS_CPU_KERNELS_HPP_
+#define KUIPER_INFER_SOURCE_KERNELS_CPU_KERNELS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include "data/gemm.hpp"
+#include "runtime/cpu_feature.hpp"
+
+// 这个目录下的源文件按照每个指令集级别各编译一次，KUIPER_ISA_NAMESPACE区分不同级别的符号。
+// 这些源文件中不能实例化标准库、glog和armadillo的模板，链接时同名的弱符号只保留一份，
+// 可能选中用更高级别指令编译的版本，在不支持的处理器上出错
+#ifndef KUIPER_ISA_NAMESPACE
+#define KUIPER_ISA_NAMESPACE isa_baseline
+#endif
+
+namespace kuiper_infer {
+/// 逐元素计算的二元运算
+enum class ElementOperation {
+  kAdd = 0,
+  kMultiply = 1,
+};
+
+/// 内核中矩阵乘法的一个操作数
+struct GemmKernelOperand {
+  const float *data = nullptr; /// 没有打包时矩阵的起始地址
+  uint32_t ld = 0; /// 矩阵相邻两列之间的距离
+  bool transpose = false; /// 是否转置
+  const float *packed = nullptr; /// 预先打包的面板，为空时每次计算时打包
+  uint32_t packed_size = 0; /// 打包时补齐到面板宽度之后的行数或者列数
+  uint32_t offset = 0; /// 从打包矩阵中的哪一行或者哪一列开始计算
+};
+
+/// 一个指令集级别的所有内核
+struct CpuKernels {
+  CpuIsa isa;
+  uint32_t (*gemm_panel_rows)(); /// 打包的左矩阵每个面板的行数
+  uint32_t (*gemm_panel_cols)(); /// 打包的右矩阵每个面板的列数
+
+  /// 矩阵乘法每次打包a和b需要的float数量
+  size_t (*gemm_workspace_size)(uint32_t m, uint32_t n, uint32_t k);
+
+  /// c = act(alpha * op(a) * op(b) + beta * c + bias)，workspace用于打包没有预先打包的操作数
+  void (*gemm)(const GemmKernelOperand &a, const GemmKernelOperand &b, uint32_t m, uint32_t n, uint32_t k,
+               float alpha, float beta, float *c, uint32_t ldc, const GemmEpilogue &epilogue, float *workspace);
+
+  /// 将整个矩阵打包为面板，left为true时size是op(a)的行数，否则是op(b)的列数
+  void (*gemm_pack)(bool left, bool transpose, uint32_t size, uint32_t depth, const float *matrix, uint32_t ld,
+                    float *packed);
+
+  /// 对整个c计算偏置和激活函数
+  void (*gemm_epilogue)(const GemmEpilogue &epilogue, uint32_t m, uint32_t n, float *c, uint32_t ldc);
+
+  /// 对一段连续的数据原地计算激活函数
+  void (*apply_activation)(ActivationType activation, float *data, uint32_t size);
+
+  /// 逐元素计算output = x op y，x_broadcast或者y_broadcast为true时对应的输入只有一个值
+  void (*element_binary)(ElementOperation operation, const float *x, bool x_broadcast, const float *y,
+                         bool y_broadcast, uint32_t size, float *output);
+
+  /// 逐元素计算output = input * scale + shift，input和output可以是同一块内存
+  void (*scale_shift)(const float *input, uint32_t size, float scale, float shift, float *output);
+
+  /// 计算连续的row_num行量化权重与量化向量的点积
+  void (*int8_dot_rows)(const int8_t *rows, uint32_t stride, uint32_t row_num, const int8_t *vector,
+                        const int32_t *row_sums, int32_t *output);
+
+  /// 半精度、bfloat16和float之间的批量转换
+  void (*half_to_float)(const uint16_t *input, uint32_t size, float *output);
+  void (*float_to_half)(const float *input, uint32_t size, uint16_t *output);
+  void (*bfloat16_to_float)(const uint16_t *input, uint32_t size, float *output);
+  void (*float_to_bfloat16)(const float *input, uint32_t size, uint16_t *output);
+
+  /// 计算全连接层一个半精度权重面板的输出，面板中同一个输入特征的panel_rows个权重连续排列
+  void (*half_panel)(bool bfloat16, const uint16_t *panel, uint32_t panel_rows, uint32_t in_features,
+                     const float *input, uint32_t input_ld, uint32_t cols, uint32_t row_num, float *output,
+                     uint32_t output_ld);
+
+  /// 计算全连接层一个分组量化权重面板的输出，bits为8或者4，权重在寄存器中反量化，每组的部分和乘以系数之后累加
+  void (*quant_panel)(uint32_t bits, const uint8_t *panel, const float *scales, uint32_t panel_rows,
+                      uint32_t group_size, uint32_t in_features, const float *input, uint32_t input_ld,
+                      uint32_t cols, uint32_t row_num, float *output, uint32_t output_ld);
+
+  /// 对一行8位像素的一个通道做水平线性插值，output[x] = row[offsets0[x]] * (1 - weights[x]) + row[offsets1[x]] * weights[x]
+  /// row_size是从row开始可以读取的字节数，偏移量按照x递增
+  void (*image_resize_row)(const uint8_t *row, uint32_t row_size, const uint32_t *offsets0, const uint32_t *offsets1,
+                           const float *weights, uint32_t width, float *output);
+
+  /// 逐元素计算output = x * x_scale + y * y_scale + shift
+  void (*linear_combine)(const float *x, float x_scale, const float *y, float y_scale, float shift, uint32_t size,
+                         float *output);
+
+  /// 对inner个相邻的列分别计算softmax，每列length个元素，同一列相邻元素相距stride，input和output可以是同一块内存
+  void (*softmax)(const float *input, uint32_t length, uint32_t stride, uint32_t inner, float *output);
+
+  /// c = act(a * b + bias)，b是按列压缩的稀疏矩阵，col_offsets指向计算的第一列，共n + 1个
+  void (*sparse_gemm)(const float *a, uint32_t lda, uint32_t m, const uint32_t *col_offsets,
+                      const uint32_t *row_indices, const float *values, uint32_t n, float *c, uint32_t ldc,
+                      const GemmEpilogue &epilogue);
+};
+
+namespace KUIPER_ISA_NAMESPACE {
+uint32_t GemmPanelRows();
+
+uint32_t GemmPanelCols();
+
+size_t GemmWorkspaceSize(uint32_t m, uint32_t n, uint32_t k);
+
+void GemmKernel(const GemmKernelOperand &a, const GemmKernelOperand &b, uint32_t m, uint32_t n, uint32_t k,
+                float alpha, float beta, float *c, uint32_t ldc, const GemmEpilogue &epilogue, float *workspace);
+
+void GemmPackKernel(bool left, bool transpose, uint32_t size, uint32_t depth, const float *matrix, uint32_t ld,
+                    float *packed);
+
+void GemmEpilogueKernel(const GemmEpilogue &epilogue, uint32_t m, uint32_t n, float *c, uint32_t ldc);
+
+void ApplyActivationKernel(ActivationType activation, float *data, uint32_t size);
+
+void ElementBinaryKernel(ElementOperation operation, const float *x, bool x_broadcast, const float *y,
+                         bool y_broadcast, uint32_t size, float *output);
+
+void ScaleShiftKernel(const float *input, uint32_t size, float scale, float shift, float *output);
+
+void Int8DotRowsKernel(const int8_t *rows, uint32_t stride, uint32_t row_num, const int8_t *vector,
+                       const int32_t *row_sums, int32_t *output);
+
+void HalfToFloatKernel(const uint16_t *input, uint32_t size, float *output);
+
+void FloatToHalfKernel(const float *input, uint32_t size, uint16_t *output);
+
+void BFloat16ToFloatKernel(const uint16_t *input, uint32_t size, float *output);
+
+void FloatToBFloat16Kernel(const float *input, uint32_t size, uint16_t *output);
+
+void HalfPanelKernel(bool bfloat16, const uint16_t *panel, uint32_t panel_rows, uint32_t in_features,
+                     const float *input, uint32_t input_ld, uint32_t cols, uint32_t row_num, float *output,
+                     uint32_t output_ld);
+
+void QuantPanelKernel(uint32_t bits, const uint8_t *panel, const float *scales, uint32_t panel_rows,
+                      uint32_t group_size, uint32_t in_features, const float *input, uint32_t input_ld,
+                      uint32_t cols, uint32_t row_num, float *output, uint32_t output_ld);
+
+void ImageResizeRowKernel(const uint8_t *row, uint32_t row_size, const uint32_t *offsets0, const uint32_t *offsets1,
+                          const float *weights, uint32_t width, float *output);
+
+void LinearCombineKernel(const float *x, float x_scale, const float *y, float y_scale, float shift, uint32_t size,
+                         float *output);
+
+void SoftmaxKernel(const float *input, uint32_t length, uint32_t stride, uint32_t inner, float *output);
+
+void SparseGemmKernel(const float *a, uint32_t lda, uint32_t m, const uint32_t *col_offsets,
+                      const uint32_t *row_indices, const float *values, uint32_t n, float *c, uint32_t ldc,
+                      const GemmEpilogue &epilogue);
+
+/// 这个级别的内核表，在cpu_kernels.cpp中定义
+extern const CpuKernels kCpuKernels;
+}
+
+/**
+ * 返回当前选择的级别的内核
+ * @return 内核表
+ */
+const CpuKernels &CurrentCpuKernels();
+
+/**
+ * 返回某个级别的内核，这个级别必须已经编译，例如打包矩阵时使用的级别
+ * @param isa 指令集级别
+ * @return 内核表
+ */
+const CpuKernels &CpuKernelsOf(CpuIsa isa);
+}
+#endif //KUIPER_INFER_SOURCE_KERNELS_CPU_KERNELS_HPP_
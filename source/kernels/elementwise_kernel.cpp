@@ -0,0 +1,173 @@
+#include "cpu_kernels.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+#if defined(__AVX512F__)
+/// 逐元素计算的向量，AVX-512一次处理16个float
+struct ElementVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm512_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm512_add_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm512_mul_ps(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+};
+#elif defined(__AVX2__)
+/// 逐元素计算的向量，AVX2一次处理8个float
+struct ElementVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm256_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm256_add_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm256_mul_ps(x, y); }
+#if defined(__FMA__)
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+#else
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_add_ps(_mm256_mul_ps(x, y), z); }
+#endif
+};
+#elif defined(__SSE4_2__)
+/// 逐元素计算的向量，SSE一次处理4个float
+struct ElementVector {
+  using Type = __m128;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return _mm_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm_set1_ps(value); }
+  static Type Add(Type x, Type y) { return _mm_add_ps(x, y); }
+  static Type Mul(Type x, Type y) { return _mm_mul_ps(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm_add_ps(_mm_mul_ps(x, y), z); }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// 逐元素计算的向量，NEON一次处理4个float
+struct ElementVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type Set1(float value) { return vdupq_n_f32(value); }
+  static Type Add(Type x, Type y) { return vaddq_f32(x, y); }
+  static Type Mul(Type x, Type y) { return vmulq_f32(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return vfmaq_f32(z, x, y); }
+};
+#else
+/// 没有向量指令时逐个计算
+struct ElementVector {
+  using Type = float;
+  static constexpr uint32_t kWidth = 1;
+  static Type Load(const float *ptr) { return *ptr; }
+  static void Store(float *ptr, Type x) { *ptr = x; }
+  static Type Set1(float value) { return value; }
+  static Type Add(Type x, Type y) { return x + y; }
+  static Type Mul(Type x, Type y) { return x * y; }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return x * y + z; }
+};
+#endif
+
+template<ElementOperation operation>
+static inline ElementVector::Type Compute(ElementVector::Type x, ElementVector::Type y) {
+  return operation == ElementOperation::kAdd ? ElementVector::Add(x, y) : ElementVector::Mul(x, y);
+}
+
+template<ElementOperation operation>
+static inline float ComputeScalar(float x, float y) {
+  return operation == ElementOperation::kAdd ? x + y : x * y;
+}
+
+/**
+ * 逐元素计算，广播的输入在循环外展开为向量，每个组合单独实例化，循环中没有分支
+ * @tparam operation 二元运算
+ * @tparam x_broadcast x是否只有一个值
+ * @tparam y_broadcast y是否只有一个值
+ */
+template<ElementOperation operation, bool x_broadcast, bool y_broadcast>
+static void ElementBinary(const float *x, const float *y, uint32_t size, float *output) {
+  using Type = typename ElementVector::Type;
+  constexpr uint32_t kWidth = ElementVector::kWidth;
+  const Type x_value = ElementVector::Set1(x[0]);
+  const Type y_value = ElementVector::Set1(y[0]);
+  uint32_t i = 0;
+  for (; i + 4 * kWidth <= size; i += 4 * kWidth) {
+    for (uint32_t v = 0; v < 4; ++v) {
+      const Type x_vector = x_broadcast ? x_value : ElementVector::Load(x + i + v * kWidth);
+      const Type y_vector = y_broadcast ? y_value : ElementVector::Load(y + i + v * kWidth);
+      ElementVector::Store(output + i + v * kWidth, Compute<operation>(x_vector, y_vector));
+    }
+  }
+  for (; i < size; ++i) {
+    output[i] = ComputeScalar<operation>(x_broadcast ? x[0] : x[i], y_broadcast ? y[0] : y[i]);
+  }
+}
+
+template<ElementOperation operation>
+static void ElementBinary(const float *x, bool x_broadcast, const float *y, bool y_broadcast, uint32_t size,
+                          float *output) {
+  if (x_broadcast && y_broadcast) {
+    ElementBinary<operation, true, true>(x, y, size, output);
+  } else if (x_broadcast) {
+    ElementBinary<operation, true, false>(x, y, size, output);
+  } else if (y_broadcast) {
+    ElementBinary<operation, false, true>(x, y, size, output);
+  } else {
+    ElementBinary<operation, false, false>(x, y, size, output);
+  }
+}
+
+void ElementBinaryKernel(ElementOperation operation, const float *x, bool x_broadcast, const float *y,
+                         bool y_broadcast, uint32_t size, float *output) {
+  if (operation == ElementOperation::kAdd) {
+    ElementBinary<ElementOperation::kAdd>(x, x_broadcast, y, y_broadcast, size, output);
+  } else {
+    ElementBinary<ElementOperation::kMultiply>(x, x_broadcast, y, y_broadcast, size, output);
+  }
+}
+
+void ScaleShiftKernel(const float *input, uint32_t size, float scale, float shift, float *output) {
+  using Type = typename ElementVector::Type;
+  constexpr uint32_t kWidth = ElementVector::kWidth;
+  const Type scale_vector = ElementVector::Set1(scale);
+  const Type shift_vector = ElementVector::Set1(shift);
+  uint32_t i = 0;
+  for (; i + 4 * kWidth <= size; i += 4 * kWidth) {
+    for (uint32_t v = 0; v < 4; ++v) {
+      const Type value = ElementVector::Load(input + i + v * kWidth);
+      ElementVector::Store(output + i + v * kWidth, ElementVector::MultiplyAdd(value, scale_vector, shift_vector));
+    }
+  }
+  for (; i < size; ++i) {
+    output[i] = input[i] * scale + shift;
+  }
+}
+
+void LinearCombineKernel(const float *x, float x_scale, const float *y, float y_scale, float shift, uint32_t size,
+                         float *output) {
+  using Type = typename ElementVector::Type;
+  constexpr uint32_t kWidth = ElementVector::kWidth;
+  const Type x_scale_vector = ElementVector::Set1(x_scale);
+  const Type y_scale_vector = ElementVector::Set1(y_scale);
+  const Type shift_vector = ElementVector::Set1(shift);
+  uint32_t i = 0;
+  for (; i + 4 * kWidth <= size; i += 4 * kWidth) {
+    for (uint32_t v = 0; v < 4; ++v) {
+      const Type y_value = ElementVector::MultiplyAdd(ElementVector::Load(y + i + v * kWidth), y_scale_vector,
+                                                      shift_vector);
+      ElementVector::Store(output + i + v * kWidth,
+                           ElementVector::MultiplyAdd(ElementVector::Load(x + i + v * kWidth), x_scale_vector,
+                                                      y_value));
+    }
+  }
+  for (; i < size; ++i) {
+    output[i] = x[i] * x_scale + y[i] * y_scale + shift;
+  }
+}
+}
+}
@@ -0,0 +1,430 @@
+#include "cpu_kernels.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+#if defined(__AVX512F__)
+/// 内置矩阵乘法的寄存器分块，AVX-512每次计算32行8列
+struct GemmVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static constexpr uint32_t kRows = 32;
+  static constexpr uint32_t kCols = 8;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm512_set1_ps(value); }
+  static Type Zero() { return _mm512_setzero_ps(); }
+  static Type Add(Type x, Type y) { return _mm512_add_ps(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+};
+#elif defined(__AVX2__)
+/// 内置矩阵乘法的寄存器分块，AVX2每次计算16行6列
+struct GemmVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static constexpr uint32_t kRows = 16;
+  static constexpr uint32_t kCols = 6;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm256_set1_ps(value); }
+  static Type Zero() { return _mm256_setzero_ps(); }
+  static Type Add(Type x, Type y) { return _mm256_add_ps(x, y); }
+#if defined(__FMA__)
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+#else
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_add_ps(_mm256_mul_ps(x, y), z); }
+#endif
+};
+#elif defined(__SSE4_2__)
+/// 内置矩阵乘法的寄存器分块，SSE每次计算8行6列，16个寄存器中12个用于累加
+struct GemmVector {
+  using Type = __m128;
+  static constexpr uint32_t kWidth = 4;
+  static constexpr uint32_t kRows = 8;
+  static constexpr uint32_t kCols = 6;
+  static Type Load(const float *ptr) { return _mm_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm_set1_ps(value); }
+  static Type Zero() { return _mm_setzero_ps(); }
+  static Type Add(Type x, Type y) { return _mm_add_ps(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm_add_ps(_mm_mul_ps(x, y), z); }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// 内置矩阵乘法的寄存器分块，NEON每次计算8行8列
+struct GemmVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static constexpr uint32_t kRows = 8;
+  static constexpr uint32_t kCols = 8;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type Set1(float value) { return vdupq_n_f32(value); }
+  static Type Zero() { return vdupq_n_f32(0.f); }
+  static Type Add(Type x, Type y) { return vaddq_f32(x, y); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return vfmaq_f32(z, x, y); }
+};
+#else
+/// 没有向量指令时每次计算4行4列
+struct GemmVector {
+  using Type = float;
+  static constexpr uint32_t kWidth = 1;
+  static constexpr uint32_t kRows = 4;
+  static constexpr uint32_t kCols = 4;
+  static Type Load(const float *ptr) { return *ptr; }
+  static void Store(float *ptr, Type x) { *ptr = x; }
+  static Type Set1(float value) { return value; }
+  static Type Zero() { return 0.f; }
+  static Type Add(Type x, Type y) { return x + y; }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return x * y + z; }
+};
+#endif
+
+constexpr uint32_t kGemmBlockK = 256; /// 每次打包的公共维度长度
+constexpr uint32_t kGemmBlockM = 256; /// 每次打包的a的行数，打包之后留在二级缓存中
+constexpr uint32_t kGemmBlockN = 1024 / GemmVector::kCols * GemmVector::kCols; /// 每次打包的b的列数，是面板宽度的倍数
+constexpr uint32_t kGemmVectors = GemmVector::kRows / GemmVector::kWidth; /// 一个面板的一列需要的向量数量
+
+// 不使用std::min，避免实例化的模板和其他级别的同名弱符号合并
+static inline uint32_t Min(uint32_t x, uint32_t y) {
+  return x < y ? x : y;
+}
+
+static uint32_t PaddedSize(uint32_t size, uint32_t panel) {
+  return (size + panel - 1) / panel * panel;
+}
+
+static bool HasEpilogue(const GemmEpilogue &epilogue) {
+  return epilogue.row_bias != nullptr || epilogue.col_bias != nullptr || epilogue.residual != nullptr ||
+      epilogue.activation != ActivationType::kActivationNone;
+}
+
+void GemmEpilogueKernel(const GemmEpilogue &epilogue, uint32_t m, uint32_t n, float *c, uint32_t ldc) {
+  if (!HasEpilogue(epilogue)) {
+    return;
+  }
+  for (uint32_t j = 0; j < n; ++j) {
+    float *c_ptr = c + size_t(j) * ldc;
+    const float col_bias = epilogue.col_bias != nullptr ? epilogue.col_bias[j] : 0.f;
+    if (epilogue.row_bias != nullptr) {
+      for (uint32_t i = 0; i < m; ++i) {
+        c_ptr[i] += epilogue.row_bias[i] + col_bias;
+      }
+    } else if (col_bias != 0.f) {
+      for (uint32_t i = 0; i < m; ++i) {
+        c_ptr[i] += col_bias;
+      }
+    }
+    if (epilogue.residual != nullptr) {
+      const float *residual_ptr = epilogue.residual + size_t(j) * epilogue.ldr;
+      for (uint32_t i = 0; i < m; ++i) {
+        c_ptr[i] += residual_ptr[i];
+      }
+    }
+    if (epilogue.activation != ActivationType::kActivationNone) {
+      ApplyActivationKernel(epilogue.activation, c_ptr, m);
+    }
+  }
+}
+
+/**
+ * 将op(a)中的一块打包为若干个kRows行的面板，面板中同一列的kRows个元素连续排列，不足的行补0
+ */
+static void PackA(bool transpose, const float *a, uint32_t lda, uint32_t row_begin, uint32_t rows,
+                  uint32_t depth_begin, uint32_t depth, float *packed) {
+  constexpr uint32_t kRows = GemmVector::kRows;
+  for (uint32_t panel = 0; panel < rows; panel += kRows) {
+    const uint32_t panel_rows = Min(kRows, rows - panel);
+    float *panel_ptr = packed + size_t(panel) * depth;
+    for (uint32_t p = 0; p < depth; ++p) {
+      float *dst = panel_ptr + size_t(p) * kRows;
+      const uint32_t col = depth_begin + p;
+      for (uint32_t r = 0; r < panel_rows; ++r) {
+        const uint32_t row = row_begin + panel + r;
+        dst[r] = transpose ? a[col + size_t(row) * lda] : a[row + size_t(col) * lda];
+      }
+      for (uint32_t r = panel_rows; r < kRows; ++r) {
+        dst[r] = 0.f;
+      }
+    }
+  }
+}
+
+/**
+ * 将op(b)中的一块打包为若干个kCols列的面板，面板中同一行的kCols个元素连续排列，不足的列补0
+ */
+static void PackB(bool transpose, const float *b, uint32_t ldb, uint32_t depth_begin, uint32_t depth,
+                  uint32_t col_begin, uint32_t cols, float *packed) {
+  constexpr uint32_t kCols = GemmVector::kCols;
+  for (uint32_t panel = 0; panel < cols; panel += kCols) {
+    const uint32_t panel_cols = Min(kCols, cols - panel);
+    float *panel_ptr = packed + size_t(panel) * depth;
+    for (uint32_t p = 0; p < depth; ++p) {
+      float *dst = panel_ptr + size_t(p) * kCols;
+      const uint32_t row = depth_begin + p;
+      for (uint32_t j = 0; j < panel_cols; ++j) {
+        const uint32_t col = col_begin + panel + j;
+        dst[j] = transpose ? b[col + size_t(row) * ldb] : b[row + size_t(col) * ldb];
+      }
+      for (uint32_t j = panel_cols; j < kCols; ++j) {
+        dst[j] = 0.f;
+      }
+    }
+  }
+}
+
+void GemmPackKernel(bool left, bool transpose, uint32_t size, uint32_t depth, const float *matrix, uint32_t ld,
+                    float *packed) {
+  const uint32_t padded = PaddedSize(size, left ? GemmVector::kRows : GemmVector::kCols);
+  for (uint32_t depth_begin = 0; depth_begin < depth; depth_begin += kGemmBlockK) {
+    const uint32_t block_depth = Min(kGemmBlockK, depth - depth_begin);
+    float *block = packed + size_t(depth_begin) * padded;
+    if (left) {
+      PackA(transpose, matrix, ld, 0, size, depth_begin, block_depth, block);
+    } else {
+      PackB(transpose, matrix, ld, depth_begin, block_depth, 0, size, block);
+    }
+  }
+}
+
+/**
+ * 返回打包矩阵中一个公共维度分块里从index行或列开始的面板
+ */
+static const float *PackedPanels(const GemmKernelOperand &operand, uint32_t depth_begin, uint32_t depth,
+                                 uint32_t index) {
+  return operand.packed + size_t(depth_begin) * operand.packed_size + size_t(index) * depth;
+}
+
+/**
+ * 计算一个块，累加的结果在寄存器中，最后乘以alpha写回c
+ * @tparam vectors 块的行数需要的向量数量，矩阵较小时不计算补0的行
+ * @tparam cols 块的列数，矩阵较窄时不计算补0的列
+ * @param accumulate 是否加到c原有的值上，否则直接覆盖
+ * @param epilogue 最后一个公共维度分块的尾部计算，偏置已经偏移到这个块的起点，不需要时为空
+ */
+template<uint32_t vectors, uint32_t cols>
+static void MicroKernel(uint32_t depth, const float *packed_a, const float *packed_b, float alpha, float *c,
+                        uint32_t ldc, uint32_t rows, bool accumulate, const GemmEpilogue *epilogue) {
+  using Type = typename GemmVector::Type;
+  constexpr uint32_t kWidth = GemmVector::kWidth;
+  Type sums[cols][vectors];
+  for (uint32_t j = 0; j < cols; ++j) {
+    for (uint32_t v = 0; v < vectors; ++v) {
+      sums[j][v] = GemmVector::Zero();
+    }
+  }
+  for (uint32_t p = 0; p < depth; ++p) {
+    Type values[vectors];
+    for (uint32_t v = 0; v < vectors; ++v) {
+      values[v] = GemmVector::Load(packed_a + v * kWidth);
+    }
+    for (uint32_t j = 0; j < cols; ++j) {
+      const Type b = GemmVector::Set1(packed_b[j]);
+      for (uint32_t v = 0; v < vectors; ++v) {
+        sums[j][v] = GemmVector::MultiplyAdd(values[v], b, sums[j][v]);
+      }
+    }
+    packed_a += GemmVector::kRows;
+    packed_b += GemmVector::kCols;
+  }
+
+  const float *row_bias = epilogue != nullptr ? epilogue->row_bias : nullptr;
+  const float *residual = epilogue != nullptr ? epilogue->residual : nullptr;
+  for (uint32_t j = 0; j < cols; ++j) {
+    float *c_ptr = c + size_t(j) * ldc;
+    const float *residual_ptr = residual != nullptr ? residual + size_t(j) * epilogue->ldr : nullptr;
+    const float col_bias = epilogue != nullptr && epilogue->col_bias != nullptr ? epilogue->col_bias[j] : 0.f;
+    if (rows == vectors * kWidth) {
+      const Type alpha_vector = GemmVector::Set1(alpha);
+      const Type col_bias_vector = GemmVector::Set1(col_bias);
+      for (uint32_t v = 0; v < vectors; ++v) {
+        Type value = accumulate ? GemmVector::Load(c_ptr + v * kWidth) : GemmVector::Zero();
+        value = GemmVector::MultiplyAdd(sums[j][v], alpha_vector, value);
+        if (epilogue != nullptr) {
+          value = GemmVector::Add(value, col_bias_vector);
+          if (row_bias != nullptr) {
+            value = GemmVector::Add(value, GemmVector::Load(row_bias + v * kWidth));
+          }
+          if (residual_ptr != nullptr) {
+            value = GemmVector::Add(value, GemmVector::Load(residual_ptr + v * kWidth));
+          }
+        }
+        GemmVector::Store(c_ptr + v * kWidth, value);
+      }
+    } else {
+      float tile[vectors * kWidth];
+      for (uint32_t v = 0; v < vectors; ++v) {
+        GemmVector::Store(tile + v * kWidth, sums[j][v]);
+      }
+      for (uint32_t r = 0; r < rows; ++r) {
+        float value = (accumulate ? c_ptr[r] : 0.f) + alpha * tile[r] + col_bias;
+        if (row_bias != nullptr) {
+          value += row_bias[r];
+        }
+        c_ptr[r] = residual_ptr != nullptr ? value + residual_ptr[r] : value;
+      }
+    }
+    if (epilogue != nullptr && epilogue->activation != ActivationType::kActivationNone) {
+      ApplyActivationKernel(epilogue->activation, c_ptr, rows);
+    }
+  }
+}
+
+using MicroKernelFunc = void (*)(uint32_t, const float *, const float *, float, float *, uint32_t, uint32_t, bool,
+                                 const GemmEpilogue *);
+
+template<uint32_t vectors, uint32_t cols>
+static void FillMicroKernels(MicroKernelFunc (&kernels)[kGemmVectors][GemmVector::kCols]) {
+  kernels[vectors - 1][cols - 1] = MicroKernel<vectors, cols>;
+  if constexpr (cols > 1) {
+    FillMicroKernels<vectors, cols - 1>(kernels);
+  } else if constexpr (vectors > 1) {
+    FillMicroKernels<vectors - 1, GemmVector::kCols>(kernels);
+  }
+}
+
+/// 按照块的向量数量和列数选择的微内核
+struct MicroKernelTable {
+  MicroKernelFunc kernels[kGemmVectors][GemmVector::kCols];
+  MicroKernelTable() { FillMicroKernels<kGemmVectors, GemmVector::kCols>(kernels); }
+};
+static const MicroKernelTable micro_kernels;
+
+/**
+ * 只有一列时退化为矩阵向量乘法，按列直接读取a，不需要打包，读取a的次数和打包之后相同
+ */
+static void BuiltinGemv(const GemmKernelOperand &a, const GemmKernelOperand &b, uint32_t m, uint32_t k,
+                        float alpha, bool accumulate, float *c, const GemmEpilogue &epilogue, float *workspace) {
+  using Type = typename GemmVector::Type;
+  constexpr uint32_t kWidth = GemmVector::kWidth;
+  const float *x = b.data;
+  if (b.transpose && k > 1) {
+    for (uint32_t p = 0; p < k; ++p) {
+      workspace[p] = b.data[size_t(p) * b.ld];
+    }
+    x = workspace;
+  }
+
+  uint32_t row = 0;
+  for (; row + GemmVector::kRows <= m; row += GemmVector::kRows) {
+    Type sums[kGemmVectors];
+    for (uint32_t v = 0; v < kGemmVectors; ++v) {
+      sums[v] = GemmVector::Zero();
+    }
+    for (uint32_t p = 0; p < k; ++p) {
+      const Type value = GemmVector::Set1(x[p]);
+      const float *a_ptr = a.data + row + size_t(p) * a.ld;
+      for (uint32_t v = 0; v < kGemmVectors; ++v) {
+        sums[v] = GemmVector::MultiplyAdd(GemmVector::Load(a_ptr + v * kWidth), value, sums[v]);
+      }
+    }
+    float tile[GemmVector::kRows];
+    for (uint32_t v = 0; v < kGemmVectors; ++v) {
+      GemmVector::Store(tile + v * kWidth, sums[v]);
+    }
+    for (uint32_t r = 0; r < GemmVector::kRows; ++r) {
+      c[row + r] = (accumulate ? c[row + r] : 0.f) + alpha * tile[r];
+    }
+  }
+  for (; row < m; ++row) {
+    float sum = 0.f;
+    for (uint32_t p = 0; p < k; ++p) {
+      sum += a.data[row + size_t(p) * a.ld] * x[p];
+    }
+    c[row] = (accumulate ? c[row] : 0.f) + alpha * sum;
+  }
+  GemmEpilogueKernel(epilogue, m, 1, c, m);
+}
+
+size_t GemmWorkspaceSize(uint32_t m, uint32_t n, uint32_t k) {
+  const uint32_t block_k = Min(k, kGemmBlockK);
+  const size_t packed_a = size_t(PaddedSize(Min(m, kGemmBlockM), GemmVector::kRows)) * block_k;
+  const size_t packed_b = size_t(PaddedSize(Min(n, kGemmBlockN), GemmVector::kCols)) * block_k;
+  // 矩阵向量乘法时用于收集转置的b
+  return packed_a + packed_b > k ? packed_a + packed_b : k;
+}
+
+void GemmKernel(const GemmKernelOperand &a, const GemmKernelOperand &b, uint32_t m, uint32_t n, uint32_t k,
+                float alpha, float beta, float *c, uint32_t ldc, const GemmEpilogue &epilogue, float *workspace) {
+  if (k == 0 || alpha == 0.f || beta != 0.f) {
+    for (uint32_t j = 0; j < n; ++j) {
+      float *c_ptr = c + size_t(j) * ldc;
+      for (uint32_t i = 0; i < m; ++i) {
+        c_ptr[i] = beta == 0.f ? 0.f : c_ptr[i] * beta;
+      }
+    }
+  }
+  if (k == 0 || alpha == 0.f) {
+    GemmEpilogueKernel(epilogue, m, n, c, ldc);
+    return;
+  }
+  if (n == 1 && a.packed == nullptr && !a.transpose) {
+    BuiltinGemv(a, b, m, k, alpha, beta != 0.f, c, epilogue, workspace);
+    return;
+  }
+
+  constexpr uint32_t kRows = GemmVector::kRows;
+  constexpr uint32_t kCols = GemmVector::kCols;
+  constexpr uint32_t kWidth = GemmVector::kWidth;
+  float *packed_a = workspace;
+  float *packed_b = workspace + size_t(PaddedSize(Min(m, kGemmBlockM), kRows)) * Min(k, kGemmBlockK);
+  const bool has_epilogue = HasEpilogue(epilogue);
+
+  for (uint32_t col_begin = 0; col_begin < n; col_begin += kGemmBlockN) {
+    const uint32_t cols = Min(kGemmBlockN, n - col_begin);
+    for (uint32_t depth_begin = 0; depth_begin < k; depth_begin += kGemmBlockK) {
+      const uint32_t depth = Min(kGemmBlockK, k - depth_begin);
+      const bool accumulate = beta != 0.f || depth_begin > 0;
+      const bool last_depth = depth_begin + depth == k;
+      const float *panels_b = packed_b;
+      if (b.packed != nullptr) {
+        panels_b = PackedPanels(b, depth_begin, depth, b.offset + col_begin);
+      } else {
+        PackB(b.transpose, b.data, b.ld, depth_begin, depth, col_begin, cols, packed_b);
+      }
+      for (uint32_t row_begin = 0; row_begin < m; row_begin += kGemmBlockM) {
+        const uint32_t rows = Min(kGemmBlockM, m - row_begin);
+        const float *panels_a = packed_a;
+        if (a.packed != nullptr) {
+          panels_a = PackedPanels(a, depth_begin, depth, a.offset + row_begin);
+        } else {
+          PackA(a.transpose, a.data, a.ld, row_begin, rows, depth_begin, depth, packed_a);
+        }
+        for (uint32_t j = 0; j < cols; j += kCols) {
+          const uint32_t tile_cols = Min(kCols, cols - j);
+          for (uint32_t i = 0; i < rows; i += kRows) {
+            const uint32_t tile_rows = Min(kRows, rows - i);
+            // 最后一个公共维度分块写回c时加上偏置并计算激活函数，结果还在缓存中
+            GemmEpilogue tile_epilogue = epilogue;
+            if (tile_epilogue.row_bias != nullptr) {
+              tile_epilogue.row_bias += row_begin + i;
+            }
+            if (tile_epilogue.col_bias != nullptr) {
+              tile_epilogue.col_bias += col_begin + j;
+            }
+            if (tile_epilogue.residual != nullptr) {
+              tile_epilogue.residual += row_begin + i + size_t(col_begin + j) * tile_epilogue.ldr;
+            }
+            const MicroKernelFunc kernel = micro_kernels.kernels[(tile_rows + kWidth - 1) / kWidth - 1][tile_cols - 1];
+            kernel(depth, panels_a + size_t(i) * depth, panels_b + size_t(j) * depth, alpha,
+                   c + row_begin + i + size_t(col_begin + j) * ldc, ldc, tile_rows, accumulate,
+                   has_epilogue && last_depth ? &tile_epilogue : nullptr);
+          }
+        }
+      }
+    }
+  }
+}
+
+uint32_t GemmPanelRows() {
+  return GemmVector::kRows;
+}
+
+uint32_t GemmPanelCols() {
+  return GemmVector::kCols;
+}
+}
+}
@@ -0,0 +1,98 @@
+#include "cpu_kernels.hpp"
+#include "data/half.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__F16C__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+// 剩下不足一个向量的元素调用基础级别的标量转换
+void HalfToFloatKernel(const uint16_t *input, uint32_t size, float *output) {
+  uint32_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= size; i += 16) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    _mm512_storeu_ps(output + i, _mm512_cvtph_ps(values));
+  }
+#elif defined(__F16C__)
+  for (; i + 8 <= size; i += 8) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+    _mm256_storeu_ps(output + i, _mm256_cvtph_ps(values));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(output + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(input + i))));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = HalfToFloat(input[i]);
+  }
+}
+
+void FloatToHalfKernel(const float *input, uint32_t size, uint16_t *output) {
+  uint32_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= size; i += 16) {
+    const __m256i values = _mm512_cvtps_ph(_mm512_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i), values);
+  }
+#elif defined(__F16C__)
+  for (; i + 8 <= size; i += 8) {
+    const __m128i values = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), values);
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 4 <= size; i += 4) {
+    vst1_u16(output + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(input + i))));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = FloatToHalf(input[i]);
+  }
+}
+
+void BFloat16ToFloatKernel(const uint16_t *input, uint32_t size, float *output) {
+  uint32_t i = 0;
+  // 零扩展到32位之后左移16位
+#if defined(__AVX512F__)
+  for (; i + 16 <= size; i += 16) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    _mm512_storeu_si512(output + i, _mm512_slli_epi32(_mm512_cvtepu16_epi32(values), 16));
+  }
+#elif defined(__AVX2__)
+  for (; i + 8 <= size; i += 8) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i),
+                        _mm256_slli_epi32(_mm256_cvtepu16_epi32(values), 16));
+  }
+#elif defined(__SSE4_2__)
+  for (; i + 4 <= size; i += 4) {
+    const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(input + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_slli_epi32(_mm_cvtepu16_epi32(values), 16));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(output + i, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(input + i), 16)));
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = BFloat16ToFloat(input[i]);
+  }
+}
+
+void FloatToBFloat16Kernel(const float *input, uint32_t size, uint16_t *output) {
+  uint32_t i = 0;
+#if defined(__AVX512BF16__)
+  for (; i + 16 <= size; i += 16) {
+    const __m256bh values = _mm512_cvtneps_pbh(_mm512_loadu_ps(input + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i), (__m256i) values);
+  }
+#endif
+  for (; i < size; ++i) {
+    output[i] = FloatToBFloat16(input[i]);
+  }
+}
+}
+}
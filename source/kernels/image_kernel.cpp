@@ -0,0 +1,35 @@
+#include "cpu_kernels.hpp"
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+// row_size只用于限制向量化的收集不越过这一行的末尾，标量版本逐字节读取不需要它
+void ImageResizeRowKernel(const uint8_t *row, [[maybe_unused]] uint32_t row_size, const uint32_t *offsets0,
+                          const uint32_t *offsets1, const float *weights, uint32_t width, float *output) {
+  uint32_t x = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  // 按照偏移量收集像素，每次读取4个字节后只保留最低的一个字节，偏移量递增，读取不能越过这一行的末尾
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  for (; x + 8 <= width && offsets1[x + 7] + 4 <= row_size; x += 8) {
+    const __m256i index0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets0 + x));
+    const __m256i index1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets1 + x));
+    const __m256i pixel0 = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(row), index0, 1),
+                                            byte_mask);
+    const __m256i pixel1 = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(row), index1, 1),
+                                            byte_mask);
+    const __m256 value0 = _mm256_cvtepi32_ps(pixel0);
+    const __m256 value1 = _mm256_cvtepi32_ps(pixel1);
+    const __m256 weight = _mm256_loadu_ps(weights + x);
+    _mm256_storeu_ps(output + x, _mm256_fmadd_ps(_mm256_sub_ps(value1, value0), weight, value0));
+  }
+#endif
+  for (; x < width; ++x) {
+    const float value0 = row[offsets0[x]];
+    const float value1 = row[offsets1[x]];
+    output[x] = value0 + (value1 - value0) * weights[x];
+  }
+}
+}
+}
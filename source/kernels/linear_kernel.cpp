@@ -0,0 +1,305 @@
+#include "cpu_kernels.hpp"
+#include "data/half.hpp"
+#include <cstring>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+#if defined(__AVX512F__)
+/// 半精度权重展开之后的一个向量，AVX-512一次展开16个权重
+struct HalfVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static constexpr uint32_t kColumns = 4; /// 同时计算的输入列数，每列4个累加寄存器
+  static Type LoadHalf(const uint16_t *ptr) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr)));
+  }
+  static Type LoadBFloat16(const uint16_t *ptr) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(values), 16));
+  }
+  static Type LoadInt8(const uint8_t *ptr) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr))));
+  }
+  static Type LoadInt4(const uint8_t *ptr, uint32_t shift) {
+    const __m512i bytes = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)));
+    const __m512i values = _mm512_and_si512(_mm512_srl_epi32(bytes, _mm_cvtsi32_si128(int(shift))),
+                                            _mm512_set1_epi32(0xF));
+    return _mm512_cvtepi32_ps(_mm512_sub_epi32(values, _mm512_set1_epi32(8)));
+  }
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static Type Set1(float value) { return _mm512_set1_ps(value); }
+  static Type Zero() { return _mm512_setzero_ps(); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+};
+#elif defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+/// 半精度权重展开之后的一个向量，AVX2一次展开8个权重
+struct HalfVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static constexpr uint32_t kColumns = 2; /// 只有16个寄存器，同时计算的输入列数更少
+  static Type LoadHalf(const uint16_t *ptr) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)));
+  }
+  static Type LoadBFloat16(const uint16_t *ptr) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(values), 16));
+  }
+  static Type LoadInt8(const uint8_t *ptr) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(ptr))));
+  }
+  static Type LoadInt4(const uint8_t *ptr, uint32_t shift) {
+    const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(ptr)));
+    const __m256i values = _mm256_and_si256(_mm256_srl_epi32(bytes, _mm_cvtsi32_si128(int(shift))),
+                                            _mm256_set1_epi32(0xF));
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(values, _mm256_set1_epi32(8)));
+  }
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static Type Set1(float value) { return _mm256_set1_ps(value); }
+  static Type Zero() { return _mm256_setzero_ps(); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// 半精度权重展开之后的一个向量，NEON一次展开4个权重
+struct HalfVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static constexpr uint32_t kColumns = 4;
+  static Type LoadHalf(const uint16_t *ptr) { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(ptr))); }
+  static Type LoadBFloat16(const uint16_t *ptr) { return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(ptr), 16)); }
+  static Type LoadInt8(const uint8_t *ptr) {
+    uint32_t word;
+    memcpy(&word, ptr, sizeof(word));
+    const int16x8_t values = vmovl_s8(vreinterpret_s8_u32(vdup_n_u32(word)));
+    return vcvtq_f32_s32(vmovl_s16(vget_low_s16(values)));
+  }
+  static Type LoadInt4(const uint8_t *ptr, uint32_t shift) {
+    uint32_t word;
+    memcpy(&word, ptr, sizeof(word));
+    const uint16x8_t bytes = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(word)));
+    const uint32x4_t values = vandq_u32(vshlq_u32(vmovl_u16(vget_low_u16(bytes)), vdupq_n_s32(-int32_t(shift))),
+                                        vdupq_n_u32(0xF));
+    return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(values), vdupq_n_s32(8)));
+  }
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static Type Set1(float value) { return vdupq_n_f32(value); }
+  static Type Zero() { return vdupq_n_f32(0.f); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return vfmaq_f32(z, x, y); }
+};
+#else
+/// 没有向量指令时逐个展开权重
+struct HalfVector {
+  using Type = float;
+  static constexpr uint32_t kWidth = 1;
+  static constexpr uint32_t kColumns = 4;
+  static Type LoadHalf(const uint16_t *ptr) { return HalfToFloat(*ptr); }
+  static Type LoadBFloat16(const uint16_t *ptr) { return BFloat16ToFloat(*ptr); }
+  static Type LoadInt8(const uint8_t *ptr) { return float(int8_t(*ptr)); }
+  static Type LoadInt4(const uint8_t *ptr, uint32_t shift) { return float(int32_t((*ptr >> shift) & 0xF) - 8); }
+  static Type Load(const float *ptr) { return *ptr; }
+  static Type Set1(float value) { return value; }
+  static Type Zero() { return 0.f; }
+  static void Store(float *ptr, Type x) { *ptr = x; }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return x * y + z; }
+};
+#endif
+
+static inline uint32_t Min(uint32_t x, uint32_t y) {
+  return x < y ? x : y;
+}
+
+/**
+ * 计算一个面板中的输出特征，权重在寄存器中展开为float之后直接参与乘加，内存中只读取半精度的权重
+ * @tparam bfloat16 权重是否为bfloat16，否则为IEEE半精度
+ * @param panel 面板的起始地址
+ * @param panel_rows 面板包含的输出特征数量，是kBlockRows的倍数
+ * @param in_features 输入特征的数量
+ * @param input 输入矩阵，每一列是一组输入特征
+ * @param input_ld 输入矩阵相邻两列之间的距离
+ * @param cols 输入矩阵的列数
+ * @param row_num 面板中有效的输出特征数量
+ * @param output 面板中第一个输出特征的乘积，每一列是一组输出特征
+ * @param output_ld 输出矩阵相邻两列之间的距离
+ */
+template<bool bfloat16>
+static void MultiplyHalfPanel(const uint16_t *panel, uint32_t panel_rows, uint32_t in_features, const float *input,
+                              uint32_t input_ld, uint32_t cols, uint32_t row_num, float *output,
+                              uint32_t output_ld) {
+  using Vector = HalfVector;
+  constexpr uint32_t kBlockRows = 4 * Vector::kWidth;
+  constexpr uint32_t kColumns = Vector::kColumns;
+  float block_output[kColumns][kBlockRows];
+  for (uint32_t block = 0; block < row_num; block += kBlockRows) {
+    for (uint32_t col = 0; col < cols; col += kColumns) {
+      // 最后一组不足kColumns列时重复计算第一列，结果不写回
+      const uint32_t col_num = Min(kColumns, cols - col);
+      const float *input_ptrs[kColumns];
+      typename Vector::Type sums[kColumns][4];
+      for (uint32_t j = 0; j < kColumns; ++j) {
+        input_ptrs[j] = input + size_t(col + (j < col_num ? j : 0)) * input_ld;
+        for (uint32_t k = 0; k < 4; ++k) {
+          sums[j][k] = Vector::Zero();
+        }
+      }
+      for (uint32_t i = 0; i < in_features; ++i) {
+        const uint16_t *weight_ptr = panel + size_t(i) * panel_rows + block;
+        typename Vector::Type weights[4];
+        for (uint32_t k = 0; k < 4; ++k) {
+          weights[k] = bfloat16 ? Vector::LoadBFloat16(weight_ptr + k * Vector::kWidth)
+                                : Vector::LoadHalf(weight_ptr + k * Vector::kWidth);
+        }
+        for (uint32_t j = 0; j < kColumns; ++j) {
+          const typename Vector::Type value = Vector::Set1(input_ptrs[j][i]);
+          for (uint32_t k = 0; k < 4; ++k) {
+            sums[j][k] = Vector::MultiplyAdd(weights[k], value, sums[j][k]);
+          }
+        }
+      }
+
+      const uint32_t block_rows = Min(kBlockRows, row_num - block);
+      for (uint32_t j = 0; j < col_num; ++j) {
+        for (uint32_t k = 0; k < 4; ++k) {
+          Vector::Store(block_output[j] + k * Vector::kWidth, sums[j][k]);
+        }
+        float *output_ptr = output + size_t(col + j) * output_ld + block;
+        for (uint32_t r = 0; r < block_rows; ++r) {
+          output_ptr[r] = block_output[j][r];
+        }
+      }
+    }
+  }
+}
+
+void HalfPanelKernel(bool bfloat16, const uint16_t *panel, uint32_t panel_rows, uint32_t in_features,
+                     const float *input, uint32_t input_ld, uint32_t cols, uint32_t row_num, float *output,
+                     uint32_t output_ld) {
+  if (bfloat16) {
+    MultiplyHalfPanel<true>(panel, panel_rows, in_features, input, input_ld, cols, row_num, output, output_ld);
+  } else {
+    MultiplyHalfPanel<false>(panel, panel_rows, in_features, input, input_ld, cols, row_num, output, output_ld);
+  }
+}
+
+/**
+ * 计算分组量化权重面板中一个行块在kColumns列输入上的输出，组内先用反量化的权重累加部分和，
+ * 组结束时乘以每一行的系数累加到结果中，反量化只需要整数到float的转换，系数每组只乘一次
+ * @tparam kBits 量化的位数，8或者4
+ * @tparam kColumns 同时计算的输入列数
+ * @param panel 面板的起始地址
+ * @param scales 面板中第一组的系数
+ * @param panel_rows 面板包含的输出特征数量，是4 * Vector::kWidth的倍数
+ * @param group_size 每组包含的输入特征数量
+ * @param in_features 输入特征的数量
+ * @param input 第一列输入
+ * @param input_ld 输入矩阵相邻两列之间的距离
+ * @param block 行块在面板中的第一行
+ * @param block_rows 行块中有效的行数
+ * @param output 面板中第一个输出特征在第一列上的结果
+ * @param output_ld 输出矩阵相邻两列之间的距离
+ */
+template<uint32_t kBits, uint32_t kColumns>
+static void MultiplyQuantBlock(const uint8_t *panel, const float *scales, uint32_t panel_rows, uint32_t group_size,
+                               uint32_t in_features, const float *input, uint32_t input_ld, uint32_t block,
+                               uint32_t block_rows, float *output, uint32_t output_ld) {
+  using Vector = HalfVector;
+  constexpr uint32_t kBlockRows = 4 * Vector::kWidth;
+  const uint32_t half_rows = panel_rows / 2;
+  typename Vector::Type sums[kColumns][4];
+  for (uint32_t j = 0; j < kColumns; ++j) {
+    for (uint32_t k = 0; k < 4; ++k) {
+      sums[j][k] = Vector::Zero();
+    }
+  }
+  for (uint32_t group_begin = 0; group_begin < in_features; group_begin += group_size) {
+    const uint32_t group_end = Min(group_begin + group_size, in_features);
+    typename Vector::Type group_sums[kColumns][4];
+    for (uint32_t j = 0; j < kColumns; ++j) {
+      for (uint32_t k = 0; k < 4; ++k) {
+        group_sums[j][k] = Vector::Zero();
+      }
+    }
+    for (uint32_t i = group_begin; i < group_end; ++i) {
+      typename Vector::Type weights[4];
+      for (uint32_t k = 0; k < 4; ++k) {
+        const uint32_t row = block + k * Vector::kWidth;
+        if (kBits == 8) {
+          weights[k] = Vector::LoadInt8(panel + size_t(i) * panel_rows + row);
+        } else {
+          // 面板前一半的行在低4位，后一半在高4位，一个向量中的行不会跨越两半
+          weights[k] = Vector::LoadInt4(panel + size_t(i) * half_rows + row % half_rows, row < half_rows ? 0 : 4);
+        }
+      }
+      for (uint32_t j = 0; j < kColumns; ++j) {
+        const typename Vector::Type value = Vector::Set1(input[size_t(j) * input_ld + i]);
+        for (uint32_t k = 0; k < 4; ++k) {
+          group_sums[j][k] = Vector::MultiplyAdd(weights[k], value, group_sums[j][k]);
+        }
+      }
+    }
+    const float *group_scales = scales + size_t(group_begin / group_size) * panel_rows + block;
+    for (uint32_t k = 0; k < 4; ++k) {
+      const typename Vector::Type scale = Vector::Load(group_scales + k * Vector::kWidth);
+      for (uint32_t j = 0; j < kColumns; ++j) {
+        sums[j][k] = Vector::MultiplyAdd(group_sums[j][k], scale, sums[j][k]);
+      }
+    }
+  }
+
+  float block_output[kBlockRows];
+  for (uint32_t j = 0; j < kColumns; ++j) {
+    for (uint32_t k = 0; k < 4; ++k) {
+      Vector::Store(block_output + k * Vector::kWidth, sums[j][k]);
+    }
+    float *output_ptr = output + size_t(j) * output_ld + block;
+    for (uint32_t r = 0; r < block_rows; ++r) {
+      output_ptr[r] = block_output[r];
+    }
+  }
+}
+
+/**
+ * 计算分组量化权重的一个面板，每次同时计算Vector::kColumns列输入，剩余的列逐列计算，不重复计算多余的列
+ * @tparam kBits 量化的位数，8或者4
+ */
+template<uint32_t kBits>
+static void MultiplyQuantPanel(const uint8_t *panel, const float *scales, uint32_t panel_rows, uint32_t group_size,
+                               uint32_t in_features, const float *input, uint32_t input_ld, uint32_t cols,
+                               uint32_t row_num, float *output, uint32_t output_ld) {
+  constexpr uint32_t kBlockRows = 4 * HalfVector::kWidth;
+  constexpr uint32_t kColumns = HalfVector::kColumns;
+  for (uint32_t block = 0; block < row_num; block += kBlockRows) {
+    const uint32_t block_rows = Min(kBlockRows, row_num - block);
+    uint32_t col = 0;
+    for (; col + kColumns <= cols; col += kColumns) {
+      MultiplyQuantBlock<kBits, kColumns>(panel, scales, panel_rows, group_size, in_features,
+                                          input + size_t(col) * input_ld, input_ld, block, block_rows,
+                                          output + size_t(col) * output_ld, output_ld);
+    }
+    for (; col < cols; ++col) {
+      MultiplyQuantBlock<kBits, 1>(panel, scales, panel_rows, group_size, in_features,
+                                   input + size_t(col) * input_ld, input_ld, block, block_rows,
+                                   output + size_t(col) * output_ld, output_ld);
+    }
+  }
+}
+
+void QuantPanelKernel(uint32_t bits, const uint8_t *panel, const float *scales, uint32_t panel_rows,
+                      uint32_t group_size, uint32_t in_features, const float *input, uint32_t input_ld,
+                      uint32_t cols, uint32_t row_num, float *output, uint32_t output_ld) {
+  if (bits == 8) {
+    MultiplyQuantPanel<8>(panel, scales, panel_rows, group_size, in_features, input, input_ld, cols, row_num, output,
+                          output_ld);
+  } else {
+    MultiplyQuantPanel<4>(panel, scales, panel_rows, group_size, in_features, input, input_ld, cols, row_num, output,
+                          output_ld);
+  }
+}
+}
+}
@@ -0,0 +1,160 @@
+#include "cpu_kernels.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+// 可移植的AVX-512级别不要求VNNI，只有用-march编译基础级别时才会使用VNNI指令
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+/// VNNI指令要求一个操作数无符号，DotRows把向量加上128之后计算，调用者扣除这么多倍的行和
+constexpr int32_t kDotRowsVectorOffset = 128;
+#else
+/// 其他的DotRows直接计算有符号的点积，不需要扣除行和
+constexpr int32_t kDotRowsVectorOffset = 0;
+#endif
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+/**
+ * 计算连续的row_num行与加上kDotRowsVectorOffset之后的向量的点积
+ * @param rows 第一行的起始地址
+ * @param stride 每一行的元素数量
+ * @param vector 量化向量
+ * @param output 每一行的点积，还没有扣除偏移量
+ */
+template<uint32_t row_num>
+static void DotRows(const int8_t *rows, uint32_t stride, const int8_t *vector, int32_t *output) {
+  const __m512i offset = _mm512_set1_epi8(char(0x80));
+  __m512i sums[row_num];
+  for (uint32_t r = 0; r < row_num; ++r) {
+    sums[r] = _mm512_setzero_si512();
+  }
+  for (uint32_t k = 0; k < stride; k += 64) {
+    const __m512i values = _mm512_xor_si512(_mm512_loadu_si512(vector + k), offset);
+    for (uint32_t r = 0; r < row_num; ++r) {
+      sums[r] = _mm512_dpbusd_epi32(sums[r], values, _mm512_loadu_si512(rows + size_t(r) * stride + k));
+    }
+  }
+  for (uint32_t r = 0; r < row_num; ++r) {
+    output[r] = _mm512_reduce_add_epi32(sums[r]);
+  }
+}
+#elif defined(__AVX2__)
+/**
+ * 计算连续的row_num行与向量的点积，把向量的符号转移到权重上，用无符号乘有符号的指令计算，两两相加不会溢出int16
+ * @param rows 第一行的起始地址
+ * @param stride 每一行的元素数量
+ * @param vector 量化向量
+ * @param output 每一行的点积
+ */
+template<uint32_t row_num>
+static void DotRows(const int8_t *rows, uint32_t stride, const int8_t *vector, int32_t *output) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sums[row_num];
+  for (uint32_t r = 0; r < row_num; ++r) {
+    sums[r] = _mm256_setzero_si256();
+  }
+  for (uint32_t k = 0; k < stride; k += 32) {
+    const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vector + k));
+    const __m256i abs_values = _mm256_sign_epi8(values, values);
+    for (uint32_t r = 0; r < row_num; ++r) {
+      const __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + size_t(r) * stride + k));
+      const __m256i products = _mm256_maddubs_epi16(abs_values, _mm256_sign_epi8(weights, values));
+      sums[r] = _mm256_add_epi32(sums[r], _mm256_madd_epi16(products, ones));
+    }
+  }
+  for (uint32_t r = 0; r < row_num; ++r) {
+    const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums[r]), _mm256_extracti128_si256(sums[r], 1));
+    const __m128i sum2 = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    output[r] = _mm_cvtsi128_si32(_mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1))));
+  }
+}
+#elif defined(__SSE4_2__)
+/**
+ * 计算连续的row_num行与向量的点积，和AVX2的方法相同，每次处理16个元素
+ * @param rows 第一行的起始地址
+ * @param stride 每一行的元素数量
+ * @param vector 量化向量
+ * @param output 每一行的点积
+ */
+template<uint32_t row_num>
+static void DotRows(const int8_t *rows, uint32_t stride, const int8_t *vector, int32_t *output) {
+  const __m128i ones = _mm_set1_epi16(1);
+  __m128i sums[row_num];
+  for (uint32_t r = 0; r < row_num; ++r) {
+    sums[r] = _mm_setzero_si128();
+  }
+  for (uint32_t k = 0; k < stride; k += 16) {
+    const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vector + k));
+    const __m128i abs_values = _mm_sign_epi8(values, values);
+    for (uint32_t r = 0; r < row_num; ++r) {
+      const __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + size_t(r) * stride + k));
+      const __m128i products = _mm_maddubs_epi16(abs_values, _mm_sign_epi8(weights, values));
+      sums[r] = _mm_add_epi32(sums[r], _mm_madd_epi16(products, ones));
+    }
+  }
+  for (uint32_t r = 0; r < row_num; ++r) {
+    const __m128i sum2 = _mm_add_epi32(sums[r], _mm_shuffle_epi32(sums[r], _MM_SHUFFLE(1, 0, 3, 2)));
+    output[r] = _mm_cvtsi128_si32(_mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1))));
+  }
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/**
+ * 计算连续的row_num行与向量的点积，int8乘积扩展到int16之后两两累加到int32
+ * @param rows 第一行的起始地址
+ * @param stride 每一行的元素数量
+ * @param vector 量化向量
+ * @param output 每一行的点积
+ */
+template<uint32_t row_num>
+static void DotRows(const int8_t *rows, uint32_t stride, const int8_t *vector, int32_t *output) {
+  int32x4_t sums[row_num];
+  for (uint32_t r = 0; r < row_num; ++r) {
+    sums[r] = vdupq_n_s32(0);
+  }
+  for (uint32_t k = 0; k < stride; k += 16) {
+    const int8x16_t values = vld1q_s8(vector + k);
+    for (uint32_t r = 0; r < row_num; ++r) {
+      const int8x16_t weights = vld1q_s8(rows + size_t(r) * stride + k);
+      sums[r] = vpadalq_s16(sums[r], vmull_s8(vget_low_s8(values), vget_low_s8(weights)));
+      sums[r] = vpadalq_s16(sums[r], vmull_high_s8(values, weights));
+    }
+  }
+  for (uint32_t r = 0; r < row_num; ++r) {
+    output[r] = vaddvq_s32(sums[r]);
+  }
+}
+#else
+template<uint32_t row_num>
+static void DotRows(const int8_t *rows, uint32_t stride, const int8_t *vector, int32_t *output) {
+  for (uint32_t r = 0; r < row_num; ++r) {
+    const int8_t *row_ptr = rows + size_t(r) * stride;
+    int32_t sum = 0;
+    for (uint32_t k = 0; k < stride; ++k) {
+      sum += int32_t(row_ptr[k]) * int32_t(vector[k]);
+    }
+    output[r] = sum;
+  }
+}
+#endif
+
+void Int8DotRowsKernel(const int8_t *rows, uint32_t stride, uint32_t row_num, const int8_t *vector,
+                       const int32_t *row_sums, int32_t *output) {
+  // 每次计算四行，向量的每一段只需要读取一次
+  uint32_t r = 0;
+  for (; r + 4 <= row_num; r += 4) {
+    DotRows<4>(rows + size_t(r) * stride, stride, vector, output + r);
+  }
+  for (; r < row_num; ++r) {
+    DotRows<1>(rows + size_t(r) * stride, stride, vector, output + r);
+  }
+  if (kDotRowsVectorOffset != 0) {
+    for (r = 0; r < row_num; ++r) {
+      output[r] -= kDotRowsVectorOffset * row_sums[r];
+    }
+  }
+}
+}
+}
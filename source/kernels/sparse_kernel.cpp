@@ -0,0 +1,135 @@
+#include "cpu_kernels.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace kuiper_infer {
+namespace KUIPER_ISA_NAMESPACE {
+#if defined(__AVX512F__)
+/// 稀疏矩阵乘法中稠密矩阵的一段连续行，AVX-512一次计算16行
+struct SparseVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm512_set1_ps(value); }
+  static Type Zero() { return _mm512_setzero_ps(); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+};
+#elif defined(__AVX2__)
+/// 稀疏矩阵乘法中稠密矩阵的一段连续行，AVX2一次计算8行
+struct SparseVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm256_set1_ps(value); }
+  static Type Zero() { return _mm256_setzero_ps(); }
+#if defined(__FMA__)
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+#else
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_add_ps(_mm256_mul_ps(x, y), z); }
+#endif
+};
+#elif defined(__SSE4_2__)
+/// 稀疏矩阵乘法中稠密矩阵的一段连续行，SSE一次计算4行
+struct SparseVector {
+  using Type = __m128;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return _mm_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm_storeu_ps(ptr, x); }
+  static Type Set1(float value) { return _mm_set1_ps(value); }
+  static Type Zero() { return _mm_setzero_ps(); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm_add_ps(_mm_mul_ps(x, y), z); }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// 稀疏矩阵乘法中稠密矩阵的一段连续行，NEON一次计算4行
+struct SparseVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type Set1(float value) { return vdupq_n_f32(value); }
+  static Type Zero() { return vdupq_n_f32(0.f); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return vfmaq_f32(z, x, y); }
+};
+#else
+/// 没有向量指令时逐行计算
+struct SparseVector {
+  using Type = float;
+  static constexpr uint32_t kWidth = 1;
+  static Type Load(const float *ptr) { return *ptr; }
+  static void Store(float *ptr, Type x) { *ptr = x; }
+  static Type Set1(float value) { return value; }
+  static Type Zero() { return 0.f; }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return x * y + z; }
+};
+#endif
+
+/// 每次计算的稠密矩阵行数，4个累加寄存器隐藏乘加的延迟
+constexpr uint32_t kSparseBlockRows = SparseVector::kWidth * 4;
+
+/**
+ * 计算c的一列中从row开始的kSparseBlockRows行，非零元素对a的对应列做向量乘加
+ */
+static inline void SparseBlock(const float *a, uint32_t lda, uint32_t row, uint32_t begin, uint32_t end,
+                               const uint32_t *row_indices, const float *values, float *c_ptr) {
+  using Vector = SparseVector;
+  constexpr uint32_t kWidth = Vector::kWidth;
+  Vector::Type acc0 = Vector::Zero();
+  Vector::Type acc1 = Vector::Zero();
+  Vector::Type acc2 = Vector::Zero();
+  Vector::Type acc3 = Vector::Zero();
+  for (uint32_t p = begin; p < end; ++p) {
+    const float *a_ptr = a + size_t(row_indices[p]) * lda + row;
+    const Vector::Type value = Vector::Set1(values[p]);
+    acc0 = Vector::MultiplyAdd(value, Vector::Load(a_ptr), acc0);
+    acc1 = Vector::MultiplyAdd(value, Vector::Load(a_ptr + kWidth), acc1);
+    acc2 = Vector::MultiplyAdd(value, Vector::Load(a_ptr + kWidth * 2), acc2);
+    acc3 = Vector::MultiplyAdd(value, Vector::Load(a_ptr + kWidth * 3), acc3);
+  }
+  Vector::Store(c_ptr + row, acc0);
+  Vector::Store(c_ptr + row + kWidth, acc1);
+  Vector::Store(c_ptr + row + kWidth * 2, acc2);
+  Vector::Store(c_ptr + row + kWidth * 3, acc3);
+}
+
+void SparseGemmKernel(const float *a, uint32_t lda, uint32_t m, const uint32_t *col_offsets,
+                      const uint32_t *row_indices, const float *values, uint32_t n, float *c, uint32_t ldc,
+                      const GemmEpilogue &epilogue) {
+  using Vector = SparseVector;
+  constexpr uint32_t kWidth = Vector::kWidth;
+  // 外层按行分块，同一块行在a中的数据被所有列重复读取，留在一级或者二级缓存中
+  for (uint32_t row = 0; row < m; row += kSparseBlockRows) {
+    const uint32_t row_end = m - row < kSparseBlockRows ? m : row + kSparseBlockRows;
+    for (uint32_t j = 0; j < n; ++j) {
+      const uint32_t begin = col_offsets[j];
+      const uint32_t end = col_offsets[j + 1];
+      float *c_ptr = c + size_t(j) * ldc;
+      if (row_end - row == kSparseBlockRows) {
+        SparseBlock(a, lda, row, begin, end, row_indices, values, c_ptr);
+        continue;
+      }
+      uint32_t i = row;
+      for (; i + kWidth <= row_end; i += kWidth) {
+        Vector::Type acc = Vector::Zero();
+        for (uint32_t p = begin; p < end; ++p) {
+          acc = Vector::MultiplyAdd(Vector::Set1(values[p]), Vector::Load(a + size_t(row_indices[p]) * lda + i), acc);
+        }
+        Vector::Store(c_ptr + i, acc);
+      }
+      for (; i < row_end; ++i) {
+        float sum = 0.f;
+        for (uint32_t p = begin; p < end; ++p) {
+          sum += values[p] * a[size_t(row_indices[p]) * lda + i];
+        }
+        c_ptr[i] = sum;
+      }
+    }
+  }
+  GemmEpilogueKernel(epilogue, m, n, c, ldc);
+}
+}
+}
@@ -0,0 +1,112 @@
+#include "layer/abstract/activation.hpp"
+#include <cstring>
+#include <algorithm>
+#include <glog/logging.h>
+#include "data/tensor.hpp"
+#include "runtime/runtime_op.hpp"
+#include "runtime/thread_pool.hpp"
+#include "../../kernels/cpu_kernels.hpp"
+#ifdef USE_CUDA
+#include "../../backend/cuda/cuda_kernels.hpp"
+#endif
+
+namespace kuiper_infer {
+/// 并行计算激活函数时每个块的元素数量
+constexpr uint32_t kActivationChunkSize = 16 * 1024;
+
+ActivationType ActivationTypeFromOpType(const std::string &op_type) {
+  if (op_type == "nn.ReLU") {
+    return ActivationType::kActivationRelu;
+  } else if (op_type == "nn.Sigmoid") {
+    return ActivationType::kActivationSigmoid;
+  } else if (op_type == "nn.SiLU") {
+    return ActivationType::kActivationSiLU;
+  } else if (op_type == "nn.Hardswish") {
+    return ActivationType::kActivationHardSwish;
+  } else if (op_type == "nn.Hardsigmoid") {
+    return ActivationType::kActivationHardSigmoid;
+  } else {
+    return ActivationType::kActivationNone;
+  }
+}
+
+bool ParseFusedActivation(const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+                          ActivationType &activation_type) {
+  activation_type = ActivationType::kActivationNone;
+  const auto &param = op->params.find(name);
+  if (param == op->params.end()) {
+    return true;
+  }
+  const auto activation = dynamic_cast<RuntimeParameterString *>(param->second);
+  if (activation == nullptr) {
+    LOG(ERROR) << "Can not find the " << name << " parameter";
+    return false;
+  }
+  activation_type = ActivationTypeFromOpType(activation->value);
+  LOG_IF(ERROR, activation_type == ActivationType::kActivationNone)
+          << "Unsupported fused activation: " << activation->value;
+  return activation_type != ActivationType::kActivationNone;
+}
+
+void ApplyActivation(ActivationType activation, float *data, uint32_t size) {
+  CurrentCpuKernels().apply_activation(activation, data, size);
+}
+
+void ApplyActivation(ActivationType activation, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                     const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  CHECK(inputs.size() == outputs.size());
+  // chunk_offsets[i]是第i个样本的第一个块在所有块中的编号
+  std::vector<uint32_t> chunk_offsets(inputs.size() + 1, 0);
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    CHECK(inputs.at(i) != nullptr && outputs.at(i) != nullptr);
+    CHECK(inputs.at(i)->size() == outputs.at(i)->size());
+    const uint32_t chunk_num = (inputs.at(i)->size() + kActivationChunkSize - 1) / kActivationChunkSize;
+    chunk_offsets.at(i + 1) = chunk_offsets.at(i) + chunk_num;
+  }
+
+  ThreadPool::Current().ParallelFor(0, chunk_offsets.back(), [&](uint32_t chunk) {
+    const uint32_t i = std::upper_bound(chunk_offsets.begin(), chunk_offsets.end(), chunk) - chunk_offsets.begin() - 1;
+    const uint32_t size = inputs.at(i)->size();
+    const uint32_t offset = (chunk - chunk_offsets.at(i)) * kActivationChunkSize;
+    const uint32_t len = std::min(kActivationChunkSize, size - offset);
+    const float *input_ptr = inputs.at(i)->data().memptr() + offset;
+    float *output_ptr = outputs.at(i)->data().memptr() + offset;
+    if (input_ptr != output_ptr) {
+      memcpy(output_ptr, input_ptr, len * sizeof(float));
+    }
+    ApplyActivation(activation, output_ptr, len);
+  });
+}
+
+InferStatus ForwardActivationCuda(ActivationType activation, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                  std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+#ifdef USE_CUDA
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of activation layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    CHECK(input != nullptr && !input->empty()) << "The input feature map of activation layer is empty";
+    std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
+    }
+    CHECK(output->shapes() == input->shapes()) << "The output size of activation is error";
+    // 输出可以是输入张量本身，此时在同一块设备内存上原地计算
+    cuda::Activation(activation, input->cuda_data(), input->size(), output->cuda_data());
+    output->set_device(DeviceType::kDeviceCUDA);
+  }
+  return InferStatus::kInferSuccess;
+#else
+  LOG(ERROR) << "The library is built without the cuda backend";
+  return InferStatus::kInferFailedDeviceNotSupported;
+#endif
+}
+}
@@ -2,6 +2,7 @@
 // Created by fss on 22-11-15.
 //
 #include "layer/abstract/layer.hpp"
+#include <algorithm>
 namespace kuiper_infer {
 
 const std::vector<std::shared_ptr<Tensor<float>>> &Layer::weights() const {
@@ -28,6 +29,131 @@ void Layer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weigh
   LOG(FATAL) << this->layer_name_ << " layer not implement yet!";
 }
 
+void Layer::set_weights(const float *weights, uint32_t size) {
+  this->set_weights(std::vector<float>(weights, weights + size));
+}
+
+void Layer::set_bias(const float *bias, uint32_t size) {
+  this->set_bias(std::vector<float>(bias, bias + size));
+}
+
+
+size_t Layer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  return 0;
+}
+
+bool Layer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                             std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().empty()) {
+    return false;
+  }
+  output_shape = input_shapes.front();
+  return true;
+}
+
+uint64_t Layer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                      const std::vector<int32_t> &output_shape) const {
+  return ShapeSize(output_shape);
+}
+
+bool Layer::ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  return false;
+}
+
+bool Layer::SupportInPlace() const {
+  return false;
+}
+
+size_t Layer::ParamBytes() const {
+  return 0;
+}
+
+void Layer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+
+}
+
+void Layer::ShareParams(SharedParams &shared_params) {
+
+}
+
+void Layer::set_shared_params(std::shared_ptr<const SharedParams> shared_params) {
+  shared_params_ = std::move(shared_params);
+}
+
+bool Layer::QuantizeInt8(float input_abs_max) {
+  return false;
+}
+
+bool Layer::QuantizeWeights(uint32_t bits, uint32_t group_size) {
+  return false;
+}
+
+bool Layer::Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) {
+  return false;
+}
+
+void Layer::PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes) {
+}
+
+bool Layer::SetDetectionPostProcess(const DetectionPostProcess &post_process) {
+  return false;
+}
+
+bool Layer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU;
+}
+
+InferStatus Layer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                               std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  LOG(ERROR) << this->layer_name_ << " layer does not support the cuda device";
+  return InferStatus::kInferFailedDeviceNotSupported;
+}
+
+uint64_t Layer::ShapeSize(const std::vector<int32_t> &shape) {
+  if (shape.empty()) {
+    return 0;
+  }
+  uint64_t size = 1;
+  for (const int32_t dim : shape) {
+    size *= uint64_t(std::max(dim, 0));
+  }
+  return size;
+}
+
+void Layer::set_workspace(float *workspace, size_t workspace_size) {
+  this->workspace_ = workspace;
+  this->workspace_size_ = workspace == nullptr ? 0 : workspace_size;
+}
+
+/// 当前线程中通过WorkspaceScope指定的临时内存
+static thread_local bool scope_bound = false;
+static thread_local float *scope_workspace = nullptr;
+static thread_local size_t scope_workspace_size = 0;
+
+Layer::WorkspaceScope::WorkspaceScope(float *workspace, size_t workspace_size)
+    : prev_bound_(scope_bound), prev_workspace_(scope_workspace), prev_workspace_size_(scope_workspace_size) {
+  scope_bound = true;
+  scope_workspace = workspace;
+  scope_workspace_size = workspace == nullptr ? 0 : workspace_size;
+}
+
+Layer::WorkspaceScope::~WorkspaceScope() {
+  scope_bound = prev_bound_;
+  scope_workspace = prev_workspace_;
+  scope_workspace_size = prev_workspace_size_;
+}
+
+float *Layer::AcquireWorkspace(size_t size, std::vector<float> &buffer) const {
+  if (scope_bound) {
+    if (size <= scope_workspace_size) {
+      return scope_workspace;
+    }
+  } else if (size <= this->workspace_size_) {
+    return this->workspace_;
+  }
+  buffer.resize(size);
+  return buffer.data();
+}
 
 InferStatus Layer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                            std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
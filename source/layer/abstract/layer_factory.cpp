@@ -20,17 +20,31 @@ LayerRegisterer::CreateRegistry &LayerRegisterer::Registry() {
 }
 
 std::shared_ptr<Layer> LayerRegisterer::CreateLayer(const std::shared_ptr<RuntimeOperator> &op) {
+  std::shared_ptr<Layer> layer;
+  const auto &status = CreateLayer(op, layer);
+  LOG_IF(FATAL, status != ParseParameterAttrStatus::kParameterAttrParseSuccess) << "Create the layer: "
+                                                                                << op->type << " failed, error code: "
+                                                                                << int(status);
+  return layer;
+}
+
+ParseParameterAttrStatus LayerRegisterer::CreateLayer(const std::shared_ptr<RuntimeOperator> &op,
+                                                      std::shared_ptr<Layer> &layer) {
+  // 注册表在main之前已经完成注册，这里只有读取，不需要加锁
   CreateRegistry &registry = Registry();
   const std::string &layer_type = op->type;
-  LOG_IF(FATAL, registry.count(layer_type) <= 0) << "Can not find the layer type: " << layer_type;
-  const auto &creator = registry.find(layer_type)->second;
+  const auto &creator_iter = registry.find(layer_type);
+  if (creator_iter == registry.end()) {
+    LOG(ERROR) << "Can not find the layer type: " << layer_type;
+    return ParseParameterAttrStatus::kParameterMissingUnknown;
+  }
 
+  const auto &creator = creator_iter->second;
   LOG_IF(FATAL, !creator) << "Layer creator is empty!";
-  std::shared_ptr<Layer> layer;
   const auto &status = creator(op, layer);
-  LOG_IF(FATAL, status != ParseParameterAttrStatus::kParameterAttrParseSuccess) << "Create the layer: "
-                                                                                << layer_type << " failed, error code: "
-                                                                                << int(status);
-  return layer;
+  if (status == ParseParameterAttrStatus::kParameterAttrParseSuccess && layer == nullptr) {
+    return ParseParameterAttrStatus::kParameterMissingUnknown;
+  }
+  return status;
 }
 }
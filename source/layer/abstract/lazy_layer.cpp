@@ -0,0 +1,183 @@
+#include "layer/abstract/lazy_layer.hpp"
+#include <cstdint>
+#include "layer/abstract/layer_factory.hpp"
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace kuiper_infer {
+/**
+ * 对计算节点中映射到内存的权重给出访问建议，没有映射的权重保存在进程自己的内存中，不需要处理
+ * @param op 计算节点
+ * @param advice madvise的建议
+ */
+static void AdviseAttributes(const RuntimeOperator &op, int advice) {
+#if defined(__linux__)
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  for (const auto &attr : op.attribute) {
+    if (attr.second == nullptr || !attr.second->mapped_data || attr.second->mapped_size == 0) {
+      continue;
+    }
+    // 权重在文件中不按页对齐，向外扩展到整页，相邻权重所在的页同样受到影响
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(attr.second->mapped_data.get()) / page_size * page_size;
+    const uintptr_t end = reinterpret_cast<uintptr_t>(attr.second->mapped_data.get()) + attr.second->mapped_size;
+    madvise(reinterpret_cast<void *>(begin), end - begin, advice);
+  }
+#endif
+}
+
+LazyLayer::LazyLayer(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<std::atomic<uint32_t>> pending_num)
+    : Layer(op->name), op_(op), pending_num_(std::move(pending_num)) {
+  CHECK(pending_num_ != nullptr);
+}
+
+void LazyLayer::Materialize() const {
+  const std::shared_ptr<RuntimeOperator> op = op_.lock();
+  CHECK(op != nullptr) << "The operator of the lazy layer " << layer_name_ << " has been released";
+#if defined(__linux__)
+  AdviseAttributes(*op, MADV_WILLNEED);
+#endif
+  std::shared_ptr<Layer> layer;
+  const ParseParameterAttrStatus status = LayerRegisterer::CreateLayer(op, layer);
+  LOG_IF(FATAL, status != ParseParameterAttrStatus::kParameterAttrParseSuccess || layer == nullptr)
+          << "Create the layer: " << op->name << " type: " << op->type << " failed, error code: " << int(status);
+  if (quantize_bits_ != 0) {
+    LOG_IF(ERROR, !layer->QuantizeWeights(quantize_bits_, quantize_group_size_))
+            << "Quantize the weights of the layer: " << op->name << " failed";
+  }
+  if (weight_policy_ != NumaMemoryPolicy::kDefault) {
+    layer->PlaceParams(weight_policy_, weight_node_);
+  }
+  // Layer已经复制或者打包了权重，映射的文件页不再需要常驻，再次读取时从页缓存或者文件中重新载入
+#if defined(__linux__)
+  AdviseAttributes(*op, MADV_DONTNEED);
+#endif
+  layer_ = layer;
+  materialized_.store(true, std::memory_order_release);
+  pending_num_->fetch_sub(1);
+}
+
+Layer &LazyLayer::layer() const {
+  std::call_once(create_flag_, [this]() { this->Materialize(); });
+  return *layer_;
+}
+
+bool LazyLayer::materialized() const {
+  return materialized_.load(std::memory_order_acquire);
+}
+
+InferStatus LazyLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                               std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return layer().Forward(inputs, outputs);
+}
+
+InferStatus LazyLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                   std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return layer().ForwardCuda(inputs, outputs);
+}
+
+const std::vector<std::shared_ptr<Tensor<float>>> &LazyLayer::weights() const {
+  return layer().weights();
+}
+
+const std::vector<std::shared_ptr<Tensor<float>>> &LazyLayer::bias() const {
+  return layer().bias();
+}
+
+void LazyLayer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) {
+  layer().set_weights(weights);
+}
+
+void LazyLayer::set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bias) {
+  layer().set_bias(bias);
+}
+
+void LazyLayer::set_weights(const std::vector<float> &weights) {
+  layer().set_weights(weights);
+}
+
+void LazyLayer::set_bias(const std::vector<float> &bias) {
+  layer().set_bias(bias);
+}
+
+void LazyLayer::set_weights(const float *weights, uint32_t size) {
+  layer().set_weights(weights, size);
+}
+
+void LazyLayer::set_bias(const float *bias, uint32_t size) {
+  layer().set_bias(bias, size);
+}
+
+size_t LazyLayer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  // 创建之前返回0，第一次执行时Layer使用自己申请的临时内存
+  return materialized() ? layer_->WorkspaceSize(input_shapes) : 0;
+}
+
+bool LazyLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                 std::vector<int32_t> &output_shape) const {
+  return layer().InferOutputShape(input_shapes, output_shape);
+}
+
+uint64_t LazyLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                          const std::vector<int32_t> &output_shape) const {
+  return layer().Flops(input_shapes, output_shape);
+}
+
+bool LazyLayer::ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  return materialized() && layer_->ShareInputMemory(input_shapes);
+}
+
+bool LazyLayer::SupportInPlace() const {
+  return materialized() && layer_->SupportInPlace();
+}
+
+size_t LazyLayer::ParamBytes() const {
+  return materialized() ? layer_->ParamBytes() : 0;
+}
+
+void LazyLayer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+  if (materialized()) {
+    layer_->PlaceParams(policy, node);
+    return;
+  }
+  weight_policy_ = policy;
+  weight_node_ = node;
+}
+
+void LazyLayer::ShareParams(SharedParams &shared_params) {
+  layer().ShareParams(shared_params);
+}
+
+bool LazyLayer::QuantizeInt8(float input_abs_max) {
+  return layer().QuantizeInt8(input_abs_max);
+}
+
+bool LazyLayer::QuantizeWeights(uint32_t bits, uint32_t group_size) {
+  if (materialized()) {
+    return layer_->QuantizeWeights(bits, group_size);
+  }
+  quantize_bits_ = bits;
+  quantize_group_size_ = group_size;
+  return true;
+}
+
+bool LazyLayer::Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) {
+  return layer().Tune(input_shapes, cache);
+}
+
+void LazyLayer::PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes) {
+  if (materialized()) {
+    layer_->PreparePlan(input_shapes);
+  }
+}
+
+bool LazyLayer::SetDetectionPostProcess(const DetectionPostProcess &post_process) {
+  return layer().SetDetectionPostProcess(post_process);
+}
+
+bool LazyLayer::SupportDevice(DeviceType device) const {
+  // 所有Layer都支持CPU，其他设备需要实际的Layer判断
+  return device == DeviceType::kDeviceCPU || layer().SupportDevice(device);
+}
+}
@@ -18,6 +18,39 @@ const std::vector<std::shared_ptr<Tensor<float>>> &ParamLayer::bias() const {
   return this->bias_;
 }
 
+size_t ParamLayer::ParamBytes() const {
+  size_t param_bytes = 0;
+  for (const auto &weight : this->weights_) {
+    param_bytes += weight ? weight->size() * sizeof(float) : 0;
+  }
+  for (const auto &bias : this->bias_) {
+    param_bytes += bias ? bias->size() * sizeof(float) : 0;
+  }
+  return param_bytes;
+}
+
+void ParamLayer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+  for (const auto &weight : this->weights_) {
+    if (weight != nullptr && !weight->empty()) {
+      PlaceMemory(weight->RawPtr(), weight->size() * sizeof(float), policy, node);
+    }
+  }
+  for (const auto &bias : this->bias_) {
+    if (bias != nullptr && !bias->empty()) {
+      PlaceMemory(bias->RawPtr(), bias->size() * sizeof(float), policy, node);
+    }
+  }
+}
+
+void ParamLayer::ShareParams(SharedParams &shared_params) {
+  for (auto &weight : this->weights_) {
+    shared_params.Share(weight);
+  }
+  for (auto &bias : this->bias_) {
+    shared_params.Share(bias);
+  }
+}
+
 void ParamLayer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) {
   this->weights_ = weights;
 }
@@ -27,7 +60,15 @@ void ParamLayer::set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bia
 }
 
 void ParamLayer::set_weights(const std::vector<float> &weights) {
-  const uint32_t elem_size = weights.size();
+  this->set_weights(weights.data(), weights.size());
+}
+
+void ParamLayer::set_bias(const std::vector<float> &bias) {
+  this->set_bias(bias.data(), bias.size());
+}
+
+void ParamLayer::set_weights(const float *weights, uint32_t size) {
+  const uint32_t elem_size = size;
 
   uint32_t weight_size = 0;
   const uint32_t batch_size = this->weights_.size();
@@ -41,14 +82,12 @@ void ParamLayer::set_weights(const std::vector<float> &weights) {
   for (uint32_t idx = 0; idx < batch_size; ++idx) {
     const uint32_t start_offset = idx * blob_size;
     const uint32_t end_offset = start_offset + blob_size;
-    const auto &sub_values = std::vector<float>{weights.begin() + start_offset,
-                                                weights.begin() + end_offset};
-    this->weights_.at(idx)->Fill(sub_values);
+    this->weights_.at(idx)->Fill(weights + start_offset, end_offset - start_offset);
   }
 }
 
-void ParamLayer::set_bias(const std::vector<float> &bias) {
-  const uint32_t elem_size = bias.size();
+void ParamLayer::set_bias(const float *bias, uint32_t size) {
+  const uint32_t elem_size = size;
 
   uint32_t bias_size = 0;
   const uint32_t batch_size = this->bias_.size();
@@ -61,10 +100,16 @@ void ParamLayer::set_bias(const std::vector<float> &bias) {
   for (uint32_t idx = 0; idx < batch_size; ++idx) {
     const uint32_t start_offset = idx * blob_size;
     const uint32_t end_offset = start_offset + blob_size;
-    const auto &sub_values = std::vector<float>{bias.begin() + start_offset,
-                                                bias.begin() + end_offset};
-    this->bias_.at(idx)->Fill(sub_values);
+    this->bias_.at(idx)->Fill(bias + start_offset, end_offset - start_offset);
   }
 }
 
+void ParamLayer::set_activation(ActivationType activation) {
+  this->activation_ = activation;
+}
+
+ActivationType ParamLayer::activation() const {
+  return this->activation_;
+}
+
 }
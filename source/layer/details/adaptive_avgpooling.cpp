@@ -4,9 +4,109 @@
 #include "adaptive_avgpooling.hpp"
 #include "layer/abstract/layer_factory.hpp"
 #include <glog/logging.h>
+#include "runtime/thread_pool.hpp"
+#include "layer/abstract/window_kernel.hpp"
+#ifdef USE_CUDA
+#include "../../backend/cuda/cuda_kernels.hpp"
+#endif
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace kuiper_infer {
 
+#if defined(__AVX512F__)
+/// AVX-512一次累加16个float
+struct SumVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Zero() { return _mm512_setzero_ps(); }
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static Type Add(Type x, Type y) { return _mm512_add_ps(x, y); }
+  static float Reduce(Type x) { return _mm512_reduce_add_ps(x); }
+};
+#elif defined(__AVX2__)
+/// AVX2一次累加8个float
+struct SumVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Zero() { return _mm256_setzero_ps(); }
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static Type Add(Type x, Type y) { return _mm256_add_ps(x, y); }
+  static float Reduce(Type x) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+  }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// NEON一次累加4个float
+struct SumVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Zero() { return vdupq_n_f32(0.f); }
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static Type Add(Type x, Type y) { return vaddq_f32(x, y); }
+  static float Reduce(Type x) { return vaddvq_f32(x); }
+};
+#endif
+
+/// 一个通道的平均池化，窗口大小和步长固定的实例中窗口内的循环次数都是常量，Kernel<0, 0, 0, 0>是通用实例
+template<uint32_t kPoolingH, uint32_t kPoolingW, uint32_t kStrideH, uint32_t kStrideW>
+struct AveragePoolingChannel {
+  using Function = void (*)(const PoolingWindow &window, const arma::fmat &input_channel, arma::fmat &output_channel);
+
+  static void Run(const PoolingWindow &window, const arma::fmat &input_channel, arma::fmat &output_channel) {
+    const uint32_t pooling_h = FixedOr<kPoolingH>(window.pooling_h);
+    const uint32_t pooling_w = FixedOr<kPoolingW>(window.pooling_w);
+    const uint32_t stride_h = FixedOr<kStrideH>(window.stride_h);
+    const uint32_t stride_w = FixedOr<kStrideW>(window.stride_w);
+    const float pooling_size = float(pooling_h * pooling_w);
+    for (uint32_t c = 0; c < window.output_w; ++c) {
+      float *output_channel_ptr = output_channel.colptr(c);
+      for (uint32_t r = 0; r < window.output_h; ++r) {
+        float mean_value = 0.f;
+        for (uint32_t w = 0; w < pooling_w; ++w) {
+          const float *col_ptr = input_channel.colptr(c * stride_w + w) + r * stride_h;
+          for (uint32_t h = 0; h < pooling_h; ++h) {
+            mean_value = mean_value + col_ptr[h];
+          }
+        }
+        output_channel_ptr[r] = mean_value / pooling_size;
+      }
+    }
+  }
+};
+
+float AdaptiveAveragePoolingLayer::GlobalAveragePooling(const std::shared_ptr<Tensor<float>> &input,
+                                                        uint32_t channel) {
+  const uint32_t plane_size = input->rows() * input->cols();
+  CHECK(plane_size > 0 && channel < input->channels());
+  const float *plane_ptr = input->at(channel).memptr();
+  uint32_t i = 0;
+  float sum = 0.f;
+#if defined(__AVX512F__) || defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+  // 两组累加器交替使用，隐藏加法指令的延迟
+  SumVector::Type sum0 = SumVector::Zero();
+  SumVector::Type sum1 = SumVector::Zero();
+  for (; i + 2 * SumVector::kWidth <= plane_size; i += 2 * SumVector::kWidth) {
+    sum0 = SumVector::Add(sum0, SumVector::Load(plane_ptr + i));
+    sum1 = SumVector::Add(sum1, SumVector::Load(plane_ptr + i + SumVector::kWidth));
+  }
+  for (; i + SumVector::kWidth <= plane_size; i += SumVector::kWidth) {
+    sum0 = SumVector::Add(sum0, SumVector::Load(plane_ptr + i));
+  }
+  sum = SumVector::Reduce(SumVector::Add(sum0, sum1));
+#endif
+  for (; i < plane_size; ++i) {
+    sum += plane_ptr[i];
+  }
+  return sum / float(plane_size);
+}
+
 AdaptiveAveragePoolingLayer::AdaptiveAveragePoolingLayer(uint32_t output_h, uint32_t output_w)
     : Layer("AdaptiveAveragePooling"), output_h_(output_h), output_w_(output_w) {
 }
@@ -30,21 +130,46 @@ InferStatus AdaptiveAveragePoolingLayer::Forward(const std::vector<std::shared_p
   }
 
   const uint32_t batch = inputs.size();
-#pragma omp parallel for num_threads(batch)
-  for (uint32_t i = 0; i < batch; ++i) {
+  if (output_h_ == 1 && output_w_ == 1) {
+    // 分类网络头部的全局平均池化，每个任务是一个样本的一个通道，在批次和通道之间一起并行
+    for (uint32_t i = 0; i < batch; ++i) {
+      const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
+      KUIPER_FORWARD_CHECK(input_data != nullptr && !input_data->empty())
+              << "The input feature map of average pooling layer is empty";
+      std::shared_ptr<Tensor<float>> &output_data = outputs.at(i);
+      if (output_data == nullptr || output_data->empty()) {
+        output_data = std::make_shared<Tensor<float>>(input_data->channels(), 1, 1);
+      }
+      KUIPER_FORWARD_CHECK(output_data->rows() == 1 && output_data->cols() == 1
+                && output_data->channels() == input_data->channels()) << "The output size of adaptive pooling is error";
+    }
+    const uint32_t input_c = inputs.front()->channels();
+    ThreadPool::Current().ParallelFor(0, batch * input_c, [&](uint32_t index) {
+      const uint32_t i = index / input_c;
+      const uint32_t ic = index % input_c;
+      KUIPER_FORWARD_CHECK(inputs.at(i)->channels() == input_c)
+              << "The input channels of adaptive pooling is not equal";
+      outputs.at(i)->at(ic, 0, 0) = GlobalAveragePooling(inputs.at(i), ic);
+    });
+    return InferStatus::kInferSuccess;
+  }
+
+  ThreadPool::Current().ParallelFor(0, batch, [&](uint32_t i) {
     const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
-    CHECK(input_data == nullptr || !input_data->empty()) << "The input feature map of average pooling layer is empty";
+    KUIPER_FORWARD_CHECK(input_data == nullptr || !input_data->empty())
+            << "The input feature map of average pooling layer is empty";
 
     const uint32_t input_h = input_data->rows();
     const uint32_t input_w = input_data->cols();
     const uint32_t input_c = input_data->channels();
     const uint32_t stride_h = uint32_t(std::floor(input_h / output_h_));
     const uint32_t stride_w = uint32_t(std::floor(input_w / output_w_));
-    CHECK(stride_w > 0 && stride_h > 0) << "The stride parameter is set incorrectly. It must always be greater than 0";
+    KUIPER_FORWARD_CHECK(stride_w > 0 && stride_h > 0)
+            << "The stride parameter is set incorrectly. It must always be greater than 0";
 
     const uint32_t pooling_h = input_h - (output_h_ - 1) * stride_h;
     const uint32_t pooling_w = input_w - (output_w_ - 1) * stride_w;
-    CHECK(pooling_w > 0 && pooling_h > 0)
+    KUIPER_FORWARD_CHECK(pooling_w > 0 && pooling_h > 0)
             << "The pooling parameter is set incorrectly. It must always be greater than 0";
 
     std::shared_ptr<Tensor<float>> output_data = outputs.at(i);
@@ -56,28 +181,99 @@ InferStatus AdaptiveAveragePoolingLayer::Forward(const std::vector<std::shared_p
     CHECK (output_data->rows() == output_h_ && output_data->cols() == output_w_
                && output_data->channels() == input_c) << "The output size of adaptive pooling is error";
 
-    for (uint32_t ic = 0; ic < input_c; ++ic) {
-      const arma::fmat &input_channel = input_data->at(ic);
-      arma::fmat &output_channel = output_data->at(ic);
-      for (uint32_t c = 0; c < input_w - pooling_w + 1; c += stride_w) {
-        for (uint32_t r = 0; r < input_h - pooling_h + 1; r += stride_h) {
-
-          float mean_value = 0.f;
-          float *output_channel_ptr = output_channel.colptr(int(c / stride_w));
-          for (uint32_t w = 0; w < pooling_w; ++w) {
-            const float *col_ptr = input_channel.colptr(c + w) + r;
-            for (uint32_t h = 0; h < pooling_h; ++h) {
-              float current_value = *(col_ptr + h);
-              mean_value = mean_value + current_value;
-            }
-          }
-          *(output_channel_ptr + int(r / stride_h)) = mean_value / float(pooling_h * pooling_w);
-        }
-      }
-    }
+    // 窗口大小由输入的形状决定，每个样本选择一次内核，常见的窗口使用循环次数固定的实例
+    PoolingWindow window;
+    window.pooling_h = pooling_h;
+    window.pooling_w = pooling_w;
+    window.stride_h = stride_h;
+    window.stride_w = stride_w;
+    window.input_w = input_w;
+    window.output_h = output_h_;
+    window.output_w = output_w_;
+    const auto channel_kernel = SelectWindowKernel<AveragePoolingChannel>(pooling_h, pooling_w, stride_h, stride_w);
+    // 在通道之间并行
+    ThreadPool::Current().ParallelFor(0, input_c, [&](uint32_t ic) {
+      channel_kernel(window, input_data->at(ic), output_data->at(ic));
+    });
     outputs.at(i) = output_data;
+  });
+  return InferStatus::kInferSuccess;
+}
+
+bool AdaptiveAveragePoolingLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus AdaptiveAveragePoolingLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                                     std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+#ifdef USE_CUDA
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of average pooling layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  if (output_w_ <= 0 || output_h_ <= 0) {
+    LOG(ERROR) << "The size of the output feature map is less than zero";
+    return InferStatus::kInferFailedOutputSizeError;
+  }
+
+  // 和CPU上相同的窗口划分，全局平均池化是窗口覆盖整个输入的特例
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input_data != nullptr && !input_data->empty())
+            << "The input feature map of average pooling layer is empty";
+    const uint32_t input_h = input_data->rows();
+    const uint32_t input_w = input_data->cols();
+    const uint32_t input_c = input_data->channels();
+    const uint32_t stride_h = input_h / output_h_;
+    const uint32_t stride_w = input_w / output_w_;
+    KUIPER_FORWARD_CHECK(stride_w > 0 && stride_h > 0)
+            << "The stride parameter is set incorrectly. It must always be greater than 0";
+    const uint32_t pooling_h = input_h - (output_h_ - 1) * stride_h;
+    const uint32_t pooling_w = input_w - (output_w_ - 1) * stride_w;
+
+    std::shared_ptr<Tensor<float>> &output_data = outputs.at(i);
+    if (output_data == nullptr || output_data->empty()) {
+      output_data = std::make_shared<Tensor<float>>(input_c, output_h_, output_w_);
+    }
+    KUIPER_FORWARD_CHECK(output_data->rows() == output_h_ && output_data->cols() == output_w_
+              && output_data->channels() == input_c) << "The output size of adaptive pooling is error";
+
+    cuda::AveragePooling(input_data->cuda_data(), input_c, input_h, input_w, pooling_h, pooling_w, stride_h, stride_w,
+                         output_h_, output_w_, output_data->cuda_data());
+    output_data->set_device(DeviceType::kDeviceCUDA);
   }
   return InferStatus::kInferSuccess;
+#else
+  return Layer::ForwardCuda(inputs, outputs);
+#endif
+}
+
+bool AdaptiveAveragePoolingLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                                   std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  if (input_shape.at(2) < int32_t(output_h_) || input_shape.at(3) < int32_t(output_w_)) {
+    return false;
+  }
+  output_shape = {input_shape.at(0), input_shape.at(1), int32_t(output_h_), int32_t(output_w_)};
+  return true;
+}
+
+uint64_t AdaptiveAveragePoolingLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                            const std::vector<int32_t> &output_shape) const {
+  // 每个输入元素累加一次，每个输出元素再做一次除法
+  if (input_shapes.empty()) {
+    return Layer::Flops(input_shapes, output_shape);
+  }
+  return ShapeSize(input_shapes.front()) + ShapeSize(output_shape);
 }
 
 ParseParameterAttrStatus AdaptiveAveragePoolingLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
@@ -13,8 +13,28 @@ class AdaptiveAveragePoolingLayer : public Layer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  bool SupportDevice(DeviceType device) const override;
+
+  InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &avg_layer);
+
+  /**
+   * 输出为1x1时的全局平均池化，每个通道的平面在内存中连续，直接求和后取平均
+   * @param input 输入的特征图
+   * @param channel 计算的通道
+   * @return 该通道所有元素的平均值
+   */
+  static float GlobalAveragePooling(const std::shared_ptr<Tensor<float>> &input, uint32_t channel);
+
  private:
   uint32_t output_h_ = 0;
   uint32_t output_w_ = 0;
@@ -4,6 +4,8 @@
 #include "batchnorm2d.hpp"
 #include "layer/abstract/layer_factory.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "runtime/thread_pool.hpp"
+#include "../../kernels/cpu_kernels.hpp"
 
 namespace kuiper_infer {
 
@@ -31,13 +33,17 @@ InferStatus BatchNorm2dLayer::Forward(const std::vector<std::shared_ptr<Tensor<f
     return InferStatus::kInferFailedWeightParameterError;
   }
 
+  if (this->scale_.size() != mean_value_size || this->shift_.size() != mean_value_size) {
+    LOG(ERROR) << "BatchNorm2d layer do not have the scale and shift values";
+    return InferStatus::kInferFailedWeightParameterError;
+  }
+
   const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
-  for (uint32_t b = 0; b < batch_size; ++b) {
+  ThreadPool::Current().ParallelFor(0, batch_size, [&](uint32_t b) {
     const auto &input = inputs.at(b);
-    CHECK(input != nullptr && !input->empty()) << "The input feature map of batchnorm layer is empty";
-    CHECK(input->channels() == mean_value_size) << "The channel of of input and mean value mat is not equal";
-    CHECK(input->channels() == affine_weight_.size()) << "The channel of input and affine weight is not equal";
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map of batchnorm layer is empty";
+    KUIPER_FORWARD_CHECK(input->channels() == mean_value_size)
+            << "The channel of of input and mean value mat is not equal";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(b);
     if (output == nullptr || output->empty()) {
@@ -45,19 +51,66 @@ InferStatus BatchNorm2dLayer::Forward(const std::vector<std::shared_ptr<Tensor<f
       output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
     }
 
-    CHECK(output->shapes() == input->shapes()) << "The output size of batchnorm is error";
+    KUIPER_FORWARD_CHECK(output->shapes() == input->shapes()) << "The output size of batchnorm is error";
+
+    // 在通道之间并行
+    // (x - mean) / sqrt(var + eps) * weight + bias在加载时合并为一次乘加，输出和输入相同时原地计算
+    const CpuKernels &kernels = CurrentCpuKernels();
+    const uint32_t plane_size = input->rows() * input->cols();
+    ThreadPool::Current().ParallelFor(0, mean_value_size, [&](uint32_t i) {
+      kernels.scale_shift(input->at(i).memptr(), plane_size, scale_.at(i), shift_.at(i), output->at(i).memptr());
+    });
+    outputs.at(b) = output;
+  });
+  return InferStatus::kInferSuccess;
+}
+
+void BatchNorm2dLayer::set_weights(const float *weights, uint32_t size) {
+  ParamLayer::set_weights(weights, size);
+  this->UpdateScaleShift();
+}
 
-    for (uint32_t i = 0; i < mean_value_size; ++i) {
-      const float mean_value = weights_.at(i)->index(0);
-      const float var_value = bias_.at(i)->index(0);
-      CHECK(input->channels() >= i) << "The channel of the input feature maps and mean values is not adapting";
+void BatchNorm2dLayer::set_bias(const float *bias, uint32_t size) {
+  ParamLayer::set_bias(bias, size);
+  this->UpdateScaleShift();
+}
 
-      float var_value_ = std::sqrt(var_value + eps_);
-      output->at(i) = ((input->at(i) - mean_value) / var_value_) * affine_weight_.at(i) + affine_bias_.at(i);
+void BatchNorm2dLayer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) {
+  ParamLayer::set_weights(weights);
+  this->UpdateScaleShift();
+}
+
+void BatchNorm2dLayer::set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bias) {
+  ParamLayer::set_bias(bias);
+  this->UpdateScaleShift();
+}
+
+void BatchNorm2dLayer::UpdateScaleShift() {
+  this->scale_.clear();
+  this->shift_.clear();
+  const uint32_t channels = this->weights_.size();
+  if (this->bias_.size() != channels || this->affine_weight_.size() != channels
+      || this->affine_bias_.size() != channels) {
+    return;
+  }
+  this->scale_.resize(channels);
+  this->shift_.resize(channels);
+  for (uint32_t i = 0; i < channels; ++i) {
+    const auto &mean = this->weights_.at(i);
+    const auto &var = this->bias_.at(i);
+    if (mean == nullptr || mean->empty() || var == nullptr || var->empty()) {
+      this->scale_.clear();
+      this->shift_.clear();
+      return;
     }
-    outputs.at(b) = output;
+    const float scale = affine_weight_.at(i) / std::sqrt(var->index(0) + eps_);
+    this->scale_.at(i) = scale;
+    this->shift_.at(i) = affine_bias_.at(i) - mean->index(0) * scale;
   }
-  return InferStatus::kInferSuccess;
+}
+
+bool BatchNorm2dLayer::SupportInPlace() const {
+  return true;
 }
 
 ParseParameterAttrStatus BatchNorm2dLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
@@ -108,13 +161,18 @@ ParseParameterAttrStatus BatchNorm2dLayer::GetInstance(const std::shared_ptr<Run
     return ParseParameterAttrStatus::kAttrMissingBias;
   }
 
-  const std::vector<float> &affine_weight = attrs.at("weight")->get<float>();
-  const std::vector<float> &affine_bias = attrs.at("bias")->get<float>();
-  batch_layer = std::make_shared<BatchNorm2dLayer>(num_features->value, eps->value, affine_weight, affine_bias);
+  std::vector<float> buffer;
+  const auto &affine_weight_attr = attrs.at("weight");
+  const float *affine_weight = affine_weight_attr->view<float>(buffer);
+  std::vector<float> affine_weight_values(affine_weight, affine_weight + affine_weight_attr->element_num());
+  const auto &affine_bias_attr = attrs.at("bias");
+  const float *affine_bias = affine_bias_attr->view<float>(buffer);
+  std::vector<float> affine_bias_values(affine_bias, affine_bias + affine_bias_attr->element_num());
+  batch_layer = std::make_shared<BatchNorm2dLayer>(num_features->value, eps->value, affine_weight_values,
+                                                   affine_bias_values);
 
   const auto &mean_attr = attrs.at("running_mean");
-  const std::vector<float> &mean = mean_attr->get<float>();
-  batch_layer->set_weights(mean);
+  batch_layer->set_weights(mean_attr->view<float>(buffer), mean_attr->element_num());
 
   if (attrs.find("running_var") == attrs.end()) {
     LOG(ERROR) << "Can not find the running var attribute";
@@ -122,8 +180,7 @@ ParseParameterAttrStatus BatchNorm2dLayer::GetInstance(const std::shared_ptr<Run
   }
 
   const auto &var_attr = attrs.at("running_var");
-  const std::vector<float> &var = var_attr->get<float>();
-  batch_layer->set_bias(var);
+  batch_layer->set_bias(var_attr->view<float>(buffer), var_attr->element_num());
   return ParseParameterAttrStatus::kParameterAttrParseSuccess;
 }
 
@@ -137,6 +194,7 @@ BatchNorm2dLayer::BatchNorm2dLayer(uint32_t num_features, float eps,
     std::shared_ptr<Tensor<float>> bias = std::make_shared<Tensor<float>>(1, 1, 1);
     this->bias_.push_back(bias);
   }
+  this->UpdateScaleShift();
 }
 
 LayerRegistererWrapper kBatchNorm2dGetInstance("nn.BatchNorm2d", BatchNorm2dLayer::GetInstance);
@@ -16,15 +16,52 @@ class BatchNorm2dLayer : public ParamLayer {
                             const std::vector<float> &affine_weight,
                             const std::vector<float> &affine_bias);
 
+  /**
+   * 每个通道计算一次乘加，输出张量可以就是输入张量，此时原地计算
+   * @param inputs 层的输入
+   * @param outputs 层的输出
+   * @return 执行的状态
+   */
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool SupportInPlace() const override;
+
+  using ParamLayer::set_weights;
+
+  using ParamLayer::set_bias;
+
+  /**
+   * 设置每个通道的均值，并重新计算每个通道的缩放和偏移
+   * @param weights 均值
+   * @param size 通道数量
+   */
+  void set_weights(const float *weights, uint32_t size) override;
+
+  /**
+   * 设置每个通道的方差，并重新计算每个通道的缩放和偏移
+   * @param bias 方差
+   * @param size 通道数量
+   */
+  void set_bias(const float *bias, uint32_t size) override;
+
+  void set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) override;
+
+  void set_bias(const std::vector<std::shared_ptr<Tensor<float>>> &bias) override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &batch_layer);
  private:
+  /**
+   * 根据均值、方差和仿射参数计算每个通道的缩放和偏移，参数数量不一致时清空
+   */
+  void UpdateScaleShift();
+
   float eps_ = 1e-5;
   std::vector<float> affine_weight_;
   std::vector<float> affine_bias_;
+  std::vector<float> scale_; /// 每个通道的缩放，weight / sqrt(var + eps)
+  std::vector<float> shift_; /// 每个通道的偏移，bias - mean * scale
 };
 }
 
@@ -26,26 +26,32 @@ InferStatus CatLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
   }
 
   const uint32_t output_size = outputs.size();
-  CHECK(inputs.size() % output_size == 0);
-  const uint32_t packet_size = inputs.size() / output_size;
+  KUIPER_FORWARD_CHECK(inputs.size() % output_size == 0);
 
   for (uint32_t i = 0; i < outputs.size(); ++i) {
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     uint32_t start_channel = 0;
     uint32_t rows = inputs.front()->rows();
     uint32_t cols = inputs.front()->cols();
+    uint32_t total_channels = 0;
+    for (uint32_t j = i; j < inputs.size(); j += output_size) {
+      total_channels += inputs.at(j)->channels();
+    }
 
     for (uint32_t j = i; j < inputs.size(); j += output_size) {
       const std::shared_ptr<Tensor<float>> &input = inputs.at(j);
       const uint32_t in_channels = input->channels();
-      CHECK(rows == input->rows() && cols == input->cols());
+      KUIPER_FORWARD_CHECK(rows == input->rows() && cols == input->cols());
 
       if (output == nullptr || output->empty()) {
-        output = std::make_shared<Tensor<float>>(in_channels * packet_size, rows, cols);
+        output = std::make_shared<Tensor<float>>(total_channels, rows, cols);
       }
-      CHECK(output->channels() == in_channels * packet_size && output->rows() == rows && output->cols() == cols);
-      for (uint32_t c = 0; c < in_channels; ++c) {
-        output->at(start_channel + c) = input->at(c);
+      KUIPER_FORWARD_CHECK(output->channels() == total_channels && output->rows() == rows && output->cols() == cols);
+      // 内存规划让来源节点直接写在输出中对应的位置，此时不需要复制
+      if (input->data().memptr() != output->at(start_channel).memptr()) {
+        for (uint32_t c = 0; c < in_channels; ++c) {
+          output->at(start_channel + c) = input->at(c);
+        }
       }
       start_channel += input->channels();
     }
@@ -54,6 +60,25 @@ InferStatus CatLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
   return InferStatus::kInferSuccess;
 }
 
+bool CatLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || (dim_ != 1 && dim_ != -3)) {
+    return false;
+  }
+  output_shape = input_shapes.front();
+  if (output_shape.size() != 4) {
+    return false;
+  }
+  for (uint32_t i = 1; i < input_shapes.size(); ++i) {
+    const std::vector<int32_t> &input_shape = input_shapes.at(i);
+    if (input_shape.size() != 4 || input_shape.at(2) != output_shape.at(2) || input_shape.at(3) != output_shape.at(3)) {
+      return false;
+    }
+    output_shape.at(1) += input_shape.at(1);
+  }
+  return true;
+}
+
 ParseParameterAttrStatus CatLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                std::shared_ptr<Layer> &cat_layer) {
   CHECK(op != nullptr) << "Cat operator is nullptr";
@@ -13,6 +13,9 @@ class CatLayer : public Layer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                        std::shared_ptr<Layer> &cat_layer);
  private:
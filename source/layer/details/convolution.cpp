@@ -4,11 +4,145 @@
 
 #include "convolution.hpp"
 #include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <sstream>
 
 #include "runtime/runtime_ir.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "runtime/thread_pool.hpp"
+#include "runtime/cpu_feature.hpp"
+#include "../../kernels/cpu_kernels.hpp"
+#ifdef USE_CUDA
+#include "../../backend/cuda/cuda_kernels.hpp"
+#endif
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace kuiper_infer {
+#if defined(__AVX512F__)
+/// 通道分块布局中每个位置的一个向量，AVX-512一次处理16个通道
+struct ChannelVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm512_fmadd_ps(x, y, z); }
+};
+#elif defined(__AVX2__)
+/// 通道分块布局中每个位置的一个向量，AVX2一次处理8个通道
+struct ChannelVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+#if defined(__FMA__)
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_fmadd_ps(x, y, z); }
+#else
+  static Type MultiplyAdd(Type x, Type y, Type z) { return _mm256_add_ps(_mm256_mul_ps(x, y), z); }
+#endif
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// 通道分块布局中每个位置的一个向量，NEON一次处理4个通道
+struct ChannelVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type MultiplyAdd(Type x, Type y, Type z) { return vfmaq_f32(z, x, y); }
+};
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define KUIPER_CONV_CHANNEL_BLOCK
+#endif
+
+constexpr size_t kIm2ColTileBytes = 512 * 1024; /// im2col每个块使用的内存大小
+constexpr uint32_t kIm2ColMinTileRows = 16; /// im2col每个块最少的输出位置数量
+
+/**
+ * 计算卷积核在某个偏移位置上，对应的输入没有越出边界的输出区间[begin, end)
+ * @param kernel_offset 卷积核内的偏移位置
+ * @param padding 填充的大小
+ * @param stride 步长
+ * @param input_size 没有填充的输入大小
+ * @param output_size 输出大小
+ * @param begin 输出区间的起点
+ * @param end 输出区间的终点
+ */
+static void ValidOutputRange(uint32_t kernel_offset, uint32_t padding, uint32_t stride, uint32_t input_size,
+                             uint32_t output_size, uint32_t &begin, uint32_t &end) {
+  // 输出位置o对应的输入位置是o * stride + kernel_offset - padding
+  begin = kernel_offset >= padding ? 0 : (padding - kernel_offset + stride - 1) / stride;
+  if (input_size + padding <= kernel_offset) {
+    end = 0;
+  } else {
+    end = std::min(output_size, (input_size + padding - kernel_offset - 1) / stride + 1);
+  }
+  begin = std::min(begin, end);
+}
+
+/// im2col展开一个输入通道的内核，窗口大小和步长不为0时是编译期常量，卷积核位置的循环可以完全展开，
+/// 步长大于1时的跨步复制也使用固定的步长
+template<uint32_t kKernelH, uint32_t kKernelW, uint32_t kStrideH, uint32_t kStrideW>
+struct Im2ColChannel {
+  using Function = Im2ColKernel;
+
+  static void Run(const Im2ColWindow &window, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                  uint32_t channel, float *channel_columns) {
+    const uint32_t kernel_h = FixedOr<kKernelH>(window.kernel_h);
+    const uint32_t kernel_w = FixedOr<kKernelW>(window.kernel_w);
+    const uint32_t stride_h = FixedOr<kStrideH>(window.stride_h);
+    const uint32_t stride_w = FixedOr<kStrideW>(window.stride_w);
+    const uint32_t output_h = window.output_h;
+    const uint32_t col_len = output_h * window.output_w;
+    for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+      uint32_t col_begin = 0;
+      uint32_t col_end = 0;
+      ValidOutputRange(kw, window.padding_w, stride_w, window.input_w, window.output_w, col_begin, col_end);
+      for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+        uint32_t row_begin = 0;
+        uint32_t row_end = 0;
+        ValidOutputRange(kh, window.padding_h, stride_h, window.input_h, output_h, row_begin, row_end);
+
+        // 块内的输出位置按照输出列切分成连续的片段，越过边界的位置直接写入填充的0
+        float *input_matrix_ptr = channel_columns + size_t(kw * kernel_h + kh) * window.column_stride;
+        uint32_t position = window.position_begin;
+        while (position < window.position_end) {
+          const uint32_t i = position / col_len;
+          const uint32_t c = (position % col_len) / output_h;
+          const uint32_t r = position % output_h;
+          const uint32_t len = std::min(output_h - r, window.position_end - position);
+          float *run_ptr = input_matrix_ptr + (position - window.position_begin);
+          position += len;
+
+          if (c < col_begin || c >= col_end) {
+            std::fill(run_ptr, run_ptr + len, 0.f);
+            continue;
+          }
+          const uint32_t valid_begin = std::min(std::max(row_begin, r), r + len);
+          const uint32_t valid_end = std::max(std::min(row_end, r + len), valid_begin);
+          const float *col_ptr = inputs.at(i)->at(channel).colptr(c * stride_w + kw - window.padding_w);
+          std::fill(run_ptr, run_ptr + (valid_begin - r), 0.f);
+          if (stride_h == 1) {
+            memcpy(run_ptr + (valid_begin - r), col_ptr + (valid_begin + kh - window.padding_h),
+                   (valid_end - valid_begin) * sizeof(float));
+          } else {
+            for (uint32_t rr = valid_begin; rr < valid_end; ++rr) {
+              run_ptr[rr - r] = col_ptr[rr * stride_h + kh - window.padding_h];
+            }
+          }
+          std::fill(run_ptr + (valid_end - r), run_ptr + len, 0.f);
+        }
+      }
+    }
+  }
+};
 
 ConvolutionLayer::ConvolutionLayer(uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
                                    uint32_t kernel_w, uint32_t padding_h, uint32_t padding_w, uint32_t stride_h,
@@ -28,6 +162,665 @@ ConvolutionLayer::ConvolutionLayer(uint32_t output_channel, uint32_t in_channel,
       this->bias_.push_back(bias);
     }
   }
+  this->im2col_kernel_ = SelectWindowKernel<Im2ColChannel>(kernel_h, kernel_w, stride_h, stride_w);
+  this->InitPackedWeights();
+}
+
+void ConvolutionLayer::set_weights(const float *weights, uint32_t size) {
+  ParamLayer::set_weights(weights, size);
+  this->InitPackedWeights();
+}
+
+void ConvolutionLayer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) {
+  ParamLayer::set_weights(weights);
+  this->InitPackedWeights();
+}
+
+void ConvolutionLayer::set_use_winograd(bool use_winograd) {
+  this->use_winograd_ = use_winograd;
+  // 调优结果中可能包含不再允许的Winograd算法
+  tuned_algorithms_.clear();
+}
+
+void ConvolutionLayer::set_residual(bool residual) {
+  this->residual_ = residual;
+  // 加上残差之后不再使用逐通道卷积，调优结果需要重新选择
+  tuned_algorithms_.clear();
+}
+
+bool ConvolutionLayer::residual() const {
+  return this->residual_;
+}
+
+void ConvolutionLayer::InitPackedWeights() {
+  tuned_algorithms_.clear();
+  cuda_kernel_.reset();
+  cuda_bias_.reset();
+  kernel_matrix_arr_.clear();
+  winograd_kernel_arr_.clear();
+  packed_kernel_arr_.clear();
+  packed_winograd_kernel_arr_.clear();
+  sparse_kernel_arr_.clear();
+  if (weights_.empty() || groups_ == 0) {
+    return;
+  }
+  const uint32_t kernel_count = this->weights_.size();
+  CHECK(kernel_count % groups_ == 0);
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  const std::shared_ptr<Tensor<float>> &first_kernel = this->weights_.front();
+  CHECK(first_kernel != nullptr && !first_kernel->empty());
+  const uint32_t input_c_group = first_kernel->channels();
+  const uint32_t row_len = first_kernel->rows() * first_kernel->cols();
+
+  kernel_matrix_arr_.resize(groups_);
+  for (uint32_t g = 0; g < groups_; ++g) {
+    arma::fmat &kernel_matrix = kernel_matrix_arr_.at(g);
+    kernel_matrix.set_size(row_len * input_c_group, kernel_count_group);
+    for (uint32_t k = 0; k < kernel_count_group; ++k) {
+      const std::shared_ptr<Tensor<float>> &kernel = this->weights_.at(k + g * kernel_count_group);
+      CHECK(kernel->channels() == input_c_group && kernel->rows() == first_kernel->rows()
+                && kernel->cols() == first_kernel->cols()) << "The kernels of convolution have different shapes";
+      for (uint32_t ic = 0; ic < input_c_group; ++ic) {
+        memcpy(kernel_matrix.colptr(k) + row_len * ic, kernel->at(ic).memptr(), row_len * sizeof(float));
+      }
+    }
+  }
+  // 剪枝之后大部分权重为0的卷积核按输出通道压缩，im2col和1x1卷积只对非零权重做乘加
+  // Winograd变换之后的卷积核不再稀疏，稀疏的卷积不创建变换后的卷积核
+  float zero_ratio = 0.f;
+  for (const arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+    zero_ratio += ZeroRatio(kernel_matrix.memptr(), kernel_matrix.n_elem) / float(groups_);
+  }
+  if (zero_ratio >= SparseThreshold()) {
+    for (const arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+      sparse_kernel_arr_.push_back(SparsifyColumns(kernel_matrix.memptr(), kernel_matrix.n_rows,
+                                                   kernel_matrix.n_cols, 1, kernel_matrix.n_rows));
+    }
+    return;
+  }
+  // 内置的矩阵乘法直接读取打包好的卷积核，每次计算时不需要再打包
+  const bool pack_builtin = CurrentGemmBackend() == GemmBackend::kBuiltin;
+  if (pack_builtin) {
+    for (const arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+      packed_kernel_arr_.push_back(GemmPackB(false, kernel_matrix.n_rows, kernel_matrix.n_cols,
+                                             kernel_matrix.memptr(), kernel_matrix.n_rows));
+    }
+  }
+
+  if (first_kernel->rows() != 3 || first_kernel->cols() != 3 || stride_h_ != 1 || stride_w_ != 1) {
+    return;
+  }
+  // Winograd F(2x2,3x3)的卷积核变换U = G * g * G^T
+  winograd_kernel_arr_.resize(groups_);
+  for (uint32_t g = 0; g < groups_; ++g) {
+    std::vector<arma::fmat> &kernel_matrices = winograd_kernel_arr_.at(g);
+    kernel_matrices.assign(16, arma::fmat(input_c_group, kernel_count_group));
+    for (uint32_t k = 0; k < kernel_count_group; ++k) {
+      const std::shared_ptr<Tensor<float>> &kernel = this->weights_.at(k + g * kernel_count_group);
+      for (uint32_t ic = 0; ic < input_c_group; ++ic) {
+        const arma::fmat &kernel_channel = kernel->at(ic);
+        float temp[4][3];
+        for (uint32_t j = 0; j < 3; ++j) {
+          const float g0 = kernel_channel.at(0, j);
+          const float g1 = kernel_channel.at(1, j);
+          const float g2 = kernel_channel.at(2, j);
+          temp[0][j] = g0;
+          temp[1][j] = (g0 + g1 + g2) * 0.5f;
+          temp[2][j] = (g0 - g1 + g2) * 0.5f;
+          temp[3][j] = g2;
+        }
+        for (uint32_t i = 0; i < 4; ++i) {
+          kernel_matrices.at(i * 4 + 0).at(ic, k) = temp[i][0];
+          kernel_matrices.at(i * 4 + 1).at(ic, k) = (temp[i][0] + temp[i][1] + temp[i][2]) * 0.5f;
+          kernel_matrices.at(i * 4 + 2).at(ic, k) = (temp[i][0] - temp[i][1] + temp[i][2]) * 0.5f;
+          kernel_matrices.at(i * 4 + 3).at(ic, k) = temp[i][2];
+        }
+      }
+    }
+    if (pack_builtin) {
+      std::vector<GemmPackedMatrix> packed_matrices;
+      for (const arma::fmat &kernel_matrix : kernel_matrices) {
+        packed_matrices.push_back(GemmPackB(false, kernel_matrix.n_rows, kernel_matrix.n_cols,
+                                            kernel_matrix.memptr(), kernel_matrix.n_rows));
+      }
+      packed_winograd_kernel_arr_.push_back(std::move(packed_matrices));
+    }
+  }
+}
+
+std::vector<float> ConvolutionLayer::GroupBias(uint32_t group) const {
+  std::vector<float> bias_values;
+  if (this->bias_.empty() || !this->use_bias_) {
+    return bias_values;
+  }
+  const uint32_t kernel_count_group = this->weights_.size() / groups_;
+  for (uint32_t k = 0; k < kernel_count_group; ++k) {
+    bias_values.push_back(this->bias_.at(k + group * kernel_count_group)->index(0));
+  }
+  return bias_values;
+}
+
+void ConvolutionLayer::WinogradForward(const std::shared_ptr<Tensor<float>> &input,
+                                       const std::shared_ptr<Tensor<float>> &output,
+                                       const std::shared_ptr<Tensor<float>> &residual, uint32_t group,
+                                       float *workspace) const {
+  const std::vector<arma::fmat> &kernel_matrices = winograd_kernel_arr_.at(group);
+  const uint32_t input_c_group = kernel_matrices.front().n_rows;
+  const uint32_t kernel_count_group = kernel_matrices.front().n_cols;
+  const uint32_t input_h = input->rows();
+  const uint32_t input_w = input->cols();
+  const uint32_t output_h = output->rows();
+  const uint32_t output_w = output->cols();
+
+  // 每个4x4的输入块得到2x2的输出块，相邻输入块之间重叠两行或两列
+  const uint32_t tile_h = (output_h + 1) / 2;
+  const uint32_t tile_w = (output_w + 1) / 2;
+  const uint32_t tile_num = tile_h * tile_w;
+
+  // 输入变换V = B^T * d * B，16个位置分别是一个输入块数*输入通道数的矩阵
+  std::vector<arma::fmat> input_matrices;
+  std::vector<arma::fmat> output_matrices;
+  for (uint32_t i = 0; i < 16; ++i) {
+    input_matrices.emplace_back(workspace + i * tile_num * input_c_group, tile_num, input_c_group, false, true);
+  }
+  float *output_workspace = workspace + 16 * tile_num * input_c_group;
+  for (uint32_t i = 0; i < 16; ++i) {
+    output_matrices.emplace_back(output_workspace + i * tile_num * kernel_count_group, tile_num,
+                                 kernel_count_group, false, true);
+  }
+  ThreadPool::Current().ParallelFor(0, input_c_group, [&](uint32_t ic) {
+    const arma::fmat &input_channel = input->at(ic + group * input_c_group);
+    float *input_ptrs[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+      input_ptrs[i] = input_matrices.at(i).colptr(ic);
+    }
+
+    float d[4][4];
+    float temp[4][4];
+    for (uint32_t tx = 0; tx < tile_w; ++tx) {
+      for (uint32_t ty = 0; ty < tile_h; ++ty) {
+        // 越过边界的位置就是填充的0
+        for (uint32_t j = 0; j < 4; ++j) {
+          const int32_t c = int32_t(tx * 2 + j) - int32_t(padding_w_);
+          for (uint32_t i = 0; i < 4; ++i) {
+            const int32_t r = int32_t(ty * 2 + i) - int32_t(padding_h_);
+            const bool inside = r >= 0 && c >= 0 && r < int32_t(input_h) && c < int32_t(input_w);
+            d[i][j] = inside ? input_channel.at(r, c) : 0.f;
+          }
+        }
+        for (uint32_t j = 0; j < 4; ++j) {
+          temp[0][j] = d[0][j] - d[2][j];
+          temp[1][j] = d[1][j] + d[2][j];
+          temp[2][j] = d[2][j] - d[1][j];
+          temp[3][j] = d[1][j] - d[3][j];
+        }
+        const uint32_t tile_index = ty + tx * tile_h;
+        for (uint32_t i = 0; i < 4; ++i) {
+          input_ptrs[i * 4 + 0][tile_index] = temp[i][0] - temp[i][2];
+          input_ptrs[i * 4 + 1][tile_index] = temp[i][1] + temp[i][2];
+          input_ptrs[i * 4 + 2][tile_index] = temp[i][2] - temp[i][1];
+          input_ptrs[i * 4 + 3][tile_index] = temp[i][1] - temp[i][3];
+        }
+      }
+    }
+  });
+
+  // 每个位置上的逐元素乘法并在输入通道上求和，等价于16个独立的矩阵乘法
+  ThreadPool::Current().ParallelFor(0, 16, [&](uint32_t i) {
+    const arma::fmat &input_matrix = input_matrices.at(i);
+    const arma::fmat &kernel_matrix = kernel_matrices.at(i);
+    arma::fmat &output_matrix = output_matrices.at(i);
+    if (!packed_winograd_kernel_arr_.empty()) {
+      GemmPackedB(false, tile_num, input_matrix.memptr(), input_matrix.n_rows,
+                  packed_winograd_kernel_arr_.at(group).at(i), 0, kernel_count_group, output_matrix.memptr(),
+                  output_matrix.n_rows);
+    } else {
+      Gemm(false, false, tile_num, kernel_count_group, input_c_group, 1.f, input_matrix.memptr(),
+           input_matrix.n_rows, kernel_matrix.memptr(), kernel_matrix.n_rows, 0.f, output_matrix.memptr(),
+           output_matrix.n_rows);
+    }
+  });
+
+  // 输出变换Y = A^T * M * A
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, kernel_count_group, [&](uint32_t k) {
+    const uint32_t kernel_index = k + group * kernel_count_group;
+    arma::fmat &output_channel = output->at(kernel_index);
+    float bias = 0.f;
+    if (!this->bias_.empty() && this->use_bias_) {
+      bias = this->bias_.at(kernel_index)->index(0);
+    }
+
+    const float *output_ptrs[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+      output_ptrs[i] = output_matrices.at(i).colptr(k);
+    }
+
+    float temp[2][4];
+    for (uint32_t tx = 0; tx < tile_w; ++tx) {
+      for (uint32_t ty = 0; ty < tile_h; ++ty) {
+        const uint32_t tile_index = ty + tx * tile_h;
+        for (uint32_t j = 0; j < 4; ++j) {
+          const float m0 = output_ptrs[0 * 4 + j][tile_index];
+          const float m1 = output_ptrs[1 * 4 + j][tile_index];
+          const float m2 = output_ptrs[2 * 4 + j][tile_index];
+          const float m3 = output_ptrs[3 * 4 + j][tile_index];
+          temp[0][j] = m0 + m1 + m2;
+          temp[1][j] = m1 - m2 - m3;
+        }
+        for (uint32_t i = 0; i < 2; ++i) {
+          const uint32_t r = ty * 2 + i;
+          if (r >= output_h) {
+            continue;
+          }
+          const uint32_t c = tx * 2;
+          output_channel.at(r, c) = temp[i][0] + temp[i][1] + temp[i][2] + bias;
+          if (c + 1 < output_w) {
+            output_channel.at(r, c + 1) = temp[i][1] - temp[i][2] - temp[i][3] + bias;
+          }
+        }
+      }
+      // 这一列块的两列输出已经全部写完，趁还在缓存中加上残差并计算激活函数
+      const uint32_t col_num = std::min(2u, output_w - tx * 2);
+      if (residual != nullptr) {
+        const float *residual_ptr = residual->at(kernel_index).colptr(tx * 2);
+        kernels.element_binary(ElementOperation::kAdd, output_channel.colptr(tx * 2), false, residual_ptr, false,
+                               output_h * col_num, output_channel.colptr(tx * 2));
+      }
+      ApplyActivation(activation_, output_channel.colptr(tx * 2), output_h * col_num);
+    }
+  });
+}
+
+/**
+ * 计算im2col每个块包含的输出位置数量，使一个块展开后的输入和矩阵乘法的结果能够放在L2缓存中
+ * @param position_num 所有样本的输出位置数量
+ * @param row_size 每个输出位置展开后的元素数量加上输出通道数量
+ * @return 每个块的输出位置数量
+ */
+static uint32_t Im2ColTileRows(uint32_t position_num, size_t row_size) {
+  size_t tile_rows = kIm2ColTileBytes / (row_size * sizeof(float));
+  // 块太小时矩阵乘法的效率很低
+  tile_rows = std::max(tile_rows / kIm2ColMinTileRows * kIm2ColMinTileRows, size_t(kIm2ColMinTileRows));
+  return uint32_t(std::min(tile_rows, size_t(position_num)));
+}
+
+/**
+ * 计算一个通道的逐通道卷积，按列遍历输出使最内层循环在连续的行上进行，便于编译器向量化
+ * 越过边界的位置视为填充的0直接跳过
+ * @param input 没有填充的输入通道
+ * @param kernel 按列优先排列的卷积核
+ * @param bias 偏移量
+ * @param padding_h 高度方向的填充
+ * @param padding_w 宽度方向的填充
+ * @param activation 每一列输出计算完成后的激活函数
+ * @param output 输出通道
+ */
+template<uint32_t kernel_size, uint32_t stride>
+static void DepthwiseChannel(const arma::fmat &input, const float *kernel, float bias,
+                             uint32_t padding_h, uint32_t padding_w, ActivationType activation,
+                             arma::fmat &output) {
+  const uint32_t input_h = input.n_rows;
+  const uint32_t input_w = input.n_cols;
+  const uint32_t output_h = output.n_rows;
+  const uint32_t output_w = output.n_cols;
+
+  uint32_t row_begins[kernel_size];
+  uint32_t row_ends[kernel_size];
+  for (uint32_t kh = 0; kh < kernel_size; ++kh) {
+    ValidOutputRange(kh, padding_h, stride, input_h, output_h, row_begins[kh], row_ends[kh]);
+  }
+
+  for (uint32_t c = 0; c < output_w; ++c) {
+    float *output_ptr = output.colptr(c);
+    std::fill(output_ptr, output_ptr + output_h, bias);
+    for (uint32_t kw = 0; kw < kernel_size; ++kw) {
+      const int32_t input_c = int32_t(c * stride + kw) - int32_t(padding_w);
+      if (input_c < 0 || input_c >= int32_t(input_w)) {
+        continue;
+      }
+      const float *input_ptr = input.colptr(input_c);
+      for (uint32_t kh = 0; kh < kernel_size; ++kh) {
+        const uint32_t row_begin = row_begins[kh];
+        const uint32_t row_end = row_ends[kh];
+        if (row_begin >= row_end) {
+          continue;
+        }
+        const float weight = kernel[kh + kw * kernel_size];
+        const float *region_ptr = input_ptr + (row_begin * stride + kh - padding_h);
+        float *region_output_ptr = output_ptr + row_begin;
+        for (uint32_t r = 0; r < row_end - row_begin; ++r) {
+          region_output_ptr[r] += weight * region_ptr[r * stride];
+        }
+      }
+    }
+    ApplyActivation(activation, output_ptr, output_h);
+  }
+}
+
+#ifdef KUIPER_CONV_CHANNEL_BLOCK
+/**
+ * 计算一个通道块的逐通道卷积，输入先转换为NCHWc的分块布局，每个位置上连续存放该块所有通道的值，
+ * 向量的每个分量对应一个通道，不受步长和输出宽度的影响，转换时四周补上填充的0，计算时不需要判断边界
+ * @param input_planes 块中每个通道的输入，按列优先排列，不足一个块时剩余的为空
+ * @param kernel_block 分块布局的卷积核，每个卷积核位置上是块中所有通道的权重
+ * @param bias_block 块中每个通道的偏移量
+ * @param input_h 输入的高度
+ * @param input_w 输入的宽度
+ * @param padding_h 高度方向的填充
+ * @param padding_w 宽度方向的填充
+ * @param activation 输出计算完成后的激活函数
+ * @param output_h 输出的高度
+ * @param output_w 输出的宽度
+ * @param output_planes 块中每个通道的输出，按列优先排列
+ */
+template<uint32_t kernel_size, uint32_t stride>
+static void DepthwiseChannelBlock(const float *const *input_planes, const float *kernel_block,
+                                  const float *bias_block, uint32_t input_h, uint32_t input_w,
+                                  uint32_t padding_h, uint32_t padding_w, ActivationType activation,
+                                  uint32_t output_h, uint32_t output_w, float *const *output_planes) {
+  constexpr uint32_t block = ChannelVector::kWidth;
+  const uint32_t padded_h = input_h + 2 * padding_h;
+  const uint32_t padded_w = input_w + 2 * padding_w;
+
+  // 分块布局按列优先排列位置，每个位置是block个通道，只有填充的部分需要置0
+  // 一列的分块数据可以放在L1缓存中，按列转换时每个通道只写入这一列
+  thread_local std::vector<float> packed_input;
+  packed_input.resize(size_t(padded_h) * padded_w * block);
+  const size_t packed_column = size_t(padded_h) * block;
+  std::fill(packed_input.begin(), packed_input.begin() + padding_w * packed_column, 0.f);
+  std::fill(packed_input.end() - padding_w * packed_column, packed_input.end(), 0.f);
+  for (uint32_t c = 0; c < input_w; ++c) {
+    float *column_ptr = packed_input.data() + (size_t(c) + padding_w) * packed_column;
+    std::fill(column_ptr, column_ptr + padding_h * block, 0.f);
+    std::fill(column_ptr + (padding_h + input_h) * block, column_ptr + packed_column, 0.f);
+    for (uint32_t lane = 0; lane < block; ++lane) {
+      float *packed_ptr = column_ptr + padding_h * block + lane;
+      if (input_planes[lane] == nullptr) {
+        for (uint32_t r = 0; r < input_h; ++r) {
+          packed_ptr[r * block] = 0.f;
+        }
+        continue;
+      }
+      const float *input_ptr = input_planes[lane] + size_t(c) * input_h;
+      for (uint32_t r = 0; r < input_h; ++r) {
+        packed_ptr[r * block] = input_ptr[r];
+      }
+    }
+  }
+
+  ChannelVector::Type weights[kernel_size * kernel_size];
+  for (uint32_t k = 0; k < kernel_size * kernel_size; ++k) {
+    weights[k] = ChannelVector::Load(kernel_block + k * block);
+  }
+  const ChannelVector::Type bias = ChannelVector::Load(bias_block);
+
+  thread_local std::vector<float> output_column;
+  output_column.resize(size_t(output_h) * block);
+  for (uint32_t c = 0; c < output_w; ++c) {
+    const float *column_ptr = packed_input.data() + size_t(c) * stride * padded_h * block;
+    for (uint32_t r = 0; r < output_h; ++r) {
+      const float *window_ptr = column_ptr + size_t(r) * stride * block;
+      ChannelVector::Type sum = bias;
+      for (uint32_t kw = 0; kw < kernel_size; ++kw) {
+        for (uint32_t kh = 0; kh < kernel_size; ++kh) {
+          const ChannelVector::Type value = ChannelVector::Load(window_ptr + (size_t(kw) * padded_h + kh) * block);
+          sum = ChannelVector::MultiplyAdd(value, weights[kh + kw * kernel_size], sum);
+        }
+      }
+      ChannelVector::Store(output_column.data() + r * block, sum);
+    }
+    ApplyActivation(activation, output_column.data(), output_h * block);
+
+    // 转换回每个通道按列优先排列的布局
+    for (uint32_t lane = 0; lane < block; ++lane) {
+      if (output_planes[lane] == nullptr) {
+        continue;
+      }
+      float *output_ptr = output_planes[lane] + size_t(c) * output_h;
+      for (uint32_t r = 0; r < output_h; ++r) {
+        output_ptr[r] = output_column[r * block + lane];
+      }
+    }
+  }
+}
+#endif
+
+void ConvolutionLayer::DepthwiseForward(const std::shared_ptr<Tensor<float>> &input,
+                                        const std::shared_ptr<Tensor<float>> &output) const {
+  const uint32_t kernel_size = this->weights_.front()->rows();
+  const uint32_t kernel_count_group = this->weights_.size() / groups_;
+#ifdef KUIPER_CONV_CHANNEL_BLOCK
+  // 相邻的block个卷积核一起计算，每个向量对应block个输出通道
+  constexpr uint32_t block = ChannelVector::kWidth;
+  const uint32_t kernel_count = this->weights_.size();
+  const uint32_t block_count = (kernel_count + block - 1) / block;
+  ThreadPool::Current().ParallelFor(0, block_count, [&](uint32_t block_index) {
+    const float *input_planes[block] = {nullptr};
+    float *output_planes[block] = {nullptr};
+    float kernel_block[25 * block] = {0.f};
+    float bias_block[block] = {0.f};
+    for (uint32_t lane = 0; lane < block; ++lane) {
+      const uint32_t kernel_index = block_index * block + lane;
+      if (kernel_index >= kernel_count) {
+        break;
+      }
+      input_planes[lane] = input->at(kernel_index / kernel_count_group).memptr();
+      output_planes[lane] = output->at(kernel_index).memptr();
+      const float *kernel = this->weights_.at(kernel_index)->at(0).memptr();
+      for (uint32_t k = 0; k < kernel_size * kernel_size; ++k) {
+        kernel_block[k * block + lane] = kernel[k];
+      }
+      if (!this->bias_.empty() && this->use_bias_) {
+        bias_block[lane] = this->bias_.at(kernel_index)->index(0);
+      }
+    }
+
+    const uint32_t input_h = input->rows();
+    const uint32_t input_w = input->cols();
+    const uint32_t output_h = output->rows();
+    const uint32_t output_w = output->cols();
+    if (kernel_size == 3) {
+      if (stride_h_ == 1) {
+        DepthwiseChannelBlock<3, 1>(input_planes, kernel_block, bias_block, input_h, input_w, padding_h_, padding_w_,
+                                    activation_, output_h, output_w, output_planes);
+      } else {
+        DepthwiseChannelBlock<3, 2>(input_planes, kernel_block, bias_block, input_h, input_w, padding_h_, padding_w_,
+                                    activation_, output_h, output_w, output_planes);
+      }
+    } else {
+      if (stride_h_ == 1) {
+        DepthwiseChannelBlock<5, 1>(input_planes, kernel_block, bias_block, input_h, input_w, padding_h_, padding_w_,
+                                    activation_, output_h, output_w, output_planes);
+      } else {
+        DepthwiseChannelBlock<5, 2>(input_planes, kernel_block, bias_block, input_h, input_w, padding_h_, padding_w_,
+                                    activation_, output_h, output_w, output_planes);
+      }
+    }
+  });
+#else
+  ThreadPool::Current().ParallelFor(0, this->weights_.size(), [&](uint32_t kernel_index) {
+    const arma::fmat &input_channel = input->at(kernel_index / kernel_count_group);
+    const float *kernel = this->weights_.at(kernel_index)->at(0).memptr();
+    float bias = 0.f;
+    if (!this->bias_.empty() && this->use_bias_) {
+      bias = this->bias_.at(kernel_index)->index(0);
+    }
+
+    arma::fmat &output_channel = output->at(kernel_index);
+    if (kernel_size == 3) {
+      if (stride_h_ == 1) {
+        DepthwiseChannel<3, 1>(input_channel, kernel, bias, padding_h_, padding_w_, activation_, output_channel);
+      } else {
+        DepthwiseChannel<3, 2>(input_channel, kernel, bias, padding_h_, padding_w_, activation_, output_channel);
+      }
+    } else {
+      if (stride_h_ == 1) {
+        DepthwiseChannel<5, 1>(input_channel, kernel, bias, padding_h_, padding_w_, activation_, output_channel);
+      } else {
+        DepthwiseChannel<5, 2>(input_channel, kernel, bias, padding_h_, padding_w_, activation_, output_channel);
+      }
+    }
+  });
+#endif
+}
+
+void ConvolutionLayer::PointwiseForward(const std::shared_ptr<Tensor<float>> &input,
+                                        const std::shared_ptr<Tensor<float>> &output,
+                                        const std::shared_ptr<Tensor<float>> &residual, uint32_t group) const {
+  const arma::fmat &kernel_matrix = kernel_matrix_arr_.at(group);
+  const uint32_t input_c_group = kernel_matrix.n_rows;
+  const uint32_t kernel_count_group = kernel_matrix.n_cols;
+  const uint32_t plane_size = input->rows() * input->cols();
+  CHECK(output->rows() * output->cols() == plane_size);
+
+  // 一个分组的输入通道在内存中是连续的，可以直接看作plane_size * input_c_group的矩阵
+  const arma::fmat input_matrix(input->at(group * input_c_group).memptr(), plane_size, input_c_group, false, true);
+  float *output_ptr = output->at(group * kernel_count_group).memptr();
+
+  // 偏置、残差和激活函数在矩阵乘法写回输出时计算，残差和输出的布局相同
+  const std::vector<float> bias_values = GroupBias(group);
+  GemmEpilogue epilogue;
+  epilogue.col_bias = bias_values.empty() ? nullptr : bias_values.data();
+  epilogue.activation = activation_;
+  if (residual != nullptr) {
+    epilogue.residual = residual->at(group * kernel_count_group).memptr();
+    epilogue.ldr = plane_size;
+  }
+
+  // 使用打包的卷积核时每个线程负责的卷积核从面板的边界开始
+  const GemmPackedMatrix *packed_kernel = packed_kernel_arr_.empty() ? nullptr : &packed_kernel_arr_.at(group);
+  const SparseMatrix *sparse_kernel = sparse_kernel_arr_.empty() ? nullptr : &sparse_kernel_arr_.at(group);
+  const uint32_t panel = packed_kernel != nullptr ? packed_kernel->panel : 1;
+  const uint32_t panel_num = (kernel_count_group + panel - 1) / panel;
+  const uint32_t block_num = std::min(panel_num, ThreadPool::Current().thread_num());
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    const uint32_t kernel_begin = std::min(block * panel_num / block_num * panel, kernel_count_group);
+    const uint32_t kernel_end = std::min((block + 1) * panel_num / block_num * panel, kernel_count_group);
+    GemmEpilogue block_epilogue = epilogue;
+    if (block_epilogue.col_bias != nullptr) {
+      block_epilogue.col_bias += kernel_begin;
+    }
+    if (block_epilogue.residual != nullptr) {
+      block_epilogue.residual += size_t(kernel_begin) * plane_size;
+    }
+    if (sparse_kernel != nullptr) {
+      SparseGemm(plane_size, input_matrix.memptr(), plane_size, *sparse_kernel, kernel_begin,
+                 kernel_end - kernel_begin, output_ptr + kernel_begin * plane_size, plane_size, block_epilogue);
+    } else if (packed_kernel != nullptr) {
+      GemmPackedB(false, plane_size, input_matrix.memptr(), plane_size, *packed_kernel, kernel_begin,
+                  kernel_end - kernel_begin, output_ptr + kernel_begin * plane_size, plane_size, block_epilogue);
+    } else {
+      Gemm(false, false, plane_size, kernel_end - kernel_begin, input_c_group, 1.f, input_matrix.memptr(),
+           plane_size, kernel_matrix.colptr(kernel_begin), input_c_group, 0.f, output_ptr + kernel_begin * plane_size,
+           plane_size, block_epilogue);
+    }
+  });
+}
+
+void ConvolutionLayer::Im2ColForward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                     const std::vector<std::shared_ptr<Tensor<float>>> &outputs,
+                                     const std::vector<std::shared_ptr<Tensor<float>>> &residuals,
+                                     uint32_t group, float *workspace) const {
+  const arma::fmat &kernel_matrix = kernel_matrix_arr_.at(group);
+  const uint32_t kernel_count_group = kernel_matrix.n_cols;
+  const uint32_t kernel_h = this->weights_.front()->rows();
+  const uint32_t kernel_w = this->weights_.front()->cols();
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t input_c_group = kernel_matrix.n_rows / row_len;
+  const uint32_t batch_size = inputs.size();
+  const uint32_t input_h = inputs.front()->rows();
+  const uint32_t input_w = inputs.front()->cols();
+  const uint32_t output_h = outputs.front()->rows();
+  const uint32_t output_w = outputs.front()->cols();
+  const uint32_t col_len = output_h * output_w;
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    CHECK(outputs.at(i)->rows() == output_h && outputs.at(i)->cols() == output_w)
+            << "The output size of convolution in a batch is not the same";
+  }
+
+  // 块中的输出位置跨越多个样本，残差在复制回输出时加上，激活函数也推迟到那时计算
+  const std::vector<float> bias_values = GroupBias(group);
+  GemmEpilogue epilogue;
+  epilogue.col_bias = bias_values.empty() ? nullptr : bias_values.data();
+  epilogue.activation = residuals.empty() ? activation_ : ActivationType::kActivationNone;
+  const CpuKernels &kernels = CurrentCpuKernels();
+
+  Im2ColWindow window;
+  window.kernel_h = kernel_h;
+  window.kernel_w = kernel_w;
+  window.stride_h = stride_h_;
+  window.stride_w = stride_w_;
+  window.padding_h = padding_h_;
+  window.padding_w = padding_w_;
+  window.input_h = input_h;
+  window.input_w = input_w;
+  window.output_h = output_h;
+  window.output_w = output_w;
+
+  // 所有样本的输出位置排成一列，按照缓存大小切分成块，每块单独展开并做矩阵乘法
+  const uint32_t position_num = batch_size * col_len;
+  const uint32_t tile_rows = Im2ColTileRows(position_num, kernel_matrix.n_rows + kernel_count_group);
+  const uint32_t tile_num = (position_num + tile_rows - 1) / tile_rows;
+  const uint32_t block_num = std::min(tile_num, ThreadPool::Current().thread_num());
+  const size_t tile_size = size_t(tile_rows) * (kernel_matrix.n_rows + kernel_count_group);
+
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    // 每个线程使用临时内存中不同的区域，依次处理自己负责的块
+    float *tile_workspace = workspace + block * tile_size;
+    const uint32_t tile_begin = block * tile_num / block_num;
+    const uint32_t tile_end = (block + 1) * tile_num / block_num;
+    for (uint32_t tile = tile_begin; tile < tile_end; ++tile) {
+      const uint32_t position_begin = tile * tile_rows;
+      const uint32_t position_end = std::min(position_begin + tile_rows, position_num);
+      const uint32_t rows = position_end - position_begin;
+
+      // 每一行是一个样本的一个输出位置，每一列是一个输入通道上卷积核的一个位置，和kernel_matrix的行一一对应
+      arma::fmat input_matrix(tile_workspace, rows, kernel_matrix.n_rows, false, true);
+      arma::fmat output_matrix(tile_workspace + input_matrix.n_elem, rows, kernel_count_group, false, true);
+
+      Im2ColWindow tile_window = window;
+      tile_window.position_begin = position_begin;
+      tile_window.position_end = position_end;
+      tile_window.column_stride = rows;
+      for (uint32_t ic = 0; ic < input_c_group; ++ic) {
+        im2col_kernel_(tile_window, inputs, ic + group * input_c_group, input_matrix.colptr(ic * row_len));
+      }
+
+      // input_matrix * kernel_matrix的每一列是一个输出通道在这些位置上的结果，偏置和激活函数在写回块时计算
+      if (!sparse_kernel_arr_.empty()) {
+        SparseGemm(rows, input_matrix.memptr(), input_matrix.n_rows, sparse_kernel_arr_.at(group), 0,
+                   kernel_count_group, output_matrix.memptr(), output_matrix.n_rows, epilogue);
+      } else if (!packed_kernel_arr_.empty()) {
+        GemmPackedB(false, rows, input_matrix.memptr(), input_matrix.n_rows, packed_kernel_arr_.at(group), 0,
+                    kernel_count_group, output_matrix.memptr(), output_matrix.n_rows, epilogue);
+      } else {
+        Gemm(false, false, rows, kernel_count_group, input_matrix.n_cols, 1.f, input_matrix.memptr(),
+             input_matrix.n_rows, kernel_matrix.memptr(), kernel_matrix.n_rows, 0.f, output_matrix.memptr(),
+             output_matrix.n_rows, epilogue);
+      }
+      for (uint32_t k = 0; k < kernel_count_group; ++k) {
+        const uint32_t kernel_index = k + group * kernel_count_group;
+        const float *output_matrix_ptr = output_matrix.colptr(k);
+        uint32_t position = position_begin;
+        while (position < position_end) {
+          const uint32_t i = position / col_len;
+          const uint32_t offset = position % col_len;
+          const uint32_t len = std::min(col_len - offset, position_end - position);
+          float *output_ptr = outputs.at(i)->at(kernel_index).memptr() + offset;
+          if (residuals.empty()) {
+            memcpy(output_ptr, output_matrix_ptr + (position - position_begin), len * sizeof(float));
+          } else {
+            const float *residual_ptr = residuals.at(i)->at(kernel_index).memptr() + offset;
+            kernels.element_binary(ElementOperation::kAdd, output_matrix_ptr + (position - position_begin), false,
+                                   residual_ptr, false, len, output_ptr);
+            ApplyActivation(activation_, output_ptr, len);
+          }
+          position += len;
+        }
+      }
+    }
+  });
 }
 
 InferStatus ConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
@@ -37,6 +830,27 @@ InferStatus ConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tensor<f
     return InferStatus::kInferFailedInputEmpty;
   }
 
+  // 合并了残差连接时后一半输入是每个样本的残差
+  if (residual_) {
+    if (inputs.size() != outputs.size() * 2) {
+      LOG(ERROR) << "The input and output size is not adapting";
+      return InferStatus::kInferFailedInputOutSizeAdaptingError;
+    }
+    const std::vector<std::shared_ptr<Tensor<float>>> feature_inputs(inputs.begin(), inputs.begin() + outputs.size());
+    const std::vector<std::shared_ptr<Tensor<float>>> residuals(inputs.begin() + outputs.size(), inputs.end());
+    return ForwardResidual(feature_inputs, residuals, outputs);
+  }
+  return ForwardResidual(inputs, {}, outputs);
+}
+
+InferStatus ConvolutionLayer::ForwardResidual(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                              const std::vector<std::shared_ptr<Tensor<float>>> &residuals,
+                                              std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of convolution layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
   if (inputs.size() != outputs.size()) {
     LOG(ERROR) << "The input and output size is not adapting";
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
@@ -52,128 +866,460 @@ InferStatus ConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tensor<f
     return InferStatus::kInferFailedBiasParameterError;
   }
 
-  const uint32_t batch_size = inputs.size();
-
   if (!stride_h_ || !stride_w_) {
     LOG(ERROR) << "The stride parameter is set incorrectly. It must always be greater than 0";
     return InferStatus::kInferFailedStrideParameterError;
   }
 
-#pragma omp parallel for num_threads(batch_size)
-  for (uint32_t i = 0; i < batch_size; ++i) {
+  const std::shared_ptr<Tensor<float>> &first_input = inputs.front();
+  KUIPER_FORWARD_CHECK(first_input != nullptr && !first_input->empty())
+          << "The input feature map of conv layer is empty";
+  return ForwardAlgorithm(inputs, outputs,
+                          ChooseAlgorithm(first_input->channels(), first_input->rows(), first_input->cols()),
+                          residuals);
+}
 
-    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input != nullptr && !input->empty()) << "The input feature map of conv layer is empty";
+InferStatus ConvolutionLayer::ForwardAlgorithm(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                               std::vector<std::shared_ptr<Tensor<float>>> &outputs,
+                                               ConvolutionAlgorithm algorithm,
+                                               const std::vector<std::shared_ptr<Tensor<float>>> &residuals) {
+  const uint32_t batch_size = inputs.size();
+  const std::shared_ptr<Tensor<float>> &first_input = inputs.front();
+  KUIPER_FORWARD_CHECK(kernel_matrix_arr_.size() == groups_) << "The packed weights of convolution is not initialized";
 
-    std::shared_ptr<Tensor<float>> input_;
-    if (padding_h_ > 0 || padding_w_ > 0) {
-      input_ = input->Clone();
-      input_->Padding({padding_h_, padding_h_, padding_w_, padding_w_}, 0);
-    } else {
-      input_ = input;
-    }
+  // 优先使用计算图分配的临时内存，单独调用时才临时申请
+  std::vector<float> workspace_buffer;
+  const size_t workspace_size = ComputeWorkspaceSize(algorithm, batch_size, first_input->channels(),
+                                                     first_input->rows(), first_input->cols());
+  float *workspace = AcquireWorkspace(workspace_size, workspace_buffer);
+
+  ThreadPool::Current().ParallelFor(0, batch_size, [&](uint32_t i) {
 
-    const uint32_t input_w = input_->cols();
-    const uint32_t input_h = input_->rows();
-    const uint32_t input_c = input_->channels();
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map of conv layer is empty";
+    KUIPER_FORWARD_CHECK(input->shapes() == first_input->shapes())
+            << "The input size of convolution in a batch is not the same";
+
+    // 填充由各个卷积算法在边界处理，不需要复制出填充后的输入
+    const uint32_t input_w = input->cols();
+    const uint32_t input_h = input->rows();
+    const uint32_t input_c = input->channels();
     const uint32_t kernel_count = this->weights_.size();
 
     uint32_t kernel_h = this->weights_.at(0)->rows();
     uint32_t kernel_w = this->weights_.at(0)->cols();
 
-    uint32_t output_h = uint32_t(std::floor((input_h - kernel_h) / stride_h_ + 1));
-    uint32_t output_w = uint32_t(std::floor((input_w - kernel_w) / stride_w_ + 1));
-    CHECK(output_h > 0 && output_w > 0) << "The size of the output feature map is less than zero";
+    KUIPER_FORWARD_CHECK(input_h + 2 * padding_h_ >= kernel_h && input_w + 2 * padding_w_ >= kernel_w)
+            << "The size of the output feature map is less than zero";
+    uint32_t output_h = uint32_t(std::floor((input_h + 2 * padding_h_ - kernel_h) / stride_h_ + 1));
+    uint32_t output_w = uint32_t(std::floor((input_w + 2 * padding_w_ - kernel_w) / stride_w_ + 1));
+    KUIPER_FORWARD_CHECK(output_h > 0 && output_w > 0) << "The size of the output feature map is less than zero";
+
+    // 每个卷积核的形状在打包权重时已经检查过，这里只检查输入通道
+    KUIPER_FORWARD_CHECK(input_c == this->weights_.at(0)->channels() * groups_)
+            << "The input channels of convolution is not adapting";
 
-    if (groups_ != 1) {
-      CHECK(kernel_count % groups_ == 0);
-      CHECK(input_c % groups_ == 0);
+    std::shared_ptr<Tensor<float>> output_tensor = outputs.at(i);
+    if (output_tensor == nullptr || output_tensor->empty()) {
+      output_tensor = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
     }
 
-    for (uint32_t k = 0; k < kernel_count; ++k) {
-      const std::shared_ptr<Tensor<float>> &kernel = this->weights_.at(k);
-      CHECK(kernel->rows() == kernel_h);
-      CHECK(kernel->cols() == kernel_w);
-      CHECK(kernel->channels() == input_c / groups_);
+    KUIPER_FORWARD_CHECK(output_tensor->rows() == output_h && output_tensor->cols() == output_w
+              && output_tensor->channels() == kernel_count) << "The output size of convolution is error";
+    outputs.at(i) = output_tensor;
+
+    // 残差和输出的形状相同，也不能是同一块内存，否则分块累加时会覆盖还没有读取的残差
+    const std::shared_ptr<Tensor<float>> residual = residuals.empty() ? nullptr : residuals.at(i);
+    KUIPER_FORWARD_CHECK(residual == nullptr || (residual->shapes() == output_tensor->shapes()
+        && residual->RawPtr() != output_tensor->RawPtr())) << "The residual of convolution is error";
+
+    if (algorithm == ConvolutionAlgorithm::kDepthwise) {
+      DepthwiseForward(input, output_tensor);
+    } else if (algorithm == ConvolutionAlgorithm::kWinograd) {
+      // 每个样本使用临时内存中不同的区域
+      float *sample_workspace = workspace + i * (workspace_size / batch_size);
+      for (uint32_t g = 0; g < groups_; ++g) {
+        WinogradForward(input, output_tensor, residual, g, sample_workspace);
+      }
+    } else if (algorithm == ConvolutionAlgorithm::kPointwise) {
+      for (uint32_t g = 0; g < groups_; ++g) {
+        PointwiseForward(input, output_tensor, residual, g);
+      }
     }
+  });
 
-    uint32_t row_len = kernel_w * kernel_h;
-    uint32_t col_len = output_h * output_w;
-    if (!col_len) {
-      col_len = 1;
+  // im2col将所有样本的展开结果拼接在一起，每个分组只做一次矩阵乘法
+  if (algorithm == ConvolutionAlgorithm::kIm2Col) {
+    for (uint32_t g = 0; g < groups_; ++g) {
+      Im2ColForward(inputs, outputs, residuals, g, workspace);
     }
+  }
+  return InferStatus::kInferSuccess;
+}
 
-    uint32_t input_c_group = input_c / groups_;
-    uint32_t kernel_count_group = kernel_count / groups_;
+ConvolutionAlgorithm ConvolutionLayer::SelectAlgorithm(uint32_t input_c) const {
+  const uint32_t kernel_h = this->weights_.front()->rows();
+  const uint32_t kernel_w = this->weights_.front()->cols();
+  const uint32_t input_c_group = input_c / groups_;
 
-    for (uint32_t g = 0; g < groups_; ++g) {
-      std::vector<arma::fmat> kernel_matrix_arr(kernel_count_group);
-      arma::fmat kernel_matrix_c(1, row_len * input_c_group);
+  // 每个分组只有一个输入通道的时候使用直接计算的逐通道卷积，逐通道卷积不支持残差
+  if (!residual_ && groups_ > 1 && input_c_group == 1 && kernel_h == kernel_w && (kernel_h == 3 || kernel_h == 5)
+      && stride_h_ == stride_w_ && (stride_h_ == 1 || stride_h_ == 2)) {
+    return ConvolutionAlgorithm::kDepthwise;
+  }
+  // 3x3步长为1的卷积使用Winograd算法，乘法次数减少到im2col的1/2.25
+  if (use_winograd_ && winograd_kernel_arr_.size() == groups_) {
+    return ConvolutionAlgorithm::kWinograd;
+  }
+  // 1x1步长为1的卷积不需要展开输入
+  if (kernel_h == 1 && kernel_w == 1 && stride_h_ == 1 && stride_w_ == 1 && padding_h_ == 0 && padding_w_ == 0) {
+    return ConvolutionAlgorithm::kPointwise;
+  }
+  return ConvolutionAlgorithm::kIm2Col;
+}
 
-      for (uint32_t k = 0; k < kernel_count_group; ++k) {
-        const std::shared_ptr<Tensor<float>> &kernel = this->weights_.at(k + g * kernel_count_group);
-        for (uint32_t ic = 0; ic < input_c_group; ++ic) {
-          memcpy(kernel_matrix_c.memptr() + row_len * ic,
-                 kernel->at(ic).memptr(), row_len * sizeof(float));
-        }
-        kernel_matrix_arr.at(k) = kernel_matrix_c;
-      }
+ConvolutionAlgorithm ConvolutionLayer::ChooseAlgorithm(uint32_t input_c, uint32_t input_h, uint32_t input_w) const {
+  if (!tuned_algorithms_.empty()) {
+    const auto &tuned = tuned_algorithms_.find({input_c, input_h, input_w, ThreadPool::Current().thread_num()});
+    if (tuned != tuned_algorithms_.end()) {
+      return tuned->second;
+    }
+  }
+  return SelectAlgorithm(input_c);
+}
 
-      arma::fmat input_matrix(input_c_group * row_len, col_len);
-      arma::fmat input_matrix_c(row_len, col_len);
+std::vector<ConvolutionAlgorithm> ConvolutionLayer::CandidateAlgorithms(uint32_t input_c) const {
+  std::vector<ConvolutionAlgorithm> algorithms{ConvolutionAlgorithm::kIm2Col};
+  const ConvolutionAlgorithm selected = SelectAlgorithm(input_c);
+  if (selected != ConvolutionAlgorithm::kIm2Col) {
+    algorithms.push_back(selected);
+  }
+  // 只有3x3步长为1的卷积会创建变换后的卷积核
+  if (selected != ConvolutionAlgorithm::kWinograd && use_winograd_ && winograd_kernel_arr_.size() == groups_) {
+    algorithms.push_back(ConvolutionAlgorithm::kWinograd);
+  }
+  const uint32_t kernel_h = this->weights_.front()->rows();
+  const uint32_t kernel_w = this->weights_.front()->cols();
+  if (selected != ConvolutionAlgorithm::kPointwise && kernel_h == 1 && kernel_w == 1 && stride_h_ == 1
+      && stride_w_ == 1 && padding_h_ == 0 && padding_w_ == 0) {
+    algorithms.push_back(ConvolutionAlgorithm::kPointwise);
+  }
+  return algorithms;
+}
 
-      for (uint32_t ic = 0; ic < input_c_group; ++ic) {
-        float *input_matrix_c_ptr = input_matrix_c.memptr();
-        const arma::fmat &input_channel = input_->at(ic + g * input_c_group);
-
-        uint32_t offset_index = 0;
-        for (uint32_t c = 0; c < input_w - kernel_w + 1; c += stride_w_) {
-          for (uint32_t r = 0; r < input_h - kernel_h + 1; r += stride_h_) {
-            for (uint32_t kw = 0; kw < kernel_w; ++kw) {
-              const float *region_ptr = input_channel.colptr(c + kw) + r;
-              memcpy(input_matrix_c_ptr + offset_index * kernel_h, region_ptr, kernel_h * sizeof(float));
-              offset_index += 1;
-            }
-          }
+bool ConvolutionLayer::Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) {
+  if (input_shapes.empty() || input_shapes.front().size() != 4 || this->weights_.empty()
+      || kernel_matrix_arr_.size() != groups_) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  const uint32_t batch_size = input_shape.at(0);
+  const uint32_t input_c = input_shape.at(1);
+  const uint32_t input_h = input_shape.at(2);
+  const uint32_t input_w = input_shape.at(3);
+  std::vector<int32_t> output_shape;
+  if (!InferOutputShape(input_shapes, output_shape)) {
+    return false;
+  }
+  const std::vector<ConvolutionAlgorithm> candidates = CandidateAlgorithms(input_c);
+  if (candidates.size() <= 1) {
+    return false;
+  }
+
+  // 键中包含影响算法快慢的所有参数，同一个缓存可以被多个模型共享
+  const uint32_t thread_num = ThreadPool::Current().thread_num();
+  std::ostringstream key;
+  key << "conv2d_o" << this->weights_.size() << "_k" << this->weights_.front()->rows() << "x"
+      << this->weights_.front()->cols() << "_s" << stride_h_ << "x" << stride_w_ << "_p" << padding_h_ << "x"
+      << padding_w_ << "_g" << groups_ << "_i" << batch_size << "x" << input_c << "x" << input_h << "x" << input_w
+      << "_t" << thread_num << "_" << CpuIsaName(CurrentCpuIsa());
+
+  ConvolutionAlgorithm best_algorithm = candidates.front();
+  int32_t cached_algorithm = 0;
+  if (cache.Find(key.str(), cached_algorithm)
+      && std::find(candidates.begin(), candidates.end(), ConvolutionAlgorithm(cached_algorithm)) != candidates.end()) {
+    best_algorithm = ConvolutionAlgorithm(cached_algorithm);
+  } else {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs(batch_size);
+    for (auto &input : inputs) {
+      input = std::make_shared<Tensor<float>>(input_c, input_h, input_w);
+      input->Rand();
+    }
+    std::vector<std::shared_ptr<Tensor<float>>> residuals;
+    if (residual_) {
+      residuals.resize(batch_size);
+      for (auto &residual : residuals) {
+        residual = std::make_shared<Tensor<float>>(output_shape.at(1), output_shape.at(2), output_shape.at(3));
+        residual->Rand();
+      }
+    }
+    // 每个算法预热一次之后取多次测量中最短的时间
+    constexpr uint32_t kTuneRepeat = 3;
+    double best_duration = 0.;
+    for (const ConvolutionAlgorithm algorithm : candidates) {
+      std::vector<float> workspace(ComputeWorkspaceSize(algorithm, batch_size, input_c, input_h, input_w));
+      WorkspaceScope workspace_scope(workspace.data(), workspace.size());
+      std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+      double duration = 0.;
+      for (uint32_t repeat = 0; repeat <= kTuneRepeat; ++repeat) {
+        const auto &start = std::chrono::steady_clock::now();
+        CHECK(ForwardAlgorithm(inputs, outputs, algorithm, residuals) == InferStatus::kInferSuccess);
+        const double current =
+            std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+        if (repeat == 1 || (repeat > 1 && current < duration)) {
+          duration = current;
         }
-        input_matrix.submat(ic * row_len, 0, ((ic + 1) * row_len) - 1, col_len - 1) = input_matrix_c;
       }
-
-      std::shared_ptr<Tensor<float>> output_tensor = outputs.at(i);
-      if (output_tensor == nullptr || output_tensor->empty()) {
-        output_tensor = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
+      if (algorithm == candidates.front() || duration < best_duration) {
+        best_duration = duration;
+        best_algorithm = algorithm;
       }
+    }
+    cache.Insert(key.str(), int32_t(best_algorithm));
+  }
+  tuned_algorithms_[{input_c, input_h, input_w, thread_num}] = best_algorithm;
+  return true;
+}
 
-      CHECK(output_tensor->rows() == output_h && output_tensor->cols() == output_w
-                && output_tensor->channels() == kernel_count) << "The output size of convolution is error";
+size_t ConvolutionLayer::ComputeWorkspaceSize(ConvolutionAlgorithm algorithm, uint32_t batch_size, uint32_t input_c,
+                                              uint32_t input_h, uint32_t input_w) const {
+  if (this->weights_.empty() || groups_ == 0) {
+    return 0;
+  }
+  const uint32_t kernel_h = this->weights_.front()->rows();
+  const uint32_t kernel_w = this->weights_.front()->cols();
+  if (input_h + 2 * padding_h_ < kernel_h || input_w + 2 * padding_w_ < kernel_w) {
+    return 0;
+  }
+  const size_t output_h = (input_h + 2 * padding_h_ - kernel_h) / stride_h_ + 1;
+  const size_t output_w = (input_w + 2 * padding_w_ - kernel_w) / stride_w_ + 1;
+  const size_t input_c_group = input_c / groups_;
+  const size_t kernel_count_group = this->weights_.size() / groups_;
 
-      std::vector<arma::fmat> outputs_matrix(kernel_count_group);
-      uint32_t thread_count = kernel_count_group < 32 ? kernel_count_group : 32;
-#pragma omp parallel for num_threads(thread_count)
-      for (uint32_t k = 0; k < kernel_count_group; ++k) {
-        const arma::fmat &output = kernel_matrix_arr.at(k) * input_matrix;
-        outputs_matrix.at(k) = output;
-      }
+  if (algorithm == ConvolutionAlgorithm::kWinograd) {
+    // 16个位置上的输入变换和矩阵乘法结果，每个样本一份
+    const size_t tile_num = ((output_h + 1) / 2) * ((output_w + 1) / 2);
+    return batch_size * 16 * tile_num * (input_c_group + kernel_count_group);
+  } else if (algorithm == ConvolutionAlgorithm::kIm2Col) {
+    // 每个线程一个块，存放块内展开后的输入和矩阵乘法的结果
+    const uint32_t position_num = batch_size * output_h * output_w;
+    const size_t row_size = input_c_group * kernel_h * kernel_w + kernel_count_group;
+    const uint32_t tile_rows = Im2ColTileRows(position_num, row_size);
+    const uint32_t tile_num = (position_num + tile_rows - 1) / tile_rows;
+    const uint32_t block_num = std::min(tile_num, ThreadPool::Current().thread_num());
+    return block_num * tile_rows * row_size;
+  }
+  return 0;
+}
 
-      for (uint32_t k = 0; k < kernel_count_group; ++k) {
-        std::shared_ptr<Tensor<float>> bias;
-        if (!this->bias_.empty() && this->use_bias_) {
-          bias = this->bias_.at(k);
-        }
-        arma::fmat output = outputs_matrix.at(k);
-        CHECK(output.size() == output_h * output_w);
+bool ConvolutionLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
 
-        output.reshape(output_h, output_w);
-        if (bias != nullptr) {
-          float bias_value = bias->index(0);
-          output += bias_value;
-        }
-        output_tensor->at(k + g * kernel_count_group) = std::move(output);
+InferStatus ConvolutionLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+#ifdef USE_CUDA
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of convolution layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  // 合并了残差连接时后一半输入是每个样本的残差，在计算偏置和激活函数时加上
+  if (inputs.size() != outputs.size() * (residual_ ? 2 : 1)) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  if (weights_.empty()) {
+    LOG(ERROR) << "Weight parameters is empty";
+    return InferStatus::kInferFailedWeightParameterError;
+  }
+
+  if (this->use_bias_ && this->bias_.size() != this->weights_.size()) {
+    LOG(ERROR) << "The size of the weight and bias is not adapting";
+    return InferStatus::kInferFailedBiasParameterError;
+  }
+
+  if (!stride_h_ || !stride_w_) {
+    LOG(ERROR) << "The stride parameter is set incorrectly. It must always be greater than 0";
+    return InferStatus::kInferFailedStrideParameterError;
+  }
+  KUIPER_FORWARD_CHECK(kernel_matrix_arr_.size() == groups_) << "The packed weights of convolution is not initialized";
+
+  const uint32_t kernel_count = this->weights_.size();
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  const uint32_t kernel_h = this->weights_.at(0)->rows();
+  const uint32_t kernel_w = this->weights_.at(0)->cols();
+  const uint32_t row_len = kernel_matrix_arr_.front().n_rows;
+  {
+    // 打包后的卷积核按列存储，每一列是一个卷积核，按行优先读取时就是kernel_count x row_len的矩阵
+    std::lock_guard<std::mutex> lock(cuda_mutex_);
+    if (cuda_kernel_ == nullptr) {
+      std::vector<float> kernel_values;
+      kernel_values.reserve(size_t(kernel_count) * row_len);
+      for (const arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+        kernel_values.insert(kernel_values.end(), kernel_matrix.begin(), kernel_matrix.end());
       }
-      outputs.at(i) = output_tensor;
+      std::shared_ptr<DeviceBuffer> cuda_kernel = std::make_shared<DeviceBuffer>();
+      cuda_kernel->CopyFromHost(kernel_values.data(), kernel_values.size());
+      std::vector<float> bias_values;
+      for (uint32_t g = 0; g < groups_; ++g) {
+        const std::vector<float> group_bias = GroupBias(g);
+        bias_values.insert(bias_values.end(), group_bias.begin(), group_bias.end());
+      }
+      if (!bias_values.empty()) {
+        cuda_bias_ = std::make_shared<DeviceBuffer>();
+        cuda_bias_->CopyFromHost(bias_values.data(), bias_values.size());
+      }
+      // 其他上下文在自己的流上读取权重，上传完成之后才能公开
+      DeviceStream::SynchronizeCurrent();
+      cuda_kernel_ = cuda_kernel;
     }
   }
+
+  // 展开后的输入保存在每个线程自己的设备内存中，同一个流上的内核按顺序执行，不同的流各用一块内存
+  thread_local std::map<void *, DeviceBuffer> col_buffers;
+  DeviceBuffer &col_buffer = col_buffers[DeviceStream::Current()];
+  for (uint32_t i = 0; i < outputs.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map of conv layer is empty";
+    const uint32_t input_c = input->channels();
+    const uint32_t input_h = input->rows();
+    const uint32_t input_w = input->cols();
+    KUIPER_FORWARD_CHECK(input_c == this->weights_.at(0)->channels() * groups_)
+            << "The input channels of convolution is not adapting";
+    KUIPER_FORWARD_CHECK(input_h + 2 * padding_h_ >= kernel_h && input_w + 2 * padding_w_ >= kernel_w)
+            << "The size of the output feature map is less than zero";
+    const uint32_t output_h = (input_h + 2 * padding_h_ - kernel_h) / stride_h_ + 1;
+    const uint32_t output_w = (input_w + 2 * padding_w_ - kernel_w) / stride_w_ + 1;
+
+    std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
+    }
+    KUIPER_FORWARD_CHECK(output->rows() == output_h && output->cols() == output_w && output->channels() == kernel_count)
+            << "The output size of convolution is error";
+
+    const uint32_t plane_size = output_h * output_w;
+    const float *col = input->cuda_data();
+    const bool pointwise = kernel_h == 1 && kernel_w == 1 && stride_h_ == 1 && stride_w_ == 1
+        && padding_h_ == 0 && padding_w_ == 0;
+    if (!pointwise) {
+      col_buffer.Reserve(size_t(row_len) * groups_ * plane_size);
+      cuda::Im2Col(input->cuda_data(), input_c, input_h, input_w, kernel_h, kernel_w, stride_h_, stride_w_,
+                   padding_h_, padding_w_, output_h, output_w, col_buffer.data());
+      col = col_buffer.data();
+    }
+    float *output_data = output->cuda_data();
+    for (uint32_t g = 0; g < groups_; ++g) {
+      cuda::Gemm(kernel_count_group, plane_size, row_len, cuda_kernel_->data() + size_t(g) * kernel_count_group * row_len,
+                 col + size_t(g) * row_len * plane_size, output_data + size_t(g) * kernel_count_group * plane_size);
+    }
+    const float *residual_data = nullptr;
+    if (residual_) {
+      const std::shared_ptr<Tensor<float>> &residual = inputs.at(outputs.size() + i);
+      KUIPER_FORWARD_CHECK(residual != nullptr && residual->shapes() == output->shapes())
+              << "The residual of convolution is error";
+      residual_data = residual->cuda_data();
+    }
+    cuda::BiasActivation(activation_, cuda_bias_ != nullptr ? cuda_bias_->data() : nullptr, kernel_count, plane_size,
+                         output_data, residual_data);
+    output->set_device(DeviceType::kDeviceCUDA);
+  }
   return InferStatus::kInferSuccess;
+#else
+  return Layer::ForwardCuda(inputs, outputs);
+#endif
+}
+
+size_t ConvolutionLayer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4) {
+    return 0;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  const ConvolutionAlgorithm algorithm = ChooseAlgorithm(input_shape.at(1), input_shape.at(2), input_shape.at(3));
+  return ComputeWorkspaceSize(algorithm, input_shape.at(0), input_shape.at(1), input_shape.at(2), input_shape.at(3));
+}
+
+void ConvolutionLayer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+  ParamLayer::PlaceParams(policy, node);
+  // 计算时读取的是打包后的卷积核，它们是weights_之外的拷贝
+  for (const arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+    PlaceMemory(kernel_matrix.memptr(), kernel_matrix.n_elem * sizeof(float), policy, node);
+  }
+  for (const auto &winograd_kernels : winograd_kernel_arr_) {
+    for (const arma::fmat &winograd_kernel : winograd_kernels) {
+      PlaceMemory(winograd_kernel.memptr(), winograd_kernel.n_elem * sizeof(float), policy, node);
+    }
+  }
+  for (const GemmPackedMatrix &packed_kernel : packed_kernel_arr_) {
+    PlaceMemory(packed_kernel.packed_data(), packed_kernel.packed_size() * sizeof(float), policy, node);
+  }
+  for (const auto &packed_winograd_kernels : packed_winograd_kernel_arr_) {
+    for (const GemmPackedMatrix &packed_kernel : packed_winograd_kernels) {
+      PlaceMemory(packed_kernel.packed_data(), packed_kernel.packed_size() * sizeof(float), policy, node);
+    }
+  }
+  for (const SparseMatrix &sparse_kernel : sparse_kernel_arr_) {
+    PlaceMemory(sparse_kernel.row_indices.data(), sparse_kernel.row_indices.size() * sizeof(uint32_t), policy, node);
+    PlaceMemory(sparse_kernel.values.data(), sparse_kernel.values.size() * sizeof(float), policy, node);
+  }
+}
+
+void ConvolutionLayer::ShareParams(SharedParams &shared_params) {
+  ParamLayer::ShareParams(shared_params);
+  for (arma::fmat &kernel_matrix : kernel_matrix_arr_) {
+    shared_params.Share(kernel_matrix);
+  }
+  for (auto &winograd_kernels : winograd_kernel_arr_) {
+    for (arma::fmat &winograd_kernel : winograd_kernels) {
+      shared_params.Share(winograd_kernel);
+    }
+  }
+  for (GemmPackedMatrix &packed_kernel : packed_kernel_arr_) {
+    shared_params.Share(packed_kernel);
+  }
+  for (auto &packed_winograd_kernels : packed_winograd_kernel_arr_) {
+    for (GemmPackedMatrix &packed_kernel : packed_winograd_kernels) {
+      shared_params.Share(packed_kernel);
+    }
+  }
+}
+
+bool ConvolutionLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                        std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4 || this->weights_.empty()) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  if (input_shape.at(1) != int32_t(this->weights_.front()->channels() * groups_)) {
+    return false;
+  }
+  const int32_t kernel_h = int32_t(this->weights_.front()->rows());
+  const int32_t kernel_w = int32_t(this->weights_.front()->cols());
+  const int32_t input_h = input_shape.at(2) + 2 * int32_t(padding_h_);
+  const int32_t input_w = input_shape.at(3) + 2 * int32_t(padding_w_);
+  if (input_h < kernel_h || input_w < kernel_w) {
+    return false;
+  }
+  output_shape = {input_shape.at(0), int32_t(this->weights_.size()), (input_h - kernel_h) / int32_t(stride_h_) + 1,
+                  (input_w - kernel_w) / int32_t(stride_w_) + 1};
+  // 残差的形状必须和输出相同
+  if (residual_ && (input_shapes.size() != 2 || input_shapes.at(1) != output_shape)) {
+    return false;
+  }
+  return true;
+}
+
+uint64_t ConvolutionLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                 const std::vector<int32_t> &output_shape) const {
+  // 每个输出元素是一次卷积核大小的乘加
+  if (weights_.empty() || weights_.front() == nullptr) {
+    return Layer::Flops(input_shapes, output_shape);
+  }
+  const uint64_t kernel_size = weights_.front()->size();
+  const uint64_t output_size = ShapeSize(output_shape);
+  return output_size * kernel_size * 2 + (use_bias_ ? output_size : 0) + (residual_ ? output_size : 0);
 }
 
 ParseParameterAttrStatus ConvolutionLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
@@ -269,11 +1415,30 @@ ParseParameterAttrStatus ConvolutionLayer::GetInstance(const std::shared_ptr<Run
     return ParseParameterAttrStatus::kParameterMissingKernel;
   }
 
+  // 计算图合并进来的激活函数是可选的参数
+  ActivationType activation_type;
+  if (!ParseFusedActivation(op, "activation", activation_type)) {
+    return ParseParameterAttrStatus::kParameterMissingActivation;
+  }
+
   // kernel的方向是倒置的
-  conv_layer = std::make_shared<ConvolutionLayer>(out_channel->value, in_channel->value,
-                                                  kernels.at(0), kernels.at(1), paddings.at(0),
-                                                  paddings.at(1), strides.at(0), strides.at(1),
-                                                  groups->value, use_bias->value);
+  std::shared_ptr<ConvolutionLayer> convolution_layer =
+      std::make_shared<ConvolutionLayer>(out_channel->value, in_channel->value,
+                                         kernels.at(0), kernels.at(1), paddings.at(0),
+                                         paddings.at(1), strides.at(0), strides.at(1),
+                                         groups->value, use_bias->value);
+  convolution_layer->set_activation(activation_type);
+
+  // 合并进来的残差连接，第二个输入是残差
+  if (params.find("residual") != params.end()) {
+    const auto &residual = dynamic_cast<RuntimeParameterBool *>(params.at("residual"));
+    if (!residual || (residual->value && op->input_operands_seq.size() != 2)) {
+      LOG(ERROR) << "Can not find the residual parameter";
+      return ParseParameterAttrStatus::kParameterMissingResidual;
+    }
+    convolution_layer->set_residual(residual->value);
+  }
+  conv_layer = convolution_layer;
 
   // load weights
   const std::map<std::string, std::shared_ptr<RuntimeAttribute>> &attrs = op->attribute;
@@ -289,8 +1454,8 @@ ParseParameterAttrStatus ConvolutionLayer::GetInstance(const std::shared_ptr<Run
       return ParseParameterAttrStatus::kAttrMissingBias;
     }
 
-    const std::vector<float> &bias_values = bias->get<float>();
-    conv_layer->set_bias(bias_values);
+    std::vector<float> bias_buffer;
+    conv_layer->set_bias(bias->view<float>(bias_buffer), bias->element_num());
   }
 
   if (attrs.find("weight") == attrs.end()) {
@@ -305,8 +1470,9 @@ ParseParameterAttrStatus ConvolutionLayer::GetInstance(const std::shared_ptr<Run
     return ParseParameterAttrStatus::kAttrMissingWeight;
   }
 
-  const std::vector<float> &weight_values = weight->get<float>();
-  conv_layer->set_weights(weight_values);
+  // 直接从属性或者映射的权重文件中读取，没有对齐时才复制
+  std::vector<float> weight_buffer;
+  conv_layer->set_weights(weight->view<float>(weight_buffer), weight->element_num());
   return ParseParameterAttrStatus::kParameterAttrParseSuccess;
 }
 
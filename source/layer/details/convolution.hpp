@@ -4,9 +4,43 @@
 
 #ifndef KUIPER_COURSE_SOURCE_LAYER_CONVOLUTION_HPP_
 #define KUIPER_COURSE_SOURCE_LAYER_CONVOLUTION_HPP_
+#include <map>
+#include <mutex>
 #include "layer/abstract/param_layer.hpp"
+#include "data/gemm.hpp"
+#include "data/sparse.hpp"
+#include "layer/abstract/window_kernel.hpp"
 
 namespace kuiper_infer {
+/// 卷积的计算算法
+enum class ConvolutionAlgorithm {
+  kIm2Col = 0, /// 展开输入之后做矩阵乘法
+  kWinograd = 1, /// 3x3步长为1的Winograd F(2x2,3x3)算法
+  kPointwise = 2, /// 1x1步长为1直接在输入通道上做矩阵乘法
+  kDepthwise = 3, /// 直接计算的逐通道卷积
+};
+
+/// im2col展开一个块中一个输入通道时的参数
+struct Im2ColWindow {
+  uint32_t kernel_h = 0; /// 卷积核的高度
+  uint32_t kernel_w = 0; /// 卷积核的宽度
+  uint32_t stride_h = 1; /// 行方向的步长
+  uint32_t stride_w = 1; /// 列方向的步长
+  uint32_t padding_h = 0; /// 行方向的填充
+  uint32_t padding_w = 0; /// 列方向的填充
+  uint32_t input_h = 0; /// 输入的行数
+  uint32_t input_w = 0; /// 输入的列数
+  uint32_t output_h = 0; /// 输出的行数
+  uint32_t output_w = 0; /// 输出的列数
+  uint32_t position_begin = 0; /// 块中第一个输出位置，所有样本的输出位置排成一列
+  uint32_t position_end = 0; /// 块中最后一个输出位置之后的位置
+  uint32_t column_stride = 0; /// 展开后的矩阵相邻两列之间的距离
+};
+
+/// 把所有样本的一个输入通道展开到块中，channel_columns指向这个通道对应的第一列
+using Im2ColKernel = void (*)(const Im2ColWindow &window, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                              uint32_t channel, float *channel_columns);
+
 class ConvolutionLayer : public ParamLayer {
  public:
   explicit ConvolutionLayer(uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
@@ -19,8 +53,185 @@ class ConvolutionLayer : public ParamLayer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  using ParamLayer::set_weights;
+
+  void set_weights(const float *weights, uint32_t size) override;
+
+  void set_weights(const std::vector<std::shared_ptr<Tensor<float>>> &weights) override;
+
+  /**
+   * 设置是否允许3x3步长为1的卷积使用Winograd算法，关闭后使用im2col算法
+   * @param use_winograd 是否允许使用Winograd算法
+   */
+  void set_use_winograd(bool use_winograd);
+
+  /**
+   * 设置卷积的输出是否加上残差，计算图把残差连接的加法合并进来时设置
+   * 设置之后输入依次是所有样本的特征图和所有样本的残差，残差在写回输出时加上，之后再计算激活函数
+   * @param residual 是否加上残差
+   */
+  void set_residual(bool residual);
+
+  /**
+   * 返回卷积的输出是否加上残差
+   * @return 是否加上残差
+   */
+  bool residual() const;
+
+  size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
+  void PlaceParams(NumaMemoryPolicy policy, uint32_t node) override;
+
+  void ShareParams(SharedParams &shared_params) override;
+
+  bool Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) override;
+
+  bool SupportDevice(DeviceType device) const override;
+
+  /**
+   * 在CUDA设备上使用im2col算法计算卷积，1x1步长为1并且没有填充时直接在输入上做矩阵乘法
+   * 第一次执行时将打包后的卷积核和偏置上传到设备上
+   * @param inputs 输入特征图，数据已经同步到设备上
+   * @param outputs 输出特征图
+   * @return 计算的状态
+   */
+  InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  /**
+   * 根据输入通道数量和卷积参数选择计算算法
+   * @param input_c 输入通道数量
+   * @return 使用的算法
+   */
+  ConvolutionAlgorithm SelectAlgorithm(uint32_t input_c) const;
+
+  /**
+   * 返回输入形状在当前线程数量下使用的算法，调优过的形状使用调优结果，否则按照卷积参数选择
+   * @param input_c 输入通道数量
+   * @param input_h 输入的高度
+   * @param input_w 输入的宽度
+   * @return 使用的算法
+   */
+  ConvolutionAlgorithm ChooseAlgorithm(uint32_t input_c, uint32_t input_h, uint32_t input_w) const;
+
+  /**
+   * 返回卷积参数下所有可以使用的算法，im2col总是可以使用
+   * @param input_c 输入通道数量
+   * @return 可以使用的算法
+   */
+  std::vector<ConvolutionAlgorithm> CandidateAlgorithms(uint32_t input_c) const;
+
+ private:
+  /**
+   * 检查输入之后按照选择的算法计算卷积
+   * @param inputs 输入特征图
+   * @param residuals 每个样本的残差，没有残差时为空
+   * @param outputs 输出特征图
+   * @return 计算的状态
+   */
+  InferStatus ForwardResidual(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                              const std::vector<std::shared_ptr<Tensor<float>>> &residuals,
+                              std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
+  /**
+   * 使用指定的算法计算卷积，输入已经检查过
+   * @param inputs 输入特征图
+   * @param outputs 输出特征图
+   * @param algorithm 使用的算法，需要是CandidateAlgorithms中的一个
+   * @param residuals 每个样本的残差，没有残差时为空
+   * @return 计算的状态
+   */
+  InferStatus ForwardAlgorithm(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                               std::vector<std::shared_ptr<Tensor<float>>> &outputs, ConvolutionAlgorithm algorithm,
+                               const std::vector<std::shared_ptr<Tensor<float>>> &residuals);
+
+  /**
+   * 将卷积核按组打包成GEMM直接使用的矩阵，设置权重之后调用一次
+   */
+  void InitPackedWeights();
+
+  /**
+   * 返回一个分组中每个卷积核的偏置，作为矩阵乘法每一列的偏置
+   * @param group 分组的编号
+   * @return 分组中每个卷积核的偏置，没有偏置时为空
+   */
+  std::vector<float> GroupBias(uint32_t group) const;
+
+  /**
+   * 计算一个batch的输入使用某种算法时需要的临时内存
+   * @param algorithm 使用的算法
+   * @param batch_size batch的大小
+   * @param input_c 输入通道数量
+   * @param input_h 输入的高度
+   * @param input_w 输入的宽度
+   * @return 需要的float元素数量
+   */
+  size_t ComputeWorkspaceSize(ConvolutionAlgorithm algorithm, uint32_t batch_size, uint32_t input_c,
+                              uint32_t input_h, uint32_t input_w) const;
+
+  /**
+   * 使用im2col算法计算所有样本的一个分组的卷积，所有样本的输出位置拼接在一起，按照缓存大小分块展开并做矩阵乘法
+   * @param inputs 没有填充的输入特征图
+   * @param outputs 输出特征图
+   * @param residuals 每个样本的残差，没有残差时为空
+   * @param group 分组的编号
+   * @param workspace 存放每个线程的块展开后的输入和矩阵乘法结果的临时内存
+   */
+  void Im2ColForward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                     const std::vector<std::shared_ptr<Tensor<float>>> &outputs,
+                     const std::vector<std::shared_ptr<Tensor<float>>> &residuals, uint32_t group,
+                     float *workspace) const;
+
+  /**
+   * 使用Winograd F(2x2,3x3)算法计算一个分组的卷积
+   * @param input 没有填充的输入特征图
+   * @param output 输出特征图
+   * @param residual 残差，没有残差时为空
+   * @param group 分组的编号
+   * @param workspace 存放变换后的输入和矩阵乘法结果的临时内存
+   */
+  void WinogradForward(const std::shared_ptr<Tensor<float>> &input, const std::shared_ptr<Tensor<float>> &output,
+                       const std::shared_ptr<Tensor<float>> &residual, uint32_t group, float *workspace) const;
+
+  /**
+   * 计算一个分组的1x1步长为1的卷积，直接在输入通道上做矩阵乘法而不需要展开
+   * @param input 输入特征图，不能有填充
+   * @param output 输出特征图
+   * @param residual 残差，没有残差时为空
+   * @param group 分组的编号
+   */
+  void PointwiseForward(const std::shared_ptr<Tensor<float>> &input, const std::shared_ptr<Tensor<float>> &output,
+                        const std::shared_ptr<Tensor<float>> &residual, uint32_t group) const;
+
+  /**
+   * 直接计算3x3或者5x5，步长为1或者2的逐通道卷积，每个分组只有一个输入通道
+   * 支持SIMD时按照向量宽度将通道分块，转换为NCHWc布局后一次计算一个块中所有通道的输出
+   * @param input 没有填充的输入特征图
+   * @param output 输出特征图
+   */
+  void DepthwiseForward(const std::shared_ptr<Tensor<float>> &input,
+                        const std::shared_ptr<Tensor<float>> &output) const;
+
  private:
+  std::vector<arma::fmat> kernel_matrix_arr_; /// 每组打包后的卷积核，每一列是一个按通道展开的卷积核
+  std::vector<std::vector<arma::fmat>> winograd_kernel_arr_; /// 每组变换后的卷积核，16个位置分别是一个输入通道数*卷积核数的矩阵
+  std::vector<GemmPackedMatrix> packed_kernel_arr_; /// 设置权重时使用内置矩阵乘法才创建，按内置实现的面板格式打包的kernel_matrix_arr_
+  std::vector<std::vector<GemmPackedMatrix>> packed_winograd_kernel_arr_; /// 按面板格式打包的winograd_kernel_arr_
+  std::vector<SparseMatrix> sparse_kernel_arr_; /// 卷积核中0的比例达到阈值时创建，按输出通道压缩的kernel_matrix_arr_，存在时代替稠密的卷积核
+  std::map<std::vector<uint32_t>, ConvolutionAlgorithm> tuned_algorithms_; /// 调优选出的算法，键是输入通道数量、高度、宽度和线程数量
+  std::mutex cuda_mutex_; /// 保护卷积核上传到CUDA设备的过程
+  std::shared_ptr<DeviceBuffer> cuda_kernel_; /// 所有分组打包后的卷积核在CUDA设备上的副本，每一行是一个卷积核
+  std::shared_ptr<DeviceBuffer> cuda_bias_; /// 偏置在CUDA设备上的副本，没有偏置时为空
+  Im2ColKernel im2col_kernel_ = nullptr; /// 创建时按照卷积核大小和步长选中的im2col展开实例
+  bool use_winograd_ = true;
   bool use_bias_ = false;
+  bool residual_ = false; /// 输出是否加上作为第二个输入的残差
   uint32_t groups_ = 1;
   uint32_t padding_h_ = 0;
   uint32_t padding_w_ = 0;
@@ -4,94 +4,280 @@
 
 #include "expression.hpp"
 #include "layer/abstract/layer_factory.hpp"
-#include <stack>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include "runtime/thread_pool.hpp"
+#include "../../kernels/cpu_kernels.hpp"
+#ifdef USE_CUDA
+#include "../../backend/cuda/cuda_kernels.hpp"
+#endif
 
 namespace kuiper_infer {
-ExpressionLayer::ExpressionLayer(const std::string &statement)
-    : Layer("Expression"), parser_(std::make_unique<ExpressionParser>(statement)) {
+/// 逐元素计算时每次处理的元素数量，所有的中间结果都能放在L1缓存中
+constexpr uint32_t kExpressionBlockSize = 256;
 
+ExpressionLayer::ExpressionLayer(const std::string &statement) : Layer("Expression") {
+  Compile(statement);
+}
+
+void ExpressionLayer::Compile(const std::string &statement) {
+  ExpressionParser parser(statement);
+  parser.Tokenizer(false);
+  CHECK(!parser.tokens().empty()) << "The expression is empty: " << statement;
+
+  const std::vector<std::shared_ptr<TokenNode>> &token_nodes = parser.Generate();
+  uint32_t depth = 0;
+  for (const auto &token_node : token_nodes) {
+    const int32_t num_index = token_node->num_index;
+    if (num_index >= 0) {
+      depth += 1;
+      input_num_ = std::max(input_num_, uint32_t(num_index) + 1);
+    } else {
+      CHECK(num_index == -int(TokenType::TokenAdd) || num_index == -int(TokenType::TokenMul))
+              << "Unknown operation type: " << num_index;
+      CHECK(depth >= 2) << "The number of operand is less than two";
+      depth -= 1;
+    }
+    stack_depth_ = std::max(stack_depth_, depth);
+    instructions_.push_back(num_index);
+  }
+  CHECK(depth == 1) << "The expression is not complete: " << statement;
+}
+
+size_t ExpressionLayer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  return size_t(ThreadPool::Current().thread_num()) * stack_depth_ * kExpressionBlockSize;
 }
 
 InferStatus ExpressionLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                                      std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
   if (inputs.empty()) {
-    LOG(ERROR) << "The input feature map of flatten layer is empty";
+    LOG(ERROR) << "The input feature map of expression layer is empty";
     return InferStatus::kInferFailedInputEmpty;
   }
 
-  const uint32_t size = inputs.size();
-//  CHECK(size % 2 == 0);
-  if (!size) {
-    LOG(ERROR) << "The input feature map of add layer is null";
+  const uint32_t batch_size = outputs.size();
+  if (batch_size == 0 || inputs.size() != input_num_ * batch_size) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  // 输入的形状和输出相同，或者每个通道只有一个值并在通道内广播
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      std::shared_ptr<Tensor<float>> full_input;
+      for (uint32_t j = 0; j < input_num_; ++j) {
+        const auto &input = inputs.at(j * batch_size + i);
+        if (full_input == nullptr || input->size() > full_input->size()) {
+          full_input = input;
+        }
+      }
+      output = std::make_shared<Tensor<float>>(full_input->channels(), full_input->rows(), full_input->cols());
+    }
+    for (uint32_t j = 0; j < input_num_; ++j) {
+      const auto &input = inputs.at(j * batch_size + i);
+      if (input == nullptr || input->empty()) {
+        LOG(ERROR) << "The input feature map of expression layer is empty";
+        return InferStatus::kInferFailedInputEmpty;
+      }
+      const bool broadcast = input->rows() == 1 && input->cols() == 1;
+      if (input->channels() != output->channels() || (!broadcast && input->shapes() != output->shapes())) {
+        LOG(ERROR) << "The input and output shape of expression layer is not adapting";
+        return InferStatus::kInferFailedInputOutSizeAdaptingError;
+      }
+    }
+  }
+
+  // 每个样本的每个通道是一个任务，线程之间使用临时内存中不同的区域保存中间结果
+  const uint32_t channels = outputs.front()->channels();
+  const uint32_t task_num = batch_size * channels;
+  const uint32_t block_num = std::min(task_num, ThreadPool::Current().thread_num());
+  const size_t block_size = size_t(stack_depth_) * kExpressionBlockSize;
+  std::vector<float> workspace_buffer;
+  float *workspace = AcquireWorkspace(block_num * block_size, workspace_buffer);
+
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    float *stack_workspace = workspace + block * block_size;
+    std::vector<const float *> stack(stack_depth_);
+    const uint32_t task_begin = block * task_num / block_num;
+    const uint32_t task_end = (block + 1) * task_num / block_num;
+    for (uint32_t task = task_begin; task < task_end; ++task) {
+      const uint32_t i = task / channels;
+      const uint32_t c = task % channels;
+      const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+      const uint32_t plane_size = output->rows() * output->cols();
+      float *output_channel = output->at(c).memptr();
+
+      for (uint32_t offset = 0; offset < plane_size; offset += kExpressionBlockSize) {
+        const uint32_t len = std::min(kExpressionBlockSize, plane_size - offset);
+        uint32_t top = 0;
+        for (uint32_t k = 0; k < instructions_.size(); ++k) {
+          const int32_t instruction = instructions_.at(k);
+          if (instruction >= 0) {
+            // 输入直接读取原来的内存，广播的输入展开到当前栈位置对应的临时内存中
+            const std::shared_ptr<Tensor<float>> &input = inputs.at(instruction * batch_size + i);
+            if (input->rows() == 1 && input->cols() == 1) {
+              float *slot = stack_workspace + top * kExpressionBlockSize;
+              std::fill(slot, slot + len, input->index(c));
+              stack[top] = slot;
+            } else {
+              stack[top] = input->at(c).memptr() + offset;
+            }
+            top += 1;
+            continue;
+          }
+
+          // 最后一条指令的结果直接写入输出，其他的结果写入栈位置对应的临时内存
+          const float *lhs = stack[top - 2];
+          const float *rhs = stack[top - 1];
+          float *result = k + 1 == instructions_.size() ? output_channel + offset
+                                                        : stack_workspace + (top - 2) * kExpressionBlockSize;
+          const ElementOperation operation = instruction == -int(TokenType::TokenAdd) ? ElementOperation::kAdd
+                                                                                      : ElementOperation::kMultiply;
+          kernels.element_binary(operation, lhs, false, rhs, false, len, result);
+          top -= 1;
+          stack[top - 1] = result;
+        }
+
+        // 表达式只有一个输入时直接复制
+        if (instructions_.size() == 1) {
+          memcpy(output_channel + offset, stack.front(), len * sizeof(float));
+        }
+      }
+    }
+  });
+  return InferStatus::kInferSuccess;
+}
+
+bool ExpressionLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus ExpressionLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                         std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+#ifdef USE_CUDA
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of expression layer is empty";
     return InferStatus::kInferFailedInputEmpty;
   }
-  CHECK(this->parser_ != nullptr);
-  this->parser_->Tokenizer(false);
-  const auto &expressions = this->parser_->tokens();
-  CHECK(!expressions.empty());
-  const auto &expression = expressions.front();
 
   const uint32_t batch_size = outputs.size();
-  if (batch_size == 0) {
+  if (batch_size == 0 || inputs.size() != input_num_ * batch_size) {
+    LOG(ERROR) << "The input and output size is not adapting";
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
   }
 
+  // 每个样本按照指令序列依次启动内核，中间结果保存在设备上的临时内存中，不同的流各用一块内存
+  thread_local std::map<void *, DeviceBuffer> stack_buffers;
+  DeviceBuffer &stack_buffer = stack_buffers[DeviceStream::Current()];
   for (uint32_t i = 0; i < batch_size; ++i) {
-    CHECK(outputs.at(i) != nullptr && !outputs.at(i)->empty());
-    outputs.at(i)->Fill(0.f);
-  }
+    std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      std::shared_ptr<Tensor<float>> full_input;
+      for (uint32_t j = 0; j < input_num_; ++j) {
+        const auto &input = inputs.at(j * batch_size + i);
+        if (full_input == nullptr || input->size() > full_input->size()) {
+          full_input = input;
+        }
+      }
+      output = std::make_shared<Tensor<float>>(full_input->channels(), full_input->rows(), full_input->cols());
+    }
+    for (uint32_t j = 0; j < input_num_; ++j) {
+      const auto &input = inputs.at(j * batch_size + i);
+      if (input == nullptr || input->empty()) {
+        LOG(ERROR) << "The input feature map of expression layer is empty";
+        return InferStatus::kInferFailedInputEmpty;
+      }
+      const bool broadcast = input->rows() == 1 && input->cols() == 1;
+      if (input->channels() != output->channels() || (!broadcast && input->shapes() != output->shapes())) {
+        LOG(ERROR) << "The input and output shape of expression layer is not adapting";
+        return InferStatus::kInferFailedInputOutSizeAdaptingError;
+      }
+    }
 
-  std::stack<std::vector<std::shared_ptr<Tensor<float>>>> op_stack;
-  const std::vector<std::shared_ptr<TokenNode>> &token_nodes = this->parser_->Generate();
-  for (const auto &token_node : token_nodes) {
-    if (token_node->num_index >= 0) {
-      // operator
-      uint32_t start_pos = token_node->num_index * batch_size;
-      std::vector<std::shared_ptr<Tensor<float>>> input_token_nodes;
-      for (uint32_t i = 0; i < batch_size; ++i) {
-        CHECK(i + start_pos < inputs.size());
-        input_token_nodes.push_back(inputs.at(i + start_pos));
+    const uint32_t channels = output->channels();
+    const uint32_t plane_size = output->rows() * output->cols();
+    // 广播的中间结果放在完整中间结果之后的单独区域，避免完整结果覆盖还没有读完的广播左操作数
+    const size_t full_size = size_t(stack_depth_) * output->size();
+    stack_buffer.Reserve(full_size + size_t(stack_depth_) * channels);
+    std::vector<const float *> stack(stack_depth_);
+    std::vector<bool> stack_broadcast(stack_depth_);
+    uint32_t top = 0;
+    for (uint32_t k = 0; k < instructions_.size(); ++k) {
+      const int32_t instruction = instructions_.at(k);
+      if (instruction >= 0) {
+        const std::shared_ptr<Tensor<float>> &input = inputs.at(instruction * batch_size + i);
+        stack[top] = input->cuda_data();
+        stack_broadcast[top] = input->rows() == 1 && input->cols() == 1;
+        top += 1;
+        continue;
       }
-      op_stack.push(input_token_nodes);
-    } else {
-      //operation
-      const int32_t op = token_node->num_index;
-      CHECK(op_stack.size() >= 2) << "The number of operand is less than two";
-      std::vector<std::shared_ptr<Tensor<float>>> input_node1 = op_stack.top();
-
-      CHECK(input_node1.size() == batch_size);
-      op_stack.pop();
-
-      std::vector<std::shared_ptr<Tensor<float>>> input_node2 = op_stack.top();
-      CHECK(input_node2.size() == batch_size);
-      op_stack.pop();
-
-      CHECK(input_node1.size() == input_node2.size());
-      std::vector<std::shared_ptr<Tensor<float>>> output_token_nodes;
-      if (op == -int(TokenType::TokenAdd)) {
-        for (uint32_t i = 0; i < batch_size; ++i) {
-          output_token_nodes.push_back(Tensor<float>::ElementAdd(input_node1.at(i), input_node2.at(i)));
-        }
-      } else if (op == -int(TokenType::TokenMul)) {
-        for (uint32_t i = 0; i < batch_size; ++i) {
-          output_token_nodes.push_back(Tensor<float>::ElementMultiply(input_node1.at(i), input_node2.at(i)));
-        }
+
+      // 两个输入都是广播时结果也只有每个通道一个值
+      const bool lhs_broadcast = stack_broadcast[top - 2];
+      const bool rhs_broadcast = stack_broadcast[top - 1];
+      const bool result_broadcast = lhs_broadcast && rhs_broadcast;
+      float *result = nullptr;
+      if (k + 1 == instructions_.size()) {
+        result = output->cuda_data();
+      } else if (result_broadcast) {
+        result = stack_buffer.data() + full_size + (top - 2) * channels;
       } else {
-        LOG(ERROR) << "Unknown operation type: " << op;
-        return InferStatus::kInferFailedOperationUnknown;
+        result = stack_buffer.data() + (top - 2) * output->size();
       }
-      op_stack.push(output_token_nodes);
+      const cuda::BinaryOperation operation = instruction == -int(TokenType::TokenAdd) ? cuda::BinaryOperation::kAdd
+                                                                                       : cuda::BinaryOperation::kMultiply;
+      cuda::ElementBinary(operation, stack[top - 2], lhs_broadcast && !result_broadcast, stack[top - 1],
+                          rhs_broadcast && !result_broadcast, channels, result_broadcast ? 1 : plane_size, result);
+      top -= 1;
+      stack[top - 1] = result;
+      stack_broadcast[top - 1] = result_broadcast;
     }
-  }
 
-  CHECK(op_stack.size() == 1);
-  std::vector<std::shared_ptr<Tensor<float>>> output_node = op_stack.top();
-  op_stack.pop();
-  for (int i = 0; i < batch_size; ++i) {
-    CHECK(outputs.at(i) != nullptr && !outputs.at(i)->empty());
-    outputs.at(i) = output_node.at(i);
+    // 表达式只有一个输入时直接复制
+    if (instructions_.size() == 1) {
+      cuda::Copy(stack.front(), output->size(), output->cuda_data());
+    }
+    output->set_device(DeviceType::kDeviceCUDA);
   }
   return InferStatus::kInferSuccess;
+#else
+  return Layer::ForwardCuda(inputs, outputs);
+#endif
+}
+
+bool ExpressionLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                       std::vector<int32_t> &output_shape) const {
+  // 广播的输入只有通道维度，输出和元素最多的输入形状相同
+  if (input_shapes.size() != input_num_) {
+    return false;
+  }
+  int64_t max_elements = 0;
+  for (const auto &input_shape : input_shapes) {
+    int64_t elements = 1;
+    for (uint32_t i = 1; i < input_shape.size(); ++i) {
+      elements *= input_shape.at(i);
+    }
+    if (elements > max_elements) {
+      max_elements = elements;
+      output_shape = input_shape;
+    }
+  }
+  return max_elements > 0;
+}
+
+uint64_t ExpressionLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                const std::vector<int32_t> &output_shape) const {
+  // 每个输出元素计算一遍表达式中的全部运算
+  uint64_t op_num = 0;
+  for (const int32_t instruction : instructions_) {
+    if (instruction < 0) {
+      op_num += 1;
+    }
+  }
+  return ShapeSize(output_shape) * std::max(op_num, uint64_t(1));
 }
 
 ParseParameterAttrStatus ExpressionLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
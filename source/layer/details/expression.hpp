@@ -15,11 +15,37 @@ class ExpressionLayer : public Layer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  bool SupportDevice(DeviceType device) const override;
+
+  InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &expression_layer);
 
+  /**
+   * 返回逐元素计算时每个线程保存中间结果需要的临时内存
+   * @param input_shapes 每个输入操作数的形状
+   * @return 需要的float元素数量
+   */
+  size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
  private:
-  std::unique_ptr<ExpressionParser> parser_;
+  /**
+   * 将表达式解析为逆波兰式的指令序列，只在创建的时候执行一次
+   * @param statement 表达式
+   */
+  void Compile(const std::string &statement);
+
+  std::vector<int32_t> instructions_; /// 逆波兰式的指令，非负数是输入的编号，负数是运算的类型
+  uint32_t input_num_ = 0; /// 表达式中输入的数量
+  uint32_t stack_depth_ = 0; /// 计算时同时存在的中间结果的最大数量
 };
 }
 #endif //KUIPER_COURSE_SOURCE_LAYER_MONOCULAR_EXPRESSION_HPP_
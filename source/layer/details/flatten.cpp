@@ -35,8 +35,8 @@ InferStatus FlattenLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
 
   end_dim -= 1;
   start_dim -= 1;
-  CHECK(end_dim > start_dim);
-  CHECK(end_dim <= 2 && start_dim >= 0);
+  KUIPER_FORWARD_CHECK(end_dim > start_dim);
+  KUIPER_FORWARD_CHECK(end_dim <= 2 && start_dim >= 0);
   const uint32_t batch_size = inputs.size();
 
   for (uint32_t i = 0; i < batch_size; ++i) {
@@ -47,15 +47,16 @@ InferStatus FlattenLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
     for (int s = start_dim; s <= end_dim; ++s) {
       elements_size *= shapes.at(s);
     }
-    std::shared_ptr<Tensor<float>> output = input->Clone();
+    // 按照存储顺序展开，输出只是共享输入内存的另一个形状
+    std::shared_ptr<Tensor<float>> output;
     if (start_dim == 0 && end_dim == 2) {
-      output->ReRawshape({elements_size});
+      output = Tensor<float>::Reshape(input, {elements_size});
     } else if (start_dim == 1 && end_dim == 2) {
       uint32_t channels = input->channels();
-      output->ReRawshape({channels, elements_size});
+      output = Tensor<float>::Reshape(input, {channels, elements_size});
     } else if (start_dim == 0 && end_dim == 1) {
       uint32_t cols = input->cols();
-      output->ReRawshape({elements_size, cols});
+      output = Tensor<float>::Reshape(input, {elements_size, cols});
     } else {
       LOG(FATAL) << "Wrong flatten dim: " << "start dim: " << start_dim << " end dim: " << end_dim;
     }
@@ -64,6 +65,39 @@ InferStatus FlattenLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
   return InferStatus::kInferSuccess;
 }
 
+bool FlattenLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                    std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  const int total_dims = 4; // NCHW
+  const int start_dim = start_dim_ < 0 ? total_dims + start_dim_ : start_dim_;
+  const int end_dim = end_dim_ < 0 ? total_dims + end_dim_ : end_dim_;
+  if (start_dim < 1 || end_dim > 3 || end_dim <= start_dim) {
+    return false;
+  }
+
+  output_shape = {input_shape.at(0)};
+  int32_t elements_size = 1;
+  for (int s = 1; s < total_dims; ++s) {
+    if (s < start_dim || s > end_dim) {
+      output_shape.push_back(input_shape.at(s));
+    } else {
+      elements_size *= input_shape.at(s);
+      if (s == end_dim) {
+        output_shape.push_back(elements_size);
+      }
+    }
+  }
+  return true;
+}
+
+bool FlattenLayer::ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  std::vector<int32_t> output_shape;
+  return this->InferOutputShape(input_shapes, output_shape);
+}
+
 ParseParameterAttrStatus FlattenLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                    std::shared_ptr<Layer> &flatten_layer) {
   CHECK(op != nullptr) << "Flatten operator is nullptr";
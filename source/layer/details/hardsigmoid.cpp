@@ -3,6 +3,7 @@
 //
 #include "hardsigmoid.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
 
 namespace kuiper_infer {
 HardSigmoid::HardSigmoid() : Layer("HardSigmoid") {
@@ -22,10 +23,9 @@ InferStatus HardSigmoid::Forward(const std::vector<std::shared_ptr<Tensor<float>
   }
 
   const uint32_t batch = inputs.size();
-#pragma omp parallel for num_threads(batch)
   for (uint32_t i = 0; i < batch; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input == nullptr || !input->empty()) << "HardSigmoid layer input is empty";
+    KUIPER_FORWARD_CHECK(input == nullptr || !input->empty()) << "HardSigmoid layer input is empty";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
@@ -33,23 +33,28 @@ InferStatus HardSigmoid::Forward(const std::vector<std::shared_ptr<Tensor<float>
       output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
     }
 
-    CHECK(output->shapes() == input->shapes()) << "The output size of hardsigmoid is error";
-
-    output->set_data(input->data());
-    output->Transform([](float val) {
-      if (val <= -3.f) {
-        return 0.f;
-      } else if (val >= 3.f) {
-        return 1.f;
-      } else {
-        return val / 6.f + 0.5f;
-      }
-    });
+    KUIPER_FORWARD_CHECK(output->shapes() == input->shapes()) << "The output size of hardsigmoid is error";
+
     outputs.at(i) = output;
   }
+
+  ApplyActivation(ActivationType::kActivationHardSigmoid, inputs, outputs);
   return InferStatus::kInferSuccess;
 }
 
+bool HardSigmoid::SupportInPlace() const {
+  return true;
+}
+
+bool HardSigmoid::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus HardSigmoid::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                     std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return ForwardActivationCuda(ActivationType::kActivationHardSigmoid, inputs, outputs);
+}
+
 ParseParameterAttrStatus HardSigmoid::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                   std::shared_ptr<Layer> &hardsigmoid_layer) {
   CHECK(op != nullptr) << "HardSigmoid operator is nullptr";
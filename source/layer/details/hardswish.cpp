@@ -3,6 +3,7 @@
 //
 #include "hardswish.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
 
 namespace kuiper_infer {
 HardSwishLayer::HardSwishLayer() : Layer("HardSwish") {}
@@ -20,10 +21,9 @@ InferStatus HardSwishLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
   }
 
   const uint32_t batch = inputs.size();
-#pragma omp parallel for num_threads(batch)
   for (uint32_t i = 0; i < batch; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input == nullptr || !input->empty()) << "HardSwish layer input is empty";
+    KUIPER_FORWARD_CHECK(input == nullptr || !input->empty()) << "HardSwish layer input is empty";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
@@ -31,23 +31,28 @@ InferStatus HardSwishLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
       output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
     }
 
-    CHECK(output->shapes() == input->shapes()) << "The output size of hardswish is error";
-
-    output->set_data(input->data());
-    output->Transform([](float val) {
-      if (val <= -3.f) {
-        return 0.f;
-      } else if (val >= 3.f) {
-        return val;
-      } else {
-        return val * (val + 3) / 6;
-      }
-    });
+    KUIPER_FORWARD_CHECK(output->shapes() == input->shapes()) << "The output size of hardswish is error";
+
     outputs.at(i) = output;
   }
+
+  ApplyActivation(ActivationType::kActivationHardSwish, inputs, outputs);
   return InferStatus::kInferSuccess;
 }
 
+bool HardSwishLayer::SupportInPlace() const {
+  return true;
+}
+
+bool HardSwishLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus HardSwishLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                        std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return ForwardActivationCuda(ActivationType::kActivationHardSwish, inputs, outputs);
+}
+
 ParseParameterAttrStatus HardSwishLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                      std::shared_ptr<Layer> &hardswish_layer) {
   CHECK(op != nullptr) << "HardSwishLayer operator is nullptr";
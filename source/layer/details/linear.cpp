@@ -5,8 +5,22 @@
 #include "linear.hpp"
 #include "layer/abstract/layer_factory.hpp"
 #include <glog/logging.h>
+#include <cmath>
+#include "runtime/thread_pool.hpp"
+#include "adaptive_avgpooling.hpp"
+#include "data/half.hpp"
+#include "data/gemm.hpp"
+#include "../../kernels/cpu_kernels.hpp"
 
 namespace kuiper_infer {
+/// 并行计算时每个权重列块至少包含的输入特征数量
+constexpr uint32_t kLinearMinBlockSize = 256;
+/// INT8计算时每个行块包含的输出特征数量，行块的量化权重可以留在缓存中被所有输入复用
+constexpr uint32_t kLinearInt8RowBlock = 64;
+/// 压缩的权重按照输出特征分成面板，每个面板包含的输出特征数量
+constexpr uint32_t kLinearPanelRows = 64;
+/// 稀疏计算时每个线程至少负责的输出特征数量
+constexpr uint32_t kLinearSparseMinBlock = 16;
 
 LinearLayer::LinearLayer(int32_t in_features, int32_t out_features, bool use_bias)
     : ParamLayer("Linear"), use_bias_(use_bias), in_features_(in_features), out_features_(out_features) {
@@ -31,62 +45,575 @@ InferStatus LinearLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
   }
 
-  if (this->weights_.empty()) {
+  // 压缩和按组量化保存的权重不在weights_中
+  const uint32_t weight_num = compressed_weights_.empty() && group_weights_.empty() ? this->weights_.size() : 1;
+  if (weight_num == 0) {
     LOG(ERROR) << "The weight parameters is empty";
     return InferStatus::kInferFailedWeightParameterError;
   } else {
-    if (this->use_bias_ && this->weights_.size() != this->bias_.size()) {
+    if (this->use_bias_ && weight_num != this->bias_.size()) {
       return InferStatus::kInferFailedBiasParameterError;
       LOG(ERROR) << "The size of the weight and bias parameters is not equal";
     }
   }
 
-  CHECK(weights_.size() == 1);
+  KUIPER_FORWARD_CHECK(weight_num == 1);
   if (use_bias_) {
-    CHECK(bias_.size() == 1);
+    KUIPER_FORWARD_CHECK(bias_.size() == 1);
+  }
+  if (global_pooling_) {
+    ForwardGlobalPooling(inputs, outputs);
+    return InferStatus::kInferSuccess;
   }
-  uint32_t batch = inputs.size();
-  const std::shared_ptr<Tensor<float>> &weight = weights_.front();
 
-#pragma omp parallel for num_threads(batch)
+  const uint32_t batch = inputs.size();
+  KUIPER_FORWARD_CHECK(inputs.front() != nullptr && inputs.front()->raw_shapes().size() == 2)
+      << "The input feature map of linear layer is empty";
+  const uint32_t input_dim = inputs.front()->raw_shapes().at(1);
   for (uint32_t i = 0; i < batch; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map of linear layer is empty";
     const std::vector<uint32_t> &raw_shapes = input->raw_shapes();
-    CHECK(raw_shapes.size() == 2);
+    KUIPER_FORWARD_CHECK(raw_shapes.size() == 2);
     const uint32_t feature_dims = raw_shapes.at(0);
-    arma::fmat weight_data(weight->data().memptr(), out_features_, in_features_);
-    CHECK(weight_data.n_rows == out_features_);
-    CHECK(weight_data.n_cols == feature_dims && feature_dims == in_features_);
-    const uint32_t input_dim = raw_shapes.at(1);
+    KUIPER_FORWARD_CHECK(feature_dims == in_features_);
+    KUIPER_FORWARD_CHECK(raw_shapes.at(1) == input_dim) << "The input shapes of linear layer are different";
+  }
 
-    arma::fmat col_vec(input->data().memptr(), in_features_, input_dim);
-    arma::fmat result = (weight_data * col_vec);
+  // 整个批次的输入拼成一个in_features x (input_dim * batch)的矩阵，只做一次矩阵乘法，权重只需要读取一次
+  // 批次已经在一块连续内存中时直接使用，否则先复制到临时内存
+  const size_t sample_size = size_t(in_features_) * input_dim;
+  std::vector<float> workspace_buffer;
+  float *input_ptr = Tensor<float>::ContiguousBatch(inputs);
+  if (input_ptr == nullptr) {
+    input_ptr = AcquireWorkspace(sample_size * batch, workspace_buffer);
+    ThreadPool::Current().ParallelFor(0, batch, [&](uint32_t i) {
+      memcpy(input_ptr + i * sample_size, inputs.at(i)->data().memptr(), sample_size * sizeof(float));
+    });
+  }
+  const arma::fmat col_vec(input_ptr, in_features_, input_dim * batch, false, true);
+  const bool fused = UseSparseWeights() || UsePackedWeights();
+  arma::fmat results = UseSparseWeights() ? MultiplySparse(col_vec)
+                                          : (fused ? MultiplyPacked(col_vec) : Multiply(col_vec));
 
-    if (use_bias_) {
-      CHECK(!this->bias_.empty());
-      const auto &bias_cube = this->bias_.front();
-      CHECK(!bias_cube->empty());
+  const float *bias_ptr = nullptr;
+  if (!fused && use_bias_) {
+    KUIPER_FORWARD_CHECK(!this->bias_.empty());
+    const auto &bias_cube = this->bias_.front();
+    KUIPER_FORWARD_CHECK(!bias_cube->empty());
+    KUIPER_FORWARD_CHECK(bias_cube->data().n_slices == 1);
+    KUIPER_FORWARD_CHECK(bias_cube->data().n_rows == out_features_);
+    bias_ptr = bias_cube->data().memptr();
+  }
 
-      const auto &bias_data = bias_cube->data();
-      CHECK(bias_data.n_slices == 1);
-      CHECK(bias_data.n_rows == out_features_);
-      result += bias_data.slice(0);
+  ThreadPool::Current().ParallelFor(0, batch, [&](uint32_t i) {
+    float *result_ptr = results.colptr(i * input_dim);
+    const uint32_t output_size = out_features_ * input_dim;
+    if (!fused) {
+      // 偏置和激活函数没有在矩阵乘法中计算
+      if (bias_ptr != nullptr) {
+        for (uint32_t col = 0; col < input_dim; ++col) {
+          float *col_ptr = result_ptr + size_t(col) * out_features_;
+          for (uint32_t j = 0; j < out_features_; ++j) {
+            col_ptr[j] += bias_ptr[j];
+          }
+        }
+      }
+      ApplyActivation(activation_, result_ptr, output_size);
     }
 
     auto &output = outputs.at(i);
     if (output == nullptr || output->empty()) {
       output = std::make_shared<Tensor<float>>(1, out_features_, input_dim);
     }
-    CHECK(output->channels() == 1 && output->rows() == out_features_ && output->cols() == input_dim);
+    KUIPER_FORWARD_CHECK(output->channels() == 1 && output->rows() == out_features_ && output->cols() == input_dim);
     const auto &output_raw_shapes = output->raw_shapes();
-    CHECK(output_raw_shapes.size() == 2);
-    CHECK(output_raw_shapes.at(0) == out_features_ && output_raw_shapes.at(1) == input_dim);
-    output->at(0) = std::move(result);
-    outputs.at(i) = output;
-  }
+    KUIPER_FORWARD_CHECK(output_raw_shapes.size() == 2);
+    KUIPER_FORWARD_CHECK(output_raw_shapes.at(0) == out_features_ && output_raw_shapes.at(1) == input_dim);
+    memcpy(output->data().memptr(), result_ptr, output_size * sizeof(float));
+  });
   return InferStatus::kInferSuccess;
 }
 
+arma::fmat LinearLayer::Multiply(const arma::fmat &input) const {
+  if (!quantized_weights_.empty()) {
+    return MultiplyInt8(input);
+  }
+  if (!compressed_weights_.empty()) {
+    return MultiplyCompressed(input);
+  }
+  if (!group_weights_.empty()) {
+    return MultiplyGroupQuantized(input);
+  }
+  const std::shared_ptr<Tensor<float>> &weight = weights_.front();
+  arma::fmat weight_data(weight->data().memptr(), out_features_, in_features_, false, true);
+  CHECK(input.n_rows == in_features_);
+  // 按输入特征把权重切分成连续的列块，每个块计算部分和后再累加，单个样本也能用满所有的线程
+  const uint32_t block_num = std::max(1u, std::min(ThreadPool::Current().thread_num(),
+                                                   uint32_t(in_features_) / kLinearMinBlockSize));
+  if (block_num == 1) {
+    arma::fmat result(out_features_, input.n_cols);
+    Gemm(false, false, out_features_, input.n_cols, in_features_, 1.f, weight_data.memptr(), out_features_,
+         input.memptr(), input.n_rows, 0.f, result.memptr(), out_features_);
+    return result;
+  }
+  std::vector<arma::fmat> block_results(block_num);
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    const uint32_t col_begin = block * in_features_ / block_num;
+    const uint32_t col_end = (block + 1) * in_features_ / block_num;
+    // 输入的行块不连续，通过ld直接在原矩阵上计算，不需要复制
+    arma::fmat &block_result = block_results.at(block);
+    block_result.set_size(out_features_, input.n_cols);
+    Gemm(false, false, out_features_, input.n_cols, col_end - col_begin, 1.f, weight_data.colptr(col_begin),
+         out_features_, input.memptr() + col_begin, input.n_rows, 0.f, block_result.memptr(), out_features_);
+  });
+  arma::fmat result = std::move(block_results.front());
+  for (uint32_t block = 1; block < block_num; ++block) {
+    result += block_results.at(block);
+  }
+  return result;
+}
+
+bool LinearLayer::UsePackedWeights() const {
+  return quantized_weights_.empty() && !packed_weights_.empty();
+}
+
+arma::fmat LinearLayer::MultiplyPacked(const arma::fmat &input) const {
+  CHECK(input.n_rows == in_features_);
+  GemmEpilogue epilogue;
+  if (use_bias_) {
+    CHECK(!this->bias_.empty() && this->bias_.front()->size() == out_features_);
+    epilogue.row_bias = this->bias_.front()->data().memptr();
+  }
+  epilogue.activation = activation_;
+
+  // 每个线程计算连续的若干个面板，单个样本时读取权重的带宽也被所有线程分担
+  arma::fmat result(out_features_, input.n_cols);
+  const uint32_t panel = packed_weights_.panel;
+  const uint32_t panel_num = (uint32_t(out_features_) + panel - 1) / panel;
+  const uint32_t block_num = std::min(panel_num, ThreadPool::Current().thread_num());
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    const uint32_t row_begin = std::min(block * panel_num / block_num * panel, uint32_t(out_features_));
+    const uint32_t row_end = std::min((block + 1) * panel_num / block_num * panel, uint32_t(out_features_));
+    GemmEpilogue block_epilogue = epilogue;
+    if (block_epilogue.row_bias != nullptr) {
+      block_epilogue.row_bias += row_begin;
+    }
+    GemmPackedA(packed_weights_, row_begin, row_end - row_begin, false, input.n_cols, input.memptr(), input.n_rows,
+                result.memptr() + row_begin, out_features_, block_epilogue);
+  });
+  return result;
+}
+
+bool LinearLayer::UseSparseWeights() const {
+  return quantized_weights_.empty() && !sparse_weights_.empty();
+}
+
+arma::fmat LinearLayer::MultiplySparse(const arma::fmat &input) const {
+  CHECK(input.n_rows == in_features_);
+  GemmEpilogue epilogue;
+  if (use_bias_) {
+    CHECK(!this->bias_.empty() && this->bias_.front()->size() == out_features_);
+    epilogue.col_bias = this->bias_.front()->data().memptr();
+  }
+  epilogue.activation = activation_;
+
+  // 稀疏权重按输出特征压缩，计算的是转置之后的结果input^T * weight^T
+  // 转置之后一个输入特征在所有输入列上的值连续，每个非零权重对它们做一次向量乘加，只有一列时不需要转置
+  const uint32_t cols = input.n_cols;
+  arma::fmat input_t;
+  arma::fmat result(out_features_, cols);
+  arma::fmat result_t;
+  const float *input_ptr = input.memptr();
+  float *result_ptr = result.memptr();
+  if (cols > 1) {
+    input_t = input.t();
+    input_ptr = input_t.memptr();
+    result_t.set_size(cols, out_features_);
+    result_ptr = result_t.memptr();
+  }
+  const uint32_t block_num = std::max(1u, std::min(ThreadPool::Current().thread_num(),
+                                                   uint32_t(out_features_) / kLinearSparseMinBlock));
+  ThreadPool::Current().ParallelFor(0, block_num, [&](uint32_t block) {
+    const uint32_t col_begin = block * out_features_ / block_num;
+    const uint32_t col_end = (block + 1) * out_features_ / block_num;
+    GemmEpilogue block_epilogue = epilogue;
+    if (block_epilogue.col_bias != nullptr) {
+      block_epilogue.col_bias += col_begin;
+    }
+    SparseGemm(cols, input_ptr, cols, sparse_weights_, col_begin, col_end - col_begin,
+               result_ptr + size_t(col_begin) * cols, cols, block_epilogue);
+  });
+  if (cols > 1) {
+    result = result_t.t();
+  }
+  return result;
+}
+
+arma::fmat LinearLayer::MultiplyCompressed(const arma::fmat &input) const {
+  CHECK(input.n_rows == in_features_);
+  arma::fmat result(out_features_, input.n_cols);
+  // 每个面板的输出特征互不相关，不需要像按输入特征切分时那样累加部分和
+  const uint32_t panel_num = (out_features_ + kLinearPanelRows - 1) / kLinearPanelRows;
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, panel_num, [&](uint32_t panel) {
+    const uint16_t *panel_ptr = compressed_weights_.data() + size_t(panel) * in_features_ * kLinearPanelRows;
+    const uint32_t row_begin = panel * kLinearPanelRows;
+    const uint32_t row_num = std::min(kLinearPanelRows, uint32_t(out_features_) - row_begin);
+    kernels.half_panel(compressed_type_ == RuntimeDataType::kTypeBFloat16, panel_ptr, kLinearPanelRows, in_features_,
+                       input.memptr(), input.n_rows, input.n_cols, row_num, result.memptr() + row_begin,
+                       result.n_rows);
+  });
+  return result;
+}
+
+arma::fmat LinearLayer::MultiplyGroupQuantized(const arma::fmat &input) const {
+  CHECK(input.n_rows == in_features_);
+  arma::fmat result(out_features_, input.n_cols);
+  // 面板的划分和半精度权重相同，每个面板还带有自己的一组系数
+  const uint32_t panel_num = (out_features_ + kLinearPanelRows - 1) / kLinearPanelRows;
+  const size_t panel_scales = size_t(group_weights_.group_num()) * kLinearPanelRows;
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, panel_num, [&](uint32_t panel) {
+    const uint8_t *panel_ptr = group_weights_.data.data() + group_weights_.panel_bytes() * panel;
+    const float *scales_ptr = group_weights_.scales.data() + panel_scales * panel;
+    const uint32_t row_begin = panel * kLinearPanelRows;
+    const uint32_t row_num = std::min(kLinearPanelRows, uint32_t(out_features_) - row_begin);
+    kernels.quant_panel(group_weights_.bits, panel_ptr, scales_ptr, kLinearPanelRows, group_weights_.group_size,
+                        in_features_, input.memptr(), input.n_rows, input.n_cols, row_num,
+                        result.memptr() + row_begin, result.n_rows);
+  });
+  return result;
+}
+
+void LinearLayer::PackCompressedWeights(RuntimeDataType type, const uint16_t *weights, uint32_t row_stride,
+                                        uint32_t col_stride) {
+  const uint32_t panel_num = (out_features_ + kLinearPanelRows - 1) / kLinearPanelRows;
+  compressed_weights_.assign(size_t(panel_num) * in_features_ * kLinearPanelRows, 0);
+  for (uint32_t o = 0; o < out_features_; ++o) {
+    uint16_t *panel_ptr = compressed_weights_.data() + size_t(o / kLinearPanelRows) * in_features_ * kLinearPanelRows;
+    for (uint32_t i = 0; i < in_features_; ++i) {
+      panel_ptr[size_t(i) * kLinearPanelRows + o % kLinearPanelRows] =
+          weights[size_t(o) * row_stride + size_t(i) * col_stride];
+    }
+  }
+  compressed_type_ = type;
+}
+
+arma::fmat LinearLayer::WidenWeights() const {
+  if (!group_weights_.empty()) {
+    return DequantizeGroups(group_weights_);
+  }
+  arma::fmat weight_data(out_features_, in_features_);
+  for (uint32_t o = 0; o < out_features_; ++o) {
+    const uint16_t *panel_ptr =
+        compressed_weights_.data() + size_t(o / kLinearPanelRows) * in_features_ * kLinearPanelRows;
+    for (uint32_t i = 0; i < in_features_; ++i) {
+      const uint16_t value = panel_ptr[size_t(i) * kLinearPanelRows + o % kLinearPanelRows];
+      weight_data.at(o, i) =
+          compressed_type_ == RuntimeDataType::kTypeBFloat16 ? BFloat16ToFloat(value) : HalfToFloat(value);
+    }
+  }
+  return weight_data;
+}
+
+arma::fmat LinearLayer::MultiplyInt8(const arma::fmat &input) const {
+  CHECK(input.n_rows == in_features_);
+  const uint32_t stride = quantized_weights_.stride;
+  const uint32_t cols = input.n_cols;
+  // 每一列输入量化之后补0到和权重的行相同的长度
+  std::vector<int8_t> quantized_input(size_t(stride) * cols, 0);
+  std::vector<float> input_scales(cols, input_scale_);
+  ThreadPool::Current().ParallelFor(0, cols, [&](uint32_t col) {
+    const float *col_ptr = input.colptr(col);
+    if (input_scale_ <= 0.f) {
+      float abs_max = 0.f;
+      for (uint32_t i = 0; i < in_features_; ++i) {
+        abs_max = std::max(abs_max, std::abs(col_ptr[i]));
+      }
+      input_scales.at(col) = QuantizeScale(abs_max);
+    }
+    QuantizeSymmetric(col_ptr, in_features_, input_scales.at(col), quantized_input.data() + size_t(col) * stride);
+  });
+
+  arma::fmat result(out_features_, cols);
+  const uint32_t row_block_num = (out_features_ + kLinearInt8RowBlock - 1) / kLinearInt8RowBlock;
+  ThreadPool::Current().ParallelFor(0, row_block_num, [&](uint32_t block) {
+    const uint32_t row_begin = block * kLinearInt8RowBlock;
+    const uint32_t row_end = std::min(uint32_t(out_features_), row_begin + kLinearInt8RowBlock);
+    int32_t accumulators[kLinearInt8RowBlock];
+    for (uint32_t col = 0; col < cols; ++col) {
+      Int8MatrixVector(quantized_weights_, quantized_input.data() + size_t(col) * stride, row_begin, row_end,
+                       accumulators);
+      float *result_ptr = result.colptr(col);
+      const float input_scale = input_scales.at(col);
+      for (uint32_t row = row_begin; row < row_end; ++row) {
+        result_ptr[row] = float(accumulators[row - row_begin]) * (quantized_weights_.scales.at(row) * input_scale);
+      }
+    }
+  });
+  return result;
+}
+
+void LinearLayer::ForwardGlobalPooling(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  const uint32_t batch = inputs.size();
+  for (const auto &input : inputs) {
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map of linear layer is empty";
+    KUIPER_FORWARD_CHECK(input->channels() == in_features_)
+            << "The input channels of linear layer is not equal to in features";
+  }
+
+  // 池化结果的第i列是第i个样本的输入特征，池化在批次和通道之间一起并行
+  std::vector<float> workspace_buffer;
+  float *pooled_ptr = AcquireWorkspace(size_t(batch) * in_features_, workspace_buffer);
+  ThreadPool::Current().ParallelFor(0, batch * in_features_, [&](uint32_t index) {
+    pooled_ptr[index] = AdaptiveAveragePoolingLayer::GlobalAveragePooling(inputs.at(index / in_features_),
+                                                                           index % in_features_);
+  });
+  const arma::fmat pooled(pooled_ptr, in_features_, batch, false, true);
+  const bool fused = UseSparseWeights() || UsePackedWeights();
+  arma::fmat result = UseSparseWeights() ? MultiplySparse(pooled)
+                                         : (fused ? MultiplyPacked(pooled) : Multiply(pooled));
+
+  for (uint32_t i = 0; i < batch; ++i) {
+    float *result_ptr = result.colptr(i);
+    if (!fused) {
+      if (use_bias_) {
+        KUIPER_FORWARD_CHECK(!this->bias_.empty());
+        const float *bias_ptr = this->bias_.front()->data().memptr();
+        for (uint32_t j = 0; j < out_features_; ++j) {
+          result_ptr[j] += bias_ptr[j];
+        }
+      }
+      ApplyActivation(activation_, result_ptr, out_features_);
+    }
+
+    auto &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(1, out_features_, 1);
+    }
+    KUIPER_FORWARD_CHECK(output->channels() == 1 && output->rows() == out_features_ && output->cols() == 1);
+    memcpy(output->data().memptr(), result_ptr, out_features_ * sizeof(float));
+  }
+}
+
+bool LinearLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                   std::vector<int32_t> &output_shape) const {
+  // 合并了全局平均池化时输入是NCHW的特征图，池化之后每个通道对应一个特征
+  if (global_pooling_) {
+    if (input_shapes.empty() || input_shapes.front().size() != 4 || input_shapes.front().at(1) != in_features_) {
+      return false;
+    }
+    output_shape = {input_shapes.front().at(0), out_features_};
+    return true;
+  }
+  // 输入的第二维是特征维度，其余维度保持不变
+  if (input_shapes.empty() || input_shapes.front().size() < 2 || input_shapes.front().at(1) != in_features_) {
+    return false;
+  }
+  output_shape = input_shapes.front();
+  output_shape.at(1) = out_features_;
+  return true;
+}
+
+uint64_t LinearLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                            const std::vector<int32_t> &output_shape) const {
+  const uint64_t output_size = ShapeSize(output_shape);
+  const uint64_t pooling_flops = global_pooling_ && !input_shapes.empty() ? ShapeSize(input_shapes.front()) : 0;
+  return output_size * uint64_t(in_features_) * 2 + (use_bias_ ? output_size : 0) + pooling_flops;
+}
+
+size_t LinearLayer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  if (input_shapes.empty() || input_shapes.front().empty()) {
+    return 0;
+  }
+  if (global_pooling_) {
+    return size_t(input_shapes.front().at(0)) * in_features_;
+  }
+  // 批次不在连续内存中时，所有样本的输入先复制到一起
+  return ShapeSize(input_shapes.front());
+}
+
+size_t LinearLayer::ParamBytes() const {
+  if (UseSparseWeights()) {
+    // 稀疏计算只读取压缩之后的权重
+    size_t param_bytes = sparse_weights_.bytes();
+    for (const auto &bias : this->bias_) {
+      param_bytes += bias ? bias->size() * sizeof(float) : 0;
+    }
+    return param_bytes;
+  }
+  if (quantized_weights_.empty() && compressed_weights_.empty() && group_weights_.empty()) {
+    // 打包的权重是weights_之外的一份拷贝
+    return ParamLayer::ParamBytes() + packed_weights_.packed_size() * sizeof(float);
+  }
+  // 量化之后每次Forward读取的是INT8权重和每个输出特征的系数，压缩之后读取的是半精度的权重，
+  // 按组量化之后读取的是8位或者4位的权重和每组的系数
+  size_t param_bytes = compressed_weights_.size() * sizeof(uint16_t) + group_weights_.bytes();
+  if (!quantized_weights_.empty()) {
+    param_bytes = quantized_weights_.data.size() + quantized_weights_.scales.size() * sizeof(float);
+  }
+  for (const auto &bias : this->bias_) {
+    param_bytes += bias ? bias->size() * sizeof(float) : 0;
+  }
+  return param_bytes;
+}
+
+void LinearLayer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+  ParamLayer::PlaceParams(policy, node);
+  PlaceMemory(packed_weights_.packed_data(), packed_weights_.packed_size() * sizeof(float), policy, node);
+  PlaceMemory(compressed_weights_.data(), compressed_weights_.size() * sizeof(uint16_t), policy, node);
+  PlaceMemory(group_weights_.data.data(), group_weights_.data.size(), policy, node);
+  PlaceMemory(group_weights_.scales.data(), group_weights_.scales.size() * sizeof(float), policy, node);
+  PlaceMemory(quantized_weights_.data.data(), quantized_weights_.data.size(), policy, node);
+  PlaceMemory(quantized_weights_.scales.data(), quantized_weights_.scales.size() * sizeof(float), policy, node);
+  PlaceMemory(quantized_weights_.row_sums.data(), quantized_weights_.row_sums.size() * sizeof(int32_t), policy, node);
+  PlaceMemory(sparse_weights_.row_indices.data(), sparse_weights_.row_indices.size() * sizeof(uint32_t), policy, node);
+  PlaceMemory(sparse_weights_.values.data(), sparse_weights_.values.size() * sizeof(float), policy, node);
+}
+
+void LinearLayer::ShareParams(SharedParams &shared_params) {
+  // 量化和压缩的权重不是float，仍然由每个计算图自己持有
+  ParamLayer::ShareParams(shared_params);
+  shared_params.Share(packed_weights_);
+}
+
+bool LinearLayer::QuantizeInt8(float input_abs_max) {
+  if (!compressed_weights_.empty() || !group_weights_.empty()) {
+    quantized_weights_ = QuantizeRows(WidenWeights());
+    input_scale_ = input_abs_max > 0.f ? QuantizeScale(input_abs_max) : 0.f;
+    return true;
+  }
+  if (this->weights_.size() != 1 || this->weights_.front() == nullptr || this->weights_.front()->empty()) {
+    LOG(ERROR) << "The weight parameters of linear layer is empty, can not quantize";
+    return false;
+  }
+  const std::shared_ptr<Tensor<float>> &weight = weights_.front();
+  const arma::fmat weight_data(weight->data().memptr(), out_features_, in_features_, false, true);
+  quantized_weights_ = QuantizeRows(weight_data);
+  input_scale_ = input_abs_max > 0.f ? QuantizeScale(input_abs_max) : 0.f;
+  return true;
+}
+
+void LinearLayer::set_weights(const float *weights, uint32_t size) {
+  if (this->weights_.empty()) {
+    this->weights_.push_back(std::make_shared<Tensor<float>>(1, out_features_, in_features_));
+  }
+  compressed_weights_.clear();
+  compressed_weights_.shrink_to_fit();
+  compressed_type_ = RuntimeDataType::kTypeUnknown;
+  group_weights_ = GroupQuantizedMatrix();
+  quantized_weights_ = QuantizedMatrix();
+  packed_weights_ = GemmPackedMatrix();
+  sparse_weights_ = SparseMatrix();
+  ParamLayer::set_weights(weights, size);
+  const std::shared_ptr<Tensor<float>> &weight = weights_.front();
+  // 剪枝之后大部分权重为0时按输出特征压缩，只对非零权重做乘加，不再打包稠密的权重
+  if (ZeroRatio(weight->data().memptr(), weight->size()) >= SparseThreshold()) {
+    sparse_weights_ = SparsifyColumns(weight->data().memptr(), in_features_, out_features_, out_features_, 1);
+    return;
+  }
+  // 内置的矩阵乘法直接读取打包好的权重，偏置和激活函数也在其中计算
+  if (CurrentGemmBackend() == GemmBackend::kBuiltin) {
+    packed_weights_ = GemmPackA(false, out_features_, in_features_, weight->data().memptr(), out_features_);
+  }
+}
+
+void LinearLayer::set_weights(RuntimeDataType type, const std::vector<uint16_t> &weights) {
+  set_weights(type, weights.data(), weights.size());
+}
+
+void LinearLayer::set_weights(RuntimeDataType type, const uint16_t *weights, uint32_t size) {
+  CHECK(type == RuntimeDataType::kTypeFloat16 || type == RuntimeDataType::kTypeBFloat16)
+          << "Unsupported compressed weight type: " << int(type);
+  CHECK_EQ(size, size_t(out_features_) * in_features_);
+  PackCompressedWeights(type, weights, in_features_, 1);
+  group_weights_ = GroupQuantizedMatrix();
+  quantized_weights_ = QuantizedMatrix();
+  packed_weights_ = GemmPackedMatrix();
+  sparse_weights_ = SparseMatrix();
+  this->weights_.clear();
+}
+
+bool LinearLayer::CompressWeights(RuntimeDataType type) {
+  if (type != RuntimeDataType::kTypeFloat16 && type != RuntimeDataType::kTypeBFloat16) {
+    LOG(ERROR) << "Unsupported compressed weight type: " << int(type);
+    return false;
+  }
+  if (this->weights_.size() != 1 || this->weights_.front() == nullptr || this->weights_.front()->empty()) {
+    LOG(ERROR) << "The weight parameters of linear layer is empty, can not compress";
+    return false;
+  }
+  // float权重按列优先排列，转换之后再分成面板
+  const std::shared_ptr<Tensor<float>> &weight = weights_.front();
+  std::vector<uint16_t> weights(weight->size());
+  if (type == RuntimeDataType::kTypeFloat16) {
+    FloatToHalf(weight->data().memptr(), weight->size(), weights.data());
+  } else {
+    FloatToBFloat16(weight->data().memptr(), weight->size(), weights.data());
+  }
+  PackCompressedWeights(type, weights.data(), 1, out_features_);
+  packed_weights_ = GemmPackedMatrix();
+  sparse_weights_ = SparseMatrix();
+  this->weights_.clear();
+  return true;
+}
+
+bool LinearLayer::QuantizeWeights(uint32_t bits, uint32_t group_size) {
+  if (bits != 8 && bits != 4) {
+    LOG(ERROR) << "Unsupported weight quantization bits: " << bits;
+    return false;
+  }
+  if (group_size == 0) {
+    LOG(ERROR) << "The weight quantization group size must be greater than zero";
+    return false;
+  }
+  if (!group_weights_.empty()) {
+    // 原始的权重已经丢弃，再次量化会叠加误差
+    LOG_IF(ERROR, group_weights_.bits != bits || group_weights_.group_size != group_size)
+            << "The weights of linear layer have been quantized to " << group_weights_.bits << " bits";
+    return group_weights_.bits == bits && group_weights_.group_size == group_size;
+  }
+  if (compressed_weights_.empty()) {
+    if (this->weights_.size() != 1 || this->weights_.front() == nullptr || this->weights_.front()->empty()) {
+      LOG(ERROR) << "The weight parameters of linear layer is empty, can not quantize";
+      return false;
+    }
+    const std::shared_ptr<Tensor<float>> &weight = weights_.front();
+    const arma::fmat weight_data(weight->data().memptr(), out_features_, in_features_, false, true);
+    group_weights_ = QuantizeGroups(weight_data, bits, group_size, kLinearPanelRows);
+  } else {
+    group_weights_ = QuantizeGroups(WidenWeights(), bits, group_size, kLinearPanelRows);
+  }
+  compressed_weights_.clear();
+  compressed_weights_.shrink_to_fit();
+  compressed_type_ = RuntimeDataType::kTypeUnknown;
+  quantized_weights_ = QuantizedMatrix();
+  packed_weights_ = GemmPackedMatrix();
+  sparse_weights_ = SparseMatrix();
+  this->weights_.clear();
+  return true;
+}
+
+RuntimeDataType LinearLayer::weight_type() const {
+  if (!group_weights_.empty()) {
+    return group_weights_.bits == 4 ? RuntimeDataType::kTypeInt4 : RuntimeDataType::kTypeInt8;
+  }
+  return compressed_weights_.empty() ? RuntimeDataType::kTypeFloat32 : compressed_type_;
+}
+
+uint32_t LinearLayer::weight_bits() const {
+  if (!group_weights_.empty()) {
+    return group_weights_.bits;
+  }
+  return compressed_weights_.empty() ? 32 : 16;
+}
+
+void LinearLayer::set_global_pooling(bool global_pooling) {
+  global_pooling_ = global_pooling;
+}
+
 ParseParameterAttrStatus LinearLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                   std::shared_ptr<Layer> &linear_layer) {
   CHECK(op != nullptr) << "Linear operator is nullptr";
@@ -125,13 +652,40 @@ ParseParameterAttrStatus LinearLayer::GetInstance(const std::shared_ptr<RuntimeO
   int32_t in_features = shapes.at(1);
   const bool use_bias = use_bias_param->value;
 
-  linear_layer = std::make_shared<LinearLayer>(in_features, out_features, use_bias);
+  // 计算图合并进来的激活函数是可选的参数
+  ActivationType activation_type;
+  if (!ParseFusedActivation(op, "activation", activation_type)) {
+    return ParseParameterAttrStatus::kParameterMissingActivation;
+  }
+
+  // 计算图合并进来的全局平均池化同样是可选的参数
+  bool global_pooling = false;
+  if (params.find("global_pooling") != params.end()) {
+    const auto &global_pooling_param = dynamic_cast<RuntimeParameterBool *>(params.at("global_pooling"));
+    if (!global_pooling_param) {
+      LOG(ERROR) << "Can not find the global pooling parameter";
+      return ParseParameterAttrStatus::kParameterMissingGlobalPooling;
+    }
+    global_pooling = global_pooling_param->value;
+  }
+
+  std::shared_ptr<LinearLayer> layer = std::make_shared<LinearLayer>(in_features, out_features, use_bias);
+  layer->set_activation(activation_type);
+  layer->set_global_pooling(global_pooling);
+  linear_layer = layer;
   if (use_bias) {
-    linear_layer->set_bias(bias->get<float>());
+    std::vector<float> bias_buffer;
+    linear_layer->set_bias(bias->view<float>(bias_buffer), bias->element_num());
   }
 
-  // load weights
-  linear_layer->set_weights(weight->get<float>());
+  // 加载权重，直接从属性或者映射的权重文件中读取，半精度的权重保持压缩
+  if (weight->type == RuntimeDataType::kTypeFloat16 || weight->type == RuntimeDataType::kTypeBFloat16) {
+    std::vector<uint16_t> weight_buffer;
+    layer->set_weights(weight->type, weight->view<uint16_t>(weight_buffer), weight->element_num());
+  } else {
+    std::vector<float> weight_buffer;
+    linear_layer->set_weights(weight->view<float>(weight_buffer), weight->element_num());
+  }
   return ParseParameterAttrStatus::kParameterAttrParseSuccess;
 }
 
@@ -6,6 +6,10 @@
 #define KUIPER_COURSE_SOURCE_LAYER_LINEAR_HPP_
 #include "layer/abstract/layer.hpp"
 #include "layer/abstract/param_layer.hpp"
+#include "data/quantize.hpp"
+#include "data/gemm.hpp"
+#include "data/sparse.hpp"
+#include "runtime/runtime_datatype.hpp"
 
 namespace kuiper_infer {
 class LinearLayer : public ParamLayer {
@@ -17,12 +21,178 @@ class LinearLayer : public ParamLayer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
+  size_t ParamBytes() const override;
+
+  void PlaceParams(NumaMemoryPolicy policy, uint32_t node) override;
+
+  void ShareParams(SharedParams &shared_params) override;
+
+  /**
+   * 将权重逐个输出特征对称量化为INT8，之后的矩阵乘法使用int32累加，浮点权重保留用于重新量化
+   * 需要在加载权重之后调用，之后再修改权重需要重新量化
+   * @param input_abs_max 标定时输入的最大绝对值，不大于0时每组输入特征按照自己的最大绝对值量化
+   * @return 是否转换成功
+   */
+  bool QuantizeInt8(float input_abs_max) override;
+
+  /**
+   * 将权重按组对称量化为8位或者4位，输入和输出保持float，计算时在寄存器中反量化，不再保存float和半精度的权重
+   * 权重按照半精度权重相同的面板排列，每个输出特征每group_size个输入特征使用一个系数
+   * @param bits 量化的位数，8或者4
+   * @param group_size 每组包含的输入特征数量
+   * @return 是否量化成功
+   */
+  bool QuantizeWeights(uint32_t bits, uint32_t group_size) override;
+
+  using ParamLayer::set_weights;
+
+  /**
+   * 设置float权重，之前压缩保存的半精度权重被丢弃
+   * @param weights 按行优先排列的权重
+   * @param size 权重的元素数量
+   */
+  void set_weights(const float *weights, uint32_t size) override;
+
+  /**
+   * 设置半精度的权重，权重在内存中保持压缩，计算时逐块展开为float，不再保存float权重
+   * @param type 权重的类型，kTypeFloat16或者kTypeBFloat16
+   * @param weights 按行优先排列的权重编码
+   */
+  void set_weights(RuntimeDataType type, const std::vector<uint16_t> &weights);
+
+  /**
+   * 从一块连续的内存设置半精度的权重
+   * @param type 权重的类型，kTypeFloat16或者kTypeBFloat16
+   * @param weights 按行优先排列的权重编码
+   * @param size 权重的元素数量
+   */
+  void set_weights(RuntimeDataType type, const uint16_t *weights, uint32_t size);
+
+  /**
+   * 将已经加载的float权重压缩为半精度，权重的内存和每次Forward读取的字节数减半
+   * @param type 压缩的类型，kTypeFloat16或者kTypeBFloat16
+   * @return 是否压缩成功
+   */
+  bool CompressWeights(RuntimeDataType type);
+
+  /**
+   * 返回权重在内存中保存的类型
+   * @return 没有压缩时为kTypeFloat32，按组量化时为kTypeInt8或者kTypeInt4
+   */
+  RuntimeDataType weight_type() const;
+
+  /**
+   * 返回每个权重在内存中占用的位数
+   * @return float权重为32，半精度权重为16，按组量化的权重为8或者4
+   */
+  uint32_t weight_bits() const;
+
+  /**
+   * 设置是否将前面的全局平均池化和展平合并进来，合并后输入是每个通道对应一个特征的特征图
+   * @param global_pooling 是否先对输入做全局平均池化
+   */
+  void set_global_pooling(bool global_pooling);
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &linear_layer);
  private:
+  /**
+   * 计算权重和输入矩阵的乘积，按输入特征把权重切分成连续的列块并行计算
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 乘积，每一列是一组输出特征
+   */
+  arma::fmat Multiply(const arma::fmat &input) const;
+
+  /**
+   * 量化之后的矩阵乘法，输入的每一列量化为INT8，按输出特征切分成行块并行计算
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 反量化之后的乘积，每一列是一组输出特征
+   */
+  arma::fmat MultiplyInt8(const arma::fmat &input) const;
+
+  /**
+   * 半精度权重的矩阵乘法，按面板并行计算，权重在计算时展开为float
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 乘积，每一列是一组输出特征
+   */
+  arma::fmat MultiplyCompressed(const arma::fmat &input) const;
+
+  /**
+   * 按组量化权重的矩阵乘法，按面板并行计算，每组的部分和乘以系数之后再累加
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 乘积，每一列是一组输出特征
+   */
+  arma::fmat MultiplyGroupQuantized(const arma::fmat &input) const;
+
+  /**
+   * 是否使用打包的float权重计算，这时偏置和激活函数在矩阵乘法写回结果时计算
+   * @return 是否使用打包的权重
+   */
+  bool UsePackedWeights() const;
+
+  /**
+   * 打包权重的矩阵乘法，按输出特征的面板切分到线程池中，每个面板写回时加上偏置并计算激活函数
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 偏置和激活函数之后的结果，每一列是一组输出特征
+   */
+  arma::fmat MultiplyPacked(const arma::fmat &input) const;
+
+  /**
+   * 是否使用稀疏的权重计算，这时偏置和激活函数同样在写回结果时计算
+   * @return 是否使用稀疏的权重
+   */
+  bool UseSparseWeights() const;
+
+  /**
+   * 稀疏权重的矩阵乘法，按输出特征切分到线程池中，只对非零权重做乘加
+   * @param input 输入矩阵，每一列是一组输入特征
+   * @return 偏置和激活函数之后的结果，每一列是一组输出特征
+   */
+  arma::fmat MultiplySparse(const arma::fmat &input) const;
+
+  /**
+   * 将半精度的权重编码按照输出特征分成面板保存，面板中同一个输入特征对应的权重连续排列，最后一个面板补0
+   * @param type 权重的类型
+   * @param weights 权重编码，第o个输出特征的第i个权重位于o * row_stride + i * col_stride
+   * @param row_stride 相邻输出特征之间的距离
+   * @param col_stride 相邻输入特征之间的距离
+   */
+  void PackCompressedWeights(RuntimeDataType type, const uint16_t *weights, uint32_t row_stride,
+                             uint32_t col_stride);
+
+  /**
+   * 将压缩或者按组量化的权重展开为float矩阵
+   * @return 形状为out_features x in_features的权重
+   */
+  arma::fmat WidenWeights() const;
+
+  /**
+   * 全局平均池化合并进来时的计算，整个批次的池化结果组成一个矩阵，只做一次矩阵乘法
+   * @param inputs 输入的特征图
+   * @param outputs 输出的特征
+   */
+  void ForwardGlobalPooling(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                            std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
   int32_t in_features_ = 0;
   int32_t out_features_ = 0;
   bool use_bias_ = false;
+  bool global_pooling_ = false;
+  QuantizedMatrix quantized_weights_; /// 量化之后的权重，为空时使用浮点计算
+  float input_scale_ = 0.f; /// 输入的量化系数，不大于0时每组输入动态计算
+  std::vector<uint16_t> compressed_weights_; /// 分成面板保存的半精度权重，为空时使用weights_中的float权重
+  RuntimeDataType compressed_type_ = RuntimeDataType::kTypeUnknown; /// 压缩的权重的类型
+  GroupQuantizedMatrix group_weights_; /// 按组只量化权重的矩阵，为空时不使用
+  GemmPackedMatrix packed_weights_; /// 设置权重时使用内置矩阵乘法才创建，按内置实现的面板格式打包的float权重
+  SparseMatrix sparse_weights_; /// 权重中0的比例达到阈值时创建，按输出特征压缩的float权重，存在时不再打包
 };
 }
 
@@ -5,13 +5,173 @@
 #include "maxpooling.hpp"
 #include "runtime/runtime_ir.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "runtime/thread_pool.hpp"
+#ifdef USE_CUDA
+#include "../../backend/cuda/cuda_kernels.hpp"
+#endif
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 namespace kuiper_infer {
 
+#if defined(__AVX512F__)
+/// AVX-512一次处理16个float
+struct PoolingVector {
+  using Type = __m512;
+  static constexpr uint32_t kWidth = 16;
+  static Type Load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm512_storeu_ps(ptr, x); }
+  static Type Max(Type x, Type y) { return _mm512_max_ps(x, y); }
+  static Type LoadStride2(const float *ptr) {
+    const __m512i index = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    return _mm512_permutex2var_ps(_mm512_loadu_ps(ptr), index, _mm512_loadu_ps(ptr + 16));
+  }
+};
+#elif defined(__AVX2__)
+/// AVX2一次处理8个float
+struct PoolingVector {
+  using Type = __m256;
+  static constexpr uint32_t kWidth = 8;
+  static Type Load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  static void Store(float *ptr, Type x) { _mm256_storeu_ps(ptr, x); }
+  static Type Max(Type x, Type y) { return _mm256_max_ps(x, y); }
+  static Type LoadStride2(const float *ptr) {
+    // 两次读取的偶数位置在每个128位中交错排列，再按照64位重新排序
+    const __m256 even = _mm256_shuffle_ps(_mm256_loadu_ps(ptr), _mm256_loadu_ps(ptr + 8), _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+/// NEON一次处理4个float
+struct PoolingVector {
+  using Type = float32x4_t;
+  static constexpr uint32_t kWidth = 4;
+  static Type Load(const float *ptr) { return vld1q_f32(ptr); }
+  static void Store(float *ptr, Type x) { vst1q_f32(ptr, x); }
+  static Type Max(Type x, Type y) { return vmaxq_f32(x, y); }
+  static Type LoadStride2(const float *ptr) { return vld2q_f32(ptr).val[0]; }
+};
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define KUIPER_POOLING_SIMD
+#endif
+
+/// 行方向的缓冲区末尾额外保留的元素，步长为2的向量读取会越过最后一个窗口
+constexpr uint32_t kPoolingBufferTail = 32;
+
+/**
+ * 池化窗口在列方向上的最大值，窗口中的各列逐元素取最大值，每列在内存中连续
+ * @tparam kColNum 实例化时固定的列数，为0时使用col_num
+ * @param input_channel 输入的通道
+ * @param col_begin 窗口中第一个有效的列
+ * @param col_num 窗口中有效的列数
+ * @param column_max 每一行在窗口各列中的最大值
+ */
+template<uint32_t kColNum>
+static void ColumnMax(const arma::fmat &input_channel, uint32_t col_begin, uint32_t col_num, float *column_max) {
+  const uint32_t input_h = input_channel.n_rows;
+  const uint32_t cols = FixedOr<kColNum>(col_num);
+  if (cols == 0) {
+    std::fill(column_max, column_max + input_h, std::numeric_limits<float>::lowest());
+    return;
+  }
+  memcpy(column_max, input_channel.colptr(col_begin), input_h * sizeof(float));
+  for (uint32_t w = 1; w < cols; ++w) {
+    const float *col_ptr = input_channel.colptr(col_begin + w);
+    uint32_t h = 0;
+#ifdef KUIPER_POOLING_SIMD
+    for (; h + PoolingVector::kWidth <= input_h; h += PoolingVector::kWidth) {
+      PoolingVector::Store(column_max + h, PoolingVector::Max(PoolingVector::Load(column_max + h),
+                                                              PoolingVector::Load(col_ptr + h)));
+    }
+#endif
+    for (; h < input_h; ++h) {
+      column_max[h] = std::max(column_max[h], col_ptr[h]);
+    }
+  }
+}
+
+/**
+ * 在行方向上对列的最大值做一维池化，缓冲区两端已经用最小值填充，不需要处理边界
+ * @tparam kPoolingH 实例化时固定的窗口高度，为0时使用pooling_h
+ * @tparam kStrideH 实例化时固定的行方向步长，为0时使用stride_h
+ * @param column_max 填充之后每一行的最大值
+ * @param output_h 输出的行数
+ * @param pooling_h 窗口的高度
+ * @param stride_h 行方向的步长
+ * @param output 输出的一列
+ */
+template<uint32_t kPoolingH, uint32_t kStrideH>
+static void RowMax(const float *column_max, uint32_t output_h, uint32_t pooling_h, uint32_t stride_h,
+                   float *output) {
+  pooling_h = FixedOr<kPoolingH>(pooling_h);
+  stride_h = FixedOr<kStrideH>(stride_h);
+  uint32_t r = 0;
+#ifdef KUIPER_POOLING_SIMD
+  // 步长为1时窗口内每个偏移量对应一次连续的读取，步长为2时对应一次隔一个元素的读取
+  if (stride_h == 1) {
+    for (; r + PoolingVector::kWidth <= output_h; r += PoolingVector::kWidth) {
+      PoolingVector::Type max_value = PoolingVector::Load(column_max + r);
+      for (uint32_t j = 1; j < pooling_h; ++j) {
+        max_value = PoolingVector::Max(max_value, PoolingVector::Load(column_max + r + j));
+      }
+      PoolingVector::Store(output + r, max_value);
+    }
+  } else if (stride_h == 2) {
+    for (; r + PoolingVector::kWidth <= output_h; r += PoolingVector::kWidth) {
+      PoolingVector::Type max_value = PoolingVector::LoadStride2(column_max + r * 2);
+      for (uint32_t j = 1; j < pooling_h; ++j) {
+        max_value = PoolingVector::Max(max_value, PoolingVector::LoadStride2(column_max + r * 2 + j));
+      }
+      PoolingVector::Store(output + r, max_value);
+    }
+  }
+#endif
+  for (; r < output_h; ++r) {
+    const float *window = column_max + r * stride_h;
+    float max_value = window[0];
+    for (uint32_t j = 1; j < pooling_h; ++j) {
+      max_value = std::max(max_value, window[j]);
+    }
+    output[r] = max_value;
+  }
+}
+
+/// 一个通道的最大池化，窗口大小和步长固定的实例中窗口内的循环次数都是常量，Kernel<0, 0, 0, 0>是通用实例
+template<uint32_t kPoolingH, uint32_t kPoolingW, uint32_t kStrideH, uint32_t kStrideW>
+struct MaxPoolingChannel {
+  using Function = MaxPoolingKernel;
+
+  static void Run(const PoolingWindow &window, const arma::fmat &input_channel, float *column_buffer,
+                  arma::fmat &output_channel) {
+    const uint32_t pooling_w = FixedOr<kPoolingW>(window.pooling_w);
+    const uint32_t stride_w = FixedOr<kStrideW>(window.stride_w);
+    float *column_max = column_buffer + window.padding_h;
+    for (uint32_t c = 0; c < window.output_w; ++c) {
+      const int32_t window_c = int32_t(c * stride_w) - int32_t(window.padding_w);
+      const uint32_t col_begin = std::max(window_c, 0);
+      const uint32_t col_end = std::min(window_c + int32_t(pooling_w), int32_t(window.input_w));
+      // 只有完整的窗口使用固定列数的实例，越过边界的窗口列数更少
+      const uint32_t col_num = col_end > col_begin ? col_end - col_begin : 0;
+      if (kPoolingW != 0 && col_num == kPoolingW) {
+        ColumnMax<kPoolingW>(input_channel, col_begin, col_num, column_max);
+      } else {
+        ColumnMax<0>(input_channel, col_begin, col_num, column_max);
+      }
+      RowMax<kPoolingH, kStrideH>(column_buffer, window.output_h, window.pooling_h, window.stride_h,
+                                  output_channel.colptr(c));
+    }
+  }
+};
+
 MaxPoolingLayer::MaxPoolingLayer(uint32_t padding_h, uint32_t padding_w, uint32_t pooling_size_h,
                                  uint32_t pooling_size_w, uint32_t stride_h, uint32_t stride_w)
     : Layer("MaxPooling"), padding_h_(padding_h), padding_w_(padding_w), pooling_size_h_(pooling_size_h),
       pooling_size_w_(pooling_size_w), stride_h_(stride_h), stride_w_(stride_w) {
-
+  channel_kernel_ = SelectWindowKernel<MaxPoolingChannel>(pooling_size_h, pooling_size_w, stride_h, stride_w);
 }
 
 InferStatus MaxPoolingLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
@@ -50,56 +210,124 @@ InferStatus MaxPoolingLayer::Forward(const std::vector<std::shared_ptr<Tensor<fl
     }
   }
 
-#pragma omp parallel for num_threads(batch)
-  for (uint32_t i = 0; i < batch; ++i) {
+  ThreadPool::Current().ParallelFor(0, batch, [&](uint32_t i) {
     const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
-    std::shared_ptr<Tensor<float>> input_data_;
-    CHECK(input_data == nullptr || !input_data->empty()) << "The input feature map of max pooling layer is empty";
-
-    if (padding_h_ > 0 || padding_w_ > 0) {
-      input_data_ = input_data->Clone();
-      input_data_->Padding({padding_h_, padding_h_, padding_w_, padding_w_}, std::numeric_limits<float>::lowest());
-    } else {
-      input_data_ = input_data;
-    }
+    KUIPER_FORWARD_CHECK(input_data != nullptr && !input_data->empty())
+            << "The input feature map of max pooling layer is empty";
 
-    const uint32_t input_h = input_data_->rows();
-    const uint32_t input_w = input_data_->cols();
-    const uint32_t input_c = input_data_->channels();
+    const uint32_t input_h = input_data->rows();
+    const uint32_t input_w = input_data->cols();
+    const uint32_t input_c = input_data->channels();
 
-    const uint32_t output_h = uint32_t(std::floor((input_h - pooling_h) / stride_h_ + 1));
-    const uint32_t output_w = uint32_t(std::floor((input_w - pooling_w) / stride_w_ + 1));
+    const uint32_t output_h = uint32_t(std::floor((input_h - pooling_h + 2 * padding_h_) / stride_h_ + 1));
+    const uint32_t output_w = uint32_t(std::floor((input_w - pooling_w + 2 * padding_w_) / stride_w_ + 1));
 
     std::shared_ptr<Tensor<float>> output_data = outputs.at(i);
     if (output_data == nullptr || output_data->empty()) {
       output_data = std::make_shared<Tensor<float>>(input_c, output_h, output_w);
     }
 
-    CHECK(output_data->rows() == output_h && output_data->cols() == output_w
+    KUIPER_FORWARD_CHECK(output_data->rows() == output_h && output_data->cols() == output_w
               && output_data->channels() == input_c) << "The output size of maxpooling is error";
 
-    for (uint32_t ic = 0; ic < input_c; ++ic) {
-      const arma::fmat &input_channel = input_data_->at(ic);
-      arma::fmat &output_channel = output_data->at(ic);
-      for (uint32_t c = 0; c < input_w - pooling_w + 1; c += stride_w_) {
-        for (uint32_t r = 0; r < input_h - pooling_h + 1; r += stride_h_) {
-
-          float *output_channel_ptr = output_channel.colptr(int(c / stride_w_));
-          float max_value = std::numeric_limits<float>::lowest();
-          for (uint32_t w = 0; w < pooling_w; ++w) {
-            const float *col_ptr = input_channel.colptr(c + w) + r;
-            for (uint32_t h = 0; h < pooling_h; ++h) {
-              float current_value = *(col_ptr + h);
-              max_value = max_value > current_value ? max_value : current_value;
-            }
-          }
-          *(output_channel_ptr + int(r / stride_h_)) = max_value;
-        }
+    // 在通道之间并行
+    // 二维的最大值可以分解为先在列方向后在行方向取最大值，窗口越过边界的列直接跳过，越过边界的行填充最小值
+    const uint32_t buffer_size = input_h + 2 * padding_h_ + kPoolingBufferTail;
+    PoolingWindow window;
+    window.pooling_h = pooling_h;
+    window.pooling_w = pooling_w;
+    window.stride_h = stride_h_;
+    window.stride_w = stride_w_;
+    window.padding_h = padding_h_;
+    window.padding_w = padding_w_;
+    window.input_w = input_w;
+    window.output_h = output_h;
+    window.output_w = output_w;
+    ThreadPool::Current().ParallelFor(0, input_c, [&](uint32_t ic) {
+      thread_local std::vector<float> column_buffer;
+      if (column_buffer.size() < buffer_size) {
+        column_buffer.resize(buffer_size);
       }
-    }
+      std::fill(column_buffer.begin(), column_buffer.begin() + buffer_size, std::numeric_limits<float>::lowest());
+      channel_kernel_(window, input_data->at(ic), column_buffer.data(), output_data->at(ic));
+    });
     outputs.at(i) = output_data;
+  });
+  return InferStatus::kInferSuccess;
+}
+
+bool MaxPoolingLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus MaxPoolingLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                         std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+#ifdef USE_CUDA
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of max pooling layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  if (!stride_h_ || !stride_w_) {
+    LOG(ERROR) << "The stride parameter is set incorrectly. It must always be greater than 0";
+    return InferStatus::kInferFailedStrideParameterError;
+  }
+
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input_data != nullptr && !input_data->empty())
+            << "The input feature map of max pooling layer is empty";
+    const uint32_t input_h = input_data->rows();
+    const uint32_t input_w = input_data->cols();
+    const uint32_t input_c = input_data->channels();
+    if (input_h + 2 * padding_h_ < pooling_size_h_ || input_w + 2 * padding_w_ < pooling_size_w_) {
+      LOG(ERROR) << "The size of the output feature map is less than zero";
+      return InferStatus::kInferFailedOutputSizeError;
+    }
+    const uint32_t output_h = (input_h + 2 * padding_h_ - pooling_size_h_) / stride_h_ + 1;
+    const uint32_t output_w = (input_w + 2 * padding_w_ - pooling_size_w_) / stride_w_ + 1;
+
+    std::shared_ptr<Tensor<float>> &output_data = outputs.at(i);
+    if (output_data == nullptr || output_data->empty()) {
+      output_data = std::make_shared<Tensor<float>>(input_c, output_h, output_w);
+    }
+    KUIPER_FORWARD_CHECK(output_data->rows() == output_h && output_data->cols() == output_w
+              && output_data->channels() == input_c) << "The output size of maxpooling is error";
+
+    cuda::MaxPooling(input_data->cuda_data(), input_c, input_h, input_w, pooling_size_h_, pooling_size_w_, stride_h_,
+                     stride_w_, padding_h_, padding_w_, output_h, output_w, output_data->cuda_data());
+    output_data->set_device(DeviceType::kDeviceCUDA);
   }
   return InferStatus::kInferSuccess;
+#else
+  return Layer::ForwardCuda(inputs, outputs);
+#endif
+}
+
+bool MaxPoolingLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                       std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  const int32_t input_h = input_shape.at(2) + 2 * int32_t(padding_h_);
+  const int32_t input_w = input_shape.at(3) + 2 * int32_t(padding_w_);
+  if (input_h < int32_t(pooling_size_h_) || input_w < int32_t(pooling_size_w_)) {
+    return false;
+  }
+  output_shape = {input_shape.at(0), input_shape.at(1), (input_h - int32_t(pooling_size_h_)) / int32_t(stride_h_) + 1,
+                  (input_w - int32_t(pooling_size_w_)) / int32_t(stride_w_) + 1};
+  return true;
+}
+
+uint64_t MaxPoolingLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                const std::vector<int32_t> &output_shape) const {
+  return ShapeSize(output_shape) * pooling_size_h_ * pooling_size_w_;
 }
 
 ParseParameterAttrStatus MaxPoolingLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
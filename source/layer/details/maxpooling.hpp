@@ -2,10 +2,15 @@
 // Created by fss on 22-11-12.
 //
 
-#ifndef KUIPER_COURSE_SOURCE_LAYER_AVGPOOLING_HPP_
-#define KUIPER_COURSE_SOURCE_LAYER_AVGPOOLING_HPP_
+#ifndef KUIPER_COURSE_SOURCE_LAYER_MAXPOOLING_HPP_
+#define KUIPER_COURSE_SOURCE_LAYER_MAXPOOLING_HPP_
 #include "layer/abstract/layer.hpp"
+#include "layer/abstract/window_kernel.hpp"
 namespace kuiper_infer {
+/// 一个通道的最大池化内核，column_buffer是行方向的缓冲区，两端按照填充大小预先写入最小值
+using MaxPoolingKernel = void (*)(const PoolingWindow &window, const arma::fmat &input_channel, float *column_buffer,
+                                  arma::fmat &output_channel);
+
 class MaxPoolingLayer : public Layer {
  public:
   explicit MaxPoolingLayer(uint32_t padding_h, uint32_t padding_w, uint32_t pooling_size_h,
@@ -14,6 +19,17 @@ class MaxPoolingLayer : public Layer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  bool SupportDevice(DeviceType device) const override;
+
+  InferStatus ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                          std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &max_layer);
 
@@ -24,6 +40,7 @@ class MaxPoolingLayer : public Layer {
   uint32_t pooling_size_w_ = 0;
   uint32_t stride_h_ = 1;
   uint32_t stride_w_ = 1;
+  MaxPoolingKernel channel_kernel_ = nullptr; /// 创建时按照窗口大小和步长选择的通道内核
 };
 }
-#endif //KUIPER_COURSE_SOURCE_LAYER_AVGPOOLING_HPP_
+#endif //KUIPER_COURSE_SOURCE_LAYER_MAXPOOLING_HPP_
@@ -3,6 +3,7 @@
 //
 #include "relu.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
 namespace kuiper_infer {
 InferStatus ReluLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                                std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
@@ -16,26 +17,36 @@ InferStatus ReluLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
   }
 
   const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input == nullptr || !input->empty()) << "The input feature map of relu layer is empty";
+    KUIPER_FORWARD_CHECK(input == nullptr || !input->empty()) << "The input feature map of relu layer is empty";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
       LOG(ERROR) << "The output size of relu is error";
       output = input->Clone();
     }
-    CHECK(output->shapes()== input->shapes()) << "The output size of relu is error";
-    output->set_data(input->data());
-    output->Transform([](float val) {
-      return val > 0. ? val : 0.;
-    });
+    KUIPER_FORWARD_CHECK(output->shapes()== input->shapes()) << "The output size of relu is error";
     outputs.at(i) = output;
   }
 
+  ApplyActivation(ActivationType::kActivationRelu, inputs, outputs);
   return InferStatus::kInferSuccess;
 }
+
+bool ReluLayer::SupportInPlace() const {
+  return true;
+}
+
+bool ReluLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus ReluLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                   std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return ForwardActivationCuda(ActivationType::kActivationRelu, inputs, outputs);
+}
+
 ParseParameterAttrStatus ReluLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                 std::shared_ptr<Layer> &relu_layer) {
   CHECK(op != nullptr) << "Relu operator is nullptr";
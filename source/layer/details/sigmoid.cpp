@@ -4,6 +4,7 @@
 
 #include "sigmoid.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
 #include <glog/logging.h>
 
 namespace kuiper_infer {
@@ -21,10 +22,9 @@ InferStatus SigmoidLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
   }
 
   const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input == nullptr || !input->empty()) << "The input feature map of sigmoid layer is empty!";
+    KUIPER_FORWARD_CHECK(input == nullptr || !input->empty()) << "The input feature map of sigmoid layer is empty!";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
@@ -33,14 +33,26 @@ InferStatus SigmoidLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
 
     CHECK (output->shapes() == input->shapes()) << "The output size of sigmoid is error";
 
-    output->set_data(input->data());
-    arma::fcube &output_data_cube = output->data();
-    output_data_cube = 1 / (1 + arma::exp(-output_data_cube));
     outputs.at(i) = output;
   }
+
+  ApplyActivation(ActivationType::kActivationSigmoid, inputs, outputs);
   return InferStatus::kInferSuccess;
 }
 
+bool SigmoidLayer::SupportInPlace() const {
+  return true;
+}
+
+bool SigmoidLayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus SigmoidLayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                      std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return ForwardActivationCuda(ActivationType::kActivationSigmoid, inputs, outputs);
+}
+
 ParseParameterAttrStatus SigmoidLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                    std::shared_ptr<Layer> &sigmoid_layer) {
   CHECK(op != nullptr) << "Sigmoid operator is nullptr";
@@ -4,6 +4,7 @@
 
 #include "silu.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
 namespace kuiper_infer {
 
 SiLULayer::SiLULayer() : Layer("SiLU") {
@@ -24,10 +25,9 @@ InferStatus SiLULayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
 
   const uint32_t batch_size = inputs.size();
 
-//#pragma omp parallel for num_threads(batch_size)
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input == nullptr || !input->empty()) << "The input feature map of silu layer is empty!";
+    KUIPER_FORWARD_CHECK(input == nullptr || !input->empty()) << "The input feature map of silu layer is empty!";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
@@ -35,15 +35,26 @@ InferStatus SiLULayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
     }
 
     CHECK (output->shapes() == input->shapes()) << "The output size of silu is error";
-    output->set_data(input->data());
-    output->Transform([](const float value) {
-      return value / (1.f + std::exp(-value));
-    });
     outputs.at(i) = output;
   }
+
+  ApplyActivation(ActivationType::kActivationSiLU, inputs, outputs);
   return InferStatus::kInferSuccess;
 }
 
+bool SiLULayer::SupportInPlace() const {
+  return true;
+}
+
+bool SiLULayer::SupportDevice(DeviceType device) const {
+  return device == DeviceType::kDeviceCPU || device == DeviceType::kDeviceCUDA;
+}
+
+InferStatus SiLULayer::ForwardCuda(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                   std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  return ForwardActivationCuda(ActivationType::kActivationSiLU, inputs, outputs);
+}
+
 ParseParameterAttrStatus SiLULayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                 std::shared_ptr<Layer> &silu_layer) {
   CHECK(op != nullptr) << "SiLU operator is nullptr";
@@ -4,9 +4,16 @@
 
 #include "softmax.hpp"
 #include <glog/logging.h>
+#include <algorithm>
+#include "layer/abstract/layer_factory.hpp"
+#include "runtime/thread_pool.hpp"
+#include "../../kernels/cpu_kernels.hpp"
 
 namespace kuiper_infer {
-SoftmaxLayer::SoftmaxLayer() : Layer("Softmax") {
+// 每个并行任务处理的相邻列数
+static constexpr uint32_t kSoftmaxColumnBlock = 64;
+
+SoftmaxLayer::SoftmaxLayer(int dim, int input_dims) : Layer("Softmax"), dim_(dim), input_dims_(input_dims) {
 
 }
 
@@ -22,31 +29,109 @@ InferStatus SoftmaxLayer::Forward(const std::vector<std::shared_ptr<Tensor<float
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
   }
 
+  if (input_dims_ < 2 || input_dims_ > 4) {
+    LOG(ERROR) << "The input dims of softmax layer is error";
+    return InferStatus::kInferFailedDimensionParameterError;
+  }
+  const int32_t dim = dim_ < 0 ? dim_ + input_dims_ : dim_;
+  if (dim <= 0 || dim >= input_dims_) {
+    LOG(ERROR) << "The dimension of softmax layer is error";
+    return InferStatus::kInferFailedDimensionParameterError;
+  }
+
+  // 输入在张量中的位置：4维的[N, C, H, W]对应(C, H, W)，3维的[N, A, B]对应(1, A, B)，2维的[N, K]对应(1, K, 1)
+  // axis为0、1、2分别表示沿着通道、行和列计算
+  uint32_t axis = 1;
+  if (input_dims_ == 4) {
+    axis = dim - 1;
+  } else if (input_dims_ == 3) {
+    axis = dim;
+  }
+
   const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
-    CHECK(input != nullptr && !input->empty()) << "The input feature map for softmax layer is empty";
+    KUIPER_FORWARD_CHECK(input != nullptr && !input->empty()) << "The input feature map for softmax layer is empty";
+    KUIPER_FORWARD_CHECK(input->shapes() == inputs.front()->shapes())
+            << "The input shapes of softmax layer are different";
 
     std::shared_ptr<Tensor<float>> output = outputs.at(i);
     if (output == nullptr || output->empty()) {
+      LOG(ERROR) << "The output size of softmax is error";
       output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
-      LOG(ERROR) << "The output size of softmax is empty" << "The output size of softmax is error";
+      outputs.at(i) = output;
     }
+    KUIPER_FORWARD_CHECK(input->shapes() == output->shapes()) << "The output size of softmax is error";
+  }
+
+  // 每个批次的张量划分为outer组，每组inner个相邻的列，同一列的length个元素相距stride
+  const Tensor<float> &first = *inputs.front();
+  const uint32_t channels = first.channels();
+  const uint32_t rows = first.rows();
+  const uint32_t cols = first.cols();
+  uint32_t outer = 0;
+  uint32_t length = 0;
+  uint32_t inner = 0;
+  if (axis == 0) {
+    outer = 1;
+    length = channels;
+    inner = rows * cols;
+  } else if (axis == 1) {
+    outer = channels * cols;
+    length = rows;
+    inner = 1;
+  } else {
+    outer = channels;
+    length = cols;
+    inner = rows;
+  }
+  const uint32_t stride = axis == 1 ? 1 : inner;
+  const uint32_t group_size = length * inner;
 
-    CHECK(input->shapes() == output->shapes()) << "The output size of softmax is error";
+  const uint32_t inner_blocks = (inner + kSoftmaxColumnBlock - 1) / kSoftmaxColumnBlock;
+  const uint32_t task_num = batch_size * outer * inner_blocks;
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, task_num, [&](uint32_t task) {
+    const uint32_t b = task / (outer * inner_blocks);
+    const uint32_t o = task / inner_blocks % outer;
+    const uint32_t block = task % inner_blocks;
+    const uint32_t inner_start = block * kSoftmaxColumnBlock;
+    const uint32_t inner_size = std::min(kSoftmaxColumnBlock, inner - inner_start);
+    const size_t offset = size_t(o) * group_size + inner_start;
+    kernels.softmax(inputs.at(b)->data().memptr() + offset, length, stride, inner_size,
+                    outputs.at(b)->data().memptr() + offset);
+  });
+  return InferStatus::kInferSuccess;
+}
 
-    const arma::fcube &input_data = input->data();
-    arma::fcube &output_data = output->data();
+bool SoftmaxLayer::SupportInPlace() const {
+  return true;
+}
 
-    const float max = input_data.max();
-    const float sum = arma::accu(arma::exp(input_data - max));
-    const float offset = max + logf(sum);
+ParseParameterAttrStatus SoftmaxLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
+                                                   std::shared_ptr<Layer> &softmax_layer) {
+  CHECK(op != nullptr) << "Softmax operator is nullptr";
+  const auto &params = op->params;
+  if (params.find("dim") == params.end()) {
+    LOG(ERROR) << "Can not find the dim parameter";
+    return ParseParameterAttrStatus::kParameterMissingDim;
+  }
 
-    output_data = arma::exp(input_data - offset);
-    outputs.at(i) = output;
+  const auto &dim_param = dynamic_cast<RuntimeParameterInt *>(params.at("dim"));
+  if (!dim_param) {
+    LOG(ERROR) << "Can not find the dim parameter";
+    return ParseParameterAttrStatus::kParameterMissingDim;
   }
-  return InferStatus::kInferSuccess;
+
+  int32_t input_dims = 4;
+  if (!op->input_operands_seq.empty() && op->input_operands_seq.front() != nullptr) {
+    input_dims = int32_t(op->input_operands_seq.front()->shapes.size());
+  }
+  softmax_layer = std::make_shared<SoftmaxLayer>(dim_param->value, input_dims);
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
 }
 
-}
\ No newline at end of file
+LayerRegistererWrapper kSoftmaxGetInstance("nn.Softmax", SoftmaxLayer::GetInstance);
+
+LayerRegistererWrapper kFSoftmaxGetInstance("F.softmax", SoftmaxLayer::GetInstance);
+}
@@ -9,11 +9,24 @@
 namespace kuiper_infer {
 class SoftmaxLayer : public Layer {
  public:
-  explicit SoftmaxLayer();
+  /**
+   * 沿着一个维度计算softmax
+   * @param dim 计算的维度，按照包含batch的输入形状计数，可以为负数，不能是batch维
+   * @param input_dims 输入操作数的维数，支持2、3、4维
+   */
+  explicit SoftmaxLayer(int dim = -1, int input_dims = 4);
 
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool SupportInPlace() const override;
+
+  static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
+                                              std::shared_ptr<Layer> &softmax_layer);
+
+ private:
+  int32_t dim_ = -1; /// 计算的维度
+  int32_t input_dims_ = 4; /// 输入操作数的维数
 };
 }
 
@@ -0,0 +1,189 @@
+#include "squeeze_excitation.hpp"
+#include <cstring>
+#include <glog/logging.h>
+#include "adaptive_avgpooling.hpp"
+#include "layer/abstract/layer_factory.hpp"
+#include "data/gemm.hpp"
+#include "runtime/thread_pool.hpp"
+#include "../../kernels/cpu_kernels.hpp"
+
+namespace kuiper_infer {
+SqueezeExcitationLayer::SqueezeExcitationLayer(uint32_t channels, uint32_t squeeze_channels,
+                                               ActivationType squeeze_activation, ActivationType excite_activation)
+    : ParamLayer("SqueezeExcitation"), channels_(channels), squeeze_channels_(squeeze_channels),
+      squeeze_activation_(squeeze_activation), excite_activation_(excite_activation) {
+  CHECK(channels > 0 && squeeze_channels > 0) << "The channels of squeeze excitation layer is empty";
+  // 按行优先排列的权重复制到张量中之后就是按列优先排列的转置矩阵
+  this->weights_ = {std::make_shared<Tensor<float>>(1, channels, squeeze_channels),
+                    std::make_shared<Tensor<float>>(1, squeeze_channels, channels)};
+  this->bias_ = {std::make_shared<Tensor<float>>(1, squeeze_channels, 1),
+                 std::make_shared<Tensor<float>>(1, channels, 1)};
+  for (const auto &param : this->weights_) {
+    param->Fill(0.f);
+  }
+  for (const auto &param : this->bias_) {
+    param->Fill(0.f);
+  }
+}
+
+/**
+ * 将按行优先排列的权重和偏移量复制到张量中
+ */
+static void CopyParams(const float *weight, uint32_t weight_size, const float *bias, uint32_t bias_size,
+                       const std::shared_ptr<Tensor<float>> &weight_tensor,
+                       const std::shared_ptr<Tensor<float>> &bias_tensor) {
+  CHECK(weight != nullptr);
+  CHECK_EQ(weight_size, weight_tensor->size());
+  CHECK(bias_size == 0 || bias_size == bias_tensor->size());
+  memcpy(weight_tensor->data().memptr(), weight, size_t(weight_size) * sizeof(float));
+  if (bias_size == 0) {
+    bias_tensor->Fill(0.f);
+  } else {
+    memcpy(bias_tensor->data().memptr(), bias, size_t(bias_size) * sizeof(float));
+  }
+}
+
+void SqueezeExcitationLayer::set_squeeze_params(const std::vector<float> &weight, const std::vector<float> &bias) {
+  CopyParams(weight.data(), weight.size(), bias.data(), bias.size(), this->weights_.at(0), this->bias_.at(0));
+}
+
+void SqueezeExcitationLayer::set_excite_params(const std::vector<float> &weight, const std::vector<float> &bias) {
+  CopyParams(weight.data(), weight.size(), bias.data(), bias.size(), this->weights_.at(1), this->bias_.at(1));
+}
+
+/**
+ * 从计算节点的属性中读取一组权重和偏移量并复制到张量中，属性中的数据按照float对齐时不经过中间数组
+ */
+static void CopyAttributeParams(const RuntimeAttribute &weight, const RuntimeAttribute &bias,
+                                const std::shared_ptr<Tensor<float>> &weight_tensor,
+                                const std::shared_ptr<Tensor<float>> &bias_tensor) {
+  std::vector<float> weight_buffer;
+  std::vector<float> bias_buffer;
+  CopyParams(weight.view<float>(weight_buffer), weight.element_num(), bias.view<float>(bias_buffer),
+             bias.element_num(), weight_tensor, bias_tensor);
+}
+
+size_t SqueezeExcitationLayer::WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  if (input_shapes.empty() || input_shapes.front().empty()) {
+    return 0;
+  }
+  return size_t(input_shapes.front().at(0)) * (channels_ * 2 + squeeze_channels_);
+}
+
+uint64_t SqueezeExcitationLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                       const std::vector<int32_t> &output_shape) const {
+  // 池化和缩放各读取一次输入，两次矩阵乘法每个权重一次乘加
+  const uint64_t batch_size = output_shape.empty() ? 1 : uint64_t(output_shape.at(0));
+  return ShapeSize(output_shape) * 2 + batch_size * channels_ * squeeze_channels_ * 4;
+}
+
+bool SqueezeExcitationLayer::SupportInPlace() const {
+  return true;
+}
+
+InferStatus SqueezeExcitationLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                            std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input feature map of squeeze excitation layer is empty";
+    return InferStatus::kInferFailedInputEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output size is not adapting";
+    return InferStatus::kInferFailedInputOutSizeAdaptingError;
+  }
+
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    if (input == nullptr || input->empty() || input->channels() != channels_) {
+      LOG(ERROR) << "The input feature map of squeeze excitation layer is empty or has wrong channels";
+      return InferStatus::kInferFailedInputEmpty;
+    }
+    std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->channels(), input->rows(), input->cols());
+    }
+    KUIPER_FORWARD_CHECK(output->shapes() == input->shapes())
+            << "The output size of squeeze excitation layer is error";
+  }
+
+  // 所有样本的池化结果、压缩结果和缩放系数按列排列，两次矩阵乘法一次计算整个批次
+  std::vector<float> workspace_buffer;
+  float *pooled = AcquireWorkspace(size_t(batch_size) * (channels_ * 2 + squeeze_channels_), workspace_buffer);
+  float *squeezed = pooled + size_t(batch_size) * channels_;
+  float *scales = squeezed + size_t(batch_size) * squeeze_channels_;
+
+  const uint32_t task_num = batch_size * channels_;
+  ThreadPool::Current().ParallelFor(0, task_num, [&](uint32_t task) {
+    pooled[task] = AdaptiveAveragePoolingLayer::GlobalAveragePooling(inputs.at(task / channels_), task % channels_);
+  });
+
+  GemmEpilogue squeeze_epilogue;
+  squeeze_epilogue.row_bias = this->bias_.at(0)->RawPtr();
+  squeeze_epilogue.activation = squeeze_activation_;
+  Gemm(true, false, squeeze_channels_, batch_size, channels_, 1.f, this->weights_.at(0)->RawPtr(), channels_,
+       pooled, channels_, 0.f, squeezed, squeeze_channels_, squeeze_epilogue);
+
+  GemmEpilogue excite_epilogue;
+  excite_epilogue.row_bias = this->bias_.at(1)->RawPtr();
+  excite_epilogue.activation = excite_activation_;
+  Gemm(true, false, channels_, batch_size, squeeze_channels_, 1.f, this->weights_.at(1)->RawPtr(),
+       squeeze_channels_, squeezed, squeeze_channels_, 0.f, scales, channels_, excite_epilogue);
+
+  // 输出就是输入时原地缩放每个通道
+  const CpuKernels &kernels = CurrentCpuKernels();
+  ThreadPool::Current().ParallelFor(0, task_num, [&](uint32_t task) {
+    const uint32_t i = task / channels_;
+    const uint32_t c = task % channels_;
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    const uint32_t plane_size = input->rows() * input->cols();
+    kernels.scale_shift(input->at(c).memptr(), plane_size, scales[task], 0.f, outputs.at(i)->at(c).memptr());
+  });
+  return InferStatus::kInferSuccess;
+}
+
+ParseParameterAttrStatus SqueezeExcitationLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
+                                                             std::shared_ptr<Layer> &se_layer) {
+  CHECK(op != nullptr) << "SqueezeExcitation operator is nullptr";
+  ActivationType squeeze_activation;
+  ActivationType excite_activation;
+  if (!ParseFusedActivation(op, "squeeze_activation", squeeze_activation)
+      || !ParseFusedActivation(op, "excite_activation", excite_activation)) {
+    LOG(ERROR) << "Unsupported fused activation of squeeze excitation";
+    return ParseParameterAttrStatus::kParameterMissingActivation;
+  }
+
+  const auto &attr = op->attribute;
+  const auto &squeeze_weight = attr.find("squeeze_weight");
+  const auto &excite_weight = attr.find("excite_weight");
+  if (squeeze_weight == attr.end() || excite_weight == attr.end()) {
+    LOG(ERROR) << "Can not find the weight parameter";
+    return ParseParameterAttrStatus::kAttrMissingWeight;
+  }
+  const auto &squeeze_bias = attr.find("squeeze_bias");
+  const auto &excite_bias = attr.find("excite_bias");
+  if (squeeze_bias == attr.end() || excite_bias == attr.end()) {
+    LOG(ERROR) << "Can not find the bias parameter";
+    return ParseParameterAttrStatus::kAttrMissingBias;
+  }
+
+  // 压缩的权重形状是squeeze_channels x channels，恢复的权重形状是channels x squeeze_channels
+  const std::vector<int> &squeeze_shape = squeeze_weight->second->shape;
+  const std::vector<int> &excite_shape = excite_weight->second->shape;
+  CHECK(squeeze_shape.size() >= 2 && excite_shape.size() >= 2) << "The weight shape of squeeze excitation is error";
+  const uint32_t squeeze_channels = squeeze_shape.at(0);
+  const uint32_t channels = squeeze_shape.at(1);
+  CHECK(excite_shape.at(0) == int(channels) && excite_shape.at(1) == int(squeeze_channels))
+          << "The weight shapes of squeeze excitation are not adapting";
+
+  std::shared_ptr<SqueezeExcitationLayer> layer =
+      std::make_shared<SqueezeExcitationLayer>(channels, squeeze_channels, squeeze_activation, excite_activation);
+  CopyAttributeParams(*squeeze_weight->second, *squeeze_bias->second, layer->weights_.at(0), layer->bias_.at(0));
+  CopyAttributeParams(*excite_weight->second, *excite_bias->second, layer->weights_.at(1), layer->bias_.at(1));
+  se_layer = layer;
+  return ParseParameterAttrStatus::kParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper kSqueezeExcitationGetInstance("kuiper.SqueezeExcitation", SqueezeExcitationLayer::GetInstance);
+}
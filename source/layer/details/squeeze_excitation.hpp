@@ -0,0 +1,60 @@
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_SQUEEZE_EXCITATION_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_SQUEEZE_EXCITATION_HPP_
+#include "layer/abstract/param_layer.hpp"
+
+namespace kuiper_infer {
+/// 合并之后的Squeeze-and-Excitation模块，由计算图的优化过程从池化、两个1x1卷积和逐元素乘法的节点链生成
+/// 每个通道全局平均池化之后经过两次小矩阵乘法和激活函数得到通道的缩放系数，再对输入的每个通道缩放
+/// weights()依次是压缩和恢复两个矩阵乘法的权重，bias()是对应的偏移量
+class SqueezeExcitationLayer : public ParamLayer {
+ public:
+  /**
+   * 创建Squeeze-and-Excitation模块
+   * @param channels 输入和输出的通道数量
+   * @param squeeze_channels 压缩之后的通道数量
+   * @param squeeze_activation 压缩之后的激活函数，MobileNetV3中是ReLU
+   * @param excite_activation 恢复之后的激活函数，MobileNetV3中是HardSigmoid
+   */
+  SqueezeExcitationLayer(uint32_t channels, uint32_t squeeze_channels, ActivationType squeeze_activation,
+                         ActivationType excite_activation);
+
+  InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                      std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
+
+  /**
+   * 每个样本保存池化结果、压缩结果和缩放系数的临时内存
+   * @param input_shapes 每个输入操作数的形状
+   * @return 需要的float元素数量
+   */
+  size_t WorkspaceSize(const std::vector<std::vector<int32_t>> &input_shapes) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  bool SupportInPlace() const override;
+
+  /**
+   * 设置压缩的权重和偏移量
+   * @param weight 按行优先排列的squeeze_channels x channels矩阵
+   * @param bias squeeze_channels个偏移量，为空时偏移量为0
+   */
+  void set_squeeze_params(const std::vector<float> &weight, const std::vector<float> &bias);
+
+  /**
+   * 设置恢复的权重和偏移量
+   * @param weight 按行优先排列的channels x squeeze_channels矩阵
+   * @param bias channels个偏移量，为空时偏移量为0
+   */
+  void set_excite_params(const std::vector<float> &weight, const std::vector<float> &bias);
+
+  static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
+                                              std::shared_ptr<Layer> &se_layer);
+
+ private:
+  uint32_t channels_ = 0; /// 输入和输出的通道数量
+  uint32_t squeeze_channels_ = 0; /// 压缩之后的通道数量
+  ActivationType squeeze_activation_ = ActivationType::kActivationNone; /// 压缩之后的激活函数
+  ActivationType excite_activation_ = ActivationType::kActivationNone; /// 恢复之后的激活函数
+};
+}
+#endif //KUIPER_INFER_SOURCE_LAYER_DETAILS_SQUEEZE_EXCITATION_HPP_
@@ -3,11 +3,93 @@
 //
 #include "upsample.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "runtime/thread_pool.hpp"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 namespace kuiper_infer {
-UpSampleLayer::UpSampleLayer(float scale_h, float scale_w, UpSampleMode mode)
-    : Layer("upsample"), scale_h_(scale_h), scale_w_(scale_w), mode_(mode) {
 
+/**
+ * 将一列中的每个元素连续重复scale次，2倍上采样时使用向量指令
+ * @param input 输入的一列
+ * @param rows 输入的行数
+ * @param scale 重复的次数
+ * @param output 输出的一列，长度为rows * scale
+ */
+static void RepeatRows(const float *input, uint32_t rows, uint32_t scale, float *output) {
+  uint32_t h = 0;
+  if (scale == 2) {
+#if defined(__AVX512F__)
+    const __m512i low_index = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+    const __m512i high_index = _mm512_setr_epi32(8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15);
+    for (; h + 16 <= rows; h += 16) {
+      const __m512 x = _mm512_loadu_ps(input + h);
+      _mm512_storeu_ps(output + 2 * h, _mm512_permutexvar_ps(low_index, x));
+      _mm512_storeu_ps(output + 2 * h + 16, _mm512_permutexvar_ps(high_index, x));
+    }
+#elif defined(__AVX2__)
+    const __m256i low_index = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i high_index = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    for (; h + 8 <= rows; h += 8) {
+      const __m256 x = _mm256_loadu_ps(input + h);
+      _mm256_storeu_ps(output + 2 * h, _mm256_permutevar8x32_ps(x, low_index));
+      _mm256_storeu_ps(output + 2 * h + 8, _mm256_permutevar8x32_ps(x, high_index));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; h + 4 <= rows; h += 4) {
+      const float32x4_t x = vld1q_f32(input + h);
+      vst1q_f32(output + 2 * h, vzip1q_f32(x, x));
+      vst1q_f32(output + 2 * h + 4, vzip2q_f32(x, x));
+    }
+#endif
+  }
+  for (; h < rows; ++h) {
+    for (uint32_t k = 0; k < scale; ++k) {
+      output[h * scale + k] = input[h];
+    }
+  }
+}
+
+/// 双线性插值时一个输出坐标对应的两个输入坐标和权重
+struct LinearCoordinate {
+  uint32_t index0 = 0; /// 左侧或者上方的输入坐标
+  uint32_t index1 = 0; /// 右侧或者下方的输入坐标
+  float lambda = 0.f; /// index1的权重，index0的权重为1 - lambda
+};
+
+/**
+ * 计算一个维度上每个输出坐标对应的插值坐标，与PyTorch的计算方式一致
+ * @param input_size 输入的长度
+ * @param output_size 输出的长度
+ * @param scale 该维度的缩放倍数
+ * @param align_corners 角点是否对齐
+ * @return 每个输出坐标的插值坐标
+ */
+static std::vector<LinearCoordinate> LinearCoordinates(uint32_t input_size, uint32_t output_size, float scale,
+                                                       bool align_corners) {
+  std::vector<LinearCoordinate> coordinates(output_size);
+  for (uint32_t i = 0; i < output_size; ++i) {
+    float src = 0.f;
+    if (align_corners) {
+      src = output_size > 1 ? float(i) * float(input_size - 1) / float(output_size - 1) : 0.f;
+    } else {
+      src = std::max((float(i) + 0.5f) / scale - 0.5f, 0.f);
+    }
+    LinearCoordinate &coordinate = coordinates.at(i);
+    coordinate.index0 = std::min(uint32_t(src), input_size - 1);
+    coordinate.index1 = std::min(coordinate.index0 + 1, input_size - 1);
+    coordinate.lambda = src - float(coordinate.index0);
+  }
+  return coordinates;
 }
+
+UpSampleLayer::UpSampleLayer(float scale_h, float scale_w, UpSampleMode mode, bool align_corners)
+    : Layer("upsample"), scale_h_(scale_h), scale_w_(scale_w), mode_(mode), align_corners_(align_corners) {
+
+}
+
 InferStatus UpSampleLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                                    std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
   if (inputs.empty()) {
@@ -20,50 +102,109 @@ InferStatus UpSampleLayer::Forward(const std::vector<std::shared_ptr<Tensor<floa
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
   }
 
-  LOG_IF(FATAL, this->mode_ != UpSampleMode::kModeNearest) << "Unsupported upsample mode: " << int(mode_);
+  LOG_IF(FATAL, this->mode_ != UpSampleMode::kModeNearest && this->mode_ != UpSampleMode::kModeBilinear)
+          << "Unsupported upsample mode: " << int(mode_);
 
   const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
+  const std::shared_ptr<Tensor<float>> &first_input = inputs.front();
+  KUIPER_FORWARD_CHECK(first_input != nullptr && !first_input->empty())
+          << "The input feature map of upsample layer is empty";
+  const uint32_t channels = first_input->channels();
+  const uint32_t input_h = first_input->rows();
+  const uint32_t input_w = first_input->cols();
+  const uint32_t output_h = uint32_t(float(input_h) * scale_h_);
+  const uint32_t output_w = uint32_t(float(input_w) * scale_w_);
   for (uint32_t i = 0; i < batch_size; ++i) {
-    const arma::fcube &input_data = inputs.at(i)->data();
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    KUIPER_FORWARD_CHECK(input != nullptr && input->shapes() == first_input->shapes())
+            << "The input shapes of upsample layer are not equal";
     auto &output = outputs.at(i);
     if (output == nullptr || output->empty()) {
-      output = std::make_shared<Tensor<float>>(input_data.n_slices,
-                                               uint32_t(input_data.n_rows * scale_h_),
-                                               uint32_t(input_data.n_cols * scale_w_));
+      output = std::make_shared<Tensor<float>>(channels, output_h, output_w);
     }
-    auto &output_data = output->data();
-    CHECK(output_data.n_rows == input_data.n_rows * scale_h_) << "The height of the feature map is not adapting!";
-    CHECK(output_data.n_cols == input_data.n_cols * scale_w_) << "The width of the feature map is not adapting!";
-    CHECK(input_data.n_slices == output_data.n_slices) << "The channel of the feature map is not adapting!";
-
-    const uint32_t channels = input_data.n_slices;
-    for (uint32_t c = 0; c < channels; ++c) {
-      const arma::fmat &input_channel = input_data.slice(c);
-      arma::fmat &output_channel = output_data.slice(c);
-      const uint32_t output_w = output_channel.n_cols;
-      const uint32_t output_h = output_channel.n_rows;
+    KUIPER_FORWARD_CHECK(output->rows() == output_h) << "The height of the feature map is not adapting!";
+    KUIPER_FORWARD_CHECK(output->cols() == output_w) << "The width of the feature map is not adapting!";
+    KUIPER_FORWARD_CHECK(output->channels() == channels) << "The channel of the feature map is not adapting!";
+  }
 
-      for (uint32_t w = 0; w < output_w; ++w) {
-        const uint32_t src_w = uint32_t((float) w / this->scale_w_);
-        CHECK(src_w < input_channel.n_cols);
-        float *output_channel_ptr = output_channel.colptr(w);
-        const float *input_channel_ptr = input_channel.colptr(src_w);
+  // 坐标映射只和形状有关，在所有通道之前计算一次，循环内部不再做除法和边界检查
+  const bool integer_scale = scale_h_ >= 1.f && scale_w_ >= 1.f && std::floor(scale_h_) == scale_h_
+      && std::floor(scale_w_) == scale_w_ && output_h == input_h * uint32_t(scale_h_)
+      && output_w == input_w * uint32_t(scale_w_);
+  std::vector<uint32_t> src_rows(output_h);
+  std::vector<uint32_t> src_cols(output_w);
+  std::vector<LinearCoordinate> row_coordinates;
+  std::vector<LinearCoordinate> col_coordinates;
+  if (mode_ == UpSampleMode::kModeNearest) {
+    for (uint32_t h = 0; h < output_h; ++h) {
+      src_rows.at(h) = std::min(uint32_t(float(h) / scale_h_), input_h - 1);
+    }
+    for (uint32_t w = 0; w < output_w; ++w) {
+      src_cols.at(w) = std::min(uint32_t(float(w) / scale_w_), input_w - 1);
+    }
+  } else {
+    row_coordinates = LinearCoordinates(input_h, output_h, scale_h_, align_corners_);
+    col_coordinates = LinearCoordinates(input_w, output_w, scale_w_, align_corners_);
+  }
 
+  // 每个任务是一个样本的一个通道
+  ThreadPool::Current().ParallelFor(0, batch_size * channels, [&](uint32_t index) {
+    const arma::fmat &input_channel = inputs.at(index / channels)->at(index % channels);
+    arma::fmat &output_channel = outputs.at(index / channels)->at(index % channels);
+    if (mode_ == UpSampleMode::kModeNearest && integer_scale) {
+      // 整数倍的邻近采样，每个输入列重复行之后得到一个输出列，再整列复制到其余scale_w - 1个输出列
+      const uint32_t scale_h = uint32_t(scale_h_);
+      const uint32_t scale_w = uint32_t(scale_w_);
+      for (uint32_t w = 0; w < input_w; ++w) {
+        float *output_ptr = output_channel.colptr(w * scale_w);
+        RepeatRows(input_channel.colptr(w), input_h, scale_h, output_ptr);
+        for (uint32_t k = 1; k < scale_w; ++k) {
+          memcpy(output_channel.colptr(w * scale_w + k), output_ptr, output_h * sizeof(float));
+        }
+      }
+    } else if (mode_ == UpSampleMode::kModeNearest) {
+      for (uint32_t w = 0; w < output_w; ++w) {
+        const float *input_ptr = input_channel.colptr(src_cols.at(w));
+        float *output_ptr = output_channel.colptr(w);
         for (uint32_t h = 0; h < output_h; ++h) {
-          const uint32_t src_h = uint32_t((float) h / this->scale_h_);
-          CHECK(src_h < input_channel.n_rows);
-
-          const float src_value = *(input_channel_ptr + src_h);
-          *(output_channel_ptr + h) = src_value;
+          output_ptr[h] = input_ptr[src_rows.at(h)];
+        }
+      }
+    } else {
+      // 先在列方向上插值得到完整的一列，列内连续的元素可以向量化，再在行方向上插值
+      thread_local std::vector<float> column;
+      column.resize(input_h);
+      for (uint32_t w = 0; w < output_w; ++w) {
+        const LinearCoordinate &col_coordinate = col_coordinates.at(w);
+        const float *input_ptr0 = input_channel.colptr(col_coordinate.index0);
+        const float *input_ptr1 = input_channel.colptr(col_coordinate.index1);
+        const float lambda_w = col_coordinate.lambda;
+        for (uint32_t h = 0; h < input_h; ++h) {
+          column[h] = input_ptr0[h] + lambda_w * (input_ptr1[h] - input_ptr0[h]);
+        }
+        float *output_ptr = output_channel.colptr(w);
+        for (uint32_t h = 0; h < output_h; ++h) {
+          const LinearCoordinate &row_coordinate = row_coordinates.at(h);
+          const float value0 = column[row_coordinate.index0];
+          output_ptr[h] = value0 + row_coordinate.lambda * (column[row_coordinate.index1] - value0);
         }
       }
     }
-    outputs.at(i) = output;
-  }
+  });
   return InferStatus::kInferSuccess;
 }
 
+bool UpSampleLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                     std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().size() != 4) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  output_shape = {input_shape.at(0), input_shape.at(1), int32_t(float(input_shape.at(2)) * scale_h_),
+                  int32_t(float(input_shape.at(3)) * scale_w_)};
+  return true;
+}
+
 ParseParameterAttrStatus UpSampleLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                     std::shared_ptr<Layer> &upsample_layer) {
 
@@ -89,8 +230,27 @@ ParseParameterAttrStatus UpSampleLayer::GetInstance(const std::shared_ptr<Runtim
   }
 
   const auto &mode = dynamic_cast<RuntimeParameterString *>(params.at("mode"));
-  CHECK(mode->value == "nearest") << "The mode " << mode->value << " is not supported!";
-  upsample_layer = std::make_shared<UpSampleLayer>(scales->value.at(0), scales->value.at(1));
+  if (mode == nullptr) {
+    LOG(ERROR) << "Can not find the mode parameter";
+    return ParseParameterAttrStatus::kParameterMissingResizeMode;
+  }
+  UpSampleMode upsample_mode = UpSampleMode::kModeNearest;
+  if (mode->value == "bilinear") {
+    upsample_mode = UpSampleMode::kModeBilinear;
+  } else {
+    CHECK(mode->value == "nearest") << "The mode " << mode->value << " is not supported!";
+  }
+
+  // 只有双线性插值使用align_corners，pnnx中可能没有这个参数
+  bool align_corners = false;
+  if (params.find("align_corners") != params.end()) {
+    const auto &align_corners_param = dynamic_cast<RuntimeParameterBool *>(params.at("align_corners"));
+    if (align_corners_param != nullptr) {
+      align_corners = align_corners_param->value;
+    }
+  }
+  upsample_layer =
+      std::make_shared<UpSampleLayer>(scales->value.at(0), scales->value.at(1), upsample_mode, align_corners);
   return ParseParameterAttrStatus::kParameterAttrParseSuccess;
 }
 
@@ -8,22 +8,28 @@
 
 namespace kuiper_infer {
 enum class UpSampleMode {
-  kModeNearest = 0, // 目前上采样层只支持邻近采样
+  kModeNearest = 0, // 邻近采样
+  kModeBilinear = 1, // 双线性插值
 };
 
 class UpSampleLayer : public Layer {
  public:
-  explicit UpSampleLayer(float scale_h, float scale_w, UpSampleMode mode = UpSampleMode::kModeNearest);
+  explicit UpSampleLayer(float scale_h, float scale_w, UpSampleMode mode = UpSampleMode::kModeNearest,
+                         bool align_corners = false);
 
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &upsample_layer);
  private:
   float scale_h_ = 0.f;
   float scale_w_ = 0.f;
   UpSampleMode mode_ = UpSampleMode::kModeNearest;
+  bool align_corners_ = false; /// 双线性插值时输入和输出的角点是否对齐
 };
 }
 #endif //KUIPER_INFER_SOURCE_LAYER_DETAILS_UPSAMPLE_HPP_
@@ -21,13 +21,15 @@ InferStatus ViewLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
     return InferStatus::kInferFailedInputOutSizeAdaptingError;
   }
 
-  CHECK(!shapes_.empty()) << "The shape parameter is empty!";
+  KUIPER_FORWARD_CHECK(!shapes_.empty()) << "The shape parameter is empty!";
   const uint32_t batch_size = inputs.size();
-  CHECK(shapes_.front() != -1 && shapes_.front() == batch_size) << "The shape parameter is wrong!";
+  // 形状参数中的批次维度来自模型导出时的批次大小，推理时以实际输入的数量为准
+  KUIPER_FORWARD_CHECK(shapes_.front() == -1 || shapes_.front() > 0) << "The shape parameter is wrong!";
 
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>> &input_data = inputs.at(i);
-    CHECK(input_data != nullptr && !input_data->empty()) << "The input feature map of view layer is empty";
+    KUIPER_FORWARD_CHECK(input_data != nullptr && !input_data->empty())
+            << "The input feature map of view layer is empty";
 
     // 检查形状中-1的数量
     int zero_index = -1;
@@ -36,9 +38,9 @@ InferStatus ViewLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
 
     std::vector<uint32_t> shapes;
     for (int j = 1; j < shapes_.size(); ++j) {
-      CHECK(shapes_.at(j) == -1 || shapes_.at(j) > 0);
+      KUIPER_FORWARD_CHECK(shapes_.at(j) == -1 || shapes_.at(j) > 0);
       if (shapes_.at(j) == -1) {
-        CHECK(zero_index == -1) << "Having two minus one in shape arrays";
+        KUIPER_FORWARD_CHECK(zero_index == -1) << "Having two minus one in shape arrays";
         zero_index = j;
       } else {
         current_size *= shapes_.at(j);
@@ -46,19 +48,74 @@ InferStatus ViewLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>
       }
     }
 
-    CHECK(zero_index == -1 || zero_index == shapes_.size() - 1)
+    KUIPER_FORWARD_CHECK(zero_index == -1 || zero_index == shapes_.size() - 1)
             << "Minus one shape is in the wrong axis, only at the last axis!";
     if (zero_index != -1) {
-      CHECK(total_size >= current_size);
+      KUIPER_FORWARD_CHECK(total_size >= current_size);
       shapes.push_back(uint32_t(total_size / current_size));
     }
-    std::shared_ptr<Tensor<float>> output_data = input_data->Clone();
-    output_data->ReRawView(shapes);
-    outputs.at(i) = output_data;
+    // 行优先的顺序和存储顺序一致时输出直接共享输入的内存
+    outputs.at(i) = Tensor<float>::View(input_data, shapes);
   }
   return InferStatus::kInferSuccess;
 }
 
+bool ViewLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                 std::vector<int32_t> &output_shape) const {
+  if (input_shapes.empty() || input_shapes.front().empty() || shapes_.empty()) {
+    return false;
+  }
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  int32_t total_size = 1;
+  for (uint32_t i = 1; i < input_shape.size(); ++i) {
+    total_size *= input_shape.at(i);
+  }
+
+  // 批次维度和输入相同，最后一维是-1时由剩余的元素数量确定
+  output_shape = {input_shape.front()};
+  int32_t current_size = 1;
+  for (uint32_t i = 1; i < shapes_.size(); ++i) {
+    if (shapes_.at(i) == -1) {
+      output_shape.push_back(-1);
+    } else {
+      current_size *= shapes_.at(i);
+      output_shape.push_back(shapes_.at(i));
+    }
+  }
+  if (output_shape.back() == -1) {
+    if (current_size <= 0 || total_size % current_size != 0) {
+      return false;
+    }
+    output_shape.back() = total_size / current_size;
+    current_size = total_size;
+  }
+  return current_size == total_size;
+}
+
+bool ViewLayer::ShareInputMemory(const std::vector<std::vector<int32_t>> &input_shapes) const {
+  std::vector<int32_t> output_shape;
+  if (!this->InferOutputShape(input_shapes, output_shape) || output_shape.size() < 2 || output_shape.size() > 4) {
+    return false;
+  }
+  // 输入张量的行列和计算图规划张量时的布局相同，二维的操作数是一列
+  const std::vector<int32_t> &input_shape = input_shapes.front();
+  uint32_t rows = 0;
+  uint32_t cols = 1;
+  if (input_shape.size() == 4) {
+    rows = input_shape.at(2);
+    cols = input_shape.at(3);
+  } else if (input_shape.size() == 3) {
+    rows = input_shape.at(1);
+    cols = input_shape.at(2);
+  } else if (input_shape.size() == 2) {
+    rows = input_shape.at(1);
+  } else {
+    return false;
+  }
+  const std::vector<uint32_t> shapes(output_shape.begin() + 1, output_shape.end());
+  return Tensor<float>::ViewSharesMemory(rows, cols, shapes);
+}
+
 ParseParameterAttrStatus ViewLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                                 std::shared_ptr<Layer> &view_layer) {
 
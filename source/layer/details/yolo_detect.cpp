@@ -3,6 +3,12 @@
 //
 #include "yolo_detect.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
+#include "runtime/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 namespace kuiper_infer {
 
 YoloDetectLayer::YoloDetectLayer(int32_t stages,
@@ -16,6 +22,102 @@ YoloDetectLayer::YoloDetectLayer(int32_t stages,
 
 }
 
+/**
+ * 导出的网格只对应导出时的特征图大小，输入分辨率变化时按照相同的偏移量和锚框重新生成网格
+ * @param grid 导出时的网格，每行是一个锚框在一个位置上的x和y坐标
+ * @param anchor_grid 导出时的锚框网格，同一个锚框在所有位置上的宽高相同
+ * @param anchor_num 锚框的数量
+ * @param rows 特征图的高度
+ * @param cols 特征图的宽度
+ * @param new_grid 重新生成的网格
+ * @param new_anchor_grid 重新生成的锚框网格
+ */
+static void MakeGrid(const arma::fmat &grid, const arma::fmat &anchor_grid, uint32_t anchor_num, uint32_t rows,
+                     uint32_t cols, arma::fmat &new_grid, arma::fmat &new_anchor_grid) {
+  CHECK(grid.n_rows % anchor_num == 0 && grid.n_rows == anchor_grid.n_rows);
+  const uint32_t origin_positions = grid.n_rows / anchor_num;
+  const uint32_t positions = rows * cols;
+  const float offset_x = grid.at(0, 0);
+  const float offset_y = grid.at(0, 1);
+  new_grid.set_size(anchor_num * positions, 2);
+  new_anchor_grid.set_size(anchor_num * positions, 2);
+  for (uint32_t a = 0; a < anchor_num; ++a) {
+    const float anchor_w = anchor_grid.at(a * origin_positions, 0);
+    const float anchor_h = anchor_grid.at(a * origin_positions, 1);
+    for (uint32_t p = 0; p < positions; ++p) {
+      const uint32_t index = a * positions + p;
+      new_grid.at(index, 0) = float(p % cols) + offset_x;
+      new_grid.at(index, 1) = float(p / cols) + offset_y;
+      new_anchor_grid.at(index, 0) = anchor_w;
+      new_anchor_grid.at(index, 1) = anchor_h;
+    }
+  }
+}
+
+/// 后处理中的候选框
+struct YoloCandidate {
+  float x1 = 0.f;
+  float y1 = 0.f;
+  float x2 = 0.f;
+  float y2 = 0.f;
+  float score = 0.f;
+  int32_t class_id = -1;
+};
+
+/**
+ * 不区分类别的非极大值抑制，候选框按照得分从高到低依次保留，和保留的框交并比超过阈值的框被抑制
+ * 坐标按列存放，保留一个框之后和剩余所有框的比较没有分支，编译器可以向量化
+ * @param candidates 候选框
+ * @param iou_thresh 交并比的阈值
+ * @param max_detections 最多保留的框数量
+ * @return 按照得分从高到低排列的保留框
+ */
+static std::vector<YoloCandidate> NonMaxSuppression(const std::vector<YoloCandidate> &candidates, float iou_thresh,
+                                                    uint32_t max_detections) {
+  const uint32_t candidate_num = candidates.size();
+  std::vector<uint32_t> order(candidate_num);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+    return candidates.at(lhs).score > candidates.at(rhs).score;
+  });
+
+  std::vector<float> x1(candidate_num);
+  std::vector<float> y1(candidate_num);
+  std::vector<float> x2(candidate_num);
+  std::vector<float> y2(candidate_num);
+  std::vector<float> areas(candidate_num);
+  for (uint32_t i = 0; i < candidate_num; ++i) {
+    const YoloCandidate &candidate = candidates.at(order.at(i));
+    x1.at(i) = candidate.x1;
+    y1.at(i) = candidate.y1;
+    x2.at(i) = candidate.x2;
+    y2.at(i) = candidate.y2;
+    areas.at(i) = (candidate.x2 - candidate.x1) * (candidate.y2 - candidate.y1);
+  }
+
+  std::vector<YoloCandidate> detections;
+  std::vector<uint8_t> suppressed(candidate_num, 0);
+  for (uint32_t i = 0; i < candidate_num && detections.size() < max_detections; ++i) {
+    if (suppressed.at(i)) {
+      continue;
+    }
+    detections.push_back(candidates.at(order.at(i)));
+    const float box_x1 = x1[i];
+    const float box_y1 = y1[i];
+    const float box_x2 = x2[i];
+    const float box_y2 = y2[i];
+    const float box_area = areas[i];
+    for (uint32_t j = i + 1; j < candidate_num; ++j) {
+      const float inter_w = std::max(0.f, std::min(box_x2, x2[j]) - std::max(box_x1, x1[j]));
+      const float inter_h = std::max(0.f, std::min(box_y2, y2[j]) - std::max(box_y1, y1[j]));
+      const float inter = inter_w * inter_h;
+      // inter / union > iou_thresh，乘到右边避免除法
+      suppressed[j] |= uint8_t(inter > iou_thresh * (box_area + areas[j] - inter));
+    }
+  }
+  return detections;
+}
+
 InferStatus YoloDetectLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                                      std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
   if (inputs.empty()) {
@@ -33,70 +135,316 @@ InferStatus YoloDetectLayer::Forward(const std::vector<std::shared_ptr<Tensor<fl
     return InferStatus::kInferFailedYoloStageNumberError;
   }
 
-  CHECK(!this->conv_layers_.empty() && this->conv_layers_.size() == stages);
+  KUIPER_FORWARD_CHECK(!this->conv_layers_.empty() && this->conv_layers_.size() == stages);
   std::vector<std::vector<std::shared_ptr<Tensor<float>>>> batches(stages);
   for (uint32_t i = 0; i < input_size; ++i) {
     const uint32_t index = i / batch_size;
     batches.at(index).push_back(inputs.at(i));
   }
 
-  uint32_t concat_rows = 0;
-  std::vector<std::shared_ptr<Tensor<float>>> zs(stages);
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> stage_outputs;
+  std::vector<std::shared_ptr<const ResizedGrid>> resized_grids;
+  ForwardStages(batches, stage_outputs, resized_grids);
+  if (post_process_.enabled) {
+    ForwardDetections(stage_outputs, resized_grids, outputs);
+    return InferStatus::kInferSuccess;
+  }
 
-#pragma omp parallel for num_threads(stages) reduction(+:concat_rows)
+  // 每个阶段在输出中的起始行，阶段内按照锚框和行优先的位置依次排列
+  std::vector<uint32_t> stage_row_offsets(stages + 1, 0);
   for (uint32_t stage = 0; stage < stages; ++stage) {
-    const std::vector<std::shared_ptr<Tensor<float>>> &stage_input = batches.at(stage);
-    CHECK(stage_input.size() == batch_size);
+    const std::shared_ptr<Tensor<float>> &stage_output = stage_outputs.at(stage).front();
+    stage_row_offsets.at(stage + 1) =
+        stage_row_offsets.at(stage) + stages * stage_output->rows() * stage_output->cols();
+  }
+  const uint32_t concat_rows = stage_row_offsets.back();
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    auto &output = outputs.at(b);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(1, concat_rows, classes_info);
+    }
+    KUIPER_FORWARD_CHECK(output->rows() == concat_rows && output->cols() == classes_info)
+            << "The output size of yolo detect layer is error";
+  }
 
-    std::vector<std::shared_ptr<Tensor<float>>> stage_output(batch_size);
+  // 每个任务解码一张图片中一个阶段的一个锚框，卷积结果的每个通道直接写到输出中对应的一段列
+  ThreadPool::Current().ParallelFor(0, batch_size * stages * stages, [&](uint32_t task) {
+    const uint32_t b = task / (stages * stages);
+    const uint32_t stage = task / stages % stages;
+    const uint32_t a = task % stages;
+    const std::shared_ptr<Tensor<float>> &input = stage_outputs.at(stage).at(b);
+    KUIPER_FORWARD_CHECK(input->channels() == stages * classes_info);
+    const uint32_t rows = input->rows();
+    const uint32_t cols = input->cols();
+    const uint32_t positions = rows * cols;
+    const ResizedGrid *resized_grid = resized_grids.at(stage).get();
+    const arma::fmat &grid = resized_grid != nullptr ? resized_grid->grid : grids_.at(stage);
+    const arma::fmat &anchor_grid = resized_grid != nullptr ? resized_grid->anchor_grid : anchor_grids_.at(stage);
+    const float stride = strides_.at(stage);
+    const uint32_t row_offset = stage_row_offsets.at(stage) + a * positions;
+
+    arma::fmat &output = outputs.at(b)->at(0);
+    for (uint32_t k = 0; k < classes_info; ++k) {
+      const float *channel_ptr = input->at(a * classes_info + k).memptr();
+      float *output_ptr = output.colptr(k) + row_offset;
+      for (uint32_t c = 0; c < cols; ++c) {
+        for (uint32_t r = 0; r < rows; ++r) {
+          output_ptr[r * cols + c] = channel_ptr[c * rows + r];
+        }
+      }
+      ApplyActivation(ActivationType::kActivationSigmoid, output_ptr, positions);
+      if (k < 2) {
+        // 中心点坐标 (sigmoid * 2 + grid) * stride
+        const float *grid_ptr = grid.colptr(k) + a * positions;
+        for (uint32_t p = 0; p < positions; ++p) {
+          output_ptr[p] = (output_ptr[p] * 2 + grid_ptr[p]) * stride;
+        }
+      } else if (k < 4) {
+        // 宽高 (sigmoid * 2)^2 * anchor
+        const float *anchor_ptr = anchor_grid.colptr(k - 2) + a * positions;
+        for (uint32_t p = 0; p < positions; ++p) {
+          const float value = output_ptr[p] * 2;
+          output_ptr[p] = value * value * anchor_ptr[p];
+        }
+      }
+    }
+  });
+  return InferStatus::kInferSuccess;
+}
+
+std::shared_ptr<const YoloDetectLayer::ResizedGrid> YoloDetectLayer::StageGrid(uint32_t stage, uint32_t rows,
+                                                                              uint32_t cols) {
+  const uint32_t stages = stages_;
+  if (grids_.at(stage).n_rows == stages * rows * cols) {
+    return nullptr;
+  }
+  const auto find_grid = [this, stage, rows, cols](uint32_t grid_num) -> std::shared_ptr<const ResizedGrid> {
+    for (uint32_t i = 0; i < grid_num; ++i) {
+      const ResizedGrid &resized_grid = *resized_grids_.at(i);
+      if (resized_grid.stage == stage && resized_grid.rows == rows && resized_grid.cols == cols) {
+        return resized_grids_.at(i);
+      }
+    }
+    return nullptr;
+  };
+  // 已经发布的网格不会再修改，规划过的分辨率在推理时不需要加锁
+  std::shared_ptr<const ResizedGrid> resized_grid = find_grid(resized_grid_num_.load(std::memory_order_acquire));
+  if (resized_grid != nullptr) {
+    return resized_grid;
+  }
+
+  std::lock_guard<std::mutex> lock(grid_mutex_);
+  const uint32_t grid_num = resized_grid_num_.load(std::memory_order_relaxed);
+  resized_grid = find_grid(grid_num);
+  if (resized_grid != nullptr) {
+    return resized_grid;
+  }
+  std::shared_ptr<ResizedGrid> new_grid = std::make_shared<ResizedGrid>();
+  new_grid->stage = stage;
+  new_grid->rows = rows;
+  new_grid->cols = cols;
+  MakeGrid(grids_.at(stage), anchor_grids_.at(stage), stages, rows, cols, new_grid->grid, new_grid->anchor_grid);
+  // 缓存满了之后新的分辨率每次重新生成，不再占用更多的内存
+  if (grid_num < kMaxResizedGrids) {
+    resized_grids_.at(grid_num) = new_grid;
+    resized_grid_num_.store(grid_num + 1, std::memory_order_release);
+  }
+  return new_grid;
+}
+
+void YoloDetectLayer::PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes) {
+  for (uint32_t i = 0; i < input_shapes.size() && i < conv_layers_.size(); ++i) {
+    std::vector<int32_t> conv_output_shape;
+    if (conv_layers_.at(i)->InferOutputShape({input_shapes.at(i)}, conv_output_shape)
+        && conv_output_shape.size() == 4) {
+      StageGrid(i, uint32_t(conv_output_shape.at(2)), uint32_t(conv_output_shape.at(3)));
+    }
+  }
+}
+
+void YoloDetectLayer::ForwardStages(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &batches,
+                                    std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &stage_outputs,
+                                    std::vector<std::shared_ptr<const ResizedGrid>> &resized_grids) {
+  const uint32_t stages = stages_;
+  stage_outputs.assign(stages, {});
+  resized_grids.assign(stages, nullptr);
+  // 卷积内部已经在线程池中并行，各个阶段依次计算，避免嵌套的并行任务
+  for (uint32_t stage = 0; stage < stages; ++stage) {
+    const std::vector<std::shared_ptr<Tensor<float>>> &stage_input = batches.at(stage);
+    std::vector<std::shared_ptr<Tensor<float>>> &stage_output = stage_outputs.at(stage);
+    stage_output.resize(stage_input.size());
     const auto status = this->conv_layers_.at(stage)->Forward(stage_input, stage_output);
     CHECK(status == InferStatus::kInferSuccess);
+    KUIPER_FORWARD_CHECK(stage_output.size() == stage_input.size());
 
-    CHECK(stage_output.size() == batch_size);
-    std::shared_ptr<Tensor<float>> x_stages_tensor;
-    for (uint32_t b = 0; b < batch_size; ++b) {
-      std::shared_ptr<Tensor<float>> input = stage_output.at(b);
-      const uint32_t nx = input->rows();
-      const uint32_t ny = input->cols();
-      if (x_stages_tensor == nullptr || x_stages_tensor->empty()) {
-        x_stages_tensor = std::make_shared<Tensor<float>>(batch_size, stages * nx * ny, uint32_t(classes_info));
-      }
+    resized_grids.at(stage) = StageGrid(stage, stage_output.front()->rows(), stage_output.front()->cols());
+  }
+}
 
-      input->ReRawView({stages, uint32_t(classes_info), ny * nx});
-      input->Transform([](const float f) {
-        return 1 / (1 + std::exp(-f));
-      });
+void YoloDetectLayer::ForwardDetections(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &stage_outputs,
+                                        const std::vector<std::shared_ptr<const ResizedGrid>> &resized_grids,
+                                        std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  const uint32_t stages = stages_;
+  const uint32_t classes_info = num_classes_ + 5;
+  const uint32_t batch_size = outputs.size();
 
-      arma::fmat &x_stages = x_stages_tensor->at(b);
-      for (uint32_t s = 0; s < stages; ++s) {
-        x_stages.submat(ny * nx * s, 0, ny * nx * (s + 1) - 1, classes_info - 1) = input->at(s).t();
+  // 得分是两个sigmoid的乘积，不会超过目标置信度，目标置信度的阈值换算到sigmoid之前直接比较卷积的结果
+  const float conf_thresh = post_process_.conf_thresh;
+  float obj_logit_thresh = -std::numeric_limits<float>::infinity();
+  if (conf_thresh >= 1.f) {
+    obj_logit_thresh = std::numeric_limits<float>::infinity();
+  } else if (conf_thresh > 0.f) {
+    obj_logit_thresh = std::log(conf_thresh / (1.f - conf_thresh));
+  }
+  auto sigmoid = [](float x) { return 1.f / (1.f + std::exp(-x)); };
+
+  ThreadPool::Current().ParallelFor(0, batch_size, [&](uint32_t b) {
+    std::vector<YoloCandidate> candidates;
+    for (uint32_t stage = 0; stage < stages; ++stage) {
+      const std::shared_ptr<Tensor<float>> &input = stage_outputs.at(stage).at(b);
+      KUIPER_FORWARD_CHECK(input->channels() == stages * classes_info);
+      const uint32_t rows = input->rows();
+      const uint32_t cols = input->cols();
+      const uint32_t positions = rows * cols;
+      const ResizedGrid *resized_grid = resized_grids.at(stage).get();
+      const arma::fmat &grid = resized_grid != nullptr ? resized_grid->grid : grids_.at(stage);
+      const arma::fmat &anchor_grid = resized_grid != nullptr ? resized_grid->anchor_grid : anchor_grids_.at(stage);
+      const float stride = strides_.at(stage);
+
+      // 第a个锚框的第k项在第a * classes_info + k个通道，位置按照行优先的顺序对应网格中的行
+      for (uint32_t a = 0; a < stages; ++a) {
+        const uint32_t channel = a * classes_info;
+        const arma::fmat &objectness = input->at(channel + 4);
+        for (uint32_t c = 0; c < cols; ++c) {
+          for (uint32_t r = 0; r < rows; ++r) {
+            if (objectness.at(r, c) < obj_logit_thresh) {
+              continue;
+            }
+            uint32_t best_class = 0;
+            float best_logit = input->at(channel + 5).at(r, c);
+            for (uint32_t k = 1; k < uint32_t(num_classes_); ++k) {
+              const float logit = input->at(channel + 5 + k).at(r, c);
+              if (logit > best_logit) {
+                best_logit = logit;
+                best_class = k;
+              }
+            }
+            const float score = sigmoid(objectness.at(r, c)) * sigmoid(best_logit);
+            if (score < conf_thresh) {
+              continue;
+            }
+
+            const uint32_t grid_index = a * positions + r * cols + c;
+            const float center_x = (sigmoid(input->at(channel).at(r, c)) * 2 + grid.at(grid_index, 0)) * stride;
+            const float center_y = (sigmoid(input->at(channel + 1).at(r, c)) * 2 + grid.at(grid_index, 1)) * stride;
+            const float width = std::pow(sigmoid(input->at(channel + 2).at(r, c)) * 2, 2.f)
+                * anchor_grid.at(grid_index, 0);
+            const float height = std::pow(sigmoid(input->at(channel + 3).at(r, c)) * 2, 2.f)
+                * anchor_grid.at(grid_index, 1);
+
+            YoloCandidate candidate;
+            candidate.x1 = center_x - width / 2;
+            candidate.y1 = center_y - height / 2;
+            candidate.x2 = center_x + width / 2;
+            candidate.y2 = center_y + height / 2;
+            candidate.score = score;
+            candidate.class_id = int32_t(best_class);
+            candidates.push_back(candidate);
+          }
+        }
       }
+    }
 
-      const arma::fmat &xy = x_stages.submat(0, 0, x_stages.n_rows - 1, 1);
-      const arma::fmat &wh = x_stages.submat(0, 2, x_stages.n_rows - 1, 3);
+    const std::vector<YoloCandidate> &detections =
+        NonMaxSuppression(candidates, post_process_.iou_thresh, post_process_.max_detections);
+    auto &output = outputs.at(b);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(1, post_process_.max_detections, 6);
+    }
+    KUIPER_FORWARD_CHECK(output->rows() == post_process_.max_detections && output->cols() == 6)
+            << "The output size of yolo detect layer is error";
+    arma::fmat &detection_mat = output->at(0);
+    detection_mat.zeros();
+    detection_mat.col(5).fill(-1.f);
+    for (uint32_t i = 0; i < detections.size(); ++i) {
+      const YoloCandidate &detection = detections.at(i);
+      detection_mat.at(i, 0) = detection.x1;
+      detection_mat.at(i, 1) = detection.y1;
+      detection_mat.at(i, 2) = detection.x2;
+      detection_mat.at(i, 3) = detection.y2;
+      detection_mat.at(i, 4) = detection.score;
+      detection_mat.at(i, 5) = float(detection.class_id);
+    }
+  });
+}
 
-      x_stages.submat(0, 0, x_stages.n_rows - 1, 1) = (xy * 2 + grids_[stage]) * strides_[stage];
-      x_stages.submat(0, 2, x_stages.n_rows - 1, 3) = arma::pow((wh * 2), 2) % anchor_grids_[stage];
+bool YoloDetectLayer::InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                                       std::vector<int32_t> &output_shape) const {
+  // 每个阶段的输出按照锚框和位置展开后拼接在一起
+  if (input_shapes.size() != stages_) {
+    return false;
+  }
+  int32_t concat_rows = 0;
+  for (const auto &input_shape : input_shapes) {
+    if (input_shape.size() != 4) {
+      return false;
     }
-    concat_rows += x_stages_tensor->rows();
-    zs.at(stage) = x_stages_tensor;
+    concat_rows += stages_ * input_shape.at(2) * input_shape.at(3);
   }
-
-  uint32_t current_rows = 0;
-  arma::fcube f1(concat_rows, classes_info, batch_size);
-  for (const auto &z : zs) {
-    f1.subcube(current_rows, 0, 0, current_rows + z->rows() - 1, classes_info - 1, batch_size - 1) = z->data();
-    current_rows += z->rows();
+  if (post_process_.enabled) {
+    output_shape = {input_shapes.front().at(0), int32_t(post_process_.max_detections), 6};
+  } else {
+    output_shape = {input_shapes.front().at(0), concat_rows, num_classes_ + 5};
   }
+  return true;
+}
 
-  for (int i = 0; i < f1.n_slices; ++i) {
-    auto &output = outputs.at(i);
-    if (output == nullptr || output->empty()) {
-      output = std::make_shared<Tensor<float>>(1, concat_rows, classes_info);
+uint64_t YoloDetectLayer::Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                                const std::vector<int32_t> &output_shape) const {
+  // 每个检测头先做一次卷积，再对卷积的输出做sigmoid和坐标变换，开启后处理时输出形状不再包含全部的候选框
+  uint64_t flops = 0;
+  for (uint32_t i = 0; i < input_shapes.size() && i < conv_layers_.size(); ++i) {
+    std::vector<int32_t> conv_output_shape;
+    if (conv_layers_.at(i)->InferOutputShape({input_shapes.at(i)}, conv_output_shape)) {
+      flops += conv_layers_.at(i)->Flops({input_shapes.at(i)}, conv_output_shape);
+      flops += ShapeSize(conv_output_shape) * 4;
     }
-    output->at(0) = f1.slice(i);
   }
-  return InferStatus::kInferSuccess;
+  return flops;
+}
+
+size_t YoloDetectLayer::ParamBytes() const {
+  size_t param_bytes = 0;
+  for (const auto &conv_layer : conv_layers_) {
+    param_bytes += conv_layer->ParamBytes();
+  }
+  return param_bytes;
+}
+
+void YoloDetectLayer::PlaceParams(NumaMemoryPolicy policy, uint32_t node) {
+  for (const auto &conv_layer : conv_layers_) {
+    conv_layer->PlaceParams(policy, node);
+  }
+}
+
+void YoloDetectLayer::ShareParams(SharedParams &shared_params) {
+  for (const auto &conv_layer : conv_layers_) {
+    conv_layer->ShareParams(shared_params);
+  }
+}
+
+bool YoloDetectLayer::Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) {
+  // 每个阶段的输入由对应的卷积计算
+  bool tuned = false;
+  for (uint32_t i = 0; i < conv_layers_.size() && i < input_shapes.size(); ++i) {
+    tuned = conv_layers_.at(i)->Tune({input_shapes.at(i)}, cache) || tuned;
+  }
+  return tuned;
+}
+
+bool YoloDetectLayer::SetDetectionPostProcess(const DetectionPostProcess &post_process) {
+  this->post_process_ = post_process;
+  return true;
 }
 
 ParseParameterAttrStatus YoloDetectLayer::GetInstance(const std::shared_ptr<RuntimeOperator> &op,
@@ -147,8 +495,8 @@ ParseParameterAttrStatus YoloDetectLayer::GetInstance(const std::shared_ptr<Runt
     const int kernel_w = out_shapes.at(3);
     conv_layers.at(i) =
         std::make_shared<ConvolutionLayer>(out_channels, in_channels, kernel_h, kernel_w, 0, 0, 1, 1, 1);
-    const std::vector<float> &weights = conv_attr->get<float>();
-    conv_layers.at(i)->set_weights(weights);
+    std::vector<float> weight_buffer;
+    conv_layers.at(i)->set_weights(conv_attr->view<float>(weight_buffer), conv_attr->element_num());
 
     const std::string &bias_name = "m." + std::to_string(i) + ".bias";
     if (attrs.find(bias_name) == attrs.end()) {
@@ -156,8 +504,8 @@ ParseParameterAttrStatus YoloDetectLayer::GetInstance(const std::shared_ptr<Runt
       return ParseParameterAttrStatus::kAttrMissingBias;
     }
     const auto &bias_attr = attrs.at(bias_name);
-    const std::vector<float> &bias = bias_attr->get<float>();
-    conv_layers.at(i)->set_bias(bias);
+    std::vector<float> bias_buffer;
+    conv_layers.at(i)->set_bias(bias_attr->view<float>(bias_buffer), bias_attr->element_num());
   }
 
   std::vector<arma::fmat> anchor_grids;
@@ -170,14 +518,15 @@ ParseParameterAttrStatus YoloDetectLayer::GetInstance(const std::shared_ptr<Runt
     }
     const auto &anchor_grid = anchor_grid_attr->second;
     const auto &anchor_shapes = anchor_grid->shape;
-    const std::vector<float> &anchor_weight_data = anchor_grid->get<float>();
+    std::vector<float> anchor_buffer;
+    const float *anchor_weight_data = anchor_grid->view<float>(anchor_buffer);
     CHECK(!anchor_shapes.empty() && anchor_shapes.size() == 5 && anchor_shapes.front() == 1);
 
     const uint32_t anchor_rows = anchor_shapes.at(1) * anchor_shapes.at(2) * anchor_shapes.at(3);
     const uint32_t anchor_cols = anchor_shapes.at(4);
-    CHECK(anchor_weight_data.size() == anchor_cols * anchor_rows);
+    CHECK(anchor_grid->element_num() == anchor_cols * anchor_rows);
 
-    arma::fmat anchor_grid_matrix(anchor_weight_data.data(), anchor_cols, anchor_rows);
+    arma::fmat anchor_grid_matrix(anchor_weight_data, anchor_cols, anchor_rows);
     anchor_grids.emplace_back(anchor_grid_matrix.t());
   }
 
@@ -192,13 +541,14 @@ ParseParameterAttrStatus YoloDetectLayer::GetInstance(const std::shared_ptr<Runt
     }
     const auto &grid = grid_attr->second;
     const auto &shapes = grid->shape;
-    const std::vector<float> &weight_data = grid->get<float>();
+    std::vector<float> grid_buffer;
+    const float *weight_data = grid->view<float>(grid_buffer);
     CHECK(!shapes.empty() && shapes.size() == 5 && shapes.front() == 1);
     const uint32_t grid_rows = shapes.at(1) * shapes.at(2) * shapes.at(3);
     const uint32_t grid_cols = shapes.at(4);
-    CHECK(weight_data.size() == grid_cols * grid_rows);
+    CHECK(grid->element_num() == grid_cols * grid_rows);
 
-    arma::fmat matrix(weight_data.data(), grid_cols, grid_rows);
+    arma::fmat matrix(weight_data, grid_cols, grid_rows);
     grids.emplace_back(matrix.t());
   }
   yolo_detect_layer =
@@ -4,6 +4,9 @@
 
 #ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_YOLO_DETECT_HPP_
 #define KUIPER_INFER_SOURCE_LAYER_DETAILS_YOLO_DETECT_HPP_
+#include <array>
+#include <atomic>
+#include <mutex>
 #include "layer/abstract/layer.hpp"
 #include "convolution.hpp"
 
@@ -20,15 +23,79 @@ class YoloDetectLayer : public Layer {
   InferStatus Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
                       std::vector<std::shared_ptr<Tensor<float>>> &outputs) override;
 
+  bool InferOutputShape(const std::vector<std::vector<int32_t>> &input_shapes,
+                        std::vector<int32_t> &output_shape) const override;
+
+  uint64_t Flops(const std::vector<std::vector<int32_t>> &input_shapes,
+                 const std::vector<int32_t> &output_shape) const override;
+
+  size_t ParamBytes() const override;
+
+  void PlaceParams(NumaMemoryPolicy policy, uint32_t node) override;
+
+  void ShareParams(SharedParams &shared_params) override;
+
+  bool Tune(const std::vector<std::vector<int32_t>> &input_shapes, TuningCache &cache) override;
+
+  /**
+   * 输入分辨率和导出时不同时按照每个阶段卷积输出的大小提前生成网格
+   */
+  void PreparePlan(const std::vector<std::vector<int32_t>> &input_shapes) override;
+
+  bool SetDetectionPostProcess(const DetectionPostProcess &post_process) override;
+
   static ParseParameterAttrStatus GetInstance(const std::shared_ptr<RuntimeOperator> &op,
                                               std::shared_ptr<Layer> &yolo_detect_layer);
  private:
+  /// 输入分辨率和导出时不同时一个阶段重新生成的网格
+  struct ResizedGrid {
+    uint32_t stage = 0; /// 阶段的编号
+    uint32_t rows = 0; /// 特征图的高度
+    uint32_t cols = 0; /// 特征图的宽度
+    arma::fmat grid; /// 每行是一个锚框在一个位置上的x和y坐标
+    arma::fmat anchor_grid; /// 每行是一个锚框在一个位置上的宽和高
+  };
+
+  /**
+   * 返回一个阶段在指定分辨率下的网格，命中缓存时不加锁，没有命中时加锁生成并在缓存未满时记录下来
+   * @param stage 阶段的编号，每个阶段有自己的步长和锚框
+   * @param rows 特征图的高度
+   * @param cols 特征图的宽度
+   * @return 重新生成的网格，分辨率和导出时相同时为空
+   */
+  std::shared_ptr<const ResizedGrid> StageGrid(uint32_t stage, uint32_t rows, uint32_t cols);
+
+  /**
+   * 计算每个阶段的卷积，输入分辨率和导出时不同的阶段使用重新生成的网格
+   * @param batches 每个阶段的输入
+   * @param stage_outputs 每个阶段卷积的输出
+   * @param resized_grids 重新生成的网格，分辨率没有变化的阶段为空
+   */
+  void ForwardStages(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &batches,
+                     std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &stage_outputs,
+                     std::vector<std::shared_ptr<const ResizedGrid>> &resized_grids);
+
+  /**
+   * 对每个阶段卷积后的结果直接做后处理，只对目标置信度超过阈值的位置计算sigmoid和类别，再做非极大值抑制
+   * @param stage_outputs 每个阶段卷积的输出
+   * @param resized_grids 重新生成的网格，为空时使用导出时的网格
+   * @param outputs 每张图片的检测框
+   */
+  void ForwardDetections(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &stage_outputs,
+                         const std::vector<std::shared_ptr<const ResizedGrid>> &resized_grids,
+                         std::vector<std::shared_ptr<Tensor<float>>> &outputs);
+
   int32_t stages_ = 0;
   int32_t num_classes_ = 0;
   std::vector<float> strides_;
   std::vector<arma::fmat> anchor_grids_;
   std::vector<arma::fmat> grids_;
   std::vector<std::shared_ptr<ConvolutionLayer>> conv_layers_;
+  DetectionPostProcess post_process_;
+  static constexpr uint32_t kMaxResizedGrids = 16; /// 最多缓存的重新生成的网格数量
+  std::mutex grid_mutex_; /// 只在添加网格时加锁，多个执行上下文可能同时规划或者执行Forward
+  std::array<std::shared_ptr<const ResizedGrid>, kMaxResizedGrids> resized_grids_; /// 按照阶段、高度和宽度缓存的网格
+  std::atomic<uint32_t> resized_grid_num_{0}; /// 已经发布的网格数量，之前的元素不会再修改
 };
 }
 #endif //KUIPER_INFER_SOURCE_LAYER_DETAILS_YOLO_DETECT_HPP_
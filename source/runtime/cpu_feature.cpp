@@ -0,0 +1,232 @@
+#include "runtime/cpu_feature.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <glog/logging.h>
+#include "../kernels/cpu_kernels.hpp"
+
+namespace kuiper_infer {
+// 除了基础级别，x86_64上每个级别的内核各自编译为一个目标，由CMake定义对应的宏
+#if defined(KUIPER_ISA_SSE42)
+namespace isa_sse42 {
+extern const CpuKernels kCpuKernels;
+}
+#endif
+#if defined(KUIPER_ISA_AVX2)
+namespace isa_avx2 {
+extern const CpuKernels kCpuKernels;
+}
+#endif
+#if defined(KUIPER_ISA_AVX512)
+namespace isa_avx512 {
+extern const CpuKernels kCpuKernels;
+}
+#endif
+
+/// SetCpuIsa选择的内核，为空时使用默认的级别
+static std::atomic<const CpuKernels *> current_kernels(nullptr);
+
+/**
+ * 返回某个级别的内核，基础级别优先，它可能用-march打开了更多的指令，其次是单独编译的级别
+ * @param isa 指令集级别
+ * @return 这个级别没有编译时返回空
+ */
+static const CpuKernels *FindCpuKernels(CpuIsa isa) {
+  if (isa_baseline::kCpuKernels.isa == isa) {
+    return &isa_baseline::kCpuKernels;
+  }
+  switch (isa) {
+#if defined(KUIPER_ISA_SSE42)
+    case CpuIsa::kSSE42: return &isa_sse42::kCpuKernels;
+#endif
+#if defined(KUIPER_ISA_AVX2)
+    case CpuIsa::kAVX2: return &isa_avx2::kCpuKernels;
+#endif
+#if defined(KUIPER_ISA_AVX512)
+    case CpuIsa::kAVX512: return &isa_avx512::kCpuKernels;
+#endif
+    default: return nullptr;
+  }
+}
+
+static const CpuKernels *SelectDefaultKernels() {
+  const char *name = std::getenv("KUIPER_CPU_ISA");
+  if (name != nullptr && *name != '\0') {
+    CpuIsa isa = CpuIsa::kScalar;
+    if (!ParseCpuIsa(name, isa)) {
+      LOG(WARNING) << "Unknown cpu isa in KUIPER_CPU_ISA: " << name;
+    } else if (!CpuIsaCompiled(isa) || !CpuIsaSupported(isa)) {
+      LOG(WARNING) << "The cpu isa " << CpuIsaName(isa) << " in KUIPER_CPU_ISA is not compiled or not supported";
+    } else {
+      return FindCpuKernels(isa);
+    }
+  }
+  // 基础级别是编译整个程序时使用的指令集，总是可以运行
+  const CpuKernels *selected = &isa_baseline::kCpuKernels;
+  for (CpuIsa isa : {CpuIsa::kSSE42, CpuIsa::kAVX2, CpuIsa::kAVX512}) {
+    const CpuKernels *kernels = FindCpuKernels(isa);
+    if (kernels != nullptr && int(isa) > int(selected->isa) && CpuIsaSupported(isa)) {
+      selected = kernels;
+    }
+  }
+  return selected;
+}
+
+static const CpuKernels *DefaultCpuKernels() {
+  static const CpuKernels *kernels = SelectDefaultKernels();
+  return kernels;
+}
+
+CpuIsa DetectCpuIsa() {
+#if defined(__x86_64__) || defined(__i386__)
+  for (CpuIsa isa : {CpuIsa::kAVX512, CpuIsa::kAVX2, CpuIsa::kSSE42}) {
+    if (CpuIsaSupported(isa)) {
+      return isa;
+    }
+  }
+  return CpuIsa::kScalar;
+#elif defined(__aarch64__)
+  return CpuIsa::kNEON;
+#else
+  return CpuIsa::kScalar;
+#endif
+}
+
+bool CpuIsaCompiled(CpuIsa isa) {
+  return FindCpuKernels(isa) != nullptr;
+}
+
+bool CpuIsaSupported(CpuIsa isa) {
+  if (isa == CpuIsa::kScalar) {
+    return true;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  // __builtin_cpu_supports同时检查了操作系统是否保存AVX和AVX-512的寄存器
+  __builtin_cpu_init();
+  const bool sse42 = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+  const bool avx2 = sse42 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+      __builtin_cpu_supports("f16c");
+  const bool avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+  switch (isa) {
+    case CpuIsa::kSSE42: return sse42;
+    case CpuIsa::kAVX2: return avx2;
+    case CpuIsa::kAVX512: return avx512;
+    default: return false;
+  }
+#elif defined(__aarch64__)
+  return isa == CpuIsa::kNEON;
+#else
+  return false;
+#endif
+}
+
+bool SetCpuIsa(CpuIsa isa) {
+  const CpuKernels *kernels = FindCpuKernels(isa);
+  if (kernels == nullptr) {
+    LOG(ERROR) << "The cpu isa " << CpuIsaName(isa) << " is not compiled";
+    return false;
+  }
+  if (!CpuIsaSupported(isa)) {
+    LOG(ERROR) << "The cpu isa " << CpuIsaName(isa) << " is not supported by this processor";
+    return false;
+  }
+  current_kernels = kernels;
+  return true;
+}
+
+CpuIsa CurrentCpuIsa() {
+  return CurrentCpuKernels().isa;
+}
+
+const char *CpuIsaName(CpuIsa isa) {
+  switch (isa) {
+    case CpuIsa::kScalar: return "scalar";
+    case CpuIsa::kSSE42: return "sse4.2";
+    case CpuIsa::kAVX2: return "avx2";
+    case CpuIsa::kAVX512: return "avx512";
+    case CpuIsa::kNEON: return "neon";
+  }
+  return "unknown";
+}
+
+bool ParseCpuIsa(const std::string &name, CpuIsa &isa) {
+  for (CpuIsa candidate : {CpuIsa::kScalar, CpuIsa::kSSE42, CpuIsa::kAVX2, CpuIsa::kAVX512, CpuIsa::kNEON}) {
+    if (name == CpuIsaName(candidate)) {
+      isa = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string CpuModelName() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  // x86上是model name，ARM上没有型号名称，使用厂商和型号编号
+  std::string implementer;
+  std::string part;
+  while (std::getline(cpuinfo, line)) {
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, colon);
+    key.erase(key.find_last_not_of(" \t") + 1);
+    const size_t value_begin = line.find_first_not_of(" \t", colon + 1);
+    const std::string value = value_begin == std::string::npos ? "" : line.substr(value_begin);
+    if (key == "model name" && !value.empty()) {
+      return value;
+    } else if (key == "CPU implementer" && implementer.empty()) {
+      implementer = value;
+    } else if (key == "CPU part" && part.empty()) {
+      part = value;
+    }
+  }
+  if (!implementer.empty() || !part.empty()) {
+    return "implementer " + implementer + " part " + part;
+  }
+  return "unknown";
+}
+
+size_t CpuCacheBytes(uint32_t level) {
+  // 每个index目录描述一个缓存，一级缓存分为数据和指令两个，只统计数据缓存和统一缓存
+  for (uint32_t index = 0;; ++index) {
+    const std::string cache_path = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+    std::ifstream level_file(cache_path + "level");
+    if (!level_file.is_open()) {
+      break;
+    }
+    uint32_t cache_level = 0;
+    std::string cache_type;
+    std::string cache_size;
+    level_file >> cache_level;
+    std::ifstream(cache_path + "type") >> cache_type;
+    std::ifstream(cache_path + "size") >> cache_size;
+    if (cache_level != level || cache_type == "Instruction" || cache_size.empty()) {
+      continue;
+    }
+    // 大小的格式为32K或者1M这样的数字加单位
+    char *unit = nullptr;
+    size_t bytes = std::strtoull(cache_size.c_str(), &unit, 10);
+    if (unit != nullptr && (*unit == 'K' || *unit == 'k')) {
+      bytes *= 1024;
+    } else if (unit != nullptr && (*unit == 'M' || *unit == 'm')) {
+      bytes *= 1024 * 1024;
+    }
+    return bytes;
+  }
+  return 0;
+}
+
+const CpuKernels &CurrentCpuKernels() {
+  const CpuKernels *kernels = current_kernels.load(std::memory_order_acquire);
+  return kernels != nullptr ? *kernels : *DefaultCpuKernels();
+}
+
+const CpuKernels &CpuKernelsOf(CpuIsa isa) {
+  const CpuKernels *kernels = FindCpuKernels(isa);
+  CHECK(kernels != nullptr) << "The cpu isa " << CpuIsaName(isa) << " is not compiled";
+  return *kernels;
+}
+}
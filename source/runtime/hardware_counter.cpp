@@ -0,0 +1,147 @@
+#include "runtime/hardware_counter.hpp"
+#include <atomic>
+#include <tuple>
+#include <cerrno>
+#include <cstring>
+#include <glog/logging.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace kuiper_infer {
+
+/**
+ * 返回向量浮点指令默认的原始事件编码
+ * @return Intel处理器上是FP_ARITH_INST_RETIRED的打包指令，否则为0
+ */
+static uint64_t DefaultVectorEvent() {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_is("intel")) {
+    // 事件0xC7，umask 0xFC包含128/256/512位的打包单精度和双精度指令
+    return 0xFCC7;
+  }
+#endif
+  return 0;
+}
+
+static std::atomic<uint64_t> vector_event_config(DefaultVectorEvent());
+
+HardwareCounterValues HardwareCounterValues::operator-(const HardwareCounterValues &start) const {
+  HardwareCounterValues values;
+  values.cycles = cycles - start.cycles;
+  values.instructions = instructions - start.instructions;
+  values.llc_misses = llc_misses - start.llc_misses;
+  values.vector_instructions = vector_instructions - start.vector_instructions;
+  return values;
+}
+
+HardwareCounters &HardwareCounters::ThreadLocal() {
+  thread_local HardwareCounters hardware_counters;
+  return hardware_counters;
+}
+
+void HardwareCounters::set_vector_event(uint64_t config) {
+  vector_event_config = config;
+}
+
+#ifdef __linux__
+/**
+ * 为当前线程打开一个计数器
+ * @param type 事件的类型
+ * @param config 事件的编码
+ * @param group_fd 所属组的组长，为-1时新建一个组
+ * @return 计数器的文件描述符，失败时为-1
+ */
+static int OpenCounter(uint32_t type, uint64_t config, int group_fd) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = group_fd == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+#endif
+
+HardwareCounters::HardwareCounters() {
+#ifdef __linux__
+  group_fd_ = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (group_fd_ == -1) {
+    LOG(WARNING) << "Can not open the hardware counters, error: " << strerror(errno)
+                 << ", check /proc/sys/kernel/perf_event_paranoid";
+    return;
+  }
+  fds_.push_back(group_fd_);
+  events_.push_back(CounterEvent::kCycles);
+
+  // 部分事件在虚拟机或者某些处理器上不支持，打开失败时只是不统计该事件
+  const uint64_t vector_config = vector_event_config;
+  const std::vector<std::tuple<uint32_t, uint64_t, CounterEvent>> member_events = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, CounterEvent::kInstructions},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, CounterEvent::kLLCMisses},
+      {PERF_TYPE_RAW, vector_config, CounterEvent::kVectorInstructions},
+  };
+  for (const auto &member_event : member_events) {
+    if (std::get<2>(member_event) == CounterEvent::kVectorInstructions && vector_config == 0) {
+      continue;
+    }
+    const int fd = OpenCounter(std::get<0>(member_event), std::get<1>(member_event), group_fd_);
+    if (fd != -1) {
+      fds_.push_back(fd);
+      events_.push_back(std::get<2>(member_event));
+    }
+  }
+  ioctl(group_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(group_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+HardwareCounters::~HardwareCounters() {
+#ifdef __linux__
+  for (const int fd : fds_) {
+    close(fd);
+  }
+#endif
+}
+
+bool HardwareCounters::available() const {
+  return group_fd_ != -1;
+}
+
+bool HardwareCounters::Read(HardwareCounterValues &values) const {
+  if (group_fd_ == -1) {
+    return false;
+  }
+#ifdef __linux__
+  // PERF_FORMAT_GROUP的格式是计数器的数量，之后按照打开的顺序排列每个计数器的值
+  uint64_t buffer[8] = {0};
+  const size_t read_size = (fds_.size() + 1) * sizeof(uint64_t);
+  if (read(group_fd_, buffer, read_size) != ssize_t(read_size) || buffer[0] != fds_.size()) {
+    return false;
+  }
+  values = HardwareCounterValues();
+  for (uint32_t i = 0; i < events_.size(); ++i) {
+    const uint64_t value = buffer[i + 1];
+    switch (events_.at(i)) {
+      case CounterEvent::kCycles: values.cycles = value;
+        break;
+      case CounterEvent::kInstructions: values.instructions = value;
+        break;
+      case CounterEvent::kLLCMisses: values.llc_misses = value;
+        break;
+      case CounterEvent::kVectorInstructions: values.vector_instructions = value;
+        break;
+    }
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+}
@@ -0,0 +1,296 @@
+#include "runtime/inference_server.hpp"
+#include <utility>
+#include <string>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+
+InferenceServer::InferenceServer(std::shared_ptr<RuntimeGraph> graph, uint32_t max_batch_size,
+                                 uint32_t max_latency_us, uint32_t worker_num, uint32_t queue_capacity,
+                                 std::shared_ptr<RuntimeMetrics> metrics)
+    : max_batch_size_(max_batch_size), worker_num_(graph != nullptr && graph->replica_num() > 0 ? graph->replica_num()
+                                                                                                 : worker_num),
+      max_latency_(max_latency_us),
+      requests_(queue_capacity) {
+  CHECK(graph != nullptr) << "The graph of inference server is empty";
+  CHECK(max_batch_size_ > 0 && max_batch_size_ <= graph->batch_size())
+          << "The max batch size " << max_batch_size_ << " must be in (0, " << graph->batch_size() << "]";
+  CHECK(worker_num_ > 0) << "The worker number of inference server must be greater than zero";
+  // 指标在推理线程启动之前取得，之后不加锁直接更新
+  metrics_ = metrics != nullptr ? std::move(metrics) : graph->metrics();
+  if (metrics_ != nullptr) {
+    request_counter_ = &metrics_->Counter("kuiper_server_requests_total", "Number of completed inference requests");
+    batch_counter_ = &metrics_->Counter("kuiper_server_batches_total", "Number of executed inference batches");
+    queue_depth_ = &metrics_->Gauge("kuiper_server_queue_depth", "Number of requests waiting in the queue");
+    queue_latency_ = &metrics_->Histogram("kuiper_server_queue_duration_seconds",
+                                          "Time from request submission to the start of its batch");
+    request_latency_ = &metrics_->Histogram("kuiper_server_request_duration_seconds",
+                                            "Time from request submission to its completion");
+  }
+  version_ = CreateVersion(std::move(graph), 0);
+  for (uint32_t i = 0; i < worker_num_; ++i) {
+    workers_.emplace_back(&InferenceServer::WorkerLoop, this, i);
+  }
+}
+
+InferenceServer::~InferenceServer() {
+  Stop();
+}
+
+std::future<std::shared_ptr<Tensor<float>>> InferenceServer::Submit(const std::shared_ptr<Tensor<float>> &input) {
+  auto promise = std::make_shared<std::promise<std::shared_ptr<Tensor<float>>>>();
+  std::future<std::shared_ptr<Tensor<float>>> future = promise->get_future();
+  Submit(input, [promise](const std::shared_ptr<Tensor<float>> &output) {
+    promise->set_value(output);
+  });
+  return future;
+}
+
+bool InferenceServer::Submit(const std::shared_ptr<Tensor<float>> &input, InferenceCallback callback) {
+  CHECK(input != nullptr && !input->empty()) << "The input tensor of request is empty";
+  CHECK(callback != nullptr) << "The callback of request is empty";
+  // 先登记再检查是否停止：推理线程只在停止之后看到没有登记的请求时才退出，
+  // 登记时还没有停止的请求一定会被处理，已经停止时撤销登记并立即以空的输出完成
+  pending_num_ += 1;
+  if (stop_) {
+    pending_num_ -= 1;
+    LOG(ERROR) << "The inference server has been stopped, the request is rejected";
+    callback(nullptr);
+    return false;
+  }
+
+  InferenceRequest request;
+  request.input = input;
+  request.callback = std::move(callback);
+  request.submit_time = std::chrono::steady_clock::now();
+  // 推理线程取走请求之后才减少队列深度，先增加再放入队列，深度不会短暂地变为负数
+  if (queue_depth_ != nullptr) {
+    queue_depth_->Add(1);
+  }
+  // 登记一直保留到请求放入队列，队列满时推理线程仍然在取走请求，不会在请求放入之前退出
+  while (!requests_.Push(request)) {
+    std::this_thread::yield();
+  }
+
+  // 只有存在等待中的推理线程时才需要加锁唤醒
+  if (sleeping_num_ > 0) {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    sleep_cond_.notify_one();
+  }
+  return true;
+}
+
+std::shared_ptr<InferenceServer::GraphVersion> InferenceServer::CreateVersion(std::shared_ptr<RuntimeGraph> graph,
+                                                                             uint64_t version) const {
+  std::shared_ptr<GraphVersion> graph_version = std::make_shared<GraphVersion>();
+  graph_version->graph = std::move(graph);
+  graph_version->version = version;
+  // 每个副本绑定到自己的CPU上，推理线程执行Forward时进入副本的线程池，只在这些CPU上运行
+  if (graph_version->graph->replica_num() > 0) {
+    graph_version->contexts = graph_version->graph->CreateReplicas();
+    return graph_version;
+  }
+  for (uint32_t i = 0; i < worker_num_; ++i) {
+    graph_version->contexts.push_back(graph_version->graph->CreateContext());
+  }
+  return graph_version;
+}
+
+std::shared_ptr<InferenceServer::GraphVersion> InferenceServer::CurrentVersion() const {
+  return std::atomic_load(&version_);
+}
+
+std::future<bool> InferenceServer::SwapGraph(std::shared_ptr<RuntimeGraph> graph, const std::string &input_name,
+                                             const std::string &output_name,
+                                             const std::shared_ptr<Tensor<float>> &warmup_input) {
+  CHECK(graph != nullptr) << "The new graph of inference server is empty";
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> future = promise->get_future();
+  std::lock_guard<std::mutex> lock(swap_mutex_);
+  // Stop在同一把锁下设置swap_stop_，之后不会再有替换放入队列，后台线程退出之前一定执行完所有已经放入的替换
+  if (swap_stop_) {
+    LOG(ERROR) << "The inference server has been stopped, the new graph is not swapped";
+    promise->set_value(false);
+    return future;
+  }
+  swap_tasks_.push_back([this, promise, graph, input_name, output_name, warmup_input]() {
+    graph->Build(input_name, output_name);
+    if (graph->batch_size() < max_batch_size_) {
+      LOG(ERROR) << "The batch size " << graph->batch_size() << " of the new graph is less than the max batch size "
+                 << max_batch_size_ << " of inference server";
+      promise->set_value(false);
+      return;
+    }
+    if (graph->replica_num() > 0 && graph->replica_num() != worker_num_) {
+      LOG(ERROR) << "The replica number " << graph->replica_num() << " of the new graph is not equal to the worker "
+                 << "number " << worker_num_ << " of inference server";
+      promise->set_value(false);
+      return;
+    }
+    std::shared_ptr<GraphVersion> new_version = CreateVersion(graph, CurrentVersion()->version + 1);
+    // 每个执行上下文按照满批次规划一次内存，替换之后的第一个批次不需要再规划
+    if (warmup_input != nullptr) {
+      const std::vector<std::shared_ptr<Tensor<float>>> warmup_inputs(max_batch_size_, warmup_input);
+      for (const auto &context : new_version->contexts) {
+        graph->Forward(context, warmup_inputs, false);
+      }
+    }
+    // 正在执行的批次仍然持有旧版本，这里只放弃自己的引用，最后一个批次完成时旧版本随之释放
+    std::atomic_exchange(&version_, new_version);
+    LOG(INFO) << "Inference server swapped to the graph version " << new_version->version;
+    promise->set_value(true);
+  });
+  if (!swap_thread_.joinable()) {
+    swap_thread_ = std::thread(&InferenceServer::SwapLoop, this);
+  }
+  swap_cond_.notify_one();
+  return future;
+}
+
+void InferenceServer::SwapLoop() {
+  while (true) {
+    std::function<void()> swap_task;
+    {
+      std::unique_lock<std::mutex> lock(swap_mutex_);
+      swap_cond_.wait(lock, [this]() { return swap_stop_ || !swap_tasks_.empty(); });
+      if (swap_tasks_.empty()) {
+        return;
+      }
+      swap_task = std::move(swap_tasks_.front());
+      swap_tasks_.pop_front();
+    }
+    swap_task();
+  }
+}
+
+std::shared_ptr<RuntimeGraph> InferenceServer::graph() const {
+  return CurrentVersion()->graph;
+}
+
+uint64_t InferenceServer::graph_version() const {
+  return CurrentVersion()->version;
+}
+
+void InferenceServer::Stop() {
+  // 先等待后台的替换完成，停止之前提交的请求可能使用替换之后的计算图
+  {
+    std::lock_guard<std::mutex> lock(swap_mutex_);
+    swap_stop_ = true;
+  }
+  swap_cond_.notify_all();
+  if (swap_thread_.joinable()) {
+    swap_thread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cond_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers_.clear();
+}
+
+uint64_t InferenceServer::request_num() const {
+  return request_num_;
+}
+
+uint64_t InferenceServer::batch_num() const {
+  return batch_num_;
+}
+
+bool InferenceServer::PopRequest(InferenceRequest &request, std::chrono::steady_clock::time_point deadline) {
+  while (true) {
+    if (requests_.Pop(request)) {
+      pending_num_ -= 1;
+      if (queue_depth_ != nullptr) {
+        queue_depth_->Add(-1);
+      }
+      return true;
+    }
+    // 停止之后仍然处理完队列中剩余的请求
+    if (stop_ && pending_num_ == 0) {
+      return false;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleeping_num_ += 1;
+    const auto &ready = [this]() { return stop_ || pending_num_ > 0; };
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+      sleep_cond_.wait(lock, ready);
+    } else {
+      sleep_cond_.wait_until(lock, deadline, ready);
+    }
+    sleeping_num_ -= 1;
+  }
+}
+
+void InferenceServer::WorkerLoop(uint32_t worker_index) {
+  // 和当前批次形状不同的请求留作下一个批次的第一个请求
+  InferenceRequest carried_request;
+  bool has_carried = false;
+  while (true) {
+    std::vector<InferenceRequest> batch;
+    InferenceRequest request;
+    if (has_carried) {
+      request = std::move(carried_request);
+      has_carried = false;
+    } else if (!PopRequest(request, std::chrono::steady_clock::time_point::max())) {
+      break;
+    }
+    batch.push_back(std::move(request));
+
+    // 从第一个请求提交开始计算等待时间，批次满了或者超时之后开始推理
+    const auto deadline = batch.front().submit_time + max_latency_;
+    while (batch.size() < max_batch_size_ && PopRequest(request, deadline)) {
+      if (request.input->shapes() != batch.front().input->shapes()) {
+        carried_request = std::move(request);
+        has_carried = true;
+        break;
+      }
+      batch.push_back(std::move(request));
+    }
+
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    inputs.reserve(batch.size());
+    for (const auto &batch_request : batch) {
+      inputs.push_back(batch_request.input);
+    }
+    // 整个批次使用同一个版本，批次结束之前替换的新版本从下一个批次开始使用
+    const auto &batch_start = std::chrono::steady_clock::now();
+    if (queue_latency_ != nullptr) {
+      for (const auto &batch_request : batch) {
+        queue_latency_->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            batch_start - batch_request.submit_time).count());
+      }
+    }
+    const std::shared_ptr<GraphVersion> version = CurrentVersion();
+    const std::shared_ptr<ExecutionContext> &context = version->contexts.at(worker_index);
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = version->graph->Forward(context, inputs, false);
+    CHECK(outputs.size() == batch.size()) << "The output size of graph is not equal to the batch size";
+    batch_num_ += 1;
+    request_num_ += batch.size();
+    if (metrics_ != nullptr) {
+      batch_counter_->Add();
+      request_counter_->Add(batch.size());
+    }
+
+    // 输出张量在执行上下文的内存中，下一个批次会覆盖，所以拷贝一份交给请求
+    for (uint32_t i = 0; i < batch.size(); ++i) {
+      if (request_latency_ != nullptr) {
+        request_latency_->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - batch.at(i).submit_time).count());
+      }
+      batch.at(i).callback(std::make_shared<Tensor<float>>(*outputs.at(i)));
+    }
+  }
+}
+}
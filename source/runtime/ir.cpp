@@ -18,10 +18,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <stack>
+#include <unordered_map>
 
 #if BUILD_PNNX
 #include <torch/script.h>
@@ -45,6 +48,7 @@ static bool type_is_integer(int type)
     if (type == 10) return false;
     if (type == 11) return false;
     if (type == 12) return false;
+    if (type == 13) return false;
     return false;
 }
 
@@ -62,6 +66,7 @@ static const char* type_to_string(int type)
     if (type == 10) return "cp64";
     if (type == 11) return "cp128";
     if (type == 12) return "cp32";
+    if (type == 13) return "bf16";
     return "null";
 }
 
@@ -79,6 +84,7 @@ static const char* type_to_numpy_string(int type)
     if (type == 10) return "csingle";
     if (type == 11) return "cdouble";
     if (type == 12) return "chalf";
+    if (type == 13) return "bfloat16";
     return "null";
 }
 
@@ -96,6 +102,7 @@ static const char* type_to_dtype_string(int type)
     if (type == 10) return "torch.complex64";
     if (type == 11) return "torch.complex128";
     if (type == 12) return "torch.complex32";
+    if (type == 13) return "torch.bfloat16";
     return "null";
 }
 
@@ -113,6 +120,7 @@ static size_t type_to_elemsize(int type)
     if (type == 10) return 8;
     if (type == 11) return 16;
     if (type == 12) return 4;
+    if (type == 13) return 2;
     return 0; // null
 }
 
@@ -130,6 +138,7 @@ static int string_to_type(const char* s)
     if (strcmp(s, "cp64") == 0) return 10;
     if (strcmp(s, "cp128") == 0) return 11;
     if (strcmp(s, "cp32") == 0) return 12;
+    if (strcmp(s, "bf16") == 0) return 13;
     return 0; // null
 }
 
@@ -151,6 +160,7 @@ int get_at_tensor_type(const at::ScalarType& st)
     if (st == c10::ScalarType::ComplexFloat) return 10;
     if (st == c10::ScalarType::ComplexDouble) return 11;
     if (st == c10::ScalarType::ComplexHalf) return 12;
+    if (st == c10::ScalarType::BFloat16) return 13;
     return 0; // unknown type
 }
 
@@ -410,6 +420,16 @@ Attribute::Attribute(const std::initializer_list<int>& _shape, const std::vector
     }
 }
 
+const char* Attribute::data_ptr() const
+{
+    return mapped_data ? mapped_data.get() : data.data();
+}
+
+size_t Attribute::data_size() const
+{
+    return mapped_data ? mapped_size : data.size();
+}
+
 bool operator==(const Attribute& lhs, const Attribute& rhs)
 {
     if (lhs.type != rhs.type)
@@ -421,7 +441,10 @@ bool operator==(const Attribute& lhs, const Attribute& rhs)
     if (lhs.shape != rhs.shape)
         return false;
 
-    if (lhs.data != rhs.data)
+    if (lhs.data_size() != rhs.data_size())
+        return false;
+
+    if (memcmp(lhs.data_ptr(), rhs.data_ptr(), lhs.data_size()) != 0)
         return false;
 
     return true;
@@ -456,9 +479,9 @@ Attribute operator+(const Attribute& a, const Attribute& b)
     c.shape = a.shape;
     c.shape[0] += b.shape[0]; // concat the first dim
 
-    c.data.resize(a.data.size() + b.data.size());
-    memcpy(c.data.data(), a.data.data(), a.data.size());
-    memcpy(c.data.data() + a.data.size(), b.data.data(), b.data.size());
+    c.data.resize(a.data_size() + b.data_size());
+    memcpy(c.data.data(), a.data_ptr(), a.data_size());
+    memcpy(c.data.data() + a.data_size(), b.data_ptr(), b.data_size());
 
     return c;
 }
@@ -581,6 +604,34 @@ static void load_input_key(Operator* op, const std::string& key, const std::stri
     }
 }
 
+// parse the dims of a value like (1,3,?,?)f32, unknown dims become -1
+static void load_shape_list(const std::string& value, std::vector<int>& shape)
+{
+    shape.clear();
+
+    size_t close = value.find_last_of(')');
+    if (value.empty() || close == std::string::npos)
+        return;
+
+    const char* p = value.data() + 1;
+    const char* end = value.data() + close;
+    while (p < end)
+    {
+        const char* comma = std::find(p, end, ',');
+        if (*p == '?')
+        {
+            shape.push_back(-1);
+        }
+        else
+        {
+            int i = 0;
+            std::from_chars(p, comma, i);
+            shape.push_back(i);
+        }
+        p = comma + 1;
+    }
+}
+
 static void load_shape(Operator* op, const std::string& key, const std::string& value)
 {
     Operand* operand = 0;
@@ -616,25 +667,7 @@ static void load_shape(Operator* op, const std::string& key, const std::string&
     operand->type = string_to_type(typestr.c_str());
 
     // shape
-    std::string lc = value.substr(1, value.find_last_of(')') - 1);
-    std::istringstream lcss(lc);
-
-    operand->shape.clear();
-    while (!lcss.eof())
-    {
-        std::string elem;
-        std::getline(lcss, elem, ',');
-
-        if (elem == "?")
-        {
-            operand->shape.push_back(-1);
-        }
-        else
-        {
-            int i = std::stoi(elem);
-            operand->shape.push_back(i);
-        }
-    }
+    load_shape_list(value, operand->shape);
 }
 
 static void load_attribute(Operator* op, const std::string& key, const std::string& value, StoreZipReader& szr)
@@ -649,18 +682,7 @@ static void load_attribute(Operator* op, const std::string& key, const std::stri
         return;
 
     // shape
-    std::string lc = value.substr(1, value.find_last_of(')') - 1);
-    std::istringstream lcss(lc);
-
-    a.shape.clear();
-    while (!lcss.eof())
-    {
-        std::string elem;
-        std::getline(lcss, elem, ',');
-
-        int i = std::stoi(elem);
-        a.shape.push_back(i);
-    }
+    load_shape_list(value, a.shape);
 
     if (a.shape.empty())
         return;
@@ -689,17 +711,73 @@ static void load_attribute(Operator* op, const std::string& key, const std::stri
         fprintf(stderr, "file size not match expect %lu but got %lu\n", bytesize, filesize);
     }
 
+    // reference the stored file in the mapped archive directly when the size is as expected
+    if (filesize == bytesize)
+    {
+        a.mapped_data = szr.get_file_view(filename);
+        if (a.mapped_data)
+        {
+            a.mapped_size = bytesize;
+            return;
+        }
+    }
+
     a.data.resize(bytesize);
     szr.read_file(filename, (char*)a.data.data());
 }
 
+// take the next whitespace separated token in [p, end) and advance p past it
+static std::string_view next_token(const char*& p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+
+    const char* b = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+
+    return std::string_view(b, p - b);
+}
+
+static int token_to_int(std::string_view token)
+{
+    int i = 0;
+    std::from_chars(token.data(), token.data() + token.size(), i);
+    return i;
+}
+
+// take the next line in [p, end) without the trailing newline and advance p to the following line
+static std::pair<const char*, const char*> next_line(const char*& p, const char* end)
+{
+    const char* b = p;
+    const char* e = (const char*)memchr(p, '\n', end - p);
+    if (!e)
+        e = end;
+
+    p = e < end ? e + 1 : end;
+    return std::make_pair(b, e);
+}
+
 int Graph::load(const std::string& parampath, const std::string& binpath)
 {
-    std::ifstream is(parampath, std::ios::in | std::ios::binary);
-    if (!is.good())
+    // read the whole param file at once and tokenize it in place
+    std::string buffer;
     {
-        fprintf(stderr, "open failed\n");
-        return -1;
+        std::ifstream is(parampath, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!is.good())
+        {
+            fprintf(stderr, "open failed\n");
+            return -1;
+        }
+
+        buffer.resize((size_t)is.tellg());
+        is.seekg(0);
+        is.read(&buffer[0], buffer.size());
+        if (!is.good())
+        {
+            fprintf(stderr, "read failed\n");
+            return -1;
+        }
     }
 
     StoreZipReader szr;
@@ -709,71 +787,84 @@ int Graph::load(const std::string& parampath, const std::string& binpath)
         return -1;
     }
 
+    const char* p = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+
     int magic = 0;
     {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
-
-        iss >> magic;
+        auto line = next_line(p, end);
+        magic = token_to_int(next_token(line.first, line.second));
     }
+    (void)magic;
 
     int operator_count = 0;
     int operand_count = 0;
     {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
+        auto line = next_line(p, end);
+        operator_count = token_to_int(next_token(line.first, line.second));
+        operand_count = token_to_int(next_token(line.first, line.second));
+    }
 
-        iss >> operator_count >> operand_count;
+    // operands by name, the keys view the names owned by the operands
+    std::unordered_map<std::string_view, Operand*> operand_map;
+    operand_map.reserve(operands.size() + operand_count);
+    for (Operand* r : operands)
+    {
+        operand_map.emplace(r->name, r);
     }
 
+    ops.reserve(ops.size() + operator_count);
+    operands.reserve(operands.size() + operand_count);
+
     for (int i = 0; i < operator_count; i++)
     {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
+        auto line = next_line(p, end);
+        const char* lp = line.first;
+        const char* le = line.second;
 
-        std::string type;
-        std::string name;
-        int input_count = 0;
-        int output_count = 0;
+        std::string_view type = next_token(lp, le);
+        std::string_view name = next_token(lp, le);
+        int input_count = token_to_int(next_token(lp, le));
+        int output_count = token_to_int(next_token(lp, le));
 
-        iss >> type >> name >> input_count >> output_count;
-
-        Operator* op = new_operator(type, name);
+        Operator* op = new_operator(std::string(type), std::string(name));
 
         for (int j = 0; j < input_count; j++)
         {
-            std::string operand_name;
-            iss >> operand_name;
+            std::string_view operand_name = next_token(lp, le);
 
-            Operand* r = get_operand(operand_name);
+            auto it = operand_map.find(operand_name);
+            if (it == operand_map.end())
+            {
+                fprintf(stderr, "no such operand %s for operator %s\n", std::string(operand_name).c_str(), op->name.c_str());
+                return -1;
+            }
+
+            Operand* r = it->second;
             r->consumers.push_back(op);
             op->inputs.push_back(r);
         }
 
         for (int j = 0; j < output_count; j++)
         {
-            std::string operand_name;
-            iss >> operand_name;
+            std::string_view operand_name = next_token(lp, le);
 
-            Operand* r = new_operand(operand_name);
+            Operand* r = new_operand(std::string(operand_name));
             r->producer = op;
             op->outputs.push_back(r);
+            operand_map[r->name] = r;
         }
 
         // key=value
-        while (!iss.eof())
+        while (true)
         {
-            std::string param;
-            iss >> param;
+            std::string_view param = next_token(lp, le);
+            if (param.empty())
+                break;
 
-            std::string key;
-            std::string value;
-            std::istringstream pss(param);
-            std::getline(pss, key, '=');
-            std::getline(pss, value);
+            size_t eq = param.find('=');
+            std::string key(param.substr(0, eq));
+            std::string value(eq == std::string_view::npos ? std::string_view() : param.substr(eq + 1));
 
             if (key[0] == '@')
             {
@@ -917,7 +1008,7 @@ int Graph::save(const std::string& parampath, const std::string& binpath)
             fprintf(paramfp, type_to_string(attr.type));
 
             std::string filename = op->name + "." + it.first;
-            szw.write_file(filename, attr.data.data(), attr.data.size());
+            szw.write_file(filename, attr.data_ptr(), attr.data_size());
         }
 
         if (op->inputnames.size() == op->inputs.size())
@@ -0,0 +1,228 @@
+#include "runtime/numa.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <glog/logging.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace kuiper_infer {
+// 和linux/mempolicy.h中的定义相同，直接使用系统调用，不依赖libnuma
+constexpr int kMemoryPolicyDefault = 0;
+constexpr int kMemoryPolicyBind = 2;
+constexpr int kMemoryPolicyInterleave = 3;
+constexpr unsigned kMemoryPolicyMove = 1u << 1;
+
+/// 当前线程绑定的NUMA节点
+static thread_local int32_t preferred_node = -1;
+
+/// 系统的NUMA拓扑，第一次使用时读取
+struct NumaTopology {
+  std::vector<std::vector<uint32_t>> node_cpus; /// 每个节点上的CPU编号
+};
+
+/**
+ * 解析/sys中的列表格式，例如0-3,8-11
+ * @param text 列表文本
+ * @return 列表中的所有编号
+ */
+static std::vector<uint32_t> ParseIdList(const std::string &text) {
+  std::vector<uint32_t> ids;
+  std::stringstream stream(text);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty() || range.front() < '0' || range.front() > '9') {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    const uint32_t first = std::stoul(range.substr(0, dash));
+    const uint32_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+    for (uint32_t id = first; id <= last; ++id) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+static bool ReadIdList(const std::string &path, std::vector<uint32_t> &ids) {
+  std::ifstream file(path);
+  std::string text;
+  if (!file.is_open() || !std::getline(file, text)) {
+    return false;
+  }
+  ids = ParseIdList(text);
+  return !ids.empty();
+}
+
+static NumaTopology ReadNumaTopology() {
+  NumaTopology topology;
+  std::vector<uint32_t> nodes;
+  if (ReadIdList("/sys/devices/system/node/online", nodes)) {
+    // 节点编号可能不连续，没有CPU的节点也保留位置，保证下标就是节点编号
+    topology.node_cpus.resize(nodes.back() + 1);
+    for (const uint32_t node : nodes) {
+      ReadIdList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", topology.node_cpus.at(node));
+    }
+  }
+  if (topology.node_cpus.empty()) {
+    std::vector<uint32_t> cpus(std::max(std::thread::hardware_concurrency(), 1u));
+    for (uint32_t i = 0; i < cpus.size(); ++i) {
+      cpus.at(i) = i;
+    }
+    topology.node_cpus.push_back(std::move(cpus));
+  }
+  return topology;
+}
+
+static const NumaTopology &GetNumaTopology() {
+  static const NumaTopology topology = ReadNumaTopology();
+  return topology;
+}
+
+uint32_t NumaNodeNum() {
+  return GetNumaTopology().node_cpus.size();
+}
+
+std::vector<uint32_t> NumaNodeCpus(uint32_t node) {
+  const NumaTopology &topology = GetNumaTopology();
+  CHECK(node < topology.node_cpus.size()) << "The numa node " << node << " does not exist";
+  return topology.node_cpus.at(node);
+}
+
+uint32_t CurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < NumaNodeNum()) {
+    return node;
+  }
+#endif
+  return 0;
+}
+
+int32_t PreferredNumaNode() {
+  return preferred_node;
+}
+
+bool BindThreadToCpus(const std::vector<uint32_t> &cpus) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const uint32_t cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
+std::vector<uint32_t> ThreadCpus() {
+  std::vector<uint32_t> cpus;
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+std::vector<std::vector<uint32_t>> SplitCpus(uint32_t group_num, const std::vector<uint32_t> &cpus) {
+  std::vector<uint32_t> split_cpus = cpus.empty() ? ThreadCpus() : cpus;
+  if (split_cpus.empty()) {
+    const uint32_t cpu_num = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t cpu = 0; cpu < cpu_num; ++cpu) {
+      split_cpus.push_back(cpu);
+    }
+  }
+  CHECK(group_num > 0 && group_num <= split_cpus.size())
+          << "The group number " << group_num << " must be in (0, " << split_cpus.size() << "]";
+  std::vector<std::vector<uint32_t>> cpu_groups(group_num);
+  for (uint32_t g = 0; g < group_num; ++g) {
+    const uint32_t begin = g * split_cpus.size() / group_num;
+    const uint32_t end = (g + 1) * split_cpus.size() / group_num;
+    cpu_groups.at(g).assign(split_cpus.begin() + begin, split_cpus.begin() + end);
+  }
+  return cpu_groups;
+}
+
+bool BindThreadToNumaNode(uint32_t node) {
+  const std::vector<uint32_t> cpus = NumaNodeCpus(node);
+  if (cpus.empty() || !BindThreadToCpus(cpus)) {
+    LOG(WARNING) << "Bind the thread to numa node " << node << " failed";
+    return false;
+  }
+  preferred_node = int32_t(node);
+  return true;
+}
+
+bool PlaceMemory(const void *data, size_t bytes, NumaMemoryPolicy policy, uint32_t node) {
+  const uint32_t node_num = NumaNodeNum();
+  CHECK(node < node_num) << "The numa node " << node << " does not exist";
+  if (data == nullptr || bytes == 0 || node_num <= 1) {
+    return true;
+  }
+#if defined(__linux__) && defined(SYS_mbind)
+  // mbind要求起始地址按页对齐，首尾不完整的页和相邻的内存共用同一个策略
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t begin = uintptr_t(data) / page_size * page_size;
+  const uintptr_t end = (uintptr_t(data) + bytes + page_size - 1) / page_size * page_size;
+
+  constexpr uint32_t kMaskBits = sizeof(unsigned long) * 8;
+  std::vector<unsigned long> node_mask((node_num + kMaskBits - 1) / kMaskBits, 0);
+  int mode = kMemoryPolicyDefault;
+  if (policy == NumaMemoryPolicy::kBind) {
+    mode = kMemoryPolicyBind;
+    node_mask.at(node / kMaskBits) |= 1ul << (node % kMaskBits);
+  } else if (policy == NumaMemoryPolicy::kInterleave) {
+    mode = kMemoryPolicyInterleave;
+    for (uint32_t i = 0; i < node_num; ++i) {
+      if (!GetNumaTopology().node_cpus.at(i).empty()) {
+        node_mask.at(i / kMaskBits) |= 1ul << (i % kMaskBits);
+      }
+    }
+  }
+  const unsigned long *mask = mode == kMemoryPolicyDefault ? nullptr : node_mask.data();
+  const unsigned long max_node = mode == kMemoryPolicyDefault ? 0 : node_mask.size() * kMaskBits + 1;
+  if (syscall(SYS_mbind, begin, end - begin, mode, mask, max_node, kMemoryPolicyMove) != 0) {
+    LOG(WARNING) << "Place " << bytes << " bytes of memory on numa node " << node << " failed";
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+NumaNodeScope::NumaNodeScope(int32_t node) {
+  if (node < 0 || node == preferred_node) {
+    return;
+  }
+  previous_node_ = preferred_node;
+  previous_cpus_ = ThreadCpus();
+  bound_ = BindThreadToNumaNode(uint32_t(node));
+}
+
+NumaNodeScope::~NumaNodeScope() {
+  if (!bound_) {
+    return;
+  }
+  if (!previous_cpus_.empty()) {
+    BindThreadToCpus(previous_cpus_);
+  }
+  preferred_node = previous_node_;
+}
+}
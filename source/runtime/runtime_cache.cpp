@@ -0,0 +1,599 @@
+#include "runtime/runtime_ir.hpp"
+#include "runtime/store_zip.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <sys/stat.h>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+/// 编译缓存中保存计算图结构的文件名称，权重属性按照节点和属性的编号分别保存
+static const char *kCacheGraphName = "kuiper.graph";
+static const uint32_t kCacheMagic = 0x4b504943;
+/// 缓存格式发生变化时需要增加版本号，版本不同的缓存不会被加载
+static const uint32_t kCacheVersion = 3;
+/// zip文件末尾的中央目录结束记录的签名和长度，记录之后可能还有注释
+static const uint32_t kZipEndSignature = 0x06054b50;
+static const size_t kZipEndSize = 22;
+
+/// 模型文件的指纹，文件的大小、修改时间或者内容的哈希变化之后缓存不再有效
+/// 修改时间只精确到秒，同一秒内大小不变的改写由内容的哈希发现
+struct ModelFingerprint {
+  uint64_t size = 0; /// 文件的字节数
+  int64_t mtime = 0; /// 文件的修改时间，单位为秒
+  uint64_t hash = 0; /// 文件内容的哈希
+
+  /**
+   * 返回是否取得了指纹，文件不存在时没有指纹，无法检查缓存是否过期
+   * @return 是否有指纹
+   */
+  bool valid() const {
+    return size != 0 || mtime != 0;
+  }
+
+  bool operator==(const ModelFingerprint &other) const {
+    return size == other.size && mtime == other.mtime && hash == other.hash;
+  }
+};
+
+/**
+ * 计算一段数据的FNV-1a哈希
+ * @param data 数据的起始地址
+ * @param size 字节数
+ * @param hash 之前的数据的哈希，用于连续计算多段数据
+ * @return 哈希值
+ */
+static uint64_t HashBytes(const char *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= uint8_t(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/**
+ * 计算文件内容的哈希。权重文件是zip格式，中央目录记录了每个条目的名称、大小和CRC32，
+ * 只对中央目录计算哈希就能发现任何条目的变化，不需要读完整个权重文件；找不到中央目录时对整个文件计算哈希
+ * @param file 打开的文件
+ * @param size 文件的字节数
+ * @return 哈希值
+ */
+static uint64_t FileContentHash(FILE *file, uint64_t size) {
+  std::vector<char> buffer(size_t(std::min<uint64_t>(size, 65535 + kZipEndSize)));
+  if (fseek(file, long(size - buffer.size()), SEEK_SET) == 0
+      && fread(buffer.data(), 1, buffer.size(), file) == buffer.size()) {
+    for (size_t end = buffer.size(); end >= kZipEndSize; --end) {
+      const char *record = buffer.data() + end - kZipEndSize;
+      uint32_t signature = 0;
+      uint32_t directory_size = 0;
+      uint32_t directory_offset = 0;
+      memcpy(&signature, record, sizeof(signature));
+      memcpy(&directory_size, record + 12, sizeof(directory_size));
+      memcpy(&directory_offset, record + 16, sizeof(directory_offset));
+      if (signature != kZipEndSignature || uint64_t(directory_offset) + directory_size > size) {
+        continue;
+      }
+      std::vector<char> directory(directory_size);
+      if (fseek(file, long(directory_offset), SEEK_SET) == 0
+          && fread(directory.data(), 1, directory.size(), file) == directory.size()) {
+        return HashBytes(directory.data(), directory.size());
+      }
+      break;
+    }
+  }
+
+  uint64_t hash = HashBytes(nullptr, 0);
+  std::vector<char> chunk(1 << 20);
+  rewind(file);
+  size_t read_size = 0;
+  while ((read_size = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+    hash = HashBytes(chunk.data(), read_size, hash);
+  }
+  return hash;
+}
+
+/**
+ * 读取模型文件的指纹
+ * @param path 模型文件的路径
+ * @return 文件的指纹，路径为空或者文件不存在时为空的指纹
+ */
+static ModelFingerprint FileFingerprint(const std::string &path) {
+  ModelFingerprint fingerprint;
+  struct stat file_stat{};
+  if (!path.empty() && stat(path.c_str(), &file_stat) == 0) {
+    fingerprint.size = uint64_t(file_stat.st_size);
+    fingerprint.mtime = int64_t(file_stat.st_mtime);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file != nullptr) {
+      fingerprint.hash = FileContentHash(file, fingerprint.size);
+      fclose(file);
+    }
+  }
+  return fingerprint;
+}
+
+/// 将计算图结构按照小端的二进制格式写入缓冲区
+class CacheWriter {
+ public:
+  void WriteUInt(uint32_t value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteInt(int32_t value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteUInt64(uint64_t value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteFingerprint(const ModelFingerprint &fingerprint) {
+    WriteUInt64(fingerprint.size);
+    WriteUInt64(uint64_t(fingerprint.mtime));
+    WriteUInt64(fingerprint.hash);
+  }
+
+  void WriteFloat(float value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteString(const std::string &value) {
+    WriteUInt(value.size());
+    WriteBytes(value.data(), value.size());
+  }
+
+  void WriteInts(const std::vector<int32_t> &values) {
+    WriteUInt(values.size());
+    WriteBytes(values.data(), values.size() * sizeof(int32_t));
+  }
+
+  const std::vector<char> &buffer() const {
+    return buffer_;
+  }
+
+ private:
+  void WriteBytes(const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+  }
+
+  std::vector<char> buffer_;
+};
+
+/// 从缓冲区中读取计算图结构，越界时返回false而不是继续读取
+class CacheReader {
+ public:
+  CacheReader(const char *data, size_t size) : data_(data), size_(size) {
+  }
+
+  bool ReadUInt(uint32_t &value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+
+  bool ReadInt(int32_t &value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+
+  bool ReadUInt64(uint64_t &value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+
+  bool ReadFingerprint(ModelFingerprint &fingerprint) {
+    uint64_t mtime = 0;
+    if (!ReadUInt64(fingerprint.size) || !ReadUInt64(mtime) || !ReadUInt64(fingerprint.hash)) {
+      return false;
+    }
+    fingerprint.mtime = int64_t(mtime);
+    return true;
+  }
+
+  bool ReadFloat(float &value) {
+    return ReadBytes(&value, sizeof(value));
+  }
+
+  bool ReadString(std::string &value) {
+    uint32_t length = 0;
+    if (!ReadUInt(length) || length > size_ - offset_) {
+      return false;
+    }
+    value.assign(data_ + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+  bool ReadInts(std::vector<int32_t> &values) {
+    uint32_t length = 0;
+    if (!ReadUInt(length) || length > (size_ - offset_) / sizeof(int32_t)) {
+      return false;
+    }
+    values.resize(length);
+    return ReadBytes(values.data(), length * sizeof(int32_t));
+  }
+
+ private:
+  bool ReadBytes(void *data, size_t size) {
+    if (size > size_ - offset_) {
+      return false;
+    }
+    memcpy(data, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+};
+
+static void WriteParameter(const RuntimeParameter *parameter, CacheWriter &writer) {
+  writer.WriteInt(int32_t(parameter->type));
+  switch (parameter->type) {
+    case RuntimeParameterType::kParameterBool: {
+      writer.WriteInt(dynamic_cast<const RuntimeParameterBool *>(parameter)->value);
+      break;
+    }
+    case RuntimeParameterType::kParameterInt: {
+      writer.WriteInt(dynamic_cast<const RuntimeParameterInt *>(parameter)->value);
+      break;
+    }
+    case RuntimeParameterType::kParameterFloat: {
+      writer.WriteFloat(dynamic_cast<const RuntimeParameterFloat *>(parameter)->value);
+      break;
+    }
+    case RuntimeParameterType::kParameterString: {
+      writer.WriteString(dynamic_cast<const RuntimeParameterString *>(parameter)->value);
+      break;
+    }
+    case RuntimeParameterType::kParameterIntArray: {
+      writer.WriteInts(dynamic_cast<const RuntimeParameterIntArray *>(parameter)->value);
+      break;
+    }
+    case RuntimeParameterType::kParameterFloatArray: {
+      const std::vector<float> &values = dynamic_cast<const RuntimeParameterFloatArray *>(parameter)->value;
+      writer.WriteUInt(values.size());
+      for (const float value : values) {
+        writer.WriteFloat(value);
+      }
+      break;
+    }
+    case RuntimeParameterType::kParameterStringArray: {
+      const std::vector<std::string> &values = dynamic_cast<const RuntimeParameterStringArray *>(parameter)->value;
+      writer.WriteUInt(values.size());
+      for (const auto &value : values) {
+        writer.WriteString(value);
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+static RuntimeParameter *ReadParameter(CacheReader &reader) {
+  int32_t type = 0;
+  if (!reader.ReadInt(type)) {
+    return nullptr;
+  }
+  switch (RuntimeParameterType(type)) {
+    case RuntimeParameterType::kParameterUnknown: {
+      return new RuntimeParameter;
+    }
+    case RuntimeParameterType::kParameterBool: {
+      int32_t value = 0;
+      if (!reader.ReadInt(value)) {
+        return nullptr;
+      }
+      RuntimeParameterBool *parameter = new RuntimeParameterBool;
+      parameter->value = value != 0;
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterInt: {
+      RuntimeParameterInt *parameter = new RuntimeParameterInt;
+      if (!reader.ReadInt(parameter->value)) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterFloat: {
+      RuntimeParameterFloat *parameter = new RuntimeParameterFloat;
+      if (!reader.ReadFloat(parameter->value)) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterString: {
+      RuntimeParameterString *parameter = new RuntimeParameterString;
+      if (!reader.ReadString(parameter->value)) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterIntArray: {
+      RuntimeParameterIntArray *parameter = new RuntimeParameterIntArray;
+      if (!reader.ReadInts(parameter->value)) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterFloatArray: {
+      RuntimeParameterFloatArray *parameter = new RuntimeParameterFloatArray;
+      uint32_t length = 0;
+      bool read_success = reader.ReadUInt(length);
+      for (uint32_t i = 0; read_success && i < length; ++i) {
+        float value = 0.f;
+        read_success = reader.ReadFloat(value);
+        parameter->value.push_back(value);
+      }
+      if (!read_success) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    case RuntimeParameterType::kParameterStringArray: {
+      RuntimeParameterStringArray *parameter = new RuntimeParameterStringArray;
+      uint32_t length = 0;
+      bool read_success = reader.ReadUInt(length);
+      for (uint32_t i = 0; read_success && i < length; ++i) {
+        std::string value;
+        read_success = reader.ReadString(value);
+        parameter->value.push_back(value);
+      }
+      if (!read_success) {
+        delete parameter;
+        return nullptr;
+      }
+      return parameter;
+    }
+    default: {
+      return nullptr;
+    }
+  }
+}
+
+std::string RuntimeGraph::CacheBuildConfig() const {
+  std::stringstream config;
+  config << "batch=" << max_batch_size_ << ";passes=";
+  for (const auto &pass : pass_manager_.passes()) {
+    config << pass->name() << ",";
+  }
+  config << ";quantization=";
+  for (const auto &setting : weight_quantization_) {
+    config << setting.first << ":" << setting.second.first << ":" << setting.second.second << ",";
+  }
+  return config.str();
+}
+
+bool RuntimeGraph::SaveCache(const std::string &cache_path) const {
+  if (graph_state_ != GraphState::Complete || build_data_released_) {
+    LOG(ERROR) << "The graph cache can only be saved after build and before releasing the build data";
+    return false;
+  }
+
+  pnnx::StoreZipWriter zip_writer;
+  if (zip_writer.open(cache_path) != 0) {
+    LOG(ERROR) << "Can not open the graph cache: " << cache_path;
+    return false;
+  }
+
+  // 节点按照计算图中的顺序保存，节点之间的连接关系通过节点名称在加载时恢复
+  CacheWriter writer;
+  writer.WriteUInt(kCacheMagic);
+  writer.WriteUInt(kCacheVersion);
+  // 记录生成缓存时模型文件的指纹，模型文件更新之后不再加载过期的缓存
+  writer.WriteFingerprint(FileFingerprint(param_path_));
+  writer.WriteFingerprint(FileFingerprint(bin_path_));
+  writer.WriteString(CacheBuildConfig());
+  writer.WriteUInt(operators_.size());
+  for (uint32_t i = 0; i < operators_.size(); ++i) {
+    const auto &op = operators_.at(i);
+    writer.WriteString(op->name);
+    writer.WriteString(op->type);
+
+    writer.WriteUInt(op->input_operands_seq.size());
+    for (const auto &input_operand : op->input_operands_seq) {
+      writer.WriteString(input_operand->name);
+      writer.WriteInt(int32_t(input_operand->type));
+      writer.WriteInts(input_operand->shapes);
+    }
+
+    if (op->output_operands != nullptr) {
+      writer.WriteUInt(1);
+      writer.WriteString(op->output_operands->name);
+      writer.WriteInts(op->output_operands->shapes);
+    } else {
+      writer.WriteUInt(0);
+    }
+
+    writer.WriteUInt(op->output_names.size());
+    for (const auto &output_name : op->output_names) {
+      writer.WriteString(output_name);
+    }
+
+    writer.WriteUInt(op->params.size());
+    for (const auto &param : op->params) {
+      writer.WriteString(param.first);
+      WriteParameter(param.second, writer);
+    }
+
+    writer.WriteUInt(op->attribute.size());
+    uint32_t attr_index = 0;
+    for (const auto &attr : op->attribute) {
+      const std::string &entry_name = std::to_string(i) + "." + std::to_string(attr_index++);
+      writer.WriteString(attr.first);
+      writer.WriteString(entry_name);
+      writer.WriteInt(int32_t(attr.second->type));
+      writer.WriteInts(attr.second->shape);
+      zip_writer.write_file(entry_name, attr.second->weight_ptr(), attr.second->weight_bytes());
+    }
+  }
+  zip_writer.write_file(kCacheGraphName, writer.buffer().data(), writer.buffer().size());
+  zip_writer.close();
+  return true;
+}
+
+bool RuntimeGraph::InitFromCache(const std::string &cache_path) {
+  FILE *cache_file = fopen(cache_path.c_str(), "rb");
+  if (cache_file == nullptr) {
+    LOG(INFO) << "The graph cache does not exist: " << cache_path;
+    return false;
+  }
+  fclose(cache_file);
+
+  pnnx::StoreZipReader zip_reader;
+  if (zip_reader.open(cache_path) != 0) {
+    LOG(ERROR) << "Can not open the graph cache: " << cache_path;
+    return false;
+  }
+  const size_t graph_size = zip_reader.get_file_size(kCacheGraphName);
+  if (graph_size == 0) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+  std::vector<char> graph_data(graph_size);
+  zip_reader.read_file(kCacheGraphName, graph_data.data());
+
+  CacheReader reader(graph_data.data(), graph_data.size());
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint32_t operator_num = 0;
+  if (!reader.ReadUInt(magic) || !reader.ReadUInt(version) || magic != kCacheMagic) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+  if (version != kCacheVersion) {
+    LOG(ERROR) << "The graph cache version " << version << " does not match the current version " << kCacheVersion;
+    return false;
+  }
+  ModelFingerprint param_fingerprint;
+  ModelFingerprint bin_fingerprint;
+  if (!reader.ReadFingerprint(param_fingerprint) || !reader.ReadFingerprint(bin_fingerprint)) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+  // 模型文件存在时必须和生成缓存时相同，只有缓存文件时无法检查，直接使用缓存
+  const ModelFingerprint &current_param = FileFingerprint(param_path_);
+  const ModelFingerprint &current_bin = FileFingerprint(bin_path_);
+  if ((current_param.valid() && !(current_param == param_fingerprint))
+      || (current_bin.valid() && !(current_bin == bin_fingerprint))) {
+    LOG(INFO) << "The model files have changed since the graph cache was saved: " << cache_path;
+    return false;
+  }
+  std::string build_config;
+  if (!reader.ReadString(build_config)) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+  if (build_config != CacheBuildConfig()) {
+    LOG(INFO) << "The build settings have changed since the graph cache was saved: " << cache_path
+              << ", cached: " << build_config << ", current: " << CacheBuildConfig();
+    return false;
+  }
+  if (!reader.ReadUInt(operator_num) || operator_num == 0) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+
+  std::vector<std::shared_ptr<RuntimeOperator>> operators;
+  bool read_success = true;
+  for (uint32_t i = 0; read_success && i < operator_num; ++i) {
+    std::shared_ptr<RuntimeOperator> runtime_operator = std::make_shared<RuntimeOperator>();
+    read_success = reader.ReadString(runtime_operator->name) && reader.ReadString(runtime_operator->type);
+
+    uint32_t input_num = 0;
+    read_success = read_success && reader.ReadUInt(input_num);
+    for (uint32_t j = 0; read_success && j < input_num; ++j) {
+      std::shared_ptr<RuntimeOperand> runtime_operand = std::make_shared<RuntimeOperand>();
+      int32_t type = 0;
+      read_success = reader.ReadString(runtime_operand->name) && reader.ReadInt(type)
+          && reader.ReadInts(runtime_operand->shapes);
+      runtime_operand->type = RuntimeDataType(type);
+      runtime_operator->input_operands.insert({runtime_operand->name, runtime_operand});
+      runtime_operator->input_operands_seq.push_back(runtime_operand);
+    }
+
+    uint32_t has_output = 0;
+    read_success = read_success && reader.ReadUInt(has_output);
+    if (read_success && has_output != 0) {
+      std::shared_ptr<RuntimeOperand> output_operand = std::make_shared<RuntimeOperand>();
+      read_success = reader.ReadString(output_operand->name) && reader.ReadInts(output_operand->shapes);
+      const std::vector<int32_t> &shapes = output_operand->shapes;
+      read_success = read_success && (shapes.size() == 2 || shapes.size() == 3 || shapes.size() == 4)
+          && shapes.at(0) >= 0;
+      if (read_success) {
+        // 中间张量由执行上下文按照内存规划创建
+        output_operand->type = RuntimeDataType::kTypeFloat32;
+        runtime_operator->output_operands = output_operand;
+      }
+    }
+
+    uint32_t output_name_num = 0;
+    read_success = read_success && reader.ReadUInt(output_name_num);
+    for (uint32_t j = 0; read_success && j < output_name_num; ++j) {
+      std::string output_name;
+      read_success = reader.ReadString(output_name);
+      runtime_operator->output_names.push_back(output_name);
+    }
+
+    uint32_t param_num = 0;
+    read_success = read_success && reader.ReadUInt(param_num);
+    for (uint32_t j = 0; read_success && j < param_num; ++j) {
+      std::string param_name;
+      read_success = reader.ReadString(param_name);
+      RuntimeParameter *parameter = read_success ? ReadParameter(reader) : nullptr;
+      if (parameter == nullptr) {
+        read_success = false;
+      } else if (!runtime_operator->params.insert({param_name, parameter}).second) {
+        delete parameter;
+      }
+    }
+
+    uint32_t attr_num = 0;
+    read_success = read_success && reader.ReadUInt(attr_num);
+    for (uint32_t j = 0; read_success && j < attr_num; ++j) {
+      std::string attr_name;
+      std::string entry_name;
+      int32_t type = 0;
+      std::shared_ptr<RuntimeAttribute> runtime_attribute = std::make_shared<RuntimeAttribute>();
+      read_success = reader.ReadString(attr_name) && reader.ReadString(entry_name) && reader.ReadInt(type)
+          && reader.ReadInts(runtime_attribute->shape);
+      if (!read_success) {
+        break;
+      }
+      runtime_attribute->type = RuntimeDataType(type);
+      // 缓存文件映射到内存时权重直接引用映射的数据
+      const size_t weight_size = zip_reader.get_file_size(entry_name);
+      runtime_attribute->mapped_data = zip_reader.get_file_view(entry_name);
+      if (runtime_attribute->mapped_data) {
+        runtime_attribute->mapped_size = weight_size;
+      } else {
+        runtime_attribute->weight_data.resize(weight_size);
+        read_success = weight_size != 0 && zip_reader.read_file(entry_name, runtime_attribute->weight_data.data()) == 0;
+      }
+      runtime_operator->attribute.insert({attr_name, runtime_attribute});
+    }
+    operators.push_back(runtime_operator);
+  }
+  zip_reader.close();
+
+  if (!read_success) {
+    LOG(ERROR) << "The graph cache is broken: " << cache_path;
+    return false;
+  }
+
+  InitOperatorEdges(operators);
+
+  this->graph_.reset();
+  this->operators_ = operators;
+  build_data_released_ = false;
+  graph_state_ = GraphState::NeedBuild;
+  return true;
+}
+}
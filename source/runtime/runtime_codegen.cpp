@@ -0,0 +1,463 @@
+#include "runtime/runtime_ir.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+/// 生成代码时直接创建的Layer，类型不在表中的节点仍然通过注册表创建并且通过虚函数调用
+struct GeneratedLayerType {
+  const char *type; /// 计算节点的类型
+  const char *class_name; /// 对应的Layer类
+  const char *header; /// Layer类所在的头文件，相对于source目录
+};
+
+static const GeneratedLayerType kGeneratedLayerTypes[] = {
+    {"nn.AdaptiveAvgPool2d", "AdaptiveAveragePoolingLayer", "layer/details/adaptive_avgpooling.hpp"},
+    {"nn.BatchNorm2d", "BatchNorm2dLayer", "layer/details/batchnorm2d.hpp"},
+    {"torch.cat", "CatLayer", "layer/details/cat.hpp"},
+    {"nn.Conv2d", "ConvolutionLayer", "layer/details/convolution.hpp"},
+    {"pnnx.Expression", "ExpressionLayer", "layer/details/expression.hpp"},
+    {"torch.flatten", "FlattenLayer", "layer/details/flatten.hpp"},
+    {"nn.Hardsigmoid", "HardSigmoid", "layer/details/hardsigmoid.hpp"},
+    {"nn.Hardswish", "HardSwishLayer", "layer/details/hardswish.hpp"},
+    {"nn.Linear", "LinearLayer", "layer/details/linear.hpp"},
+    {"nn.MaxPool2d", "MaxPoolingLayer", "layer/details/maxpooling.hpp"},
+    {"nn.ReLU", "ReluLayer", "layer/details/relu.hpp"},
+    {"nn.Sigmoid", "SigmoidLayer", "layer/details/sigmoid.hpp"},
+    {"nn.SiLU", "SiLULayer", "layer/details/silu.hpp"},
+    {"nn.Softmax", "SoftmaxLayer", "layer/details/softmax.hpp"},
+    {"F.softmax", "SoftmaxLayer", "layer/details/softmax.hpp"},
+    {"kuiper.SqueezeExcitation", "SqueezeExcitationLayer", "layer/details/squeeze_excitation.hpp"},
+    {"nn.Upsample", "UpSampleLayer", "layer/details/upsample.hpp"},
+    {"Tensor.view", "ViewLayer", "layer/details/view.hpp"},
+    {"models.yolo.Detect", "YoloDetectLayer", "layer/details/yolo_detect.hpp"},
+};
+
+/// 内存块在生成代码的内存中按照64字节对齐依次排列
+constexpr size_t kGeneratedAlignFloats = 16;
+
+static const GeneratedLayerType *FindGeneratedLayerType(const std::string &type) {
+  for (const GeneratedLayerType &layer_type : kGeneratedLayerTypes) {
+    if (type == layer_type.type) {
+      return &layer_type;
+    }
+  }
+  return nullptr;
+}
+
+static bool IsIdentifier(const std::string &name) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front()))) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  });
+}
+
+/**
+ * 转换为C++的字符串字面量
+ */
+static std::string StringLiteral(const std::string &value) {
+  std::string literal = "\"";
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      literal.push_back('\\');
+      literal.push_back(c);
+    } else if (std::isprint(static_cast<unsigned char>(c))) {
+      literal.push_back(c);
+    } else {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\%03o", static_cast<unsigned char>(c));
+      literal += escaped;
+    }
+  }
+  literal.push_back('"');
+  return literal;
+}
+
+/**
+ * 转换为C++的浮点数字面量，使用十六进制表示保证生成的值和原来的值完全相同
+ */
+static std::string FloatLiteral(float value) {
+  if (std::isnan(value)) {
+    return "std::numeric_limits<float>::quiet_NaN()";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "std::numeric_limits<float>::infinity()" : "-std::numeric_limits<float>::infinity()";
+  }
+  char literal[32];
+  snprintf(literal, sizeof(literal), "%af", value);
+  return literal;
+}
+
+template<typename T>
+static std::string JoinValues(const std::vector<T> &values, const std::function<std::string(const T &)> &format) {
+  std::string joined;
+  for (uint32_t i = 0; i < values.size(); ++i) {
+    if (i > 0) {
+      joined += ", ";
+    }
+    joined += format(values.at(i));
+  }
+  return joined;
+}
+
+static std::string IntValues(const std::vector<int32_t> &values) {
+  return JoinValues<int32_t>(values, [](const int32_t &value) { return std::to_string(value); });
+}
+
+static std::string ParameterLiteral(const RuntimeParameter *parameter) {
+  switch (parameter->type) {
+    case RuntimeParameterType::kParameterBool: {
+      const bool value = dynamic_cast<const RuntimeParameterBool *>(parameter)->value;
+      return std::string("MakeParameter<RuntimeParameterBool>(") + (value ? "true" : "false") + ")";
+    }
+    case RuntimeParameterType::kParameterInt: {
+      const int32_t value = dynamic_cast<const RuntimeParameterInt *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterInt>(" + std::to_string(value) + ")";
+    }
+    case RuntimeParameterType::kParameterFloat: {
+      const float value = dynamic_cast<const RuntimeParameterFloat *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterFloat>(" + FloatLiteral(value) + ")";
+    }
+    case RuntimeParameterType::kParameterString: {
+      const std::string &value = dynamic_cast<const RuntimeParameterString *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterString>(std::string(" + StringLiteral(value) + "))";
+    }
+    case RuntimeParameterType::kParameterIntArray: {
+      const std::vector<int32_t> &values = dynamic_cast<const RuntimeParameterIntArray *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterIntArray>(std::vector<int>{" + IntValues(values) + "})";
+    }
+    case RuntimeParameterType::kParameterFloatArray: {
+      const std::vector<float> &values = dynamic_cast<const RuntimeParameterFloatArray *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterFloatArray>(std::vector<float>{"
+          + JoinValues<float>(values, [](const float &value) { return FloatLiteral(value); }) + "})";
+    }
+    case RuntimeParameterType::kParameterStringArray: {
+      const std::vector<std::string> &values = dynamic_cast<const RuntimeParameterStringArray *>(parameter)->value;
+      return "MakeParameter<RuntimeParameterStringArray>(std::vector<std::string>{"
+          + JoinValues<std::string>(values, [](const std::string &value) { return StringLiteral(value); }) + "})";
+    }
+    default: {
+      // 未知类型的参数无法还原，返回空字符串
+      return "";
+    }
+  }
+}
+
+/**
+ * 按照内存规划中创建张量的方式把形状转换为通道数、行数和列数
+ */
+static std::vector<int32_t> TensorDims(const std::vector<int32_t> &shapes) {
+  CHECK(shapes.size() >= 2 && shapes.size() <= 4) << "The shape of generated tensor is wrong";
+  if (shapes.size() == 4) {
+    return {shapes.at(1), shapes.at(2), shapes.at(3)};
+  } else if (shapes.size() == 2) {
+    return {1, shapes.at(1), 1};
+  } else {
+    return {1, shapes.at(1), shapes.at(2)};
+  }
+}
+
+/**
+ * 把权重按照32位的字写成数组的初始化列表，不足4字节的部分补0，生成的代码需要在字节序相同的处理器上编译
+ */
+static void WriteWeightWords(const char *data, size_t bytes, std::ostream &source) {
+  // 空的权重也输出一个字，数组的长度不能为0
+  const size_t word_num = std::max(size_t(1), (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+  char word_text[16];
+  for (size_t w = 0; w < word_num; ++w) {
+    uint32_t word = 0;
+    memcpy(&word, data + w * sizeof(uint32_t), std::min(sizeof(uint32_t), bytes - w * sizeof(uint32_t)));
+    snprintf(word_text, sizeof(word_text), "0x%08x,", word);
+    source << (w % 8 == 0 ? "\n    " : " ") << word_text;
+  }
+  source << "\n";
+}
+
+bool RuntimeGraph::GenerateSource(const std::string &header_path, const std::string &source_path,
+                                  const std::string &class_name) const {
+  if (graph_state_ != GraphState::Complete || build_data_released_) {
+    LOG(ERROR) << "The source can only be generated after build and before releasing the build data";
+    return false;
+  }
+  if (device_op_num_ > 0) {
+    LOG(ERROR) << "The generated source only supports graphs executed on CPU";
+    return false;
+  }
+  if (!IsIdentifier(class_name)) {
+    LOG(ERROR) << "The class name of generated source is not an identifier: " << class_name;
+    return false;
+  }
+
+  const RuntimeGraphPlan &plan = default_context_->plans_.front();
+  const RuntimeMemoryPlanner &memory_planner = plan.memory_planner;
+  const std::vector<std::vector<int32_t>> &output_shapes = plan.output_shapes;
+  const uint32_t batch_size = plan.input_shape.at(0);
+
+  // 内存块依次排列在同一块内存中，输入张量放在最后
+  std::vector<size_t> slot_offsets;
+  size_t arena_size = 0;
+  for (uint32_t s = 0; s < memory_planner.slot_count(); ++s) {
+    slot_offsets.push_back(arena_size);
+    arena_size += (memory_planner.slot_size(s) + kGeneratedAlignFloats - 1) / kGeneratedAlignFloats
+        * kGeneratedAlignFloats;
+  }
+  uint32_t input_index = 0;
+  size_t workspace_size = kGeneratedAlignFloats;
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    if (topo_operators_.at(i) == input_operator_) {
+      input_index = i;
+    }
+    workspace_size = std::max(workspace_size, memory_planner.workspace(i).workspace_size);
+  }
+  const std::vector<int32_t> &input_dims = TensorDims(output_shapes.at(input_index));
+  const size_t input_offset = arena_size;
+  const size_t input_elem_size = size_t(input_dims.at(0)) * input_dims.at(1) * input_dims.at(2);
+  arena_size += input_elem_size * batch_size;
+  const std::vector<int32_t> &output_dims = TensorDims(output_shapes.at(topo_output_index_));
+
+  std::string header_name = header_path;
+  if (header_name.find_last_of('/') != std::string::npos) {
+    header_name = header_name.substr(header_name.find_last_of('/') + 1);
+  }
+  std::string guard_name = class_name;
+  std::transform(guard_name.begin(), guard_name.end(), guard_name.begin(),
+                 [](char c) { return char(std::toupper(static_cast<unsigned char>(c))); });
+
+  std::ostringstream header;
+  header << "// 由KuiperInfer根据" << param_path_ << "生成，不要手动修改\n"
+         << "#ifndef KUIPER_GENERATED_" << guard_name << "_HPP_\n"
+         << "#define KUIPER_GENERATED_" << guard_name << "_HPP_\n"
+         << "#include <cstdint>\n#include <memory>\n#include \"data/tensor.hpp\"\n\n"
+         << "namespace kuiper_infer {\n"
+         << "/// " << param_path_ << "的专用推理代码，输入形状和批次固定，输出是" << output_names_.front() << "\n"
+         << "class " << class_name << " {\n public:\n"
+         << "  static constexpr uint32_t kBatchSize = " << batch_size << "; /// 每次推理的批次大小\n"
+         << "  static constexpr uint32_t kInputShape[3] = {" << IntValues(input_dims)
+         << "}; /// 每个输入张量的通道数、行数和列数\n"
+         << "  static constexpr uint32_t kOutputShape[3] = {" << IntValues(output_dims)
+         << "}; /// 每个输出张量的通道数、行数和列数\n\n"
+         << "  " << class_name << "();\n\n  ~" << class_name << "();\n\n"
+         << "  " << class_name << "(const " << class_name << " &) = delete;\n\n"
+         << "  " << class_name << " &operator=(const " << class_name << " &) = delete;\n\n"
+         << "  /**\n   * 返回一个输入张量，推理之前写入输入数据，张量建立在模型预先分配的内存上\n"
+         << "   * @param batch 输入张量的编号，小于kBatchSize\n   * @return 输入张量\n   */\n"
+         << "  Tensor<float> &input(uint32_t batch);\n\n"
+         << "  /**\n   * 返回一个输出张量，下一次推理时会被覆盖\n"
+         << "   * @param batch 输出张量的编号，小于kBatchSize\n   * @return 输出张量\n   */\n"
+         << "  const Tensor<float> &output(uint32_t batch) const;\n\n"
+         << "  /**\n   * 按照执行序列依次执行所有节点\n   */\n"
+         << "  void Forward();\n\n"
+         << " private:\n  struct Impl;\n  std::unique_ptr<Impl> impl_;\n};\n}\n"
+         << "#endif //KUIPER_GENERATED_" << guard_name << "_HPP_\n";
+
+  // 每个节点的输出张量在生成代码中的变量，输入节点使用输入张量
+  std::vector<std::string> output_vars(topo_operators_.size());
+  std::vector<const GeneratedLayerType *> layer_types(topo_operators_.size(), nullptr);
+  std::vector<std::string> headers;
+  bool use_registry = false;
+  std::ostringstream members;
+  std::ostringstream constructor;
+  std::ostringstream forward;
+  output_vars.at(input_index) = "impl.input";
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &op = topo_operators_.at(i);
+    if (op == input_operator_ || op->type == "pnnx.Output") {
+      continue;
+    }
+    const std::string &index = std::to_string(i);
+    const GeneratedLayerType *layer_type = FindGeneratedLayerType(op->type);
+    layer_types.at(i) = layer_type;
+    if (layer_type != nullptr) {
+      if (std::find(headers.begin(), headers.end(), layer_type->header) == headers.end()) {
+        headers.emplace_back(layer_type->header);
+      }
+      members << "  std::shared_ptr<" << layer_type->class_name << "> layer" << index << ";\n";
+    } else {
+      use_registry = true;
+      members << "  std::shared_ptr<Layer> layer" << index << ";\n";
+    }
+    members << "  std::vector<std::shared_ptr<Tensor<float>>> inputs" << index << ";\n"
+            << "  std::vector<std::shared_ptr<Tensor<float>>> outputs" << index << ";\n";
+    output_vars.at(i) = "impl.outputs" + index;
+
+    constructor << "  // " << op->name << ": " << op->type << "\n  {\n"
+                << "    std::shared_ptr<RuntimeOperator> op = std::make_shared<RuntimeOperator>();\n"
+                << "    op->name = " << StringLiteral(op->name) << ";\n"
+                << "    op->type = " << StringLiteral(op->type) << ";\n";
+    for (const auto &input_operand : op->input_operands_seq) {
+      constructor << "    AddOperand(*op, " << StringLiteral(input_operand->name) << ", {"
+                  << IntValues(input_operand->shapes) << "});\n";
+    }
+    for (const auto &param : op->params) {
+      const std::string &param_literal = ParameterLiteral(param.second);
+      if (param_literal.empty()) {
+        LOG(ERROR) << "The parameter " << param.first << " of " << op->name
+                   << " can not be generated, type: " << int(param.second->type);
+        return false;
+      }
+      constructor << "    op->params.insert({" << StringLiteral(param.first) << ", " << param_literal << "});\n";
+    }
+    uint32_t attr_index = 0;
+    for (const auto &attr : op->attribute) {
+      const std::string &weight_name = "kWeight" + index + "_" + std::to_string(attr_index++);
+      constructor << "    op->attribute.insert({" << StringLiteral(attr.first) << ", EmbeddedAttribute(" << weight_name
+                  << ", " << attr.second->weight_bytes() << ", RuntimeDataType(" << int32_t(attr.second->type)
+                  << "), {" << IntValues(attr.second->shape) << "})});\n";
+    }
+    constructor << "    std::shared_ptr<Layer> layer;\n";
+    if (layer_type != nullptr) {
+      constructor << "    CHECK(" << layer_type->class_name << "::GetInstance(op, layer) == "
+                  << "ParseParameterAttrStatus::kParameterAttrParseSuccess)\n"
+                  << "            << \"Create the layer: \" << op->name << \" failed\";\n"
+                  << "    impl.layer" << index << " = std::dynamic_pointer_cast<" << layer_type->class_name
+                  << ">(layer);\n"
+                  << "    CHECK(impl.layer" << index << " != nullptr);\n";
+    } else {
+      constructor << "    CHECK(LayerRegisterer::CreateLayer(op, layer) == "
+                  << "ParseParameterAttrStatus::kParameterAttrParseSuccess)\n"
+                  << "            << \"Create the layer: \" << op->name << \" failed\";\n"
+                  << "    impl.layer" << index << " = layer;\n";
+    }
+    if (detection_post_process_.enabled && op->type == "models.yolo.Detect") {
+      constructor << "    DetectionPostProcess post_process;\n"
+                  << "    post_process.enabled = true;\n"
+                  << "    post_process.conf_thresh = " << FloatLiteral(detection_post_process_.conf_thresh) << ";\n"
+                  << "    post_process.iou_thresh = " << FloatLiteral(detection_post_process_.iou_thresh) << ";\n"
+                  << "    post_process.max_detections = " << detection_post_process_.max_detections << ";\n"
+                  << "    CHECK(impl.layer" << index << "->SetDetectionPostProcess(post_process));\n";
+    }
+    constructor << "  }\n";
+
+    for (const uint32_t prev_index : topo_input_indexes_.at(i)) {
+      CHECK(!output_vars.at(prev_index).empty()) << "The input node of " << op->name << " is not generated";
+      constructor << "  impl.inputs" << index << ".insert(impl.inputs" << index << ".end(), "
+                  << output_vars.at(prev_index) << ".begin(), " << output_vars.at(prev_index) << ".end());\n";
+    }
+
+    const std::string &call = layer_type != nullptr
+        ? "impl.layer" + index + "->" + layer_type->class_name + "::Forward(impl.inputs" + index + ", impl.outputs"
+            + index + ")"
+        : "impl.layer" + index + "->Forward(impl.inputs" + index + ", impl.outputs" + index + ")";
+    std::vector<size_t> offsets;
+    const int32_t slot_index = memory_planner.TensorOffsets(i, offsets);
+    const std::vector<std::shared_ptr<Tensor<float>>> &planned_datas = memory_planner.tensors(i);
+    if (slot_index < 0) {
+      // 输出共享输入内存的节点只改变形状，输入张量的内存固定，在构造时执行一次得到的输出之后一直有效
+      CHECK(!planned_datas.empty() && planned_datas.front() == nullptr)
+              << "The output of " << op->name << " is not planned";
+      constructor << "  impl.outputs" << index << ".resize(kBatchSize);\n"
+                  << "  CheckForward(" << call << ", " << StringLiteral(op->name) << ");\n";
+      continue;
+    }
+    const std::vector<int32_t> &dims = TensorDims(output_shapes.at(i));
+    constructor << "  impl.outputs" << index << " = {";
+    for (uint32_t b = 0; b < offsets.size(); ++b) {
+      constructor << (b > 0 ? ", " : "") << "ArenaTensor(arena, " << slot_offsets.at(slot_index) + offsets.at(b)
+                  << ", " << IntValues(dims) << ")";
+    }
+    constructor << "};\n";
+    forward << "  // " << op->name << ": " << op->type << "\n"
+            << "  CheckForward(" << call << ", " << StringLiteral(op->name) << ");\n";
+  }
+  CHECK(!output_vars.at(topo_output_index_).empty());
+
+  std::ostringstream source;
+  source << "// 由KuiperInfer根据" << param_path_ << "生成，不要手动修改\n"
+         << "#include \"" << header_name << "\"\n"
+         << "#include <limits>\n#include <string>\n#include <vector>\n#include <glog/logging.h>\n"
+         << "#include \"runtime/runtime_op.hpp\"\n";
+  if (use_registry) {
+    source << "#include \"layer/abstract/layer_factory.hpp\"\n";
+  }
+  for (const std::string &layer_header : headers) {
+    source << "#include \"" << layer_header << "\"\n";
+  }
+  source << "\nnamespace kuiper_infer {\nnamespace {\n"
+         << "/// 所有中间张量和输入张量所在内存的float元素数量，生命周期不重叠的张量共享同一段内存\n"
+         << "constexpr size_t kArenaSize = " << arena_size << ";\n"
+         << "/// 所有Layer共用的临时内存的float元素数量\n"
+         << "constexpr size_t kWorkspaceSize = " << workspace_size << ";\n"
+         << "/// 输入张量在内存中的起始位置\n"
+         << "constexpr size_t kInputOffset = " << input_offset << ";\n\n";
+
+  std::ostringstream source_end;
+  source_end << "std::shared_ptr<Tensor<float>> ArenaTensor(float *arena, size_t offset, uint32_t channels, uint32_t rows,\n"
+         << "                                           uint32_t cols) {\n"
+         << "  return std::make_shared<Tensor<float>>(arena + offset, channels, rows, cols);\n}\n\n"
+         << "std::shared_ptr<RuntimeAttribute> EmbeddedAttribute(const uint32_t *data, size_t bytes, "
+         << "RuntimeDataType type,\n"
+         << "                                                    std::vector<int> shape) {\n"
+         << "  std::shared_ptr<RuntimeAttribute> attribute = std::make_shared<RuntimeAttribute>();\n"
+         << "  // 属性直接引用内嵌的权重，不复制\n"
+         << "  attribute->mapped_data = std::shared_ptr<const char>(reinterpret_cast<const char *>(data), "
+         << "[](const char *) {});\n"
+         << "  attribute->mapped_size = bytes;\n"
+         << "  attribute->type = type;\n"
+         << "  attribute->shape = std::move(shape);\n"
+         << "  return attribute;\n}\n\n"
+         << "template<typename P, typename V>\nRuntimeParameter *MakeParameter(V value) {\n"
+         << "  P *parameter = new P;\n  parameter->value = std::move(value);\n  return parameter;\n}\n\n"
+         << "void AddOperand(RuntimeOperator &op, const std::string &name, std::vector<int32_t> shapes) {\n"
+         << "  std::shared_ptr<RuntimeOperand> operand = std::make_shared<RuntimeOperand>();\n"
+         << "  operand->name = name;\n  operand->shapes = std::move(shapes);\n"
+         << "  operand->type = RuntimeDataType::kTypeFloat32;\n"
+         << "  op.input_operands.insert({name, operand});\n  op.input_operands_seq.push_back(operand);\n}\n\n"
+         << "void CheckForward(InferStatus status, const char *name) {\n"
+         << "  CHECK(status == InferStatus::kInferSuccess) << name << \" layer forward failed, error code: \" "
+         << "<< int(status);\n}\n}\n\n"
+         << "struct " << class_name << "::Impl {\n"
+         << "  alignas(64) float arena[kArenaSize];\n"
+         << "  alignas(64) float workspace[kWorkspaceSize];\n"
+         << "  std::vector<std::shared_ptr<Tensor<float>>> input;\n"
+         << members.str() << "};\n\n"
+         << class_name << "::" << class_name << "() : impl_(std::make_unique<Impl>()) {\n"
+         << "  Impl &impl = *impl_;\n  float *arena = impl.arena;\n"
+         << "  for (uint32_t b = 0; b < kBatchSize; ++b) {\n"
+         << "    impl.input.push_back(ArenaTensor(arena, kInputOffset + b * " << input_elem_size << ", "
+         << IntValues(input_dims) << "));\n  }\n"
+         << constructor.str() << "}\n\n"
+         << class_name << "::~" << class_name << "() = default;\n\n"
+         << "Tensor<float> &" << class_name << "::input(uint32_t batch) {\n"
+         << "  return *impl_->input.at(batch);\n}\n\n"
+         << "const Tensor<float> &" << class_name << "::output(uint32_t batch) const {\n"
+         << "  Impl &impl = *impl_;\n"
+         << "  return *" << output_vars.at(topo_output_index_) << ".at(batch);\n}\n\n"
+         << "void " << class_name << "::Forward() {\n"
+         << "  Impl &impl = *impl_;\n"
+         << "  Layer::WorkspaceScope workspace_scope(impl.workspace, kWorkspaceSize);\n"
+         << forward.str() << "}\n}\n";
+
+  std::ofstream header_file(header_path, std::ios::out | std::ios::trunc);
+  std::ofstream source_file(source_path, std::ios::out | std::ios::trunc);
+  if (!header_file.is_open() || !source_file.is_open()) {
+    LOG(ERROR) << "Can not open the generated source: " << header_path << " " << source_path;
+    return false;
+  }
+  header_file << header.str();
+  source_file << source.str();
+  // 权重的文本通常比权重本身大得多，直接写入文件而不是先保存在内存中
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &op = topo_operators_.at(i);
+    if (op == input_operator_ || op->type == "pnnx.Output") {
+      continue;
+    }
+    uint32_t attr_index = 0;
+    for (const auto &attr : op->attribute) {
+      source_file << "/// " << op->name << "." << attr.first << "\nalignas(64) const uint32_t kWeight" << i << "_"
+                  << attr_index++ << "[] = {";
+      WriteWeightWords(attr.second->weight_ptr(), attr.second->weight_bytes(), source_file);
+      source_file << "};\n\n";
+    }
+  }
+  source_file << source_end.str();
+  return header_file.good() && source_file.good();
+}
+}
@@ -0,0 +1,126 @@
+#include "runtime/runtime_context.hpp"
+#include <utility>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+/**
+ * 将一块连续内存按照批次划分为张量，每个张量直接使用对应位置的内存
+ * @param data 内存的起始地址
+ * @param shapes 张量的形状，第一维是batch
+ * @return 每个batch的张量
+ */
+static std::vector<std::shared_ptr<Tensor<float>>> BatchTensorViews(float *data, const std::vector<int32_t> &shapes) {
+  CHECK(data != nullptr) << "The bound memory is empty";
+  CHECK(shapes.size() == 2 || shapes.size() == 3 || shapes.size() == 4)
+          << "Unsupported shape sizes: " << shapes.size();
+  CHECK(shapes.at(0) > 0) << "The batch size of bound memory must be greater than zero";
+  size_t elem_size = 1;
+  for (uint32_t i = 1; i < shapes.size(); ++i) {
+    CHECK(shapes.at(i) > 0) << "The shape of bound memory is error";
+    elem_size *= shapes.at(i);
+  }
+
+  std::vector<std::shared_ptr<Tensor<float>>> tensors(shapes.at(0));
+  for (uint32_t i = 0; i < tensors.size(); ++i) {
+    float *raw_ptr = data + i * elem_size;
+    if (shapes.size() == 4) {
+      tensors.at(i) = std::make_shared<Tensor<float>>(raw_ptr, shapes.at(1), shapes.at(2), shapes.at(3));
+    } else if (shapes.size() == 2) {
+      tensors.at(i) = std::make_shared<Tensor<float>>(raw_ptr, 1, shapes.at(1), 1);
+    } else {
+      tensors.at(i) = std::make_shared<Tensor<float>>(raw_ptr, 1, shapes.at(1), shapes.at(2));
+    }
+  }
+  return tensors;
+}
+
+
+void ExecutionContext::set_plan_cache_size(uint32_t plan_cache_size) {
+  CHECK(plan_cache_size > 0) << "The plan cache size must be greater than zero";
+  this->plan_cache_size_ = plan_cache_size;
+  while (plans_.size() > plan_cache_size_) {
+    plans_.pop_back();
+  }
+}
+
+uint32_t ExecutionContext::plan_cache_size() const {
+  return this->plan_cache_size_;
+}
+
+uint32_t ExecutionContext::cached_plan_num() const {
+  return this->plans_.size();
+}
+
+const RuntimeMemoryPlanner &ExecutionContext::memory_planner() const {
+  CHECK(!plans_.empty()) << "The execution context has no plan yet!";
+  return this->plans_.front().memory_planner;
+}
+
+void ExecutionContext::set_profiler(std::shared_ptr<RuntimeProfiler> profiler) {
+  this->profiler_ = std::move(profiler);
+}
+
+const std::shared_ptr<RuntimeProfiler> &ExecutionContext::profiler() const {
+  return this->profiler_;
+}
+
+void ExecutionContext::set_activation_dumper(std::shared_ptr<ActivationDumper> activation_dumper) {
+  this->activation_dumper_ = std::move(activation_dumper);
+}
+
+const std::shared_ptr<ActivationDumper> &ExecutionContext::activation_dumper() const {
+  return this->activation_dumper_;
+}
+
+void ExecutionContext::set_numa_node(int32_t numa_node) {
+  CHECK(numa_node >= -1 && numa_node < int32_t(NumaNodeNum())) << "The numa node " << numa_node << " does not exist";
+  this->numa_node_ = numa_node;
+}
+
+int32_t ExecutionContext::numa_node() const {
+  return this->numa_node_;
+}
+
+void ExecutionContext::set_thread_pool(std::shared_ptr<ThreadPool> thread_pool) {
+  this->thread_pool_ = std::move(thread_pool);
+}
+
+const std::shared_ptr<ThreadPool> &ExecutionContext::thread_pool() const {
+  return this->thread_pool_;
+}
+
+void ExecutionContext::BindInputs(const std::vector<std::shared_ptr<Tensor<float>>> &inputs) {
+  for (const auto &input : inputs) {
+    CHECK(input != nullptr && !input->empty()) << "The bound input tensor is empty";
+  }
+  this->bound_inputs_ = inputs;
+}
+
+void ExecutionContext::BindInputs(float *data, const std::vector<int32_t> &shapes) {
+  this->bound_inputs_ = BatchTensorViews(data, shapes);
+}
+
+void ExecutionContext::BindOutputs(const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  for (const auto &output : outputs) {
+    CHECK(output != nullptr && !output->empty()) << "The bound output tensor is empty";
+  }
+  this->bound_outputs_ = outputs;
+}
+
+void ExecutionContext::BindOutputs(float *data, const std::vector<int32_t> &shapes) {
+  this->bound_outputs_ = BatchTensorViews(data, shapes);
+}
+
+void ExecutionContext::ClearBindings() {
+  this->bound_inputs_.clear();
+  this->bound_outputs_.clear();
+}
+
+const std::vector<std::shared_ptr<Tensor<float>>> &ExecutionContext::bound_inputs() const {
+  return this->bound_inputs_;
+}
+
+const std::vector<std::shared_ptr<Tensor<float>>> &ExecutionContext::bound_outputs() const {
+  return this->bound_outputs_;
+}
+}
@@ -0,0 +1,281 @@
+#include "runtime/runtime_dump.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+// .kdump文件的格式：文件头是magic、版本、节点第一次保存的顺序、名称长度和名称
+// 之后每次推理一条记录：张量数量，每个张量的通道数、行数、列数和按照张量内存布局排列的数据
+static constexpr char kDumpMagic[4] = {'K', 'D', 'M', 'P'};
+static constexpr uint32_t kDumpVersion = 1;
+static constexpr const char *kDumpExtension = ".kdump";
+
+/// 从文件中读取的一个节点的全部输出
+struct DumpFile {
+  std::string name;
+  uint32_t sequence = 0;
+  std::vector<std::vector<uint32_t>> record_shapes; /// 每条记录中每个张量的通道数、行数和列数
+  std::vector<std::vector<float>> record_datas; /// 每条记录中所有张量依次排列的数据
+};
+
+static bool ReadDumpFile(const std::string &path, DumpFile &dump_file) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.good()) {
+    return false;
+  }
+  char magic[4];
+  uint32_t version = 0;
+  uint32_t name_size = 0;
+  in.read(magic, 4);
+  in.read(reinterpret_cast<char *>(&version), sizeof(version));
+  in.read(reinterpret_cast<char *>(&dump_file.sequence), sizeof(dump_file.sequence));
+  in.read(reinterpret_cast<char *>(&name_size), sizeof(name_size));
+  if (!in.good() || memcmp(magic, kDumpMagic, 4) != 0 || version != kDumpVersion) {
+    LOG(ERROR) << "Not an activation dump file: " << path;
+    return false;
+  }
+  dump_file.name.resize(name_size);
+  in.read(dump_file.name.data(), name_size);
+
+  uint32_t tensor_num = 0;
+  while (in.read(reinterpret_cast<char *>(&tensor_num), sizeof(tensor_num))) {
+    std::vector<uint32_t> shapes(size_t(tensor_num) * 3);
+    std::vector<float> data;
+    for (uint32_t i = 0; i < tensor_num; ++i) {
+      in.read(reinterpret_cast<char *>(shapes.data() + i * 3), sizeof(uint32_t) * 3);
+      const size_t size = size_t(shapes.at(i * 3)) * shapes.at(i * 3 + 1) * shapes.at(i * 3 + 2);
+      const size_t offset = data.size();
+      data.resize(offset + size);
+      in.read(reinterpret_cast<char *>(data.data() + offset), size * sizeof(float));
+    }
+    if (!in.good()) {
+      LOG(ERROR) << "The activation dump file is truncated: " << path;
+      return false;
+    }
+    dump_file.record_shapes.push_back(std::move(shapes));
+    dump_file.record_datas.push_back(std::move(data));
+  }
+  return true;
+}
+
+ActivationDumper::ActivationDumper(std::string directory, const std::vector<std::string> &operator_names,
+                                   size_t max_pending_bytes)
+    : directory_(std::move(directory)), operator_names_(operator_names.begin(), operator_names.end()),
+      max_pending_bytes_(max_pending_bytes) {
+  writer_ = std::thread([this]() { WriteLoop(); });
+}
+
+ActivationDumper::~ActivationDumper() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cond_.notify_all();
+  writer_.join();
+  for (const auto &[name, file] : files_) {
+    fclose(file);
+  }
+}
+
+bool ActivationDumper::Selected(const std::string &name) const {
+  return operator_names_.empty() || operator_names_.find(name) != operator_names_.end();
+}
+
+void ActivationDumper::Dump(const std::string &name, const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+  DumpRecord record;
+  record.name = name;
+  size_t total_size = 0;
+  for (const auto &output : outputs) {
+    CHECK(output != nullptr) << "The dumped output of " << name << " is empty";
+    total_size += output->size();
+  }
+  // 规划的张量会被后面的节点复用，必须在推理线程中复制
+  record.data.resize(total_size);
+  float *data = record.data.data();
+  for (const auto &output : outputs) {
+    record.shapes.insert(record.shapes.end(), {output->channels(), output->rows(), output->cols()});
+    std::memcpy(data, output->data().memptr(), output->size() * sizeof(float));
+    data += output->size();
+  }
+
+  const size_t bytes = total_size * sizeof(float);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [&]() { return pending_bytes_ == 0 || pending_bytes_ + bytes <= max_pending_bytes_; });
+    const auto &sequence = sequences_.insert({name, next_sequence_});
+    if (sequence.second) {
+      next_sequence_ += 1;
+    }
+    record.sequence = sequence.first->second;
+    pending_bytes_ += bytes;
+    queue_.push_back(std::move(record));
+  }
+  queue_cond_.notify_one();
+}
+
+bool ActivationDumper::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [&]() { return pending_bytes_ == 0 && queue_.empty(); });
+  return !failed_;
+}
+
+const std::string &ActivationDumper::directory() const {
+  return directory_;
+}
+
+std::string ActivationDumper::DumpPath(const std::string &directory, const std::string &name) {
+  std::string file_name = name;
+  for (char &c : file_name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.') {
+      c = '_';
+    }
+  }
+  return (std::filesystem::path(directory) / (file_name + kDumpExtension)).string();
+}
+
+void ActivationDumper::WriteLoop() {
+  while (true) {
+    DumpRecord record;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_cond_.wait(lock, [&]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      record = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    bool success = true;
+    FILE *&file = files_[record.name];
+    if (file == nullptr) {
+      const std::string &path = DumpPath(directory_, record.name);
+      file = fopen(path.c_str(), "wb");
+      if (file == nullptr) {
+        LOG(ERROR) << "Can not open the activation dump file: " << path;
+        success = false;
+      } else {
+        const uint32_t name_size = record.name.size();
+        success = fwrite(kDumpMagic, 1, 4, file) == 4 && fwrite(&kDumpVersion, sizeof(uint32_t), 1, file) == 1 &&
+            fwrite(&record.sequence, sizeof(uint32_t), 1, file) == 1 &&
+            fwrite(&name_size, sizeof(uint32_t), 1, file) == 1 &&
+            fwrite(record.name.data(), 1, name_size, file) == name_size;
+      }
+    }
+    if (file != nullptr && success) {
+      const uint32_t tensor_num = record.shapes.size() / 3;
+      success = fwrite(&tensor_num, sizeof(uint32_t), 1, file) == 1;
+      const float *data = record.data.data();
+      for (uint32_t i = 0; i < tensor_num && success; ++i) {
+        const uint32_t *shape = record.shapes.data() + i * 3;
+        const size_t size = size_t(shape[0]) * shape[1] * shape[2];
+        success = fwrite(shape, sizeof(uint32_t), 3, file) == 3 && fwrite(data, sizeof(float), size, file) == size;
+        data += size;
+      }
+      success = success && fflush(file) == 0;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_bytes_ -= record.data.size() * sizeof(float);
+      failed_ = failed_ || !success;
+    }
+    done_cond_.notify_all();
+  }
+}
+
+std::vector<ActivationDiff> ActivationDumper::Compare(const std::string &reference_directory,
+                                                      const std::string &directory) {
+  std::vector<std::pair<uint32_t, ActivationDiff>> diffs;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+    if (entry.path().extension() != kDumpExtension) {
+      continue;
+    }
+    DumpFile dump_file;
+    if (!ReadDumpFile(entry.path().string(), dump_file)) {
+      continue;
+    }
+    DumpFile reference_file;
+    if (!ReadDumpFile(DumpPath(reference_directory, dump_file.name), reference_file)) {
+      continue;
+    }
+
+    ActivationDiff diff;
+    diff.name = dump_file.name;
+    const size_t record_num = std::min(dump_file.record_datas.size(), reference_file.record_datas.size());
+    diff.shape_matched = dump_file.record_datas.size() == reference_file.record_datas.size();
+    double abs_sum = 0.;
+    double square_sum = 0.;
+    double dot = 0.;
+    double norm = 0.;
+    double reference_norm = 0.;
+    for (size_t r = 0; r < record_num; ++r) {
+      if (dump_file.record_shapes.at(r) != reference_file.record_shapes.at(r)) {
+        diff.shape_matched = false;
+        continue;
+      }
+      const std::vector<float> &data = dump_file.record_datas.at(r);
+      const std::vector<float> &reference_data = reference_file.record_datas.at(r);
+      for (size_t i = 0; i < data.size(); ++i) {
+        const double value = data.at(i);
+        const double reference = reference_data.at(i);
+        const double abs_error = std::fabs(value - reference);
+        diff.max_abs_error = std::max(diff.max_abs_error, abs_error);
+        diff.max_rel_error = std::max(diff.max_rel_error, abs_error / std::max(std::fabs(reference), 1e-6));
+        abs_sum += abs_error;
+        square_sum += abs_error * abs_error;
+        dot += value * reference;
+        norm += value * value;
+        reference_norm += reference * reference;
+      }
+      diff.records += 1;
+      diff.elements += data.size();
+    }
+    if (diff.elements > 0) {
+      diff.mean_abs_error = abs_sum / double(diff.elements);
+      diff.rmse = std::sqrt(square_sum / double(diff.elements));
+    }
+    if (norm > 0. && reference_norm > 0.) {
+      diff.cosine_similarity = dot / std::sqrt(norm * reference_norm);
+    } else if (norm != reference_norm) {
+      diff.cosine_similarity = 0.;
+    }
+    diffs.emplace_back(dump_file.sequence, std::move(diff));
+  }
+  std::sort(diffs.begin(), diffs.end(), [](const auto &a, const auto &b) {
+    return a.first < b.first;
+  });
+
+  std::vector<ActivationDiff> results;
+  for (auto &diff : diffs) {
+    results.push_back(std::move(diff.second));
+  }
+  return results;
+}
+
+std::string ActivationDumper::CompareReport(const std::vector<ActivationDiff> &diffs) {
+  std::ostringstream table;
+  table << std::left << std::setw(32) << "Name" << std::right << std::setw(12) << "Elements" << std::setw(14)
+        << "MaxAbs" << std::setw(14) << "MeanAbs" << std::setw(14) << "RMSE" << std::setw(14) << "MaxRel"
+        << std::setw(12) << "Cosine" << "\n";
+  for (const ActivationDiff &diff : diffs) {
+    table << std::left << std::setw(32) << diff.name << std::right << std::setw(12) << diff.elements
+          << std::scientific << std::setprecision(3) << std::setw(14) << diff.max_abs_error << std::setw(14)
+          << diff.mean_abs_error << std::setw(14) << diff.rmse << std::setw(14) << diff.max_rel_error << std::fixed
+          << std::setprecision(6) << std::setw(12) << diff.cosine_similarity;
+    if (!diff.shape_matched) {
+      table << "  shape mismatch";
+    }
+    table << "\n";
+  }
+  return table.str();
+}
+}
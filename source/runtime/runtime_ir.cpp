@@ -4,123 +4,91 @@
 #include <iostream>
 #include <iomanip>
 #include <queue>
-#include <deque>
+#include <set>
+#include <unordered_map>
 #include <utility>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <functional>
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/lazy_layer.hpp"
 #include "tick.hpp"
+#include "runtime/thread_pool.hpp"
+#include "runtime/cpu_feature.hpp"
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 namespace kuiper_infer {
 
-void RuntimeGraphShape::InitOperatorInputTensor(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
-  if (operators.empty()) {
-    LOG(ERROR) << "Operators for init input shapes is empty!";
-    return;
-  }
-  for (const auto &op : operators) {
-    if (op->input_operands.empty()) {
-      continue;
-    } else {
-      const std::map<std::string, std::shared_ptr<RuntimeOperand>> &input_operands_map = op->input_operands;
-      for (const auto &input_operand_iter : input_operands_map) {
-        const auto &input_operand = input_operand_iter.second;
-        const auto &type = input_operand->type;
-        CHECK(type == RuntimeDataType::kTypeFloat32) << "The graph only support float32 yet!";
-        const auto &shapes = input_operand->shapes;
-        auto &input_datas = input_operand->datas;
-
-        const int32_t batch = shapes.at(0);
-        CHECK(batch >= 0) << "Dynamic batch size is not supported!";
-        CHECK(shapes.size() == 2 || shapes.size() == 4 || shapes.size() == 3)
-                << "Unsupported shape sizes: " << shapes.size();
-
-        if (!input_datas.empty()) {
-          CHECK(input_datas.size() == batch) << "Batch size is wrong!";
-          for (int32_t i = 0; i < batch; ++i) {
-            const std::vector<uint32_t> &origin_shape = input_datas.at(i)->shapes();
-            const std::vector<int32_t> &current_shape = shapes;
-            if (current_shape.size() == 4) {
-              CHECK(origin_shape.at(0) == current_shape.at(1) &&
-                  origin_shape.at(1) == current_shape.at(2) && origin_shape.at(2) == current_shape.at(3));
-            } else if (current_shape.size() == 2) {
-              CHECK(origin_shape.at(1) == current_shape.at(1) && origin_shape.at(0) == 1 && origin_shape.at(2) == 1);
-            } else {
-              CHECK(origin_shape.at(1) == current_shape.at(1) && origin_shape.at(0) == 1
-                        && origin_shape.at(2) == current_shape.at(2));
-            }
-          }
-        } else {
-          input_datas.resize(batch);
-          for (int32_t i = 0; i < batch; ++i) {
-            if (shapes.size() == 4) {
-              input_datas.at(i) = std::make_shared<Tensor<float>>(shapes.at(1), shapes.at(2), shapes.at(3));
-            } else if (shapes.size() == 2) {
-              input_datas.at(i) = std::make_shared<Tensor<float>>(1, shapes.at(1), 1);
-            } else {
-              input_datas.at(i) = std::make_shared<Tensor<float>>(1, shapes.at(1), shapes.at(2));
-            }
-          }
-        }
-      }
-    }
-  }
-}
-
 void RuntimeGraphShape::InitOperatorOutputTensor(const std::vector<pnnx::Operator *> &pnnx_operators,
                                                  const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
 
   CHECK(!pnnx_operators.empty() && !operators.empty());
-  CHECK(pnnx_operators.size() == operators.size());
+  // 图优化会删除一部分计算节点，所以按照名称而不是位置对应pnnx节点和计算节点
+  std::unordered_map<std::string, std::shared_ptr<RuntimeOperator>> operators_maps;
+  operators_maps.reserve(operators.size());
+  for (const auto &runtime_op : operators) {
+    operators_maps.insert({runtime_op->name, runtime_op});
+  }
   for (uint32_t i = 0; i < pnnx_operators.size(); ++i) {
+    const auto &runtime_op_iter = operators_maps.find(pnnx_operators.at(i)->name);
+    if (runtime_op_iter == operators_maps.end()) {
+      continue;
+    }
     const std::vector<pnnx::Operand *> operands = pnnx_operators.at(i)->outputs;
     CHECK(operands.size() <= 1) << "Only support one node one output yet!";
     if (operands.empty()) {
       continue;
     }
     pnnx::Operand *operand = operands.front();
-    const auto &runtime_op = operators.at(i);
+    const auto &runtime_op = runtime_op_iter->second;
     CHECK(operand != nullptr) << "Operand output is null";
     const std::vector<int32_t> &shapes = operand->shape;
     const auto &output_tensors = runtime_op->output_operands;
 
     const int32_t batch = shapes.at(0);
-    CHECK(batch >= 0) << "Dynamic batch size is not supported!";
+    CHECK(batch >= 0) << "Dynamic batch size needs a max batch size, please call set_max_batch_size!";
     CHECK(shapes.size() == 2 || shapes.size() == 4 || shapes.size() == 3)
             << "Unsupported shape sizes: " << shapes.size();
 
+    // 中间张量由执行上下文按照内存规划创建，操作数中只记录形状
     if (!output_tensors) {
       std::shared_ptr<RuntimeOperand> output_operand = std::make_shared<RuntimeOperand>();
       output_operand->shapes = shapes;
       output_operand->type = RuntimeDataType::kTypeFloat32;
       output_operand->name = operand->name + "_output";
-      for (int j = 0; j < batch; ++j) {
-        if (shapes.size() == 4) {
-          output_operand->datas.push_back(
-              std::make_shared<Tensor<float >>(shapes.at(1), shapes.at(2), shapes.at(3)));
-        } else if (shapes.size() == 2) {
-          output_operand->datas.push_back(std::make_shared<Tensor<float >>(1, shapes.at(1), 1));
-        } else {
-          output_operand->datas.push_back(std::make_shared<Tensor<float >>(1, shapes.at(1), shapes.at(2)));
-        }
-      }
       runtime_op->output_operands = output_operand;
     } else {
-      CHECK(batch == output_tensors->datas.size());
-      //output_tensors empty
-      const auto &output_tensors_datas = output_tensors->datas;
       CHECK(output_tensors->type == RuntimeDataType::kTypeFloat32);
       CHECK(output_tensors->shapes == shapes);
-      for (const auto &output_tensors_data : output_tensors_datas) {
-        const auto &tensor_shapes = output_tensors->shapes;
-        if (shapes.size() == 4) {
-          CHECK(tensor_shapes.at(1) == shapes.at(1)
-                    && tensor_shapes.at(2) == shapes.at(2) && tensor_shapes.at(3) == shapes.at(3));
-        } else if (shapes.size() == 2) {
-          CHECK(tensor_shapes.at(0) == 1 && tensor_shapes.at(1) == shapes.at(1) && tensor_shapes.at(2) == 1);
-        } else {
-          CHECK(tensor_shapes.at(0) == 1 && tensor_shapes.at(1) == shapes.at(1) && tensor_shapes.at(2) == shapes.at(2));
-        }
+    }
+  }
+}
+
+void RuntimeGraphShape::InitOperatorBatchSize(const std::vector<pnnx::Operand *> &pnnx_operands,
+                                              const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                              uint32_t max_batch_size) {
+  CHECK(max_batch_size > 0) << "The max batch size must be greater than zero";
+  for (pnnx::Operand *operand : pnnx_operands) {
+    if (operand != nullptr && !operand->shape.empty()) {
+      operand->shape.front() = int32_t(max_batch_size);
+    }
+  }
+
+  for (const auto &op : operators) {
+    for (const auto &input_operand : op->input_operands_seq) {
+      if (!input_operand->shapes.empty()) {
+        input_operand->shapes.front() = int32_t(max_batch_size);
       }
     }
+    const auto &output_operand = op->output_operands;
+    if (output_operand != nullptr && !output_operand->shapes.empty()) {
+      output_operand->shapes.front() = int32_t(max_batch_size);
+    }
   }
 }
 
@@ -145,6 +113,314 @@ const std::string &RuntimeGraph::bin_path() const {
   return this->bin_path_;
 }
 
+void RuntimeGraph::set_parallel_execute(bool parallel_execute) {
+  if (graph_state_ == GraphState::Complete && parallel_execute != parallel_execute_) {
+    graph_state_ = GraphState::NeedBuild;
+  }
+  this->parallel_execute_ = parallel_execute;
+}
+
+bool RuntimeGraph::parallel_execute() const {
+  return this->parallel_execute_;
+}
+
+void RuntimeGraph::set_micro_batch(uint32_t micro_batch_size, size_t cache_bytes) {
+  if (graph_state_ == GraphState::Complete
+      && (micro_batch_size != micro_batch_size_ || cache_bytes != micro_batch_cache_bytes_)) {
+    graph_state_ = GraphState::NeedBuild;
+  }
+  this->micro_batch_size_ = micro_batch_size;
+  this->micro_batch_cache_bytes_ = cache_bytes;
+}
+
+uint32_t RuntimeGraph::micro_batch_size() const {
+  return this->micro_batch_size_;
+}
+
+void RuntimeGraph::set_max_batch_size(uint32_t max_batch_size) {
+  // 操作数的形状在初始化时确定，修改之后需要重新初始化
+  if (graph_state_ != GraphState::NeedInit && max_batch_size != max_batch_size_) {
+    graph_state_ = GraphState::NeedInit;
+  }
+  this->max_batch_size_ = max_batch_size;
+}
+
+uint32_t RuntimeGraph::max_batch_size() const {
+  return this->max_batch_size_;
+}
+
+uint32_t RuntimeGraph::batch_size() const {
+  CHECK(graph_state_ == GraphState::Complete && input_operator_ != nullptr) << "Graph need be build!";
+  return input_operator_->output_operands->shapes.at(0);
+}
+
+void RuntimeGraph::set_compact(bool compact) {
+  this->compact_ = compact;
+}
+
+bool RuntimeGraph::compact() const {
+  return this->compact_;
+}
+
+size_t RuntimeGraph::reclaimed_bytes() const {
+  return this->reclaimed_bytes_;
+}
+
+void RuntimeGraph::set_lazy_weights(bool lazy_weights) {
+  this->lazy_weights_ = lazy_weights;
+}
+
+bool RuntimeGraph::lazy_weights() const {
+  return this->lazy_weights_;
+}
+
+uint32_t RuntimeGraph::lazy_layer_num() const {
+  return lazy_layer_num_ != nullptr ? lazy_layer_num_->load() : 0;
+}
+
+void RuntimeGraph::set_cache_path(const std::string &cache_path) {
+  this->cache_path_ = cache_path;
+}
+
+const std::string &RuntimeGraph::cache_path() const {
+  return this->cache_path_;
+}
+
+void RuntimeGraph::set_auto_tune(bool auto_tune) {
+  this->auto_tune_ = auto_tune;
+}
+
+bool RuntimeGraph::auto_tune() const {
+  return this->auto_tune_;
+}
+
+void RuntimeGraph::set_detection_post_process(const DetectionPostProcess &post_process) {
+  CHECK(!post_process.enabled || post_process.max_detections > 0)
+          << "The max detections of post process must be greater than zero";
+  this->detection_post_process_ = post_process;
+}
+
+const DetectionPostProcess &RuntimeGraph::detection_post_process() const {
+  return this->detection_post_process_;
+}
+
+void RuntimeGraph::set_device(DeviceType device) {
+  this->device_ = device;
+}
+
+DeviceType RuntimeGraph::device() const {
+  return this->device_;
+}
+
+void RuntimeGraph::set_shared_params_path(const std::string &shared_params_path) {
+  this->shared_params_path_ = shared_params_path;
+}
+
+const std::string &RuntimeGraph::shared_params_path() const {
+  return this->shared_params_path_;
+}
+
+const std::shared_ptr<SharedParams> &RuntimeGraph::shared_params() const {
+  return this->shared_params_;
+}
+
+void RuntimeGraph::set_tuning_cache_path(const std::string &tuning_cache_path) {
+  this->tuning_cache_path_ = tuning_cache_path;
+}
+
+const std::string &RuntimeGraph::tuning_cache_path() const {
+  return this->tuning_cache_path_;
+}
+
+GraphPassManager &RuntimeGraph::pass_manager() {
+  return this->pass_manager_;
+}
+
+void RuntimeGraph::set_plan_cache_size(uint32_t plan_cache_size) {
+  CHECK(plan_cache_size > 0) << "The plan cache size must be greater than zero";
+  this->plan_cache_size_ = plan_cache_size;
+  if (default_context_ != nullptr) {
+    default_context_->set_plan_cache_size(plan_cache_size);
+  }
+}
+
+void RuntimeGraph::set_thread_budget(uint32_t thread_num, const std::vector<uint32_t> &cpus) {
+  if (thread_num == 0) {
+    this->thread_pool_.reset();
+  } else if (thread_pool_ == nullptr) {
+    this->thread_pool_ = std::make_shared<ThreadPool>(thread_num, cpus);
+  } else {
+    thread_pool_->set_thread_num(thread_num);
+    thread_pool_->set_cpu_affinity(cpus);
+  }
+}
+
+const std::shared_ptr<ThreadPool> &RuntimeGraph::thread_pool() const {
+  return this->thread_pool_;
+}
+
+void RuntimeGraph::set_replicas(uint32_t replica_num, const std::vector<uint32_t> &cpus) {
+  this->replica_num_ = replica_num;
+  this->replica_cpus_ = cpus;
+}
+
+uint32_t RuntimeGraph::replica_num() const {
+  return this->replica_num_;
+}
+
+ThreadPool *RuntimeGraph::ContextThreadPool(const ExecutionContext &context) const {
+  return context.thread_pool_ != nullptr ? context.thread_pool_.get() : thread_pool_.get();
+}
+
+void RuntimeGraph::set_weight_placement(NumaMemoryPolicy policy, uint32_t node) {
+  CHECK(node < NumaNodeNum()) << "The numa node " << node << " does not exist";
+  this->weight_policy_ = policy;
+  this->weight_node_ = node;
+  if (graph_state_ == GraphState::Complete) {
+    PlaceWeights();
+  }
+}
+
+NumaMemoryPolicy RuntimeGraph::weight_policy() const {
+  return this->weight_policy_;
+}
+
+uint32_t RuntimeGraph::plan_cache_size() const {
+  return this->plan_cache_size_;
+}
+
+uint32_t RuntimeGraph::cached_plan_num() const {
+  return default_context_ != nullptr ? default_context_->cached_plan_num() : 0;
+}
+
+const RuntimeMemoryPlanner &RuntimeGraph::memory_planner() const {
+  CHECK(default_context_ != nullptr) << "Graph need be build!";
+  return default_context_->memory_planner();
+}
+
+RuntimeMemoryReport RuntimeGraph::MemoryReport(const std::shared_ptr<ExecutionContext> &context) const {
+  const ExecutionContext *current_context = context != nullptr ? context.get() : default_context_.get();
+  CHECK(current_context != nullptr) << "Graph need be build!";
+  const RuntimeMemoryPlanner &memory_planner = current_context->memory_planner();
+
+  RuntimeMemoryReport report;
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op->layer == nullptr) {
+      continue;
+    }
+    OperatorMemory op_memory;
+    op_memory.name = current_op->name;
+    op_memory.type = current_op->type;
+    for (const auto &tensor : memory_planner.tensors(i)) {
+      if (tensor != nullptr) {
+        op_memory.activation_bytes += tensor->size() * sizeof(float);
+      }
+    }
+    op_memory.weight_bytes = current_op->layer->ParamBytes();
+    op_memory.scratch_bytes = memory_planner.workspace(i).workspace_size * sizeof(float);
+    report.weight_bytes += op_memory.weight_bytes;
+    report.operators.push_back(std::move(op_memory));
+  }
+  report.activation_bytes = memory_planner.planned_bytes();
+  report.scratch_bytes = memory_planner.workspace_bytes();
+  report.current_bytes = MemoryTracker::GetInstance().current_bytes();
+  report.peak_bytes = MemoryTracker::GetInstance().peak_bytes();
+  return report;
+}
+
+void RuntimeGraph::set_profiler(std::shared_ptr<RuntimeProfiler> profiler) {
+  this->profiler_ = std::move(profiler);
+  if (default_context_ != nullptr) {
+    default_context_->set_profiler(profiler_);
+  }
+}
+
+const std::shared_ptr<RuntimeProfiler> &RuntimeGraph::profiler() const {
+  return this->profiler_;
+}
+
+void RuntimeGraph::set_metrics(std::shared_ptr<RuntimeMetrics> metrics, const std::string &graph_label) {
+  this->metrics_ = std::move(metrics);
+  this->metrics_label_ = graph_label;
+  BindMetrics();
+}
+
+const std::shared_ptr<RuntimeMetrics> &RuntimeGraph::metrics() const {
+  return this->metrics_;
+}
+
+void RuntimeGraph::BindMetrics() {
+  graph_metrics_ = GraphMetrics();
+  if (metrics_ == nullptr) {
+    return;
+  }
+  const MetricLabels labels{{"graph", metrics_label_.empty() ? param_path_ : metrics_label_}};
+  graph_metrics_.forward_num = &metrics_->Counter("kuiper_graph_forward_total", "Number of graph forward calls",
+                                                  labels);
+  graph_metrics_.sample_num = &metrics_->Counter("kuiper_graph_samples_total",
+                                                 "Number of samples in all graph forward calls", labels);
+  graph_metrics_.forward_latency = &metrics_->Histogram("kuiper_graph_forward_duration_seconds",
+                                                        "Latency of graph forward calls", labels);
+  graph_metrics_.weight_bytes = &metrics_->Gauge("kuiper_graph_weight_bytes", "Bytes of weights in created layers",
+                                                 labels);
+  graph_metrics_.activation_bytes = &metrics_->Gauge("kuiper_graph_activation_bytes",
+                                                     "Planned activation bytes of the latest execution plan", labels);
+  graph_metrics_.workspace_bytes = &metrics_->Gauge("kuiper_graph_workspace_bytes",
+                                                    "Workspace bytes of the latest execution plan", labels);
+
+  // 同一类型的节点共用一个直方图，推理时按照执行序列中的位置直接取得
+  size_t weight_bytes = 0;
+  graph_metrics_.operator_latencies.assign(topo_operators_.size(), nullptr);
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op == input_operator_ || current_op->type == "pnnx.Output") {
+      continue;
+    }
+    MetricLabels op_labels = labels;
+    op_labels["type"] = current_op->type;
+    graph_metrics_.operator_latencies.at(i) = &metrics_->Histogram("kuiper_operator_duration_seconds",
+                                                                   "Latency of operators by type", op_labels);
+    if (current_op->layer != nullptr) {
+      weight_bytes += current_op->layer->ParamBytes();
+    }
+  }
+  graph_metrics_.weight_bytes->Set(int64_t(weight_bytes));
+}
+
+void RuntimeGraph::RecordForward(const ExecutionContext &context, uint32_t batch_size,
+                                 std::chrono::steady_clock::time_point start) const {
+  if (graph_metrics_.forward_num == nullptr) {
+    return;
+  }
+  const auto &duration = std::chrono::steady_clock::now() - start;
+  graph_metrics_.forward_num->Add();
+  graph_metrics_.sample_num->Add(batch_size);
+  graph_metrics_.forward_latency->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+  for (uint32_t i = 0; i < graph_metrics_.operator_latencies.size(); ++i) {
+    LatencyHistogram *operator_latency = graph_metrics_.operator_latencies.at(i);
+    if (operator_latency == nullptr || (!context.active_ops_.empty() && !context.active_ops_.at(i))) {
+      continue;
+    }
+    operator_latency->Record(uint64_t(context.run_durations_.at(i) * 1e9));
+  }
+}
+
+void RuntimeGraph::set_activation_dumper(std::shared_ptr<ActivationDumper> activation_dumper) {
+  this->activation_dumper_ = std::move(activation_dumper);
+  if (default_context_ != nullptr) {
+    default_context_->set_activation_dumper(activation_dumper_);
+  }
+}
+
+const std::shared_ptr<ActivationDumper> &RuntimeGraph::activation_dumper() const {
+  return this->activation_dumper_;
+}
+
+const std::vector<std::shared_ptr<RuntimeOperator>> &RuntimeGraph::operators() const {
+  return this->operators_;
+}
+
 bool RuntimeGraph::Init() {
   if (this->bin_path_.empty() || this->param_path_.empty()) {
     LOG(ERROR) << "The bin path or param path is empty";
@@ -203,26 +479,47 @@ bool RuntimeGraph::Init() {
   }
 
   // 构建图关系
-  for (const auto &current_op : this->operators_) {
-    const std::vector<std::string> &output_names = current_op->output_names;
-    for (const auto &next_op : this->operators_) {
-      if (next_op == current_op) {
-        continue;
-      }
-      if (std::find(output_names.begin(), output_names.end(), next_op->name) != output_names.end()) {
-        current_op->output_operators.insert({next_op->name, next_op});
-      }
-    }
-  }
+  InitOperatorEdges(this->operators_);
 
+  build_data_released_ = false;
   graph_state_ = GraphState::NeedBuild;
   return true;
 }
 
 void RuntimeGraph::Build(const std::string &input_name, const std::string &output_name) {
-  if (graph_state_ == GraphState::NeedInit) {
-    bool init_graph = Init();
-    LOG_IF(FATAL, !init_graph) << "Init graph failed!";
+  Build(input_name, std::vector<std::string>{output_name});
+}
+
+void RuntimeGraph::Build(const std::string &input_name, const std::vector<std::string> &output_names) {
+  CHECK(!output_names.empty()) << "The output names of graph is empty";
+  // 执行序列重新生成之前不记录节点的指标
+  graph_metrics_ = GraphMetrics();
+  // compact模式下pnnx图和权重属性已经释放，再次Build时需要重新加载模型文件
+  bool from_cache = false;
+  bool from_model = false;
+  if (graph_state_ == GraphState::NeedInit || build_data_released_) {
+    if (!cache_path_.empty()) {
+      from_cache = InitFromCache(cache_path_);
+      LOG_IF(INFO, from_cache) << "Init graph from the cache: " << cache_path_;
+    }
+    if (!from_cache) {
+      bool init_graph = Init();
+      LOG_IF(FATAL, !init_graph) << "Init graph failed!";
+      from_model = true;
+    }
+  }
+  // 图优化删除了到达不了输出节点的节点，使用其他的输入或者输出节点时重新加载模型
+  if (!from_model && (input_name != input_name_ || output_names != output_names_)) {
+    const auto &has_operator = [&](const std::string &name) {
+      return std::any_of(operators_.begin(), operators_.end(),
+                         [&](const std::shared_ptr<RuntimeOperator> &op) { return op->name == name; });
+    };
+    if (!has_operator(input_name) || !std::all_of(output_names.begin(), output_names.end(), has_operator)) {
+      bool init_graph = Init();
+      LOG_IF(FATAL, !init_graph) << "Init graph failed!";
+      from_model = true;
+      from_cache = false;
+    }
   }
 
   CHECK(graph_state_ >= GraphState::NeedBuild) << "Graph status error, current state is " << int(graph_state_);
@@ -230,25 +527,318 @@ void RuntimeGraph::Build(const std::string &input_name, const std::string &outpu
 
   this->input_operators_maps_.clear();
   this->output_operators_maps_.clear();
+  // 操作数的批次维度在初始化时来自模型，重新初始化之后按照最大批次大小修改
+  if (max_batch_size_ > 0 && (from_model || from_cache)) {
+    RuntimeGraphShape::InitOperatorBatchSize(graph_ ? graph_->operands : std::vector<pnnx::Operand *>(),
+                                             this->operators_, max_batch_size_);
+  }
+
+  // 在创建Layer之前执行图优化，删除无用的节点并合并算子，合并后的权重保存在节点的属性中
+  const uint32_t changed_num = pass_manager_.Run(this->operators_, {input_name, output_names});
+  LOG(INFO) << "Graph passes changed " << changed_num << " operators";
 
+  std::vector<std::shared_ptr<RuntimeOperator>> layer_operators;
   for (const auto &kOperator : this->operators_) {
     if (kOperator->type == "pnnx.Input") {
       this->input_operators_maps_.insert({kOperator->name, kOperator});
     } else if (kOperator->type == "pnnx.Output") {
       this->output_operators_maps_.insert({kOperator->name, kOperator});
     } else {
-      std::shared_ptr<Layer> layer = RuntimeGraph::CreateLayer(kOperator);
-      CHECK(layer != nullptr) << "Layer create failed!";
-      if (layer) {
-        kOperator->layer = layer;
+      layer_operators.push_back(kOperator);
+    }
+  }
+  CreateLayers(layer_operators);
+  if (detection_post_process_.enabled) {
+    uint32_t post_process_num = 0;
+    for (const auto &layer_operator : layer_operators) {
+      if (layer_operator->layer->SetDetectionPostProcess(detection_post_process_)) {
+        post_process_num += 1;
+      }
+    }
+    LOG_IF(WARNING, post_process_num == 0) << "No layer supports the detection post process";
+  }
+  // 从缓存加载时输出操作数已经按照缓存中的形状创建
+  if (graph_ != nullptr) {
+    RuntimeGraphShape::InitOperatorOutputTensor(graph_->ops, this->operators_);
+  }
+
+  if (input_operators_maps_.find(input_name) == input_operators_maps_.end()) {
+    LOG(FATAL) << "Can not find the input node: " << input_name;
+  }
+  std::vector<std::shared_ptr<RuntimeOperator>> output_ops;
+  for (const auto &output_name : output_names) {
+    if (output_operators_maps_.find(output_name) == output_operators_maps_.end()) {
+      LOG(FATAL) << "Can not find the output node: " << output_name;
+    }
+    const std::shared_ptr<RuntimeOperator> &output_op = output_operators_maps_.at(output_name);
+    CHECK(output_op->input_operands.size() == 1) << "The output node " << output_name << " must have one input";
+    CHECK(std::find(output_ops.begin(), output_ops.end(), output_op) == output_ops.end())
+            << "The output node " << output_name << " is duplicated";
+    output_ops.push_back(output_op);
+  }
+  input_operator_ = input_operators_maps_.at(input_name);
+  output_operator_ = output_ops.front();
+
+  topo_operators_ = TopoSortOperators(input_operator_, output_ops);
+
+  topo_successors_.assign(topo_operators_.size(), {});
+  topo_in_degrees_.assign(topo_operators_.size(), 0);
+  topo_input_indexes_.assign(topo_operators_.size(), {});
+  std::map<std::string, uint32_t> topo_indexes;
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    topo_indexes.insert({topo_operators_.at(i)->name, i});
+  }
+  // 输入操作数的名称就是来源节点的名称，执行时按照位置从上下文中读取来源节点的输出
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op == input_operator_) {
+      continue;
+    }
+    for (const auto &input_operand : current_op->input_operands_seq) {
+      const auto &input_index = topo_indexes.find(input_operand->name);
+      CHECK(input_index != topo_indexes.end())
+              << "Can not find the input node: " << input_operand->name << " of " << current_op->name;
+      topo_input_indexes_.at(i).push_back(input_index->second);
+    }
+  }
+  // 每个输出的祖先节点在执行序列中都在它之前，倒序遍历一次就能标记出来
+  topo_output_indexes_.clear();
+  topo_output_ancestors_.clear();
+  for (const auto &output_op : output_ops) {
+    const uint32_t output_op_index = topo_indexes.at(output_op->name);
+    topo_output_indexes_.push_back(topo_input_indexes_.at(output_op_index).front());
+    std::vector<bool> ancestors(topo_operators_.size(), false);
+    ancestors.at(output_op_index) = true;
+    for (uint32_t i = output_op_index + 1; i-- > 0;) {
+      if (ancestors.at(i)) {
+        for (const uint32_t input_index : topo_input_indexes_.at(i)) {
+          ancestors.at(input_index) = true;
+        }
+      }
+    }
+    topo_output_ancestors_.push_back(std::move(ancestors));
+  }
+  topo_output_index_ = topo_output_indexes_.front();
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    for (const auto &next_op : topo_operators_.at(i)->output_operators) {
+      const auto &next_index = topo_indexes.find(next_op.first);
+      if (next_index != topo_indexes.end()
+          && next_op.second->input_operands.find(topo_operators_.at(i)->name) != next_op.second->input_operands.end()) {
+        topo_successors_.at(i).push_back(next_index->second);
+        topo_in_degrees_.at(next_index->second) += 1;
       }
     }
   }
-  RuntimeGraphShape::InitOperatorInputTensor(this->operators_);
-  RuntimeGraphShape::InitOperatorOutputTensor(graph_->ops, this->operators_);
+
+  PlaceOperators();
+
+  CHECK(input_operator_->output_operands != nullptr) << "The input node has no output operand";
+  static std::atomic<uint64_t> next_build_id(1);
+  build_id_ = next_build_id.fetch_add(1);
   graph_state_ = GraphState::Complete;
   input_name_ = input_name;
-  output_name_ = output_name;
+  output_names_ = output_names;
+  // 先量化权重，指标中记录的是量化之后的权重字节数
+  QuantizeLayerWeights();
+  BindMetrics();
+  if (auto_tune_) {
+    TuneLayers();
+  }
+  default_context_ = CreateContext();
+  default_context_->set_profiler(profiler_);
+  default_context_->set_activation_dumper(activation_dumper_);
+
+  // 从pnnx模型构建的计算图保存为缓存，下次启动时直接加载
+  if (from_model && !cache_path_.empty()) {
+    LOG_IF(ERROR, !SaveCache(cache_path_)) << "Save the graph cache failed: " << cache_path_;
+  }
+
+  reclaimed_bytes_ = 0;
+  if (compact_) {
+    reclaimed_bytes_ = ReleaseBuildData();
+    LOG(INFO) << "Reclaimed bytes after build: " << reclaimed_bytes_;
+  }
+
+  ShareParams();
+  PlaceWeights();
+
+  const RuntimeMemoryReport &memory_report = MemoryReport();
+  LOG(INFO) << "Memory after build, weight bytes: " << memory_report.weight_bytes << ", activation bytes: "
+            << memory_report.activation_bytes << ", scratch bytes: " << memory_report.scratch_bytes
+            << ", peak bytes: " << memory_report.peak_bytes;
+}
+
+void RuntimeGraph::TuneLayers() {
+  TuningCache tuning_cache;
+  if (!tuning_cache_path_.empty()) {
+    tuning_cache.Load(tuning_cache_path_);
+  }
+
+  // 按照推理时使用的线程池调优，线程数量不同时最快的算法可能不同
+  ThreadPool::Scope thread_pool_scope(thread_pool_.get());
+  uint32_t tuned_num = 0;
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op->layer == nullptr) {
+      continue;
+    }
+    std::vector<std::vector<int32_t>> input_shapes;
+    for (const uint32_t input_index : topo_input_indexes_.at(i)) {
+      const auto &input_operand = topo_operators_.at(input_index)->output_operands;
+      input_shapes.push_back(input_operand ? input_operand->shapes : std::vector<int32_t>());
+    }
+    if (current_op->layer->Tune(input_shapes, tuning_cache)) {
+      tuned_num += 1;
+    }
+  }
+  LOG(INFO) << "Tuned layers: " << tuned_num << ", tuning cache entries: " << tuning_cache.size();
+
+  if (!tuning_cache_path_.empty() && tuning_cache.modified()) {
+    LOG_IF(ERROR, !tuning_cache.Save(tuning_cache_path_)) << "Save the tuning cache failed: " << tuning_cache_path_;
+  }
+}
+
+void RuntimeGraph::QuantizeLayerWeights() {
+  if (weight_quantization_.empty()) {
+    return;
+  }
+  uint32_t quantized_num = 0;
+  for (const auto &current_op : topo_operators_) {
+    if (current_op->layer == nullptr) {
+      continue;
+    }
+    auto setting = weight_quantization_.find(current_op->name);
+    if (setting == weight_quantization_.end()) {
+      setting = weight_quantization_.find("");
+    }
+    if (setting == weight_quantization_.end() || setting->second.first == 0) {
+      continue;
+    }
+    if (current_op->layer->QuantizeWeights(setting->second.first, setting->second.second)) {
+      quantized_num += 1;
+    }
+  }
+  LOG(INFO) << "Quantized layer weights: " << quantized_num;
+}
+
+void RuntimeGraph::ShareParams() {
+  if (shared_params_path_.empty()) {
+    shared_params_.reset();
+    return;
+  }
+  const auto &share_layers = [this](SharedParams &shared_params) {
+    for (const auto &current_op : topo_operators_) {
+      if (current_op->layer != nullptr) {
+        shared_params.BeginOperator(current_op->name);
+        const uint32_t shared_num = shared_params.shared_num();
+        current_op->layer->ShareParams(shared_params);
+        // 记录时不会替换任何参数，只有映射的共享器会交给Layer
+        if (shared_params.shared_num() > shared_num) {
+          current_op->layer->set_shared_params(shared_params.shared_from_this());
+        }
+      }
+    }
+  };
+  std::shared_ptr<SharedParams> shared_params = SharedParams::Open(shared_params_path_);
+  if (shared_params != nullptr) {
+    share_layers(*shared_params);
+  }
+  // 文件不存在或者和当前的模型不一致时重新生成，已经引用旧文件的权重在重新映射之前保持有效
+  if (shared_params == nullptr || shared_params->missed_num() > 0) {
+    SharedParams recorder;
+    share_layers(recorder);
+    std::shared_ptr<SharedParams> saved_params;
+    if (recorder.Save(shared_params_path_)) {
+      saved_params = SharedParams::Open(shared_params_path_);
+    }
+    if (saved_params != nullptr) {
+      share_layers(*saved_params);
+      shared_params = saved_params;
+    }
+  }
+  shared_params_ = shared_params;
+  if (shared_params_ != nullptr) {
+    LOG(INFO) << "Shared params: " << shared_params_->shared_num() << ", shared bytes: "
+              << shared_params_->shared_bytes();
+  }
+}
+
+void RuntimeGraph::PlaceWeights() const {
+  if (weight_policy_ == NumaMemoryPolicy::kDefault) {
+    return;
+  }
+  for (const auto &current_op : topo_operators_) {
+    if (current_op->layer != nullptr) {
+      current_op->layer->PlaceParams(weight_policy_, weight_node_);
+    }
+  }
+}
+
+void RuntimeGraph::PlaceOperators() {
+  const bool device_available = DeviceAvailable(device_);
+  LOG_IF(WARNING, !device_available) << "The device " << int(device_) << " is not available, run on the cpu";
+  uint32_t device_op_num = 0;
+  for (const auto &current_op : topo_operators_) {
+    current_op->device = DeviceType::kDeviceCPU;
+    if (device_available && current_op->layer != nullptr && current_op->layer->SupportDevice(device_)) {
+      current_op->device = device_;
+      device_op_num += 1;
+    }
+  }
+  LOG_IF(INFO, device_ != DeviceType::kDeviceCPU) << "Operators placed on the device: " << device_op_num;
+  device_op_num_ = device_op_num;
+
+  // 节点的输出在自己的设备上写入，执行完成后复制到其他设备上的后继节点，计算图的输出节点在CPU上
+  topo_sync_devices_.assign(topo_operators_.size(), {});
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    std::vector<DeviceType> &sync_devices = topo_sync_devices_.at(i);
+    for (const uint32_t next_index : topo_successors_.at(i)) {
+      const DeviceType next_device = topo_operators_.at(next_index)->device;
+      if (next_device != topo_operators_.at(i)->device
+          && std::find(sync_devices.begin(), sync_devices.end(), next_device) == sync_devices.end()) {
+        sync_devices.push_back(next_device);
+      }
+    }
+  }
+
+  // 输出在设备上时不在节点执行完成后阻塞地复制，而是异步复制到页锁定内存，推理结束时统一等待
+  const auto &output_successors = topo_successors_.at(topo_output_index_);
+  stage_outputs_ = topo_operators_.at(topo_output_index_)->device != DeviceType::kDeviceCPU
+      && std::all_of(output_successors.begin(), output_successors.end(), [this](uint32_t next_index) {
+        return topo_operators_.at(next_index) == output_operator_;
+      });
+}
+
+size_t RuntimeGraph::ReleaseBuildData() {
+  size_t reclaimed_bytes = 0;
+  // 计算节点中映射的权重和pnnx图中的共享同一个映射，存在pnnx图时只在pnnx图中统计
+  for (const auto &op : this->operators_) {
+    // 还没有创建的延迟Layer在第一次执行时仍然需要读取权重属性
+    const auto &lazy_layer = std::dynamic_pointer_cast<LazyLayer>(op->layer);
+    if (lazy_layer != nullptr && !lazy_layer->materialized()) {
+      continue;
+    }
+    for (const auto &attr : op->attribute) {
+      if (attr.second != nullptr) {
+        reclaimed_bytes += attr.second->weight_data.capacity();
+        if (graph_ == nullptr) {
+          reclaimed_bytes += attr.second->mapped_size;
+        }
+      }
+    }
+    op->attribute.clear();
+  }
+
+  if (graph_ != nullptr) {
+    for (const pnnx::Operator *op : graph_->ops) {
+      for (const auto &attr : op->attrs) {
+        reclaimed_bytes += attr.second.data.capacity() + attr.second.mapped_size;
+      }
+    }
+    graph_.reset();
+  }
+  build_data_released_ = true;
+  return reclaimed_bytes;
 }
 
 std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
@@ -256,87 +846,207 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(const std::vec
   if (graph_state_ < GraphState::Complete) {
     LOG(FATAL) << "Graph need be build!";
   }
+  return Forward(default_context_, inputs, debug);
+}
+
+void RuntimeGraph::PrepareForward(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                  const std::vector<uint32_t> &output_ids) const {
+  if (graph_state_ < GraphState::Complete) {
+    LOG(FATAL) << "Graph need be build!";
+  }
   CHECK(graph_state_ == GraphState::Complete) << "Graph status error, current state is " << int(graph_state_);
+  CHECK(input_operator_ != nullptr && output_operator_ != nullptr);
+  CHECK(!inputs.empty()) << "The inputs of graph is empty!";
+  const std::vector<int32_t> &build_shape = input_operator_->output_operands->shapes;
+  CHECK(inputs.size() <= build_shape.at(0))
+          << "The batch size " << inputs.size() << " exceeds the max batch size " << build_shape.at(0);
 
-  std::shared_ptr<RuntimeOperator> input_op;
-  if (input_operators_maps_.find(input_name_) == input_operators_maps_.end()) {
-    LOG(FATAL) << "Can not find the input node: " << input_name_;
-  } else {
-    input_op = input_operators_maps_.at(input_name_);
+  // 计算图重新Build之后节点和执行序列都会变化，上下文中原有的执行计划不能再使用
+  if (context.build_id_ != build_id_) {
+    context.plans_.clear();
+    context.build_id_ = build_id_;
   }
 
-  std::shared_ptr<RuntimeOperator> output_op;
-  if (output_operators_maps_.find(output_name_) == output_operators_maps_.end()) {
-    LOG(FATAL) << "Can not find the output node: " << input_name_;
+  // 输入形状和当前的执行计划不同时切换到对应的计划
+  const std::shared_ptr<Tensor<float>> &input = inputs.front();
+  CHECK(input != nullptr && !input->empty()) << "The input tensor of graph is empty!";
+  std::vector<int32_t> input_shape;
+  if (build_shape.size() == 4) {
+    input_shape = {build_shape.at(0), int32_t(input->channels()), int32_t(input->rows()), int32_t(input->cols())};
+  } else if (build_shape.size() == 2) {
+    CHECK(input->channels() == 1 && input->cols() == 1);
+    input_shape = {build_shape.at(0), int32_t(input->rows())};
   } else {
-    output_op = output_operators_maps_.at(output_name_);
+    CHECK(input->channels() == 1);
+    input_shape = {build_shape.at(0), int32_t(input->rows()), int32_t(input->cols())};
+  }
+  for (const auto &batch_input : inputs) {
+    CHECK(batch_input != nullptr && batch_input->shapes() == input->shapes())
+            << "The input tensors of graph must have the same shape";
+  }
+  // 延迟Layer创建之后才能给出临时内存和原地计算的需求，创建之前的执行计划不再使用
+  if (lazy_layer_num_ != nullptr) {
+    const uint32_t lazy_layer_num = lazy_layer_num_->load();
+    context.plans_.remove_if([lazy_layer_num](const RuntimeGraphPlan &plan) {
+      return plan.lazy_layer_num != lazy_layer_num;
+    });
   }
 
-  std::deque<std::shared_ptr<RuntimeOperator>> operator_queue;
-  operator_queue.push_back(input_op);
-  std::map<std::string, double> run_duration_infos;
+  // 执行计划中的临时内存和线程数量有关，线程池变化后需要切换到对应的计划
+  if (context.plans_.empty() || context.plans_.front().input_shape != input_shape
+      || context.plans_.front().thread_num != ThreadPool::Current().thread_num()) {
+    SwitchPlan(context, input_shape);
+  }
 
-  while (!operator_queue.empty()) {
-    std::shared_ptr<RuntimeOperator> current_op = operator_queue.front();
-    operator_queue.pop_front();
+  // 执行计划的内存第一次在绑定的节点上使用时迁移过来
+  RuntimeGraphPlan &plan = context.plans_.front();
+  if (context.numa_node_ >= 0 && plan.numa_node != context.numa_node_) {
+    plan.memory_planner.PlaceMemory(NumaMemoryPolicy::kBind, uint32_t(context.numa_node_));
+    plan.numa_node = context.numa_node_;
+  }
 
-    if (!current_op || current_op == output_op) {
-      if (debug) {
-        LOG(INFO) << "Model Inference End";
-      }
-      break;
+  // 有节点在设备上执行时上下文使用自己的流，设备上的中间张量按照同一份规划复用设备内存
+  if (device_op_num_ > 0) {
+    if (context.device_stream_ == nullptr) {
+      context.device_stream_ = std::make_unique<DeviceStream>();
     }
+    plan.memory_planner.PlaceDeviceMemory();
+  }
 
-    if (current_op == input_op) {
-      const std::vector<std::shared_ptr<Tensor<float>>> &layer_output_datas = inputs;
-      ProbeNextLayer(current_op, operator_queue, layer_output_datas);
+  // 绑定的输出张量直接作为计算图输出来源节点的输出，形状必须和计划中的输出形状相同
+  const std::vector<std::shared_ptr<Tensor<float>>> &bound_outputs = context.bound_outputs_;
+  if (!bound_outputs.empty()) {
+    CHECK(bound_outputs.size() >= inputs.size())
+            << "The bound outputs " << bound_outputs.size() << " is less than the batch size " << inputs.size();
+    const std::vector<int32_t> &output_shape = plan.output_shapes.at(topo_output_index_);
+    std::vector<uint32_t> output_tensor_shape;
+    if (output_shape.size() == 4) {
+      output_tensor_shape = {uint32_t(output_shape.at(1)), uint32_t(output_shape.at(2)), uint32_t(output_shape.at(3))};
+    } else if (output_shape.size() == 2) {
+      output_tensor_shape = {1, uint32_t(output_shape.at(1)), 1};
     } else {
-      std::string current_op_name = current_op->name;
-      bool has_ready = CheckOperatorReady(current_op);
-      if (!has_ready) {
-        operator_queue.push_back(current_op);
-        continue;
-      }
+      CHECK(output_shape.size() == 3);
+      output_tensor_shape = {1, uint32_t(output_shape.at(1)), uint32_t(output_shape.at(2))};
+    }
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+      CHECK(bound_outputs.at(i)->shapes() == output_tensor_shape)
+              << "The shape of bound output tensor is different from the output of graph";
+    }
+  }
 
-      const std::vector<std::shared_ptr<RuntimeOperand>> &input_operand_datas = current_op->input_operands_seq;
-      std::vector<std::shared_ptr<Tensor<float>>> layer_input_datas;
-      for (const auto &input_operand_data : input_operand_datas) {
-        for (const auto &input_data : input_operand_data->datas) {
-          layer_input_datas.push_back(input_data);
-        }
+  context.output_datas_.assign(topo_operators_.size(), {});
+  context.run_durations_.assign(topo_operators_.size(), 0.);
+
+  // 只执行本次需要的输出节点的祖先节点，全部节点都需要执行时不再逐个检查
+  CHECK(!output_ids.empty()) << "The outputs of forward is empty";
+  context.active_ops_.assign(topo_operators_.size(), false);
+  for (const uint32_t output_id : output_ids) {
+    CHECK(output_id < topo_output_ancestors_.size()) << "The output " << output_id << " is not built";
+    const std::vector<bool> &ancestors = topo_output_ancestors_.at(output_id);
+    for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+      if (ancestors.at(i)) {
+        context.active_ops_.at(i) = true;
       }
+    }
+  }
+  if (std::all_of(context.active_ops_.begin(), context.active_ops_.end(), [](bool active) { return active; })) {
+    context.active_ops_.clear();
+  }
+}
 
-      CHECK(!layer_input_datas.empty());
-      CHECK(current_op->output_operands != nullptr);
-      std::vector<std::shared_ptr<Tensor<float>>> layer_output_datas = current_op->output_operands->datas;
+void RuntimeGraph::ExecuteRange(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                uint32_t begin, uint32_t end) const {
+  CHECK(begin <= end && end <= topo_operators_.size());
+  const RuntimeGraphPlan &plan = context.plans_.front();
+  const uint32_t batch_size = inputs.size();
+  if (plan.segment_bounds.empty() || batch_size <= plan.micro_batch_size) {
+    for (uint32_t i = begin; i < end; ++i) {
+      context.run_durations_.at(i) = ExecuteOperator(i, context, inputs, 0, batch_size);
+    }
+    return;
+  }
 
-      const auto &start = std::chrono::steady_clock::now();
-      InferStatus status = current_op->layer->Forward(layer_input_datas, layer_output_datas);
-      if (debug) {
-        std::replace_if(current_op_name.begin(), current_op_name.end(), [](char c) { return c == '.'; }, '_');
-        const double duration =
-            std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
-        if (run_duration_infos.find(current_op->type) == run_duration_infos.end()) {
-          run_duration_infos.insert({current_op->type, duration});
-        } else {
-          run_duration_infos.at(current_op->type) += duration;
-        }
+  // 每一段对一个微批次执行完所有节点之后再执行下一个微批次，范围只覆盖一段的一部分时同样安全
+  for (uint32_t s = 0; s + 1 < plan.segment_bounds.size(); ++s) {
+    const uint32_t segment_begin = std::max(begin, plan.segment_bounds.at(s));
+    const uint32_t segment_end = std::min(end, plan.segment_bounds.at(s + 1));
+    if (segment_begin >= segment_end) {
+      continue;
+    }
+    // 只有一个节点时拆分批次没有收益，反而减小了Layer内部矩阵乘法的规模
+    const uint32_t step = segment_end - segment_begin > 1 ? plan.micro_batch_size : batch_size;
+    for (uint32_t batch_begin = 0; batch_begin < batch_size; batch_begin += step) {
+      const uint32_t batch_end = std::min(batch_size, batch_begin + step);
+      for (uint32_t i = segment_begin; i < segment_end; ++i) {
+        context.run_durations_.at(i) += ExecuteOperator(i, context, inputs, batch_begin, batch_end);
       }
+    }
+  }
+}
 
-      CHECK(status == InferStatus::kInferSuccess)
-              << current_op->layer->layer_name() << " layer forward failed, error code: " << int(status);
-      ProbeNextLayer(current_op, operator_queue, layer_output_datas);
+std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::FinishForward(
+    ExecutionContext &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const {
+  const std::vector<std::shared_ptr<Tensor<float>>> &bound_outputs = context.bound_outputs_;
+  // 等待上下文的流完成，之后页锁定内存中的输出可以写回输出张量，暂存的输入也可以被下一次推理改写
+  if (context.device_stream_ != nullptr) {
+    context.device_stream_->Synchronize();
+    if (context.outputs_pinned_) {
+      const float *pinned_output = context.pinned_outputs_.data();
+      for (const auto &output_data : context.output_datas_.at(topo_output_index_)) {
+        std::memcpy(output_data->data().memptr(), pinned_output, output_data->size() * sizeof(float));
+        output_data->set_device(DeviceType::kDeviceCPU);
+        pinned_output += output_data->size();
+      }
+      context.outputs_pinned_ = false;
     }
   }
 
-  for (const auto &op : this->operators_) {
-    op->meet_num = 0;
+  // 输出共享输入内存的Layer和直接输出计算图输入的情况不会写入绑定的张量，此时复制一次
+  // 本次推理不需要第一个输出时它的来源节点没有执行，绑定的张量保持不变
+  const bool output_active = context.active_ops_.empty() || context.active_ops_.at(topo_output_index_);
+  if (!bound_outputs.empty() && output_active) {
+    std::vector<std::shared_ptr<Tensor<float>>> &output_datas = context.output_datas_.at(topo_output_index_);
+    CHECK(output_datas.size() == inputs.size());
+    for (uint32_t i = 0; i < output_datas.size(); ++i) {
+      const std::shared_ptr<Tensor<float>> &bound_output = bound_outputs.at(i);
+      if (output_datas.at(i)->data().memptr() != bound_output->data().memptr()) {
+        std::memcpy(bound_output->data().memptr(), output_datas.at(i)->data().memptr(),
+                    bound_output->size() * sizeof(float));
+      }
+    }
+    output_datas.assign(bound_outputs.begin(), bound_outputs.begin() + inputs.size());
+  }
+
+  return context.output_datas_.at(topo_output_index_);
+}
+
+std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(const std::shared_ptr<ExecutionContext> &context,
+                                                                  const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+                                                                  bool debug) const {
+  CHECK(context != nullptr) << "The execution context is empty!";
+  const auto &start = std::chrono::steady_clock::now();
+  ThreadPool::Scope thread_pool_scope(ContextThreadPool(*context));
+  PrepareForward(*context, inputs);
+  // 绑定节点的上下文在这个节点上执行
+  NumaNodeScope numa_scope(context->numa_node_);
+  ExecuteOperators(*context, inputs);
+  FinishForward(*context, inputs);
+  RecordForward(*context, inputs.size(), start);
+
+  if (debug) {
+    LOG(INFO) << "Model Inference End";
   }
 
-  CHECK(output_op->input_operands.size() == 1) << "The graph only support one path to the output node yet!";
-  const auto &output_op_input_operand = output_op->input_operands.begin();
-  const auto &output_operand = output_op_input_operand->second;
   if (debug) {
+    std::map<std::string, double> run_duration_infos;
+    for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+      const auto &current_op = topo_operators_.at(i);
+      if (current_op == input_operator_ || current_op->type == "pnnx.Output") {
+        continue;
+      }
+      run_duration_infos[current_op->type] += context->run_durations_.at(i);
+    }
+
     LOG(INFO) << "--------------------------------------------------" << "\n";
     LOG(INFO) << "Model Running Information, Time Cost:";
     LOG(INFO) << "Batch Size:" << inputs.size();
@@ -350,23 +1060,488 @@ std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(const std::vec
       duration_all += run_info.second;
     }
     LOG(INFO) << "All time cost: " << duration_all << " s";
+    if (context->profiler_ != nullptr) {
+      LOG(INFO) << "Top operators:\n" << context->profiler_->TopOperators(10);
+    }
+    LOG(INFO) << "Memory usage:\n" << MemoryReport(context).ToString();
+  }
+  return context->output_datas_.at(topo_output_index_);
+}
+
+std::vector<std::shared_ptr<Tensor<float>>> RuntimeGraph::Forward(const std::shared_ptr<ExecutionContext> &context,
+                                                                  bool debug) const {
+  CHECK(context != nullptr) << "The execution context is empty!";
+  CHECK(!context->bound_inputs_.empty()) << "The execution context has no bound inputs!";
+  return Forward(context, context->bound_inputs_, debug);
+}
+
+std::vector<std::vector<std::shared_ptr<Tensor<float>>>> RuntimeGraph::ForwardOutputs(
+    const std::vector<std::shared_ptr<Tensor<float>>> &inputs, const std::vector<std::string> &output_names) {
+  if (graph_state_ < GraphState::Complete) {
+    LOG(FATAL) << "Graph need be build!";
+  }
+  return ForwardOutputs(default_context_, inputs, output_names);
+}
+
+std::vector<std::vector<std::shared_ptr<Tensor<float>>>> RuntimeGraph::ForwardOutputs(
+    const std::shared_ptr<ExecutionContext> &context, const std::vector<std::shared_ptr<Tensor<float>>> &inputs,
+    const std::vector<std::string> &output_names) const {
+  CHECK(context != nullptr) << "The execution context is empty!";
+  CHECK(!output_names.empty()) << "The output names of forward is empty";
+  std::vector<uint32_t> output_ids;
+  for (const auto &output_name : output_names) {
+    const auto &output_name_iter = std::find(output_names_.begin(), output_names_.end(), output_name);
+    LOG_IF(FATAL, output_name_iter == output_names_.end()) << "The output node " << output_name << " is not built";
+    output_ids.push_back(output_name_iter - output_names_.begin());
+  }
+
+  const auto &start = std::chrono::steady_clock::now();
+  ThreadPool::Scope thread_pool_scope(ContextThreadPool(*context));
+  PrepareForward(*context, inputs, output_ids);
+  NumaNodeScope numa_scope(context->numa_node_);
+  ExecuteOperators(*context, inputs);
+  FinishForward(*context, inputs);
+  RecordForward(*context, inputs.size(), start);
+
+  std::vector<std::vector<std::shared_ptr<Tensor<float>>>> outputs;
+  outputs.reserve(output_ids.size());
+  for (const uint32_t output_id : output_ids) {
+    outputs.push_back(context->output_datas_.at(topo_output_indexes_.at(output_id)));
+  }
+  return outputs;
+}
+
+const std::vector<std::string> &RuntimeGraph::output_names() const {
+  return output_names_;
+}
+
+void RuntimeGraph::ExecuteOperators(ExecutionContext &context,
+                                    const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const {
+  if (!parallel_execute_) {
+    ExecuteRange(context, inputs, 0, topo_operators_.size());
+    return;
+  }
+  // 每个节点还需要等待的前驱节点数量，减到0时该节点就绪并作为任务提交
+  if (context.in_degrees_.size() != topo_operators_.size()) {
+    context.in_degrees_ = std::vector<std::atomic<uint32_t>>(topo_operators_.size());
+  }
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    context.in_degrees_.at(i).store(topo_in_degrees_.at(i));
+  }
+  context.remain_ops_.store(topo_operators_.size());
+  ExecuteParallel(0, context, inputs);
+
+  // 等待所有节点完成的时候帮助线程池执行任务
+  ThreadPool &thread_pool = ThreadPool::Current();
+  while (context.remain_ops_ != 0) {
+    if (!thread_pool.RunPendingTask()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+std::shared_ptr<ExecutionContext> RuntimeGraph::CreateContext() const {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  std::shared_ptr<ExecutionContext> context = std::make_shared<ExecutionContext>();
+  context->build_id_ = build_id_;
+  context->set_plan_cache_size(plan_cache_size_);
+  ThreadPool::Scope thread_pool_scope(thread_pool_.get());
+  CreatePlan(*context, input_operator_->output_operands->shapes);
+  return context;
+}
+
+std::vector<std::shared_ptr<ExecutionContext>> RuntimeGraph::CreateReplicas() const {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  CHECK(replica_num_ > 0) << "The replicas of graph are not set";
+  std::vector<std::shared_ptr<ExecutionContext>> replicas;
+  for (const std::vector<uint32_t> &cpus : SplitCpus(replica_num_, replica_cpus_)) {
+    std::shared_ptr<ExecutionContext> context = std::make_shared<ExecutionContext>();
+    context->build_id_ = build_id_;
+    context->set_plan_cache_size(plan_cache_size_);
+    context->set_thread_pool(std::make_shared<ThreadPool>(cpus.size(), cpus));
+    // 按照副本自己的线程数量规划，Layer的临时内存和副本推理时的线程数量一致
+    ThreadPool::Scope thread_pool_scope(context->thread_pool().get());
+    CreatePlan(*context, input_operator_->output_operands->shapes);
+    replicas.push_back(std::move(context));
+  }
+  return replicas;
+}
+
+uint32_t RuntimeGraph::Warmup(const std::shared_ptr<ExecutionContext> &context,
+                              const std::vector<std::vector<int32_t>> &input_shapes, bool lock_memory) const {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  const std::shared_ptr<ExecutionContext> &current_context = context != nullptr ? context : default_context_;
+  const std::vector<int32_t> &build_shape = input_operator_->output_operands->shapes;
+  std::vector<std::vector<int32_t>> warmup_shapes = input_shapes;
+  if (warmup_shapes.empty() && current_context->build_id_ == build_id_) {
+    // 从最早使用的计划开始预热，预热完成之后计划在缓存中的顺序不变，线程数不同的同一形状只预热一次
+    for (auto plan = current_context->plans_.rbegin(); plan != current_context->plans_.rend(); ++plan) {
+      if (std::find(warmup_shapes.begin(), warmup_shapes.end(), plan->input_shape) == warmup_shapes.end()) {
+        warmup_shapes.push_back(plan->input_shape);
+      }
+    }
+  }
+  if (warmup_shapes.empty()) {
+    warmup_shapes.push_back(build_shape);
+  }
+  LOG_IF(WARNING, warmup_shapes.size() > current_context->plan_cache_size_)
+          << "The warmup shapes " << warmup_shapes.size() << " exceed the plan cache size "
+          << current_context->plan_cache_size_ << ", the earlier plans will be evicted";
+
+  for (const std::vector<int32_t> &shape : warmup_shapes) {
+    CHECK(shape.size() == build_shape.size()) << "The warmup shape has " << shape.size()
+                                              << " dimensions, the graph input has " << build_shape.size();
+    CHECK(shape.at(0) > 0 && shape.at(0) <= build_shape.at(0))
+            << "The warmup batch size " << shape.at(0) << " must be in (0, " << build_shape.at(0) << "]";
+    // 执行计划按照最大批次规划，预热使用满批次，让所有的批次张量都被写入一次
+    std::vector<std::shared_ptr<Tensor<float>>> inputs(build_shape.at(0));
+    for (auto &input : inputs) {
+      if (shape.size() == 4) {
+        input = std::make_shared<Tensor<float>>(shape.at(1), shape.at(2), shape.at(3));
+      } else if (shape.size() == 2) {
+        input = std::make_shared<Tensor<float>>(1, shape.at(1), 1);
+      } else {
+        input = std::make_shared<Tensor<float>>(1, shape.at(1), shape.at(2));
+      }
+      input->Fill(0.f);
+    }
+    // 预热所有的输出，每个节点都至少执行一次
+    const uint32_t lazy_layer_num = this->lazy_layer_num();
+    ForwardOutputs(current_context, inputs, output_names_);
+    // 第一次执行创建了延迟Layer时执行计划会重新规划，按照新的计划再执行一次
+    if (this->lazy_layer_num() != lazy_layer_num) {
+      ForwardOutputs(current_context, inputs, output_names_);
+    }
+  }
+
+  if (lock_memory) {
+#if defined(__linux__)
+    LOG_IF(WARNING, mlockall(MCL_CURRENT) != 0) << "Lock the memory failed, check the RLIMIT_MEMLOCK of the process";
+#else
+    LOG(WARNING) << "Locking the memory is only supported on linux";
+#endif
+  }
+  LOG(INFO) << "Warmup input shapes: " << warmup_shapes.size();
+  return warmup_shapes.size();
+}
+
+std::vector<uint32_t> RuntimeGraph::PartitionStages(const std::vector<uint32_t> &stage_threads) const {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  const uint32_t stage_num = stage_threads.size();
+  const uint32_t op_num = topo_operators_.size();
+  CHECK(stage_num > 0 && stage_num <= op_num)
+          << "The stage number " << stage_num << " must be in (0, " << op_num << "]";
+
+  // 没有计算量的节点也计入1，只搬运数据的节点不会全部堆在同一个阶段
+  std::vector<double> prefix_costs(op_num + 1, 0.);
+  for (uint32_t i = 0; i < op_num; ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    double cost = 0.;
+    if (current_op != input_operator_ && current_op->type != "pnnx.Output" && current_op->layer != nullptr
+        && current_op->output_operands != nullptr) {
+      std::vector<std::vector<int32_t>> input_shapes;
+      for (const uint32_t input_index : topo_input_indexes_.at(i)) {
+        input_shapes.push_back(topo_operators_.at(input_index)->output_operands->shapes);
+      }
+      cost = double(current_op->layer->Flops(input_shapes, current_op->output_operands->shapes)) + 1.;
+    }
+    prefix_costs.at(i + 1) = prefix_costs.at(i) + cost;
+  }
+
+  uint64_t total_threads = 0;
+  for (const uint32_t thread_num : stage_threads) {
+    CHECK(thread_num > 0) << "The thread number of a stage must be greater than zero";
+    total_threads += thread_num;
+  }
+  std::vector<uint32_t> bounds(stage_num + 1, 0);
+  bounds.back() = op_num;
+  uint64_t thread_sum = 0;
+  for (uint32_t s = 0; s + 1 < stage_num; ++s) {
+    thread_sum += stage_threads.at(s);
+    const double target = prefix_costs.back() * double(thread_sum) / double(total_threads);
+    // 每个阶段至少包含一个节点，并且给之后的阶段留下足够的节点
+    uint32_t end = bounds.at(s) + 1;
+    const uint32_t max_end = op_num - (stage_num - s - 1);
+    while (end < max_end && std::abs(prefix_costs.at(end + 1) - target) <= std::abs(prefix_costs.at(end) - target)) {
+      end += 1;
+    }
+    bounds.at(s + 1) = end;
+  }
+  return bounds;
+}
+
+void RuntimeGraph::set_weight_quantization(const std::string &op_name, uint32_t bits, uint32_t group_size) {
+  CHECK(bits == 0 || bits == 8 || bits == 4) << "Unsupported weight quantization bits: " << bits;
+  CHECK(bits == 0 || group_size > 0) << "The weight quantization group size must be greater than zero";
+  // 单独设置为0的节点仍然需要记录，才能覆盖所有节点的设置
+  if (op_name.empty() && bits == 0) {
+    weight_quantization_.erase(op_name);
+    return;
+  }
+  weight_quantization_[op_name] = {bits, group_size};
+}
+
+uint32_t RuntimeGraph::QuantizeInt8(const std::vector<std::vector<std::shared_ptr<Tensor<float>>>> &samples) {
+  CHECK(graph_state_ == GraphState::Complete) << "Graph need be build!";
+  CHECK(!samples.empty()) << "The calibration samples is empty!";
+  default_context_->input_abs_max_.assign(topo_operators_.size(), 0.f);
+  // 标定时计算所有的输出，每个节点都能统计到输入的范围
+  for (const auto &sample : samples) {
+    ForwardOutputs(default_context_, sample, output_names_);
+  }
+  std::vector<float> input_abs_max = std::move(default_context_->input_abs_max_);
+  default_context_->input_abs_max_.clear();
+
+  uint32_t quantized_num = 0;
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op->layer == nullptr || input_abs_max.at(i) <= 0.f) {
+      continue;
+    }
+    if (current_op->layer->QuantizeInt8(input_abs_max.at(i))) {
+      quantized_num += 1;
+    }
+  }
+  LOG(INFO) << "Quantized layers to int8: " << quantized_num;
+  return quantized_num;
+}
+
+double RuntimeGraph::ExecuteOperator(uint32_t op_index, ExecutionContext &context,
+                                     const std::vector<std::shared_ptr<Tensor<float>>> &inputs, uint32_t batch_begin,
+                                     uint32_t batch_end) const {
+  // 不是本次需要的输出节点的祖先节点不执行，并行执行时仍然作为完成的前驱节点提交后继节点
+  if (!context.active_ops_.empty() && !context.active_ops_.at(op_index)) {
+    return 0.;
+  }
+  const auto &current_op = topo_operators_.at(op_index);
+  std::vector<std::shared_ptr<Tensor<float>>> &output_datas = context.output_datas_.at(op_index);
+  // 并行执行时节点可能在任意工作线程上执行，每个节点都在上下文的流上提交内核和复制
+  DeviceStream::Scope stream_scope(context.device_stream_.get());
+  if (current_op == input_operator_) {
+    // 微批次执行时输入节点在第一个微批次中一次给出所有输入
+    if (batch_begin > 0) {
+      return 0.;
+    }
+    output_datas = inputs;
+    // 调用者的输入可能已经在设备上，保留它的设备标记
+    for (const DeviceType device : topo_sync_devices_.at(op_index)) {
+      if (device == DeviceType::kDeviceCUDA && context.device_stream_ != nullptr) {
+        StageInputs(context, output_datas);
+        continue;
+      }
+      for (const auto &output_data : output_datas) {
+        output_data->SyncTo(device);
+      }
+    }
+    return 0.;
+  }
+  if (current_op->type == "pnnx.Output") {
+    return 0.;
+  }
+
+  // 本次推理的批次可以小于预先分配的批次，每个节点只计算前inputs.size()个张量中[batch_begin, batch_end)的部分
+  CHECK(batch_begin < batch_end && batch_end <= inputs.size());
+  const uint32_t batch_size = batch_end - batch_begin;
+  std::vector<std::shared_ptr<Tensor<float>>> layer_input_datas;
+  for (const uint32_t input_index : topo_input_indexes_.at(op_index)) {
+    const auto &input_datas = context.output_datas_.at(input_index);
+    CHECK(input_datas.size() == inputs.size());
+    layer_input_datas.insert(layer_input_datas.end(), input_datas.begin() + batch_begin,
+                             input_datas.begin() + batch_end);
+  }
+  CHECK(!layer_input_datas.empty());
+
+  // 标定时在Forward之前统计输入，原地计算的Layer会改写输入张量
+  if (!context.input_abs_max_.empty()) {
+    float &abs_max = context.input_abs_max_.at(op_index);
+    for (const auto &input_data : layer_input_datas) {
+      input_data->SyncTo(DeviceType::kDeviceCPU);
+      abs_max = std::max(abs_max, arma::abs(input_data->data()).max());
+    }
+  }
+
+  const RuntimeMemoryPlanner &memory_planner = context.plans_.front().memory_planner;
+  const auto &planned_datas = memory_planner.tensors(op_index);
+  CHECK(planned_datas.size() >= batch_end);
+  std::vector<std::shared_ptr<Tensor<float>>> layer_output_datas(planned_datas.begin() + batch_begin,
+                                                                 planned_datas.begin() + batch_end);
+  // 计算图的输出直接写入调用者绑定的张量，输出共享输入内存的Layer仍然使用规划的空张量
+  if (op_index == topo_output_index_ && !context.bound_outputs_.empty() && layer_output_datas.front() != nullptr) {
+    layer_output_datas.assign(context.bound_outputs_.begin() + batch_begin,
+                              context.bound_outputs_.begin() + batch_end);
+  }
+
+  const RuntimeWorkspace &workspace = memory_planner.workspace(op_index);
+  const std::shared_ptr<RuntimeProfiler> &profiler = context.profiler_;
+  // 硬件计数器只统计当前线程，节点的Forward在当前线程开始和结束，并行的部分计入其他线程
+  HardwareCounterValues counter_start;
+  const bool count_hardware = profiler != nullptr && profiler->hardware_counters() &&
+      HardwareCounters::ThreadLocal().Read(counter_start);
+  const double profile_start = profiler != nullptr ? profiler->Now() : 0.;
+  const auto &start = std::chrono::steady_clock::now();
+  InferStatus status;
+  {
+    Layer::WorkspaceScope workspace_scope(workspace.workspace, workspace.workspace_size);
+    if (current_op->device == DeviceType::kDeviceCUDA) {
+      status = current_op->layer->ForwardCuda(layer_input_datas, layer_output_datas);
+    } else {
+      status = current_op->layer->Forward(layer_input_datas, layer_output_datas);
+    }
+    // 设备上的内核异步执行，性能分析时等待完成才能得到节点的执行时间
+    if (profiler != nullptr && current_op->device != DeviceType::kDeviceCPU) {
+      DeviceStream::SynchronizeCurrent();
+    }
+  }
+  const double duration =
+      std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+
+  CHECK(status == InferStatus::kInferSuccess)
+          << current_op->layer->layer_name() << " layer forward failed, error code: " << int(status);
+  // 后继节点在其他设备上时由当前节点复制输出，后继节点读取输入时不需要再同步
+  const bool stage_outputs = op_index == topo_output_index_ && stage_outputs_ && context.device_stream_ != nullptr;
+  for (const auto &output_data : layer_output_datas) {
+    output_data->set_device(current_op->device);
+    if (stage_outputs) {
+      continue;
+    }
+    for (const DeviceType device : topo_sync_devices_.at(op_index)) {
+      output_data->SyncTo(device);
+    }
+  }
+  if (stage_outputs) {
+    StageOutputs(context, layer_output_datas);
+  }
+  // 只在保存时才把设备上的输出同步回CPU，没有设置dumper时不增加开销
+  const std::shared_ptr<ActivationDumper> &activation_dumper = context.activation_dumper_;
+  if (activation_dumper != nullptr && activation_dumper->Selected(current_op->name)) {
+    for (const auto &output_data : layer_output_datas) {
+      output_data->SyncTo(DeviceType::kDeviceCPU);
+    }
+    activation_dumper->Dump(current_op->name, layer_output_datas);
+  }
+  if (profiler != nullptr) {
+    OperatorProfile profile;
+    profile.name = current_op->name;
+    profile.type = current_op->type;
+    profile.start_us = profile_start;
+    profile.end_us = profiler->Now();
+    HardwareCounterValues counter_end;
+    if (count_hardware && HardwareCounters::ThreadLocal().Read(counter_end)) {
+      profile.has_hardware_counters = true;
+      profile.hardware_counters = counter_end - counter_start;
+    }
+    // 计划中的形状按照最大批次规划，记录时换成本次推理的批次
+    const std::vector<std::vector<int32_t>> &output_shapes = context.plans_.front().output_shapes;
+    uint64_t element_size = 0;
+    for (const uint32_t input_index : topo_input_indexes_.at(op_index)) {
+      std::vector<int32_t> input_shape = output_shapes.at(input_index);
+      input_shape.at(0) = int32_t(batch_size);
+      element_size += std::accumulate(input_shape.begin(), input_shape.end(), uint64_t(1), std::multiplies<>());
+      profile.input_shapes.push_back(std::move(input_shape));
+    }
+    profile.output_shape = output_shapes.at(op_index);
+    profile.output_shape.at(0) = int32_t(batch_size);
+    element_size += std::accumulate(profile.output_shape.begin(), profile.output_shape.end(), uint64_t(1),
+                                    std::multiplies<>());
+    profile.flops = current_op->layer->Flops(profile.input_shapes, profile.output_shape);
+    profile.bytes = element_size * sizeof(float) + current_op->layer->ParamBytes();
+    for (const auto &output_data : layer_output_datas) {
+      profile.activation_bytes += output_data->size() * sizeof(float);
+    }
+    profile.weight_bytes = current_op->layer->ParamBytes();
+    profile.scratch_bytes = workspace.workspace_size * sizeof(float);
+    profile.current_bytes = MemoryTracker::GetInstance().current_bytes();
+    profiler->Record(std::move(profile));
+  }
+  if (batch_size == inputs.size()) {
+    output_datas = std::move(layer_output_datas);
+  } else {
+    output_datas.resize(inputs.size());
+    std::move(layer_output_datas.begin(), layer_output_datas.end(), output_datas.begin() + batch_begin);
   }
-  return output_operand->datas;
+  return duration;
 }
 
-std::shared_ptr<Layer> RuntimeGraph::CreateLayer(const std::shared_ptr<RuntimeOperator> &op) {
-  LOG_IF(FATAL, !op) << "Operator is empty!";
-  const auto &layer = LayerRegisterer::CreateLayer(op);
-  LOG_IF(FATAL, !layer) << "Layer init failed " << op->type;
-  return layer;
+void RuntimeGraph::ExecuteParallel(uint32_t op_index, ExecutionContext &context,
+                                   const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const {
+  context.run_durations_.at(op_index) = ExecuteOperator(op_index, context, inputs, 0, inputs.size());
+  for (const uint32_t next_index : topo_successors_.at(op_index)) {
+    // 最后一个完成的前驱节点负责提交后继节点
+    if (context.in_degrees_.at(next_index).fetch_sub(1) == 1) {
+      ThreadPool::Current().Submit([this, next_index, &context, &inputs]() {
+        ExecuteParallel(next_index, context, inputs);
+      });
+    }
+  }
+  context.remain_ops_ -= 1;
+}
+
+void RuntimeGraph::StageInputs(ExecutionContext &context,
+                               const std::vector<std::shared_ptr<Tensor<float>>> &inputs) const {
+  // 页锁定内存上的复制由DMA异步完成，同一时刻其他上下文的流上的内核可以继续计算
+  size_t total_size = 0;
+  for (const auto &input : inputs) {
+    total_size += input->size();
+  }
+  context.pinned_inputs_.Reserve(total_size);
+  float *pinned_input = context.pinned_inputs_.data();
+  for (const auto &input : inputs) {
+    if (input->device() == DeviceType::kDeviceCPU) {
+      std::memcpy(pinned_input, input->data().memptr(), input->size() * sizeof(float));
+      CopyHostToDevice(pinned_input, input->cuda_data(), input->size());
+    }
+    pinned_input += input->size();
+  }
 }
 
-void RuntimeGraph::SetOpInputData(const std::vector<std::shared_ptr<Tensor<float>>> &src,
-                                  const std::vector<std::shared_ptr<Tensor<float>>> &dest) {
-  CHECK(src.size() == dest.size()) << "src size: " << src.size() << " dest size: " << dest.size();
-  for (uint32_t i = 0; i < src.size(); ++i) {
-    dest.at(i)->set_data(src.at(i)->data());
+void RuntimeGraph::StageOutputs(ExecutionContext &context,
+                                const std::vector<std::shared_ptr<Tensor<float>>> &outputs) const {
+  size_t total_size = 0;
+  for (const auto &output : outputs) {
+    total_size += output->size();
+  }
+  context.pinned_outputs_.Reserve(total_size);
+  float *pinned_output = context.pinned_outputs_.data();
+  for (const auto &output : outputs) {
+    CopyDeviceToHost(output->cuda_data(), pinned_output, output->size());
+    pinned_output += output->size();
+  }
+  context.outputs_pinned_ = true;
+}
+
+void RuntimeGraph::CreateLayers(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+  // Build时需要访问所有Layer的选项打开时不延迟创建
+  const bool lazy_weights = lazy_weights_ && !auto_tune_ && shared_params_path_.empty()
+      && !detection_post_process_.enabled;
+  lazy_layer_num_.reset();
+  if (lazy_weights) {
+    lazy_layer_num_ = std::make_shared<std::atomic<uint32_t>>(0);
+  }
+
+  // Layer之间相互独立，权重的转换可以并行完成，结束后按照节点顺序报告第一个失败的节点
+  std::vector<ParseParameterAttrStatus> status(operators.size(), ParseParameterAttrStatus::kParameterMissingUnknown);
+  ThreadPool::Current().ParallelFor(0, operators.size(), [&](uint32_t i) {
+    const auto &op = operators.at(i);
+    LOG_IF(FATAL, !op) << "Operator is empty!";
+    if (lazy_weights && !op->attribute.empty()) {
+      op->layer = std::make_shared<LazyLayer>(op, lazy_layer_num_);
+      lazy_layer_num_->fetch_add(1);
+      status.at(i) = ParseParameterAttrStatus::kParameterAttrParseSuccess;
+      return;
+    }
+    std::shared_ptr<Layer> layer;
+    status.at(i) = LayerRegisterer::CreateLayer(op, layer);
+    op->layer = layer;
+  });
+
+  for (uint32_t i = 0; i < operators.size(); ++i) {
+    const auto &op = operators.at(i);
+    LOG_IF(FATAL, status.at(i) != ParseParameterAttrStatus::kParameterAttrParseSuccess)
+            << "Create the layer: " << op->name << " type: " << op->type << " failed, error code: "
+            << int(status.at(i));
+    CHECK(op->layer != nullptr) << "Layer create failed!";
   }
+  LOG_IF(INFO, lazy_layer_num_ != nullptr) << "Lazy layers: " << lazy_layer_num_->load();
 }
 
 void RuntimeGraph::InitInputOperators(const std::vector<pnnx::Operand *> &inputs,
@@ -484,10 +1659,19 @@ void RuntimeGraph::InitGraphAttrs(const std::map<std::string, pnnx::Attribute> &
     const std::string &name = pair.first;
     const pnnx::Attribute &attr = pair.second;
     switch (attr.type) {
-      case 1: {
+      // 半精度的权重保持原始的编码，加载到Layer时再决定是否展开
+      case 1:
+      case 3:
+      case 13: {
         std::shared_ptr<RuntimeAttribute> runtime_attribute = std::make_shared<RuntimeAttribute>();
-        runtime_attribute->type = RuntimeDataType::kTypeFloat32;
-        runtime_attribute->weight_data = attr.data;
+        runtime_attribute->type = RuntimeDataType(attr.type);
+        // 映射到内存的权重只共享所有权，不复制数据
+        if (attr.mapped_data) {
+          runtime_attribute->mapped_data = attr.mapped_data;
+          runtime_attribute->mapped_size = attr.mapped_size;
+        } else {
+          runtime_attribute->weight_data = attr.data;
+        }
         runtime_attribute->shape = attr.shape;
         runtime_operator->attribute.insert({name, runtime_attribute});
         break;
@@ -499,35 +1683,238 @@ void RuntimeGraph::InitGraphAttrs(const std::map<std::string, pnnx::Attribute> &
   }
 }
 
-bool RuntimeGraph::CheckOperatorReady(const std::shared_ptr<RuntimeOperator> &op) {
-  CHECK(op != nullptr);
-  CHECK(op->meet_num <= op->input_operands.size());
-  if (op->meet_num == op->input_operands.size()) {
-    return true;
+std::vector<std::shared_ptr<RuntimeOperator>> RuntimeGraph::TopoSortOperators(const std::shared_ptr<RuntimeOperator> &input_op,
+                                                                              const std::vector<std::shared_ptr<RuntimeOperator>> &output_ops) {
+  CHECK(input_op != nullptr && !output_ops.empty());
+  // 先找到从输入节点能够到达的所有节点，再从输出节点沿着输入操作数反向遍历，得到输出节点的祖先节点
+  std::map<std::string, std::shared_ptr<RuntimeOperator>> reachable_ops{{input_op->name, input_op}};
+  std::queue<std::shared_ptr<RuntimeOperator>> visit_queue;
+  visit_queue.push(input_op);
+  while (!visit_queue.empty()) {
+    const std::shared_ptr<RuntimeOperator> current_op = visit_queue.front();
+    visit_queue.pop();
+    for (const auto &next_op : current_op->output_operators) {
+      if (reachable_ops.insert({next_op.first, next_op.second}).second) {
+        visit_queue.push(next_op.second);
+      }
+    }
+  }
+  std::set<std::shared_ptr<RuntimeOperator>> ancestor_ops;
+  for (const auto &output_op : output_ops) {
+    LOG_IF(FATAL, reachable_ops.find(output_op->name) == reachable_ops.end())
+            << "The output node " << output_op->name << " can not be reached from the input node " << input_op->name;
+    if (ancestor_ops.insert(output_op).second) {
+      visit_queue.push(output_op);
+    }
+  }
+  while (!visit_queue.empty()) {
+    const std::shared_ptr<RuntimeOperator> current_op = visit_queue.front();
+    visit_queue.pop();
+    for (const auto &input_operand : current_op->input_operands) {
+      const auto &prev_op = reachable_ops.find(input_operand.first);
+      if (prev_op != reachable_ops.end() && ancestor_ops.insert(prev_op->second).second) {
+        visit_queue.push(prev_op->second);
+      }
+    }
+  }
+
+  // 每个节点需要等待所有输入操作数就绪之后才能执行
+  std::map<std::shared_ptr<RuntimeOperator>, uint32_t> in_degrees;
+  std::queue<std::shared_ptr<RuntimeOperator>> ready_queue;
+  ready_queue.push(input_op);
+
+  std::vector<std::shared_ptr<RuntimeOperator>> topo_operators;
+  uint32_t output_num = 0;
+  while (!ready_queue.empty()) {
+    const std::shared_ptr<RuntimeOperator> current_op = ready_queue.front();
+    ready_queue.pop();
+    if (std::find(output_ops.begin(), output_ops.end(), current_op) != output_ops.end()) {
+      output_num += 1;
+      continue;
+    }
+    topo_operators.push_back(current_op);
+
+    for (const auto &next_op : current_op->output_operators) {
+      const auto &next_rt_operator = next_op.second;
+      if (ancestor_ops.find(next_rt_operator) == ancestor_ops.end()
+          || next_rt_operator->input_operands.find(current_op->name) == next_rt_operator->input_operands.end()) {
+        continue;
+      }
+      uint32_t &in_degree = in_degrees[next_rt_operator];
+      in_degree += 1;
+      CHECK(in_degree <= next_rt_operator->input_operands.size());
+      if (in_degree == next_rt_operator->input_operands.size()) {
+        ready_queue.push(next_rt_operator);
+      }
+    }
+  }
+  LOG_IF(FATAL, output_num != output_ops.size())
+          << "Some output nodes depend on the nodes which can not be reached from the input node " << input_op->name;
+  // 输出节点按照给出的顺序放在执行序列的最后
+  topo_operators.insert(topo_operators.end(), output_ops.begin(), output_ops.end());
+  return topo_operators;
+}
+
+std::vector<std::vector<int32_t>> RuntimeGraph::InferOperatorShapes(const std::vector<int32_t> &input_shape) const {
+  std::vector<std::vector<int32_t>> output_shapes(topo_operators_.size());
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &current_op = topo_operators_.at(i);
+    if (current_op->type == "pnnx.Output" || current_op->output_operands == nullptr) {
+      continue;
+    }
+    if (current_op == input_operator_) {
+      output_shapes.at(i) = input_shape;
+      continue;
+    }
+    // 来源节点在执行序列中更早的位置，它们的输出形状已经推导完成
+    std::vector<std::vector<int32_t>> input_shapes;
+    for (const uint32_t input_index : topo_input_indexes_.at(i)) {
+      input_shapes.push_back(output_shapes.at(input_index));
+    }
+    std::vector<int32_t> &output_shape = output_shapes.at(i);
+    LOG_IF(FATAL, !current_op->layer->InferOutputShape(input_shapes, output_shape))
+            << "The layer " << current_op->name << " does not support the new input shape";
+    KUIPER_BUILD_CHECK(output_shape.size() == 2 || output_shape.size() == 3 || output_shape.size() == 4)
+            << "Unsupported shape sizes: " << output_shape.size();
+    KUIPER_BUILD_CHECK(output_shape.front() == input_shape.front())
+            << "The batch size can not be changed by a layer";
+  }
+  return output_shapes;
+}
+
+/**
+ * 把执行序列切分成连续的若干段，一个微批次在一段内所有节点输出的字节数不超过缓存的预算
+ * @param output_shapes 每个节点输出操作数的形状，第一维是batch
+ * @param micro_batch_size 每个微批次的样本数量
+ * @param cache_bytes 一个微批次在一段内的字节数上限
+ * @return 各段的边界，第一个是0，最后一个是节点的数量
+ */
+static std::vector<uint32_t> PartitionSegments(const std::vector<std::vector<int32_t>> &output_shapes,
+                                               uint32_t micro_batch_size, size_t cache_bytes) {
+  std::vector<uint32_t> segment_bounds = {0};
+  size_t segment_bytes = 0;
+  for (uint32_t i = 0; i < output_shapes.size(); ++i) {
+    const std::vector<int32_t> &output_shape = output_shapes.at(i);
+    const size_t op_bytes = output_shape.empty() ? 0 :
+                            std::accumulate(output_shape.begin() + 1, output_shape.end(), size_t(1),
+                                            std::multiplies<>()) * micro_batch_size * sizeof(float);
+    // 超过预算时从当前节点开始新的一段，单个节点超过预算时自己作为一段
+    if (segment_bytes + op_bytes > cache_bytes && i > segment_bounds.back()) {
+      segment_bounds.push_back(i);
+      segment_bytes = 0;
+    }
+    segment_bytes += op_bytes;
+  }
+  segment_bounds.push_back(output_shapes.size());
+  return segment_bounds;
+}
+
+/**
+ * 估计一个微批次在一段内可以使用的缓存字节数，每个线程独占的二级缓存加上共享的三级缓存
+ * 权重和Layer的临时内存也要占用缓存，中间张量只使用其中的一半
+ * @param thread_num 参与计算的线程数量
+ * @return 缓存的字节数
+ */
+static size_t MicroBatchCacheBytes(uint32_t thread_num) {
+  size_t cache_bytes = CpuCacheBytes(2) * thread_num + CpuCacheBytes(3);
+  if (cache_bytes == 0) {
+    cache_bytes = size_t(1024 * 1024) * thread_num;
+  }
+  return cache_bytes / 2;
+}
+
+void RuntimeGraph::CreatePlan(ExecutionContext &context, const std::vector<int32_t> &input_shape) const {
+  RuntimeGraphPlan plan;
+  plan.input_shape = input_shape;
+  plan.thread_num = ThreadPool::Current().thread_num();
+  plan.lazy_layer_num = lazy_layer_num();
+  // Build时的输入形状直接使用模型中记录的形状，其他输入形状由Layer推导
+  if (input_shape == input_operator_->output_operands->shapes) {
+    for (const auto &current_op : topo_operators_) {
+      const auto &output_operand = current_op->output_operands;
+      plan.output_shapes.push_back(output_operand ? output_operand->shapes : std::vector<int32_t>());
+    }
   } else {
-    return false;
+    plan.output_shapes = InferOperatorShapes(input_shape);
+  }
+
+  std::vector<std::vector<std::vector<int32_t>>> input_shapes(topo_operators_.size());
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    for (const uint32_t input_index : topo_input_indexes_.at(i)) {
+      input_shapes.at(i).push_back(plan.output_shapes.at(input_index));
+    }
+  }
+  // Layer按照规划的输入形状提前准备只读数据，推理时不再生成
+  for (uint32_t i = 0; i < topo_operators_.size(); ++i) {
+    const auto &layer = topo_operators_.at(i)->layer;
+    if (layer != nullptr) {
+      layer->PreparePlan(input_shapes.at(i));
+    }
+  }
+
+  // 微批次执行时同一段内的节点交替执行，段内的中间张量不复用内存
+  std::vector<uint32_t> op_segments;
+  if (micro_batch_size_ > 0 && !parallel_execute_ && device_op_num_ == 0
+      && input_shape.at(0) > int32_t(micro_batch_size_)) {
+    const size_t cache_bytes =
+        micro_batch_cache_bytes_ > 0 ? micro_batch_cache_bytes_ : MicroBatchCacheBytes(plan.thread_num);
+    plan.micro_batch_size = micro_batch_size_;
+    plan.segment_bounds = PartitionSegments(plan.output_shapes, micro_batch_size_, cache_bytes);
+    op_segments.resize(topo_operators_.size());
+    for (uint32_t s = 0; s + 1 < plan.segment_bounds.size(); ++s) {
+      std::fill(op_segments.begin() + plan.segment_bounds.at(s), op_segments.begin() + plan.segment_bounds.at(s + 1),
+                s);
+    }
+    LOG(INFO) << "Micro batch size: " << micro_batch_size_ << ", segments: " << plan.segment_bounds.size() - 1
+              << ", cache bytes: " << cache_bytes;
+  }
+
+  // 按照执行序列中张量的生命周期复用输出张量的内存，并行执行时只在有先后依赖的节点之间复用
+  plan.memory_planner.Plan(topo_operators_, plan.output_shapes, parallel_execute_, op_segments);
+  LOG(INFO) << "Memory plan: " << plan.memory_planner.slot_count() << " slots, planned bytes: "
+            << plan.memory_planner.planned_bytes() << " naive bytes: " << plan.memory_planner.naive_bytes();
+  // 所有Layer的临时内存在规划时一次分配，推理时不再申请内存
+  plan.memory_planner.PlanWorkspace(topo_operators_, input_shapes, parallel_execute_);
+  LOG(INFO) << "Workspace bytes: " << plan.memory_planner.workspace_bytes();
+  if (graph_metrics_.activation_bytes != nullptr) {
+    graph_metrics_.activation_bytes->Set(int64_t(plan.memory_planner.planned_bytes()));
+    graph_metrics_.workspace_bytes->Set(int64_t(plan.memory_planner.workspace_bytes()));
+  }
+
+  context.plans_.push_front(std::move(plan));
+  while (context.plans_.size() > context.plan_cache_size_) {
+    context.plans_.pop_back();
   }
 }
 
-void RuntimeGraph::ProbeNextLayer(const std::shared_ptr<RuntimeOperator> &current_op,
-                                  std::deque<std::shared_ptr<RuntimeOperator>> &operator_queue,
-                                  const std::vector<std::shared_ptr<Tensor<float>>> &layer_output_datas) {
-  const auto &next_ops = current_op->output_operators;
-  for (const auto &next_op : next_ops) {
-    const auto &next_rt_operator = next_op.second;
-    const auto &next_input_operands = next_rt_operator->input_operands;
-    if (next_input_operands.find(current_op->name) != next_input_operands.end()) {
-      SetOpInputData(layer_output_datas, next_input_operands.at(current_op->name)->datas);
-      const auto &iter = next_input_operands.find(current_op->name);
-      if (std::find(operator_queue.begin(), operator_queue.end(), next_rt_operator) == operator_queue.end()) {
-        next_rt_operator->meet_num += 1;
-        if (CheckOperatorReady(next_rt_operator)) {
-          operator_queue.push_back(next_rt_operator);
-        }
-        next_rt_operator->meet_num -= 1;
+void RuntimeGraph::SwitchPlan(ExecutionContext &context, const std::vector<int32_t> &input_shape) const {
+  const uint32_t thread_num = ThreadPool::Current().thread_num();
+  for (auto plan = context.plans_.begin(); plan != context.plans_.end(); ++plan) {
+    if (plan->input_shape == input_shape && plan->thread_num == thread_num) {
+      // 命中缓存时直接使用之前规划好的内存
+      context.plans_.splice(context.plans_.begin(), context.plans_, plan);
+      return;
+    }
+  }
+  CreatePlan(context, input_shape);
+}
+
+void RuntimeGraph::InitOperatorEdges(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+  // 先建立名称到节点的索引，每个节点只需要按照输出节点名称查找一次
+  std::unordered_map<std::string, std::shared_ptr<RuntimeOperator>> operators_maps;
+  operators_maps.reserve(operators.size());
+  for (const auto &op : operators) {
+    operators_maps.insert({op->name, op});
+  }
+  for (const auto &current_op : operators) {
+    current_op->output_operators.clear();
+    current_op->output_operators.reserve(current_op->output_names.size());
+    for (const auto &output_name : current_op->output_names) {
+      const auto &next_op = operators_maps.find(output_name);
+      if (next_op != operators_maps.end() && next_op->second != current_op) {
+        current_op->output_operators.insert({next_op->first, next_op->second});
       }
-      next_rt_operator->meet_num += 1;
     }
   }
 }
-}
\ No newline at end of file
+}
@@ -0,0 +1,496 @@
+#include "runtime/runtime_memory.hpp"
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+
+/// 输出操作数和内存块之间的对应关系
+struct RuntimeMemoryAssignment {
+  uint32_t op_index = 0; /// 节点在执行序列中的位置
+  uint32_t slot_index = 0; /// 分配到的内存块
+  size_t elem_size = 0; /// 每个batch张量的元素数量
+  size_t batch_stride = 0; /// 相邻batch张量起点之间的元素数量
+  size_t offset = 0; /// 第一个batch张量在内存块中的起点
+};
+
+/// 直接写入拼接节点输出中的来源节点
+struct RuntimeCatAlias {
+  int32_t cat_index = -1; /// 拼接节点在执行序列中的位置，为-1时表示不写入拼接节点的输出
+  size_t offset = 0; /// 在拼接节点每个batch张量中的起点
+};
+
+/**
+ * 找出可以直接写入拼接节点输出的来源节点，来源节点只被该拼接节点读取，并且在拼接的输入中只出现一次
+ * @param topo_operators 按照执行顺序排列的计算节点
+ * @param output_shapes 每个节点输出操作数的形状
+ * @param execute_indexes 节点名称和执行位置的对应关系
+ * @param share_inputs 每个节点的输出是否共享输入的内存，这样的节点不写入自己的输出张量
+ * @return 每个节点写入的拼接节点和位置
+ */
+static std::vector<RuntimeCatAlias> FindCatAliases(const std::vector<std::shared_ptr<RuntimeOperator>> &topo_operators,
+                                                   const std::vector<std::vector<int32_t>> &output_shapes,
+                                                   const std::map<std::string, uint32_t> &execute_indexes,
+                                                   const std::vector<bool> &share_inputs) {
+  std::vector<RuntimeCatAlias> aliases(topo_operators.size());
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    const auto &cat_op = topo_operators.at(i);
+    const std::vector<int32_t> &cat_shape = output_shapes.at(i);
+    if (cat_op->type != "torch.cat" || cat_op->layer == nullptr || cat_shape.size() != 4) {
+      continue;
+    }
+    const auto &dim_param = cat_op->params.find("dim");
+    if (dim_param == cat_op->params.end()) {
+      continue;
+    }
+    const auto dim = dynamic_cast<RuntimeParameterInt *>(dim_param->second);
+    if (dim == nullptr || (dim->value != 1 && dim->value != -3)) {
+      continue;
+    }
+
+    // 按照通道拼接时每个来源在输出张量中是连续的一段，起点是之前所有来源的元素数量之和
+    const size_t plane_size = size_t(cat_shape.at(2)) * cat_shape.at(3);
+    size_t offset = 0;
+    for (const auto &input_operand : cat_op->input_operands_seq) {
+      const auto &execute_index = execute_indexes.find(input_operand->name);
+      CHECK(execute_index != execute_indexes.end()) << "Can not find the input node: " << input_operand->name;
+      const uint32_t prev_index = execute_index->second;
+      const auto &prev_op = topo_operators.at(prev_index);
+      const std::vector<int32_t> &prev_shape = output_shapes.at(prev_index);
+      CHECK(prev_shape.size() == 4) << "The input shape of cat is error";
+      const uint32_t occurrences = std::count_if(cat_op->input_operands_seq.begin(), cat_op->input_operands_seq.end(),
+                                                 [&](const std::shared_ptr<RuntimeOperand> &operand) {
+                                                   return operand->name == input_operand->name;
+                                                 });
+      if (prev_op->layer != nullptr && !share_inputs.at(prev_index) && prev_op->type != "torch.cat"
+          && prev_op->output_operators.size() == 1
+          && occurrences == 1 && prev_shape.at(0) == cat_shape.at(0) && prev_shape.at(2) == cat_shape.at(2)
+          && prev_shape.at(3) == cat_shape.at(3) && aliases.at(prev_index).cat_index < 0) {
+        aliases.at(prev_index).cat_index = int32_t(i);
+        aliases.at(prev_index).offset = offset;
+      }
+      offset += size_t(prev_shape.at(1)) * plane_size;
+    }
+  }
+  return aliases;
+}
+
+void RuntimeMemoryPlanner::Plan(const std::vector<std::shared_ptr<RuntimeOperator>> &topo_operators,
+                                const std::vector<std::vector<int32_t>> &output_shapes, bool dependency_aware,
+                                const std::vector<uint32_t> &op_segments) {
+  slots_.clear();
+  device_slots_.clear();
+  slot_allocation_.Reset(0);
+  tensors_.assign(topo_operators.size(), {});
+  tensor_slots_.assign(topo_operators.size(), -1);
+  naive_bytes_ = 0;
+  if (topo_operators.empty()) {
+    LOG(ERROR) << "Operators for memory planning is empty!";
+    return;
+  }
+  CHECK(output_shapes.size() == topo_operators.size());
+  CHECK(op_segments.empty() || op_segments.size() == topo_operators.size());
+  // 分段内一个微批次的写入者可能在其他微批次的读取者之前执行，只有之前分段的读取者一定已经完成
+  auto op_segment = [&op_segments](uint32_t op_index) {
+    return op_segments.empty() ? op_index : op_segments.at(op_index);
+  };
+
+  std::map<std::string, uint32_t> execute_indexes;
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    execute_indexes.insert({topo_operators.at(i)->name, i});
+  }
+
+  // 并行执行时记录每个节点的全部祖先节点，只有祖先节点一定在当前节点开始之前完成
+  std::vector<std::vector<bool>> ancestors;
+  if (dependency_aware) {
+    ancestors.assign(topo_operators.size(), std::vector<bool>(topo_operators.size(), false));
+    for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+      for (const auto &input_operand : topo_operators.at(i)->input_operands) {
+        const auto &execute_index = execute_indexes.find(input_operand.first);
+        if (execute_index == execute_indexes.end()) {
+          continue;
+        }
+        const uint32_t prev_index = execute_index->second;
+        ancestors.at(i).at(prev_index) = true;
+        for (uint32_t j = 0; j < topo_operators.size(); ++j) {
+          if (ancestors.at(prev_index).at(j)) {
+            ancestors.at(i).at(j) = true;
+          }
+        }
+      }
+    }
+  }
+
+  // 输出共享输入内存的节点不分配内存块，例如view和flatten
+  std::vector<bool> share_inputs(topo_operators.size(), false);
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    const auto &current_op = topo_operators.at(i);
+    if (current_op->layer == nullptr || output_shapes.at(i).empty()) {
+      continue;
+    }
+    std::vector<std::vector<int32_t>> input_shapes;
+    for (const auto &input_operand : current_op->input_operands_seq) {
+      const auto &execute_index = execute_indexes.find(input_operand->name);
+      if (execute_index != execute_indexes.end() && !output_shapes.at(execute_index->second).empty()) {
+        input_shapes.push_back(output_shapes.at(execute_index->second));
+      }
+    }
+    if (!input_shapes.empty() && input_shapes.size() == current_op->input_operands_seq.size()) {
+      share_inputs.at(i) = current_op->layer->ShareInputMemory(input_shapes);
+    }
+  }
+
+  std::vector<size_t> slot_sizes; // 每个内存块需要容纳的元素数量
+  std::vector<std::vector<uint32_t>> slot_readers; // 内存块中当前张量的全部读取者
+  std::vector<RuntimeMemoryAssignment> assignments;
+
+  // 拼接节点的来源节点直接写入拼接输出中属于自己的一段，拼接节点执行时不再复制
+  const std::vector<RuntimeCatAlias> &cat_aliases = FindCatAliases(topo_operators, output_shapes, execute_indexes,
+                                                                     share_inputs);
+  std::vector<std::vector<uint32_t>> cat_writers(topo_operators.size());
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    if (cat_aliases.at(i).cat_index >= 0) {
+      cat_writers.at(cat_aliases.at(i).cat_index).push_back(i);
+    }
+  }
+  std::vector<int32_t> cat_slots(topo_operators.size(), -1);
+
+  // 为一个输出张量选择内存块，内存块中之前的张量的读取者必须在所有写入者开始之前完成
+  // 在已经空闲的内存块中优先选择能容纳该张量的最小块，都放不下时选择最大的块并扩大
+  auto select_slot = [&](size_t operand_size, const std::vector<uint32_t> &readers,
+                         const std::vector<uint32_t> &writers) {
+    int32_t best_slot = -1;
+    for (uint32_t s = 0; s < slot_sizes.size(); ++s) {
+      bool released = true;
+      for (const uint32_t reader : slot_readers.at(s)) {
+        for (const uint32_t writer : writers) {
+          if (dependency_aware ? !ancestors.at(writer).at(reader) : op_segment(reader) >= op_segment(writer)) {
+            released = false;
+            break;
+          }
+        }
+        if (!released) {
+          break;
+        }
+      }
+      if (!released) {
+        continue;
+      }
+      if (best_slot < 0) {
+        best_slot = int32_t(s);
+        continue;
+      }
+      const bool fit = slot_sizes.at(s) >= operand_size;
+      const bool best_fit = slot_sizes.at(best_slot) >= operand_size;
+      if (fit && (!best_fit || slot_sizes.at(s) < slot_sizes.at(best_slot))) {
+        best_slot = int32_t(s);
+      } else if (!fit && !best_fit && slot_sizes.at(s) > slot_sizes.at(best_slot)) {
+        best_slot = int32_t(s);
+      }
+    }
+
+    if (best_slot < 0) {
+      best_slot = int32_t(slot_sizes.size());
+      slot_sizes.push_back(operand_size);
+      slot_readers.push_back(readers);
+    } else {
+      slot_sizes.at(best_slot) = std::max(slot_sizes.at(best_slot), operand_size);
+      slot_readers.at(best_slot) = readers;
+    }
+    return uint32_t(best_slot);
+  };
+
+  // 输出张量的生命周期持续到所有读取它的后继节点执行完成，没有读取者时持续到写入完成
+  // 后继节点的输出共享这块内存时，后继节点的读取者也是这块内存的读取者
+  auto operator_readers = [&](uint32_t op_index) {
+    std::vector<uint32_t> readers;
+    std::vector<uint32_t> sharing_ops = {op_index};
+    while (!sharing_ops.empty()) {
+      const uint32_t sharing_op = sharing_ops.back();
+      sharing_ops.pop_back();
+      for (const auto &next_op : topo_operators.at(sharing_op)->output_operators) {
+        const auto &execute_index = execute_indexes.find(next_op.first);
+        if (execute_index != execute_indexes.end()) {
+          readers.push_back(execute_index->second);
+          if (share_inputs.at(execute_index->second)) {
+            sharing_ops.push_back(execute_index->second);
+          }
+        }
+      }
+    }
+    if (readers.empty()) {
+      readers.push_back(op_index);
+    }
+    return readers;
+  };
+
+  // 形状中除batch之外的元素数量
+  auto element_size = [](const std::vector<int32_t> &shapes) {
+    CHECK(shapes.size() == 2 || shapes.size() == 4 || shapes.size() == 3)
+            << "Unsupported shape sizes: " << shapes.size();
+    CHECK(shapes.at(0) > 0) << "The batch size of operand must be greater than zero";
+    size_t elem_size = 1;
+    for (uint32_t j = 1; j < shapes.size(); ++j) {
+      elem_size *= shapes.at(j);
+    }
+    return elem_size;
+  };
+
+  // 每个节点的输出张量所在的内存块，没有分配内存块的节点为-1
+  std::vector<int32_t> op_slots(topo_operators.size(), -1);
+  // 输入只被当前节点读取并且形状和输出相同时，支持原地计算的Layer直接改写输入所在的内存
+  auto in_place_input = [&](uint32_t op_index) {
+    const auto &current_op = topo_operators.at(op_index);
+    if (!current_op->layer->SupportInPlace() || current_op->input_operands_seq.size() != 1
+        || cat_aliases.at(op_index).cat_index >= 0 || cat_slots.at(op_index) >= 0) {
+      return -1;
+    }
+    const auto &execute_index = execute_indexes.find(current_op->input_operands_seq.front()->name);
+    if (execute_index == execute_indexes.end()) {
+      return -1;
+    }
+    const uint32_t prev_index = execute_index->second;
+    if (op_slots.at(prev_index) < 0 || cat_aliases.at(prev_index).cat_index >= 0
+        || output_shapes.at(prev_index) != output_shapes.at(op_index)) {
+      return -1;
+    }
+    // 前驱节点连接到计算图的输出节点时，它的输出在推理结束之后还会被读取
+    const auto &prev_output_operators = topo_operators.at(prev_index)->output_operators;
+    if (prev_output_operators.size() != 1 || prev_output_operators.begin()->first != current_op->name) {
+      return -1;
+    }
+    return int32_t(prev_index);
+  };
+
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    const auto &current_op = topo_operators.at(i);
+    const std::vector<int32_t> &shapes = output_shapes.at(i);
+    // 输入节点直接使用计算图的输入张量
+    if (current_op->layer == nullptr || shapes.empty()) {
+      continue;
+    }
+    const size_t elem_size = element_size(shapes);
+    naive_bytes_ += elem_size * shapes.at(0) * sizeof(float);
+    if (share_inputs.at(i)) {
+      // 输出张量在执行时由Layer建立在输入张量的内存上
+      tensors_.at(i).resize(shapes.at(0));
+      continue;
+    }
+
+    RuntimeMemoryAssignment assignment;
+    assignment.op_index = i;
+    assignment.elem_size = elem_size;
+    assignment.batch_stride = elem_size;
+    const int32_t cat_index = cat_aliases.at(i).cat_index;
+    if (cat_index >= 0) {
+      // 第一个来源节点执行之前为拼接节点的输出分配内存块，所有来源节点都是它的写入者
+      if (cat_slots.at(cat_index) < 0) {
+        std::vector<uint32_t> writers = cat_writers.at(cat_index);
+        writers.push_back(uint32_t(cat_index));
+        const size_t cat_elem_size = element_size(output_shapes.at(cat_index));
+        cat_slots.at(cat_index) = int32_t(select_slot(cat_elem_size * output_shapes.at(cat_index).at(0),
+                                                      operator_readers(cat_index), writers));
+      }
+      assignment.slot_index = uint32_t(cat_slots.at(cat_index));
+      assignment.batch_stride = element_size(output_shapes.at(cat_index));
+      assignment.offset = cat_aliases.at(i).offset;
+    } else if (cat_slots.at(i) >= 0) {
+      assignment.slot_index = uint32_t(cat_slots.at(i));
+    } else {
+      const int32_t in_place_index = in_place_input(i);
+      if (in_place_index >= 0) {
+        // 输入张量的唯一读取者就是当前节点，内存块之后的读取者换成当前节点的读取者
+        assignment.slot_index = uint32_t(op_slots.at(in_place_index));
+        slot_readers.at(assignment.slot_index) = operator_readers(i);
+      } else {
+        assignment.slot_index = select_slot(elem_size * shapes.at(0), operator_readers(i), {i});
+      }
+    }
+    op_slots.at(i) = int32_t(assignment.slot_index);
+    assignments.push_back(assignment);
+  }
+
+  slots_.resize(slot_sizes.size());
+  for (uint32_t s = 0; s < slot_sizes.size(); ++s) {
+    slots_.at(s).resize(slot_sizes.at(s));
+  }
+  slot_allocation_.Reset(planned_bytes());
+
+  for (const auto &assignment : assignments) {
+    const std::vector<int32_t> &shapes = output_shapes.at(assignment.op_index);
+    std::vector<std::shared_ptr<Tensor<float>>> &tensors = tensors_.at(assignment.op_index);
+    float *slot_ptr = slots_.at(assignment.slot_index).data();
+    tensor_slots_.at(assignment.op_index) = int32_t(assignment.slot_index);
+    tensors.resize(shapes.at(0));
+    for (uint32_t j = 0; j < tensors.size(); ++j) {
+      float *raw_ptr = slot_ptr + assignment.offset + j * assignment.batch_stride;
+      if (shapes.size() == 4) {
+        tensors.at(j) = std::make_shared<Tensor<float>>(raw_ptr, shapes.at(1), shapes.at(2), shapes.at(3));
+      } else if (shapes.size() == 2) {
+        tensors.at(j) = std::make_shared<Tensor<float>>(raw_ptr, 1, shapes.at(1), 1);
+      } else {
+        tensors.at(j) = std::make_shared<Tensor<float>>(raw_ptr, 1, shapes.at(1), shapes.at(2));
+      }
+    }
+  }
+}
+
+void RuntimeMemoryPlanner::PlanWorkspace(const std::vector<std::shared_ptr<RuntimeOperator>> &topo_operators,
+                                         const std::vector<std::vector<std::vector<int32_t>>> &input_shapes,
+                                         bool dependency_aware) {
+  CHECK(input_shapes.size() == topo_operators.size());
+  // 每个区域的起点按照16个float，也就是64字节对齐
+  const size_t align_size = 16;
+  std::vector<size_t> workspace_sizes(topo_operators.size(), 0);
+  size_t total_size = 0;
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    const auto &current_op = topo_operators.at(i);
+    if (current_op->layer == nullptr) {
+      continue;
+    }
+    const size_t workspace_size = (current_op->layer->WorkspaceSize(input_shapes.at(i)) + align_size - 1)
+        / align_size * align_size;
+    workspace_sizes.at(i) = workspace_size;
+    if (dependency_aware) {
+      total_size += workspace_size;
+    } else {
+      total_size = std::max(total_size, workspace_size);
+    }
+  }
+
+  workspace_.clear();
+  workspace_.shrink_to_fit();
+  workspaces_.assign(topo_operators.size(), RuntimeWorkspace());
+  workspace_size_ = total_size;
+  workspace_allocation_.Reset(0);
+  if (total_size == 0) {
+    return;
+  }
+  workspace_.resize(total_size + align_size);
+  workspace_allocation_.Reset(workspace_.size() * sizeof(float));
+  const uintptr_t address = reinterpret_cast<uintptr_t>(workspace_.data());
+  const uintptr_t align_bytes = align_size * sizeof(float);
+  float *workspace_ptr = reinterpret_cast<float *>((address + align_bytes - 1) / align_bytes * align_bytes);
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < topo_operators.size(); ++i) {
+    const auto &current_op = topo_operators.at(i);
+    if (current_op->layer == nullptr) {
+      continue;
+    }
+    const size_t workspace_size = workspace_sizes.at(i);
+    if (workspace_size != 0) {
+      workspaces_.at(i).workspace = workspace_ptr + offset;
+      workspaces_.at(i).workspace_size = workspace_size;
+    }
+    if (dependency_aware) {
+      offset += workspace_size;
+    }
+  }
+}
+
+const std::vector<std::shared_ptr<Tensor<float>>> &RuntimeMemoryPlanner::tensors(uint32_t op_index) const {
+  CHECK(op_index < tensors_.size()) << "The operator index is out of range of the memory plan";
+  return tensors_.at(op_index);
+}
+
+const RuntimeWorkspace &RuntimeMemoryPlanner::workspace(uint32_t op_index) const {
+  CHECK(op_index < workspaces_.size()) << "The operator index is out of range of the workspace plan";
+  return workspaces_.at(op_index);
+}
+
+size_t RuntimeMemoryPlanner::workspace_bytes() const {
+  return workspace_size_ * sizeof(float);
+}
+
+size_t RuntimeMemoryPlanner::planned_bytes() const {
+  size_t planned_bytes = 0;
+  for (const auto &slot : slots_) {
+    planned_bytes += slot.size() * sizeof(float);
+  }
+  return planned_bytes;
+}
+
+size_t RuntimeMemoryPlanner::naive_bytes() const {
+  return naive_bytes_;
+}
+
+uint32_t RuntimeMemoryPlanner::slot_count() const {
+  return slots_.size();
+}
+
+size_t RuntimeMemoryPlanner::slot_size(uint32_t slot_index) const {
+  CHECK(slot_index < slots_.size()) << "The slot index is out of range of the memory plan";
+  return slots_.at(slot_index).size();
+}
+
+int32_t RuntimeMemoryPlanner::TensorOffsets(uint32_t op_index, std::vector<size_t> &offsets) const {
+  CHECK(op_index < tensors_.size()) << "The operator index is out of range of the memory plan";
+  offsets.clear();
+  const int32_t slot_index = tensor_slots_.at(op_index);
+  if (slot_index < 0) {
+    return slot_index;
+  }
+  const float *slot_ptr = slots_.at(slot_index).data();
+  for (const auto &tensor : tensors_.at(op_index)) {
+    offsets.push_back(tensor->data().memptr() - slot_ptr);
+  }
+  return slot_index;
+}
+
+bool RuntimeMemoryPlanner::PlaceMemory(NumaMemoryPolicy policy, uint32_t node) const {
+  bool placed = true;
+  for (const auto &slot : slots_) {
+    placed = kuiper_infer::PlaceMemory(slot.data(), slot.size() * sizeof(float), policy, node) && placed;
+  }
+  return kuiper_infer::PlaceMemory(workspace_.data(), workspace_.size() * sizeof(float), policy, node) && placed;
+}
+
+void RuntimeMemoryPlanner::PlaceDeviceMemory() {
+  if (!device_slots_.empty() || slots_.empty()) {
+    return;
+  }
+  device_slots_.resize(slots_.size());
+  for (uint32_t s = 0; s < slots_.size(); ++s) {
+    device_slots_.at(s) = std::make_shared<DeviceBuffer>();
+    device_slots_.at(s)->Reserve(slots_.at(s).size());
+  }
+  // 张量在设备内存块中的偏移量和主机上相同，拼接输出和原地计算的共享关系在设备上同样成立
+  for (uint32_t i = 0; i < tensors_.size(); ++i) {
+    const int32_t slot_index = tensor_slots_.at(i);
+    if (slot_index < 0) {
+      continue;
+    }
+    const float *slot_ptr = slots_.at(slot_index).data();
+    for (const auto &tensor : tensors_.at(i)) {
+      const size_t offset = tensor->data().memptr() - slot_ptr;
+      tensor->set_cuda_buffer(DeviceBuffer::View(device_slots_.at(slot_index), offset, tensor->size()));
+    }
+  }
+}
+
+size_t RuntimeMemoryPlanner::device_bytes() const {
+  size_t device_bytes = 0;
+  for (const auto &device_slot : device_slots_) {
+    device_bytes += device_slot->size() * sizeof(float);
+  }
+  return device_bytes;
+}
+
+std::string RuntimeMemoryReport::ToString() const {
+  std::ostringstream table;
+  table << std::left << std::setw(32) << "Name" << std::setw(20) << "Type" << std::right << std::setw(16)
+        << "Activation(B)" << std::setw(16) << "Weight(B)" << std::setw(16) << "Scratch(B)" << "\n";
+  for (const OperatorMemory &op_memory : operators) {
+    table << std::left << std::setw(32) << op_memory.name << std::setw(20) << op_memory.type << std::right
+          << std::setw(16) << op_memory.activation_bytes << std::setw(16) << op_memory.weight_bytes << std::setw(16)
+          << op_memory.scratch_bytes << "\n";
+  }
+  table << "Planned activation bytes: " << activation_bytes << ", weight bytes: " << weight_bytes
+        << ", scratch bytes: " << scratch_bytes << ", current bytes: " << current_bytes << ", peak bytes: "
+        << peak_bytes << "\n";
+  return table.str();
+}
+}
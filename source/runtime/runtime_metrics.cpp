@@ -0,0 +1,289 @@
+#include "runtime/runtime_metrics.hpp"
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+#include "data/memory_tracker.hpp"
+
+namespace kuiper_infer {
+
+uint32_t MetricShardIndex() {
+  static std::atomic<uint32_t> next_index{0};
+  thread_local const uint32_t shard_index = next_index.fetch_add(1, std::memory_order_relaxed) % kMetricShardNum;
+  return shard_index;
+}
+
+void MetricCounter::Add(uint64_t value) {
+  shards_.at(MetricShardIndex()).value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricCounter::value() const {
+  uint64_t value = 0;
+  for (const Shard &shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+void MetricGauge::Set(int64_t value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+void MetricGauge::Add(int64_t value) {
+  value_.fetch_add(value, std::memory_order_relaxed);
+}
+
+int64_t MetricGauge::value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+uint64_t HistogramSnapshot::ValueAtQuantile(double quantile) const {
+  if (count == 0) {
+    return 0;
+  }
+  quantile = std::min(std::max(quantile, 0.), 1.);
+  // 第rank个记录所在的桶，rank从1开始
+  const uint64_t rank = std::max(uint64_t(1), uint64_t(std::ceil(quantile * double(count))));
+  uint64_t accumulated = 0;
+  for (uint32_t i = 0; i < counts.size(); ++i) {
+    accumulated += counts.at(i);
+    if (accumulated >= rank) {
+      return std::min(LatencyHistogram::BucketUpperBound(i), max_ns);
+    }
+  }
+  return max_ns;
+}
+
+double HistogramSnapshot::mean_ns() const {
+  return count == 0 ? 0. : double(sum_ns) / double(count);
+}
+
+LatencyHistogram::~LatencyHistogram() {
+  for (auto &shard : shards_) {
+    delete shard.load();
+  }
+}
+
+uint32_t LatencyHistogram::BucketIndex(uint64_t nanoseconds) {
+  constexpr uint64_t kSubBucketNum = uint64_t(1) << kSubBucketBits;
+  if (nanoseconds < 2 * kSubBucketNum) {
+    return uint32_t(nanoseconds);
+  }
+  nanoseconds = std::min(nanoseconds, (uint64_t(1) << kMaxValueBits) - 1);
+  // 最高位在第msb位时，保留包括最高位在内的kSubBucketBits + 1位，区间内的桶宽度是2^exponent
+  const uint32_t msb = 63 - __builtin_clzll(nanoseconds);
+  const uint32_t exponent = msb - kSubBucketBits;
+  return (exponent << kSubBucketBits) + uint32_t(nanoseconds >> exponent);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(uint32_t bucket_index) {
+  constexpr uint32_t kSubBucketNum = 1u << kSubBucketBits;
+  if (bucket_index < 2 * kSubBucketNum) {
+    return bucket_index;
+  }
+  const uint32_t exponent = (bucket_index >> kSubBucketBits) - 1;
+  const uint64_t mantissa = (bucket_index & (kSubBucketNum - 1)) + kSubBucketNum;
+  return ((mantissa + 1) << exponent) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+  std::atomic<Shard *> &shard_ptr = shards_.at(MetricShardIndex());
+  Shard *shard = shard_ptr.load(std::memory_order_acquire);
+  if (shard == nullptr) {
+    // 同一分片上的多个线程同时第一次记录时只保留一个新分配的分片
+    Shard *new_shard = new Shard();
+    if (shard_ptr.compare_exchange_strong(shard, new_shard, std::memory_order_acq_rel)) {
+      shard = new_shard;
+    } else {
+      delete new_shard;
+    }
+  }
+  shard->counts.at(BucketIndex(nanoseconds)).fetch_add(1, std::memory_order_relaxed);
+  shard->sum_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+  uint64_t max_ns = shard->max_ns.load(std::memory_order_relaxed);
+  while (nanoseconds > max_ns && !shard->max_ns.compare_exchange_weak(max_ns, nanoseconds,
+                                                                      std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  snapshot.counts.assign(kBucketNum, 0);
+  for (const auto &shard_ptr : shards_) {
+    const Shard *shard = shard_ptr.load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      continue;
+    }
+    for (uint32_t i = 0; i < kBucketNum; ++i) {
+      const uint64_t bucket_count = shard->counts.at(i).load(std::memory_order_relaxed);
+      snapshot.counts.at(i) += bucket_count;
+      snapshot.count += bucket_count;
+    }
+    snapshot.sum_ns += shard->sum_ns.load(std::memory_order_relaxed);
+    snapshot.max_ns = std::max(snapshot.max_ns, shard->max_ns.load(std::memory_order_relaxed));
+  }
+  return snapshot;
+}
+
+RuntimeMetrics::MetricFamily &RuntimeMetrics::Family(const std::string &name, const std::string &help,
+                                                     MetricType type) {
+  const auto &family_iter = families_.find(name);
+  if (family_iter != families_.end()) {
+    CHECK(family_iter->second.type == type) << "The metric " << name << " is registered with another type";
+    return family_iter->second;
+  }
+  MetricFamily &family = families_[name];
+  family.type = type;
+  family.help = help;
+  return family;
+}
+
+MetricCounter &RuntimeMetrics::Counter(const std::string &name, const std::string &help,
+                                       const MetricLabels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<MetricCounter> &counter = Family(name, help, MetricType::kCounter).counters[labels];
+  if (counter == nullptr) {
+    counter = std::make_unique<MetricCounter>();
+  }
+  return *counter;
+}
+
+MetricGauge &RuntimeMetrics::Gauge(const std::string &name, const std::string &help, const MetricLabels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<MetricGauge> &gauge = Family(name, help, MetricType::kGauge).gauges[labels];
+  if (gauge == nullptr) {
+    gauge = std::make_unique<MetricGauge>();
+  }
+  return *gauge;
+}
+
+LatencyHistogram &RuntimeMetrics::Histogram(const std::string &name, const std::string &help,
+                                            const MetricLabels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<LatencyHistogram> &histogram = Family(name, help, MetricType::kHistogram).histograms[labels];
+  if (histogram == nullptr) {
+    histogram = std::make_unique<LatencyHistogram>();
+  }
+  return *histogram;
+}
+
+/**
+ * 将标签格式化为{name="value",...}，标签值中的反斜杠、双引号和换行需要转义
+ * @param labels 指标的标签
+ * @param extra_name 额外的标签名，例如直方图的le，为空时没有额外的标签
+ * @param extra_value 额外的标签值
+ * @return 标签文本，没有标签时为空
+ */
+static std::string FormatLabels(const MetricLabels &labels, const std::string &extra_name = "",
+                                const std::string &extra_value = "") {
+  if (labels.empty() && extra_name.empty()) {
+    return "";
+  }
+  std::string text = "{";
+  auto append_label = [&text](const std::string &name, const std::string &value) {
+    if (text.size() > 1) {
+      text += ",";
+    }
+    text += name + "=\"";
+    for (const char c : value) {
+      if (c == '\\' || c == '"') {
+        text.push_back('\\');
+        text.push_back(c);
+      } else if (c == '\n') {
+        text += "\\n";
+      } else {
+        text.push_back(c);
+      }
+    }
+    text += "\"";
+  };
+  for (const auto &label : labels) {
+    append_label(label.first, label.second);
+  }
+  if (!extra_name.empty()) {
+    append_label(extra_name, extra_value);
+  }
+  return text + "}";
+}
+
+/**
+ * 返回导出直方图时使用的桶边界，1微秒到68秒之间每个2的幂次区间的四等分点，都和直方图的桶边界对齐
+ * @return 边界，单位为纳秒
+ */
+static const std::vector<uint64_t> &ExportBounds() {
+  static const std::vector<uint64_t> bounds = [] {
+    std::vector<uint64_t> bounds;
+    for (uint32_t exponent = 10; exponent < LatencyHistogram::kMaxValueBits; ++exponent) {
+      for (uint64_t quarter = 4; quarter < 8; ++quarter) {
+        bounds.push_back(quarter << (exponent - 2));
+      }
+    }
+    return bounds;
+  }();
+  return bounds;
+}
+
+std::string RuntimeMetrics::ExportPrometheus() const {
+  std::ostringstream stream;
+  stream.precision(9);
+  // 全局内存统计在导出时读取，不需要组件更新
+  const MemoryTracker &memory_tracker = MemoryTracker::GetInstance();
+  stream << "# HELP kuiper_memory_current_bytes Bytes currently held by tensors and execution plans\n"
+         << "# TYPE kuiper_memory_current_bytes gauge\n"
+         << "kuiper_memory_current_bytes " << memory_tracker.current_bytes() << "\n"
+         << "# HELP kuiper_memory_peak_bytes Peak bytes held by tensors and execution plans\n"
+         << "# TYPE kuiper_memory_peak_bytes gauge\n"
+         << "kuiper_memory_peak_bytes " << memory_tracker.peak_bytes() << "\n";
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &family_iter : families_) {
+    const std::string &name = family_iter.first;
+    const MetricFamily &family = family_iter.second;
+    stream << "# HELP " << name << " " << family.help << "\n";
+    switch (family.type) {
+      case MetricType::kCounter: {
+        stream << "# TYPE " << name << " counter\n";
+        for (const auto &counter : family.counters) {
+          stream << name << FormatLabels(counter.first) << " " << counter.second->value() << "\n";
+        }
+        break;
+      }
+      case MetricType::kGauge: {
+        stream << "# TYPE " << name << " gauge\n";
+        for (const auto &gauge : family.gauges) {
+          stream << name << FormatLabels(gauge.first) << " " << gauge.second->value() << "\n";
+        }
+        break;
+      }
+      case MetricType::kHistogram: {
+        stream << "# TYPE " << name << " histogram\n";
+        for (const auto &histogram : family.histograms) {
+          const HistogramSnapshot &snapshot = histogram.second->Snapshot();
+          // 桶的上界小于导出边界的记录都计入这个边界
+          uint64_t accumulated = 0;
+          uint32_t bucket_index = 0;
+          for (const uint64_t bound : ExportBounds()) {
+            while (bucket_index < LatencyHistogram::kBucketNum &&
+                LatencyHistogram::BucketUpperBound(bucket_index) < bound) {
+              accumulated += snapshot.counts.at(bucket_index);
+              bucket_index += 1;
+            }
+            std::ostringstream bound_text;
+            bound_text.precision(9);
+            bound_text << double(bound) * 1e-9;
+            stream << name << "_bucket" << FormatLabels(histogram.first, "le", bound_text.str()) << " "
+                   << accumulated << "\n";
+          }
+          stream << name << "_bucket" << FormatLabels(histogram.first, "le", "+Inf") << " " << snapshot.count
+                 << "\n";
+          stream << name << "_sum" << FormatLabels(histogram.first) << " " << double(snapshot.sum_ns) * 1e-9
+                 << "\n";
+          stream << name << "_count" << FormatLabels(histogram.first) << " " << snapshot.count << "\n";
+        }
+        break;
+      }
+    }
+  }
+  return stream.str();
+}
+}
@@ -0,0 +1,951 @@
+#include "runtime/runtime_pass.hpp"
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <glog/logging.h>
+#include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/activation.hpp"
+
+namespace kuiper_infer {
+GraphPass::GraphPass(std::string name) : name_(std::move(name)) {
+
+}
+
+const std::string &GraphPass::name() const {
+  return this->name_;
+}
+
+/**
+ * 读取节点中的float类型属性，半精度的属性展开为float
+ * @param op 计算节点
+ * @param name 属性的名称
+ * @param values 属性的值
+ * @return 是否存在该属性
+ */
+static bool GetFloatAttribute(const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+                              std::vector<float> &values) {
+  const auto &attr = op->attribute.find(name);
+  if (attr == op->attribute.end() || attr->second == nullptr || attr->second->weight_bytes() == 0) {
+    return false;
+  }
+  const RuntimeDataType type = attr->second->type;
+  if (type != RuntimeDataType::kTypeFloat32 && type != RuntimeDataType::kTypeFloat16
+      && type != RuntimeDataType::kTypeBFloat16) {
+    return false;
+  }
+  values = attr->second->get<float>();
+  return true;
+}
+
+/**
+ * 写入节点中的float类型属性，属性不存在时新建
+ * @param op 计算节点
+ * @param name 属性的名称
+ * @param shape 属性的形状
+ * @param values 属性的值
+ */
+static void SetFloatAttribute(const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+                              const std::vector<int> &shape, const std::vector<float> &values) {
+  std::shared_ptr<RuntimeAttribute> &attr = op->attribute[name];
+  if (attr == nullptr) {
+    attr = std::make_shared<RuntimeAttribute>();
+  }
+  attr->type = RuntimeDataType::kTypeFloat32;
+  attr->shape = shape;
+  attr->mapped_data.reset();
+  attr->mapped_size = 0;
+  attr->weight_data.resize(values.size() * sizeof(float));
+  memcpy(attr->weight_data.data(), values.data(), attr->weight_data.size());
+}
+
+/**
+ * 将只有一个输入的计算节点合并到它的前驱节点中，后继节点改为直接读取前驱节点的输出
+ * @param prev_op 前驱节点
+ * @param op 被合并的节点
+ */
+static void MergeIntoPrevOperator(const std::shared_ptr<RuntimeOperator> &prev_op,
+                                  const std::shared_ptr<RuntimeOperator> &op) {
+  prev_op->output_names = op->output_names;
+  prev_op->output_operators = op->output_operators;
+  for (const auto &next_op : op->output_operators) {
+    auto &next_input_operands = next_op.second->input_operands;
+    const auto &next_input_operand = next_input_operands.find(op->name);
+    if (next_input_operand == next_input_operands.end()) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperand> operand = next_input_operand->second;
+    next_input_operands.erase(next_input_operand);
+    operand->name = prev_op->name;
+    next_input_operands.insert({prev_op->name, operand});
+  }
+  op->output_operators.clear();
+}
+
+/**
+ * 删除节点和前驱节点之间的连接，前驱节点不再输出到该节点
+ * @param prev_op 前驱节点
+ * @param op 计算节点
+ */
+static void DisconnectOperator(const std::shared_ptr<RuntimeOperator> &prev_op,
+                               const std::shared_ptr<RuntimeOperator> &op) {
+  prev_op->output_operators.erase(op->name);
+  auto &output_names = prev_op->output_names;
+  output_names.erase(std::remove(output_names.begin(), output_names.end(), op->name), output_names.end());
+}
+
+/**
+ * 从计算节点中删除一组节点，剩余节点的顺序不变
+ * @param operators 计算图中的计算节点
+ * @param removed_operators 需要删除的节点
+ */
+static void EraseOperators(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                           const std::vector<std::shared_ptr<RuntimeOperator>> &removed_operators) {
+  const std::set<std::shared_ptr<RuntimeOperator>> removed_set(removed_operators.begin(), removed_operators.end());
+  operators.erase(std::remove_if(operators.begin(), operators.end(),
+                                 [&](const std::shared_ptr<RuntimeOperator> &op) {
+                                   return removed_set.find(op) != removed_set.end();
+                                 }), operators.end());
+}
+
+/**
+ * 按照名称查找计算节点
+ * @param operators 计算图中的计算节点
+ * @param name 节点的名称
+ * @return 找到的节点，不存在时返回空
+ */
+static std::shared_ptr<RuntimeOperator> FindOperator(const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                                     const std::string &name) {
+  const auto &op = std::find_if(operators.begin(), operators.end(),
+                                [&](const std::shared_ptr<RuntimeOperator> &current_op) {
+                                  return current_op->name == name;
+                                });
+  return op == operators.end() ? nullptr : *op;
+}
+
+bool GraphPassContext::IsOutput(const std::string &name) const {
+  return std::find(output_names.begin(), output_names.end(), name) != output_names.end();
+}
+
+DeadNodeEliminationPass::DeadNodeEliminationPass() : GraphPass("dead_node_elimination") {
+
+}
+
+uint32_t DeadNodeEliminationPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                      const GraphPassContext &context) {
+  std::map<std::string, std::shared_ptr<RuntimeOperator>> operators_maps;
+  for (const auto &op : operators) {
+    operators_maps.insert({op->name, op});
+  }
+  // 从所有的输出节点沿着输入操作数反向遍历，能够到达的节点才会影响输出
+  std::set<std::string> live_names;
+  std::queue<std::shared_ptr<RuntimeOperator>> live_queue;
+  for (const auto &output_name : context.output_names) {
+    const auto &output_op = operators_maps.find(output_name);
+    if (output_op != operators_maps.end() && live_names.insert(output_name).second) {
+      live_queue.push(output_op->second);
+    }
+  }
+  if (live_queue.empty()) {
+    return 0;
+  }
+  while (!live_queue.empty()) {
+    const std::shared_ptr<RuntimeOperator> current_op = live_queue.front();
+    live_queue.pop();
+    for (const auto &input_operand : current_op->input_operands) {
+      const auto &prev_op = operators_maps.find(input_operand.first);
+      if (prev_op != operators_maps.end() && live_names.insert(prev_op->first).second) {
+        live_queue.push(prev_op->second);
+      }
+    }
+  }
+  // 输入节点即使没有连接到输出也保留，Build的时候统一报告错误
+  live_names.insert(context.input_name);
+
+  std::vector<std::shared_ptr<RuntimeOperator>> dead_operators;
+  for (const auto &op : operators) {
+    if (live_names.find(op->name) == live_names.end()) {
+      dead_operators.push_back(op);
+    }
+  }
+  for (const auto &dead_op : dead_operators) {
+    for (const auto &input_operand : dead_op->input_operands) {
+      const auto &prev_op = operators_maps.find(input_operand.first);
+      if (prev_op != operators_maps.end()) {
+        DisconnectOperator(prev_op->second, dead_op);
+      }
+    }
+    dead_op->output_operators.clear();
+  }
+  EraseOperators(operators, dead_operators);
+  return dead_operators.size();
+}
+
+IdentityEliminationPass::IdentityEliminationPass() : GraphPass("identity_elimination") {
+
+}
+
+/**
+ * 判断节点在推理时是否直接输出它的输入
+ * @param op 计算节点
+ * @return 是否是恒等节点
+ */
+static bool IsIdentityOperator(const std::shared_ptr<RuntimeOperator> &op) {
+  return op->type == "nn.Identity" || op->type == "nn.Dropout" || op->type == "nn.Dropout2d";
+}
+
+/**
+ * 判断节点是否只改变形状，不改变数据的行优先顺序
+ * @param op 计算节点
+ * @return 是否只改变形状
+ */
+static bool IsReshapeOperator(const std::shared_ptr<RuntimeOperator> &op) {
+  return op->type == "torch.flatten" || op->type == "Tensor.view" || op->type == "Tensor.reshape";
+}
+
+/**
+ * 删除只有一个输入的节点，后继节点改为直接读取前驱节点的输出
+ * 后继节点已经读取前驱节点的输出时，两个输入操作数无法区分，不做处理
+ * @param prev_op 前驱节点
+ * @param op 被删除的节点
+ * @return 是否删除
+ */
+static bool BypassOperator(const std::shared_ptr<RuntimeOperator> &prev_op,
+                           const std::shared_ptr<RuntimeOperator> &op) {
+  for (const auto &next_op : op->output_operators) {
+    if (next_op.second->input_operands.find(prev_op->name) != next_op.second->input_operands.end()) {
+      return false;
+    }
+  }
+  const std::shared_ptr<RuntimeOperand> input_operand = op->input_operands_seq.front();
+  DisconnectOperator(prev_op, op);
+  for (const auto &next_op : op->output_operators) {
+    auto &next_input_operands = next_op.second->input_operands;
+    const auto &next_input_operand = next_input_operands.find(op->name);
+    if (next_input_operand == next_input_operands.end()) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperand> operand = next_input_operand->second;
+    next_input_operands.erase(next_input_operand);
+    operand->name = prev_op->name;
+    operand->shapes = input_operand->shapes;
+    next_input_operands.insert({prev_op->name, operand});
+
+    prev_op->output_operators.insert({next_op.first, next_op.second});
+    auto &output_names = prev_op->output_names;
+    if (std::find(output_names.begin(), output_names.end(), next_op.first) == output_names.end()) {
+      output_names.push_back(next_op.first);
+    }
+  }
+  op->output_operators.clear();
+  op->input_operands.clear();
+  op->input_operands_seq.clear();
+  return true;
+}
+
+uint32_t IdentityEliminationPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                      const GraphPassContext &context) {
+  std::vector<std::shared_ptr<RuntimeOperator>> removed_operators;
+  for (const auto &op : operators) {
+    if (!IsIdentityOperator(op) && !IsReshapeOperator(op)) {
+      continue;
+    }
+    if (op->name == context.input_name || context.IsOutput(op->name) || op->output_operators.empty()
+        || op->input_operands.size() != 1 || op->input_operands_seq.size() != 1) {
+      continue;
+    }
+
+    bool removable = IsIdentityOperator(op);
+    if (!removable) {
+      // 输出形状和输入相同的展平和view什么都不做
+      const std::vector<int32_t> &input_shapes = op->input_operands_seq.front()->shapes;
+      removable = true;
+      for (const auto &next_op : op->output_operators) {
+        const auto &next_input_operand = next_op.second->input_operands.find(op->name);
+        if (next_input_operand == next_op.second->input_operands.end()
+            || next_input_operand->second->shapes != input_shapes) {
+          removable = false;
+          break;
+        }
+      }
+    }
+    if (!removable && op->output_operators.size() == 1) {
+      // 之后的view按照元素数量重新计算形状，不依赖这里得到的形状
+      const std::shared_ptr<RuntimeOperator> next_op = op->output_operators.begin()->second;
+      removable = next_op->type == "Tensor.view" && next_op->input_operands.size() == 1;
+    }
+    if (!removable) {
+      continue;
+    }
+
+    const std::shared_ptr<RuntimeOperator> prev_op = FindOperator(operators, op->input_operands_seq.front()->name);
+    if (prev_op == nullptr || !BypassOperator(prev_op, op)) {
+      continue;
+    }
+    removed_operators.push_back(op);
+  }
+  EraseOperators(operators, removed_operators);
+  return removed_operators.size();
+}
+
+ConstantFoldingPass::ConstantFoldingPass() : GraphPass("constant_folding") {
+
+}
+
+/**
+ * 将操作数的形状转换为批次大小为1时张量的通道、行和列
+ * @param shapes 操作数的形状，第一维是batch
+ * @param tensor_shapes 张量的通道、行和列
+ * @return 是否支持该形状
+ */
+static bool ConstantTensorShapes(const std::vector<int32_t> &shapes, std::vector<uint32_t> &tensor_shapes) {
+  if (shapes.size() < 2 || shapes.size() > 4 || shapes.front() != 1) {
+    return false;
+  }
+  for (const int32_t dim : shapes) {
+    if (dim <= 0) {
+      return false;
+    }
+  }
+  // 和执行时的布局一致，二维的操作数是一列
+  if (shapes.size() == 4) {
+    tensor_shapes = {uint32_t(shapes.at(1)), uint32_t(shapes.at(2)), uint32_t(shapes.at(3))};
+  } else if (shapes.size() == 3) {
+    tensor_shapes = {1, uint32_t(shapes.at(1)), uint32_t(shapes.at(2))};
+  } else {
+    tensor_shapes = {1, uint32_t(shapes.at(1)), 1};
+  }
+  return true;
+}
+
+/**
+ * 读取常量节点的值，常量节点只有一个属性
+ * @param op 常量节点
+ * @param values 常量的值
+ * @return 是否是float类型的常量节点
+ */
+static bool GetConstantValues(const std::shared_ptr<RuntimeOperator> &op, std::vector<float> &values) {
+  if (op->type != "pnnx.Attribute" || op->attribute.size() != 1) {
+    return false;
+  }
+  return GetFloatAttribute(op, op->attribute.begin()->first, values);
+}
+
+/**
+ * 在构建时执行输入全部是常量的节点
+ * @param op 计算节点
+ * @param const_operators 每个输入操作数对应的常量节点
+ * @param output_shape 输出操作数的形状
+ * @param output_values 输出的值
+ * @return 是否计算成功
+ */
+static bool FoldOperator(const std::shared_ptr<RuntimeOperator> &op,
+                         const std::vector<std::shared_ptr<RuntimeOperator>> &const_operators,
+                         std::vector<int32_t> &output_shape, std::vector<float> &output_values) {
+  std::shared_ptr<Layer> layer;
+  if (LayerRegisterer::CreateLayer(op, layer) != ParseParameterAttrStatus::kParameterAttrParseSuccess) {
+    return false;
+  }
+
+  std::vector<std::vector<int32_t>> input_shapes;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t i = 0; i < const_operators.size(); ++i) {
+    const std::vector<int32_t> &shapes = op->input_operands_seq.at(i)->shapes;
+    std::vector<uint32_t> tensor_shapes;
+    std::vector<float> values;
+    if (!ConstantTensorShapes(shapes, tensor_shapes) || !GetConstantValues(const_operators.at(i), values)
+        || values.size() != tensor_shapes.at(0) * tensor_shapes.at(1) * tensor_shapes.at(2)) {
+      return false;
+    }
+    std::shared_ptr<Tensor<float>> input =
+        std::make_shared<Tensor<float>>(tensor_shapes.at(0), tensor_shapes.at(1), tensor_shapes.at(2));
+    input->Fill(values);
+    inputs.push_back(input);
+    input_shapes.push_back(shapes);
+  }
+
+  // 需要临时内存的Layer由执行上下文提供内存，构建时不执行
+  std::vector<uint32_t> output_tensor_shapes;
+  if (layer->WorkspaceSize(input_shapes) != 0 || !layer->InferOutputShape(input_shapes, output_shape)
+      || !ConstantTensorShapes(output_shape, output_tensor_shapes)) {
+    return false;
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{
+      std::make_shared<Tensor<float>>(output_tensor_shapes.at(0), output_tensor_shapes.at(1),
+                                      output_tensor_shapes.at(2))};
+  if (layer->Forward(inputs, outputs) != InferStatus::kInferSuccess || outputs.front() == nullptr
+      || outputs.front()->channels() != output_tensor_shapes.at(0) || outputs.front()->rows() != output_tensor_shapes.at(1)
+      || outputs.front()->cols() != output_tensor_shapes.at(2)) {
+    return false;
+  }
+
+  const std::shared_ptr<Tensor<float>> &output = outputs.front();
+  output_values.clear();
+  output_values.reserve(output->size());
+  for (uint32_t c = 0; c < output->channels(); ++c) {
+    for (uint32_t r = 0; r < output->rows(); ++r) {
+      for (uint32_t col = 0; col < output->cols(); ++col) {
+        output_values.push_back(output->at(c, r, col));
+      }
+    }
+  }
+  return true;
+}
+
+uint32_t ConstantFoldingPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                  const GraphPassContext &context) {
+  uint32_t folded_num = 0;
+  // 折叠之后的节点成为新的常量，继续折叠读取它的节点，直到没有可以折叠的节点
+  bool folded = true;
+  while (folded) {
+    folded = false;
+    for (const auto &op : operators) {
+      if (op->type == "pnnx.Input" || op->type == "pnnx.Output" || op->type == "pnnx.Attribute"
+          || op->name == context.input_name || op->input_operands_seq.empty()
+          || op->input_operands.size() != op->input_operands_seq.size()) {
+        continue;
+      }
+      std::vector<std::shared_ptr<RuntimeOperator>> const_operators;
+      for (const auto &input_operand : op->input_operands_seq) {
+        const std::shared_ptr<RuntimeOperator> prev_op = FindOperator(operators, input_operand->name);
+        if (prev_op == nullptr || prev_op->type != "pnnx.Attribute") {
+          break;
+        }
+        const_operators.push_back(prev_op);
+      }
+      std::vector<int32_t> output_shape;
+      std::vector<float> output_values;
+      if (const_operators.size() != op->input_operands_seq.size()
+          || !FoldOperator(op, const_operators, output_shape, output_values)) {
+        continue;
+      }
+
+      // 节点改为保存计算结果的常量节点
+      for (const auto &const_op : const_operators) {
+        DisconnectOperator(const_op, op);
+      }
+      for (const auto &param : op->params) {
+        delete param.second;
+      }
+      op->params.clear();
+      op->attribute.clear();
+      op->input_operands.clear();
+      op->input_operands_seq.clear();
+      op->layer.reset();
+      op->type = "pnnx.Attribute";
+      SetFloatAttribute(op, "data", std::vector<int>(output_shape.begin(), output_shape.end()), output_values);
+      folded_num += 1;
+      folded = true;
+    }
+  }
+
+  // 删除不再被读取的常量节点
+  std::vector<std::shared_ptr<RuntimeOperator>> unused_operators;
+  for (const auto &op : operators) {
+    if (op->type == "pnnx.Attribute" && op->output_operators.empty() && !context.IsOutput(op->name)) {
+      unused_operators.push_back(op);
+    }
+  }
+  EraseOperators(operators, unused_operators);
+  return folded_num;
+}
+
+ConvBatchNormFusionPass::ConvBatchNormFusionPass() : GraphPass("conv_batchnorm_fusion") {
+
+}
+
+uint32_t ConvBatchNormFusionPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                      const GraphPassContext &context) {
+  uint32_t fused_num = 0;
+  std::vector<std::shared_ptr<RuntimeOperator>> fused_operators;
+  for (const auto &conv_op : operators) {
+    if (conv_op->type != "nn.Conv2d" || conv_op->output_operators.size() != 1) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperator> bn_op = conv_op->output_operators.begin()->second;
+    if (bn_op->type != "nn.BatchNorm2d" || bn_op->input_operands.size() != 1
+        || bn_op->input_operands.find(conv_op->name) == bn_op->input_operands.end()) {
+      continue;
+    }
+
+    const auto &eps_param = bn_op->params.find("eps");
+    const auto &use_bias_param = conv_op->params.find("bias");
+    if (eps_param == bn_op->params.end() || use_bias_param == conv_op->params.end()) {
+      continue;
+    }
+    const auto eps = dynamic_cast<RuntimeParameterFloat *>(eps_param->second);
+    const auto use_bias = dynamic_cast<RuntimeParameterBool *>(use_bias_param->second);
+    if (!eps || !use_bias) {
+      continue;
+    }
+
+    std::vector<float> mean;
+    std::vector<float> var;
+    std::vector<float> gamma;
+    std::vector<float> beta;
+    std::vector<float> weight;
+    if (!GetFloatAttribute(bn_op, "running_mean", mean) || !GetFloatAttribute(bn_op, "running_var", var)
+        || !GetFloatAttribute(bn_op, "weight", gamma) || !GetFloatAttribute(bn_op, "bias", beta)
+        || !GetFloatAttribute(conv_op, "weight", weight)) {
+      continue;
+    }
+
+    const uint32_t out_channel = mean.size();
+    if (out_channel == 0 || var.size() != out_channel || gamma.size() != out_channel
+        || beta.size() != out_channel || weight.size() % out_channel != 0) {
+      continue;
+    }
+    std::vector<float> bias(out_channel, 0.f);
+    if (use_bias->value && (!GetFloatAttribute(conv_op, "bias", bias) || bias.size() != out_channel)) {
+      continue;
+    }
+
+    // y = gamma * (conv(x) + b - mean) / sqrt(var + eps) + beta
+    // 等价于权重为w * scale，偏移量为(b - mean) * scale + beta的卷积，其中scale = gamma / sqrt(var + eps)
+    const uint32_t kernel_size = weight.size() / out_channel;
+    for (uint32_t k = 0; k < out_channel; ++k) {
+      const float scale = gamma.at(k) / std::sqrt(var.at(k) + eps->value);
+      for (uint32_t j = 0; j < kernel_size; ++j) {
+        weight.at(k * kernel_size + j) *= scale;
+      }
+      bias.at(k) = (bias.at(k) - mean.at(k)) * scale + beta.at(k);
+    }
+    SetFloatAttribute(conv_op, "weight", conv_op->attribute.at("weight")->shape, weight);
+    SetFloatAttribute(conv_op, "bias", {int(out_channel)}, bias);
+    use_bias->value = true;
+
+    MergeIntoPrevOperator(conv_op, bn_op);
+    fused_operators.push_back(bn_op);
+    fused_num += 1;
+  }
+
+  EraseOperators(operators, fused_operators);
+  return fused_num;
+}
+
+ActivationFusionPass::ActivationFusionPass() : GraphPass("activation_fusion") {
+
+}
+
+uint32_t ActivationFusionPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                   const GraphPassContext &context) {
+  uint32_t fused_num = 0;
+  std::vector<std::shared_ptr<RuntimeOperator>> fused_operators;
+  for (const auto &op : operators) {
+    if (op->type != "nn.Conv2d" && op->type != "nn.Linear") {
+      continue;
+    }
+    if (op->output_operators.size() != 1 || op->params.find("activation") != op->params.end()) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperator> activation_op = op->output_operators.begin()->second;
+    if (ActivationTypeFromOpType(activation_op->type) == ActivationType::kActivationNone) {
+      continue;
+    }
+    if (activation_op->input_operands.size() != 1
+        || activation_op->input_operands.find(op->name) == activation_op->input_operands.end()) {
+      continue;
+    }
+
+    // 激活函数记录在节点的参数中，创建Layer的时候读取
+    RuntimeParameterString *activation_param = new RuntimeParameterString;
+    activation_param->value = activation_op->type;
+    op->params.insert({"activation", activation_param});
+
+    MergeIntoPrevOperator(op, activation_op);
+    fused_operators.push_back(activation_op);
+    fused_num += 1;
+  }
+
+  EraseOperators(operators, fused_operators);
+  return fused_num;
+}
+
+/**
+ * 判断节点是否有整数数组类型的参数并且等于给定的值
+ * @param op 计算节点
+ * @param name 参数的名称
+ * @param value 期望的值
+ * @return 参数是否等于期望的值
+ */
+static bool IntArrayParamEquals(const std::shared_ptr<RuntimeOperator> &op, const std::string &name,
+                                const std::vector<int> &value) {
+  const auto &param = op->params.find(name);
+  if (param == op->params.end()) {
+    return false;
+  }
+  const auto int_array = dynamic_cast<RuntimeParameterIntArray *>(param->second);
+  return int_array != nullptr && int_array->value == value;
+}
+
+GlobalPoolingFusionPass::GlobalPoolingFusionPass() : GraphPass("global_pooling_fusion") {
+
+}
+
+uint32_t GlobalPoolingFusionPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                      const GraphPassContext &context) {
+  uint32_t fused_num = 0;
+  std::vector<std::shared_ptr<RuntimeOperator>> fused_operators;
+  for (const auto &pool_op : operators) {
+    if (pool_op->type != "nn.AdaptiveAvgPool2d" || !IntArrayParamEquals(pool_op, "output_size", {1, 1})) {
+      continue;
+    }
+    if (pool_op->input_operands_seq.size() != 1 || pool_op->output_operators.size() != 1) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperator> flatten_op = pool_op->output_operators.begin()->second;
+    if (flatten_op->type != "torch.flatten" || flatten_op->input_operands.size() != 1
+        || flatten_op->output_operators.size() != 1) {
+      continue;
+    }
+    // 池化之后的高和宽都是1，从通道维展平到最后一维的结果就是每个通道一个特征
+    const auto &start_dim = flatten_op->params.find("start_dim");
+    const auto &end_dim = flatten_op->params.find("end_dim");
+    if (start_dim == flatten_op->params.end() || end_dim == flatten_op->params.end()) {
+      continue;
+    }
+    const auto start_dim_param = dynamic_cast<RuntimeParameterInt *>(start_dim->second);
+    const auto end_dim_param = dynamic_cast<RuntimeParameterInt *>(end_dim->second);
+    if (!start_dim_param || !end_dim_param || start_dim_param->value != 1
+        || (end_dim_param->value != -1 && end_dim_param->value != 3)) {
+      continue;
+    }
+    const std::shared_ptr<RuntimeOperator> linear_op = flatten_op->output_operators.begin()->second;
+    if (linear_op->type != "nn.Linear" || linear_op->input_operands.size() != 1
+        || linear_op->input_operands.find(flatten_op->name) == linear_op->input_operands.end()
+        || linear_op->params.find("global_pooling") != linear_op->params.end()) {
+      continue;
+    }
+
+    // 全连接层改为直接读取池化节点的输入，池化节点的前驱节点改为输出到全连接层
+    const std::shared_ptr<RuntimeOperand> &input_operand = pool_op->input_operands_seq.front();
+    const std::shared_ptr<RuntimeOperator> prev_op = FindOperator(operators, input_operand->name);
+    if (prev_op == nullptr) {
+      continue;
+    }
+    auto &prev_output_operators = prev_op->output_operators;
+    prev_output_operators.erase(pool_op->name);
+    prev_output_operators.insert({linear_op->name, linear_op});
+    std::replace(prev_op->output_names.begin(), prev_op->output_names.end(), pool_op->name, linear_op->name);
+
+    linear_op->input_operands.clear();
+    linear_op->input_operands.insert({input_operand->name, input_operand});
+    linear_op->input_operands_seq = {input_operand};
+    RuntimeParameterBool *global_pooling_param = new RuntimeParameterBool;
+    global_pooling_param->value = true;
+    linear_op->params.insert({"global_pooling", global_pooling_param});
+
+    pool_op->output_operators.clear();
+    flatten_op->output_operators.clear();
+    fused_operators.push_back(pool_op);
+    fused_operators.push_back(flatten_op);
+    fused_num += 1;
+  }
+
+  EraseOperators(operators, fused_operators);
+  return fused_num;
+}
+
+SqueezeExcitationFusionPass::SqueezeExcitationFusionPass() : GraphPass("squeeze_excitation_fusion") {
+
+}
+
+/**
+ * 判断节点是否是只有一个后继节点、步长为1、没有填充和分组的1x1卷积
+ * @param op 计算节点
+ * @return 是否是这样的卷积
+ */
+static bool IsPointwiseConv(const std::shared_ptr<RuntimeOperator> &op) {
+  if (op == nullptr || op->type != "nn.Conv2d" || op->input_operands_seq.size() != 1
+      || op->output_operators.size() != 1) {
+    return false;
+  }
+  if (!IntArrayParamEquals(op, "kernel_size", {1, 1}) || !IntArrayParamEquals(op, "stride", {1, 1})
+      || !IntArrayParamEquals(op, "padding", {0, 0})) {
+    return false;
+  }
+  const auto &groups = op->params.find("groups");
+  if (groups != op->params.end()) {
+    const auto groups_param = dynamic_cast<RuntimeParameterInt *>(groups->second);
+    if (groups_param == nullptr || groups_param->value != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * 读取1x1卷积的权重和偏移量，没有偏移量时为0
+ * @param conv_op 卷积节点
+ * @param weight 按行优先排列的out_channels x in_channels权重
+ * @param bias 每个输出通道的偏移量
+ * @return 是否读取成功
+ */
+static bool GetPointwiseParams(const std::shared_ptr<RuntimeOperator> &conv_op, std::vector<float> &weight,
+                               std::vector<float> &bias) {
+  const auto &weight_attr = conv_op->attribute.find("weight");
+  if (weight_attr == conv_op->attribute.end() || weight_attr->second->shape.size() != 4
+      || !GetFloatAttribute(conv_op, "weight", weight)) {
+    return false;
+  }
+  const uint32_t out_channels = weight_attr->second->shape.at(0);
+  const auto &use_bias = conv_op->params.find("bias");
+  const auto use_bias_param =
+      use_bias == conv_op->params.end() ? nullptr : dynamic_cast<RuntimeParameterBool *>(use_bias->second);
+  if (use_bias_param != nullptr && use_bias_param->value) {
+    return GetFloatAttribute(conv_op, "bias", bias) && bias.size() == out_channels;
+  }
+  bias.assign(out_channels, 0.f);
+  return true;
+}
+
+uint32_t SqueezeExcitationFusionPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                          const GraphPassContext &context) {
+  uint32_t fused_num = 0;
+  std::vector<std::shared_ptr<RuntimeOperator>> fused_operators;
+  // 只有一个输入的节点的前驱节点
+  auto prev_operator = [&](const std::shared_ptr<RuntimeOperator> &op) -> std::shared_ptr<RuntimeOperator> {
+    if (op == nullptr || op->input_operands_seq.size() != 1) {
+      return nullptr;
+    }
+    return FindOperator(operators, op->input_operands_seq.front()->name);
+  };
+
+  for (const auto &mul_op : operators) {
+    if (mul_op->type != "pnnx.Expression" || mul_op->input_operands_seq.size() != 2
+        || mul_op->input_operands.size() != 2) {
+      continue;
+    }
+    const auto &expr = mul_op->params.find("expr");
+    const auto expr_param = expr == mul_op->params.end() ? nullptr
+                                                          : dynamic_cast<RuntimeParameterString *>(expr->second);
+    if (expr_param == nullptr || (expr_param->value != "mul(@0,@1)" && expr_param->value != "mul(@1,@0)")) {
+      continue;
+    }
+
+    // 两个输入中的一个是缩放系数，从它沿着前驱节点反向匹配到池化节点，池化的输入必须是另一个输入
+    for (uint32_t gate_index = 0; gate_index < 2; ++gate_index) {
+      const std::shared_ptr<RuntimeOperand> &input_operand = mul_op->input_operands_seq.at(1 - gate_index);
+      const std::shared_ptr<RuntimeOperand> &gate_operand = mul_op->input_operands_seq.at(gate_index);
+      std::vector<std::shared_ptr<RuntimeOperator>> chain;
+      std::shared_ptr<RuntimeOperator> current_op = FindOperator(operators, gate_operand->name);
+      // 激活函数已经合并到卷积中，或者是卷积之后唯一的节点
+      auto match_conv = [&](std::string &activation) -> std::shared_ptr<RuntimeOperator> {
+        if (current_op != nullptr && ActivationTypeFromOpType(current_op->type) != ActivationType::kActivationNone
+            && current_op->input_operands_seq.size() == 1 && current_op->output_operators.size() == 1) {
+          activation = current_op->type;
+          chain.push_back(current_op);
+          current_op = prev_operator(current_op);
+        }
+        if (!IsPointwiseConv(current_op)) {
+          return nullptr;
+        }
+        const auto &fused_activation = current_op->params.find("activation");
+        if (fused_activation != current_op->params.end()) {
+          const auto activation_param = dynamic_cast<RuntimeParameterString *>(fused_activation->second);
+          if (activation_param == nullptr || !activation.empty()) {
+            return nullptr;
+          }
+          activation = activation_param->value;
+        }
+        const std::shared_ptr<RuntimeOperator> conv_op = current_op;
+        chain.push_back(conv_op);
+        current_op = prev_operator(conv_op);
+        return conv_op;
+      };
+      std::string squeeze_activation;
+      std::string excite_activation;
+      const std::shared_ptr<RuntimeOperator> excite_conv = match_conv(excite_activation);
+      const std::shared_ptr<RuntimeOperator> squeeze_conv = excite_conv ? match_conv(squeeze_activation) : nullptr;
+      const std::shared_ptr<RuntimeOperator> pool_op = current_op;
+      if (squeeze_conv == nullptr || pool_op == nullptr || pool_op->type != "nn.AdaptiveAvgPool2d"
+          || !IntArrayParamEquals(pool_op, "output_size", {1, 1}) || pool_op->output_operators.size() != 1
+          || pool_op->input_operands_seq.size() != 1 || pool_op->input_operands_seq.front()->name != input_operand->name) {
+        continue;
+      }
+      const std::shared_ptr<RuntimeOperator> input_op = FindOperator(operators, input_operand->name);
+      std::vector<float> squeeze_weight;
+      std::vector<float> squeeze_bias;
+      std::vector<float> excite_weight;
+      std::vector<float> excite_bias;
+      if (input_op == nullptr || !GetPointwiseParams(squeeze_conv, squeeze_weight, squeeze_bias)
+          || !GetPointwiseParams(excite_conv, excite_weight, excite_bias)) {
+        continue;
+      }
+      const uint32_t squeeze_channels = squeeze_bias.size();
+      const uint32_t channels = excite_bias.size();
+      if (squeeze_weight.size() != size_t(squeeze_channels) * channels || excite_weight.size() != squeeze_weight.size()) {
+        continue;
+      }
+
+      // 乘法节点改为合并之后的节点，后继节点的连接不变，只保留池化的输入
+      for (const auto &param : mul_op->params) {
+        delete param.second;
+      }
+      mul_op->params.clear();
+      mul_op->attribute.clear();
+      mul_op->type = "kuiper.SqueezeExcitation";
+      for (const auto &activation : {std::make_pair("squeeze_activation", squeeze_activation),
+                                     std::make_pair("excite_activation", excite_activation)}) {
+        if (!activation.second.empty()) {
+          RuntimeParameterString *activation_param = new RuntimeParameterString;
+          activation_param->value = activation.second;
+          mul_op->params.insert({activation.first, activation_param});
+        }
+      }
+      SetFloatAttribute(mul_op, "squeeze_weight", {int(squeeze_channels), int(channels)}, squeeze_weight);
+      SetFloatAttribute(mul_op, "squeeze_bias", {int(squeeze_channels)}, squeeze_bias);
+      SetFloatAttribute(mul_op, "excite_weight", {int(channels), int(squeeze_channels)}, excite_weight);
+      SetFloatAttribute(mul_op, "excite_bias", {int(channels)}, excite_bias);
+      const std::shared_ptr<RuntimeOperand> kept_operand = input_operand;
+      mul_op->input_operands.erase(gate_operand->name);
+      mul_op->input_operands_seq = {kept_operand};
+
+      DisconnectOperator(input_op, pool_op);
+      chain.push_back(pool_op);
+      for (const auto &chain_op : chain) {
+        chain_op->output_operators.clear();
+        fused_operators.push_back(chain_op);
+      }
+      fused_num += 1;
+      break;
+    }
+  }
+
+  EraseOperators(operators, fused_operators);
+  return fused_num;
+}
+
+ResidualAddFusionPass::ResidualAddFusionPass() : GraphPass("residual_add_fusion") {
+
+}
+
+uint32_t ResidualAddFusionPass::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                    const GraphPassContext &context) {
+  uint32_t fused_num = 0;
+  std::vector<std::shared_ptr<RuntimeOperator>> fused_operators;
+  for (const auto &add_op : operators) {
+    if (add_op->type != "pnnx.Expression" || add_op->input_operands_seq.size() != 2
+        || add_op->input_operands.size() != 2) {
+      continue;
+    }
+    const auto &expr = add_op->params.find("expr");
+    const auto expr_param = expr == add_op->params.end() ? nullptr
+                                                          : dynamic_cast<RuntimeParameterString *>(expr->second);
+    if (expr_param == nullptr || (expr_param->value != "add(@0,@1)" && expr_param->value != "add(@1,@0)")) {
+      continue;
+    }
+    // 两个加数的形状相同时才不需要广播
+    if (add_op->input_operands_seq.at(0)->shapes != add_op->input_operands_seq.at(1)->shapes) {
+      continue;
+    }
+
+    for (uint32_t conv_index = 0; conv_index < 2; ++conv_index) {
+      const std::shared_ptr<RuntimeOperand> conv_operand = add_op->input_operands_seq.at(conv_index);
+      const std::shared_ptr<RuntimeOperand> residual_operand = add_op->input_operands_seq.at(1 - conv_index);
+      const std::shared_ptr<RuntimeOperator> conv_op = FindOperator(operators, conv_operand->name);
+      // 卷积的输出只被加法读取，合并之后加法的输入就不会再被其他节点看到
+      if (conv_op == nullptr || conv_op->type != "nn.Conv2d" || conv_op->output_operators.size() != 1
+          || conv_op->input_operands_seq.size() != 1 || conv_op->params.find("activation") != conv_op->params.end()
+          || conv_op->params.find("residual") != conv_op->params.end()) {
+        continue;
+      }
+      // 卷积的输入就是残差时两个输入操作数的名称相同，无法区分
+      if (conv_op->input_operands.find(residual_operand->name) != conv_op->input_operands.end()) {
+        continue;
+      }
+      const std::shared_ptr<RuntimeOperator> residual_op = FindOperator(operators, residual_operand->name);
+      if (residual_op == nullptr) {
+        continue;
+      }
+
+      // 残差改为卷积的第二个输入，产生残差的节点改为输出到卷积
+      RuntimeParameterBool *residual_param = new RuntimeParameterBool;
+      residual_param->value = true;
+      conv_op->params.insert({"residual", residual_param});
+      conv_op->input_operands.insert({residual_operand->name, residual_operand});
+      conv_op->input_operands_seq.push_back(residual_operand);
+      DisconnectOperator(residual_op, add_op);
+      residual_op->output_operators.insert({conv_op->name, conv_op});
+      residual_op->output_names.push_back(conv_op->name);
+      MergeIntoPrevOperator(conv_op, add_op);
+      fused_operators.push_back(add_op);
+
+      // 加法之后唯一的激活函数在加上残差之后计算
+      if (conv_op->output_operators.size() == 1) {
+        const std::shared_ptr<RuntimeOperator> activation_op = conv_op->output_operators.begin()->second;
+        if (ActivationTypeFromOpType(activation_op->type) != ActivationType::kActivationNone
+            && activation_op->input_operands.size() == 1
+            && activation_op->input_operands.find(conv_op->name) != activation_op->input_operands.end()) {
+          RuntimeParameterString *activation_param = new RuntimeParameterString;
+          activation_param->value = activation_op->type;
+          conv_op->params.insert({"activation", activation_param});
+          MergeIntoPrevOperator(conv_op, activation_op);
+          fused_operators.push_back(activation_op);
+        }
+      }
+      fused_num += 1;
+      break;
+    }
+  }
+
+  EraseOperators(operators, fused_operators);
+  return fused_num;
+}
+
+GraphPassManager GraphPassManager::Default() {
+  GraphPassManager pass_manager;
+  pass_manager.AddPass(std::make_shared<DeadNodeEliminationPass>());
+  pass_manager.AddPass(std::make_shared<IdentityEliminationPass>());
+  pass_manager.AddPass(std::make_shared<ConstantFoldingPass>());
+  // 在创建Layer之前将BatchNorm的参数合并到前面的卷积中，合并后的权重保存在卷积节点的属性中
+  pass_manager.AddPass(std::make_shared<ConvBatchNormFusionPass>());
+  // 卷积和全连接层之后的激活函数在计算偏移量的时候一起完成
+  pass_manager.AddPass(std::make_shared<ActivationFusionPass>());
+  // 分类网络头部的全局平均池化和展平在全连接层中完成
+  pass_manager.AddPass(std::make_shared<GlobalPoolingFusionPass>());
+  // 注意力模块的池化、两个1x1卷积和通道缩放合并为一个节点，需要在激活函数合并之后执行
+  pass_manager.AddPass(std::make_shared<SqueezeExcitationFusionPass>());
+  // 残差连接的加法和之后的激活函数合并到产生加数的卷积中
+  pass_manager.AddPass(std::make_shared<ResidualAddFusionPass>());
+  return pass_manager;
+}
+
+void GraphPassManager::AddPass(std::shared_ptr<GraphPass> pass) {
+  CHECK(pass != nullptr) << "The graph pass is empty";
+  this->passes_.push_back(std::move(pass));
+}
+
+bool GraphPassManager::RemovePass(const std::string &name) {
+  const auto &pass = std::find_if(passes_.begin(), passes_.end(),
+                                  [&](const std::shared_ptr<GraphPass> &current_pass) {
+                                    return current_pass->name() == name;
+                                  });
+  if (pass == passes_.end()) {
+    return false;
+  }
+  passes_.erase(pass);
+  return true;
+}
+
+void GraphPassManager::Clear() {
+  this->passes_.clear();
+}
+
+const std::vector<std::shared_ptr<GraphPass>> &GraphPassManager::passes() const {
+  return this->passes_;
+}
+
+uint32_t GraphPassManager::Run(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                               const GraphPassContext &context) const {
+  uint32_t changed_num = 0;
+  for (const auto &pass : passes_) {
+    const uint32_t pass_changed_num = pass->Run(operators, context);
+    LOG(INFO) << "Graph pass " << pass->name() << " changed " << pass_changed_num << " operators";
+    changed_num += pass_changed_num;
+  }
+  return changed_num;
+}
+}
@@ -0,0 +1,192 @@
+#include "runtime/runtime_pipeline.hpp"
+#include <utility>
+#include <chrono>
+#include <glog/logging.h>
+#include "runtime/numa.hpp"
+
+namespace kuiper_infer {
+/// 提交但还没有进入第一个阶段的请求最多的数量，队列满时提交请求的线程等待
+constexpr uint32_t kPipelineSubmitCapacity = 1024;
+
+/**
+ * 每个在途的请求都需要一个执行上下文：每个阶段正在处理一个，每个队列最多缓存capacity个
+ */
+static uint32_t PipelineContextNum(uint32_t stage_num, uint32_t queue_capacity) {
+  return stage_num + (stage_num - 1) * queue_capacity;
+}
+
+RuntimePipeline::RuntimePipeline(std::shared_ptr<RuntimeGraph> graph,
+                                 const std::vector<std::vector<uint32_t>> &core_groups, uint32_t queue_capacity)
+    : graph_(std::move(graph)), submitted_(kPipelineSubmitCapacity),
+      free_contexts_(PipelineContextNum(core_groups.size(), queue_capacity)) {
+  CHECK(graph_ != nullptr) << "The graph of pipeline is empty";
+  CHECK(!core_groups.empty()) << "The pipeline needs at least one stage";
+  CHECK(queue_capacity > 0) << "The queue capacity of pipeline must be greater than zero";
+  // 设备上的节点使用上下文自己的流异步执行，阶段之间只传递上下文时无法保证设备上的计算已经完成
+  CHECK(graph_->device_op_num_ == 0) << "The pipeline only supports graphs executed on CPU";
+
+  std::vector<uint32_t> stage_threads;
+  for (const auto &core_group : core_groups) {
+    CHECK(!core_group.empty()) << "The core group of a pipeline stage is empty";
+    stage_threads.push_back(core_group.size());
+  }
+  bounds_ = graph_->PartitionStages(stage_threads);
+
+  uint32_t max_thread_num = 0;
+  for (uint32_t s = 0; s < core_groups.size(); ++s) {
+    std::unique_ptr<Stage> stage = std::make_unique<Stage>();
+    stage->begin = bounds_.at(s);
+    stage->end = bounds_.at(s + 1);
+    stage->thread_pool = std::make_unique<ThreadPool>(core_groups.at(s).size(), core_groups.at(s));
+    if (s > 0) {
+      stage->requests = std::make_unique<SpscQueue<std::unique_ptr<PipelineRequest>>>(queue_capacity);
+    }
+    if (stage->thread_pool->thread_num() > max_thread_num) {
+      max_thread_num = stage->thread_pool->thread_num();
+      plan_pool_ = stage->thread_pool.get();
+    }
+    stages_.push_back(std::move(stage));
+  }
+
+  // 上下文第一次使用时在第一个阶段中按照线程最多的阶段规划执行计划，之后同样形状的请求都命中缓存
+  const uint32_t context_num = PipelineContextNum(stages_.size(), queue_capacity);
+  for (uint32_t i = 0; i < context_num; ++i) {
+    std::shared_ptr<ExecutionContext> context = std::make_shared<ExecutionContext>();
+    context->set_plan_cache_size(graph_->plan_cache_size());
+    CHECK(free_contexts_.Push(context));
+  }
+  for (uint32_t s = 0; s < stages_.size(); ++s) {
+    stages_.at(s)->thread = std::thread(&RuntimePipeline::StageLoop, this, s);
+  }
+  LOG(INFO) << "Pipeline with " << stages_.size() << " stages and " << context_num << " execution contexts";
+}
+
+RuntimePipeline::~RuntimePipeline() {
+  Stop();
+}
+
+std::vector<std::vector<uint32_t>> RuntimePipeline::SplitCores(uint32_t stage_num, const std::vector<uint32_t> &cpus) {
+  return SplitCpus(stage_num, cpus);
+}
+
+std::future<std::vector<std::shared_ptr<Tensor<float>>>> RuntimePipeline::Submit(
+    const std::vector<std::shared_ptr<Tensor<float>>> &inputs) {
+  auto promise = std::make_shared<std::promise<std::vector<std::shared_ptr<Tensor<float>>>>>();
+  std::future<std::vector<std::shared_ptr<Tensor<float>>>> future = promise->get_future();
+  Submit(inputs, [promise](const std::vector<std::shared_ptr<Tensor<float>>> &outputs) {
+    promise->set_value(outputs);
+  });
+  return future;
+}
+
+bool RuntimePipeline::Submit(const std::vector<std::shared_ptr<Tensor<float>>> &inputs, PipelineCallback callback) {
+  CHECK(!inputs.empty()) << "The inputs of request is empty";
+  CHECK(callback != nullptr) << "The callback of request is empty";
+  // 先登记再检查是否停止：第一个阶段只在停止之后看到没有登记的请求时才退出，
+  // 登记时还没有停止的请求一定会被处理，已经停止时撤销登记并立即以空的输出完成
+  pending_num_ += 1;
+  if (stop_) {
+    pending_num_ -= 1;
+    LOG(ERROR) << "The pipeline has been stopped, the request is rejected";
+    callback({});
+    return false;
+  }
+  std::unique_ptr<PipelineRequest> request = std::make_unique<PipelineRequest>();
+  request->inputs = inputs;
+  request->callback = std::move(callback);
+  while (!submitted_.Push(request)) {
+    std::this_thread::yield();
+  }
+  stages_.front()->waiter.Notify();
+  return true;
+}
+
+void RuntimePipeline::Stop() {
+  std::lock_guard<std::mutex> lock(stop_mutex_);
+  // 第一个阶段处理完剩余的请求之后退出，退出的通知沿着队列依次传给之后的阶段
+  stop_ = true;
+  stages_.front()->waiter.Notify();
+  for (const auto &stage : stages_) {
+    if (stage->thread.joinable()) {
+      stage->thread.join();
+    }
+  }
+}
+
+uint32_t RuntimePipeline::stage_num() const {
+  return stages_.size();
+}
+
+const std::vector<uint32_t> &RuntimePipeline::stage_bounds() const {
+  return bounds_;
+}
+
+uint64_t RuntimePipeline::request_num() const {
+  return request_num_;
+}
+
+void RuntimePipeline::PushRequest(uint32_t stage_index, std::unique_ptr<PipelineRequest> request) {
+  Stage &stage = *stages_.at(stage_index);
+  // 下一个阶段较慢时队列会满，等待它取走请求，上游的阶段因此自然地放慢
+  while (!stage.requests->Push(request)) {
+    std::this_thread::yield();
+  }
+  stage.waiter.Notify();
+}
+
+void RuntimePipeline::StageLoop(uint32_t stage_index) {
+  Stage &stage = *stages_.at(stage_index);
+  // 阶段线程在整个生命周期内只在自己的CPU上运行，Layer提交的并行任务也只交给这个阶段的线程池
+  ThreadPool::Scope thread_pool_scope(stage.thread_pool.get());
+  const bool last_stage = stage_index + 1 == stages_.size();
+  while (true) {
+    std::unique_ptr<PipelineRequest> request;
+    if (stage_index == 0) {
+      stage.waiter.Wait([this]() { return pending_num_ > 0 || stop_; });
+      if (!submitted_.Pop(request)) {
+        // 停止之后仍然处理完队列中剩余的请求
+        if (stop_ && pending_num_ == 0) {
+          break;
+        }
+        continue;
+      }
+      pending_num_ -= 1;
+      // 所有上下文都在途时等待最后一个阶段归还，等待的条件不能有副作用，它可能被检查多次
+      stage.waiter.Wait([this]() { return !free_contexts_.empty(); });
+      CHECK(free_contexts_.Pop(request->context));
+      request->start = std::chrono::steady_clock::now();
+      ThreadPool::Scope plan_scope(plan_pool_ != stage.thread_pool.get() ? plan_pool_ : nullptr);
+      graph_->PrepareForward(*request->context, request->inputs);
+    } else {
+      stage.waiter.Wait([&stage]() { return !stage.requests->empty(); });
+      CHECK(stage.requests->Pop(request));
+      if (request == nullptr) {
+        break;
+      }
+    }
+
+    graph_->ExecuteRange(*request->context, request->inputs, stage.begin, stage.end);
+    if (!last_stage) {
+      PushRequest(stage_index + 1, std::move(request));
+      continue;
+    }
+
+    // 输出张量在上下文的内存中，上下文归还之后会被之后的请求覆盖，所以拷贝一份交给请求
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs =
+        graph_->FinishForward(*request->context, request->inputs);
+    graph_->RecordForward(*request->context, request->inputs.size(), request->start);
+    std::vector<std::shared_ptr<Tensor<float>>> request_outputs;
+    request_outputs.reserve(outputs.size());
+    for (const auto &output : outputs) {
+      request_outputs.push_back(std::make_shared<Tensor<float>>(*output));
+    }
+    CHECK(free_contexts_.Push(request->context));
+    stages_.front()->waiter.Notify();
+    request_num_ += 1;
+    request->callback(request_outputs);
+  }
+  if (!last_stage) {
+    PushRequest(stage_index + 1, nullptr);
+  }
+}
+}
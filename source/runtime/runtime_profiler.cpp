@@ -0,0 +1,218 @@
+#include "runtime/runtime_profiler.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+
+double OperatorProfile::duration_us() const {
+  return end_us - start_us;
+}
+
+double OperatorProfile::gflops() const {
+  const double duration = duration_us();
+  if (duration <= 0.) {
+    return 0.;
+  }
+  return double(flops) / duration * 1e-3;
+}
+
+/**
+ * 将形状转换为[1,3,224,224]形式的文本
+ * @param shape 操作数的形状
+ * @return 形状的文本
+ */
+static std::string ShapeToString(const std::vector<int32_t> &shape) {
+  std::ostringstream stream;
+  stream << "[";
+  for (uint32_t i = 0; i < shape.size(); ++i) {
+    stream << (i ? "," : "") << shape.at(i);
+  }
+  stream << "]";
+  return stream.str();
+}
+
+/**
+ * 转义json字符串中的特殊字符
+ * @param text 原始的文本
+ * @return 可以直接放在json双引号之间的文本
+ */
+static std::string JsonEscape(const std::string &text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (uint8_t(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      escaped += buffer;
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+RuntimeProfiler::RuntimeProfiler() : start_time_(std::chrono::steady_clock::now()) {
+
+}
+
+double RuntimeProfiler::Now() const {
+  return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+      std::chrono::steady_clock::now() - start_time_).count();
+}
+
+bool RuntimeProfiler::set_hardware_counters(bool hardware_counters) {
+  if (hardware_counters && !HardwareCounters::ThreadLocal().available()) {
+    LOG(WARNING) << "The hardware counters are not available, profile without them";
+    hardware_counters = false;
+  }
+  hardware_counters_ = hardware_counters;
+  return hardware_counters;
+}
+
+bool RuntimeProfiler::hardware_counters() const {
+  return hardware_counters_;
+}
+
+void RuntimeProfiler::Record(OperatorProfile profile) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto &thread_index = thread_indexes_.insert({std::this_thread::get_id(), thread_indexes_.size()});
+  profile.thread_index = thread_index.first->second;
+  records_.push_back(std::move(profile));
+}
+
+void RuntimeProfiler::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.clear();
+}
+
+std::vector<OperatorProfile> RuntimeProfiler::records() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_;
+}
+
+bool RuntimeProfiler::ExportChromeTrace(const std::string &path) const {
+  std::ofstream trace_file(path, std::ios::out | std::ios::trunc);
+  if (!trace_file.is_open()) {
+    LOG(ERROR) << "Can not open the trace file: " << path;
+    return false;
+  }
+
+  const std::vector<OperatorProfile> &profiles = records();
+  // 每个节点是一个完整事件，ts和dur的单位是微秒，shapes和计算量放在args中
+  trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  trace_file << std::fixed << std::setprecision(3);
+  for (uint32_t i = 0; i < profiles.size(); ++i) {
+    const OperatorProfile &profile = profiles.at(i);
+    std::string input_shapes;
+    for (uint32_t j = 0; j < profile.input_shapes.size(); ++j) {
+      input_shapes += (j ? "," : "") + ShapeToString(profile.input_shapes.at(j));
+    }
+    trace_file << (i ? ",\n" : "\n") << "{\"name\":\"" << JsonEscape(profile.name) << "\",\"cat\":\""
+               << JsonEscape(profile.type) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << profile.thread_index
+               << ",\"ts\":" << profile.start_us << ",\"dur\":" << profile.duration_us()
+               << ",\"args\":{\"input_shapes\":\"" << input_shapes << "\",\"output_shape\":\""
+               << ShapeToString(profile.output_shape) << "\",\"flops\":" << profile.flops
+               << ",\"bytes\":" << profile.bytes << ",\"gflops\":" << profile.gflops()
+               << ",\"activation_bytes\":" << profile.activation_bytes << ",\"weight_bytes\":"
+               << profile.weight_bytes << ",\"scratch_bytes\":" << profile.scratch_bytes;
+    if (profile.has_hardware_counters) {
+      const HardwareCounterValues &counters = profile.hardware_counters;
+      const double ipc = counters.cycles ? double(counters.instructions) / double(counters.cycles) : 0.;
+      trace_file << ",\"cycles\":" << counters.cycles << ",\"instructions\":" << counters.instructions
+                 << ",\"ipc\":" << ipc << ",\"llc_misses\":" << counters.llc_misses
+                 << ",\"vector_instructions\":" << counters.vector_instructions;
+    }
+    trace_file << "}}";
+    // 计数器事件在时间线上画出节点执行完成时持有的内存
+    trace_file << ",\n{\"name\":\"memory\",\"ph\":\"C\",\"pid\":0,\"ts\":" << profile.end_us
+               << ",\"args\":{\"current_bytes\":" << profile.current_bytes << "}}";
+  }
+  trace_file << "\n]}\n";
+  trace_file.close();
+  if (trace_file.fail()) {
+    LOG(ERROR) << "Write the trace file failed: " << path;
+    return false;
+  }
+  return true;
+}
+
+std::string RuntimeProfiler::TopOperators(uint32_t top_n) const {
+  /// 同一个节点多次执行的汇总结果
+  struct OperatorSummary {
+    std::string name;
+    std::string type;
+    uint32_t calls = 0;
+    double total_us = 0.;
+    uint64_t flops = 0;
+    uint64_t bytes = 0;
+    HardwareCounterValues hardware_counters;
+  };
+
+  std::vector<OperatorSummary> summaries;
+  std::map<std::string, uint32_t> summary_indexes;
+  bool has_hardware_counters = false;
+  for (const OperatorProfile &profile : records()) {
+    const auto &summary_index = summary_indexes.insert({profile.name, summaries.size()});
+    if (summary_index.second) {
+      OperatorSummary summary;
+      summary.name = profile.name;
+      summary.type = profile.type;
+      summaries.push_back(summary);
+    }
+    OperatorSummary &summary = summaries.at(summary_index.first->second);
+    summary.calls += 1;
+    summary.total_us += profile.duration_us();
+    summary.flops += profile.flops;
+    summary.bytes += profile.bytes;
+    if (profile.has_hardware_counters) {
+      has_hardware_counters = true;
+      summary.hardware_counters.cycles += profile.hardware_counters.cycles;
+      summary.hardware_counters.instructions += profile.hardware_counters.instructions;
+      summary.hardware_counters.llc_misses += profile.hardware_counters.llc_misses;
+      summary.hardware_counters.vector_instructions += profile.hardware_counters.vector_instructions;
+    }
+  }
+  std::stable_sort(summaries.begin(), summaries.end(), [](const OperatorSummary &a, const OperatorSummary &b) {
+    return a.total_us > b.total_us;
+  });
+  if (top_n != 0 && summaries.size() > top_n) {
+    summaries.resize(top_n);
+  }
+
+  std::ostringstream table;
+  table << std::left << std::setw(32) << "Name" << std::setw(20) << "Type" << std::right << std::setw(8) << "Calls"
+        << std::setw(14) << "Total(ms)" << std::setw(12) << "Avg(ms)" << std::setw(12) << "GFLOP/s"
+        << std::setw(12) << "FLOP/Byte";
+  // IPC低并且每千条指令的LLC缺失多的节点受限于访存，向量指令占比低的节点没有充分向量化
+  if (has_hardware_counters) {
+    table << std::setw(8) << "IPC" << std::setw(12) << "LLC/KInst" << std::setw(12) << "Vector(%)";
+  }
+  table << "\n";
+  table << std::fixed;
+  for (const OperatorSummary &summary : summaries) {
+    const double gflops = summary.total_us > 0. ? double(summary.flops) / summary.total_us * 1e-3 : 0.;
+    const double intensity = summary.bytes > 0 ? double(summary.flops) / double(summary.bytes) : 0.;
+    table << std::left << std::setw(32) << summary.name << std::setw(20) << summary.type << std::right
+          << std::setw(8) << summary.calls << std::setprecision(3) << std::setw(14) << summary.total_us * 1e-3
+          << std::setw(12) << summary.total_us * 1e-3 / summary.calls << std::setprecision(2) << std::setw(12)
+          << gflops << std::setw(12) << intensity;
+    if (has_hardware_counters) {
+      const HardwareCounterValues &counters = summary.hardware_counters;
+      const double instructions = double(counters.instructions);
+      table << std::setw(8) << (counters.cycles ? instructions / double(counters.cycles) : 0.) << std::setw(12)
+            << (instructions > 0. ? double(counters.llc_misses) * 1e3 / instructions : 0.) << std::setw(12)
+            << (instructions > 0. ? double(counters.vector_instructions) * 100. / instructions : 0.);
+    }
+    table << "\n";
+  }
+  return table.str();
+}
+}
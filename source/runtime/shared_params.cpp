@@ -0,0 +1,238 @@
+#include "runtime/shared_params.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+static const uint32_t kSharedParamsMagic = 0x5053504b;
+/// 文件格式发生变化时需要增加版本号，版本不同的文件不会被映射
+static const uint32_t kSharedParamsVersion = 1;
+/// 参数数据的对齐字节数，映射的起点按页对齐，数据因此按照缓存行对齐
+static const uint64_t kSharedParamsAlignment = 64;
+
+static uint64_t AlignOffset(uint64_t offset) {
+  return (offset + kSharedParamsAlignment - 1) / kSharedParamsAlignment * kSharedParamsAlignment;
+}
+
+SharedParams::~SharedParams() {
+  if (mapped_data_ != nullptr) {
+    munmap(mapped_data_, mapped_size_);
+  }
+}
+
+std::shared_ptr<SharedParams> SharedParams::Open(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat{};
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 16) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t file_size = file_stat.st_size;
+  // 私有的可写映射，没有写入的页在所有进程之间共享，意外写入时只复制被写入的页
+  void *addr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Can not map the shared params: " << path;
+    return nullptr;
+  }
+
+  std::shared_ptr<SharedParams> shared_params = std::make_shared<SharedParams>();
+  shared_params->mapped_data_ = static_cast<char *>(addr);
+  shared_params->mapped_size_ = file_size;
+
+  const char *data = shared_params->mapped_data_;
+  size_t offset = 0;
+  const auto &read_bytes = [&](void *value, size_t size) {
+    if (size > file_size - offset) {
+      return false;
+    }
+    memcpy(value, data + offset, size);
+    offset += size;
+    return true;
+  };
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint32_t entry_num = 0;
+  if (!read_bytes(&magic, sizeof(magic)) || !read_bytes(&version, sizeof(version))
+      || !read_bytes(&entry_num, sizeof(entry_num)) || magic != kSharedParamsMagic
+      || version != kSharedParamsVersion) {
+    LOG(ERROR) << "The shared params is broken or has another version: " << path;
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < entry_num; ++i) {
+    uint32_t name_length = 0;
+    if (!read_bytes(&name_length, sizeof(name_length)) || name_length > file_size - offset) {
+      LOG(ERROR) << "The shared params is broken: " << path;
+      return nullptr;
+    }
+    std::string name(data + offset, name_length);
+    offset += name_length;
+    Entry entry;
+    if (!read_bytes(&entry.offset, sizeof(entry.offset)) || !read_bytes(&entry.size, sizeof(entry.size))
+        || entry.offset % kSharedParamsAlignment != 0 || entry.offset > file_size
+        || entry.size > (file_size - entry.offset) / sizeof(float)) {
+      LOG(ERROR) << "The shared params is broken: " << path;
+      return nullptr;
+    }
+    shared_params->entries_.insert({std::move(name), entry});
+  }
+  return shared_params;
+}
+
+bool SharedParams::Save(const std::string &path) const {
+  // 先计算每个参数的偏移量，目录之后的数据按照64字节对齐
+  uint64_t header_size = sizeof(uint32_t) * 3;
+  for (const auto &record : records_) {
+    header_size += sizeof(uint32_t) + record.first.size() + sizeof(uint64_t) * 2;
+  }
+  std::vector<uint64_t> offsets;
+  uint64_t data_end = header_size;
+  for (const auto &record : records_) {
+    data_end = AlignOffset(data_end);
+    offsets.push_back(data_end);
+    data_end += record.second.second * sizeof(float);
+  }
+
+  std::vector<char> header;
+  const auto &write_bytes = [&header](const void *value, size_t size) {
+    const char *bytes = static_cast<const char *>(value);
+    header.insert(header.end(), bytes, bytes + size);
+  };
+  const uint32_t entry_num = records_.size();
+  write_bytes(&kSharedParamsMagic, sizeof(kSharedParamsMagic));
+  write_bytes(&kSharedParamsVersion, sizeof(kSharedParamsVersion));
+  write_bytes(&entry_num, sizeof(entry_num));
+  for (uint32_t i = 0; i < records_.size(); ++i) {
+    const std::string &name = records_.at(i).first;
+    const uint32_t name_length = name.size();
+    const uint64_t size = records_.at(i).second.second;
+    write_bytes(&name_length, sizeof(name_length));
+    write_bytes(name.data(), name.size());
+    write_bytes(&offsets.at(i), sizeof(uint64_t));
+    write_bytes(&size, sizeof(size));
+  }
+
+  const std::string temp_path = path + "." + std::to_string(getpid()) + ".tmp";
+  FILE *file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOG(ERROR) << "Can not open the shared params: " << temp_path;
+    return false;
+  }
+  bool write_success = fwrite(header.data(), 1, header.size(), file) == header.size();
+  uint64_t position = header.size();
+  const char padding[kSharedParamsAlignment] = {0};
+  for (uint32_t i = 0; write_success && i < records_.size(); ++i) {
+    const uint64_t padding_size = offsets.at(i) - position;
+    const size_t bytes = records_.at(i).second.second * sizeof(float);
+    write_success = fwrite(padding, 1, padding_size, file) == padding_size
+        && fwrite(records_.at(i).second.first, 1, bytes, file) == bytes;
+    position = offsets.at(i) + bytes;
+  }
+  write_success = fclose(file) == 0 && write_success;
+  if (!write_success || rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "Write the shared params failed: " << path;
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void SharedParams::BeginOperator(const std::string &operator_name) {
+  operator_name_ = operator_name;
+  operator_index_ = 0;
+}
+
+float *SharedParams::Attach(const float *data, size_t size) {
+  const std::string &name = operator_name_ + "." + std::to_string(operator_index_++);
+  if (mapped_data_ == nullptr) {
+    records_.push_back({name, {data, size}});
+    return nullptr;
+  }
+  // 同名参数的内容完全相同时才替换，模型更新之后旧的文件不会被误用
+  const auto &entry = entries_.find(name);
+  if (entry == entries_.end() || entry->second.size != size
+      || memcmp(mapped_data_ + entry->second.offset, data, size * sizeof(float)) != 0) {
+    missed_num_ += 1;
+    return nullptr;
+  }
+  return reinterpret_cast<float *>(mapped_data_ + entry->second.offset);
+}
+
+void SharedParams::Share(std::shared_ptr<Tensor<float>> &tensor) {
+  if (tensor == nullptr || tensor->empty()) {
+    return;
+  }
+  float *shared_data = Attach(tensor->RawPtr(), tensor->size());
+  if (shared_data == nullptr) {
+    return;
+  }
+  // 张量可能通过weights()被取走，删除器持有共享器，张量存在期间映射保持有效
+  std::shared_ptr<const SharedParams> holder = shared_from_this();
+  std::shared_ptr<Tensor<float>> shared_tensor(
+      new Tensor<float>(shared_data, tensor->channels(), tensor->rows(), tensor->cols()),
+      [holder](Tensor<float> *shared) { delete shared; });
+  // 张量按照外部内存创建时推导实际尺寸，改变过实际尺寸的张量保留自己的数据
+  if (shared_tensor->raw_shapes() == tensor->raw_shapes()) {
+    tensor = shared_tensor;
+    this->Count(tensor->size());
+  }
+}
+
+void SharedParams::Share(arma::fmat &matrix) {
+  if (matrix.empty()) {
+    return;
+  }
+  float *shared_data = Attach(matrix.memptr(), matrix.n_elem);
+  if (shared_data == nullptr) {
+    return;
+  }
+  // 移动赋值接管外部内存而不是复制，较早版本的Armadillo会复制一份，此时只是没有共享
+  matrix = arma::fmat(shared_data, matrix.n_rows, matrix.n_cols, false, false);
+  if (matrix.memptr() == shared_data) {
+    this->Count(matrix.n_elem);
+  }
+}
+
+void SharedParams::Share(GemmPackedMatrix &matrix) {
+  if (matrix.empty()) {
+    return;
+  }
+  const size_t size = matrix.packed_size();
+  float *shared_data = Attach(matrix.packed_data(), size);
+  if (shared_data == nullptr) {
+    return;
+  }
+  matrix.shared_data = std::shared_ptr<const float>(shared_from_this(), shared_data);
+  matrix.shared_size = size;
+  std::vector<float>().swap(matrix.data);
+  this->Count(size);
+}
+
+void SharedParams::Count(size_t size) {
+  shared_num_ += 1;
+  shared_bytes_ += size * sizeof(float);
+}
+
+bool SharedParams::mapped() const {
+  return mapped_data_ != nullptr;
+}
+
+uint32_t SharedParams::shared_num() const {
+  return shared_num_;
+}
+
+size_t SharedParams::shared_bytes() const {
+  return shared_bytes_;
+}
+
+uint32_t SharedParams::missed_num() const {
+  return missed_num_;
+}
+}
@@ -16,10 +16,19 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <map>
 #include <string>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PNNX_STOREZIP_MMAP 1
+#endif
+
 namespace pnnx {
 
 // https://stackoverflow.com/questions/1537964/visual-c-equivalent-of-gccs-attribute-packed
@@ -197,6 +206,23 @@ int StoreZipReader::open(const std::string& path)
     }
   }
 
+#if PNNX_STOREZIP_MMAP
+  // map the whole archive, stored files are then served from the page cache without copying
+  int fd = fileno(fp);
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    size_t mapping_size = st.st_size;
+    void* addr = mmap(0, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      mapping = std::shared_ptr<const char>((const char*)addr, [mapping_size](const char* p) {
+        munmap((void*)p, mapping_size);
+      });
+    }
+  }
+#endif
+
   return 0;
 }
 
@@ -222,14 +248,31 @@ int StoreZipReader::read_file(const std::string& name, char* data)
   size_t offset = filemetas[name].offset;
   size_t size = filemetas[name].size;
 
+  if (mapping)
+  {
+    memcpy(data, mapping.get() + offset, size);
+    return 0;
+  }
+
   fseek(fp, offset, SEEK_SET);
   fread(data, size, 1, fp);
 
   return 0;
 }
 
+std::shared_ptr<const char> StoreZipReader::get_file_view(const std::string& name)
+{
+  if (!mapping || filemetas.find(name) == filemetas.end())
+    return std::shared_ptr<const char>();
+
+  // aliasing constructor, the view shares the ownership of the whole mapping
+  return std::shared_ptr<const char>(mapping, mapping.get() + filemetas[name].offset);
+}
+
 int StoreZipReader::close()
 {
+  mapping.reset();
+
   if (!fp)
     return 0;
 
@@ -0,0 +1,305 @@
+#include "runtime/thread_pool.hpp"
+#include <algorithm>
+#include <glog/logging.h>
+#include "runtime/numa.hpp"
+
+namespace kuiper_infer {
+/// 当前线程所属的线程池和工作线程编号，不是工作线程时为空
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local uint32_t current_worker_index = 0;
+/// 当前线程通过Scope指定的线程池
+static thread_local ThreadPool *scoped_pool = nullptr;
+
+ThreadPool::ThreadPool(uint32_t thread_num, const std::vector<uint32_t> &cpus) {
+  CHECK(thread_num > 0) << "The thread number of thread pool must be greater than zero";
+  thread_num_ = thread_num;
+  cpus_ = cpus;
+  Start();
+}
+
+ThreadPool::~ThreadPool() {
+  Stop();
+}
+
+ThreadPool &ThreadPool::GetInstance() {
+  static ThreadPool thread_pool(std::max(std::thread::hardware_concurrency(), 1u));
+  return thread_pool;
+}
+
+ThreadPool &ThreadPool::Current() {
+  if (scoped_pool != nullptr) {
+    return *scoped_pool;
+  }
+  return current_pool != nullptr ? *current_pool : GetInstance();
+}
+
+void ThreadPool::set_thread_num(uint32_t thread_num) {
+  CHECK(thread_num > 0) << "The thread number of thread pool must be greater than zero";
+  if (thread_num == thread_num_) {
+    return;
+  }
+  Stop();
+  thread_num_ = thread_num;
+  Start();
+}
+
+uint32_t ThreadPool::thread_num() const {
+  return thread_num_;
+}
+
+void ThreadPool::set_numa_binding(bool numa_binding) {
+  if (numa_binding == numa_binding_) {
+    return;
+  }
+  Stop();
+  numa_binding_ = numa_binding;
+  Start();
+}
+
+bool ThreadPool::numa_binding() const {
+  return numa_binding_;
+}
+
+void ThreadPool::set_cpu_affinity(const std::vector<uint32_t> &cpus) {
+  if (cpus == cpus_) {
+    return;
+  }
+  Stop();
+  cpus_ = cpus;
+  Start();
+}
+
+const std::vector<uint32_t> &ThreadPool::cpu_affinity() const {
+  return cpus_;
+}
+
+void ThreadPool::Start() {
+  stop_ = false;
+  const uint32_t worker_num = thread_num_ - 1;
+  for (uint32_t i = 0; i < worker_num; ++i) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  // 工作线程按编号连续地分配到各个节点，不绑定时所有线程看作在同一个节点上
+  const uint32_t node_num = numa_binding_ ? NumaNodeNum() : 1;
+  std::vector<uint32_t> worker_nodes(worker_num, 0);
+  node_queues_.assign(node_num, {});
+  for (uint32_t i = 0; i < worker_num; ++i) {
+    worker_nodes.at(i) = i * node_num / worker_num;
+    node_queues_.at(worker_nodes.at(i)).push_back(i);
+  }
+  steal_orders_.assign(worker_num, {});
+  for (uint32_t i = 0; i < worker_num; ++i) {
+    for (const bool same_node : {true, false}) {
+      for (uint32_t j = 1; j < worker_num; ++j) {
+        const uint32_t victim = (i + j) % worker_num;
+        if ((worker_nodes.at(victim) == worker_nodes.at(i)) == same_node) {
+          steal_orders_.at(i).push_back(victim);
+        }
+      }
+    }
+  }
+  for (uint32_t i = 0; i < worker_num; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+void ThreadPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cond_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers_.clear();
+  queues_.clear();
+  steal_orders_.clear();
+  node_queues_.clear();
+  pending_num_ = 0;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  if (queues_.empty()) {
+    task();
+    return;
+  }
+
+  uint32_t queue_index;
+  const int32_t preferred_node = PreferredNumaNode();
+  if (current_pool == this) {
+    queue_index = current_worker_index;
+  } else if (numa_binding_ && preferred_node >= 0 && preferred_node < int32_t(node_queues_.size())
+      && !node_queues_.at(preferred_node).empty()) {
+    const std::vector<uint32_t> &node_queues = node_queues_.at(preferred_node);
+    queue_index = node_queues.at(next_queue_.fetch_add(1) % node_queues.size());
+  } else {
+    queue_index = next_queue_.fetch_add(1) % queues_.size();
+  }
+  // 先增加等待数量再放入队列，其他线程窃取任务时的减少不会早于增加
+  pending_num_ += 1;
+  {
+    WorkerQueue &queue = *queues_.at(queue_index);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+  sleep_cond_.notify_one();
+}
+
+bool ThreadPool::PopTask(uint32_t queue_index, std::function<void()> &task) {
+  if (pending_num_ == 0) {
+    return false;
+  }
+  {
+    WorkerQueue &queue = *queues_.at(queue_index);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      pending_num_ -= 1;
+      return true;
+    }
+  }
+
+  for (const uint32_t victim : steal_orders_.at(queue_index)) {
+    WorkerQueue &queue = *queues_.at(victim);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      pending_num_ -= 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::RunPendingTask() {
+  if (queues_.empty()) {
+    return false;
+  }
+  uint32_t queue_index = current_pool == this ? current_worker_index : next_queue_.load() % queues_.size();
+  const int32_t preferred_node = PreferredNumaNode();
+  if (current_pool != this && numa_binding_ && preferred_node >= 0 && preferred_node < int32_t(node_queues_.size())
+      && !node_queues_.at(preferred_node).empty()) {
+    // 绑定了节点的外部线程优先执行同一个节点上的任务
+    queue_index = node_queues_.at(preferred_node).front();
+  }
+  std::function<void()> task;
+  if (!PopTask(queue_index, task)) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  if (numa_binding_) {
+    for (uint32_t node = 0; node < node_queues_.size(); ++node) {
+      const std::vector<uint32_t> &node_queues = node_queues_.at(node);
+      if (std::find(node_queues.begin(), node_queues.end(), worker_index) != node_queues.end()) {
+        BindThreadToNumaNode(node);
+      }
+    }
+  }
+  if (!cpus_.empty()) {
+    // 绑定NUMA节点之后只保留节点上的CPU，节点上没有指定的CPU时使用全部指定的CPU
+    std::vector<uint32_t> cpus;
+    const std::vector<uint32_t> thread_cpus = ThreadCpus();
+    for (const uint32_t cpu : cpus_) {
+      if (!numa_binding_ || std::find(thread_cpus.begin(), thread_cpus.end(), cpu) != thread_cpus.end()) {
+        cpus.push_back(cpu);
+      }
+    }
+    LOG_IF(WARNING, !BindThreadToCpus(cpus.empty() ? cpus_ : cpus)) << "Set the cpu affinity of worker thread failed";
+  }
+  while (true) {
+    std::function<void()> task;
+    if (PopTask(worker_index, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cond_.wait(lock, [this]() { return stop_ || pending_num_ > 0; });
+    if (stop_) {
+      break;
+    }
+  }
+  current_pool = nullptr;
+}
+
+void ThreadPool::ParallelFor(uint32_t begin, uint32_t end, const std::function<void(uint32_t)> &function) {
+  if (end <= begin) {
+    return;
+  }
+  const uint32_t count = end - begin;
+  const uint32_t chunk_num = std::min(count, thread_num_);
+  if (chunk_num <= 1) {
+    for (uint32_t i = begin; i < end; ++i) {
+      function(i);
+    }
+    return;
+  }
+
+  // 前count % chunk_num个块比其他块多一个元素
+  const uint32_t chunk_size = count / chunk_num;
+  const uint32_t chunk_remain = count % chunk_num;
+  const auto &run_chunk = [&](uint32_t chunk) {
+    const uint32_t chunk_begin = begin + chunk * chunk_size + std::min(chunk, chunk_remain);
+    const uint32_t chunk_end = chunk_begin + chunk_size + (chunk < chunk_remain ? 1 : 0);
+    for (uint32_t i = chunk_begin; i < chunk_end; ++i) {
+      function(i);
+    }
+  };
+
+  std::atomic<uint32_t> remain_chunks(chunk_num - 1);
+  for (uint32_t chunk = 1; chunk < chunk_num; ++chunk) {
+    Submit([&run_chunk, &remain_chunks, chunk]() {
+      run_chunk(chunk);
+      remain_chunks -= 1;
+    });
+  }
+  run_chunk(0);
+
+  // 等待其他块完成的时候帮助执行队列中的任务
+  while (remain_chunks != 0) {
+    if (!RunPendingTask()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+ThreadPool::Scope::Scope(ThreadPool *thread_pool) {
+  if (thread_pool == nullptr) {
+    return;
+  }
+  bound_ = true;
+  prev_pool_ = scoped_pool;
+  scoped_pool = thread_pool;
+  if (!thread_pool->cpus_.empty()) {
+    prev_cpus_ = ThreadCpus();
+    if (!BindThreadToCpus(thread_pool->cpus_)) {
+      prev_cpus_.clear();
+    }
+  }
+}
+
+ThreadPool::Scope::~Scope() {
+  if (!bound_) {
+    return;
+  }
+  scoped_pool = prev_pool_;
+  if (!prev_cpus_.empty()) {
+    BindThreadToCpus(prev_cpus_);
+  }
+}
+}
@@ -0,0 +1,101 @@
+#include "runtime/tuning_cache.hpp"
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+#include "runtime/cpu_feature.hpp"
+
+namespace kuiper_infer {
+/// 缓存文件第一行的标识和版本，格式变化时增加版本号
+static const char *kTuningCacheMagic = "kuiper_tuning_cache 1";
+
+TuningCache::TuningCache() : cpu_model_(CpuModelName()) {
+
+}
+
+bool TuningCache::Load(const std::string &path) {
+  entries_.clear();
+  modified_ = false;
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    LOG(INFO) << "The tuning cache does not exist: " << path;
+    return false;
+  }
+
+  // 第一行是标识，第二行是处理器型号，之后每一行是一个键和值
+  std::string magic;
+  std::string cpu_model;
+  if (!std::getline(file, magic) || magic != kTuningCacheMagic || !std::getline(file, cpu_model)) {
+    LOG(ERROR) << "The tuning cache is broken: " << path;
+    return false;
+  }
+  if (cpu_model != cpu_model_) {
+    LOG(INFO) << "The tuning cache is created on another cpu: " << cpu_model << ", current cpu: " << cpu_model_;
+    return false;
+  }
+
+  std::map<std::string, int32_t> entries;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream line_stream(line);
+    std::string key;
+    int32_t value = 0;
+    if (!(line_stream >> key >> value)) {
+      LOG(ERROR) << "The tuning cache is broken: " << path;
+      return false;
+    }
+    entries.insert({key, value});
+  }
+  entries_ = std::move(entries);
+  return true;
+}
+
+bool TuningCache::Save(const std::string &path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Can not open the tuning cache: " << path;
+    return false;
+  }
+  file << kTuningCacheMagic << "\n" << cpu_model_ << "\n";
+  for (const auto &entry : entries_) {
+    file << entry.first << " " << entry.second << "\n";
+  }
+  file.close();
+  if (file.fail()) {
+    LOG(ERROR) << "Write the tuning cache failed: " << path;
+    return false;
+  }
+  modified_ = false;
+  return true;
+}
+
+bool TuningCache::Find(const std::string &key, int32_t &value) const {
+  const auto &entry = entries_.find(key);
+  if (entry == entries_.end()) {
+    return false;
+  }
+  value = entry->second;
+  return true;
+}
+
+void TuningCache::Insert(const std::string &key, int32_t value) {
+  CHECK(!key.empty() && key.find_first_of(" \t\n") == std::string::npos)
+          << "The key of tuning cache can not contain blank characters: " << key;
+  entries_[key] = value;
+  modified_ = true;
+}
+
+uint32_t TuningCache::size() const {
+  return entries_.size();
+}
+
+bool TuningCache::modified() const {
+  return modified_;
+}
+
+const std::string &TuningCache::cpu_model() const {
+  return cpu_model_;
+}
+}
@@ -0,0 +1,309 @@
+#include "runtime/video_pipeline.hpp"
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <glog/logging.h>
+
+namespace kuiper_infer {
+/**
+ * 两个时间点之间的纳秒数
+ */
+static int64_t ElapsedNs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+std::string VideoPipelineStats::ToString() const {
+  std::ostringstream stats;
+  stats << std::fixed << std::setprecision(3);
+  stats << "Frames: " << frame_num << ", dropped: " << dropped_num << ", batches: " << batch_num
+        << ", fps: " << frames_per_second << "\n";
+  stats << "Stage latency(ms) source: " << source_ms << ", preprocess: " << preprocess_ms << ", infer: " << infer_ms
+        << ", postprocess: " << postprocess_ms << ", sink: " << sink_ms << ", end to end: " << latency_ms << "\n";
+  return stats.str();
+}
+
+VideoPipeline::VideoPipeline(std::shared_ptr<RuntimeGraph> graph, VideoSource source, VideoSink sink,
+                             const VideoPipelineOptions &options)
+    : graph_(std::move(graph)), source_(std::move(source)), sink_(std::move(sink)), options_(options),
+      start_time_(std::chrono::steady_clock::now()) {
+  CHECK(graph_ != nullptr) << "The graph of video pipeline is empty";
+  CHECK(source_ != nullptr && sink_ != nullptr) << "The source and sink of video pipeline can not be empty";
+  CHECK(options_.batch_size > 0 && options_.batch_size <= graph_->batch_size())
+          << "The batch size " << options_.batch_size << " must be in (0, " << graph_->batch_size() << "]";
+  CHECK(options_.queue_capacity > 0) << "The queue capacity of video pipeline must be greater than zero";
+  CHECK(graph_->detection_post_process().enabled)
+          << "The video pipeline needs the detection post process of graph";
+  context_ = graph_->CreateContext();
+
+  // 每个队列、每个阶段正在处理的帧和一个批次都用满时，读取阶段仍然有空闲的帧，流水线的深度只由队列的容量决定
+  const uint32_t task_num = options_.queue_capacity * (kStageNum - 1) + options_.batch_size + kStageNum;
+  for (uint32_t i = 0; i < kStageNum; ++i) {
+    std::unique_ptr<Stage> stage = std::make_unique<Stage>();
+    stage->tasks = std::make_unique<SpscQueue<VideoTask *>>(i == kStageSource ? task_num : options_.queue_capacity);
+    stages_.push_back(std::move(stage));
+  }
+  const ImagePreprocessParam &preprocess = options_.preprocess;
+  for (uint32_t i = 0; i < task_num; ++i) {
+    std::unique_ptr<VideoTask> task = std::make_unique<VideoTask>();
+    task->input = std::make_shared<Tensor<float>>(3, preprocess.target_height, preprocess.target_width);
+    VideoTask *free_task = task.get();
+    CHECK(stages_.at(kStageSource)->tasks->Push(free_task));
+    task_pool_.push_back(std::move(task));
+  }
+
+  stages_.at(kStageSource)->thread = std::thread(&VideoPipeline::SourceLoop, this);
+  stages_.at(kStagePreprocess)->thread = std::thread(&VideoPipeline::PreprocessLoop, this);
+  stages_.at(kStageInfer)->thread = std::thread(&VideoPipeline::InferLoop, this);
+  stages_.at(kStagePostprocess)->thread = std::thread(&VideoPipeline::PostprocessLoop, this);
+  stages_.at(kStageSink)->thread = std::thread(&VideoPipeline::SinkLoop, this);
+  LOG(INFO) << "Video pipeline with batch size " << options_.batch_size << " and " << task_num << " frames";
+}
+
+VideoPipeline::~VideoPipeline() {
+  Stop();
+}
+
+void VideoPipeline::Wait() {
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  for (const auto &stage : stages_) {
+    if (stage->thread.joinable()) {
+      stage->thread.join();
+    }
+  }
+}
+
+void VideoPipeline::Stop() {
+  stop_ = true;
+  Wait();
+}
+
+VideoPipelineStats VideoPipeline::stats() const {
+  VideoPipelineStats stats;
+  stats.frame_num = frame_num_;
+  stats.dropped_num = dropped_num_;
+  stats.batch_num = batch_num_;
+  if (stats.frame_num == 0) {
+    return stats;
+  }
+  const double frame_num = double(stats.frame_num);
+  const int64_t first_read_ns = first_read_ns_;
+  const int64_t last_done_ns = last_done_ns_;
+  if (first_read_ns >= 0 && last_done_ns > first_read_ns) {
+    stats.frames_per_second = frame_num * 1e9 / double(last_done_ns - first_read_ns);
+  }
+  // 读取阶段的耗时也包括丢弃的帧
+  stats.source_ms = double(stages_.at(kStageSource)->busy_ns) / 1e6 / (frame_num + double(stats.dropped_num));
+  stats.preprocess_ms = double(stages_.at(kStagePreprocess)->busy_ns) / 1e6 / frame_num;
+  stats.infer_ms = double(stages_.at(kStageInfer)->busy_ns) / 1e6 / frame_num;
+  stats.postprocess_ms = double(stages_.at(kStagePostprocess)->busy_ns) / 1e6 / frame_num;
+  stats.sink_ms = double(stages_.at(kStageSink)->busy_ns) / 1e6 / frame_num;
+  stats.latency_ms = double(latency_ns_) / 1e6 / frame_num;
+  return stats;
+}
+
+bool VideoPipeline::PopTask(uint32_t stage_index, std::chrono::steady_clock::time_point deadline,
+                            VideoTask *&task) {
+  Stage &stage = *stages_.at(stage_index);
+  while (!stage.tasks->Pop(task)) {
+    if (!stage.waiter.Wait([&stage]() { return !stage.tasks->empty(); }, deadline)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void VideoPipeline::PushTask(uint32_t stage_index, VideoTask *task) {
+  Stage &stage = *stages_.at(stage_index);
+  // 下一个阶段较慢时队列会满，等待它取走帧，上游的阶段因此自然地放慢
+  while (!stage.tasks->Push(task)) {
+    std::this_thread::yield();
+  }
+  stage.waiter.Notify();
+}
+
+void VideoPipeline::RecordStage(uint32_t stage_index, std::chrono::steady_clock::time_point start,
+                                uint32_t frame_num) {
+  const int64_t busy_ns = ElapsedNs(start, std::chrono::steady_clock::now());
+  stages_.at(stage_index)->busy_ns += uint64_t(busy_ns) * frame_num;
+}
+
+void VideoPipeline::SourceLoop() {
+  const auto forever = std::chrono::steady_clock::time_point::max();
+  uint64_t frame_index = 0;
+  VideoTask *task = nullptr;
+  while (!stop_) {
+    // 丢弃的帧不归还，下一次直接读入同一块内存
+    if (task == nullptr) {
+      PopTask(kStageSource, forever, task);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    int64_t expected = -1;
+    first_read_ns_.compare_exchange_strong(expected, ElapsedNs(start_time_, start));
+    VideoFrame &frame = task->result.frame;
+    frame = VideoFrame();
+    const bool has_frame = source_(frame);
+    RecordStage(kStageSource, start);
+    if (!has_frame) {
+      break;
+    }
+    frame.index = frame_index++;
+    task->read_time = start;
+    CHECK(frame.image.data != nullptr && frame.image.height > 0 && frame.image.width > 0)
+            << "The frame " << frame.index << " read from the source is empty";
+
+    if (!options_.drop_frames) {
+      PushTask(kStagePreprocess, task);
+      task = nullptr;
+      continue;
+    }
+    // 预处理阶段的队列满时丢弃这一帧，实时视频流总是处理最新的帧
+    Stage &stage = *stages_.at(kStagePreprocess);
+    VideoTask *pushed_task = task;
+    if (stage.tasks->Push(pushed_task)) {
+      stage.waiter.Notify();
+      task = nullptr;
+    } else {
+      dropped_num_ += 1;
+      frame.holder.reset();
+    }
+  }
+  if (task != nullptr) {
+    task->result.frame = VideoFrame();
+  }
+  PushTask(kStagePreprocess, nullptr);
+}
+
+void VideoPipeline::PreprocessLoop() {
+  const auto forever = std::chrono::steady_clock::time_point::max();
+  while (true) {
+    VideoTask *task = nullptr;
+    PopTask(kStagePreprocess, forever, task);
+    if (task == nullptr) {
+      break;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    // 输入张量在上一次推理时可能被复制到了设备上，重新写入之后以主机上的数据为准
+    task->letterbox = PreprocessImage(task->result.frame.image, options_.preprocess, task->input->data().memptr());
+    task->input->set_device(DeviceType::kDeviceCPU);
+    RecordStage(kStagePreprocess, start);
+    PushTask(kStageInfer, task);
+  }
+  PushTask(kStageInfer, nullptr);
+}
+
+void VideoPipeline::InferLoop() {
+  const auto forever = std::chrono::steady_clock::time_point::max();
+  std::vector<VideoTask *> batch;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  bool finished = false;
+  while (!finished) {
+    VideoTask *task = nullptr;
+    PopTask(kStageInfer, forever, task);
+    if (task == nullptr) {
+      break;
+    }
+    batch.assign(1, task);
+    // 从第一帧到达开始最多等待给定的时间，批次满了或者超时后执行一次推理
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.max_batch_wait_us);
+    while (batch.size() < options_.batch_size) {
+      VideoTask *next_task = nullptr;
+      if (!PopTask(kStageInfer, deadline, next_task)) {
+        break;
+      }
+      if (next_task == nullptr) {
+        finished = true;
+        break;
+      }
+      batch.push_back(next_task);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    inputs.clear();
+    for (const VideoTask *batch_task : batch) {
+      inputs.push_back(batch_task->input);
+    }
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph_->Forward(context_, inputs);
+    CHECK(outputs.size() == batch.size());
+    // 输出在执行上下文的内存中，下一个批次推理时会被覆盖，复制到每一帧自己的张量中
+    for (uint32_t i = 0; i < batch.size(); ++i) {
+      const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+      std::shared_ptr<Tensor<float>> &task_output = batch.at(i)->output;
+      if (task_output == nullptr || task_output->shapes() != output->shapes()) {
+        task_output = std::make_shared<Tensor<float>>(*output);
+      } else {
+        std::memcpy(task_output->data().memptr(), output->data().memptr(), output->size() * sizeof(float));
+      }
+    }
+    RecordStage(kStageInfer, start, batch.size());
+    batch_num_ += 1;
+    for (VideoTask *batch_task : batch) {
+      PushTask(kStagePostprocess, batch_task);
+    }
+  }
+  PushTask(kStagePostprocess, nullptr);
+}
+
+void VideoPipeline::PostprocessLoop() {
+  const auto forever = std::chrono::steady_clock::time_point::max();
+  while (true) {
+    VideoTask *task = nullptr;
+    PopTask(kStagePostprocess, forever, task);
+    if (task == nullptr) {
+      break;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const std::shared_ptr<Tensor<float>> &output = task->output;
+    CHECK(output->channels() == 1 && output->cols() == 6)
+            << "The output of graph must be the detections after the post process";
+    const ImageView &image = task->result.frame.image;
+    const LetterboxInfo &letterbox = task->letterbox;
+    const float width = float(image.width);
+    const float height = float(image.height);
+    std::vector<VideoDetection> &detections = task->result.detections;
+    detections.clear();
+    // 每行是x1、y1、x2、y2、得分和类别，检测框按照得分从高到低排列，类别为-1的行之后没有检测框
+    for (uint32_t i = 0; i < output->rows(); ++i) {
+      const int32_t class_id = int32_t(output->at(0, i, 5));
+      if (class_id < 0) {
+        break;
+      }
+      VideoDetection detection;
+      detection.x1 = std::clamp((output->at(0, i, 0) - float(letterbox.pad_left)) / letterbox.scale_x, 0.f, width);
+      detection.y1 = std::clamp((output->at(0, i, 1) - float(letterbox.pad_top)) / letterbox.scale_y, 0.f, height);
+      detection.x2 = std::clamp((output->at(0, i, 2) - float(letterbox.pad_left)) / letterbox.scale_x, 0.f, width);
+      detection.y2 = std::clamp((output->at(0, i, 3) - float(letterbox.pad_top)) / letterbox.scale_y, 0.f, height);
+      detection.score = output->at(0, i, 4);
+      detection.class_id = class_id;
+      detections.push_back(detection);
+    }
+    RecordStage(kStagePostprocess, start);
+    PushTask(kStageSink, task);
+  }
+  PushTask(kStageSink, nullptr);
+}
+
+void VideoPipeline::SinkLoop() {
+  const auto forever = std::chrono::steady_clock::time_point::max();
+  while (true) {
+    VideoTask *task = nullptr;
+    PopTask(kStageSink, forever, task);
+    if (task == nullptr) {
+      break;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    task->result.latency_ms = double(ElapsedNs(task->read_time, start)) / 1e6;
+    sink_(task->result);
+    const auto end = std::chrono::steady_clock::now();
+    RecordStage(kStageSink, start);
+    latency_ns_ += uint64_t(ElapsedNs(task->read_time, end));
+    last_done_ns_ = ElapsedNs(start_time_, end);
+    frame_num_ += 1;
+
+    // 归还之前释放帧的像素，读取阶段可以立即复用解码器的内存
+    task->result.frame = VideoFrame();
+    PushTask(kStageSource, task);
+  }
+}
+}
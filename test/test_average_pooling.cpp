@@ -213,4 +213,30 @@ TEST(test_layer, forward_average_pooling_out11x11) {
       ASSERT_TRUE(arma::approx_equal(output1->at(c), output2->at(c), "absdiff", 0.01f));
     }
   }
-}
\ No newline at end of file
+}
+TEST(test_layer, forward_average_pooling_out1x1) {
+  using namespace kuiper_infer;
+  // 全局平均池化走单独的实现，平面大小覆盖向量宽度的余数部分
+  const std::vector<std::pair<uint32_t, uint32_t>> sizes = {{7, 7}, {1, 1}, {13, 5}, {56, 56}};
+  for (const auto &size : sizes) {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    const uint32_t input_size = 3;
+    for (uint32_t i = 0; i < input_size; ++i) {
+      std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(37, size.first, size.second);
+      input->Rand();
+      inputs.push_back(input);
+    }
+    std::vector<std::shared_ptr<Tensor<float>>> outputs1;
+    AveragePooling(inputs, outputs1, 1, 1);
+    AdaptiveAveragePoolingLayer average_layer(1, 1);
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs2(input_size);
+    ASSERT_EQ(average_layer.Forward(inputs, outputs2), InferStatus::kInferSuccess);
+    for (uint32_t i = 0; i < input_size; ++i) {
+      ASSERT_EQ(outputs1.at(i)->shapes(), outputs2.at(i)->shapes());
+      for (uint32_t c = 0; c < outputs1.at(i)->channels(); ++c) {
+        ASSERT_NEAR(outputs1.at(i)->at(c, 0, 0), outputs2.at(i)->at(c, 0, 0), 1e-5f);
+      }
+    }
+  }
+}
@@ -116,4 +116,34 @@ TEST(test_layer, forward_batchnorm4) {
     ASSERT_NEAR(mean / size, 0.f, 0.01f);
     ASSERT_NEAR(var / size, 1.f, 0.01f);
   }
-}
\ No newline at end of file
+}
+TEST(test_layer, forward_batchnorm_inplace) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 7, 9);
+  input->Rand();
+  const std::shared_ptr<Tensor<float>> origin = input->Clone();
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+
+  const std::vector<float> mean{0.5f, -1.f, 2.f};
+  const std::vector<float> var{1.f, 4.f, 0.25f};
+  const std::vector<float> affine_weight{2.f, 0.5f, -1.f};
+  const std::vector<float> affine_bias{0.f, 1.f, 3.f};
+  BatchNorm2dLayer layer(3, 1e-5f, affine_weight, affine_bias);
+  layer.set_weights(mean);
+  layer.set_bias(var);
+
+  // 输出就是输入张量，原地计算
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{input};
+  const auto status = layer.Forward(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+  ASSERT_EQ(outputs.front(), input);
+  for (uint32_t c = 0; c < 3; ++c) {
+    for (uint32_t r = 0; r < 7; ++r) {
+      for (uint32_t col = 0; col < 9; ++col) {
+        const float expected = (origin->at(c, r, col) - mean.at(c)) / std::sqrt(var.at(c) + 1e-5f)
+            * affine_weight.at(c) + affine_bias.at(c);
+        ASSERT_NEAR(input->at(c, r, col), expected, 1e-5f);
+      }
+    }
+  }
+}
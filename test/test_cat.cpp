@@ -43,3 +43,28 @@ TEST(test_layer, cat1) {
 
 }
 
+
+TEST(test_layer, cat_different_channels) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 8, 5);
+  std::shared_ptr<Tensor<float>> input2 = std::make_shared<Tensor<float>>(5, 8, 5);
+  input1->Rand();
+  input2->Rand();
+  std::shared_ptr<Tensor<float>> output = std::make_shared<Tensor<float>>(8, 8, 5);
+  // input1已经写在输出的前3个通道中，只有input2需要复制
+  std::shared_ptr<Tensor<float>> aliased_input1 = std::make_shared<Tensor<float>>(output->data().memptr(), 3, 8, 5);
+  aliased_input1->data() = input1->data();
+  ASSERT_EQ(aliased_input1->data().memptr(), output->data().memptr());
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{aliased_input1, input2};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{output};
+  CatLayer cat_layer(1);
+  ASSERT_EQ(cat_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+  ASSERT_EQ(outputs.front()->channels(), 8);
+  for (uint32_t c = 0; c < 3; ++c) {
+    ASSERT_TRUE(arma::approx_equal(input1->at(c), outputs.front()->at(c), "absdiff", 1e-6f));
+  }
+  for (uint32_t c = 0; c < 5; ++c) {
+    ASSERT_TRUE(arma::approx_equal(input2->at(c), outputs.front()->at(c + 3), "absdiff", 1e-6f));
+  }
+}
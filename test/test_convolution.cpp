@@ -0,0 +1,378 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+#include <cstdio>
+#include <fstream>
+#include "data/tensor.hpp"
+#include "data/gemm.hpp"
+#include "data/sparse.hpp"
+#include "../source/layer/details/convolution.hpp"
+#include "../source/layer/details/relu.hpp"
+#include "../source/layer/details/sigmoid.hpp"
+#include "../source/layer/details/silu.hpp"
+#include "../source/layer/details/hardswish.hpp"
+#include "../source/layer/details/hardsigmoid.hpp"
+
+using namespace kuiper_infer;
+
+/// 直接按照卷积的定义计算，作为各个卷积实现的参考结果
+static std::shared_ptr<Tensor<float>> DirectConvolution(const std::shared_ptr<Tensor<float>> &input,
+                                                        const std::vector<std::shared_ptr<Tensor<float>>> &weights,
+                                                        const std::vector<float> &bias,
+                                                        uint32_t groups, uint32_t padding, uint32_t stride) {
+  const uint32_t kernel_count = weights.size();
+  const uint32_t kernel_h = weights.front()->rows();
+  const uint32_t kernel_w = weights.front()->cols();
+  const uint32_t input_c_group = weights.front()->channels();
+  const uint32_t kernel_count_group = kernel_count / groups;
+  const uint32_t output_h = (input->rows() + 2 * padding - kernel_h) / stride + 1;
+  const uint32_t output_w = (input->cols() + 2 * padding - kernel_w) / stride + 1;
+
+  std::shared_ptr<Tensor<float>> output = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    const uint32_t g = k / kernel_count_group;
+    for (uint32_t r = 0; r < output_h; ++r) {
+      for (uint32_t c = 0; c < output_w; ++c) {
+        float sum = bias.empty() ? 0.f : bias.at(k);
+        for (uint32_t ic = 0; ic < input_c_group; ++ic) {
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+              const int32_t h = int32_t(r * stride + kh) - int32_t(padding);
+              const int32_t w = int32_t(c * stride + kw) - int32_t(padding);
+              if (h < 0 || w < 0 || h >= int32_t(input->rows()) || w >= int32_t(input->cols())) {
+                continue;
+              }
+              sum += input->at(g * input_c_group + ic, h, w) * weights.at(k)->at(ic, kh, kw);
+            }
+          }
+        }
+        output->at(k, r, c) = sum;
+      }
+    }
+  }
+  return output;
+}
+
+static void CheckConvolution(uint32_t in_channel, uint32_t out_channel, uint32_t kernel_size,
+                             uint32_t padding, uint32_t stride, uint32_t groups, uint32_t input_size,
+                             ActivationType activation = ActivationType::kActivationNone, bool residual = false) {
+  ConvolutionLayer conv_layer(out_channel, in_channel, kernel_size, kernel_size, padding, padding,
+                              stride, stride, groups, true);
+  conv_layer.set_activation(activation);
+  conv_layer.set_residual(residual);
+  std::vector<std::shared_ptr<Tensor<float>>> weights;
+  for (uint32_t k = 0; k < out_channel; ++k) {
+    std::shared_ptr<Tensor<float>> weight = std::make_shared<Tensor<float>>(in_channel / groups,
+                                                                            kernel_size, kernel_size);
+    weight->Rand();
+    if (activation != ActivationType::kActivationNone) {
+      // 让输出有正有负，覆盖激活函数的各个分段
+      weight->Transform([](float val) { return val - 0.5f; });
+    }
+    weights.push_back(weight);
+  }
+  std::vector<float> bias;
+  for (uint32_t k = 0; k < out_channel; ++k) {
+    bias.push_back(float(k) * 0.1f);
+  }
+  conv_layer.set_weights(weights);
+  conv_layer.set_bias(bias);
+
+  const uint32_t batch_size = 2;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(in_channel, input_size, input_size);
+    input->Rand();
+    inputs.push_back(input);
+  }
+  // 残差作为后一半输入
+  const uint32_t output_size = (input_size + 2 * padding - kernel_size) / stride + 1;
+  std::vector<std::shared_ptr<Tensor<float>>> residuals;
+  std::vector<std::shared_ptr<Tensor<float>>> layer_inputs = inputs;
+  if (residual) {
+    for (uint32_t b = 0; b < batch_size; ++b) {
+      std::shared_ptr<Tensor<float>> residual_tensor = std::make_shared<Tensor<float>>(out_channel, output_size,
+                                                                                       output_size);
+      residual_tensor->Rand();
+      residual_tensor->Transform([](float val) { return val - 0.5f; });
+      residuals.push_back(residual_tensor);
+      layer_inputs.push_back(residual_tensor);
+    }
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+  const auto status = conv_layer.Forward(layer_inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    const auto &expected = DirectConvolution(inputs.at(b), weights, bias, groups, padding, stride);
+    if (residual) {
+      for (uint32_t i = 0; i < expected->size(); ++i) {
+        expected->index(i) += residuals.at(b)->index(i);
+      }
+    }
+    ApplyActivation(activation, expected->data().memptr(), expected->size());
+    const auto &output = outputs.at(b);
+    ASSERT_EQ(output->shapes(), expected->shapes());
+    for (uint32_t i = 0; i < output->size(); ++i) {
+      ASSERT_NEAR(output->index(i), expected->index(i), 1e-4);
+    }
+  }
+}
+
+TEST(test_layer, forward_convolution_3x3) {
+  CheckConvolution(8, 16, 3, 1, 1, 1, 14);
+}
+
+TEST(test_layer, forward_convolution_stride2) {
+  CheckConvolution(6, 12, 3, 1, 2, 1, 15);
+}
+
+TEST(test_layer, forward_convolution_group) {
+  CheckConvolution(8, 16, 3, 0, 1, 4, 12);
+}
+
+TEST(test_layer, forward_convolution_winograd) {
+  const uint32_t in_channel = 6;
+  const uint32_t out_channel = 10;
+  const uint32_t groups = 2;
+  ConvolutionLayer winograd_layer(out_channel, in_channel, 3, 3, 1, 1, 1, 1, groups, true);
+  ConvolutionLayer im2col_layer(out_channel, in_channel, 3, 3, 1, 1, 1, 1, groups, true);
+  im2col_layer.set_use_winograd(false);
+
+  std::vector<std::shared_ptr<Tensor<float>>> weights;
+  std::vector<float> bias;
+  for (uint32_t k = 0; k < out_channel; ++k) {
+    std::shared_ptr<Tensor<float>> weight = std::make_shared<Tensor<float>>(in_channel / groups, 3, 3);
+    weight->Rand();
+    weights.push_back(weight);
+    bias.push_back(float(k) * 0.1f);
+  }
+  winograd_layer.set_weights(weights);
+  winograd_layer.set_bias(bias);
+  im2col_layer.set_weights(weights);
+  im2col_layer.set_bias(bias);
+
+  // 奇数大小的输出会让最后一行和最后一列的输出块只有一半有效
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(in_channel, 13, 9);
+  input->Rand();
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> winograd_outputs(1);
+  std::vector<std::shared_ptr<Tensor<float>>> im2col_outputs(1);
+  ASSERT_EQ(winograd_layer.Forward(inputs, winograd_outputs), InferStatus::kInferSuccess);
+  ASSERT_EQ(im2col_layer.Forward(inputs, im2col_outputs), InferStatus::kInferSuccess);
+
+  const auto &winograd_output = winograd_outputs.front();
+  const auto &im2col_output = im2col_outputs.front();
+  ASSERT_EQ(winograd_output->shapes(), im2col_output->shapes());
+  for (uint32_t i = 0; i < winograd_output->size(); ++i) {
+    ASSERT_NEAR(winograd_output->index(i), im2col_output->index(i), 1e-4);
+  }
+}
+
+TEST(test_layer, forward_convolution_1x1) {
+  CheckConvolution(16, 24, 1, 0, 1, 1, 10);
+}
+
+TEST(test_layer, forward_convolution_1x1_group) {
+  CheckConvolution(12, 8, 1, 1, 1, 2, 7);
+}
+
+TEST(test_layer, forward_convolution_depthwise_3x3) {
+  CheckConvolution(8, 8, 3, 1, 1, 8, 13);
+  CheckConvolution(8, 8, 3, 1, 2, 8, 13);
+}
+
+TEST(test_layer, forward_convolution_depthwise_5x5) {
+  CheckConvolution(6, 12, 5, 2, 1, 6, 11);
+  CheckConvolution(6, 6, 5, 2, 2, 6, 12);
+}
+
+TEST(test_layer, forward_convolution_depthwise_channel_block) {
+  // 通道数跨过多个向量宽度的块，最后一个块不满
+  CheckConvolution(37, 37, 3, 1, 1, 37, 9);
+  CheckConvolution(37, 37, 3, 1, 2, 37, 17);
+  CheckConvolution(20, 40, 5, 2, 1, 20, 7);
+}
+
+TEST(test_layer, forward_convolution_workspace) {
+  const uint32_t in_channel = 4;
+  const uint32_t out_channel = 6;
+  const uint32_t batch_size = 2;
+  for (uint32_t stride : {1, 2}) {
+    ConvolutionLayer conv_layer(out_channel, in_channel, 3, 3, 1, 1, stride, stride, 1, false);
+    std::vector<std::shared_ptr<Tensor<float>>> weights;
+    for (uint32_t k = 0; k < out_channel; ++k) {
+      std::shared_ptr<Tensor<float>> weight = std::make_shared<Tensor<float>>(in_channel, 3, 3);
+      weight->Rand();
+      weights.push_back(weight);
+    }
+    conv_layer.set_weights(weights);
+
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    for (uint32_t b = 0; b < batch_size; ++b) {
+      std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(in_channel, 11, 10);
+      input->Rand();
+      inputs.push_back(input);
+    }
+
+    const size_t workspace_size = conv_layer.WorkspaceSize({{int32_t(batch_size), int32_t(in_channel), 11, 10}});
+    ASSERT_GT(workspace_size, 0);
+    // 临时内存中残留的数据不能影响计算结果
+    std::vector<float> workspace(workspace_size, std::numeric_limits<float>::quiet_NaN());
+    conv_layer.set_workspace(workspace.data(), workspace.size());
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+    ASSERT_EQ(conv_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+    ASSERT_FALSE(std::isnan(workspace.front()));
+    for (uint32_t b = 0; b < batch_size; ++b) {
+      const auto &expected = DirectConvolution(inputs.at(b), weights, {}, 1, 1, stride);
+      const auto &output = outputs.at(b);
+      ASSERT_EQ(output->shapes(), expected->shapes());
+      for (uint32_t i = 0; i < output->size(); ++i) {
+        ASSERT_NEAR(output->index(i), expected->index(i), 1e-4);
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_convolution_tiled) {
+  // 输出位置较多时会被切分成多个块，块的边界和样本的边界不重合
+  CheckConvolution(32, 16, 3, 1, 2, 1, 40);
+  CheckConvolution(16, 8, 5, 2, 1, 1, 30);
+}
+
+TEST(test_layer, forward_convolution_window_kernels) {
+  // 常见的窗口使用参数固定的im2col实例，其他窗口使用通用实例
+  CheckConvolution(4, 8, 2, 0, 2, 1, 16);
+  CheckConvolution(4, 8, 5, 2, 1, 1, 13);
+  CheckConvolution(4, 8, 4, 1, 1, 1, 13);
+  CheckConvolution(4, 8, 7, 3, 2, 1, 17);
+}
+
+TEST(test_layer, forward_convolution_fused_activation) {
+  const std::vector<ActivationType> activations{ActivationType::kActivationRelu, ActivationType::kActivationSigmoid,
+                                                ActivationType::kActivationSiLU, ActivationType::kActivationHardSwish,
+                                                ActivationType::kActivationHardSigmoid};
+  for (const ActivationType activation : activations) {
+    // 依次覆盖winograd、im2col、1x1和逐通道卷积
+    CheckConvolution(8, 16, 3, 1, 1, 1, 14, activation);
+    CheckConvolution(6, 12, 3, 1, 2, 1, 15, activation);
+    CheckConvolution(16, 24, 1, 0, 1, 1, 10, activation);
+    CheckConvolution(8, 8, 3, 1, 1, 8, 13, activation);
+  }
+}
+
+TEST(test_layer, forward_convolution_residual) {
+  // 残差在winograd、im2col和1x1卷积写回输出时加上，逐通道卷积改用im2col
+  for (const bool builtin : {false, true}) {
+    ASSERT_TRUE(SetGemmBackend(builtin ? GemmBackend::kBuiltin : CompiledGemmBackend()));
+    CheckConvolution(8, 16, 3, 1, 1, 1, 14, ActivationType::kActivationRelu, true);
+    CheckConvolution(6, 12, 3, 1, 2, 1, 15, ActivationType::kActivationRelu, true);
+    CheckConvolution(32, 19, 1, 0, 1, 1, 10, ActivationType::kActivationRelu, true);
+    CheckConvolution(8, 8, 3, 1, 1, 8, 13, ActivationType::kActivationNone, true);
+  }
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+}
+
+TEST(test_layer, forward_convolution_packed) {
+  // 使用内置矩阵乘法时卷积核在设置时打包，偏置和激活函数在矩阵乘法中计算
+  ASSERT_TRUE(SetGemmBackend(GemmBackend::kBuiltin));
+  CheckConvolution(8, 16, 3, 1, 1, 1, 14, ActivationType::kActivationRelu);
+  CheckConvolution(6, 12, 3, 1, 2, 1, 15, ActivationType::kActivationSiLU);
+  CheckConvolution(32, 19, 1, 0, 1, 1, 10, ActivationType::kActivationHardSwish);
+  CheckConvolution(16, 8, 5, 2, 1, 2, 30);
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+}
+
+TEST(test_layer, forward_convolution_sparse) {
+  // 阈值为0时所有卷积核都按稀疏矩阵计算，3x3步长为1的卷积不再使用Winograd
+  SetSparseThreshold(0.f);
+  CheckConvolution(8, 16, 3, 1, 1, 1, 14, ActivationType::kActivationRelu);
+  CheckConvolution(6, 12, 3, 1, 2, 1, 15, ActivationType::kActivationSiLU);
+  CheckConvolution(32, 19, 1, 0, 1, 1, 10, ActivationType::kActivationHardSwish);
+  CheckConvolution(16, 8, 5, 2, 1, 2, 30);
+  SetSparseThreshold(0.7f);
+}
+
+TEST(test_layer, fused_activation_same_as_layer) {
+  const std::vector<std::pair<ActivationType, std::shared_ptr<Layer>>> activation_layers{
+      {ActivationType::kActivationRelu, std::make_shared<ReluLayer>()},
+      {ActivationType::kActivationSigmoid, std::make_shared<SigmoidLayer>()},
+      {ActivationType::kActivationSiLU, std::make_shared<SiLULayer>()},
+      {ActivationType::kActivationHardSwish, std::make_shared<HardSwishLayer>()},
+      {ActivationType::kActivationHardSigmoid, std::make_shared<HardSigmoid>()},
+  };
+  for (const auto &activation_layer : activation_layers) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(2, 7, 9);
+    input->Rand();
+    input->Transform([](float val) { return val * 10.f - 5.f; });
+    std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+    std::vector<std::shared_ptr<Tensor<float>>> outputs{std::make_shared<Tensor<float>>(2, 7, 9)};
+    ASSERT_EQ(activation_layer.second->Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+    std::shared_ptr<Tensor<float>> fused = input->Clone();
+    ApplyActivation(activation_layer.first, fused->data().memptr(), fused->size());
+    for (uint32_t i = 0; i < fused->size(); ++i) {
+      ASSERT_NEAR(fused->index(i), outputs.front()->index(i), 1e-6);
+    }
+  }
+}
+
+TEST(test_layer, forward_convolution_tune) {
+  const uint32_t in_channel = 8;
+  const uint32_t out_channel = 16;
+  const uint32_t batch_size = 2;
+  ConvolutionLayer conv_layer(out_channel, in_channel, 3, 3, 1, 1, 1, 1, 1, false);
+  std::vector<std::shared_ptr<Tensor<float>>> weights;
+  for (uint32_t k = 0; k < out_channel; ++k) {
+    std::shared_ptr<Tensor<float>> weight = std::make_shared<Tensor<float>>(in_channel, 3, 3);
+    weight->Rand();
+    weights.push_back(weight);
+  }
+  conv_layer.set_weights(weights);
+  ASSERT_EQ(conv_layer.CandidateAlgorithms(in_channel).size(), 2);
+
+  // 第一次调优时测量并写入缓存，之后从缓存中读取同样的结果
+  const std::vector<std::vector<int32_t>> input_shapes{{int32_t(batch_size), int32_t(in_channel), 14, 12}};
+  TuningCache tuning_cache;
+  ASSERT_TRUE(conv_layer.Tune(input_shapes, tuning_cache));
+  ASSERT_EQ(tuning_cache.size(), 1);
+  ASSERT_TRUE(tuning_cache.modified());
+  const ConvolutionAlgorithm tuned_algorithm = conv_layer.ChooseAlgorithm(in_channel, 14, 12);
+  ASSERT_EQ(conv_layer.ChooseAlgorithm(in_channel, 15, 12), conv_layer.SelectAlgorithm(in_channel));
+
+  const std::string cache_path = "conv_tuning_cache.txt";
+  ASSERT_TRUE(tuning_cache.Save(cache_path));
+  ASSERT_FALSE(tuning_cache.modified());
+  TuningCache loaded_cache;
+  ASSERT_TRUE(loaded_cache.Load(cache_path));
+  ASSERT_EQ(loaded_cache.size(), 1);
+  ConvolutionLayer cached_layer(out_channel, in_channel, 3, 3, 1, 1, 1, 1, 1, false);
+  cached_layer.set_weights(weights);
+  ASSERT_TRUE(cached_layer.Tune(input_shapes, loaded_cache));
+  ASSERT_FALSE(loaded_cache.modified());
+  ASSERT_EQ(cached_layer.ChooseAlgorithm(in_channel, 14, 12), tuned_algorithm);
+
+  // 调优后的算法计算结果不变
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(in_channel, 14, 12);
+    input->Rand();
+    inputs.push_back(input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+  ASSERT_EQ(cached_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    const auto &expected = DirectConvolution(inputs.at(b), weights, {}, 1, 1, 1);
+    for (uint32_t i = 0; i < expected->size(); ++i) {
+      ASSERT_NEAR(outputs.at(b)->index(i), expected->index(i), 1e-4);
+    }
+  }
+
+  // 其他处理器上保存的缓存不会被使用
+  std::ofstream other_cache(cache_path, std::ios::trunc);
+  other_cache << "kuiper_tuning_cache 1\nother cpu\nconv2d 1\n";
+  other_cache.close();
+  ASSERT_FALSE(loaded_cache.Load(cache_path));
+  ASSERT_EQ(loaded_cache.size(), 0);
+  std::remove(cache_path.c_str());
+}
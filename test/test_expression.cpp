@@ -5,6 +5,7 @@
 #include "parser/parse_expression.hpp"
 #include "runtime/runtime_ir.hpp"
 #include "data/load_data.hpp"
+#include "data/device.hpp"
 #include "../source/layer/details/expression.hpp"
 
 TEST(test_expression, add1) {
@@ -228,6 +229,79 @@ TEST(test_layer, complex2) {
   ASSERT_TRUE(arma::approx_equal(output1->data(), output2->data(), "absdiff", 1e-5));
 }
 
+TEST(test_layer, complex_batch_broadcast) {
+  using namespace kuiper_infer;
+  const std::string &str = "add(mul(@0,@1),add(@2,@0))";
+  ExpressionLayer layer(str);
+  const uint32_t batch_size = 2;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  // 输入按照表达式中的编号排列，每个编号连续放置batch_size个张量，@1每个通道只有一个值
+  for (uint32_t j = 0; j < 3; ++j) {
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, j == 1 ? 1 : 37, j == 1 ? 1 : 29);
+      input->Rand();
+      inputs.push_back(input);
+    }
+  }
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    outputs.at(i) = std::make_shared<Tensor<float>>(3, 37, 29);
+  }
+  const std::vector<std::shared_ptr<Tensor<float>>> origin_outputs = outputs;
+  const auto status = layer.Forward(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    // 结果直接写入已有的输出张量
+    ASSERT_EQ(outputs.at(i), origin_outputs.at(i));
+    const auto &input0 = inputs.at(i);
+    const auto &input1 = inputs.at(batch_size + i);
+    const auto &input2 = inputs.at(2 * batch_size + i);
+    for (uint32_t c = 0; c < 3; ++c) {
+      for (uint32_t r = 0; r < 37; ++r) {
+        for (uint32_t w = 0; w < 29; ++w) {
+          const float expected = input0->at(c, r, w) * input1->at(c, 0, 0) + (input2->at(c, r, w) + input0->at(c, r, w));
+          ASSERT_NEAR(outputs.at(i)->at(c, r, w), expected, 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TEST(test_layer, complex_broadcast_intermediate_cuda) {
+  using namespace kuiper_infer;
+  // 广播的中间结果作为左操作数和完整的输入运算，结果不能覆盖还没有读完的广播中间结果
+  if (!DeviceAvailable(DeviceType::kDeviceCUDA)) {
+    return;
+  }
+  const std::string &str = "mul(add(mul(@1,@1),@0),@0)";
+  ExpressionLayer layer(str);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  inputs.push_back(std::make_shared<Tensor<float>>(16, 23, 31));
+  inputs.push_back(std::make_shared<Tensor<float>>(16, 1, 1));
+  for (const auto &input : inputs) {
+    input->Rand();
+  }
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(1);
+  outputs.front() = std::make_shared<Tensor<float>>(16, 23, 31);
+  const auto status = layer.ForwardCuda(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+  const std::shared_ptr<Tensor<float>> &output = outputs.front();
+  ASSERT_EQ(output->device(), DeviceType::kDeviceCUDA);
+  output->SyncTo(DeviceType::kDeviceCPU);
+  for (uint32_t c = 0; c < 16; ++c) {
+    const float scale = inputs.at(1)->at(c, 0, 0) * inputs.at(1)->at(c, 0, 0);
+    for (uint32_t r = 0; r < 23; ++r) {
+      for (uint32_t w = 0; w < 31; ++w) {
+        const float input = inputs.at(0)->at(c, r, w);
+        ASSERT_NEAR(output->at(c, r, w), (scale + input) * input, 1e-5);
+      }
+    }
+  }
+}
+
 TEST(test_parser, tokenizer) {
   using namespace kuiper_infer;
   const std::string &str = "add(add(add(@0,@1),@1),add(@0,@2))";
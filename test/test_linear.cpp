@@ -5,6 +5,8 @@
 #include <glog/logging.h>
 #include "data/tensor.hpp"
 #include "../source/layer/details/linear.hpp"
+#include "data/half.hpp"
+#include "data/gemm.hpp"
 
 TEST(test_layer, forward_linear1) {
   using namespace kuiper_infer;
@@ -303,3 +305,460 @@ TEST(test_layer, forward_linear8) {
 
 
 
+
+TEST(test_layer, forward_linear_blocked) {
+  using namespace kuiper_infer;
+  // 输入特征较多时权重会被切分成多个列块并行计算
+  const uint32_t in_features = 2048;
+  const uint32_t out_features = 16;
+  const uint32_t in_dims = 1;
+
+  LinearLayer linear_layer(in_features, out_features, false);
+  std::vector<float> weights_raw;
+  float expected = 0.f;
+  for (int i = 0; i < out_features; ++i) {
+    for (int j = 0; j < in_features; ++j) {
+      weights_raw.push_back(float(j % 5 + 1));
+    }
+  }
+  for (int j = 0; j < in_features; ++j) {
+    expected += float(j % 5 + 1);
+  }
+  linear_layer.set_weights(weights_raw);
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, in_dims);
+  input->Fill(1.f);
+  std::shared_ptr<Tensor<float>> output = std::make_shared<Tensor<float>>(1, out_features, in_dims);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  inputs.push_back(input);
+  std::vector<std::shared_ptr<Tensor<float>>> outputs;
+  outputs.push_back(output);
+
+  const auto status = linear_layer.Forward(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+  ASSERT_EQ(outputs.size(), 1);
+  for (int i = 0; i < out_features; ++i) {
+    ASSERT_EQ(outputs.front()->index(i), expected);
+  }
+}
+
+TEST(test_layer, forward_linear_fused_relu) {
+  using namespace kuiper_infer;
+  const uint32_t in_features = 16;
+  const uint32_t out_features = 8;
+  const uint32_t in_dims = 1;
+
+  LinearLayer linear_layer(in_features, out_features, true);
+  linear_layer.set_activation(ActivationType::kActivationRelu);
+  std::vector<float> weights(in_features * out_features, 1.f);
+  linear_layer.set_weights(weights);
+  // 前一半输出通道的结果为负数，应该被截断为0
+  std::vector<float> bias;
+  for (uint32_t k = 0; k < out_features; ++k) {
+    bias.push_back(k < out_features / 2 ? -32.f : 1.f);
+  }
+  linear_layer.set_bias(bias);
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, in_dims);
+  input->Fill(1.f);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{std::make_shared<Tensor<float>>(1, out_features, in_dims)};
+
+  const auto status = linear_layer.Forward(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+  const auto &output = outputs.front();
+  for (uint32_t k = 0; k < out_features; ++k) {
+    for (uint32_t j = 0; j < in_dims; ++j) {
+      ASSERT_EQ(output->at(0, k, j), k < out_features / 2 ? 0.f : in_features + 1.f);
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_global_pooling) {
+  using namespace kuiper_infer;
+  // 合并了全局平均池化的全连接层，结果和先池化再计算全连接层相同
+  const uint32_t in_features = 300;
+  const uint32_t out_features = 10;
+  const uint32_t batch = 4;
+
+  std::vector<float> weights(in_features * out_features);
+  std::vector<float> bias(out_features);
+  for (uint32_t i = 0; i < weights.size(); ++i) {
+    weights.at(i) = float(i % 7) * 0.1f - 0.3f;
+  }
+  for (uint32_t k = 0; k < out_features; ++k) {
+    bias.at(k) = float(k) - 5.f;
+  }
+  LinearLayer pooling_linear_layer(in_features, out_features, true);
+  pooling_linear_layer.set_global_pooling(true);
+  pooling_linear_layer.set_activation(ActivationType::kActivationRelu);
+  pooling_linear_layer.set_weights(weights);
+  pooling_linear_layer.set_bias(bias);
+  LinearLayer linear_layer(in_features, out_features, true);
+  linear_layer.set_activation(ActivationType::kActivationRelu);
+  linear_layer.set_weights(weights);
+  linear_layer.set_bias(bias);
+
+  std::vector<int32_t> output_shape;
+  ASSERT_TRUE(pooling_linear_layer.InferOutputShape({{int32_t(batch), int32_t(in_features), 7, 7}}, output_shape));
+  ASSERT_EQ(output_shape, std::vector<int32_t>({int32_t(batch), int32_t(out_features)}));
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  std::vector<std::shared_ptr<Tensor<float>>> pooled_inputs;
+  for (uint32_t i = 0; i < batch; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(in_features, 7, 7);
+    input->Rand();
+    inputs.push_back(input);
+    std::shared_ptr<Tensor<float>> pooled_input = std::make_shared<Tensor<float>>(1, in_features, 1);
+    for (uint32_t c = 0; c < in_features; ++c) {
+      pooled_input->index(c) = arma::accu(input->at(c)) / 49.f;
+    }
+    pooled_inputs.push_back(pooled_input);
+  }
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs1(batch);
+  std::vector<std::shared_ptr<Tensor<float>>> outputs2(batch);
+  ASSERT_EQ(pooling_linear_layer.Forward(inputs, outputs1), InferStatus::kInferSuccess);
+  ASSERT_EQ(linear_layer.Forward(pooled_inputs, outputs2), InferStatus::kInferSuccess);
+  for (uint32_t i = 0; i < batch; ++i) {
+    ASSERT_EQ(outputs1.at(i)->shapes(), outputs2.at(i)->shapes());
+    for (uint32_t k = 0; k < out_features; ++k) {
+      ASSERT_NEAR(outputs1.at(i)->index(k), outputs2.at(i)->index(k), 1e-4f);
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_contiguous_batch) {
+  using namespace kuiper_infer;
+  const uint32_t in_features = 24;
+  const uint32_t out_features = 10;
+  const uint32_t batch_size = 5;
+
+  LinearLayer linear_layer(in_features, out_features, true);
+  std::vector<float> weights_raw;
+  for (uint32_t i = 0; i < out_features * in_features; ++i) {
+    weights_raw.push_back(float(i % 7) * 0.25f - 0.5f);
+  }
+  std::vector<float> bias_raw;
+  for (uint32_t i = 0; i < out_features; ++i) {
+    bias_raw.push_back(float(i) * 0.1f);
+  }
+  linear_layer.set_weights(weights_raw);
+  linear_layer.set_bias(bias_raw);
+
+  // 连续内存中的批次合并成一次矩阵乘法，结果和逐个样本计算相同
+  const std::vector<std::shared_ptr<Tensor<float>>> &batch_inputs =
+      Tensor<float>::CreateBatch(batch_size, 1, in_features, 1);
+  ASSERT_NE(Tensor<float>::ContiguousBatch(batch_inputs), nullptr);
+  std::vector<std::shared_ptr<Tensor<float>>> separate_inputs;
+  for (const auto &input : batch_inputs) {
+    input->Rand();
+    separate_inputs.push_back(input->Clone());
+  }
+  ASSERT_EQ(Tensor<float>::ContiguousBatch(separate_inputs), nullptr);
+
+  std::vector<std::shared_ptr<Tensor<float>>> batch_outputs =
+      Tensor<float>::CreateBatch(batch_size, 1, out_features, 1);
+  std::vector<std::shared_ptr<Tensor<float>>> separate_outputs(batch_size);
+  ASSERT_EQ(linear_layer.Forward(batch_inputs, batch_outputs), InferStatus::kInferSuccess);
+  ASSERT_EQ(linear_layer.Forward(separate_inputs, separate_outputs), InferStatus::kInferSuccess);
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    ASSERT_EQ(batch_outputs.at(b)->raw_shapes(), separate_outputs.at(b)->raw_shapes());
+    for (uint32_t i = 0; i < out_features; ++i) {
+      ASSERT_NEAR(batch_outputs.at(b)->index(i), separate_outputs.at(b)->index(i), 1e-5);
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_gathered_batch) {
+  using namespace kuiper_infer;
+  const uint32_t in_features = 40;
+  const uint32_t out_features = 12;
+  const uint32_t input_dim = 3;
+  const uint32_t batch_size = 6;
+
+  LinearLayer linear_layer(in_features, out_features, true);
+  std::vector<float> weights_raw;
+  for (uint32_t i = 0; i < out_features * in_features; ++i) {
+    weights_raw.push_back(float(i % 11) * 0.125f - 0.6f);
+  }
+  std::vector<float> bias_raw;
+  for (uint32_t i = 0; i < out_features; ++i) {
+    bias_raw.push_back(float(i) * 0.2f - 1.f);
+  }
+  linear_layer.set_weights(weights_raw);
+  linear_layer.set_bias(bias_raw);
+
+  // 不连续的样本先拼接在一起再做一次矩阵乘法，结果和逐个样本计算相同
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, input_dim);
+    input->Rand();
+    inputs.push_back(input);
+  }
+  ASSERT_EQ(Tensor<float>::ContiguousBatch(inputs), nullptr);
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(batch_size);
+  ASSERT_EQ(linear_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::vector<std::shared_ptr<Tensor<float>>> single_inputs{inputs.at(b)};
+    std::vector<std::shared_ptr<Tensor<float>>> single_outputs(1);
+    ASSERT_EQ(linear_layer.Forward(single_inputs, single_outputs), InferStatus::kInferSuccess);
+    ASSERT_EQ(outputs.at(b)->raw_shapes(), single_outputs.front()->raw_shapes());
+    for (uint32_t i = 0; i < out_features * input_dim; ++i) {
+      ASSERT_NEAR(outputs.at(b)->index(i), single_outputs.front()->index(i), 1e-5);
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_int8) {
+  using namespace kuiper_infer;
+  const uint32_t in_features = 300;
+  const uint32_t out_features = 70;
+  const uint32_t batch_size = 3;
+
+  LinearLayer linear_layer(in_features, out_features, true);
+  std::vector<float> weights_raw;
+  for (uint32_t i = 0; i < out_features * in_features; ++i) {
+    weights_raw.push_back(float(i % 13) * 0.1f - 0.6f);
+  }
+  std::vector<float> bias_raw;
+  for (uint32_t i = 0; i < out_features; ++i) {
+    bias_raw.push_back(float(i) * 0.1f);
+  }
+  linear_layer.set_weights(weights_raw);
+  linear_layer.set_bias(bias_raw);
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  float input_abs_max = 0.f;
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, 1);
+    input->Rand();
+    input_abs_max = std::max(input_abs_max, arma::abs(input->data()).max());
+    inputs.push_back(input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> float_outputs(batch_size);
+  ASSERT_EQ(linear_layer.Forward(inputs, float_outputs), InferStatus::kInferSuccess);
+  float max_output = 0.f;
+  for (const auto &output : float_outputs) {
+    max_output = std::max(max_output, arma::abs(output->data()).max());
+  }
+  const size_t float_bytes = linear_layer.ParamBytes();
+
+  // 标定的输入范围和每列动态计算的输入范围都要和浮点结果接近
+  for (const float calibrated_abs_max : {input_abs_max, 0.f}) {
+    ASSERT_TRUE(linear_layer.QuantizeInt8(calibrated_abs_max));
+    ASSERT_LT(linear_layer.ParamBytes(), float_bytes);
+    std::vector<std::shared_ptr<Tensor<float>>> int8_outputs(batch_size);
+    ASSERT_EQ(linear_layer.Forward(inputs, int8_outputs), InferStatus::kInferSuccess);
+    for (uint32_t b = 0; b < batch_size; ++b) {
+      ASSERT_EQ(int8_outputs.at(b)->raw_shapes(), float_outputs.at(b)->raw_shapes());
+      for (uint32_t i = 0; i < int8_outputs.at(b)->size(); ++i) {
+        ASSERT_NEAR(int8_outputs.at(b)->index(i), float_outputs.at(b)->index(i), max_output * 0.02f);
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_half) {
+  using namespace kuiper_infer;
+  const uint32_t in_features = 1000;
+  const uint32_t out_features = 70;
+  const uint32_t batch_size = 2;
+
+  std::vector<float> weights_raw;
+  for (uint32_t i = 0; i < out_features * in_features; ++i) {
+    weights_raw.push_back(float(i % 13) * 0.1f - 0.6f + float(i % 5) * 1e-3f);
+  }
+  std::vector<float> bias_raw;
+  for (uint32_t i = 0; i < out_features; ++i) {
+    bias_raw.push_back(float(i) * 0.1f);
+  }
+  LinearLayer float_layer(in_features, out_features, true);
+  float_layer.set_weights(weights_raw);
+  float_layer.set_bias(bias_raw);
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t b = 0; b < batch_size; ++b) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, 1);
+    input->Rand();
+    inputs.push_back(input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> float_outputs(batch_size);
+  ASSERT_EQ(float_layer.Forward(inputs, float_outputs), InferStatus::kInferSuccess);
+
+  for (const RuntimeDataType type : {RuntimeDataType::kTypeFloat16, RuntimeDataType::kTypeBFloat16}) {
+    // 从模型中加载的半精度权重和加载之后再压缩的权重得到相同的结果
+    std::vector<uint16_t> compressed_raw(weights_raw.size());
+    if (type == RuntimeDataType::kTypeFloat16) {
+      FloatToHalf(weights_raw.data(), weights_raw.size(), compressed_raw.data());
+    } else {
+      FloatToBFloat16(weights_raw.data(), weights_raw.size(), compressed_raw.data());
+    }
+    LinearLayer loaded_layer(in_features, out_features, true);
+    loaded_layer.set_weights(type, compressed_raw);
+    loaded_layer.set_bias(bias_raw);
+    ASSERT_EQ(loaded_layer.weight_type(), type);
+    ASSERT_TRUE(loaded_layer.weights().empty());
+    ASSERT_LT(loaded_layer.ParamBytes(), float_layer.ParamBytes());
+
+    LinearLayer compressed_layer(in_features, out_features, true);
+    compressed_layer.set_weights(weights_raw);
+    compressed_layer.set_bias(bias_raw);
+    ASSERT_TRUE(compressed_layer.CompressWeights(type));
+    ASSERT_EQ(compressed_layer.ParamBytes(), loaded_layer.ParamBytes());
+
+    std::vector<std::shared_ptr<Tensor<float>>> loaded_outputs(batch_size);
+    std::vector<std::shared_ptr<Tensor<float>>> compressed_outputs(batch_size);
+    ASSERT_EQ(loaded_layer.Forward(inputs, loaded_outputs), InferStatus::kInferSuccess);
+    ASSERT_EQ(compressed_layer.Forward(inputs, compressed_outputs), InferStatus::kInferSuccess);
+    const float tolerance = type == RuntimeDataType::kTypeFloat16 ? 0.02f : 0.2f;
+    for (uint32_t b = 0; b < batch_size; ++b) {
+      for (uint32_t i = 0; i < out_features; ++i) {
+        ASSERT_FLOAT_EQ(loaded_outputs.at(b)->index(i), compressed_outputs.at(b)->index(i));
+        ASSERT_NEAR(loaded_outputs.at(b)->index(i), float_outputs.at(b)->index(i), tolerance);
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_group_quantized) {
+  using namespace kuiper_infer;
+  // 输入特征不是分组大小的整数倍，输出特征填不满最后一个面板，输入的列数不是同时计算的列数的整数倍
+  const uint32_t in_features = 200;
+  const uint32_t out_features = 100;
+  const uint32_t in_dims = 3;
+  const uint32_t group_size = 64;
+  arma::fmat weight_data(out_features, in_features, arma::fill::randu);
+  weight_data -= 0.5f;
+  std::vector<float> weights;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    for (uint32_t i = 0; i < in_features; ++i) {
+      weights.push_back(weight_data.at(o, i));
+    }
+  }
+  std::vector<float> bias;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    bias.push_back(float(o) * 0.01f);
+  }
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, in_dims);
+  input->Rand();
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+
+  LinearLayer float_layer(in_features, out_features, true);
+  float_layer.set_weights(weights);
+  float_layer.set_bias(bias);
+  for (const uint32_t bits : {8u, 4u}) {
+    LinearLayer linear_layer(in_features, out_features, true);
+    linear_layer.set_weights(weights);
+    linear_layer.set_bias(bias);
+    ASSERT_FALSE(linear_layer.QuantizeWeights(2, group_size));
+    ASSERT_TRUE(linear_layer.QuantizeWeights(bits, group_size));
+    ASSERT_EQ(linear_layer.weight_bits(), bits);
+    ASSERT_EQ(linear_layer.weight_type(), bits == 8 ? RuntimeDataType::kTypeInt8 : RuntimeDataType::kTypeInt4);
+    ASSERT_TRUE(linear_layer.weights().empty());
+    ASSERT_LT(linear_layer.ParamBytes() * 2, float_layer.ParamBytes());
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs(1);
+    ASSERT_EQ(linear_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+    // 反量化之后的权重和融合在内核中的反量化得到相同的结果
+    const arma::fmat dequantized = DequantizeGroups(QuantizeGroups(weight_data, bits, group_size, 64));
+    const arma::fmat expected = dequantized * input->at(0);
+    const float max_error = arma::abs(dequantized - weight_data).max();
+    ASSERT_LE(max_error, bits == 8 ? 0.5f / 127.f : 0.5f / 7.f);
+    for (uint32_t j = 0; j < in_dims; ++j) {
+      for (uint32_t o = 0; o < out_features; ++o) {
+        ASSERT_NEAR(outputs.front()->at(0, o, j), expected.at(o, j) + bias.at(o), 1e-4f);
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_linear_packed) {
+  using namespace kuiper_infer;
+  // 使用内置矩阵乘法时权重在设置时打包，偏置和激活函数在矩阵乘法中计算，多列输入的偏置同样正确
+  ASSERT_TRUE(SetGemmBackend(GemmBackend::kBuiltin));
+  const uint32_t in_features = 300;
+  const uint32_t out_features = 70;
+  const uint32_t in_dims = 3;
+  LinearLayer linear_layer(in_features, out_features, true);
+  linear_layer.set_activation(ActivationType::kActivationSiLU);
+  arma::fmat weight_data(out_features, in_features, arma::fill::randu);
+  weight_data -= 0.5f;
+  std::vector<float> weights;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    for (uint32_t i = 0; i < in_features; ++i) {
+      weights.push_back(weight_data.at(o, i));
+    }
+  }
+  linear_layer.set_weights(weights);
+  std::vector<float> bias;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    bias.push_back(float(o) * 0.05f - 1.f);
+  }
+  linear_layer.set_bias(bias);
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, in_dims);
+  input->Rand();
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{std::make_shared<Tensor<float>>(1, out_features, in_dims)};
+  ASSERT_EQ(linear_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+  arma::fmat expected = weight_data * input->at(0);
+  for (uint32_t j = 0; j < in_dims; ++j) {
+    for (uint32_t o = 0; o < out_features; ++o) {
+      expected.at(o, j) += bias.at(o);
+    }
+  }
+  ApplyActivation(ActivationType::kActivationSiLU, expected.memptr(), expected.n_elem);
+  const arma::fmat &output = outputs.front()->at(0);
+  ASSERT_LE(arma::abs(output - expected).max(), 1e-3f);
+}
+
+TEST(test_layer, forward_linear_sparse) {
+  using namespace kuiper_infer;
+  // 剪枝之后80%的权重为0，设置权重时转换为稀疏矩阵，单列和多列输入的结果都和稠密计算一致
+  const uint32_t in_features = 300;
+  const uint32_t out_features = 70;
+  LinearLayer linear_layer(in_features, out_features, true);
+  linear_layer.set_activation(ActivationType::kActivationRelu);
+  arma::fmat weight_data(out_features, in_features, arma::fill::randu);
+  weight_data -= 0.5f;
+  std::vector<float> weights;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    for (uint32_t i = 0; i < in_features; ++i) {
+      if ((o * in_features + i) % 5 != 0) {
+        weight_data.at(o, i) = 0.f;
+      }
+      weights.push_back(weight_data.at(o, i));
+    }
+  }
+  ASSERT_GE(ZeroRatio(weight_data.memptr(), weight_data.n_elem), SparseThreshold());
+  linear_layer.set_weights(weights);
+  std::vector<float> bias;
+  for (uint32_t o = 0; o < out_features; ++o) {
+    bias.push_back(float(o) * 0.05f - 1.f);
+  }
+  linear_layer.set_bias(bias);
+  // 只读取压缩之后的权重
+  ASSERT_LT(linear_layer.ParamBytes(), weight_data.n_elem * sizeof(float) / 2);
+
+  for (const uint32_t in_dims : {1u, 37u}) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, in_features, in_dims);
+    input->Rand();
+    std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+    std::vector<std::shared_ptr<Tensor<float>>> outputs{std::make_shared<Tensor<float>>(1, out_features, in_dims)};
+    ASSERT_EQ(linear_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+    arma::fmat expected = weight_data * input->at(0);
+    for (uint32_t j = 0; j < in_dims; ++j) {
+      for (uint32_t o = 0; o < out_features; ++o) {
+        expected.at(o, j) += bias.at(o);
+      }
+    }
+    ApplyActivation(ActivationType::kActivationRelu, expected.memptr(), expected.n_elem);
+    const arma::fmat &output = outputs.front()->at(0);
+    ASSERT_LE(arma::abs(output - expected).max(), 1e-3f);
+  }
+}
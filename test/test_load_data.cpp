@@ -3,6 +3,7 @@
 //
 #include <gtest/gtest.h>
 #include <glog/logging.h>
+#include <cstdio>
 #include "data/load_data.hpp"
 
 TEST(test_load, load_csv_data) {
@@ -143,4 +144,52 @@ TEST(test_load, load_large_data) {
     }
   }
   ASSERT_EQ(data_minus_one, 1024 * 1024);
-}
\ No newline at end of file
+}
+TEST(test_load, load_csv_tensor) {
+  using namespace kuiper_infer;
+  const arma::fmat &data = CSVDataLoader::LoadData("./tmp/data_loader/data2.csv");
+  const std::shared_ptr<Tensor<float>> &tensor = CSVDataLoader::LoadTensor("./tmp/data_loader/data2.csv");
+  ASSERT_NE(tensor, nullptr);
+  ASSERT_EQ(tensor->channels(), 1);
+  ASSERT_EQ(tensor->rows(), data.n_rows);
+  ASSERT_EQ(tensor->cols(), data.n_cols);
+  for (uint32_t i = 0; i < data.n_rows; ++i) {
+    for (uint32_t j = 0; j < data.n_cols; ++j) {
+      ASSERT_EQ(tensor->at(0, i, j), data.at(i, j));
+    }
+  }
+}
+
+TEST(test_load, save_load_npy) {
+  using namespace kuiper_infer;
+  const std::string file_path = "./tmp/data_loader/tensor.npy";
+  for (const auto &shapes : std::vector<std::vector<uint32_t>>{{3, 5, 7}, {1, 4, 6}, {1, 1, 9}}) {
+    Tensor<float> tensor(shapes.at(0), shapes.at(1), shapes.at(2));
+    tensor.Rand();
+    ASSERT_TRUE(BinaryDataLoader::SaveNpy(file_path, tensor));
+
+    const std::shared_ptr<Tensor<float>> &loaded = BinaryDataLoader::LoadNpy(file_path);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_EQ(loaded->shapes(), tensor.shapes());
+    ASSERT_EQ(loaded->raw_shapes(), tensor.raw_shapes());
+    for (uint32_t i = 0; i < tensor.size(); ++i) {
+      ASSERT_EQ(loaded->index(i), tensor.index(i));
+    }
+  }
+  std::remove(file_path.c_str());
+}
+
+TEST(test_load, save_load_raw) {
+  using namespace kuiper_infer;
+  const std::string file_path = "./tmp/data_loader/tensor.raw";
+  Tensor<float> tensor(4, 3, 5);
+  tensor.Rand();
+  ASSERT_TRUE(BinaryDataLoader::SaveRaw(file_path, tensor));
+
+  const std::shared_ptr<Tensor<float>> &loaded = BinaryDataLoader::LoadRaw(file_path, 4, 3, 5);
+  ASSERT_EQ(loaded->shapes(), tensor.shapes());
+  for (uint32_t i = 0; i < tensor.size(); ++i) {
+    ASSERT_EQ(loaded->index(i), tensor.index(i));
+  }
+  std::remove(file_path.c_str());
+}
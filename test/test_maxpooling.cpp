@@ -479,4 +479,97 @@ TEST(test_layer, forward_max_pooling_s77_k77) {
       ASSERT_TRUE(arma::approx_equal(output1->at(c), output2->at(c), "absdiff", 0.01f));
     }
   }
-}
\ No newline at end of file
+}
+TEST(test_layer, forward_max_pooling_padding) {
+  using namespace kuiper_infer;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  std::vector<std::shared_ptr<Tensor<float>>> padded_inputs;
+  const uint32_t kernel_h = 3;
+  const uint32_t kernel_w = 3;
+  const uint32_t stride_h = 2;
+  const uint32_t stride_w = 2;
+  const uint32_t padding = 1;
+  const uint32_t input_size = 3;
+
+  for (uint32_t i = 0; i < input_size; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 33, 28);
+    input->Rand();
+    // 输入中有负数时，按0填充会得到错误的结果
+    input->Transform([](float value) { return value - 0.5f; });
+    inputs.push_back(input);
+
+    std::shared_ptr<Tensor<float>> padded_input = input->Clone();
+    padded_input->Padding({padding, padding, padding, padding}, std::numeric_limits<float>::lowest());
+    padded_inputs.push_back(padded_input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs1;
+  MaxPooling(padded_inputs, outputs1, stride_w, stride_h, kernel_h, kernel_w);
+  ASSERT_EQ(outputs1.size(), input_size);
+  MaxPoolingLayer max_layer(padding, padding, kernel_h, kernel_w, stride_h, stride_w);
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs2(input_size);
+  max_layer.Forward(inputs, outputs2);
+  ASSERT_EQ(outputs2.size(), input_size);
+
+  for (uint32_t i = 0; i < input_size; ++i) {
+    const auto &output1 = outputs1.at(i);
+    const auto &output2 = outputs2.at(i);
+    ASSERT_EQ(output1->shapes(), output2->shapes());
+    uint32_t channels = output1->channels();
+    for (int c = 0; c < channels; ++c) {
+      ASSERT_TRUE(arma::approx_equal(output1->at(c), output2->at(c), "absdiff", 0.01f));
+    }
+  }
+}
+
+TEST(test_layer, forward_max_pooling_vectorized) {
+  using namespace kuiper_infer;
+  // 分别对应2x2步长2、ResNet的3x3步长2填充1以及SPPF的5x5步长1填充2，尺寸覆盖向量宽度的余数部分
+  const std::vector<std::vector<uint32_t>> configs = {{2, 2, 0}, {3, 2, 1}, {5, 1, 2}, {3, 1, 1}};
+  const std::vector<std::pair<uint32_t, uint32_t>> sizes = {{5, 4}, {17, 13}, {40, 31}, {112, 112}};
+  for (const auto &config : configs) {
+    const uint32_t kernel = config.at(0);
+    const uint32_t stride = config.at(1);
+    const uint32_t padding = config.at(2);
+    for (const auto &size : sizes) {
+      std::vector<std::shared_ptr<Tensor<float>>> inputs;
+      std::vector<std::shared_ptr<Tensor<float>>> padded_inputs;
+      for (uint32_t i = 0; i < 2; ++i) {
+        std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(4, size.first, size.second);
+        input->Rand();
+        input->Transform([](float value) { return value - 0.5f; });
+        inputs.push_back(input);
+
+        std::shared_ptr<Tensor<float>> padded_input = input->Clone();
+        padded_input->Padding({padding, padding, padding, padding}, std::numeric_limits<float>::lowest());
+        padded_inputs.push_back(padded_input);
+      }
+      std::vector<std::shared_ptr<Tensor<float>>> outputs1;
+      MaxPooling(padded_inputs, outputs1, stride, stride, kernel, kernel);
+      MaxPoolingLayer max_layer(padding, padding, kernel, kernel, stride, stride);
+      std::vector<std::shared_ptr<Tensor<float>>> outputs2(inputs.size());
+      ASSERT_EQ(max_layer.Forward(inputs, outputs2), InferStatus::kInferSuccess);
+
+      for (uint32_t i = 0; i < inputs.size(); ++i) {
+        ASSERT_EQ(outputs1.at(i)->shapes(), outputs2.at(i)->shapes());
+        for (uint32_t c = 0; c < outputs1.at(i)->channels(); ++c) {
+          ASSERT_TRUE(arma::approx_equal(outputs1.at(i)->at(c), outputs2.at(i)->at(c), "absdiff", 1e-6f))
+                        << "kernel: " << kernel << " stride: " << stride << " size: " << size.first << "x"
+                        << size.second;
+        }
+      }
+    }
+  }
+}
+
+TEST(test_layer, infer_shape_max_pooling_s22_k33) {
+  using namespace kuiper_infer;
+  MaxPoolingLayer max_layer(1, 1, 3, 3, 2, 2);
+  std::vector<int32_t> output_shape;
+  ASSERT_TRUE(max_layer.InferOutputShape({{2, 64, 112, 96}}, output_shape));
+  ASSERT_EQ(output_shape, std::vector<int32_t>({2, 64, 56, 48}));
+
+  // 输入尺寸小于池化核时无法推导输出形状
+  ASSERT_FALSE(max_layer.InferOutputShape({{2, 64, 0, 0}}, output_shape));
+  ASSERT_FALSE(max_layer.InferOutputShape({{2, 64}}, output_shape));
+}
@@ -5,6 +5,59 @@
 #include <glog/logging.h>
 #include "runtime/runtime_ir.hpp"
 #include "data/load_data.hpp"
+#include "runtime/store_zip.hpp"
+#include "layer/abstract/layer_factory.hpp"
+#include "runtime/inference_server.hpp"
+#include "runtime/runtime_pipeline.hpp"
+#include "../source/layer/details/flatten.hpp"
+#include "../source/layer/details/relu.hpp"
+#include "../source/layer/details/linear.hpp"
+#include "layer/abstract/lazy_layer.hpp"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <map>
+
+/// 手动构建计算图时使用的节点，layer为空时只用于图变换和内存规划
+static std::shared_ptr<kuiper_infer::RuntimeOperator> MakeOperator(
+    const std::string &name, const std::string &type, const std::shared_ptr<kuiper_infer::Layer> &layer = nullptr) {
+  std::shared_ptr<kuiper_infer::RuntimeOperator> op = std::make_shared<kuiper_infer::RuntimeOperator>();
+  op->name = name;
+  op->type = type;
+  op->layer = layer;
+  return op;
+}
+
+/// 将prev_op的输出连接到op的输入，shapes是连接处操作数的形状
+static void ConnectOperator(const std::shared_ptr<kuiper_infer::RuntimeOperator> &prev_op,
+                            const std::shared_ptr<kuiper_infer::RuntimeOperator> &op,
+                            const std::vector<int32_t> &shapes = {}) {
+  std::shared_ptr<kuiper_infer::RuntimeOperand> operand = std::make_shared<kuiper_infer::RuntimeOperand>();
+  operand->name = prev_op->name;
+  operand->shapes = shapes;
+  op->input_operands.insert({prev_op->name, operand});
+  op->input_operands_seq.push_back(operand);
+  prev_op->output_operators.insert({op->name, op});
+  prev_op->output_names.push_back(op->name);
+}
+
+/// 写出手动编写的pnnx模型，weights的键是权重文件中的名称，即节点名称.属性名称
+static void WriteModel(const std::string &param_path, const std::string &bin_path, const std::string &param,
+                       const std::map<std::string, std::vector<float>> &weights = {}) {
+  std::ofstream param_file(param_path, std::ios::trunc);
+  param_file << param;
+  pnnx::StoreZipWriter writer;
+  CHECK_EQ(writer.open(bin_path), 0) << "Can not open the model file: " << bin_path;
+  for (const auto &weight : weights) {
+    writer.write_file(weight.first, (const char *) weight.second.data(), weight.second.size() * sizeof(float));
+  }
+  writer.close();
+}
 
 TEST(test_net, forward_resnet18) {
   using namespace kuiper_infer;
@@ -107,3 +160,1658 @@ TEST(test_net, forward_mobilenet2) {
   }
 }
 
+
+TEST(test_net, memory_plan_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  const RuntimeMemoryPlanner &memory_planner = graph.memory_planner();
+  ASSERT_GT(memory_planner.slot_count(), 0);
+  ASSERT_GT(memory_planner.naive_bytes(), 0);
+  ASSERT_LT(memory_planner.planned_bytes(), memory_planner.naive_bytes());
+
+  std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 224, 224);
+  input1->Fill(2.);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  inputs.push_back(input1);
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+  ASSERT_EQ(outputs.size(), 1);
+  const auto &output1 = outputs.front()->data().slice(0);
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  ASSERT_EQ(output1.size(), output2.size());
+  for (uint32_t s = 0; s < output1.size(); ++s) {
+    ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+  }
+}
+
+TEST(test_net, fuse_batchnorm_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  for (const auto &op : graph.operators()) {
+    ASSERT_NE(op->type, "nn.BatchNorm2d");
+  }
+
+  std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 224, 224);
+  input1->Fill(2.);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  inputs.push_back(input1);
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+  ASSERT_EQ(outputs.size(), 1);
+  const auto &output1 = outputs.front()->data().slice(0);
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  ASSERT_EQ(output1.size(), output2.size());
+  for (uint32_t s = 0; s < output1.size(); ++s) {
+    ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+  }
+}
+
+TEST(test_net, forward_resnet18_parallel) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_parallel_execute(true);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(graph.parallel_execute(), true);
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  int repeat_number = 2;
+  for (int i = 0; i < repeat_number; ++i) {
+    std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 224, 224);
+    input1->Fill(2.);
+
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    inputs.push_back(input1);
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+    ASSERT_EQ(outputs.size(), 1);
+
+    const auto &output1 = outputs.front()->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+}
+
+TEST(test_net, store_zip_file_view) {
+  std::vector<float> weights(1000);
+  for (uint32_t i = 0; i < weights.size(); ++i) {
+    weights.at(i) = float(i) * 0.5f;
+  }
+  pnnx::StoreZipWriter writer;
+  ASSERT_EQ(writer.open("store_zip_view.bin"), 0);
+  writer.write_file("conv.weight", (const char *) weights.data(), weights.size() * sizeof(float));
+  writer.close();
+
+  pnnx::StoreZipReader reader;
+  ASSERT_EQ(reader.open("store_zip_view.bin"), 0);
+  ASSERT_EQ(reader.get_file_size("conv.weight"), weights.size() * sizeof(float));
+  std::vector<float> read_weights(weights.size());
+  ASSERT_EQ(reader.read_file("conv.weight", (char *) read_weights.data()), 0);
+  std::shared_ptr<const char> view = reader.get_file_view("conv.weight");
+  ASSERT_EQ(reader.get_file_view("conv.bias"), nullptr);
+  reader.close();
+
+  // 关闭文件之后映射的内存仍然有效
+  ASSERT_NE(view, nullptr);
+  ASSERT_EQ(std::memcmp(view.get(), weights.data(), weights.size() * sizeof(float)), 0);
+  ASSERT_EQ(read_weights, weights);
+  std::remove("store_zip_view.bin");
+}
+
+TEST(test_net, compact_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_compact(true);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_GT(graph.reclaimed_bytes(), 0);
+  for (const auto &op : graph.operators()) {
+    ASSERT_TRUE(op->attribute.empty());
+  }
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 释放之后再次Build会重新加载模型文件
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 224, 224);
+    input1->Fill(2.);
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    inputs.push_back(input1);
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+    ASSERT_EQ(outputs.size(), 1);
+    const auto &output1 = outputs.front()->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+  }
+}
+
+TEST(test_net, cache_resnet18) {
+  using namespace kuiper_infer;
+  const std::string cache_path = "resnet18_batch1.kuiper";
+  std::remove(cache_path.data());
+  RuntimeGraph graph1("tmp/resnet/resnet18_batch1.param",
+                      "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph1.set_cache_path(cache_path);
+  graph1.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 第二次加载时不再需要pnnx模型文件
+  RuntimeGraph graph2("", "");
+  graph2.set_cache_path(cache_path);
+  graph2.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(graph1.operators().size(), graph2.operators().size());
+
+  std::shared_ptr<Tensor<float>> input1 = std::make_shared<Tensor<float>>(3, 224, 224);
+  input1->Fill(2.);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  inputs.push_back(input1);
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = graph2.Forward(inputs, false);
+  ASSERT_EQ(outputs.size(), 1);
+  const auto &output1 = outputs.front()->data().slice(0);
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  ASSERT_EQ(output1.size(), output2.size());
+  for (uint32_t s = 0; s < output1.size(); ++s) {
+    ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+  }
+  std::remove(cache_path.data());
+}
+
+TEST(test_net, cache_stale_model) {
+  using namespace kuiper_infer;
+  namespace fs = std::filesystem;
+  const std::string cache_path = "resnet18_stale.kuiper";
+  const std::string param_path = "resnet18_stale.param";
+  std::remove(cache_path.data());
+  fs::copy_file("tmp/resnet/resnet18_batch1.param", param_path, fs::copy_options::overwrite_existing);
+  const auto &read_file = [](const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  };
+
+  RuntimeGraph graph1(param_path, "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph1.set_cache_path(cache_path);
+  graph1.Build("pnnx_input_0", "pnnx_output_0");
+  const std::string saved_cache = read_file(cache_path);
+  ASSERT_FALSE(saved_cache.empty());
+
+  // 模型文件没有变化时从缓存加载，不会重新生成缓存
+  RuntimeGraph graph2(param_path, "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph2.set_cache_path(cache_path);
+  graph2.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(read_file(cache_path), saved_cache);
+
+  // 结构文件更新之后缓存过期，重新从模型文件构建并保存带有新指纹的缓存
+  fs::last_write_time(param_path, fs::last_write_time(param_path) + std::chrono::hours(1));
+  RuntimeGraph graph3(param_path, "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph3.set_cache_path(cache_path);
+  graph3.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_NE(read_file(cache_path), saved_cache);
+  ASSERT_EQ(graph1.operators().size(), graph3.operators().size());
+  std::remove(cache_path.data());
+  std::remove(param_path.data());
+}
+
+TEST(test_net, cache_stale_content_and_settings) {
+  using namespace kuiper_infer;
+  namespace fs = std::filesystem;
+  const std::string cache_path = "relu_stale.kuiper";
+  const std::string param_path = "relu_stale.pnnx.param";
+  const std::string bin_path = "relu_stale.pnnx.bin";
+  std::remove(cache_path.data());
+  const std::string &param_text = "7767517\n"
+                                  "3 2\n"
+                                  "pnnx.Input pnnx_input_0 0 1 0 #0=(1,2,4,4)f32\n"
+                                  "nn.ReLU relu 1 1 0 1 #0=(1,2,4,4)f32 #1=(1,2,4,4)f32\n"
+                                  "pnnx.Output pnnx_output_0 1 0 1 #1=(1,2,4,4)f32\n";
+  WriteModel(param_path, bin_path, param_text);
+  const auto &read_file = [](const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  };
+  const auto &has_operator = [](const RuntimeGraph &graph, const std::string &name) {
+    return std::any_of(graph.operators().begin(), graph.operators().end(),
+                       [&](const std::shared_ptr<RuntimeOperator> &op) { return op->name == name; });
+  };
+
+  RuntimeGraph graph1(param_path, bin_path);
+  graph1.set_cache_path(cache_path);
+  graph1.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_TRUE(has_operator(graph1, "relu"));
+
+  // 同一秒内大小不变的改写：修改时间恢复为原来的值，只有内容的哈希能发现变化
+  const fs::file_time_type write_time = fs::last_write_time(param_path);
+  std::string new_param_text = param_text;
+  new_param_text.replace(new_param_text.find(" relu "), 6, " relx ");
+  std::ofstream(param_path, std::ios::binary | std::ios::trunc) << new_param_text;
+  fs::last_write_time(param_path, write_time);
+  RuntimeGraph graph2(param_path, bin_path);
+  graph2.set_cache_path(cache_path);
+  graph2.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_TRUE(has_operator(graph2, "relx"));
+  const std::string saved_cache = read_file(cache_path);
+
+  // 最大批次不同时不加载缓存
+  RuntimeGraph graph3(param_path, bin_path);
+  graph3.set_cache_path(cache_path);
+  graph3.set_max_batch_size(4);
+  graph3.Build("pnnx_input_0", "pnnx_output_0");
+  const std::string batch_cache = read_file(cache_path);
+  ASSERT_NE(batch_cache, saved_cache);
+
+  // 图优化过程不同时不加载缓存
+  RuntimeGraph graph4(param_path, bin_path);
+  graph4.set_cache_path(cache_path);
+  graph4.set_max_batch_size(4);
+  ASSERT_TRUE(graph4.pass_manager().RemovePass(graph4.pass_manager().passes().front()->name()));
+  graph4.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_NE(read_file(cache_path), batch_cache);
+
+  // 设置相同时直接从缓存加载
+  RuntimeGraph graph5(param_path, bin_path);
+  graph5.set_cache_path(cache_path);
+  graph5.set_max_batch_size(4);
+  graph5.pass_manager().RemovePass(graph5.pass_manager().passes().front()->name());
+  const std::string reused_cache = read_file(cache_path);
+  graph5.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(read_file(cache_path), reused_cache);
+  std::remove(cache_path.data());
+  std::remove(param_path.data());
+  std::remove(bin_path.data());
+}
+
+TEST(test_net, generate_source_group_conv) {
+  using namespace kuiper_infer;
+  const std::string header_path = "group_conv_model.hpp";
+  const std::string source_path = "group_conv_model.cpp";
+  RuntimeGraph graph("tmp/group_conv/group_conv.pnnx.param",
+                     "tmp/group_conv/group_conv.pnnx.bin");
+  ASSERT_FALSE(graph.GenerateSource(header_path, source_path, "GroupConvModel"));
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_FALSE(graph.GenerateSource(header_path, source_path, "1GroupConv"));
+  ASSERT_TRUE(graph.GenerateSource(header_path, source_path, "GroupConvModel"));
+
+  const auto &read_file = [](const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+  };
+  const std::string &header = read_file(header_path);
+  const std::string &source = read_file(source_path);
+  ASSERT_NE(header.find("class GroupConvModel {"), std::string::npos);
+  ASSERT_NE(header.find("kInputShape[3] = {4, 16, 16}"), std::string::npos);
+  ASSERT_NE(source.find("#include \"group_conv_model.hpp\""), std::string::npos);
+  // 卷积直接调用具体的Layer，权重内嵌在源文件中
+  ASSERT_NE(source.find("ConvolutionLayer::GetInstance(op, layer)"), std::string::npos);
+  ASSERT_NE(source.find("->ConvolutionLayer::Forward(impl.inputs"), std::string::npos);
+  ASSERT_NE(source.find("alignas(64) const uint32_t kWeight"), std::string::npos);
+  ASSERT_EQ(source.find("LayerRegisterer::CreateLayer"), std::string::npos);
+
+  // 编译生成的代码，读取输入执行一次推理并写出输出，和计算图的结果比较
+  const std::string driver_path = "group_conv_model_main.cpp";
+  const std::string program_path = "./group_conv_model";
+  const std::string input_path = "group_conv_model_input.bin";
+  const std::string output_path = "group_conv_model_output.bin";
+  {
+    std::ofstream driver(driver_path, std::ios::trunc);
+    driver << R"(#include "group_conv_model.hpp"
+#include <fstream>
+int main(int argc, char *argv[]) {
+  using namespace kuiper_infer;
+  GroupConvModel model;
+  std::ifstream input_file(argv[1], std::ios::binary);
+  Tensor<float> &input = model.input(0);
+  input_file.read(reinterpret_cast<char *>(input.data().memptr()), input.size() * sizeof(float));
+  model.Forward();
+  const Tensor<float> &output = model.output(0);
+  std::ofstream output_file(argv[2], std::ios::binary);
+  output_file.write(reinterpret_cast<const char *>(output.data().memptr()), output.size() * sizeof(float));
+  return input_file.good() && output_file.good() ? 0 : 1;
+}
+)";
+  }
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(4, 16, 16);
+  input->Rand();
+  {
+    std::ofstream input_file(input_path, std::ios::binary | std::ios::trunc);
+    input_file.write(reinterpret_cast<const char *>(input->data().memptr()), input->size() * sizeof(float));
+  }
+  const std::string compile_command = std::string(KUIPER_TEST_CXX_COMPILER) + " @" + KUIPER_TEST_CODEGEN_COMPILE + " "
+      + driver_path + " " + source_path + " @" + KUIPER_TEST_CODEGEN_LINK + " -o " + program_path;
+  ASSERT_EQ(std::system(compile_command.c_str()), 0) << compile_command;
+  ASSERT_EQ(std::system((program_path + " " + input_path + " " + output_path).c_str()), 0);
+
+  const std::shared_ptr<Tensor<float>> &output = graph.Forward({input}).front();
+  std::vector<float> generated_output(output->size());
+  std::ifstream output_file(output_path, std::ios::binary);
+  output_file.read(reinterpret_cast<char *>(generated_output.data()), generated_output.size() * sizeof(float));
+  ASSERT_TRUE(output_file.good());
+  const float *output_ptr = output->data().memptr();
+  for (uint32_t i = 0; i < generated_output.size(); ++i) {
+    ASSERT_LE(std::abs(generated_output.at(i) - output_ptr[i]), 1e-5f);
+  }
+
+  // 无法还原的参数不会生成代码
+  for (const auto &op : graph.operators()) {
+    if (op->type == "nn.Conv2d") {
+      op->params.insert({"unknown", new RuntimeParameter});
+      break;
+    }
+  }
+  ASSERT_FALSE(graph.GenerateSource(header_path, source_path, "GroupConvModel"));
+  for (const std::string &path : {header_path, source_path, driver_path, program_path, input_path, output_path}) {
+    std::remove(path.data());
+  }
+}
+
+TEST(test_net, create_layer_status) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeOperator> op = std::make_shared<RuntimeOperator>();
+  op->type = "nn.Unknown";
+  std::shared_ptr<Layer> layer;
+  ASSERT_EQ(LayerRegisterer::CreateLayer(op, layer), ParseParameterAttrStatus::kParameterMissingUnknown);
+  ASSERT_EQ(layer, nullptr);
+
+  // 缺少参数时返回对应的错误码，不会直接退出
+  op->type = "nn.Conv2d";
+  ASSERT_EQ(LayerRegisterer::CreateLayer(op, layer), ParseParameterAttrStatus::kParameterMissingInChannel);
+
+  op->type = "nn.ReLU";
+  ASSERT_EQ(LayerRegisterer::CreateLayer(op, layer), ParseParameterAttrStatus::kParameterAttrParseSuccess);
+  ASSERT_NE(layer, nullptr);
+}
+
+TEST(test_net, dynamic_batch_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_max_batch_size(4);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(graph.max_batch_size(), 4);
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 同一个计算图依次处理不同大小的批次
+  for (const uint32_t batch_size : {3u, 1u, 4u}) {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+      input->Fill(2.);
+      inputs.push_back(input);
+    }
+
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+    ASSERT_EQ(outputs.size(), batch_size);
+    for (const auto &output : outputs) {
+      const auto &output1 = output->data().slice(0);
+      ASSERT_EQ(output1.size(), output2.size());
+      for (uint32_t s = 0; s < output1.size(); ++s) {
+        ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+      }
+    }
+  }
+}
+
+TEST(test_net, micro_batch_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_max_batch_size(4);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 较小的缓存预算让执行序列切分成多段，每段内按照2个样本的微批次执行
+  RuntimeGraph micro_graph("tmp/resnet/resnet18_batch1.param",
+                           "tmp/resnet/resnet18_batch1.pnnx.bin");
+  micro_graph.set_max_batch_size(4);
+  micro_graph.set_micro_batch(2, 4 * 1024 * 1024);
+  ASSERT_EQ(micro_graph.micro_batch_size(), 2);
+  micro_graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 每个样本的输入不同，微批次之间互相覆盖中间张量时结果会不同
+  for (const uint32_t batch_size : {4u, 3u, 1u}) {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs;
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+      input->Fill(1.f + float(i) * 0.5f);
+      inputs.push_back(input);
+    }
+    const std::vector<std::shared_ptr<Tensor<float>>> outputs1 = graph.Forward(inputs, false);
+    const std::vector<std::shared_ptr<Tensor<float>>> outputs2 = micro_graph.Forward(inputs, false);
+    ASSERT_EQ(outputs1.size(), batch_size);
+    ASSERT_EQ(outputs2.size(), batch_size);
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      const arma::fcube &output1 = outputs1.at(i)->data();
+      const arma::fcube &output2 = outputs2.at(i)->data();
+      ASSERT_EQ(output1.size(), output2.size());
+      for (uint32_t s = 0; s < output1.size(); ++s) {
+        ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 1e-5);
+      }
+    }
+  }
+}
+
+TEST(test_net, reshape_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_plan_cache_size(2);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  ASSERT_EQ(graph.cached_plan_num(), 1);
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 输入分辨率变化时重新推导形状，分辨率恢复后复用缓存中的执行计划
+  for (const uint32_t input_size : {224u, 256u, 320u, 224u}) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, input_size, input_size);
+    input->Fill(2.);
+    std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward({input}, false);
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs.front()->size(), 1000);
+    if (input_size == 224) {
+      const auto &output1 = outputs.front()->data().slice(0);
+      ASSERT_EQ(output1.size(), output2.size());
+      for (uint32_t s = 0; s < output1.size(); ++s) {
+        ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+      }
+    }
+  }
+  ASSERT_EQ(graph.cached_plan_num(), 2);
+}
+
+TEST(test_net, forward_resnet18_contexts) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 每个线程使用自己的执行上下文，共享同一个计算图中的Layer和权重
+  const uint32_t thread_num = 4;
+  std::vector<std::shared_ptr<ExecutionContext>> contexts;
+  for (uint32_t i = 0; i < thread_num; ++i) {
+    contexts.push_back(graph.CreateContext());
+  }
+
+  std::vector<float> max_diffs(thread_num, 0.f);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_num; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int repeat = 0; repeat < 3; ++repeat) {
+        std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+        input->Fill(2.);
+        std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(contexts.at(i), {input}, false);
+        const auto &output1 = outputs.front()->data().slice(0);
+        for (uint32_t s = 0; s < output1.size(); ++s) {
+          max_diffs.at(i) = std::max(max_diffs.at(i), std::abs(output1.at(s) - output2.at(s)));
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const float max_diff : max_diffs) {
+    ASSERT_LE(max_diff, 5e-6);
+  }
+}
+
+TEST(test_net, forward_resnet18_bound) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  std::shared_ptr<ExecutionContext> context = graph.CreateContext();
+  std::vector<float> input_data(3 * 224 * 224, 2.f);
+  context->BindInputs(input_data.data(), {1, 3, 224, 224});
+  const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph.Forward(context);
+  const std::vector<uint32_t> output_shape = outputs.front()->shapes();
+  std::shared_ptr<Tensor<float>> bound_output =
+      std::make_shared<Tensor<float>>(output_shape.at(0), output_shape.at(1), output_shape.at(2));
+  context->BindOutputs({bound_output});
+
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    const std::vector<std::shared_ptr<Tensor<float>>> &bound_outputs = graph.Forward(context);
+    // 计算图的输出直接写在绑定的张量中
+    ASSERT_EQ(bound_outputs.size(), 1);
+    ASSERT_EQ(bound_outputs.front(), bound_output);
+    const auto &output1 = bound_output->data().slice(0);
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  // 绑定的输入在两次推理之间原地改写，输入张量没有被计算图修改
+  for (const float value : input_data) {
+    ASSERT_EQ(value, 2.f);
+  }
+}
+
+TEST(test_net, forward_outputs_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", std::vector<std::string>{"pnnx_output_0"});
+  ASSERT_EQ(graph.output_names(), std::vector<std::string>{"pnnx_output_0"});
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    const auto &outputs = graph.ForwardOutputs({input}, {"pnnx_output_0"});
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_EQ(outputs.front().size(), 1);
+    const auto &output1 = outputs.front().front()->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+}
+
+TEST(test_net, forward_outputs_branches) {
+  using namespace kuiper_infer;
+  // pnnx_input_0 -> relu -> pnnx_output_0
+  //              -> sigmoid -> pnnx_output_1
+  const std::string param_path = "two_outputs.pnnx.param";
+  const std::string bin_path = "two_outputs.pnnx.bin";
+  WriteModel(param_path, bin_path,
+             "7767517\n"
+             "5 3\n"
+             "pnnx.Input pnnx_input_0 0 1 0 #0=(1,2,4,4)f32\n"
+             "nn.ReLU relu 1 1 0 1 #0=(1,2,4,4)f32 #1=(1,2,4,4)f32\n"
+             "nn.Sigmoid sigmoid 1 1 0 2 #0=(1,2,4,4)f32 #2=(1,2,4,4)f32\n"
+             "pnnx.Output pnnx_output_0 1 0 1 #1=(1,2,4,4)f32\n"
+             "pnnx.Output pnnx_output_1 1 0 2 #2=(1,2,4,4)f32\n");
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(2, 4, 4);
+  for (uint32_t i = 0; i < input->size(); ++i) {
+    input->index(i) = float(i) - 16.f;
+  }
+  // 只有一个输出的计算图作为参考结果
+  std::vector<arma::fcube> references;
+  for (const std::string output_name : {"pnnx_output_0", "pnnx_output_1"}) {
+    RuntimeGraph reference(param_path, bin_path);
+    reference.Build("pnnx_input_0", output_name);
+    references.push_back(reference.Forward({input}).front()->data());
+  }
+
+  RuntimeGraph graph(param_path, bin_path);
+  std::shared_ptr<RuntimeProfiler> profiler = std::make_shared<RuntimeProfiler>();
+  graph.set_profiler(profiler);
+  graph.Build("pnnx_input_0", std::vector<std::string>{"pnnx_output_0", "pnnx_output_1"});
+  ASSERT_EQ(graph.output_names(), (std::vector<std::string>{"pnnx_output_0", "pnnx_output_1"}));
+
+  // Forward执行所有的输出并返回第一个输出
+  const auto &forward_outputs = graph.Forward({input});
+  ASSERT_EQ(forward_outputs.size(), 1);
+  ASSERT_TRUE(arma::approx_equal(forward_outputs.front()->data(), references.at(0), "absdiff", 1e-6));
+  ASSERT_EQ(profiler->records().size(), 2);
+
+  // 按照请求的顺序返回，每个输出的批次大小就是输入的数量
+  profiler->Clear();
+  const auto &outputs = graph.ForwardOutputs({input}, {"pnnx_output_1", "pnnx_output_0"});
+  ASSERT_EQ(outputs.size(), 2);
+  ASSERT_EQ(outputs.at(0).size(), 1);
+  ASSERT_EQ(outputs.at(1).size(), 1);
+  ASSERT_TRUE(arma::approx_equal(outputs.at(0).front()->data(), references.at(1), "absdiff", 1e-6));
+  ASSERT_TRUE(arma::approx_equal(outputs.at(1).front()->data(), references.at(0), "absdiff", 1e-6));
+  ASSERT_EQ(profiler->records().size(), 2);
+
+  // 只请求一部分输出时，其他输出所在分支上的节点不执行
+  for (const std::string output_name : {"pnnx_output_0", "pnnx_output_1"}) {
+    profiler->Clear();
+    const auto &subset_outputs = graph.ForwardOutputs({input}, {output_name});
+    ASSERT_EQ(subset_outputs.size(), 1);
+    ASSERT_EQ(subset_outputs.front().size(), 1);
+    const bool first = output_name == "pnnx_output_0";
+    ASSERT_TRUE(arma::approx_equal(subset_outputs.front().front()->data(), references.at(first ? 0 : 1),
+                                   "absdiff", 1e-6));
+    const std::vector<OperatorProfile> &records = profiler->records();
+    ASSERT_EQ(records.size(), 1);
+    ASSERT_EQ(records.front().name, first ? "relu" : "sigmoid");
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
+
+TEST(test_net, weight_quantization_linear) {
+  using namespace kuiper_infer;
+  // pnnx_input_0 -> linear1 -> linear2 -> linear3 -> pnnx_output_0
+  const std::string param_path = "three_linears.pnnx.param";
+  const std::string bin_path = "three_linears.pnnx.bin";
+  std::string param = "7767517\n5 4\npnnx.Input pnnx_input_0 0 1 0 #0=(1,64)f32\n";
+  std::map<std::string, std::vector<float>> weights;
+  for (uint32_t i = 1; i <= 3; ++i) {
+    const std::string &name = "linear" + std::to_string(i);
+    const std::string &input = std::to_string(i - 1);
+    const std::string &output = std::to_string(i);
+    param += "nn.Linear " + name + " 1 1 " + input + " " + output
+        + " bias=True in_features=64 out_features=64 @bias=(64)f32 @weight=(64,64)f32 #" + input + "=(1,64)f32 #"
+        + output + "=(1,64)f32\n";
+    arma::fvec weight(64 * 64, arma::fill::randu);
+    arma::fvec bias(64, arma::fill::randu);
+    weight -= 0.5f;
+    bias -= 0.5f;
+    weights.insert({name + ".weight", std::vector<float>(weight.begin(), weight.end())});
+    weights.insert({name + ".bias", std::vector<float>(bias.begin(), bias.end())});
+  }
+  param += "pnnx.Output pnnx_output_0 1 0 3 #3=(1,64)f32\n";
+  WriteModel(param_path, bin_path, param, weights);
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, 64, 1);
+  input->Rand();
+  RuntimeGraph float_graph(param_path, bin_path);
+  float_graph.Build("pnnx_input_0", "pnnx_output_0");
+  const arma::fcube reference = float_graph.Forward({input}).front()->data();
+  size_t float_weight_bytes = 0;
+  for (const auto &op : float_graph.operators()) {
+    float_weight_bytes += op->layer != nullptr ? op->layer->ParamBytes() : 0;
+  }
+
+  // 所有节点默认量化为8位，linear2单独设置为4位，linear3不量化
+  const std::map<std::string, uint32_t> expected_bits{{"linear1", 8}, {"linear2", 4}, {"linear3", 32}};
+  for (const bool lazy_weights : {false, true}) {
+    RuntimeGraph graph(param_path, bin_path);
+    std::shared_ptr<RuntimeMetrics> metrics = std::make_shared<RuntimeMetrics>();
+    graph.set_metrics(metrics, "three_linears");
+    graph.set_lazy_weights(lazy_weights);
+    graph.set_weight_quantization("", 8);
+    graph.set_weight_quantization("linear2", 4, 32);
+    graph.set_weight_quantization("linear3", 0);
+    graph.Build("pnnx_input_0", "pnnx_output_0");
+
+    const int64_t weight_bytes =
+        metrics->Gauge("kuiper_graph_weight_bytes", "", {{"graph", "three_linears"}}).value();
+    if (lazy_weights) {
+      // 延迟创建的Layer在第一次执行时才量化
+      ASSERT_EQ(graph.lazy_layer_num(), 3);
+      ASSERT_EQ(weight_bytes, 0);
+    } else {
+      // 指标中是量化之后的权重字节数
+      ASSERT_GT(weight_bytes, 0);
+      ASSERT_LT(size_t(weight_bytes), float_weight_bytes);
+    }
+    const arma::fcube output = graph.Forward({input}).front()->data();
+    ASSERT_LE(arma::abs(output - reference).max(), 0.2f * arma::abs(reference).max());
+
+    size_t quantized_weight_bytes = 0;
+    for (const auto &op : graph.operators()) {
+      if (op->type != "nn.Linear") {
+        continue;
+      }
+      const Layer *layer = op->layer.get();
+      if (lazy_weights) {
+        const LazyLayer *lazy_layer = dynamic_cast<const LazyLayer *>(layer);
+        ASSERT_NE(lazy_layer, nullptr);
+        ASSERT_TRUE(lazy_layer->materialized());
+        layer = &lazy_layer->layer();
+      }
+      const LinearLayer *linear_layer = dynamic_cast<const LinearLayer *>(layer);
+      ASSERT_NE(linear_layer, nullptr);
+      ASSERT_EQ(linear_layer->weight_bits(), expected_bits.at(op->name)) << op->name;
+      quantized_weight_bytes += linear_layer->ParamBytes();
+    }
+    if (!lazy_weights) {
+      ASSERT_EQ(size_t(weight_bytes), quantized_weight_bytes);
+    }
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
+
+TEST(test_net, forward_resnet18_device) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_device(DeviceType::kDeviceCUDA);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 设备不可用时所有节点都放置在CPU上，卷积、激活函数和池化节点在设备可用时放置到设备上
+  const bool cuda_available = DeviceAvailable(DeviceType::kDeviceCUDA);
+  for (const auto &op : graph.operators()) {
+    if (op->type == "nn.Conv2d" || op->type == "nn.MaxPool2d") {
+      ASSERT_EQ(op->device, cuda_available ? DeviceType::kDeviceCUDA : DeviceType::kDeviceCPU);
+    } else if (op->type == "nn.Linear" || op->type == "torch.flatten") {
+      ASSERT_EQ(op->device, DeviceType::kDeviceCPU);
+    }
+  }
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph.Forward({input});
+    ASSERT_EQ(outputs.size(), 1);
+    // 计算图的输出总是同步回CPU
+    ASSERT_EQ(outputs.front()->device(), DeviceType::kDeviceCPU);
+    const auto &output1 = outputs.front()->data().slice(0);
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 1e-4);
+    }
+  }
+}
+
+TEST(test_net, forward_resnet18_device_contexts) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_device(DeviceType::kDeviceCUDA);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 每个上下文在自己的流上执行，一个上下文的复制和另一个上下文的计算可以重叠
+  const uint32_t thread_num = 2;
+  std::vector<std::shared_ptr<ExecutionContext>> contexts;
+  for (uint32_t i = 0; i < thread_num; ++i) {
+    contexts.push_back(graph.CreateContext());
+  }
+
+  std::vector<float> max_diffs(thread_num, 0.f);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_num; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int repeat = 0; repeat < 3; ++repeat) {
+        std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+        input->Fill(2.);
+        std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(contexts.at(i), {input}, false);
+        const auto &output1 = outputs.front()->data().slice(0);
+        for (uint32_t s = 0; s < output1.size(); ++s) {
+          max_diffs.at(i) = std::max(max_diffs.at(i), std::abs(output1.at(s) - output2.at(s)));
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const float max_diff : max_diffs) {
+    ASSERT_LE(max_diff, 1e-4);
+  }
+
+  // 设备上的中间张量复用和主机上相同的内存规划
+  for (const auto &context : contexts) {
+    const RuntimeMemoryPlanner &memory_planner = context->memory_planner();
+    if (DeviceAvailable(DeviceType::kDeviceCUDA)) {
+      ASSERT_EQ(memory_planner.device_bytes(), memory_planner.planned_bytes());
+    } else {
+      ASSERT_EQ(memory_planner.device_bytes(), 0);
+    }
+  }
+}
+
+TEST(test_net, inference_server_resnet18) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                       "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph->set_max_batch_size(4);
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  const uint32_t request_num = 12;
+  InferenceServer server(graph, 4, 50000, 2);
+  std::vector<std::future<std::shared_ptr<Tensor<float>>>> futures;
+  for (uint32_t i = 0; i < request_num; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+    input->Fill(2.);
+    futures.push_back(server.Submit(input));
+  }
+
+  for (auto &future : futures) {
+    const std::shared_ptr<Tensor<float>> &output = future.get();
+    const auto &output1 = output->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  server.Stop();
+  ASSERT_EQ(server.request_num(), request_num);
+  // 请求在等待时间内一次性提交，会被合并成较少的批次
+  ASSERT_LT(server.batch_num(), request_num);
+}
+
+TEST(test_net, inference_server_replicas) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                       "tmp/resnet/resnet18_batch1.pnnx.bin");
+  // 两个副本各自绑定一半的CPU，CPU不足两个时共用同一个CPU
+  std::vector<uint32_t> cpus;
+  if (std::thread::hardware_concurrency() < 2) {
+    cpus = {0, 0};
+  }
+  graph->set_replicas(2, cpus);
+  ASSERT_EQ(graph->replica_num(), 2);
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  const std::vector<std::shared_ptr<ExecutionContext>> replicas = graph->CreateReplicas();
+  ASSERT_EQ(replicas.size(), 2);
+  for (const auto &replica : replicas) {
+    ASSERT_NE(replica->thread_pool(), nullptr);
+  }
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  const uint32_t request_num = 8;
+  InferenceServer server(graph, 1, 0);
+  std::vector<std::future<std::shared_ptr<Tensor<float>>>> futures;
+  for (uint32_t i = 0; i < request_num; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+    input->Fill(2.);
+    futures.push_back(server.Submit(input));
+  }
+
+  for (auto &future : futures) {
+    const std::shared_ptr<Tensor<float>> &output = future.get();
+    const auto &output1 = output->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  server.Stop();
+  ASSERT_EQ(server.request_num(), request_num);
+  ASSERT_EQ(server.batch_num(), request_num);
+}
+
+TEST(test_net, inference_server_submit_stop) {
+  using namespace kuiper_infer;
+  const std::string param_path = "server_relu.pnnx.param";
+  const std::string bin_path = "server_relu.pnnx.bin";
+  WriteModel(param_path, bin_path,
+             "7767517\n"
+             "3 2\n"
+             "pnnx.Input pnnx_input_0 0 1 0 #0=(1,2,4,4)f32\n"
+             "nn.ReLU relu 1 1 0 1 #0=(1,2,4,4)f32 #1=(1,2,4,4)f32\n"
+             "pnnx.Output pnnx_output_0 1 0 1 #1=(1,2,4,4)f32\n");
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(2, 4, 4);
+  input->Fill(1.f);
+
+  // 提交和停止同时进行，被接受的请求都得到输出，被拒绝的请求立即以空的输出完成，没有请求丢失
+  const uint32_t request_num = 200;
+  for (uint32_t round = 0; round < 20; ++round) {
+    std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>(param_path, bin_path);
+    graph->set_max_batch_size(4);
+    graph->Build("pnnx_input_0", "pnnx_output_0");
+    InferenceServer server(graph, 4, 100, 2);
+
+    std::atomic<uint32_t> accepted_num{0};
+    std::atomic<uint32_t> completed_num{0};
+    std::atomic<uint32_t> rejected_num{0};
+    std::thread submitter([&]() {
+      for (uint32_t i = 0; i < request_num; ++i) {
+        const bool accepted = server.Submit(input, [&](const std::shared_ptr<Tensor<float>> &output) {
+          if (output != nullptr) {
+            completed_num += 1;
+          } else {
+            rejected_num += 1;
+          }
+        });
+        accepted_num += accepted ? 1 : 0;
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::microseconds(round * 50));
+    server.Stop();
+    submitter.join();
+    ASSERT_EQ(completed_num + rejected_num, request_num);
+    ASSERT_EQ(completed_num, accepted_num);
+    ASSERT_EQ(server.request_num(), accepted_num);
+  }
+  std::remove(param_path.c_str());
+  std::remove(bin_path.c_str());
+}
+
+TEST(test_net, inference_server_swap_graph) {
+  using namespace kuiper_infer;
+  const auto &create_graph = []() {
+    std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                         "tmp/resnet/resnet18_batch1.pnnx.bin");
+    graph->set_max_batch_size(4);
+    return graph;
+  };
+  std::shared_ptr<RuntimeGraph> graph = create_graph();
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+  std::weak_ptr<RuntimeGraph> old_graph = graph;
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  InferenceServer server(std::move(graph), 4, 1000, 2);
+  ASSERT_EQ(server.graph_version(), 0);
+
+  // 替换期间持续提交请求，所有请求都由旧版本或者新版本完成
+  std::future<bool> swapped = server.SwapGraph(create_graph(), "pnnx_input_0", "pnnx_output_0", input);
+  std::vector<std::future<std::shared_ptr<Tensor<float>>>> futures;
+  while (swapped.wait_for(std::chrono::milliseconds(5)) != std::future_status::ready) {
+    futures.push_back(server.Submit(input));
+  }
+  ASSERT_TRUE(swapped.get());
+  ASSERT_EQ(server.graph_version(), 1);
+  for (uint32_t i = 0; i < 4; ++i) {
+    futures.push_back(server.Submit(input));
+  }
+  for (auto &future : futures) {
+    const std::shared_ptr<Tensor<float>> &output = future.get();
+    const auto &output1 = output->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  // 第二次替换复用同一个后台线程
+  std::weak_ptr<RuntimeGraph> second_graph = server.graph();
+  ASSERT_TRUE(server.SwapGraph(create_graph(), "pnnx_input_0", "pnnx_output_0").get());
+  ASSERT_EQ(server.graph_version(), 2);
+  server.Stop();
+  // 最后一个使用旧版本的批次完成之后旧的计算图被释放
+  ASSERT_TRUE(old_graph.expired());
+  ASSERT_TRUE(second_graph.expired());
+  ASSERT_EQ(server.request_num(), futures.size());
+  // 停止之后的替换被拒绝
+  ASSERT_FALSE(server.SwapGraph(create_graph(), "pnnx_input_0", "pnnx_output_0").get());
+}
+
+TEST(test_net, profile_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  std::shared_ptr<RuntimeProfiler> profiler = std::make_shared<RuntimeProfiler>();
+  // 没有perf_event权限的环境中硬件计数器保持关闭
+  const bool hardware_counters = profiler->set_hardware_counters(true);
+  graph.set_profiler(profiler);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  graph.Forward({input}, false);
+
+  // 输入和输出节点不执行Layer，不会被记录
+  const std::vector<OperatorProfile> &records = profiler->records();
+  ASSERT_EQ(records.size(), graph.operators().size() - 2);
+  uint64_t conv_flops = 0;
+  for (const OperatorProfile &record : records) {
+    ASSERT_LE(record.start_us, record.end_us);
+    ASSERT_EQ(record.output_shape.at(0), 1);
+    ASSERT_FALSE(record.input_shapes.empty());
+    if (record.type == "nn.Conv2d") {
+      ASSERT_GT(record.bytes, 0);
+      conv_flops += record.flops;
+    }
+    ASSERT_EQ(record.has_hardware_counters, hardware_counters);
+    if (hardware_counters) {
+      ASSERT_GT(record.hardware_counters.cycles, 0);
+    }
+  }
+  // resnet18在224x224的输入下大约需要1.8G次乘加
+  ASSERT_GT(conv_flops, 3000000000);
+  ASSERT_LT(conv_flops, 4000000000);
+
+  const std::string trace_path = "tmp/resnet18_trace.json";
+  ASSERT_TRUE(profiler->ExportChromeTrace(trace_path));
+  FILE *trace_file = fopen(trace_path.data(), "rb");
+  ASSERT_NE(trace_file, nullptr);
+  char header[64] = {0};
+  const size_t header_size = fread(header, 1, sizeof(header) - 1, trace_file);
+  fclose(trace_file);
+  ASSERT_EQ(header_size, sizeof(header) - 1);
+  ASSERT_NE(strstr(header, "traceEvents"), nullptr);
+  std::remove(trace_path.data());
+  ASSERT_FALSE(profiler->TopOperators(5).empty());
+}
+
+TEST(test_net, metrics_resnet18) {
+  using namespace kuiper_infer;
+  // 桶的上界和实际值的相对误差不超过桶的宽度
+  for (const uint64_t value : {uint64_t(0), uint64_t(63), uint64_t(64), uint64_t(1000), uint64_t(123456789)}) {
+    const uint64_t upper_bound = LatencyHistogram::BucketUpperBound(LatencyHistogram::BucketIndex(value));
+    ASSERT_GE(upper_bound, value);
+    ASSERT_LE(double(upper_bound - value), double(value) / 32. + 1.);
+  }
+
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                       "tmp/resnet/resnet18_batch1.pnnx.bin");
+  std::shared_ptr<RuntimeMetrics> metrics = std::make_shared<RuntimeMetrics>();
+  graph->set_metrics(metrics, "resnet18");
+  graph->set_max_batch_size(4);
+  // 微批次执行时每个节点分多次执行，节点的耗时每次Forward仍然只记录一次
+  graph->set_micro_batch(1);
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  const uint32_t forward_num = 3;
+  for (uint32_t i = 0; i < forward_num; ++i) {
+    graph->Forward({input, input}, false);
+  }
+  const MetricLabels labels{{"graph", "resnet18"}};
+  ASSERT_EQ(metrics->Counter("kuiper_graph_forward_total", "", labels).value(), forward_num);
+  ASSERT_EQ(metrics->Counter("kuiper_graph_samples_total", "", labels).value(), 2 * forward_num);
+  const HistogramSnapshot &forward_latency =
+      metrics->Histogram("kuiper_graph_forward_duration_seconds", "", labels).Snapshot();
+  ASSERT_EQ(forward_latency.count, forward_num);
+  ASSERT_GT(forward_latency.ValueAtQuantile(0.99), 0);
+  ASSERT_LE(forward_latency.ValueAtQuantile(0.5), forward_latency.max_ns);
+  ASSERT_GT(metrics->Gauge("kuiper_graph_activation_bytes", "", labels).value(), 0);
+
+  uint32_t conv_num = 0;
+  for (const auto &op : graph->operators()) {
+    conv_num += op->type == "nn.Conv2d";
+  }
+  MetricLabels conv_labels = labels;
+  conv_labels["type"] = "nn.Conv2d";
+  ASSERT_EQ(metrics->Histogram("kuiper_operator_duration_seconds", "", conv_labels).Snapshot().count,
+            conv_num * forward_num);
+
+  // 推理服务和计算图共用同一个指标集合
+  InferenceServer server(graph, 4, 1000);
+  std::vector<std::future<std::shared_ptr<Tensor<float>>>> futures;
+  for (uint32_t i = 0; i < 6; ++i) {
+    futures.push_back(server.Submit(input));
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+  server.Stop();
+  ASSERT_EQ(metrics->Counter("kuiper_server_requests_total", "").value(), 6);
+  ASSERT_EQ(metrics->Gauge("kuiper_server_queue_depth", "").value(), 0);
+  ASSERT_EQ(metrics->Histogram("kuiper_server_request_duration_seconds", "").Snapshot().count, 6);
+
+  const std::string &text = metrics->ExportPrometheus();
+  ASSERT_NE(text.find("# TYPE kuiper_graph_forward_duration_seconds histogram"), std::string::npos);
+  ASSERT_NE(text.find("kuiper_graph_forward_total{graph=\"resnet18\"} 3\n"), std::string::npos);
+  ASSERT_NE(text.find("kuiper_operator_duration_seconds_bucket{graph=\"resnet18\",type=\"nn.Conv2d\",le=\"+Inf\"}"),
+            std::string::npos);
+  ASSERT_NE(text.find("kuiper_memory_current_bytes"), std::string::npos);
+}
+
+TEST(test_net, dump_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+
+  const std::vector<std::string> directories = {"tmp/dump_reference", "tmp/dump_same", "tmp/dump_changed"};
+  for (const std::string &directory : directories) {
+    std::filesystem::create_directories(directory);
+    if (directory == directories.back()) {
+      input->Fill(2.5);
+    }
+    std::shared_ptr<ActivationDumper> dumper = std::make_shared<ActivationDumper>(directory);
+    graph.set_activation_dumper(dumper);
+    graph.Forward({input}, false);
+    ASSERT_TRUE(dumper->Flush());
+  }
+  graph.set_activation_dumper(nullptr);
+
+  // 相同的输入逐层完全一致，输入改变之后每一层都有误差
+  const std::vector<ActivationDiff> &same_diffs = ActivationDumper::Compare(directories.at(0), directories.at(1));
+  ASSERT_EQ(same_diffs.size(), graph.operators().size() - 2);
+  for (const ActivationDiff &diff : same_diffs) {
+    ASSERT_TRUE(diff.shape_matched);
+    ASSERT_EQ(diff.records, 1);
+    ASSERT_GT(diff.elements, 0);
+    ASSERT_EQ(diff.max_abs_error, 0.);
+    ASSERT_NEAR(diff.cosine_similarity, 1., 1e-6);
+  }
+  const std::vector<ActivationDiff> &changed_diffs = ActivationDumper::Compare(directories.at(0), directories.at(2));
+  ASSERT_EQ(changed_diffs.size(), same_diffs.size());
+  ASSERT_EQ(changed_diffs.front().name, same_diffs.front().name);
+  ASSERT_GT(changed_diffs.front().max_abs_error, 0.);
+  ASSERT_FALSE(ActivationDumper::CompareReport(changed_diffs).empty());
+
+  for (const std::string &directory : directories) {
+    std::filesystem::remove_all(directory);
+  }
+}
+
+TEST(test_net, shared_params_resnet18) {
+  using namespace kuiper_infer;
+  const std::string shared_params_path = "tmp/resnet18.kparams";
+  std::filesystem::remove(shared_params_path);
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+
+  RuntimeGraph reference("tmp/resnet/resnet18_batch1.param", "tmp/resnet/resnet18_batch1.pnnx.bin");
+  reference.Build("pnnx_input_0", "pnnx_output_0");
+  const std::vector<std::shared_ptr<Tensor<float>>> &expected = reference.Forward({input}, false);
+
+  // 第一个计算图生成参数文件，之后的计算图直接映射同一个文件
+  std::vector<std::shared_ptr<RuntimeGraph>> graphs;
+  for (uint32_t i = 0; i < 2; ++i) {
+    std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                         "tmp/resnet/resnet18_batch1.pnnx.bin");
+    graph->set_shared_params_path(shared_params_path);
+    graph->Build("pnnx_input_0", "pnnx_output_0");
+    const std::shared_ptr<SharedParams> &shared_params = graph->shared_params();
+    ASSERT_NE(shared_params, nullptr);
+    ASSERT_TRUE(shared_params->mapped());
+    ASSERT_GT(shared_params->shared_num(), 0);
+    ASSERT_GT(shared_params->shared_bytes(), 0);
+    ASSERT_EQ(shared_params->missed_num(), 0);
+    graphs.push_back(graph);
+  }
+  for (const auto &graph : graphs) {
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph->Forward({input}, false);
+    ASSERT_EQ(outputs.size(), expected.size());
+    for (uint32_t i = 0; i < outputs.front()->size(); ++i) {
+      ASSERT_EQ(outputs.front()->index(i), expected.front()->index(i));
+    }
+  }
+
+  // 计算图销毁之后，取走的Layer和权重张量仍然引用有效的映射
+  std::shared_ptr<Layer> fc_layer;
+  for (const auto &op : graphs.front()->operators()) {
+    if (op->type == "nn.Linear") {
+      fc_layer = op->layer;
+    }
+  }
+  ASSERT_NE(fc_layer, nullptr);
+  ASSERT_FALSE(fc_layer->weights().empty());
+  const std::shared_ptr<Tensor<float>> fc_weight = fc_layer->weights().front();
+  const std::vector<float> fc_values(fc_weight->RawPtr(), fc_weight->RawPtr() + fc_weight->size());
+  graphs.clear();
+  std::filesystem::remove(shared_params_path);
+  for (uint32_t i = 0; i < fc_values.size(); ++i) {
+    ASSERT_EQ(fc_weight->RawPtr()[i], fc_values.at(i));
+  }
+}
+
+TEST(test_net, lazy_weights_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_lazy_weights(true);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+  // Build之后带有权重的Layer都还没有创建，内存报告中不计入它们的权重
+  ASSERT_GT(graph.lazy_layer_num(), 0);
+  ASSERT_EQ(graph.MemoryReport().weight_bytes, 0);
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  // 第一次执行时创建Layer，第二次执行按照创建之后的Layer重新规划
+  for (uint32_t i = 0; i < 2; ++i) {
+    const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph.Forward({input}, false);
+    ASSERT_EQ(graph.lazy_layer_num(), 0);
+    ASSERT_EQ(outputs.size(), 1);
+    const auto &output1 = outputs.front()->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  ASSERT_GT(graph.MemoryReport().weight_bytes, 0);
+}
+
+TEST(test_net, warmup_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.set_max_batch_size(2);
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  // 预热Build时的形状和一个更小的输入尺寸，之后两个形状的推理都不再重新规划
+  std::shared_ptr<ExecutionContext> context = graph.CreateContext();
+  ASSERT_EQ(graph.Warmup(context, {{2, 3, 224, 224}, {2, 3, 112, 112}}), 2);
+  ASSERT_EQ(graph.Warmup(context), 2);
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  const std::vector<std::shared_ptr<Tensor<float>>> &outputs = graph.Forward(context, {input}, false);
+  ASSERT_EQ(outputs.size(), 1);
+  const auto &output1 = outputs.front()->data().slice(0);
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  ASSERT_EQ(output1.size(), output2.size());
+  for (uint32_t s = 0; s < output1.size(); ++s) {
+    ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+  }
+}
+
+TEST(test_net, pipeline_resnet18) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/resnet/resnet18_batch1.param",
+                                                                       "tmp/resnet/resnet18_batch1.pnnx.bin");
+  std::shared_ptr<RuntimeMetrics> metrics = std::make_shared<RuntimeMetrics>();
+  graph->set_metrics(metrics, "pipeline");
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  // 分成两个阶段，CPU不足两个时两个阶段共用同一个CPU
+  std::vector<std::vector<uint32_t>> core_groups;
+  if (std::thread::hardware_concurrency() >= 2) {
+    core_groups = RuntimePipeline::SplitCores(2);
+  } else {
+    core_groups = {{0}, {0}};
+  }
+  RuntimePipeline pipeline(graph, core_groups);
+  ASSERT_EQ(pipeline.stage_num(), 2);
+  const std::vector<uint32_t> &bounds = pipeline.stage_bounds();
+  ASSERT_EQ(bounds.size(), 3);
+  ASSERT_LT(bounds.at(0), bounds.at(1));
+  ASSERT_LT(bounds.at(1), bounds.at(2));
+
+  const uint32_t request_num = 6;
+  std::vector<std::future<std::vector<std::shared_ptr<Tensor<float>>>>> futures;
+  for (uint32_t i = 0; i < request_num; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+    input->Fill(2.);
+    futures.push_back(pipeline.Submit({input}));
+  }
+
+  const auto &output2 = CSVDataLoader::LoadData("tmp/resnet/23.csv");
+  for (auto &future : futures) {
+    const std::vector<std::shared_ptr<Tensor<float>>> outputs = future.get();
+    ASSERT_EQ(outputs.size(), 1);
+    const auto &output1 = outputs.front()->data().slice(0);
+    ASSERT_EQ(output1.size(), output2.size());
+    for (uint32_t s = 0; s < output1.size(); ++s) {
+      ASSERT_LE(std::abs(output1.at(s) - output2.at(s)), 5e-6);
+    }
+  }
+  pipeline.Stop();
+  ASSERT_EQ(pipeline.request_num(), request_num);
+
+  // 流水线执行的请求同样记录在计算图的指标中
+  const MetricLabels labels{{"graph", "pipeline"}};
+  ASSERT_EQ(metrics->Counter("kuiper_graph_forward_total", "", labels).value(), request_num);
+  ASSERT_EQ(metrics->Histogram("kuiper_graph_forward_duration_seconds", "", labels).Snapshot().count, request_num);
+  uint32_t conv_num = 0;
+  for (const auto &op : graph->operators()) {
+    conv_num += op->type == "nn.Conv2d";
+  }
+  MetricLabels conv_labels = labels;
+  conv_labels["type"] = "nn.Conv2d";
+  ASSERT_EQ(metrics->Histogram("kuiper_operator_duration_seconds", "", conv_labels).Snapshot().count,
+            conv_num * request_num);
+}
+
+TEST(test_net, memory_report_resnet18) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/resnet/resnet18_batch1.param",
+                     "tmp/resnet/resnet18_batch1.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 224, 224);
+  input->Fill(2.);
+  graph.Forward({input}, false);
+
+  const RuntimeMemoryReport &report = graph.MemoryReport();
+  ASSERT_EQ(report.operators.size(), graph.operators().size() - 2);
+  ASSERT_EQ(report.activation_bytes, graph.memory_planner().planned_bytes());
+  ASSERT_EQ(report.scratch_bytes, graph.memory_planner().workspace_bytes());
+  size_t activation_bytes = 0;
+  for (const OperatorMemory &op_memory : report.operators) {
+    activation_bytes += op_memory.activation_bytes;
+  }
+  // 中间张量复用内存之后小于每个节点单独分配的总和
+  ASSERT_LT(report.activation_bytes, activation_bytes);
+  // resnet18大约有1170万个参数
+  ASSERT_GT(report.weight_bytes, 11000000 * sizeof(float));
+  ASSERT_LT(report.weight_bytes, 12500000 * sizeof(float));
+  ASSERT_GE(report.peak_bytes, report.current_bytes);
+  ASSERT_GE(report.current_bytes, report.weight_bytes + report.activation_bytes);
+  ASSERT_FALSE(report.ToString().empty());
+}
+
+TEST(test_net, memory_plan_cat_alias) {
+  using namespace kuiper_infer;
+  // input -> relu1 -> cat -> relu3
+  //       -> relu2 ---^
+  //       -----------^
+  // 规划只需要知道节点是否有Layer，不会调用Forward
+  const std::shared_ptr<Layer> layer = std::make_shared<Layer>("test");
+  const auto input_op = MakeOperator("input", "pnnx.Input", nullptr);
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU", layer);
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU", layer);
+  const auto cat = MakeOperator("cat", "torch.cat", layer);
+  const auto relu3 = MakeOperator("relu3", "nn.ReLU", layer);
+  RuntimeParameterInt *dim = new RuntimeParameterInt;
+  dim->value = 1;
+  cat->params.insert({"dim", dim});
+  ConnectOperator(input_op, relu1);
+  ConnectOperator(input_op, relu2);
+  ConnectOperator(relu1, cat);
+  ConnectOperator(relu2, cat);
+  ConnectOperator(input_op, cat);
+  ConnectOperator(cat, relu3);
+
+  const std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, relu1, relu2, cat, relu3};
+  const std::vector<std::vector<int32_t>> output_shapes{{2, 3, 5, 4}, {2, 3, 5, 4}, {2, 2, 5, 4},
+                                                        {2, 8, 5, 4}, {2, 8, 5, 4}};
+  for (const bool dependency_aware : {false, true}) {
+    RuntimeMemoryPlanner memory_planner;
+    memory_planner.Plan(operators, output_shapes, dependency_aware);
+    const auto &cat_tensors = memory_planner.tensors(3);
+    ASSERT_EQ(cat_tensors.size(), 2);
+    for (uint32_t i = 0; i < 2; ++i) {
+      // 只被拼接节点读取的来源节点直接写在拼接输出中，计算图的输入仍然需要复制
+      ASSERT_EQ(memory_planner.tensors(1).at(i)->data().memptr(), cat_tensors.at(i)->at(0).memptr());
+      ASSERT_EQ(memory_planner.tensors(2).at(i)->data().memptr(), cat_tensors.at(i)->at(3).memptr());
+      ASSERT_EQ(memory_planner.tensors(2).at(i)->channels(), 2);
+    }
+    // 拼接的输出被relu3读取，relu3的输出不能复用拼接所在的内存块
+    ASSERT_NE(memory_planner.tensors(4).front()->data().memptr(), cat_tensors.front()->data().memptr());
+  }
+}
+
+TEST(test_net, memory_plan_share_input) {
+  using namespace kuiper_infer;
+  // input -> relu1 -> flatten -> linear -> relu2
+  const std::shared_ptr<Layer> layer = std::make_shared<Layer>("test");
+  const auto input_op = MakeOperator("input", "pnnx.Input", nullptr);
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU", layer);
+  const auto flatten = MakeOperator("flatten", "torch.flatten", std::make_shared<FlattenLayer>(1, -1));
+  const auto linear = MakeOperator("linear", "nn.Linear", layer);
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU", layer);
+  ConnectOperator(input_op, relu1);
+  ConnectOperator(relu1, flatten);
+  ConnectOperator(flatten, linear);
+  ConnectOperator(linear, relu2);
+
+  const std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, relu1, flatten, linear, relu2};
+  const std::vector<std::vector<int32_t>> output_shapes{{2, 3, 5, 4}, {2, 3, 5, 4}, {2, 60},
+                                                        {2, 60}, {2, 60}};
+  for (const bool dependency_aware : {false, true}) {
+    RuntimeMemoryPlanner memory_planner;
+    memory_planner.Plan(operators, output_shapes, dependency_aware);
+    // flatten的输出建立在relu1的输出上，不分配内存
+    ASSERT_EQ(memory_planner.tensors(2).size(), 2);
+    ASSERT_EQ(memory_planner.tensors(2).front(), nullptr);
+    // linear读取的是relu1的内存，linear的输出不能复用relu1所在的内存块
+    ASSERT_NE(memory_planner.tensors(3).front()->data().memptr(), memory_planner.tensors(1).front()->data().memptr());
+    ASSERT_EQ(memory_planner.slot_count(), 2);
+  }
+}
+
+TEST(test_net, memory_plan_in_place) {
+  using namespace kuiper_infer;
+  // input -> linear1 -> relu1 -> linear2 -> relu2 -> output
+  //                                     -> linear3 -> output
+  const std::shared_ptr<Layer> layer = std::make_shared<Layer>("test");
+  const std::shared_ptr<Layer> relu_layer = std::make_shared<ReluLayer>();
+  const auto input_op = MakeOperator("input", "pnnx.Input", nullptr);
+  const auto linear1 = MakeOperator("linear1", "nn.Linear", layer);
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU", relu_layer);
+  const auto linear2 = MakeOperator("linear2", "nn.Linear", layer);
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU", relu_layer);
+  const auto linear3 = MakeOperator("linear3", "nn.Linear", layer);
+  ConnectOperator(input_op, linear1);
+  ConnectOperator(linear1, relu1);
+  ConnectOperator(relu1, linear2);
+  ConnectOperator(linear2, relu2);
+  ConnectOperator(linear2, linear3);
+
+  const std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, linear1, relu1, linear2, relu2, linear3};
+  const std::vector<std::vector<int32_t>> output_shapes{{2, 30}, {2, 60}, {2, 60}, {2, 60}, {2, 60}, {2, 60}};
+  for (const bool dependency_aware : {false, true}) {
+    RuntimeMemoryPlanner memory_planner;
+    memory_planner.Plan(operators, output_shapes, dependency_aware);
+    // linear1的输出只被relu1读取，relu1直接改写linear1的输出
+    for (uint32_t i = 0; i < 2; ++i) {
+      ASSERT_EQ(memory_planner.tensors(2).at(i)->data().memptr(), memory_planner.tensors(1).at(i)->data().memptr());
+    }
+    // relu1的输出被linear2读取，linear2的输出不能复用relu1所在的内存块
+    ASSERT_NE(memory_planner.tensors(3).front()->data().memptr(), memory_planner.tensors(2).front()->data().memptr());
+    // linear2的输出还被linear3读取，relu2不能原地计算
+    ASSERT_NE(memory_planner.tensors(4).front()->data().memptr(), memory_planner.tensors(3).front()->data().memptr());
+  }
+}
+
+TEST(test_net, graph_pass_dead_node_identity) {
+  using namespace kuiper_infer;
+  // input -> relu1 -> dropout -> flatten -> view -> output
+  //       -> relu2 -> output2
+  const auto input_op = MakeOperator("input", "pnnx.Input");
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU");
+  const auto dropout = MakeOperator("dropout", "nn.Dropout");
+  const auto flatten = MakeOperator("flatten", "torch.flatten");
+  const auto view = MakeOperator("view", "Tensor.view");
+  const auto output_op = MakeOperator("output", "pnnx.Output");
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU");
+  const auto output_op2 = MakeOperator("output2", "pnnx.Output");
+  ConnectOperator(input_op, relu1, {1, 3, 4, 4});
+  ConnectOperator(relu1, dropout, {1, 3, 4, 4});
+  ConnectOperator(dropout, flatten, {1, 3, 4, 4});
+  ConnectOperator(flatten, view, {1, 48});
+  ConnectOperator(view, output_op, {1, 4, 12});
+  ConnectOperator(input_op, relu2, {1, 3, 4, 4});
+  ConnectOperator(relu2, output_op2, {1, 3, 4, 4});
+
+  std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, relu1, dropout, flatten, view, output_op,
+                                                          relu2, output_op2};
+  const GraphPassContext context{"input", {"output"}};
+  DeadNodeEliminationPass dead_node_pass;
+  ASSERT_EQ(dead_node_pass.Run(operators, context), 2);
+  ASSERT_EQ(operators.size(), 6);
+  ASSERT_EQ(input_op->output_operators.size(), 1);
+  ASSERT_EQ(input_op->output_names, std::vector<std::string>{"relu1"});
+
+  // dropout什么都不做，flatten之后的view按照元素数量重新确定形状
+  IdentityEliminationPass identity_pass;
+  ASSERT_EQ(identity_pass.Run(operators, context), 2);
+  ASSERT_EQ(operators.size(), 4);
+  ASSERT_EQ(relu1->output_operators.size(), 1);
+  ASSERT_EQ(relu1->output_operators.begin()->second, view);
+  ASSERT_EQ(relu1->output_names, std::vector<std::string>{"view"});
+  ASSERT_EQ(view->input_operands.size(), 1);
+  const auto &view_input = view->input_operands.find("relu1");
+  ASSERT_NE(view_input, view->input_operands.end());
+  ASSERT_EQ(view_input->second, view->input_operands_seq.front());
+  ASSERT_EQ(view_input->second->shapes, (std::vector<int32_t>{1, 3, 4, 4}));
+  ASSERT_EQ(identity_pass.Run(operators, context), 0);
+}
+
+TEST(test_net, graph_pass_dead_node_outputs) {
+  using namespace kuiper_infer;
+  // input -> relu1 -> relu2 -> output
+  //                -> relu3 -> output2
+  //       -> relu4
+  const auto input_op = MakeOperator("input", "pnnx.Input");
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU");
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU");
+  const auto relu3 = MakeOperator("relu3", "nn.ReLU");
+  const auto relu4 = MakeOperator("relu4", "nn.ReLU");
+  const auto output_op = MakeOperator("output", "pnnx.Output");
+  const auto output_op2 = MakeOperator("output2", "pnnx.Output");
+  ConnectOperator(input_op, relu1, {1, 3, 4, 4});
+  ConnectOperator(relu1, relu2, {1, 3, 4, 4});
+  ConnectOperator(relu2, output_op, {1, 3, 4, 4});
+  ConnectOperator(relu1, relu3, {1, 3, 4, 4});
+  ConnectOperator(relu3, output_op2, {1, 3, 4, 4});
+  ConnectOperator(input_op, relu4, {1, 3, 4, 4});
+
+  // 两个输出的祖先节点都保留，只有不影响任何输出的relu4被删除
+  std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, relu1, relu2, relu3, relu4, output_op,
+                                                          output_op2};
+  const GraphPassContext context{"input", {"output", "output2"}};
+  ASSERT_TRUE(context.IsOutput("output2"));
+  ASSERT_FALSE(context.IsOutput("relu3"));
+  DeadNodeEliminationPass dead_node_pass;
+  ASSERT_EQ(dead_node_pass.Run(operators, context), 1);
+  ASSERT_EQ(operators.size(), 6);
+  ASSERT_EQ(input_op->output_names, std::vector<std::string>{"relu1"});
+  ASSERT_EQ(relu1->output_operators.size(), 2);
+  ASSERT_EQ(dead_node_pass.Run(operators, context), 0);
+
+  // 只需要第一个输出时第二个输出所在的分支也被删除
+  ASSERT_EQ(dead_node_pass.Run(operators, {"input", {"output"}}), 2);
+  ASSERT_EQ(operators.size(), 4);
+  ASSERT_EQ(relu1->output_names, std::vector<std::string>{"relu2"});
+}
+
+TEST(test_net, graph_pass_constant_folding) {
+  using namespace kuiper_infer;
+  // constant -> relu -> cat -> output
+  // input ------------^
+  const auto input_op = MakeOperator("input", "pnnx.Input");
+  const auto constant = MakeOperator("constant", "pnnx.Attribute");
+  const auto relu = MakeOperator("relu", "nn.ReLU");
+  const auto cat = MakeOperator("cat", "torch.cat");
+  const auto output_op = MakeOperator("output", "pnnx.Output");
+  const std::vector<float> values{-1.f, 2.f, -3.f, 4.f, 5.f, -6.f, 7.f, -8.f};
+  std::shared_ptr<RuntimeAttribute> attr = std::make_shared<RuntimeAttribute>();
+  attr->type = RuntimeDataType::kTypeFloat32;
+  attr->shape = {1, 2, 2, 2};
+  attr->weight_data.resize(values.size() * sizeof(float));
+  memcpy(attr->weight_data.data(), values.data(), attr->weight_data.size());
+  constant->attribute.insert({"data", attr});
+  ConnectOperator(constant, relu, {1, 2, 2, 2});
+  ConnectOperator(relu, cat, {1, 2, 2, 2});
+  ConnectOperator(input_op, cat, {1, 2, 2, 2});
+  ConnectOperator(cat, output_op, {1, 4, 2, 2});
+
+  std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, constant, relu, cat, output_op};
+  ConstantFoldingPass folding_pass;
+  ASSERT_EQ(folding_pass.Run(operators, {"input", {"output"}}), 1);
+  // relu在构建时计算，原来的常量不再被读取
+  ASSERT_EQ(operators.size(), 4);
+  ASSERT_EQ(relu->type, "pnnx.Attribute");
+  ASSERT_TRUE(relu->input_operands.empty());
+  ASSERT_EQ(cat->type, "torch.cat");
+  const auto &folded = relu->attribute.find("data");
+  ASSERT_NE(folded, relu->attribute.end());
+  ASSERT_EQ(folded->second->shape, (std::vector<int>{1, 2, 2, 2}));
+  const std::vector<float> &folded_values = folded->second->get<float>();
+  ASSERT_EQ(folded_values.size(), values.size());
+  for (uint32_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(folded_values.at(i), std::max(values.at(i), 0.f));
+  }
+
+  GraphPassManager pass_manager = GraphPassManager::Default();
+  ASSERT_EQ(pass_manager.passes().size(), 8);
+  ASSERT_TRUE(pass_manager.RemovePass("constant_folding"));
+  ASSERT_FALSE(pass_manager.RemovePass("constant_folding"));
+  ASSERT_EQ(pass_manager.passes().size(), 7);
+}
+
+TEST(test_net, graph_pass_residual_add) {
+  using namespace kuiper_infer;
+  // input -> relu1 -> conv1 -> conv2 -> add -> relu2 -> output
+  //                ------------------^
+  const auto input_op = MakeOperator("input", "pnnx.Input");
+  const auto relu1 = MakeOperator("relu1", "nn.ReLU");
+  const auto conv1 = MakeOperator("conv1", "nn.Conv2d");
+  const auto conv2 = MakeOperator("conv2", "nn.Conv2d");
+  const auto add = MakeOperator("add", "pnnx.Expression");
+  RuntimeParameterString *expr = new RuntimeParameterString;
+  expr->value = "add(@0,@1)";
+  add->params.insert({"expr", expr});
+  const auto relu2 = MakeOperator("relu2", "nn.ReLU");
+  const auto output_op = MakeOperator("output", "pnnx.Output");
+  ConnectOperator(input_op, relu1, {1, 4, 6, 6});
+  ConnectOperator(relu1, conv1, {1, 4, 6, 6});
+  ConnectOperator(conv1, conv2, {1, 4, 6, 6});
+  ConnectOperator(conv2, add, {1, 4, 6, 6});
+  ConnectOperator(relu1, add, {1, 4, 6, 6});
+  ConnectOperator(add, relu2, {1, 4, 6, 6});
+  ConnectOperator(relu2, output_op, {1, 4, 6, 6});
+
+  std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, relu1, conv1, conv2, add, relu2, output_op};
+  ResidualAddFusionPass fusion_pass;
+  ASSERT_EQ(fusion_pass.Run(operators, {"input", {"output"}}), 1);
+  ASSERT_EQ(operators.size(), 5);
+  // conv2读取conv1的输出和残差，加法之后的relu合并为conv2的激活函数
+  ASSERT_EQ(conv2->input_operands_seq.size(), 2);
+  ASSERT_EQ(conv2->input_operands_seq.at(0)->name, "conv1");
+  ASSERT_EQ(conv2->input_operands_seq.at(1)->name, "relu1");
+  ASSERT_NE(conv2->input_operands.find("relu1"), conv2->input_operands.end());
+  const auto &residual = conv2->params.find("residual");
+  ASSERT_NE(residual, conv2->params.end());
+  ASSERT_TRUE(dynamic_cast<RuntimeParameterBool *>(residual->second)->value);
+  const auto &activation = conv2->params.find("activation");
+  ASSERT_NE(activation, conv2->params.end());
+  ASSERT_EQ(dynamic_cast<RuntimeParameterString *>(activation->second)->value, "nn.ReLU");
+  ASSERT_EQ(relu1->output_operators.size(), 2);
+  ASSERT_NE(relu1->output_operators.find("conv2"), relu1->output_operators.end());
+  ASSERT_EQ(relu1->output_operators.find("add"), relu1->output_operators.end());
+  ASSERT_EQ(conv2->output_operators.size(), 1);
+  ASSERT_EQ(conv2->output_operators.begin()->second, output_op);
+  ASSERT_NE(output_op->input_operands.find("conv2"), output_op->input_operands.end());
+  ASSERT_EQ(fusion_pass.Run(operators, {"input", {"output"}}), 0);
+}
+
+TEST(test_net, graph_pass_squeeze_excitation) {
+  using namespace kuiper_infer;
+  // input -> conv -> pool -> squeeze -> relu -> excite -> sigmoid -> mul -> output
+  //                -------------------------------------------------^
+  auto int_array = [](const std::vector<int> &value) {
+    RuntimeParameterIntArray *param = new RuntimeParameterIntArray;
+    param->value = value;
+    return param;
+  };
+  auto make_pointwise_conv = [&](const std::string &name, int32_t in_channels, int32_t out_channels, float value) {
+    const auto op = MakeOperator(name, "nn.Conv2d");
+    op->params.insert({"kernel_size", int_array({1, 1})});
+    op->params.insert({"stride", int_array({1, 1})});
+    op->params.insert({"padding", int_array({0, 0})});
+    RuntimeParameterBool *bias = new RuntimeParameterBool;
+    bias->value = false;
+    op->params.insert({"bias", bias});
+    const std::vector<float> values(out_channels * in_channels, value);
+    std::shared_ptr<RuntimeAttribute> attr = std::make_shared<RuntimeAttribute>();
+    attr->type = RuntimeDataType::kTypeFloat32;
+    attr->shape = {out_channels, in_channels, 1, 1};
+    attr->weight_data.resize(values.size() * sizeof(float));
+    memcpy(attr->weight_data.data(), values.data(), attr->weight_data.size());
+    op->attribute.insert({"weight", attr});
+    return op;
+  };
+  const auto input_op = MakeOperator("input", "pnnx.Input");
+  const auto conv = MakeOperator("conv", "nn.Conv2d");
+  const auto pool = MakeOperator("pool", "nn.AdaptiveAvgPool2d");
+  pool->params.insert({"output_size", int_array({1, 1})});
+  const auto squeeze = make_pointwise_conv("squeeze", 8, 2, 0.5f);
+  const auto relu = MakeOperator("relu", "nn.ReLU");
+  const auto excite = make_pointwise_conv("excite", 2, 8, 0.25f);
+  const auto sigmoid = MakeOperator("sigmoid", "nn.Sigmoid");
+  const auto mul = MakeOperator("mul", "pnnx.Expression");
+  RuntimeParameterString *expr = new RuntimeParameterString;
+  expr->value = "mul(@0,@1)";
+  mul->params.insert({"expr", expr});
+  const auto output_op = MakeOperator("output", "pnnx.Output");
+  ConnectOperator(input_op, conv, {1, 3, 4, 4});
+  ConnectOperator(conv, pool, {1, 8, 4, 4});
+  ConnectOperator(pool, squeeze, {1, 8, 1, 1});
+  ConnectOperator(squeeze, relu, {1, 2, 1, 1});
+  ConnectOperator(relu, excite, {1, 2, 1, 1});
+  ConnectOperator(excite, sigmoid, {1, 8, 1, 1});
+  ConnectOperator(conv, mul, {1, 8, 4, 4});
+  ConnectOperator(sigmoid, mul, {1, 8, 1, 1});
+  ConnectOperator(mul, output_op, {1, 8, 4, 4});
+
+  std::vector<std::shared_ptr<RuntimeOperator>> operators{input_op, conv, pool, squeeze, relu, excite, sigmoid,
+                                                          mul, output_op};
+  SqueezeExcitationFusionPass fusion_pass;
+  ASSERT_EQ(fusion_pass.Run(operators, {"input", {"output"}}), 1);
+  ASSERT_EQ(operators.size(), 4);
+  ASSERT_EQ(mul->type, "kuiper.SqueezeExcitation");
+  ASSERT_EQ(mul->input_operands.size(), 1);
+  ASSERT_EQ(mul->input_operands_seq.size(), 1);
+  ASSERT_EQ(mul->input_operands_seq.front()->name, "conv");
+  ASSERT_EQ(conv->output_operators.size(), 1);
+  ASSERT_EQ(conv->output_operators.begin()->second, mul);
+
+  const auto &squeeze_activation = mul->params.find("squeeze_activation");
+  ASSERT_NE(squeeze_activation, mul->params.end());
+  ASSERT_EQ(dynamic_cast<RuntimeParameterString *>(squeeze_activation->second)->value, "nn.ReLU");
+  const auto &excite_activation = mul->params.find("excite_activation");
+  ASSERT_NE(excite_activation, mul->params.end());
+  ASSERT_EQ(dynamic_cast<RuntimeParameterString *>(excite_activation->second)->value, "nn.Sigmoid");
+  const auto &squeeze_weight = mul->attribute.find("squeeze_weight");
+  ASSERT_NE(squeeze_weight, mul->attribute.end());
+  ASSERT_EQ(squeeze_weight->second->shape, (std::vector<int>{2, 8}));
+  const auto &excite_bias = mul->attribute.find("excite_bias");
+  ASSERT_NE(excite_bias, mul->attribute.end());
+  for (const float value : excite_bias->second->get<float>()) {
+    ASSERT_EQ(value, 0.f);
+  }
+  ASSERT_EQ(fusion_pass.Run(operators, {"input", {"output"}}), 0);
+}
@@ -7,6 +7,7 @@
 
 #include "data/tensor.hpp"
 #include "../source/layer/details/sigmoid.hpp"
+#include "layer/abstract/activation.hpp"
 
 TEST(test_layer, forward_sigmoid1) {
   using namespace kuiper_infer;
@@ -71,7 +72,9 @@ TEST(test_layer, forward_sigmoid3) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), 1.f / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = 1.f / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
 }
@@ -93,7 +96,9 @@ TEST(test_layer, forward_sigmoid4) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), 1.f / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = 1.f / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
 }
@@ -115,7 +120,29 @@ TEST(test_layer, forward_sigmoid5) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), 1.f / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = 1.f / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
-}
\ No newline at end of file
+}
+TEST(test_layer, sigmoid_fast_exp_error) {
+  using namespace kuiper_infer;
+  // 元素数量不是向量宽度的整数倍，同时覆盖向量和标量两部分
+  const uint32_t size = 60001;
+  std::vector<float> sigmoid_data(size);
+  std::vector<float> silu_data(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    sigmoid_data.at(i) = -30.f + float(i) * 0.001f;
+    silu_data.at(i) = sigmoid_data.at(i);
+  }
+  ApplyActivation(ActivationType::kActivationSigmoid, sigmoid_data.data(), size);
+  ApplyActivation(ActivationType::kActivationSiLU, silu_data.data(), size);
+
+  for (uint32_t i = 0; i < size; ++i) {
+    const double x = -30.f + float(i) * 0.001f;
+    const double sigmoid = 1. / (1. + std::exp(-x));
+    ASSERT_LE(std::abs(sigmoid_data.at(i) - sigmoid), 1e-6 * sigmoid);
+    ASSERT_LE(std::abs(silu_data.at(i) - x * sigmoid), 1e-6 * std::abs(x * sigmoid) + 1e-30);
+  }
+}
@@ -25,7 +25,9 @@ TEST(test_layer, forward_silu1) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), input_->index(j) / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = input_->index(j) / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
 }
@@ -47,7 +49,9 @@ TEST(test_layer, forward_silu2) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), input_->index(j) / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = input_->index(j) / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
 }
@@ -69,7 +73,38 @@ TEST(test_layer, forward_silu3) {
     CHECK(input_->size() == output_->size());
     uint32_t size = input_->size();
     for (uint32_t j = 0; j < size; ++j) {
-      ASSERT_EQ(output_->index(j), input_->index(j) / (1 + std::exp(-input_->index(j))));
+      // 向量化的exp是多项式近似，相对误差不超过1e-6
+      const float expected = input_->index(j) / (1 + std::exp(-input_->index(j)));
+      ASSERT_LE(std::abs(output_->index(j) - expected), 1e-6 * std::abs(expected));
     }
   }
-}
\ No newline at end of file
+}
+TEST(test_layer, forward_silu_batch_inplace) {
+  using namespace kuiper_infer;
+  // 样本的大小不是块大小的整数倍，每个样本的最后一个块不完整，原地计算时不能越过样本的末尾
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  std::vector<std::vector<float>> expected_values;
+  for (uint32_t i = 0; i < 3; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(7, 61, 53);
+    input->Rand();
+    std::vector<float> expected(input->size());
+    for (uint32_t j = 0; j < input->size(); ++j) {
+      const float value = input->index(j);
+      expected.at(j) = value / (1 + std::exp(-value));
+    }
+    inputs.push_back(input);
+    expected_values.push_back(std::move(expected));
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = inputs;
+
+  SiLULayer silu_layer;
+  const auto status = silu_layer.Forward(inputs, outputs);
+  ASSERT_EQ(status, InferStatus::kInferSuccess);
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(outputs.at(i), inputs.at(i));
+    for (uint32_t j = 0; j < outputs.at(i)->size(); ++j) {
+      const float expected = expected_values.at(i).at(j);
+      ASSERT_LE(std::abs(outputs.at(i)->index(j) - expected), 1e-6 * std::abs(expected));
+    }
+  }
+}
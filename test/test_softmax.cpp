@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 
 #include "../source/layer/details/softmax.hpp"
 
@@ -142,3 +144,72 @@ TEST(test_layer, forward_softmax5) {
 
 }
 
+
+TEST(test_layer, forward_softmax_dims) {
+  using namespace kuiper_infer;
+  const uint32_t channels = 5;
+  const uint32_t rows = 7;
+  const uint32_t cols = 9;
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(channels, rows, cols);
+  input->Rand();
+  input->Transform([](float value) { return value * 8.f; });
+
+  // dim按照[N, C, H, W]计数，1、2、3分别沿着通道、行和列计算
+  for (int dim = 1; dim <= 3; ++dim) {
+    std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+    std::vector<std::shared_ptr<Tensor<float>>> outputs(1);
+    SoftmaxLayer softmax_layer(dim - 4, 4);
+    const auto status = softmax_layer.Forward(inputs, outputs);
+    ASSERT_EQ(status, InferStatus::kInferSuccess);
+    const std::shared_ptr<Tensor<float>> &output = outputs.front();
+    ASSERT_EQ(output->shapes(), input->shapes());
+
+    for (uint32_t c = 0; c < channels; ++c) {
+      for (uint32_t r = 0; r < rows; ++r) {
+        for (uint32_t w = 0; w < cols; ++w) {
+          const uint32_t length = dim == 1 ? channels : (dim == 2 ? rows : cols);
+          double max = -1e30;
+          for (uint32_t k = 0; k < length; ++k) {
+            const float value = dim == 1 ? input->at(k, r, w) : (dim == 2 ? input->at(c, k, w) : input->at(c, r, k));
+            max = std::max(max, double(value));
+          }
+          double sum = 0.;
+          for (uint32_t k = 0; k < length; ++k) {
+            const float value = dim == 1 ? input->at(k, r, w) : (dim == 2 ? input->at(c, k, w) : input->at(c, r, k));
+            sum += std::exp(double(value) - max);
+          }
+          const double expected = std::exp(double(input->at(c, r, w)) - max) / sum;
+          ASSERT_NEAR(output->at(c, r, w), expected, 1e-6) << "dim " << dim;
+        }
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_softmax_in_place) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 4, 70);
+  input->Rand();
+  std::shared_ptr<Tensor<float>> expected = input->Clone();
+
+  SoftmaxLayer softmax_layer(1, 4);
+  std::vector<std::shared_ptr<Tensor<float>>> expected_outputs(1);
+  std::vector<std::shared_ptr<Tensor<float>>> expected_inputs{expected};
+  ASSERT_EQ(softmax_layer.Forward(expected_inputs, expected_outputs), InferStatus::kInferSuccess);
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs{input};
+  ASSERT_EQ(softmax_layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+  for (uint32_t i = 0; i < input->size(); ++i) {
+    ASSERT_FLOAT_EQ(input->index(i), expected_outputs.front()->index(i));
+  }
+}
+
+TEST(test_layer, forward_softmax_dim_error) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(1, 2, 3);
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(1);
+  SoftmaxLayer softmax_layer(0, 4);
+  ASSERT_EQ(softmax_layer.Forward(inputs, outputs), InferStatus::kInferFailedDimensionParameterError);
+}
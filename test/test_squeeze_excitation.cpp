@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include "data/tensor.hpp"
+#include "../source/layer/details/squeeze_excitation.hpp"
+
+TEST(test_layer, forward_squeeze_excitation) {
+  using namespace kuiper_infer;
+  const uint32_t channels = 24;
+  const uint32_t squeeze_channels = 6;
+  std::vector<float> squeeze_weight(squeeze_channels * channels);
+  std::vector<float> squeeze_bias(squeeze_channels);
+  std::vector<float> excite_weight(channels * squeeze_channels);
+  std::vector<float> excite_bias(channels);
+  for (uint32_t i = 0; i < squeeze_weight.size(); ++i) {
+    squeeze_weight.at(i) = float(int(i % 7) - 3) * 0.1f;
+    excite_weight.at(i) = float(int(i % 5) - 2) * 0.2f;
+  }
+  for (uint32_t s = 0; s < squeeze_channels; ++s) {
+    squeeze_bias.at(s) = float(s) * 0.05f - 0.1f;
+  }
+  for (uint32_t c = 0; c < channels; ++c) {
+    excite_bias.at(c) = float(c % 3) * 0.1f;
+  }
+
+  SqueezeExcitationLayer layer(channels, squeeze_channels, ActivationType::kActivationRelu,
+                               ActivationType::kActivationSigmoid);
+  layer.set_squeeze_params(squeeze_weight, squeeze_bias);
+  layer.set_excite_params(excite_weight, excite_bias);
+
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (uint32_t i = 0; i < 3; ++i) {
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(channels, 7, 9);
+    input->Rand();
+    inputs.push_back(input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(inputs.size());
+  ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+  for (uint32_t i = 0; i < inputs.size(); ++i) {
+    const std::shared_ptr<Tensor<float>> &input = inputs.at(i);
+    const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    ASSERT_EQ(output->shapes(), input->shapes());
+    // 逐步计算池化、两个1x1卷积和通道缩放
+    std::vector<float> pooled(channels);
+    for (uint32_t c = 0; c < channels; ++c) {
+      pooled.at(c) = arma::accu(input->at(c)) / float(input->rows() * input->cols());
+    }
+    std::vector<float> squeezed(squeeze_channels);
+    for (uint32_t s = 0; s < squeeze_channels; ++s) {
+      float sum = squeeze_bias.at(s);
+      for (uint32_t c = 0; c < channels; ++c) {
+        sum += squeeze_weight.at(s * channels + c) * pooled.at(c);
+      }
+      squeezed.at(s) = std::max(sum, 0.f);
+    }
+    for (uint32_t c = 0; c < channels; ++c) {
+      float sum = excite_bias.at(c);
+      for (uint32_t s = 0; s < squeeze_channels; ++s) {
+        sum += excite_weight.at(c * squeeze_channels + s) * squeezed.at(s);
+      }
+      const float scale = 1.f / (1.f + std::exp(-sum));
+      for (uint32_t r = 0; r < input->rows(); ++r) {
+        for (uint32_t col = 0; col < input->cols(); ++col) {
+          ASSERT_NEAR(output->at(c, r, col), input->at(c, r, col) * scale, 1e-5);
+        }
+      }
+    }
+  }
+
+  // 输出就是输入时原地计算
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(*inputs.front());
+  std::vector<std::shared_ptr<Tensor<float>>> in_place{input};
+  ASSERT_EQ(layer.Forward(in_place, in_place), InferStatus::kInferSuccess);
+  for (uint32_t j = 0; j < input->size(); ++j) {
+    ASSERT_NEAR(input->index(j), outputs.front()->index(j), 1e-6);
+  }
+}
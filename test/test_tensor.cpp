@@ -0,0 +1,614 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+#include "data/tensor.hpp"
+#include "data/quantize.hpp"
+#include "data/half.hpp"
+#include "data/gemm.hpp"
+#include "data/image.hpp"
+#include "data/tensor_allocator.hpp"
+#include "runtime/cpu_feature.hpp"
+
+TEST(test_tensor, element_add_output) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> tensor1 = std::make_shared<Tensor<float>>(3, 5, 7);
+  std::shared_ptr<Tensor<float>> tensor2 = std::make_shared<Tensor<float>>(3, 5, 7);
+  tensor1->Rand();
+  tensor2->Rand();
+  std::shared_ptr<Tensor<float>> output = std::make_shared<Tensor<float>>(3, 5, 7);
+  Tensor<float>::ElementAdd(tensor1, tensor2, output);
+  for (uint32_t i = 0; i < output->size(); ++i) {
+    ASSERT_EQ(output->index(i), tensor1->index(i) + tensor2->index(i));
+  }
+
+  // 输出张量是输入张量时原地累加
+  const std::shared_ptr<Tensor<float>> origin = tensor1->Clone();
+  Tensor<float>::ElementAdd(tensor1, tensor2, tensor1);
+  for (uint32_t i = 0; i < tensor1->size(); ++i) {
+    ASSERT_EQ(tensor1->index(i), origin->index(i) + tensor2->index(i));
+  }
+}
+
+TEST(test_tensor, element_multiply_broadcast) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> tensor1 = std::make_shared<Tensor<float>>(4, 6, 3);
+  std::shared_ptr<Tensor<float>> scale = std::make_shared<Tensor<float>>(4, 1, 1);
+  tensor1->Rand();
+  scale->Rand();
+
+  // 每个通道只有一个值的张量可以放在任意一侧
+  const std::shared_ptr<Tensor<float>> output1 = Tensor<float>::ElementMultiply(tensor1, scale);
+  const std::shared_ptr<Tensor<float>> output2 = Tensor<float>::ElementMultiply(scale, tensor1);
+  ASSERT_EQ(output1->shapes(), tensor1->shapes());
+  ASSERT_EQ(output2->shapes(), tensor1->shapes());
+  for (uint32_t c = 0; c < 4; ++c) {
+    for (uint32_t r = 0; r < 6; ++r) {
+      for (uint32_t w = 0; w < 3; ++w) {
+        const float expected = tensor1->at(c, r, w) * scale->index(c);
+        ASSERT_EQ(output1->at(c, r, w), expected);
+        ASSERT_EQ(output2->at(c, r, w), expected);
+      }
+    }
+  }
+
+  const std::shared_ptr<Tensor<float>> origin = tensor1->Clone();
+  Tensor<float>::ElementMultiply(tensor1, scale, tensor1);
+  Tensor<float>::ElementAdd(scale, tensor1, tensor1);
+  for (uint32_t c = 0; c < 4; ++c) {
+    for (uint32_t i = 0; i < 6 * 3; ++i) {
+      ASSERT_EQ(tensor1->at(c).at(i), origin->at(c).at(i) * scale->index(c) + scale->index(c));
+    }
+  }
+}
+
+TEST(test_tensor, memory_tracker) {
+  using namespace kuiper_infer;
+  MemoryTracker &memory_tracker = MemoryTracker::GetInstance();
+  const size_t origin_bytes = memory_tracker.current_bytes();
+  const size_t tensor_bytes = 3 * 32 * 32 * sizeof(float);
+  {
+    Tensor<float> tensor1(3, 32, 32);
+    ASSERT_EQ(memory_tracker.current_bytes(), origin_bytes + tensor_bytes);
+    ASSERT_GE(memory_tracker.peak_bytes(), origin_bytes + tensor_bytes);
+
+    // 拷贝出的张量持有新的内存
+    Tensor<float> tensor2(tensor1);
+    ASSERT_EQ(memory_tracker.current_bytes(), origin_bytes + tensor_bytes * 2);
+
+    // 填充之后按照新的大小统计
+    tensor2.Padding({1, 1, 1, 1}, 0.f);
+    ASSERT_EQ(memory_tracker.current_bytes(), origin_bytes + tensor_bytes + 3 * 34 * 34 * sizeof(float));
+
+    // 建立在外部内存上的张量不计入
+    std::vector<float> external(3 * 32 * 32);
+    Tensor<float> tensor3(external.data(), 3, 32, 32);
+    ASSERT_EQ(memory_tracker.current_bytes(), origin_bytes + tensor_bytes + 3 * 34 * 34 * sizeof(float));
+  }
+  ASSERT_EQ(memory_tracker.current_bytes(), origin_bytes);
+}
+
+TEST(test_tensor, view_share_memory) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> tensor = std::make_shared<Tensor<float>>(4, 6, 1);
+  tensor->Rand();
+
+  // 每个通道只有一列时行优先的顺序就是存储顺序，view不复制数据
+  const auto view = Tensor<float>::View(tensor, {3, 1, 8});
+  ASSERT_TRUE(view->is_view());
+  ASSERT_EQ(view->data().memptr(), tensor->data().memptr());
+  ASSERT_EQ(view->raw_shapes(), std::vector<uint32_t>({3, 1, 8}));
+
+  const std::shared_ptr<Tensor<float>> copied = tensor->Clone();
+  copied->ReRawView({3, 1, 8});
+  ASSERT_EQ(view->shapes(), copied->shapes());
+  for (uint32_t i = 0; i < view->size(); ++i) {
+    ASSERT_EQ(view->index(i), copied->index(i));
+  }
+
+  // 视图持有原始张量，原始张量释放之后视图仍然可以使用
+  const float first = tensor->index(0);
+  const auto reshaped = Tensor<float>::Reshape(view, {24});
+  tensor.reset();
+  ASSERT_EQ(reshaped->index(0), first);
+  ASSERT_EQ(reshaped->raw_shapes(), std::vector<uint32_t>({24}));
+}
+
+TEST(test_tensor, view_copy) {
+  using namespace kuiper_infer;
+  const uint32_t channels = 3;
+  const uint32_t rows = 5;
+  const uint32_t cols = 4;
+  std::shared_ptr<Tensor<float>> tensor = std::make_shared<Tensor<float>>(channels, rows, cols);
+  tensor->Rand();
+
+  // 行列都大于1时需要重新排列，结果和逐个元素按行优先顺序计算的位置一致
+  const std::vector<uint32_t> shapes = {2, 6, 5};
+  ASSERT_FALSE(Tensor<float>::ViewSharesMemory(rows, cols, shapes));
+  const auto view = Tensor<float>::View(tensor, shapes);
+  ASSERT_FALSE(view->is_view());
+  ASSERT_NE(view->data().memptr(), tensor->data().memptr());
+  for (uint32_t c = 0; c < channels; ++c) {
+    for (uint32_t r = 0; r < rows; ++r) {
+      for (uint32_t c_ = 0; c_ < cols; ++c_) {
+        const uint32_t pos_index = c * rows * cols + r * cols + c_;
+        const uint32_t ch = pos_index / (shapes.at(1) * shapes.at(2));
+        const uint32_t row = pos_index % (shapes.at(1) * shapes.at(2)) / shapes.at(2);
+        const uint32_t col = pos_index % shapes.at(2);
+        ASSERT_EQ(view->at(ch, row, col), tensor->at(c, r, c_));
+      }
+    }
+  }
+
+  const std::shared_ptr<Tensor<float>> copied = tensor->Clone();
+  copied->ReRawView(shapes);
+  for (uint32_t i = 0; i < view->size(); ++i) {
+    ASSERT_EQ(view->index(i), copied->index(i));
+  }
+}
+
+TEST(test_tensor, slice_channels) {
+  using namespace kuiper_infer;
+  std::shared_ptr<Tensor<float>> tensor = std::make_shared<Tensor<float>>(5, 3, 4);
+  tensor->Rand();
+
+  const auto slice = Tensor<float>::Slice(tensor, 1, 3);
+  ASSERT_TRUE(slice->is_view());
+  ASSERT_EQ(slice->channels(), 3);
+  ASSERT_EQ(slice->data().memptr(), tensor->at(1).memptr());
+  for (uint32_t c = 0; c < 3; ++c) {
+    ASSERT_TRUE(arma::approx_equal(slice->at(c), tensor->at(c + 1), "absdiff", 0.f));
+  }
+
+  // 写入切片就是写入原始张量
+  slice->at(0, 2, 3) = 42.f;
+  ASSERT_EQ(tensor->at(1, 2, 3), 42.f);
+
+  const auto channel = Tensor<float>::Slice(tensor, 4, 1);
+  ASSERT_EQ(channel->raw_shapes(), std::vector<uint32_t>({3, 4}));
+}
+
+TEST(test_tensor, create_batch) {
+  using namespace kuiper_infer;
+  const auto &tensors = Tensor<float>::CreateBatch(3, 2, 4, 5);
+  ASSERT_EQ(tensors.size(), 3);
+  float *batch_ptr = Tensor<float>::ContiguousBatch(tensors);
+  ASSERT_NE(batch_ptr, nullptr);
+  for (uint32_t i = 0; i < tensors.size(); ++i) {
+    ASSERT_EQ(tensors.at(i)->shapes(), std::vector<uint32_t>({2, 4, 5}));
+    ASSERT_EQ(tensors.at(i)->data().memptr(), batch_ptr + i * 40);
+  }
+
+  // 顺序被打乱或者形状不同时不能作为一个连续的批次
+  std::vector<std::shared_ptr<Tensor<float>>> reordered = {tensors.at(0), tensors.at(2), tensors.at(1)};
+  ASSERT_EQ(Tensor<float>::ContiguousBatch(reordered), nullptr);
+  std::vector<std::shared_ptr<Tensor<float>>> reshaped = {tensors.at(0), Tensor<float>::Reshape(tensors.at(1), {40})};
+  ASSERT_EQ(Tensor<float>::ContiguousBatch(reshaped), nullptr);
+}
+
+TEST(test_tensor, int8_matrix_vector) {
+  using namespace kuiper_infer;
+  // 列数不是向量宽度的整数倍，行数不是一次计算的行数的整数倍
+  const uint32_t rows = 11;
+  const uint32_t cols = 141;
+  arma::fmat matrix(rows, cols);
+  for (uint32_t r = 0; r < rows; ++r) {
+    for (uint32_t c = 0; c < cols; ++c) {
+      matrix.at(r, c) = float(int32_t((r * 31 + c * 17) % 255) - 127) * 0.01f;
+    }
+  }
+  const QuantizedMatrix &quantized = QuantizeRows(matrix);
+  ASSERT_EQ(quantized.rows, rows);
+  ASSERT_EQ(quantized.cols, cols);
+  ASSERT_GE(quantized.stride, cols);
+
+  std::vector<int8_t> vector(quantized.stride, 0);
+  for (uint32_t c = 0; c < cols; ++c) {
+    vector.at(c) = int8_t(int32_t(c * 7 % 255) - 127);
+  }
+  std::vector<int32_t> output(rows);
+  Int8MatrixVector(quantized, vector.data(), 0, rows, output.data());
+  for (uint32_t r = 0; r < rows; ++r) {
+    int32_t expected = 0;
+    for (uint32_t c = 0; c < cols; ++c) {
+      const int8_t value = quantized.data.at(r * quantized.stride + c);
+      ASSERT_LE(std::abs(value), 127);
+      ASSERT_NEAR(float(value) * quantized.scales.at(r), matrix.at(r, c), quantized.scales.at(r));
+      expected += int32_t(value) * int32_t(vector.at(c));
+    }
+    ASSERT_EQ(output.at(r), expected);
+  }
+
+  // 只计算部分行时第一个结果对应起始行
+  std::vector<int32_t> partial_output(rows);
+  Int8MatrixVector(quantized, vector.data(), 3, 10, partial_output.data());
+  for (uint32_t r = 3; r < 10; ++r) {
+    ASSERT_EQ(partial_output.at(r - 3), output.at(r));
+  }
+}
+
+TEST(test_tensor, half_conversion) {
+  using namespace kuiper_infer;
+  ASSERT_EQ(FloatToHalf(1.f), 0x3c00);
+  ASSERT_EQ(FloatToHalf(-2.f), 0xc000);
+  ASSERT_EQ(FloatToHalf(65504.f), 0x7bff);
+  ASSERT_EQ(FloatToHalf(70000.f), 0x7c00);
+  ASSERT_EQ(FloatToHalf(5.9604644775390625e-8f), 0x0001);
+  ASSERT_EQ(HalfToFloat(0x3555), 0.333251953125f);
+  ASSERT_EQ(HalfToFloat(0x0001), 5.9604644775390625e-8f);
+  ASSERT_EQ(FloatToBFloat16(1.f), 0x3f80);
+  ASSERT_EQ(BFloat16ToFloat(0xc0a0), -5.f);
+  // 1 + 2^-8正好在两个bfloat16中间，舍入到偶数
+  ASSERT_EQ(FloatToBFloat16(1.00390625f), 0x3f80);
+
+  // 批量转换的结果和逐个转换相同，元素数量不是向量宽度的整数倍
+  std::vector<float> values;
+  for (int32_t i = -600; i < 600; ++i) {
+    values.push_back(float(i) * 0.37f + float(i % 7) * 1e-5f);
+  }
+  const uint32_t size = values.size() - 3;
+  std::vector<uint16_t> halves(size);
+  std::vector<uint16_t> bfloat16s(size);
+  std::vector<float> widened(size);
+  FloatToHalf(values.data(), size, halves.data());
+  FloatToBFloat16(values.data(), size, bfloat16s.data());
+  for (uint32_t i = 0; i < size; ++i) {
+    ASSERT_EQ(halves.at(i), FloatToHalf(values.at(i)));
+    ASSERT_EQ(bfloat16s.at(i), FloatToBFloat16(values.at(i)));
+  }
+  HalfToFloat(halves.data(), size, widened.data());
+  for (uint32_t i = 0; i < size; ++i) {
+    ASSERT_EQ(widened.at(i), HalfToFloat(halves.at(i)));
+    ASSERT_NEAR(widened.at(i), values.at(i), std::abs(values.at(i)) * 1e-3f);
+  }
+  BFloat16ToFloat(bfloat16s.data(), size, widened.data());
+  for (uint32_t i = 0; i < size; ++i) {
+    ASSERT_EQ(widened.at(i), BFloat16ToFloat(bfloat16s.at(i)));
+    ASSERT_NEAR(widened.at(i), values.at(i), std::abs(values.at(i)) * 4e-3f);
+  }
+}
+
+TEST(test_tensor, gemm_backends) {
+  using namespace kuiper_infer;
+  ASSERT_EQ(CurrentGemmBackend(), CompiledGemmBackend());
+  if (CompiledGemmBackend() != GemmBackend::kMKL) {
+    ASSERT_FALSE(SetGemmBackend(GemmBackend::kMKL));
+  }
+  const GemmBackend backends[] = {CompiledGemmBackend(), GemmBackend::kBuiltin};
+  // 尺寸不是分块和微内核的整数倍，k跨过多个分块
+  const uint32_t m = 37;
+  const uint32_t n = 29;
+  const uint32_t k = 300;
+  for (const GemmBackend backend : backends) {
+    ASSERT_TRUE(SetGemmBackend(backend));
+    for (uint32_t transpose = 0; transpose < 4; ++transpose) {
+      const bool transpose_a = transpose & 1u;
+      const bool transpose_b = transpose & 2u;
+      // 矩阵是更大的矩阵中的一块，ld大于行数
+      arma::fmat a = transpose_a ? arma::fmat(k + 3, m, arma::fill::randu) : arma::fmat(m + 3, k, arma::fill::randu);
+      arma::fmat b = transpose_b ? arma::fmat(n + 5, k, arma::fill::randu) : arma::fmat(k + 5, n, arma::fill::randu);
+      arma::fmat c(m + 2, n, arma::fill::randu);
+      const arma::fmat op_a = transpose_a ? arma::fmat(a.rows(0, k - 1).t()) : arma::fmat(a.rows(0, m - 1));
+      const arma::fmat op_b = transpose_b ? arma::fmat(b.rows(0, n - 1).t()) : arma::fmat(b.rows(0, k - 1));
+      const arma::fmat expected = 0.5f * op_a * op_b + 2.f * c.rows(0, m - 1);
+      Gemm(transpose_a, transpose_b, m, n, k, 0.5f, a.memptr(), a.n_rows, b.memptr(), b.n_rows, 2.f, c.memptr(),
+           c.n_rows);
+      ASSERT_LE(arma::abs(c.rows(0, m - 1) - expected).max(), 1e-3f);
+    }
+    // beta为0时不读取c原有的值
+    arma::fmat a(m, k, arma::fill::randu);
+    arma::fmat b(k, n, arma::fill::randu);
+    arma::fmat c(m, n);
+    c.fill(std::numeric_limits<float>::quiet_NaN());
+    Gemm(false, false, m, n, k, 1.f, a.memptr(), m, b.memptr(), k, 0.f, c.memptr(), m);
+    ASSERT_LE(arma::abs(c - a * b).max(), 1e-3f);
+  }
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+}
+
+TEST(test_tensor, gemm_packed) {
+  using namespace kuiper_infer;
+  const uint32_t m = 70;
+  const uint32_t n = 45;
+  const uint32_t k = 300;
+  arma::fmat a(m, k, arma::fill::randu);
+  arma::fmat b(k, n, arma::fill::randu);
+  a -= 0.5f;
+  std::vector<float> row_bias;
+  std::vector<float> col_bias;
+  for (uint32_t i = 0; i < m; ++i) {
+    row_bias.push_back(float(i % 7) * 0.1f - 0.3f);
+  }
+  for (uint32_t j = 0; j < n; ++j) {
+    col_bias.push_back(float(j % 5) * 0.2f - 0.4f);
+  }
+  arma::fmat expected = a * b;
+  for (uint32_t j = 0; j < n; ++j) {
+    for (uint32_t i = 0; i < m; ++i) {
+      expected.at(i, j) = std::max(expected.at(i, j) + row_bias.at(i) + col_bias.at(j), 0.f);
+    }
+  }
+
+  GemmEpilogue epilogue;
+  epilogue.row_bias = row_bias.data();
+  epilogue.col_bias = col_bias.data();
+  epilogue.activation = ActivationType::kActivationRelu;
+  // 两个操作数分别打包，只计算从面板边界开始的一部分行或列
+  const GemmPackedMatrix packed_a = GemmPackA(false, m, k, a.memptr(), m);
+  const GemmPackedMatrix packed_b = GemmPackB(false, k, n, b.memptr(), k);
+  arma::fmat c(m, n);
+  const uint32_t row_begin = packed_a.panel;
+  GemmPackedA(packed_a, 0, row_begin, false, n, b.memptr(), k, c.memptr(), m, epilogue);
+  GemmEpilogue row_epilogue = epilogue;
+  row_epilogue.row_bias += row_begin;
+  GemmPackedA(packed_a, row_begin, m - row_begin, false, n, b.memptr(), k, c.memptr() + row_begin, m, row_epilogue);
+  ASSERT_LE(arma::abs(c - expected).max(), 1e-3f);
+
+  c.zeros();
+  const uint32_t col_begin = packed_b.panel * 2;
+  GemmPackedB(false, m, a.memptr(), m, packed_b, 0, col_begin, c.memptr(), m, epilogue);
+  GemmEpilogue col_epilogue = epilogue;
+  col_epilogue.col_bias += col_begin;
+  GemmPackedB(false, m, a.memptr(), m, packed_b, col_begin, n - col_begin, c.colptr(col_begin), m, col_epilogue);
+  ASSERT_LE(arma::abs(c - expected).max(), 1e-3f);
+
+  // 单列时使用矩阵向量乘法，结果和带尾部计算的BLAS一致
+  for (const GemmBackend backend : {CompiledGemmBackend(), GemmBackend::kBuiltin}) {
+    ASSERT_TRUE(SetGemmBackend(backend));
+    arma::fvec y(m);
+    Gemm(false, false, m, 1, k, 1.f, a.memptr(), m, b.memptr(), k, 0.f, y.memptr(), m, epilogue);
+    ASSERT_LE(arma::abs(y - expected.col(0)).max(), 1e-3f);
+  }
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+}
+
+TEST(test_tensor, cpu_isa_dispatch) {
+  using namespace kuiper_infer;
+  const CpuIsa default_isa = CurrentCpuIsa();
+  ASSERT_TRUE(CpuIsaCompiled(default_isa));
+  ASSERT_TRUE(CpuIsaSupported(default_isa));
+  CpuIsa parsed = CpuIsa::kScalar;
+  ASSERT_TRUE(ParseCpuIsa(CpuIsaName(CpuIsa::kAVX2), parsed));
+  ASSERT_EQ(parsed, CpuIsa::kAVX2);
+  ASSERT_FALSE(ParseCpuIsa("avx3", parsed));
+
+  const uint32_t m = 70;
+  const uint32_t n = 45;
+  const uint32_t k = 300;
+  arma::fmat a(m, k, arma::fill::randu);
+  arma::fmat b(k, n, arma::fill::randu);
+  a -= 0.5f;
+  std::vector<float> col_bias;
+  for (uint32_t j = 0; j < n; ++j) {
+    col_bias.push_back(float(j % 5) * 0.2f - 0.4f);
+  }
+  arma::fmat expected = a * b;
+  for (uint32_t j = 0; j < n; ++j) {
+    for (uint32_t i = 0; i < m; ++i) {
+      const float value = expected.at(i, j) + col_bias.at(j);
+      expected.at(i, j) = value / (1.f + std::exp(-value));
+    }
+  }
+  GemmEpilogue epilogue;
+  epilogue.col_bias = col_bias.data();
+  epilogue.activation = ActivationType::kActivationSiLU;
+  // 默认级别打包的矩阵在切换级别之后仍然按照打包时的格式计算
+  const GemmPackedMatrix default_packed = GemmPackA(false, m, k, a.memptr(), m);
+  ASSERT_EQ(default_packed.isa, default_isa);
+
+  const QuantizedMatrix &quantized = QuantizeRows(a);
+  std::vector<int8_t> vector(quantized.stride, 0);
+  for (uint32_t c = 0; c < k; ++c) {
+    vector.at(c) = int8_t(int32_t(c * 7 % 255) - 127);
+  }
+  std::vector<float> values;
+  for (int32_t i = -50; i < 50; ++i) {
+    values.push_back(float(i) * 0.37f);
+  }
+
+  ASSERT_TRUE(SetGemmBackend(GemmBackend::kBuiltin));
+  for (const CpuIsa isa : {CpuIsa::kScalar, CpuIsa::kSSE42, CpuIsa::kAVX2, CpuIsa::kAVX512, CpuIsa::kNEON}) {
+    if (!CpuIsaCompiled(isa) || !CpuIsaSupported(isa)) {
+      ASSERT_FALSE(SetCpuIsa(isa));
+      continue;
+    }
+    ASSERT_TRUE(SetCpuIsa(isa));
+    ASSERT_EQ(CurrentCpuIsa(), isa);
+    arma::fmat c(m, n);
+    Gemm(false, false, m, n, k, 1.f, a.memptr(), m, b.memptr(), k, 0.f, c.memptr(), m, epilogue);
+    ASSERT_LE(arma::abs(c - expected).max(), 1e-3f) << CpuIsaName(isa);
+
+    const GemmPackedMatrix packed_b = GemmPackB(false, k, n, b.memptr(), k);
+    ASSERT_EQ(packed_b.isa, isa);
+    c.zeros();
+    GemmPackedB(false, m, a.memptr(), m, packed_b, 0, n, c.memptr(), m, epilogue);
+    ASSERT_LE(arma::abs(c - expected).max(), 1e-3f) << CpuIsaName(isa);
+    c.zeros();
+    GemmPackedA(default_packed, 0, m, false, n, b.memptr(), k, c.memptr(), m, epilogue);
+    ASSERT_LE(arma::abs(c - expected).max(), 1e-3f) << CpuIsaName(isa);
+
+    std::vector<float> activated = values;
+    ApplyActivation(ActivationType::kActivationSigmoid, activated.data(), activated.size());
+    for (uint32_t i = 0; i < values.size(); ++i) {
+      ASSERT_NEAR(activated.at(i), 1.f / (1.f + std::exp(-values.at(i))), 1e-6f) << CpuIsaName(isa);
+    }
+
+    std::vector<uint16_t> halves(values.size());
+    std::vector<float> widened(values.size());
+    FloatToHalf(values.data(), values.size(), halves.data());
+    HalfToFloat(halves.data(), halves.size(), widened.data());
+    for (uint32_t i = 0; i < values.size(); ++i) {
+      ASSERT_EQ(halves.at(i), FloatToHalf(values.at(i))) << CpuIsaName(isa);
+      ASSERT_EQ(widened.at(i), HalfToFloat(halves.at(i))) << CpuIsaName(isa);
+    }
+
+    // 通道大小不是向量宽度的整数倍，第二个张量每个通道只有一个值
+    std::shared_ptr<Tensor<float>> tensor1 = std::make_shared<Tensor<float>>(3, 7, 11);
+    std::shared_ptr<Tensor<float>> tensor2 = std::make_shared<Tensor<float>>(3, 1, 1);
+    tensor1->Rand();
+    tensor2->Rand();
+    const std::shared_ptr<Tensor<float>> &sum = Tensor<float>::ElementAdd(tensor1, tensor2);
+    const std::shared_ptr<Tensor<float>> &product = Tensor<float>::ElementMultiply(tensor2, tensor1);
+    for (uint32_t ch = 0; ch < 3; ++ch) {
+      for (uint32_t i = 0; i < 7 * 11; ++i) {
+        const float value = tensor1->at(ch).at(i);
+        ASSERT_EQ(sum->at(ch).at(i), value + tensor2->index(ch)) << CpuIsaName(isa);
+        ASSERT_EQ(product->at(ch).at(i), tensor2->index(ch) * value) << CpuIsaName(isa);
+      }
+    }
+
+    std::vector<int32_t> output(m);
+    Int8MatrixVector(quantized, vector.data(), 0, m, output.data());
+    for (uint32_t r = 0; r < m; ++r) {
+      int32_t dot = 0;
+      for (uint32_t c = 0; c < k; ++c) {
+        dot += int32_t(quantized.data.at(r * quantized.stride + c)) * int32_t(vector.at(c));
+      }
+      ASSERT_EQ(output.at(r), dot) << CpuIsaName(isa);
+    }
+  }
+  ASSERT_TRUE(SetCpuIsa(default_isa));
+  ASSERT_TRUE(SetGemmBackend(CompiledGemmBackend()));
+}
+
+/// 按照image_sizes中的高和宽生成BGR图片，像素保存在pixels中，images指向这些像素
+static void MakeTestImages(const std::vector<std::pair<uint32_t, uint32_t>> &image_sizes,
+                           std::vector<std::vector<uint8_t>> &pixels,
+                           std::vector<kuiper_infer::ImageView> &images) {
+  for (const auto &image_size : image_sizes) {
+    std::vector<uint8_t> image_pixels(image_size.first * image_size.second * 3);
+    for (uint32_t i = 0; i < image_pixels.size(); ++i) {
+      image_pixels.at(i) = uint8_t(i * 37 % 251);
+    }
+    pixels.push_back(std::move(image_pixels));
+  }
+  for (uint32_t i = 0; i < image_sizes.size(); ++i) {
+    kuiper_infer::ImageView image;
+    image.data = pixels.at(i).data();
+    image.height = image_sizes.at(i).first;
+    image.width = image_sizes.at(i).second;
+    images.push_back(image);
+  }
+}
+
+TEST(test_tensor, image_preprocess) {
+  using namespace kuiper_infer;
+  // 两张大小不同的BGR图片，一张缩小一张放大，letterbox之后写入同一个批次
+  const std::vector<std::pair<uint32_t, uint32_t>> image_sizes{{37, 53}, {10, 7}};
+  std::vector<std::vector<uint8_t>> pixels;
+  std::vector<ImageView> images;
+  MakeTestImages(image_sizes, pixels, images);
+
+  ImagePreprocessParam param;
+  param.target_height = 64;
+  param.target_width = 48;
+  std::vector<float> output(images.size() * 3 * 64 * 48);
+  const std::vector<LetterboxInfo> &infos = PreprocessImages(images, param, output.data());
+  ASSERT_EQ(infos.size(), images.size());
+
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    const ImageView &image = images.at(i);
+    const LetterboxInfo &info = infos.at(i);
+    const uint32_t resized_width = std::lround(image.width * info.scale_x);
+    const uint32_t resized_height = std::lround(image.height * info.scale_y);
+    ASSERT_TRUE(resized_width == param.target_width || resized_height == param.target_height);
+    // 输出和张量的内存布局相同
+    Tensor<float> tensor(output.data() + i * 3 * 64 * 48, 3, 64, 48);
+    auto pixel = [&](uint32_t y, uint32_t x, uint32_t c) {
+      return float(image.data[(y * image.width + x) * 3 + c]);
+    };
+    for (uint32_t c = 0; c < 3; ++c) {
+      for (uint32_t y = 0; y < param.target_height; ++y) {
+        for (uint32_t x = 0; x < param.target_width; ++x) {
+          float expected = 114.f / 255.f;
+          if (y >= info.pad_top && y < info.pad_top + resized_height && x >= info.pad_left
+              && x < info.pad_left + resized_width) {
+            const float src_x = std::max((float(x - info.pad_left) + 0.5f) * image.width / resized_width - 0.5f, 0.f);
+            const float src_y = std::max((float(y - info.pad_top) + 0.5f) * image.height / resized_height - 0.5f, 0.f);
+            const uint32_t x0 = std::min(uint32_t(src_x), image.width - 1);
+            const uint32_t y0 = std::min(uint32_t(src_y), image.height - 1);
+            const uint32_t x1 = std::min(x0 + 1, image.width - 1);
+            const uint32_t y1 = std::min(y0 + 1, image.height - 1);
+            const float weight_x = x0 == x1 ? 0.f : src_x - float(x0);
+            const float weight_y = y0 == y1 ? 0.f : src_y - float(y0);
+            // 输出的第一个通道是原图的第三个通道
+            const uint32_t src_c = 2 - c;
+            const float top = pixel(y0, x0, src_c) * (1 - weight_x) + pixel(y0, x1, src_c) * weight_x;
+            const float bottom = pixel(y1, x0, src_c) * (1 - weight_x) + pixel(y1, x1, src_c) * weight_x;
+            expected = (top * (1 - weight_y) + bottom * weight_y) / 255.f;
+          }
+          ASSERT_NEAR(tensor.at(c, y, x), expected, 1e-5) << "image: " << i << " c: " << c << " y: " << y
+                                                          << " x: " << x;
+        }
+      }
+    }
+  }
+}
+
+TEST(test_tensor, image_preprocess_cuda) {
+  using namespace kuiper_infer;
+  // 设备上的预处理和CPU上的结果相同，输出留在设备上
+  if (!DeviceAvailable(DeviceType::kDeviceCUDA)) {
+    return;
+  }
+  const std::vector<std::pair<uint32_t, uint32_t>> image_sizes{{37, 53}, {10, 7}};
+  std::vector<std::vector<uint8_t>> pixels;
+  std::vector<ImageView> images;
+  MakeTestImages(image_sizes, pixels, images);
+
+  ImagePreprocessParam param;
+  param.target_height = 64;
+  param.target_width = 48;
+  param.shift[1] = -0.5f;
+  std::vector<float> expected(images.size() * 3 * 64 * 48);
+  const std::vector<LetterboxInfo> &expected_infos = PreprocessImages(images, param, expected.data());
+
+  std::vector<std::shared_ptr<Tensor<float>>> outputs;
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    outputs.push_back(std::make_shared<Tensor<float>>(3, 64, 48));
+  }
+  const std::vector<LetterboxInfo> &infos = PreprocessImagesCuda(images, param, outputs);
+  ASSERT_EQ(infos.size(), images.size());
+  for (uint32_t i = 0; i < images.size(); ++i) {
+    ASSERT_EQ(infos.at(i).pad_left, expected_infos.at(i).pad_left);
+    ASSERT_EQ(infos.at(i).pad_top, expected_infos.at(i).pad_top);
+    const std::shared_ptr<Tensor<float>> &output = outputs.at(i);
+    ASSERT_EQ(output->device(), DeviceType::kDeviceCUDA);
+    output->SyncTo(DeviceType::kDeviceCPU);
+    const float *expected_data = expected.data() + i * 3 * 64 * 48;
+    for (uint32_t j = 0; j < output->size(); ++j) {
+      ASSERT_NEAR(output->data().memptr()[j], expected_data[j], 1e-5) << "image: " << i << " index: " << j;
+    }
+  }
+}
+
+TEST(test_tensor, tensor_allocator) {
+  using namespace kuiper_infer;
+  // 张量的内存按照64字节对齐
+  for (uint32_t channels = 1; channels < 8; ++channels) {
+    Tensor<float> tensor(channels, 13, 17);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(tensor.data().memptr()) % PoolTensorAllocator::kAlignment, 0);
+  }
+
+  PoolTensorAllocator allocator(size_t(64) << 20, PoolTensorAllocator::kHugePageSize);
+  void *small = allocator.Allocate(1000);
+  ASSERT_NE(small, nullptr);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(small) % PoolTensorAllocator::kAlignment, 0);
+  allocator.Release(small, 1000);
+  ASSERT_GT(allocator.cached_bytes(), 0);
+  // 同一级别的申请复用释放的内存
+  void *reused = allocator.Allocate(1010);
+  ASSERT_EQ(reused, small);
+  ASSERT_EQ(allocator.reused_count(), 1);
+  allocator.Release(reused, 1010);
+
+  // 较大的内存按照大页对齐
+  const size_t large_bytes = size_t(5) << 20;
+  float *large = static_cast<float *>(allocator.Allocate(large_bytes));
+  ASSERT_NE(large, nullptr);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(large) % PoolTensorAllocator::kHugePageSize, 0);
+  for (size_t i = 0; i < large_bytes / sizeof(float); ++i) {
+    large[i] = float(i);
+  }
+  allocator.Release(large, large_bytes);
+  allocator.Trim();
+  ASSERT_EQ(allocator.cached_bytes(), 0);
+}
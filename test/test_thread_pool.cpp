@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+#include <atomic>
+#include <thread>
+
+#include "runtime/thread_pool.hpp"
+#include "runtime/numa.hpp"
+#include "runtime/lock_free_queue.hpp"
+
+TEST(test_thread_pool, parallel_for) {
+  using namespace kuiper_infer;
+  ThreadPool thread_pool(4);
+  ASSERT_EQ(thread_pool.thread_num(), 4);
+
+  const uint32_t size = 1031;
+  std::vector<uint32_t> values(size, 0);
+  thread_pool.ParallelFor(0, size, [&](uint32_t i) {
+    values.at(i) += i;
+  });
+  for (uint32_t i = 0; i < size; ++i) {
+    ASSERT_EQ(values.at(i), i);
+  }
+}
+
+TEST(test_thread_pool, parallel_for_nested) {
+  using namespace kuiper_infer;
+  ThreadPool thread_pool(3);
+  std::atomic<uint32_t> count(0);
+  thread_pool.ParallelFor(0, 8, [&](uint32_t i) {
+    thread_pool.ParallelFor(0, 16, [&](uint32_t j) {
+      count += 1;
+    });
+  });
+  ASSERT_EQ(count.load(), 8 * 16);
+}
+
+TEST(test_thread_pool, set_thread_num) {
+  using namespace kuiper_infer;
+  ThreadPool thread_pool(2);
+  thread_pool.set_thread_num(1);
+  ASSERT_EQ(thread_pool.thread_num(), 1);
+
+  std::atomic<uint32_t> count(0);
+  thread_pool.ParallelFor(0, 10, [&](uint32_t i) {
+    count += 1;
+  });
+  ASSERT_EQ(count.load(), 10);
+
+  thread_pool.set_thread_num(6);
+  ASSERT_EQ(thread_pool.thread_num(), 6);
+  std::atomic<uint32_t> submit_count(0);
+  for (uint32_t i = 0; i < 32; ++i) {
+    thread_pool.Submit([&]() {
+      submit_count += 1;
+    });
+  }
+  while (submit_count != 32) {
+    thread_pool.RunPendingTask();
+  }
+  ASSERT_EQ(submit_count.load(), 32);
+}
+
+TEST(test_thread_pool, numa_binding) {
+  using namespace kuiper_infer;
+  const uint32_t node_num = NumaNodeNum();
+  ASSERT_GE(node_num, 1);
+  ASSERT_LT(CurrentNumaNode(), node_num);
+  ASSERT_FALSE(NumaNodeCpus(0).empty());
+
+  ThreadPool thread_pool(4);
+  thread_pool.set_numa_binding(true);
+  ASSERT_TRUE(thread_pool.numa_binding());
+  ASSERT_EQ(thread_pool.thread_num(), 4);
+  {
+    // 外部线程绑定节点之后提交的任务仍然全部完成，作用域结束后恢复原来的绑定
+    NumaNodeScope numa_scope(0);
+    ASSERT_EQ(PreferredNumaNode(), 0);
+    std::vector<uint32_t> values(1000, 0);
+    thread_pool.ParallelFor(0, values.size(), [&](uint32_t i) {
+      values.at(i) = i * 2;
+    });
+    for (uint32_t i = 0; i < values.size(); ++i) {
+      ASSERT_EQ(values.at(i), i * 2);
+    }
+  }
+  ASSERT_EQ(PreferredNumaNode(), -1);
+
+  // 放置内存不改变内容
+  std::vector<float> data(10000, 1.f);
+  ASSERT_TRUE(PlaceMemory(data.data(), data.size() * sizeof(float), NumaMemoryPolicy::kInterleave));
+  ASSERT_TRUE(PlaceMemory(data.data(), data.size() * sizeof(float), NumaMemoryPolicy::kBind, node_num - 1));
+  for (const float value : data) {
+    ASSERT_EQ(value, 1.f);
+  }
+  thread_pool.set_numa_binding(false);
+  ASSERT_FALSE(thread_pool.numa_binding());
+}
+
+TEST(test_thread_pool, scope) {
+  using namespace kuiper_infer;
+  ASSERT_EQ(&ThreadPool::Current(), &ThreadPool::GetInstance());
+  const std::vector<uint32_t> cpus = ThreadCpus();
+  ASSERT_FALSE(cpus.empty());
+  ThreadPool thread_pool(3, {cpus.front()});
+  ASSERT_EQ(thread_pool.cpu_affinity().size(), 1);
+  {
+    // 作用域内Layer提交的任务和嵌套的任务都使用指定的线程池，当前线程也只在指定的CPU上运行
+    ThreadPool::Scope scope(&thread_pool);
+    ASSERT_EQ(&ThreadPool::Current(), &thread_pool);
+    ASSERT_EQ(ThreadCpus(), thread_pool.cpu_affinity());
+    std::atomic<uint32_t> count(0);
+    std::atomic<uint32_t> other_pool(0);
+    ThreadPool::Current().ParallelFor(0, 8, [&](uint32_t i) {
+      ThreadPool::Current().ParallelFor(0, 4, [&](uint32_t j) {
+        if (&ThreadPool::Current() != &thread_pool) {
+          other_pool += 1;
+        }
+        count += 1;
+      });
+    });
+    ASSERT_EQ(count.load(), 32);
+    ASSERT_EQ(other_pool.load(), 0);
+  }
+  ASSERT_EQ(&ThreadPool::Current(), &ThreadPool::GetInstance());
+  ASSERT_EQ(ThreadCpus(), cpus);
+}
+
+TEST(test_thread_pool, lock_free_queue) {
+  using namespace kuiper_infer;
+  LockFreeQueue<uint32_t> queue(6);
+  ASSERT_EQ(queue.capacity(), 8);
+  for (uint32_t i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.Push(i));
+  }
+  uint32_t value = 8;
+  ASSERT_FALSE(queue.Push(value));
+  for (uint32_t i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.Pop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(queue.Pop(value));
+
+  // 多个生产者和消费者同时访问，每个元素恰好被取出一次
+  const uint32_t producer_num = 3;
+  const uint32_t value_num = 2000;
+  std::vector<std::atomic<uint32_t>> pop_counts(producer_num * value_num);
+  std::atomic<uint32_t> popped(0);
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producer_num; ++p) {
+    threads.emplace_back([&, p]() {
+      for (uint32_t i = 0; i < value_num; ++i) {
+        uint32_t push_value = p * value_num + i;
+        while (!queue.Push(push_value)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    threads.emplace_back([&]() {
+      uint32_t pop_value;
+      while (popped < producer_num * value_num) {
+        if (queue.Pop(pop_value)) {
+          pop_counts.at(pop_value) += 1;
+          popped += 1;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &pop_count : pop_counts) {
+    ASSERT_EQ(pop_count.load(), 1);
+  }
+}
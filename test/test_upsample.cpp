@@ -177,3 +177,70 @@ TEST(test_layer, forward_upsample5) {
   }
 }
 
+
+TEST(test_layer, forward_upsample_nearest_fraction) {
+  using namespace kuiper_infer;
+  // 非整数倍的邻近采样
+  UpSampleLayer layer(1.5f, 2.5f);
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(5, 13, 10);
+  input->Rand();
+  std::vector<std::shared_ptr<Tensor<float>>> inputs{input};
+  std::vector<std::shared_ptr<Tensor<float>>> outputs(1);
+  ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+  const auto &output = outputs.front();
+  ASSERT_EQ(output->rows(), 19);
+  ASSERT_EQ(output->cols(), 25);
+  for (uint32_t c = 0; c < input->channels(); ++c) {
+    for (uint32_t r = 0; r < output->rows(); ++r) {
+      for (uint32_t w = 0; w < output->cols(); ++w) {
+        ASSERT_EQ(output->at(c, r, w), input->at(c, uint32_t(float(r) / 1.5f), uint32_t(float(w) / 2.5f)));
+      }
+    }
+  }
+}
+
+TEST(test_layer, forward_upsample_bilinear) {
+  using namespace kuiper_infer;
+  const uint32_t channels = 3;
+  const uint32_t rows = 11;
+  const uint32_t cols = 7;
+  for (const bool align_corners : {false, true}) {
+    UpSampleLayer layer(2.f, 2.f, UpSampleMode::kModeBilinear, align_corners);
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(channels, rows, cols);
+    input->Rand();
+    std::vector<std::shared_ptr<Tensor<float>>> inputs{input, input->Clone()};
+    std::vector<std::shared_ptr<Tensor<float>>> outputs(2);
+    ASSERT_EQ(layer.Forward(inputs, outputs), InferStatus::kInferSuccess);
+
+    // 按照PyTorch的坐标映射逐个元素计算
+    auto source = [&](uint32_t i, uint32_t input_size, uint32_t output_size) {
+      if (align_corners) {
+        return float(i) * float(input_size - 1) / float(output_size - 1);
+      }
+      return std::max((float(i) + 0.5f) / 2.f - 0.5f, 0.f);
+    };
+    for (const auto &output : outputs) {
+      ASSERT_EQ(output->rows(), rows * 2);
+      ASSERT_EQ(output->cols(), cols * 2);
+      for (uint32_t c = 0; c < channels; ++c) {
+        for (uint32_t r = 0; r < output->rows(); ++r) {
+          const float src_h = source(r, rows, rows * 2);
+          const uint32_t h0 = std::min(uint32_t(src_h), rows - 1);
+          const uint32_t h1 = std::min(h0 + 1, rows - 1);
+          const float lambda_h = src_h - float(h0);
+          for (uint32_t w = 0; w < output->cols(); ++w) {
+            const float src_w = source(w, cols, cols * 2);
+            const uint32_t w0 = std::min(uint32_t(src_w), cols - 1);
+            const uint32_t w1 = std::min(w0 + 1, cols - 1);
+            const float lambda_w = src_w - float(w0);
+            const float expected = (1.f - lambda_h) * ((1.f - lambda_w) * input->at(c, h0, w0)
+                + lambda_w * input->at(c, h0, w1)) + lambda_h * ((1.f - lambda_w) * input->at(c, h1, w0)
+                + lambda_w * input->at(c, h1, w1));
+            ASSERT_NEAR(output->at(c, r, w), expected, 1e-5f) << r << " " << w;
+          }
+        }
+      }
+    }
+  }
+}
@@ -3,8 +3,12 @@
 //
 #include <gtest/gtest.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <numeric>
 #include "runtime/runtime_ir.hpp"
+#include "runtime/video_pipeline.hpp"
 #include "data/load_data.hpp"
+#include "data/image.hpp"
 
 TEST(test_net, forward_yolo1) {
   using namespace kuiper_infer;
@@ -16,8 +20,15 @@ TEST(test_net, forward_yolo1) {
   std::vector<std::shared_ptr<Tensor<float>>> inputs;
 
   for (int i = 0; i < batch_size; ++i) {
+    // 每张图片的内容不同，得分各不相同，检测框不依赖得分相同时的排列顺序
     std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 320, 320);
-    input->Fill(127.f);
+    for (uint32_t c = 0; c < 3; ++c) {
+      for (uint32_t r = 0; r < 320; ++r) {
+        for (uint32_t w = 0; w < 320; ++w) {
+          input->at(c, r, w) = float((c * 131 + r * 7 + w * 13 + i * 29) % 256);
+        }
+      }
+    }
     inputs.push_back(input);
   }
   std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
@@ -62,4 +73,239 @@ TEST(test_net, forward_yolo2) {
       }
     }
   }
-}
\ No newline at end of file
+}
+/**
+ * 对检测头的完整输出逐行计算得分并做非极大值抑制，作为融合后处理的参考结果
+ * 候选框按照融合后处理遍历的顺序（阶段、锚框、列、行）排列，得分相同时两者保留相同的框
+ * @param output 检测头的完整输出，每行是一个锚框在一个位置上的中心点、宽高、目标置信度和类别置信度
+ * @param stage_sizes 每个阶段特征图的边长
+ * @param anchor_num 每个位置的锚框数量
+ * @param post_process 后处理参数
+ * @return 和融合后处理输出格式相同的检测框
+ */
+static arma::fmat ReferencePostProcess(const arma::fmat &output, const std::vector<uint32_t> &stage_sizes,
+                                       uint32_t anchor_num, const kuiper_infer::DetectionPostProcess &post_process) {
+  std::vector<uint32_t> candidates;
+  std::vector<float> scores;
+  uint32_t stage_offset = 0;
+  for (const uint32_t size : stage_sizes) {
+    for (uint32_t a = 0; a < anchor_num; ++a) {
+      for (uint32_t c = 0; c < size; ++c) {
+        for (uint32_t r = 0; r < size; ++r) {
+          const uint32_t row = stage_offset + a * size * size + r * size + c;
+          const float score = output.at(row, 4) * output.row(row).subvec(5, output.n_cols - 1).max();
+          if (score >= post_process.conf_thresh) {
+            candidates.push_back(row);
+            scores.push_back(score);
+          }
+        }
+      }
+    }
+    stage_offset += anchor_num * size * size;
+  }
+  std::vector<uint32_t> order(candidates.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+    return scores.at(lhs) > scores.at(rhs);
+  });
+
+  arma::fmat detections(post_process.max_detections, 6, arma::fill::zeros);
+  detections.col(5).fill(-1.f);
+  uint32_t detection_num = 0;
+  for (uint32_t i = 0; i < order.size() && detection_num < post_process.max_detections; ++i) {
+    const uint32_t row = candidates.at(order.at(i));
+    const float x1 = output.at(row, 0) - output.at(row, 2) / 2;
+    const float y1 = output.at(row, 1) - output.at(row, 3) / 2;
+    const float x2 = output.at(row, 0) + output.at(row, 2) / 2;
+    const float y2 = output.at(row, 1) + output.at(row, 3) / 2;
+    bool suppressed = false;
+    for (uint32_t k = 0; k < detection_num && !suppressed; ++k) {
+      const float inter_w = std::max(0.f, std::min(x2, detections.at(k, 2)) - std::max(x1, detections.at(k, 0)));
+      const float inter_h = std::max(0.f, std::min(y2, detections.at(k, 3)) - std::max(y1, detections.at(k, 1)));
+      const float inter = inter_w * inter_h;
+      const float area_k = (detections.at(k, 2) - detections.at(k, 0)) * (detections.at(k, 3) - detections.at(k, 1));
+      suppressed = inter > post_process.iou_thresh * ((x2 - x1) * (y2 - y1) + area_k - inter);
+    }
+    if (suppressed) {
+      continue;
+    }
+    const arma::frowvec &class_scores = output.row(row).subvec(5, output.n_cols - 1);
+    detections.at(detection_num, 0) = x1;
+    detections.at(detection_num, 1) = y1;
+    detections.at(detection_num, 2) = x2;
+    detections.at(detection_num, 3) = y2;
+    detections.at(detection_num, 4) = scores.at(order.at(i));
+    detections.at(detection_num, 5) = float(class_scores.index_max());
+    detection_num += 1;
+  }
+  return detections;
+}
+
+TEST(test_net, forward_yolo_post_process) {
+  using namespace kuiper_infer;
+  RuntimeGraph graph("tmp/yolo/yolov5n_small.pnnx.param",
+                     "tmp/yolo/yolov5n_small.pnnx.bin");
+  graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  RuntimeGraph post_process_graph("tmp/yolo/yolov5n_small.pnnx.param",
+                                  "tmp/yolo/yolov5n_small.pnnx.bin");
+  DetectionPostProcess post_process;
+  post_process.enabled = true;
+  post_process.conf_thresh = 0.01f;
+  post_process.iou_thresh = 0.45f;
+  post_process.max_detections = 50;
+  post_process_graph.set_detection_post_process(post_process);
+  post_process_graph.Build("pnnx_input_0", "pnnx_output_0");
+
+  const uint32_t batch_size = 4;
+  std::vector<std::shared_ptr<Tensor<float>>> inputs;
+  for (int i = 0; i < batch_size; ++i) {
+    // 每张图片的内容不同，得分各不相同，检测框不依赖得分相同时的排列顺序
+    std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 320, 320);
+    for (uint32_t c = 0; c < 3; ++c) {
+      for (uint32_t r = 0; r < 320; ++r) {
+        for (uint32_t w = 0; w < 320; ++w) {
+          input->at(c, r, w) = float((c * 131 + r * 7 + w * 13 + i * 29) % 256);
+        }
+      }
+    }
+    inputs.push_back(input);
+  }
+  std::vector<std::shared_ptr<Tensor<float>>> outputs = graph.Forward(inputs, false);
+  std::vector<std::shared_ptr<Tensor<float>>> detections = post_process_graph.Forward(inputs, false);
+  ASSERT_EQ(detections.size(), batch_size);
+  for (int i = 0; i < batch_size; ++i) {
+    const auto &output = outputs.at(i)->at(0);
+    const auto &detection = detections.at(i)->at(0);
+    ASSERT_EQ(detection.n_rows, post_process.max_detections);
+    ASSERT_EQ(detection.n_cols, 6);
+
+    // 融合的后处理和先完整解码再做非极大值抑制的结果相同，三个阶段的步长是8、16和32
+    ASSERT_EQ(output.n_rows, 3 * (40 * 40 + 20 * 20 + 10 * 10));
+    const arma::fmat &reference = ReferencePostProcess(output, {40, 20, 10}, 3, post_process);
+    for (uint32_t r = 0; r < detection.n_rows; ++r) {
+      ASSERT_EQ(detection.at(r, 5), reference.at(r, 5)) << "image: " << i << " detection: " << r;
+      for (uint32_t k = 0; k < 4; ++k) {
+        ASSERT_NEAR(detection.at(r, k), reference.at(r, k), 1e-2) << "image: " << i << " detection: " << r;
+      }
+      ASSERT_NEAR(detection.at(r, 4), reference.at(r, 4), 1e-4) << "image: " << i << " detection: " << r;
+    }
+
+    // 得分最高的检测框和完整输出中得分最高的一行相同
+    float best_score = 0.f;
+    for (uint32_t r = 0; r < output.n_rows; ++r) {
+      const float score = output.at(r, 4) * output.row(r).subvec(5, output.n_cols - 1).max();
+      best_score = std::max(best_score, score);
+    }
+    if (best_score < post_process.conf_thresh) {
+      ASSERT_EQ(detection.at(0, 5), -1.f);
+      continue;
+    }
+    ASSERT_NEAR(detection.at(0, 4), best_score, 1e-4);
+
+    // 检测框按照得分排列，保留的框之间交并比不超过阈值
+    for (uint32_t r = 0; r < detection.n_rows && detection.at(r, 5) >= 0; ++r) {
+      ASSERT_GE(detection.at(r, 4), post_process.conf_thresh);
+      if (r > 0) {
+        ASSERT_LE(detection.at(r, 4), detection.at(r - 1, 4));
+      }
+      for (uint32_t k = 0; k < r; ++k) {
+        const float inter_w = std::max(0.f, std::min(detection.at(r, 2), detection.at(k, 2))
+            - std::max(detection.at(r, 0), detection.at(k, 0)));
+        const float inter_h = std::max(0.f, std::min(detection.at(r, 3), detection.at(k, 3))
+            - std::max(detection.at(r, 1), detection.at(k, 1)));
+        const float inter = inter_w * inter_h;
+        const float area_r = (detection.at(r, 2) - detection.at(r, 0)) * (detection.at(r, 3) - detection.at(r, 1));
+        const float area_k = (detection.at(k, 2) - detection.at(k, 0)) * (detection.at(k, 3) - detection.at(k, 1));
+        ASSERT_LE(inter, post_process.iou_thresh * (area_r + area_k - inter) + 1e-3);
+      }
+    }
+  }
+}
+
+TEST(test_net, video_pipeline_yolo) {
+  using namespace kuiper_infer;
+  std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>("tmp/yolo/yolov5n_small.pnnx.param",
+                                                                       "tmp/yolo/yolov5n_small.pnnx.bin");
+  DetectionPostProcess post_process;
+  post_process.enabled = true;
+  post_process.conf_thresh = 0.01f;
+  post_process.iou_thresh = 0.45f;
+  graph->set_detection_post_process(post_process);
+  graph->Build("pnnx_input_0", "pnnx_output_0");
+
+  // 所有的帧内容相同，检测结果也应该相同
+  const uint32_t frame_num = 10;
+  const uint32_t height = 240;
+  const uint32_t width = 400;
+  std::vector<uint8_t> pixels(height * width * 3);
+  for (uint32_t i = 0; i < pixels.size(); ++i) {
+    pixels.at(i) = uint8_t((i * 7) % 251);
+  }
+  ImageView image;
+  image.data = pixels.data();
+  image.height = height;
+  image.width = width;
+
+  VideoPipelineOptions options;
+  options.preprocess.target_height = 320;
+  options.preprocess.target_width = 320;
+  options.batch_size = 4;
+  options.max_batch_wait_us = 2000;
+  options.queue_capacity = 2;
+
+  // 直接预处理和推理一帧作为参照
+  std::shared_ptr<Tensor<float>> input = std::make_shared<Tensor<float>>(3, 320, 320);
+  const LetterboxInfo letterbox = PreprocessImage(image, options.preprocess, input->data().memptr());
+  const std::shared_ptr<Tensor<float>> reference = graph->Forward(graph->CreateContext(), {input}).front();
+  std::vector<VideoDetection> reference_detections;
+  for (uint32_t r = 0; r < reference->rows() && reference->at(0, r, 5) >= 0; ++r) {
+    VideoDetection detection;
+    detection.x1 = std::clamp((reference->at(0, r, 0) - letterbox.pad_left) / letterbox.scale_x, 0.f, float(width));
+    detection.score = reference->at(0, r, 4);
+    detection.class_id = int32_t(reference->at(0, r, 5));
+    reference_detections.push_back(detection);
+  }
+
+  uint32_t read_num = 0;
+  std::vector<uint64_t> frame_indexes;
+  std::vector<std::vector<VideoDetection>> frame_detections;
+  VideoSource source = [&](VideoFrame &frame) {
+    if (read_num == frame_num) {
+      return false;
+    }
+    read_num += 1;
+    frame.image = image;
+    return true;
+  };
+  VideoSink sink = [&](VideoResult &result) {
+    frame_indexes.push_back(result.frame.index);
+    frame_detections.push_back(result.detections);
+    ASSERT_GE(result.latency_ms, 0.);
+  };
+  VideoPipeline pipeline(graph, source, sink, options);
+  pipeline.Wait();
+
+  // 帧按照读取的顺序交给sink
+  ASSERT_EQ(frame_indexes.size(), frame_num);
+  for (uint32_t i = 0; i < frame_num; ++i) {
+    ASSERT_EQ(frame_indexes.at(i), i);
+    const std::vector<VideoDetection> &detections = frame_detections.at(i);
+    ASSERT_EQ(detections.size(), reference_detections.size());
+    for (uint32_t d = 0; d < detections.size(); ++d) {
+      ASSERT_EQ(detections.at(d).class_id, reference_detections.at(d).class_id);
+      ASSERT_NEAR(detections.at(d).score, reference_detections.at(d).score, 1e-4);
+      ASSERT_NEAR(detections.at(d).x1, reference_detections.at(d).x1, 1e-2);
+      ASSERT_GE(detections.at(d).y1, 0.f);
+      ASSERT_LE(detections.at(d).y2, float(height));
+    }
+  }
+  const VideoPipelineStats stats = pipeline.stats();
+  ASSERT_EQ(stats.frame_num, frame_num);
+  ASSERT_EQ(stats.dropped_num, 0);
+  ASSERT_GE(stats.batch_num, (frame_num + options.batch_size - 1) / options.batch_size);
+  ASSERT_LE(stats.batch_num, frame_num);
+  ASSERT_GT(stats.frames_per_second, 0.);
+  ASSERT_GT(stats.infer_ms, 0.);
+  LOG(INFO) << stats.ToString();
+}